@@ -0,0 +1,27 @@
+#ifndef _ALIAS_TABLE_SHARED_DEF_H_
+#define _ALIAS_TABLE_SHARED_DEF_H_
+
+#include "CppTypes.h"
+
+GPU_STRUCTURE_NAMESPACE_BEGIN
+
+struct SAliasTableEntry
+{
+    float threshold;    // Probability of keeping this entry rather than taking its alias once the slot is chosen
+    uint alias;         // Relative to the first entry of the table
+    float probability;  // Normalized probability of selecting this entry, used to evaluate PDFs
+};
+
+#ifndef __cplusplus
+// Selects an entry of the table starting at offset with one sample for the slot and another one for the choice between the slot and its alias
+uint AliasTable_Sample( StructuredBuffer<SAliasTableEntry> table, uint offset, uint count, float2 samples )
+{
+    uint index = min( (uint)( samples.x * count ), count - 1 );
+    SAliasTableEntry entry = table[ offset + index ];
+    return samples.y < entry.threshold ? index : entry.alias;
+}
+#endif
+
+GPU_STRUCTURE_NAMESPACE_END
+
+#endif
@@ -11,12 +11,22 @@ float CheckerboardTexture( float2 texcoord )
     return ( ( uint( texcoord.x * 2 ) + uint( texcoord.y * 2 ) ) & 0x1 ) != 0 ? 1.0f : 0.0f;
 }
 
+// Ray cone texture LOD. footprint is the cone width at the hit divided by the cosine between the ray and the triangle,
+// texcoordAreaRatio is the texcoord area of the triangle divided by its area, both in the local space of the instance.
+float CalculateTextureLOD( Texture2D<float4> tex, float footprint, float texcoordAreaRatio )
+{
+    uint width, height, levelCount;
+    tex.GetDimensions( 0, width, height, levelCount );
+    return max( 0.5f * log2( texcoordAreaRatio * width * height ) + log2( footprint ), 0.0f );
+}
+
 void HitShader( float3 rayOrigin
     , float3 rayDirection
     , Vertex v0
     , Vertex v1
     , Vertex v2
     , float t
+    , float footprint
     , float u
     , float v
     , uint triangleId
@@ -56,15 +66,21 @@ void HitShader( float3 rayOrigin
 
     uint materialId = materialOverride != INSTANCE_MATERIAL_OVERRIDE_NONE ? materialOverride : materialIds[ triangleId ];
 
+    float2 texTiling = materials[ materialId ].texTiling;
     float2 texcoord = VectorBaryCentric2( v0.texcoord, v1.texcoord, v2.texcoord, u, v );
-           texcoord *= materials[ materialId ].texTiling;
+           texcoord *= texTiling;
 
     float3 albedo = materials[ materialId ].albedo;
     int albedoTextureIndex = materials[ materialId ].albedoTextureIndex;
     [branch]
     if ( albedoTextureIndex != -1 )
     {
-        albedo *= textures[ NonUniformResourceIndex( albedoTextureIndex ) ].SampleLevel( samplerState, texcoord, 0 ).rgb;
+        float2 t0t1 = ( v1.texcoord - v0.texcoord ) * texTiling;
+        float2 t0t2 = ( v2.texcoord - v0.texcoord ) * texTiling;
+        float texcoordArea = abs( t0t1.x * t0t2.y - t0t2.x * t0t1.y );
+        float triangleArea = length( cross( v0v2, v0v1 ) );
+        float lod = CalculateTextureLOD( textures[ NonUniformResourceIndex( albedoTextureIndex ) ], footprint, texcoordArea / max( triangleArea, 1e-20f ) );
+        albedo *= textures[ NonUniformResourceIndex( albedoTextureIndex ) ].SampleLevel( samplerState, texcoord, lod ).rgb;
     }
 
     float checkerboard = CheckerboardTexture( texcoord );
@@ -24,21 +24,30 @@ float3 TriangleLight_Evaluate( SLight light, float3 direction, float3 normal )
     return dot( direction, normal ) > 0.f ? light.radiance : 0.f;
 }
 
-void TriangleLight_EvaluateWithPDF( SLight light, float4x3 transform, float3 v0, float3 v1, float3 v2, float3 wi, float3 normal, float distance, out float3 radiance, out float pdf )
+bool TriangleLight_ShouldSampleSolidAngle( float solidAngle )
+{
+    return solidAngle >= TRIANGLE_LIGHT_MIN_SOLID_ANGLE_SAMPLING && solidAngle <= TRIANGLE_LIGHT_MAX_SOLID_ANGLE_SAMPLING;
+}
+
+void TriangleLight_EvaluateWithPDF( SLight light, float4x3 transform, float3 v0, float3 v1, float3 v2, float3 p, float3 wi, float3 normal, float distance, out float3 radiance, out float pdf )
 {
     // Transform all vertices to world space before evaluation so we can calculate correct surface area use triangle edge vectors
     v0 = mul( float4( v0, 1.f ), transform );
     v1 = mul( float4( v1, 1.f ), transform );
     v2 = mul( float4( v2, 1.f ), transform );
 
-    float3 v0v1 = v1 - v0;
-    float3 v0v2 = v2 - v0;
-    float3 crossProduct = cross( v0v2, v0v1 );
-    float surfaceArea = length( crossProduct );
-    pdf = surfaceArea >= 1e-6f ? 1.f / ( surfaceArea * .5f ) : 0.f;
-
     float WIdotN = -dot( wi, normal );
     radiance = WIdotN > 0.f ? light.radiance : 0.f;
+
+    float solidAngle = SphericalTriangleSolidAngle( normalize( v0 - p ), normalize( v1 - p ), normalize( v2 - p ) );
+    if ( TriangleLight_ShouldSampleSolidAngle( solidAngle ) )
+    {
+        pdf = WIdotN > 0.f ? 1.f / solidAngle : 0.f;
+        return;
+    }
+
+    float surfaceArea = length( cross( v2 - v0, v1 - v0 ) ) * .5f;
+    pdf = surfaceArea >= 1e-6f ? 1.f / surfaceArea : 0.f;
     pdf *= WIdotN > 0.f ? distance * distance / dot( -wi, normal ) : 0.f;
 }
 
@@ -48,19 +57,36 @@ void TriangleLight_Sample( SLight light, float4x3 transform, float3 v0, float3 v
     float3 vws0 = mul( float4( v0, 1.f ), transform );
     float3 vws1 = mul( float4( v1, 1.f ), transform );
     float3 vws2 = mul( float4( v2, 1.f ), transform );
-    float surfaceArea = length( cross( vws2 - vws0, vws1 - vws0 ) ) * .5f;
-
-    float2 samplePosBarycentric = SampleTriangle( samples );
-    float3 samplePos = VectorBaryCentric3( v0, v1, v2, samplePosBarycentric.x, samplePosBarycentric.y );
     float3 v0v1 = v1 - v0;
     float3 v0v2 = v2 - v0;
-    float3 crossProduct = cross( v0v2, v0v1 );
-    float3 normal = normalize( crossProduct );
-    pdf = surfaceArea >= 1e-6f ? 1.f / ( surfaceArea * .5f ) : 0.f;
+    float3 normal = normalize( mul( float4( normalize( cross( v0v2, v0v1 ) ), 0.f ), transform ) );
+
+    // Large triangles close to p are sampled in solid angle, the area sampling PDF would vary a lot over them
+    float3 a = normalize( vws0 - p );
+    float3 b = normalize( vws1 - p );
+    float3 c = normalize( vws2 - p );
+    float solidAngle = SphericalTriangleSolidAngle( a, b, c );
+    if ( TriangleLight_ShouldSampleSolidAngle( solidAngle ) )
+    {
+        wi = SampleSphericalTriangle( a, b, c, samples, pdf );
+
+        // Intersect the plane of the triangle to find the distance to the sample
+        float3 planeNormal = cross( vws2 - vws0, vws1 - vws0 );
+        float WIdotPlaneNormal = dot( wi, planeNormal );
+        distance = WIdotPlaneNormal != 0.f ? dot( vws0 - p, planeNormal ) / WIdotPlaneNormal : 0.f;
+        pdf = distance > 0.f ? pdf : 0.f;
+
+        float WIdotN = -dot( wi, normal );
+        radiance = WIdotN > 0.f && pdf > 0.f ? light.radiance : 0.f;
+        pdf = WIdotN > 0.f ? pdf : 0.f;
+        return;
+    }
 
-    // Transform the sample position and normal to world space before we calculating wi
-    samplePos = mul( float4( samplePos, 1.f ), transform );
-    normal = normalize( mul( float4( normal, 0.f ), transform ) );
+    float surfaceArea = length( cross( vws2 - vws0, vws1 - vws0 ) ) * .5f;
+
+    float2 samplePosBarycentric = SampleTriangle( samples );
+    float3 samplePos = VectorBaryCentric3( vws0, vws1, vws2, samplePosBarycentric.x, samplePosBarycentric.y );
+    pdf = surfaceArea >= 1e-6f ? 1.f / surfaceArea : 0.f;
 
     wi = samplePos - p;
     distance = length( wi );
@@ -81,28 +107,103 @@ float3 EnvironmentLight_Evaluate( SLight light, float3 direction, TextureCube<fl
 #endif
 }
 
-void EnvironmentLight_EvaluateWithPDF( SLight light, float3 wi, TextureCube<float3> envTexture, SamplerState envTextureSampler, out float3 radiance, out float pdf )
+// u and v are in [-1, 1] with v pointing down the face, same as the texel addressing of TextureCube
+float3 CubemapFaceToDirection( uint face, float u, float v )
+{
+    switch ( face )
+    {
+    case 0: return float3( 1.f, -v, -u );
+    case 1: return float3( -1.f, -v, u );
+    case 2: return float3( u, 1.f, v );
+    case 3: return float3( u, -1.f, -v );
+    case 4: return float3( u, -v, 1.f );
+    default: return float3( -u, -v, -1.f );
+    }
+}
+
+uint CubemapDirectionToCell( float3 direction, uint cellCount, out float u, out float v )
+{
+    float3 absDirection = abs( direction );
+    uint face;
+    if ( absDirection.x >= absDirection.y && absDirection.x >= absDirection.z )
+    {
+        u = ( direction.x > 0.f ? -direction.z : direction.z ) / absDirection.x;
+        v = -direction.y / absDirection.x;
+        face = direction.x > 0.f ? 0 : 1;
+    }
+    else if ( absDirection.y >= absDirection.z )
+    {
+        u = direction.x / absDirection.y;
+        v = ( direction.y > 0.f ? direction.z : -direction.z ) / absDirection.y;
+        face = direction.y > 0.f ? 2 : 3;
+    }
+    else
+    {
+        u = ( direction.z > 0.f ? direction.x : -direction.x ) / absDirection.z;
+        v = -direction.y / absDirection.z;
+        face = direction.z > 0.f ? 4 : 5;
+    }
+    uint x = min( (uint)( saturate( ( u + 1.f ) * .5f ) * cellCount ), cellCount - 1 );
+    uint y = min( (uint)( saturate( ( v + 1.f ) * .5f ) * cellCount ), cellCount - 1 );
+    return ( face * cellCount + y ) * cellCount + x;
+}
+
+// Directions are distributed uniformly over the area of a cell on the face plane, dA = r^3 * dw
+float CubemapCellPDF( float cellProbability, uint cellCount, float u, float v )
+{
+    float squaredDistance = 1.f + u * u + v * v;
+    return cellProbability * cellCount * cellCount * .25f * squaredDistance * sqrt( squaredDistance );
+}
+
+void EnvironmentLight_EvaluateWithPDF( SLight light, float3 wi, TextureCube<float3> envTexture, SamplerState envTextureSampler, StructuredBuffer<SAliasTableEntry> envDistribution, out float3 radiance, out float pdf )
 {
 #if defined( HAS_ENV_TEXTURE )
     radiance = envTexture.SampleLevel( envTextureSampler, wi, 0 ).rgb * light.radiance;
+    uint cellCount = Light_GetEnvironmentDistributionCellCount( light );
+    if ( cellCount != 0 )
+    {
+        float u, v;
+        uint cellIndex = CubemapDirectionToCell( wi, cellCount, u, v );
+        pdf = CubemapCellPDF( envDistribution[ cellIndex ].probability, cellCount, u, v );
+    }
+    else
+    {
+        pdf = UniformSpherePDF();
+    }
 #else 
     radiance = light.radiance;
-#endif
     pdf = UniformSpherePDF();
+#endif
 }
 
-void EnvironmentLight_Sample( SLight light, float2 samples, TextureCube<float3> envTexture, SamplerState envTextureSampler, out float3 radiance, out float3 wi, out float distance, out float pdf )
+void EnvironmentLight_Sample( SLight light, float4 samples, TextureCube<float3> envTexture, SamplerState envTextureSampler, StructuredBuffer<SAliasTableEntry> envDistribution, out float3 radiance, out float3 wi, out float distance, out float pdf )
 {
-    wi = SampleSphere( samples );
-    pdf = UniformSpherePDF();
 #if defined( HAS_ENV_TEXTURE )
+    uint cellCount = Light_GetEnvironmentDistributionCellCount( light );
+    if ( cellCount != 0 )
+    {
+        uint faceCellCount = cellCount * cellCount;
+        uint cellIndex = AliasTable_Sample( envDistribution, 0, faceCellCount * 6, samples.xy );
+        uint face = cellIndex / faceCellCount;
+        uint y = ( cellIndex % faceCellCount ) / cellCount;
+        uint x = cellIndex % cellCount;
+        float u = ( x + samples.z ) * 2.f / cellCount - 1.f;
+        float v = ( y + samples.w ) * 2.f / cellCount - 1.f;
+        wi = normalize( CubemapFaceToDirection( face, u, v ) );
+        pdf = CubemapCellPDF( envDistribution[ cellIndex ].probability, cellCount, u, v );
+    }
+    else
+    {
+        wi = SampleSphere( samples.xy );
+        pdf = UniformSpherePDF();
+    }
     radiance = envTexture.SampleLevel( envTextureSampler, wi, 0 ).rgb * light.radiance;
 #else 
+    wi = SampleSphere( samples.xy );
+    pdf = UniformSpherePDF();
     radiance = light.radiance;
 #endif
     distance = FLT_INF;
 }
 
-
-
 #endif
\ No newline at end of file
@@ -0,0 +1,138 @@
+#ifndef _LIGHT_BVH_SHARED_DEF_H_
+#define _LIGHT_BVH_SHARED_DEF_H_
+
+#include "CppTypes.h"
+
+#define LIGHT_BVH_MAX_DEPTH 32
+
+GPU_STRUCTURE_NAMESPACE_BEGIN
+
+// Bounds of the lights under a node, nodes are stored depth first so the first child of an interior node directly follows it
+struct SLightBVHNode
+{
+    float3 boundsMin;
+    float power;
+    float3 boundsMax;
+    float cosThetaO;            // Half angle of the cone bounding the emitter normals
+    float3 axis;
+    float cosThetaE;            // Angle around the normals within which light is emitted
+    uint childOrLightIndex;     // Second child of an interior node or the light index of a leaf
+    uint isLeaf;
+};
+
+#ifndef __cplusplus
+// cos( max( 0, a - b ) )
+float LightBVH_CosSubClamped( float sinThetaA, float cosThetaA, float sinThetaB, float cosThetaB )
+{
+    return cosThetaA > cosThetaB ? 1.f : cosThetaA * cosThetaB + sinThetaA * sinThetaB;
+}
+
+// sin( max( 0, a - b ) )
+float LightBVH_SinSubClamped( float sinThetaA, float cosThetaA, float sinThetaB, float cosThetaB )
+{
+    return cosThetaA > cosThetaB ? 0.f : sinThetaA * cosThetaB - cosThetaA * sinThetaB;
+}
+
+// Conservative estimate of the light a shading point receives from the lights under a node.
+// Based on "Importance Sampling of Many Lights with Adaptive Tree Splitting" by Conty Estevez and Kulla
+float LightBVH_Importance( SLightBVHNode node, float3 p )
+{
+    float3 center = ( node.boundsMin + node.boundsMax ) * .5f;
+    float3 halfDiagonal = ( node.boundsMax - node.boundsMin ) * .5f;
+    float squaredRadius = dot( halfDiagonal, halfDiagonal );
+    float3 centerToP = p - center;
+    float squaredDistance = dot( centerToP, centerToP );
+
+    // Angle between the cone axis and the direction to p
+    float cosThetaW = squaredDistance > 0.f ? dot( node.axis, centerToP ) * rsqrt( squaredDistance ) : 1.f;
+    float sinThetaW = SafeSqrt( 1.f - cosThetaW * cosThetaW );
+
+    // Half angle of the cone from p bounding the node bounds
+    float cosThetaB = squaredDistance > squaredRadius ? SafeSqrt( 1.f - squaredRadius / squaredDistance ) : -1.f;
+    float sinThetaB = SafeSqrt( 1.f - cosThetaB * cosThetaB );
+
+    float sinThetaO = SafeSqrt( 1.f - node.cosThetaO * node.cosThetaO );
+    float cosThetaX = LightBVH_CosSubClamped( sinThetaW, cosThetaW, sinThetaO, node.cosThetaO );
+    float sinThetaX = LightBVH_SinSubClamped( sinThetaW, cosThetaW, sinThetaO, node.cosThetaO );
+    float cosThetaP = LightBVH_CosSubClamped( sinThetaX, cosThetaX, sinThetaB, cosThetaB );
+    if ( cosThetaP <= node.cosThetaE )
+    {
+        return 0.f;
+    }
+    return node.power * cosThetaP / max( squaredDistance, squaredRadius );
+}
+
+// Returns LIGHT_INDEX_INVALID when no light under the root can illuminate p
+uint LightBVH_Sample( StructuredBuffer<SLightBVHNode> nodes, float3 p, float sample, out float pmf )
+{
+    pmf = 1.f;
+    uint nodeIndex = 0;
+    for ( uint depth = 0; depth <= LIGHT_BVH_MAX_DEPTH; ++depth )
+    {
+        SLightBVHNode node = nodes[ nodeIndex ];
+        if ( node.isLeaf )
+        {
+            if ( nodeIndex > 0 || LightBVH_Importance( node, p ) > 0.f )
+            {
+                return node.childOrLightIndex;
+            }
+            break;
+        }
+
+        float importance0 = LightBVH_Importance( nodes[ nodeIndex + 1 ], p );
+        float importance1 = LightBVH_Importance( nodes[ node.childOrLightIndex ], p );
+        if ( importance0 == 0.f && importance1 == 0.f )
+        {
+            break;
+        }
+
+        float probability0 = importance0 / ( importance0 + importance1 );
+        if ( sample < probability0 )
+        {
+            nodeIndex = nodeIndex + 1;
+            sample = min( sample / probability0, 0.99999994f );
+            pmf *= probability0;
+        }
+        else
+        {
+            nodeIndex = node.childOrLightIndex;
+            sample = min( ( sample - probability0 ) / ( 1.f - probability0 ), 0.99999994f );
+            pmf *= 1.f - probability0;
+        }
+    }
+    pmf = 0.f;
+    return LIGHT_INDEX_INVALID;
+}
+
+// Probability of LightBVH_Sample returning the light whose path from the root is given by bitTrail, the lowest bit selects the child of the root
+float LightBVH_PMF( StructuredBuffer<SLightBVHNode> nodes, float3 p, uint bitTrail )
+{
+    float pmf = 1.f;
+    uint nodeIndex = 0;
+    for ( uint depth = 0; depth <= LIGHT_BVH_MAX_DEPTH; ++depth )
+    {
+        SLightBVHNode node = nodes[ nodeIndex ];
+        if ( node.isLeaf )
+        {
+            return nodeIndex > 0 || LightBVH_Importance( node, p ) > 0.f ? pmf : 0.f;
+        }
+
+        float importance0 = LightBVH_Importance( nodes[ nodeIndex + 1 ], p );
+        float importance1 = LightBVH_Importance( nodes[ node.childOrLightIndex ], p );
+        if ( importance0 == 0.f && importance1 == 0.f )
+        {
+            return 0.f;
+        }
+
+        bool isSecondChild = ( bitTrail & 0x1 ) != 0;
+        pmf *= ( isSecondChild ? importance1 : importance0 ) / ( importance0 + importance1 );
+        nodeIndex = isSecondChild ? node.childOrLightIndex : nodeIndex + 1;
+        bitTrail >>= 1;
+    }
+    return 0.f;
+}
+#endif
+
+GPU_STRUCTURE_NAMESPACE_END
+
+#endif
@@ -10,12 +10,19 @@
 #define LIGHT_FLAGS_DIRECTIONAL_LIGHT 0x4
 #define LIGHT_FLAGS_ENVIRONMENT_LIGHT 0x8
 
+// Triangle lights subtending a solid angle within this range are sampled uniformly in solid angle rather than in area.
+// Smaller triangles are sampled well by area and lose precision in the spherical triangle sampling, larger ones nearly cover a hemisphere.
+#define TRIANGLE_LIGHT_MIN_SOLID_ANGLE_SAMPLING 3e-4f
+#define TRIANGLE_LIGHT_MAX_SOLID_ANGLE_SAMPLING 6.22f
+
 GPU_STRUCTURE_NAMESPACE_BEGIN
 
 struct SLight
 {
     float3 radiance;
     float3 position_or_triangleRange;
+    uint triangleAliasTableOffset;
+    uint lightBVHBitTrail;
     uint flags;
 };
 
@@ -39,6 +46,21 @@ uint Light_GetInstanceIndex( SLight light )
 {
     return asuint( light.position_or_triangleRange.z );
 }
+
+uint Light_GetTriangleAliasTableOffset( SLight light )
+{
+    return light.triangleAliasTableOffset;
+}
+
+uint Light_GetLightBVHBitTrail( SLight light )
+{
+    return light.lightBVHBitTrail;
+}
+
+uint Light_GetEnvironmentDistributionCellCount( SLight light )
+{
+    return asuint( light.position_or_triangleRange.x );
+}
 #endif
 
 GPU_STRUCTURE_NAMESPACE_END
@@ -20,6 +20,23 @@ float3 SafeSqrt( float3 value )
     return sqrt( max( 0, value ) );
 }
 
+float SafeAsin( float value )
+{
+    return asin( clamp( value, -1, 1 ) );
+}
+
+// Numerically stable angle between two unit vectors
+float AngleBetween( float3 v0, float3 v1 )
+{
+    return dot( v0, v1 ) < 0 ? PI - 2 * SafeAsin( length( v0 + v1 ) * .5f ) : 2 * SafeAsin( length( v1 - v0 ) * .5f );
+}
+
+// Component of v orthogonal to the unit vector w
+float3 GramSchmidt( float3 v, float3 w )
+{
+    return v - dot( v, w ) * w;
+}
+
 float2 VectorBaryCentric2( float2 p0, float2 p1, float2 p2, float u, float v )
 {
     float2 r1 = p1 - p0;
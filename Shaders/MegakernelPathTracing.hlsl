@@ -2,6 +2,8 @@
 
 bool IntersectScene( float3 origin
     , float3 direction
+    , float coneWidth
+    , float coneSpreadAngle
     , uint dispatchThreadIndex
     , StructuredBuffer<Vertex> vertices
     , StructuredBuffer<uint> triangles
@@ -33,7 +35,7 @@ bool IntersectScene( float3 origin
     if ( hasIntersection )
     {
         t = hitInfo.t;
-        HitInfoToIntersection( origin, direction, hitInfo, vertices, triangles, materialIds, materials, instancesTransforms, instanceLightIndices, instanceMaterialOverrides, textures, samplerState, intersection );
+        HitInfoToIntersection( origin, direction, hitInfo, coneWidth, coneSpreadAngle, vertices, triangles, materialIds, materials, instancesTransforms, instanceLightIndices, instanceMaterialOverrides, textures, samplerState, intersection );
     }
     return hasIntersection;
 }
@@ -80,6 +82,7 @@ cbuffer RayTracingConstants : register( b0 )
     uint2 g_TileOffset;
     uint g_EnvironmentLightIndex;
     uint g_FrameSeed;
+    uint g_RussianRouletteBounceCount;
 }
 
 StructuredBuffer<Vertex> g_Vertices                     : register( t0 );
@@ -100,7 +103,11 @@ StructuredBuffer<uint> g_MaterialIds                    : register( t14 );
 StructuredBuffer<Material> g_Materials                  : register( t15 );
 Buffer<uint> g_InstanceLightIndices                     : register( t16 );
 TextureCube<float3> g_EnvTexture                        : register( t17 );
-Texture2D<float4> g_Textures[]                          : register( t18 );
+StructuredBuffer<SAliasTableEntry> g_EnvDistribution    : register( t18 );
+StructuredBuffer<SAliasTableEntry> g_LightAliasTable    : register( t19 );
+StructuredBuffer<SAliasTableEntry> g_TriangleAliasTable : register( t20 );
+StructuredBuffer<SLightBVHNode> g_LightBVHNodes         : register( t21 );
+Texture2D<float4> g_Textures[]                          : register( t22 );
 RWTexture2D<float2> g_SamplePositionTexture             : register( u0 );
 RWTexture2D<float3> g_SampleValueTexture                : register( u1 );
 
@@ -125,9 +132,12 @@ void main( uint threadId : SV_GroupIndex, uint2 pixelPos : SV_DispatchThreadID )
     float3 apertureSample = GetNextSample3D( rng );
     GenerateRay( filmSample, apertureSample, g_FilmSize, g_ApertureRadius, g_FocalDistance, g_FilmDistance, g_BladeCount, g_BladeVertexPos, g_ApertureBaseAngle, g_CameraTransform, intersection.position, wi );
 
+    float coneSpreadAngle = CalculatePixelSpreadAngle( g_FilmSize, g_FilmDistance, g_Resolution );
+    float coneWidth = 0.0f;
+
     float hitDistance;
     uint iterationCounter;
-    bool hasHit = IntersectScene( intersection.position, wi, threadId, g_Vertices, g_Triangles, g_BVHNodes, g_InstanceTransforms, g_InstanceInvTransforms, g_InstanceFlags,
+    bool hasHit = IntersectScene( intersection.position, wi, coneWidth, coneSpreadAngle, threadId, g_Vertices, g_Triangles, g_BVHNodes, g_InstanceTransforms, g_InstanceInvTransforms, g_InstanceFlags,
         g_InstanceLightIndices, g_InstanceMaterialOverrides, g_MaterialIds, g_Materials, g_Textures, UVWrapSampler, rng, intersection, hitDistance, iterationCounter );
 
     if ( hasHit )
@@ -147,7 +157,7 @@ void main( uint threadId : SV_GroupIndex, uint2 pixelPos : SV_DispatchThreadID )
             // Sample light
             if ( g_LightCount != 0 )
             {
-                SLightSampleResult sampleResult = SampleLightDirect( intersection.position, g_Lights, g_LightCount, g_Vertices, g_Triangles, g_InstanceTransforms, g_EnvTexture, UVClampSampler, rng );
+                SLightSampleResult sampleResult = SampleLightDirect( intersection.position, g_Lights, g_LightAliasTable, g_LightCount, g_LightBVHNodes, g_Vertices, g_Triangles, g_InstanceTransforms, g_TriangleAliasTable, g_EnvTexture, UVClampSampler, g_EnvDistribution, rng );
                 bool isDeltaLight = sampleResult.isDeltaLight;
                 if ( any( sampleResult.radiance > 0.f ) && sampleResult.pdf > 0.f
                     && !IsOcculuded( OffsetRayOrigin( intersection.position, intersection.geometryNormal, sampleResult.wi ), sampleResult.wi, sampleResult.distance, threadId,
@@ -177,7 +187,18 @@ void main( uint threadId : SV_GroupIndex, uint2 pixelPos : SV_DispatchThreadID )
                 float NdotWI = abs( dot( intersection.normal, wi ) );
                 pathThroughput = pathThroughput * bsdf * NdotWI / bsdfPdf;
 
-                hasHit = IntersectScene( OffsetRayOrigin( intersection.position, intersection.geometryNormal, wi ), wi, threadId, g_Vertices, g_Triangles, g_BVHNodes, g_InstanceTransforms,
+                if ( iBounce >= g_RussianRouletteBounceCount )
+                {
+                    float survivalProbability = RussianRouletteSurvivalProbability( pathThroughput );
+                    if ( GetNextSample1D( rng ) >= survivalProbability )
+                        break;
+                    pathThroughput /= survivalProbability;
+                }
+
+                // The cone keeps the spread of the primary ray, its width grows with the path length
+                coneWidth += coneSpreadAngle * hitDistance;
+                float3 shadingPosition = intersection.position;
+                hasHit = IntersectScene( OffsetRayOrigin( intersection.position, intersection.geometryNormal, wi ), wi, coneWidth, coneSpreadAngle, threadId, g_Vertices, g_Triangles, g_BVHNodes, g_InstanceTransforms,
                     g_InstanceInvTransforms, g_InstanceFlags, g_InstanceLightIndices, g_InstanceMaterialOverrides, g_MaterialIds, g_Materials, g_Textures, UVWrapSampler, rng, intersection, hitDistance, iterationCounter );
 
                 uint lightIndex = hasHit ? intersection.lightIndex : g_EnvironmentLightIndex;
@@ -185,7 +206,7 @@ void main( uint threadId : SV_GroupIndex, uint2 pixelPos : SV_DispatchThreadID )
                 {
                     float3 radiance;
                     float lightPdf;
-                    EvaluateLightDirect( lightIndex, intersection.triangleIndex, intersection.geometryNormal, wi, hitDistance, g_Lights, g_LightCount, g_Vertices, g_Triangles, g_InstanceTransforms, g_EnvTexture, UVClampSampler, radiance, lightPdf );
+                    EvaluateLightDirect( shadingPosition, lightIndex, intersection.triangleIndex, intersection.geometryNormal, wi, hitDistance, g_Lights, g_LightAliasTable, g_LightCount, g_LightBVHNodes, g_Vertices, g_Triangles, g_InstanceTransforms, g_TriangleAliasTable, g_EnvTexture, UVClampSampler, g_EnvDistribution, radiance, lightPdf );
                     if ( lightPdf > 0.0f )
                     {
                         float weight = !isDeltaBxdf ? PowerHeuristic( 1, bsdfPdf, 1, lightPdf ) : 1.0f;
@@ -227,6 +248,7 @@ cbuffer RayTracingConstants : register( b0 )
     uint2 g_TileOffset;
     uint g_EnvironmentLightIndex;
     uint g_FrameSeed;
+    uint g_RussianRouletteBounceCount;
 }
 
 cbuffer DebugConstants : register( b1 )
@@ -244,7 +266,7 @@ Buffer<uint> g_InstanceMaterialOverrides : register( t13 );
 StructuredBuffer<uint> g_MaterialIds    : register( t14 );
 StructuredBuffer<Material> g_Materials  : register( t15 );
 Buffer<uint> g_InstanceLightIndices     : register( t16 );
-Texture2D<float4> g_Textures[]          : register( t18 );
+Texture2D<float4> g_Textures[]          : register( t22 );
 RWTexture2D<float2> g_SamplePositionTexture : register( u0 );
 RWTexture2D<float3> g_SampleValueTexture    : register( u1 );
 
@@ -268,7 +290,7 @@ void main( uint threadId : SV_GroupIndex, uint2 pixelPos : SV_DispatchThreadID )
 
     float hitDistance = 0.0f;
     uint iterationCounter;
-    if ( IntersectScene( intersection.position, wo, threadId, g_Vertices, g_Triangles, g_BVHNodes, g_InstanceTransforms, g_InstanceInvTransforms, g_InstanceFlags,
+    if ( IntersectScene( intersection.position, wo, 0.0f, CalculatePixelSpreadAngle( g_FilmSize, g_FilmDistance, g_Resolution ), threadId, g_Vertices, g_Triangles, g_BVHNodes, g_InstanceTransforms, g_InstanceInvTransforms, g_InstanceFlags,
         g_InstanceLightIndices, g_InstanceMaterialOverrides, g_MaterialIds, g_Materials, g_Textures, UVWrapSampler, rng, intersection, hitDistance, iterationCounter ) )
     {
 #if defined( OUTPUT_NORMAL )
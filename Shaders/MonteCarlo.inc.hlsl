@@ -59,6 +59,60 @@ float2 SampleTriangle( float2 sample )
     return float2( 1.0f - s, sample.y * s );
 }
 
+// Solid angle subtended by the spherical triangle with unit vertices a, b and c
+float SphericalTriangleSolidAngle( float3 a, float3 b, float3 c )
+{
+    return abs( 2 * atan2( dot( a, cross( b, c ) ), 1 + dot( a, b ) + dot( a, c ) + dot( b, c ) ) );
+}
+
+// Uniformly samples a direction in the spherical triangle with unit vertices a, b and c.
+// Based on "Stratified Sampling of Spherical Triangles" by Arvo, following SampleSphericalTriangle of PBRT-v4
+float3 SampleSphericalTriangle( float3 a, float3 b, float3 c, float2 sample, out float pdf )
+{
+    pdf = 0;
+
+    float3 n_ab = cross( a, b );
+    float3 n_bc = cross( b, c );
+    float3 n_ca = cross( c, a );
+    if ( dot( n_ab, n_ab ) == 0 || dot( n_bc, n_bc ) == 0 || dot( n_ca, n_ca ) == 0 )
+    {
+        return 0;
+    }
+    n_ab = normalize( n_ab );
+    n_bc = normalize( n_bc );
+    n_ca = normalize( n_ca );
+
+    // Interior angles at the vertices, their sum minus pi is the area of the spherical triangle
+    float alpha = AngleBetween( n_ab, -n_ca );
+    float beta = AngleBetween( n_bc, -n_ab );
+    float gamma = AngleBetween( n_ca, -n_bc );
+    float A_pi = alpha + beta + gamma;
+    float area = A_pi - PI;
+    if ( area <= 0 )
+    {
+        return 0;
+    }
+    pdf = 1 / area;
+
+    // Find the vertex c' of the sub-triangle a b c' with the sampled area
+    float Ap_pi = lerp( PI, A_pi, sample.x );
+    float cosAlpha = cos( alpha );
+    float sinAlpha = sin( alpha );
+    float sinPhi = sin( Ap_pi ) * cosAlpha - cos( Ap_pi ) * sinAlpha;
+    float cosPhi = cos( Ap_pi ) * cosAlpha + sin( Ap_pi ) * sinAlpha;
+    float k1 = cosPhi + cosAlpha;
+    float k2 = sinPhi - sinAlpha * dot( a, b );
+    float cosBp = ( k2 + ( k2 * cosPhi - k1 * sinPhi ) * cosAlpha ) / ( ( k2 * sinPhi + k1 * cosPhi ) * sinAlpha );
+    cosBp = clamp( cosBp, -1, 1 );
+    float sinBp = SafeSqrt( 1 - cosBp * cosBp );
+    float3 cp = cosBp * a + sinBp * normalize( GramSchmidt( c, a ) );
+
+    // Sample along the arc between b and c'
+    float cosTheta = 1 - sample.y * ( 1 - dot( cp, b ) );
+    float sinTheta = SafeSqrt( 1 - cosTheta * cosTheta );
+    return cosTheta * b + sinTheta * normalize( GramSchmidt( cp, b ) );
+}
+
 float3 SampleSphere( float2 sample )
 {
     float z = 1 - 2 * sample.x;
@@ -72,6 +126,13 @@ float UniformSpherePDF()
     return 1 / ( 4 * PI );
 }
 
+// Probability for a path to continue after Russian roulette, paths carrying little throughput are likely to be terminated.
+// The throughput of surviving paths is divided by this probability.
+float RussianRouletteSurvivalProbability( float3 pathThroughput )
+{
+    return saturate( max( pathThroughput.x, max( pathThroughput.y, pathThroughput.z ) ) );
+}
+
 float PowerHeuristic( uint nf, float fPdf, uint ng, float gPdf )
 {
     float f = nf * fPdf;
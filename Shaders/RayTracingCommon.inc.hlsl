@@ -6,6 +6,8 @@
 #include "MonteCarlo.inc.hlsl"
 #include "Vertex.inc.hlsl"
 #include "LightSharedDef.inc.hlsl"
+#include "AliasTableSharedDef.inc.hlsl"
+#include "LightBVHSharedDef.inc.hlsl"
 #include "Light.inc.hlsl"
 #include "Material.inc.hlsl"
 #include "BVHNode.inc.hlsl"
@@ -85,9 +87,17 @@ void GenerateRay( float2 filmSample
     direction = mul( float4( direction, 0.0f ), cameraTransform ).xyz;
 }
 
+// Angle between the rays through neighbouring pixels, used as the spread angle of the ray cones
+float CalculatePixelSpreadAngle( float2 filmSize, float filmDistance, uint2 resolution )
+{
+    return filmSize.y / ( filmDistance * resolution.y );
+}
+
 void HitInfoToIntersection( float3 origin
     , float3 direction
     , SHitInfo hitInfo
+    , float coneWidth
+    , float coneSpreadAngle
     , StructuredBuffer<Vertex> vertices
     , StructuredBuffer<uint> triangles
     , StructuredBuffer<uint> materialIds
@@ -107,7 +117,15 @@ void HitInfoToIntersection( float3 origin
     Vertex v0 = vertices[ triangles[ hitInfo.triangleId * 3 ] ];
     Vertex v1 = vertices[ triangles[ hitInfo.triangleId * 3 + 1 ] ];
     Vertex v2 = vertices[ triangles[ hitInfo.triangleId * 3 + 2 ] ];
-    HitShader( origin, direction, v0, v1, v2, hitInfo.t, hitInfo.u, hitInfo.v, hitInfo.triangleId, hitInfo.backface, materialOverride, materialIds, materials, textures, samplerState, intersection );
+
+    // Project the cone width at the hit onto the triangle and bring it to the local space of the instance for the texture LOD.
+    // Same uniform scaling assumption as below.
+    float4x3 instanceTransform = instances[ hitInfo.instanceIndex ];
+    float instanceScale = length( instanceTransform[ 0 ] );
+    float3 geometryNormal = normalize( mul( float4( cross( v2.position - v0.position, v1.position - v0.position ), 0.f ), instanceTransform ) );
+    float footprint = ( coneWidth + coneSpreadAngle * hitInfo.t ) / ( instanceScale * max( abs( dot( geometryNormal, direction ) ), 0.01f ) );
+
+    HitShader( origin, direction, v0, v1, v2, hitInfo.t, footprint, hitInfo.u, hitInfo.v, hitInfo.triangleId, hitInfo.backface, materialOverride, materialIds, materials, textures, samplerState, intersection );
     // Transform the position & vectors from local space to world space. Assuming the transform only contains uniform scaling otherwise the transformed vectors are wrong.
     intersection.position = mul( float4( intersection.position, 1.f ), instances[ hitInfo.instanceIndex ] );
     intersection.normal = normalize( mul( float4( intersection.normal, 0.f ), instances[ hitInfo.instanceIndex ] ) );
@@ -132,19 +150,38 @@ struct SLightSampleResult
 
 SLightSampleResult SampleLightDirect( float3 p
     , StructuredBuffer<SLight> lights
+    , StructuredBuffer<SAliasTableEntry> lightAliasTable
     , uint lightCount
+    , StructuredBuffer<SLightBVHNode> lightBVHNodes
     , StructuredBuffer<Vertex> vertices
     , StructuredBuffer<uint> triangles
     , StructuredBuffer<float4x3> instanceTransforms
+    , StructuredBuffer<SAliasTableEntry> triangleAliasTable
     , TextureCube<float3> envTexture
     , SamplerState envTextureSampler
+    , StructuredBuffer<SAliasTableEntry> envDistribution
     , inout Xoshiro128StarStar rng )
 {
     SLightSampleResult result;
 
-    // Uniformly select one light
-    float lightSelectionSample = GetNextSample1D( rng );
-    uint lightIndex = floor( lightSelectionSample * lightCount );
+    // Select a light at infinity proportionally to its estimated power, or the light BVH in the last entry
+    uint lightIndex = AliasTable_Sample( lightAliasTable, 0, lightCount + 1, GetNextSample2D( rng ) );
+    float lightPmf = lightAliasTable[ lightIndex ].probability;
+    if ( lightIndex == lightCount )
+    {
+        float lightBVHPmf;
+        lightIndex = LightBVH_Sample( lightBVHNodes, p, GetNextSample1D( rng ), lightBVHPmf );
+        if ( lightIndex == LIGHT_INDEX_INVALID )
+        {
+            result.radiance = 0.f;
+            result.wi = float3( 0.f, 0.f, 1.f );
+            result.pdf = 0.f;
+            result.distance = 0.f;
+            result.isDeltaLight = false;
+            return result;
+        }
+        lightPmf *= lightBVHPmf;
+    }
     SLight light = lights[ lightIndex ];
 
     result.isDeltaLight = false;
@@ -160,10 +197,11 @@ SLightSampleResult SampleLightDirect( float3 p
     }
     else if ( light.flags & LIGHT_FLAGS_MESH_LIGHT )
     {
-        // Uniformly select one triangle
-        float triangleSelectionSample = GetNextSample1D( rng );
+        // Select one triangle proportionally to its area
+        uint aliasTableOffset = Light_GetTriangleAliasTableOffset( light );
+        uint localTriangleIndex = AliasTable_Sample( triangleAliasTable, aliasTableOffset, Light_GetTriangleCount( light ), GetNextSample2D( rng ) );
         float2 triangleSample = GetNextSample2D( rng );
-        uint triangleIndex = Light_GetTriangleOffset( light ) + floor( triangleSelectionSample * Light_GetTriangleCount( light ) );
+        uint triangleIndex = Light_GetTriangleOffset( light ) + localTriangleIndex;
 
         float3 v0 = vertices[ triangles[ triangleIndex * 3 ] ].position;
         float3 v1 = vertices[ triangles[ triangleIndex * 3 + 1 ] ].position;
@@ -171,15 +209,17 @@ SLightSampleResult SampleLightDirect( float3 p
         float4x3 instanceTransform = instanceTransforms[ Light_GetInstanceIndex( light ) ];
         TriangleLight_Sample( light, instanceTransform, v0, v1, v2, triangleSample, p, result.radiance, result.wi, result.distance, result.pdf );
 
-        result.pdf /= Light_GetTriangleCount( light );
+        result.pdf *= triangleAliasTable[ aliasTableOffset + localTriangleIndex ].probability;
     }
     else if ( light.flags & LIGHT_FLAGS_ENVIRONMENT_LIGHT )
     {
-        float2 samples = GetNextSample2D( rng );
-        EnvironmentLight_Sample( light, samples, envTexture, envTextureSampler, result.radiance, result.wi, result.distance, result.pdf );
+        float4 samples;
+        samples.xy = GetNextSample2D( rng );
+        samples.zw = GetNextSample2D( rng );
+        EnvironmentLight_Sample( light, samples, envTexture, envTextureSampler, envDistribution, result.radiance, result.wi, result.distance, result.pdf );
     }
 
-    result.pdf /= lightCount;
+    result.pdf *= lightPmf;
 
     if ( result.distance != FLT_INF )
     {
@@ -188,18 +228,23 @@ SLightSampleResult SampleLightDirect( float3 p
     return result;
 }
 
-void EvaluateLightDirect( uint lightIndex
+void EvaluateLightDirect( float3 p
+    , uint lightIndex
     , uint triangleIndex
     , float3 normal
     , float3 wi
     , float distance
     , StructuredBuffer<SLight> lights
+    , StructuredBuffer<SAliasTableEntry> lightAliasTable
     , uint lightCount
+    , StructuredBuffer<SLightBVHNode> lightBVHNodes
     , StructuredBuffer<Vertex> vertices
     , StructuredBuffer<uint> triangles
     , StructuredBuffer<float4x3> instanceTransforms
+    , StructuredBuffer<SAliasTableEntry> triangleAliasTable
     , TextureCube<float3> envTexture
     , SamplerState envTextureSampler
+    , StructuredBuffer<SAliasTableEntry> envDistribution
     , out float3 radiance
     , out float pdf )
 {
@@ -213,13 +258,20 @@ void EvaluateLightDirect( uint lightIndex
         float3 v1 = vertices[ triangles[ triangleIndex * 3 + 1 ] ].position;
         float3 v2 = vertices[ triangles[ triangleIndex * 3 + 2 ] ].position;
         float4x3 instanceTransform = instanceTransforms[ Light_GetInstanceIndex( light ) ];
-        TriangleLight_EvaluateWithPDF( light, instanceTransform, v0, v1, v2, wi, normal, distance, radiance, pdf );
-        pdf /= Light_GetTriangleCount( light );
+        TriangleLight_EvaluateWithPDF( light, instanceTransform, v0, v1, v2, p, wi, normal, distance, radiance, pdf );
+        pdf *= triangleAliasTable[ Light_GetTriangleAliasTableOffset( light ) + triangleIndex - Light_GetTriangleOffset( light ) ].probability;
     }
     else if ( light.flags & LIGHT_FLAGS_ENVIRONMENT_LIGHT )
     {
-        EnvironmentLight_EvaluateWithPDF( light, wi, envTexture, envTextureSampler, radiance, pdf );
+        EnvironmentLight_EvaluateWithPDF( light, wi, envTexture, envTextureSampler, envDistribution, radiance, pdf );
     }
     
-    pdf /= lightCount;
+    if ( light.flags & ( LIGHT_FLAGS_ENVIRONMENT_LIGHT | LIGHT_FLAGS_DIRECTIONAL_LIGHT ) )
+    {
+        pdf *= lightAliasTable[ lightIndex ].probability;
+    }
+    else
+    {
+        pdf *= lightAliasTable[ lightCount ].probability * LightBVH_PMF( lightBVHNodes, p, Light_GetLightBVHBitTrail( light ) );
+    }
 }
\ No newline at end of file
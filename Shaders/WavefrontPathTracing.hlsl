@@ -22,6 +22,8 @@ struct SPathAccumulation
     float bsdfPdf;
     float3 Li;
     bool isDeltaBxdf;
+    float3 shadingPosition;
+    float coneWidth;
 };
 
 void UnpackPathFlags( uint flags, out bool isIdle, out bool hasShadowRayHit, out bool shouldTerminate, out uint bounce )
@@ -77,7 +79,7 @@ Buffer<uint> g_InstanceMaterialOverrides            : register( t8 );
 StructuredBuffer<uint> g_MaterialIds                : register( t9 );
 StructuredBuffer<Material> g_Materials              : register( t10 );
 Buffer<float> g_OpacitySamples                      : register( t11 );
-Texture2D<float4> g_Textures[]                      : register( t18 );
+Texture2D<float4> g_Textures[]                      : register( t22 );
 RWStructuredBuffer<SRayHit> g_RayHits               : register( u0 );
 
 [numthreads( 32, 1, 1 )]
@@ -135,7 +137,7 @@ Buffer<uint> g_InstanceMaterialOverrides            : register( t8 );
 StructuredBuffer<uint> g_MaterialIds                : register( t9 );
 StructuredBuffer<Material> g_Materials              : register( t10 );
 Buffer<float> g_OpacitySamples                      : register( t11 );
-Texture2D<float4> g_Textures[]                      : register( t18 );
+Texture2D<float4> g_Textures[]                      : register( t22 );
 RWBuffer<uint> g_Flags                              : register( u0 );
 
 [numthreads( 32, 1, 1 )]
@@ -261,6 +263,8 @@ cbuffer MaterialConstants : register( b0 )
     uint g_LightCount;
     uint g_MaxBounceCount;
     uint g_EnvironmentLightIndex;
+    uint g_RussianRouletteBounceCount;
+    float g_PixelSpreadAngle;
 }
 
 Buffer<uint> g_PathIndices                              : register( t0 );
@@ -281,7 +285,11 @@ Texture2DArray<float> g_BRDFDielectricAvgTexture        : register( t14 );
 Texture2DArray<float> g_BSDFTexture                     : register( t15 );
 Texture2DArray<float> g_BSDFAvgTexture                  : register( t16 );
 TextureCube<float3> g_EnvTexture                        : register( t17 );
-Texture2D<float4> g_Textures[]                          : register( t18 );
+StructuredBuffer<SAliasTableEntry> g_EnvDistribution    : register( t18 );
+StructuredBuffer<SAliasTableEntry> g_LightAliasTable    : register( t19 );
+StructuredBuffer<SAliasTableEntry> g_TriangleAliasTable : register( t20 );
+StructuredBuffer<SLightBVHNode> g_LightBVHNodes         : register( t21 );
+Texture2D<float4> g_Textures[]                          : register( t22 );
 
 RWStructuredBuffer<SRay> g_Rays                         : register( u0 );
 RWStructuredBuffer<SRay> g_ShadowRays                   : register( u1 );
@@ -319,11 +327,11 @@ void main( uint threadId : SV_DispatchThreadID, uint gtid : SV_GroupThreadID )
     SRay ray = g_Rays[ pathIndex ];
     float3 origin = ray.origin;
     float3 direction = ray.direction;
+    SPathAccumulation pathAccumulation = g_PathAccumulation[ pathIndex ];
     Intersection intersection;
-    HitInfoToIntersection( origin, direction, hitInfo, g_Vertices, g_Triangles, g_MaterialIds, g_Materials, g_InstanceTransforms, g_InstanceLightIndices, g_InstanceMaterialOverrides, g_Textures, UVWrapSampler, intersection );
+    HitInfoToIntersection( origin, direction, hitInfo, pathAccumulation.coneWidth, g_PixelSpreadAngle, g_Vertices, g_Triangles, g_MaterialIds, g_Materials, g_InstanceTransforms, g_InstanceLightIndices, g_InstanceMaterialOverrides, g_Textures, UVWrapSampler, intersection );
 
     Xoshiro128StarStar rng = g_Rngs[ pathIndex ];
-    SPathAccumulation pathAccumulation = g_PathAccumulation[ pathIndex ];
 
     uint pathFlags = g_Flags[pathIndex];
     uint bounce = PathFlags_GetBounce(pathFlags);
@@ -337,9 +345,11 @@ void main( uint threadId : SV_DispatchThreadID, uint gtid : SV_GroupThreadID )
         if ( bounce > 0 && lightIndex != LIGHT_INDEX_INVALID )
 #endif
         {
+            // The light pdf is evaluated from the previous shading position rather than the offset ray origin, same as the megakernel
+            float3 shadingPosition = bounce > 0 ? pathAccumulation.shadingPosition : origin;
             float3 radiance;
             float lightPdf;
-            EvaluateLightDirect( lightIndex, intersection.triangleIndex, intersection.geometryNormal, direction, hitInfo.t, g_Lights, g_LightCount, g_Vertices, g_Triangles, g_InstanceTransforms, g_EnvTexture, UVClampSampler, radiance, lightPdf );
+            EvaluateLightDirect( shadingPosition, lightIndex, intersection.triangleIndex, intersection.geometryNormal, direction, hitInfo.t, g_Lights, g_LightAliasTable, g_LightCount, g_LightBVHNodes, g_Vertices, g_Triangles, g_InstanceTransforms, g_TriangleAliasTable, g_EnvTexture, UVClampSampler, g_EnvDistribution, radiance, lightPdf );
             if ( lightPdf > 0.0f )
             {
                 float weight = !pathAccumulation.isDeltaBxdf ? PowerHeuristic( 1, pathAccumulation.bsdfPdf, 1, lightPdf ) : 1.0f;
@@ -364,7 +374,7 @@ void main( uint threadId : SV_DispatchThreadID, uint gtid : SV_GroupThreadID )
         // Sample light
         if ( g_LightCount != 0 )
         {
-            SLightSampleResult sampleResult = SampleLightDirect( intersection.position, g_Lights, g_LightCount, g_Vertices, g_Triangles, g_InstanceTransforms, g_EnvTexture, UVClampSampler, rng );
+            SLightSampleResult sampleResult = SampleLightDirect( intersection.position, g_Lights, g_LightAliasTable, g_LightCount, g_LightBVHNodes, g_Vertices, g_Triangles, g_InstanceTransforms, g_TriangleAliasTable, g_EnvTexture, UVClampSampler, g_EnvDistribution, rng );
             bool isDeltaLight = sampleResult.isDeltaLight;
             if ( any( sampleResult.radiance > 0.0f ) && sampleResult.pdf > 0.0f )
             {
@@ -396,17 +406,34 @@ void main( uint threadId : SV_DispatchThreadID, uint gtid : SV_GroupThreadID )
             float3 bsdf;
             SampleBSDF( wo, bsdfSample, bsdfSelectionSample, intersection, wi, bsdf, bsdfPdf, isDeltaBxdf );
 
-            if ( any( bsdf != 0.0f ) && bsdfPdf != 0.0f )
+            bool isTerminated = all( bsdf == 0.0f ) || bsdfPdf == 0.0f;
+            if ( !isTerminated )
             {
                 float NdotWI = abs( dot( intersection.normal, wi ) );
                 pathAccumulation.pathThroughput = pathAccumulation.pathThroughput * bsdf * NdotWI / bsdfPdf;
 
+                if ( bounce >= g_RussianRouletteBounceCount )
+                {
+                    float survivalProbability = RussianRouletteSurvivalProbability( pathAccumulation.pathThroughput );
+                    isTerminated = GetNextSample1D( rng ) >= survivalProbability;
+                    if ( !isTerminated )
+                    {
+                        pathAccumulation.pathThroughput /= survivalProbability;
+                    }
+                }
+            }
+
+            if ( !isTerminated )
+            {
                 ray.direction = wi;
                 ray.origin = OffsetRayOrigin( intersection.position, intersection.geometryNormal, wi );
                 ray.tMin = 0.0f;
                 ray.tMax = FLT_INF;
                 g_Rays[ pathIndex ] = ray;
 
+                pathAccumulation.shadingPosition = intersection.position;
+                pathAccumulation.coneWidth += g_PixelSpreadAngle * hitInfo.t;
+
                 pathFlags = PathFlags_SetBounce( pathFlags, bounce + 1 );
             }
             else
@@ -593,6 +620,8 @@ void main( uint threadId : SV_DispatchThreadID, uint gtid : SV_GroupThreadID )
                 pathAccumulation.pathThroughput = 1.0f;
                 pathAccumulation.bsdfPdf = 0.f;
                 pathAccumulation.isDeltaBxdf = true;
+                pathAccumulation.shadingPosition = 0.0f;
+                pathAccumulation.coneWidth = 0.0f;
                 g_PathAccumulation[ threadId ] = pathAccumulation;
                 g_NewPathQueue[ rayIndexBase + rayIndexOffset ] = threadId;
                 isIdle = false;
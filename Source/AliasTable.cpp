@@ -0,0 +1,188 @@
+#include "stdafx.h"
+#include "AliasTable.h"
+#include "Logging.h"
+
+bool BuildAliasTable( const float* weights, uint32_t count, std::vector<GPU::SAliasTableEntry>* outTable )
+{
+    double weightSum = 0.0;
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        if ( weights[ i ] > 0.f && std::isfinite( weights[ i ] ) )
+        {
+            weightSum += weights[ i ];
+        }
+    }
+    if ( !( weightSum > 0.0 ) )
+    {
+        return false;
+    }
+
+    const size_t tableOffset = outTable->size();
+    outTable->resize( tableOffset + count );
+    GPU::SAliasTableEntry* table = outTable->data() + tableOffset;
+
+    // Probabilities scaled by the entry count, entries below one donate the rest of their slot to an entry above one
+    std::vector<double> scaledProbabilities( count );
+    std::vector<uint32_t> smallIndices;
+    std::vector<uint32_t> largeIndices;
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        const double probability = weights[ i ] > 0.f && std::isfinite( weights[ i ] ) ? weights[ i ] / weightSum : 0.0;
+        table[ i ].probability = (float)probability;
+        table[ i ].alias = i;
+        scaledProbabilities[ i ] = probability * count;
+        if ( scaledProbabilities[ i ] < 1.0 )
+        {
+            smallIndices.push_back( i );
+        }
+        else
+        {
+            largeIndices.push_back( i );
+        }
+    }
+
+    while ( !smallIndices.empty() && !largeIndices.empty() )
+    {
+        const uint32_t smallIndex = smallIndices.back();
+        smallIndices.pop_back();
+        const uint32_t largeIndex = largeIndices.back();
+
+        table[ smallIndex ].threshold = (float)scaledProbabilities[ smallIndex ];
+        table[ smallIndex ].alias = largeIndex;
+
+        scaledProbabilities[ largeIndex ] -= 1.0 - scaledProbabilities[ smallIndex ];
+        if ( scaledProbabilities[ largeIndex ] < 1.0 )
+        {
+            largeIndices.pop_back();
+            smallIndices.push_back( largeIndex );
+        }
+    }
+
+    // Whatever is left is one up to rounding errors
+    for ( uint32_t index : smallIndices )
+    {
+        table[ index ].threshold = 1.f;
+        table[ index ].alias = index;
+    }
+    for ( uint32_t index : largeIndices )
+    {
+        table[ index ].threshold = 1.f;
+        table[ index ].alias = index;
+    }
+
+    return true;
+}
+
+uint32_t SampleAliasTable( const GPU::SAliasTableEntry* table, uint32_t count, float sample0, float sample1 )
+{
+    const uint32_t index = std::min( (uint32_t)( sample0 * count ), count - 1 );
+    return sample1 < table[ index ].threshold ? index : table[ index ].alias;
+}
+
+static bool ValidateTable( const char* name, const std::vector<float>& weights )
+{
+    std::vector<GPU::SAliasTableEntry> table;
+    if ( !BuildAliasTable( weights.data(), (uint32_t)weights.size(), &table ) )
+    {
+        LOG_STRING_FORMAT( "%s: failed to build the alias table, FAILED\n", name );
+        return false;
+    }
+
+    const uint32_t count = (uint32_t)table.size();
+    auto isZero = [ &weights ]( uint32_t index ) { return !( weights[ index ] > 0.f && std::isfinite( weights[ index ] ) ); };
+    bool isValid = true;
+
+    // Probabilities must sum to one and zero weights must never be reachable, neither directly nor as an alias
+    {
+        double probabilitySum = 0.0;
+        uint32_t reachableZeroCount = 0;
+        for ( uint32_t i = 0; i < count; ++i )
+        {
+            probabilitySum += table[ i ].probability;
+            if ( isZero( i ) && table[ i ].threshold > 0.f )
+            {
+                ++reachableZeroCount;
+            }
+            if ( table[ i ].threshold < 1.f && isZero( table[ i ].alias ) )
+            {
+                ++reachableZeroCount;
+            }
+        }
+        const bool passed = fabs( probabilitySum - 1.0 ) < 1e-5 && reachableZeroCount == 0;
+        LOG_STRING_FORMAT( "%s: probability sum %.6f, %u reachable zero weights, %s\n", name, probabilitySum, reachableZeroCount, passed ? "passed" : "FAILED" );
+        isValid &= passed;
+    }
+
+    // Chi-square test of the histogram of samples, entries expecting too few samples are pooled into one bin
+    {
+        const uint32_t sampleCount = 1 << 22;
+        std::mt19937 rng( 0x5EED );
+        auto nextSample = [ &rng ]() { return ( rng() >> 8 ) / float( 1 << 24 ); };
+
+        std::vector<uint32_t> histogram( count, 0 );
+        for ( uint32_t i = 0; i < sampleCount; ++i )
+        {
+            const float sample0 = nextSample();
+            const float sample1 = nextSample();
+            ++histogram[ SampleAliasTable( table.data(), count, sample0, sample1 ) ];
+        }
+
+        double chiSquare = 0.0;
+        uint32_t binCount = 0;
+        double pooledExpected = 0.0;
+        double pooledObserved = 0.0;
+        uint32_t zeroSampledCount = 0;
+        for ( uint32_t i = 0; i < count; ++i )
+        {
+            if ( isZero( i ) )
+            {
+                zeroSampledCount += histogram[ i ];
+                continue;
+            }
+            const double expected = (double)table[ i ].probability * sampleCount;
+            if ( expected < 5.0 )
+            {
+                pooledExpected += expected;
+                pooledObserved += histogram[ i ];
+                continue;
+            }
+            chiSquare += ( histogram[ i ] - expected ) * ( histogram[ i ] - expected ) / expected;
+            ++binCount;
+        }
+        if ( pooledExpected >= 5.0 )
+        {
+            chiSquare += ( pooledObserved - pooledExpected ) * ( pooledObserved - pooledExpected ) / pooledExpected;
+            ++binCount;
+        }
+        // About 5 standard deviations above the mean of the chi-square distribution
+        const double degreesOfFreedom = binCount > 1 ? binCount - 1.0 : 1.0;
+        const double threshold = degreesOfFreedom + 5.0 * sqrt( 2.0 * degreesOfFreedom );
+        const bool passed = chiSquare <= threshold && zeroSampledCount == 0;
+        LOG_STRING_FORMAT( "%s: histogram chi-square %.1f over %u bins, threshold %.1f, %u samples of zero weights, %s\n", name, chiSquare, binCount, threshold, zeroSampledCount, passed ? "passed" : "FAILED" );
+        isValid &= passed;
+    }
+
+    return isValid;
+}
+
+bool ValidateAliasTable()
+{
+    bool isValid = true;
+
+    isValid &= ValidateTable( "Single entry", { 3.f } );
+    isValid &= ValidateTable( "Uniform", std::vector<float>( 100, 1.f ) );
+
+    // Weights spanning six orders of magnitude with zero, negative and non-finite entries in between, like a point light next to
+    // a dim emissive triangle and a black one
+    std::vector<float> weights;
+    std::mt19937 rng( 0xA11A5 );
+    for ( uint32_t i = 0; i < 1000; ++i )
+    {
+        const uint32_t kind = rng() % 16;
+        weights.emplace_back( kind == 0 ? 0.f : kind == 1 ? -1.f : kind == 2 ? std::numeric_limits<float>::infinity() : powf( 10.f, ( rng() % 6000 ) / 1000.f ) );
+    }
+    isValid &= ValidateTable( "Mixed magnitudes", weights );
+
+    LOG_STRING_FORMAT( "Alias table validation %s.\n", isValid ? "passed" : "FAILED" );
+    return isValid;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "../Shaders/AliasTableSharedDef.inc.hlsl"
+
+// Builds a Walker alias table with Vose's method and appends it to outTable, entry i is then selected with a probability proportional
+// to weights[ i ] in constant time. Negative and non-finite weights count as zero. Returns false and appends nothing when no weight is positive.
+bool BuildAliasTable( const float* weights, uint32_t count, std::vector<GPU::SAliasTableEntry>* outTable );
+
+// Same as AliasTable_Sample in the shaders
+uint32_t SampleAliasTable( const GPU::SAliasTableEntry* table, uint32_t count, float sample0, float sample1 );
+
+// Checks that probabilities sum to one, that zero weights are never sampled and that the histogram of samples follows the weights.
+// Logs the results and returns false on failure.
+bool ValidateAliasTable();
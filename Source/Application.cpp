@@ -3,6 +3,21 @@
 #include "Application.h"
 #include "DirectComputeRayTracing.h"
 #include "CommandLineArgs.h"
+#include "Logging.h"
+#include "Texture.h"
+#include "TextureCompression.h"
+#include "TextureCache.h"
+#include "TextureMipGeneration.h"
+#include "ImageWriting.h"
+#include "Scene.h"
+#include "AliasTable.h"
+#include "EnvironmentLightDistribution.h"
+#include "LightBVH.h"
+#include "SphericalTriangle.h"
+#include "RussianRoulette.h"
+#include "CPUBSDFs.h"
+#include "BatchRender.h"
+#include "TraversalBenchmark.h"
 
 #define MAX_LOADSTRING 100
 
@@ -87,6 +102,88 @@ int APIENTRY wWinMain( _In_ HINSTANCE hInstance,
     CommandLineArgs cmdlnArgs;
     cmdlnArgs.Parse( lpCmdLine );
 
+    CLoggingThread loggingThread;
+    if ( !cmdlnArgs.GetLogFilename().empty() )
+    {
+        EnableLogToFile( std::filesystem::u8path( cmdlnArgs.GetLogFilename() ) );
+    }
+
+    if ( cmdlnArgs.GetLogBenchmark() )
+    {
+        RunLoggingBenchmark();
+        return 0;
+    }
+
+    if ( !cmdlnArgs.GetTextureDecodingBenchmarkDirectory().empty() )
+    {
+        RunTextureDecodingBenchmark( cmdlnArgs.GetTextureDecodingBenchmarkDirectory() );
+        return 0;
+    }
+
+    if ( !cmdlnArgs.GetTextureCompressionBenchmarkDirectory().empty() )
+    {
+        RunTextureCompressionBenchmark( cmdlnArgs.GetTextureCompressionBenchmarkDirectory() );
+        return 0;
+    }
+
+    if ( !cmdlnArgs.GetImageWritingBenchmarkDirectory().empty() )
+    {
+        // A 16K render, the size where a second full copy of the image used to hurt
+        RunImageWritingBenchmark( cmdlnArgs.GetImageWritingBenchmarkDirectory(), 16384 );
+        return 0;
+    }
+
+    if ( !cmdlnArgs.GetMeshLoadingBenchmarkOBJFilename().empty() )
+    {
+        RunMeshLoadingBenchmark( std::filesystem::u8path( cmdlnArgs.GetMeshLoadingBenchmarkOBJFilename() ), std::filesystem::u8path( cmdlnArgs.GetMeshLoadingBenchmarkPLYFilename() ) );
+        return 0;
+    }
+
+    if ( cmdlnArgs.GetXMLParsingBenchmarkShapeCount() != 0 )
+    {
+        RunXMLParsingBenchmark( cmdlnArgs.GetXMLParsingBenchmarkShapeCount() );
+        return 0;
+    }
+
+    if ( cmdlnArgs.GetValidateLightSampling() )
+    {
+        bool isValid = ValidateAliasTable();
+        isValid &= ValidateEnvironmentLightSampling();
+        isValid &= ValidateLightBVHSampling();
+        isValid &= ValidateTriangleLightSampling();
+        return isValid ? 0 : 1;
+    }
+
+    if ( cmdlnArgs.GetValidateRussianRoulette() )
+    {
+        return ValidateRussianRoulette() ? 0 : 1;
+    }
+
+    if ( cmdlnArgs.GetValidateBSDFs() )
+    {
+        return ValidateBSDFs() ? 0 : 1;
+    }
+
+    if ( cmdlnArgs.GetValidateMipGeneration() )
+    {
+        return ValidateMipGeneration() ? 0 : 1;
+    }
+
+    if ( cmdlnArgs.GetTextureCacheEnabled() )
+    {
+        TextureCache::Initialize( std::filesystem::u8path( cmdlnArgs.GetTextureCacheDirectory() ), cmdlnArgs.GetTextureCacheSizeLimit() );
+    }
+
+    if ( !cmdlnArgs.GetTraversalBenchmarkFilename().empty() )
+    {
+        return RunTraversalBenchmark( cmdlnArgs.GetTraversalBenchmarkFilename() ) ? 0 : 1;
+    }
+
+    if ( cmdlnArgs.IsBatchRenderEnabled() )
+    {
+        return RunBatchRender() ? 0 : 1;
+    }
+
     SetProcessDpiAwarenessContext( DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2 );
 
     LoadStringW( hInstance, IDS_APP_TITLE, szTitle, MAX_LOADSTRING );
@@ -0,0 +1,225 @@
+#include "stdafx.h"
+#include "BatchRender.h"
+#include "CommandLineArgs.h"
+#include "DirectComputeRayTracing.h"
+#include "CPUPathTracer.h"
+#include "Scene.h"
+#include "D3D12Adapter.h"
+#include "D3D12Resource.h"
+#include "ImageWriting.h"
+#include "Logging.h"
+#include "Timers.h"
+
+// Used when neither a sample count nor a time limit is given
+static const uint32_t s_DefaultBatchSampleCount = 64;
+
+struct SBatchTarget
+{
+    bool IsReached( uint32_t sampleCount, float elapsedSeconds ) const
+    {
+        return ( m_SampleCount > 0 && sampleCount >= m_SampleCount ) || ( m_TimeLimit > 0.f && elapsedSeconds >= m_TimeLimit );
+    }
+
+    uint32_t m_SampleCount;
+    float m_TimeLimit;
+};
+
+static const char* GetBatchIntegratorName( EBatchIntegrator integrator )
+{
+    switch ( integrator )
+    {
+    case EBatchIntegrator::Megakernel:
+        return "megakernel";
+    case EBatchIntegrator::Wavefront:
+        return "wavefront";
+    default:
+        return "CPU";
+    }
+}
+
+static bool FlushCommandList()
+{
+    ID3D12GraphicsCommandList* commandList = D3D12Adapter::GetCommandList();
+    if ( FAILED( commandList->Close() ) )
+    {
+        return false;
+    }
+    ID3D12CommandList* commandLists[] = { commandList };
+    D3D12Adapter::GetCommandQueue()->ExecuteCommandLists( 1, commandLists );
+    return D3D12Adapter::WaitForGPU();
+}
+
+CScene* LoadSceneWithoutWindow( float* loadSeconds )
+{
+    // Loading still creates the GPU resources of the scene, the WARP device keeps that working in containers without a GPU
+    if ( !D3D12Adapter::Init( NULL, true ) )
+    {
+        LOG_STRING( "Failed to create the WARP device for loading the scene.\n" );
+        D3D12Adapter::Destroy();
+        return nullptr;
+    }
+    CD3D12Resource::CreateDeferredDeleteQueue();
+
+    CScene* scene = new CScene();
+
+    Timer loadTimer;
+    loadTimer.Start();
+    scene->Reset();
+    const bool isSceneLoaded = scene->LoadFromFile( CommandLineArgs::Singleton()->GetFilename() ) && FlushCommandList();
+    if ( loadSeconds )
+    {
+        *loadSeconds = loadTimer.GetElapsedSecondsFloat().count();
+    }
+
+    if ( !isSceneLoaded )
+    {
+        DestroySceneWithoutWindow( scene );
+        return nullptr;
+    }
+    return scene;
+}
+
+void DestroySceneWithoutWindow( CScene* scene )
+{
+    delete scene;
+    CD3D12Resource::FlushDeleteAll();
+    D3D12Adapter::Destroy();
+}
+
+static bool RunCPUBatchRender( const SBatchTarget& target )
+{
+    const CommandLineArgs* args = CommandLineArgs::Singleton();
+
+    float loadSeconds = 0.f;
+    CScene* scene = LoadSceneWithoutWindow( &loadSeconds );
+    if ( !scene )
+    {
+        return false;
+    }
+
+    bool result = false;
+    CCPUPathTracer* pathTracer = new CCPUPathTracer();
+    if ( pathTracer->Create( scene ) )
+    {
+        // After the first sample the chunks are sized to what is left of the time limit, at the measured speed
+        Timer renderTimer;
+        renderTimer.Start();
+        uint32_t sampleCount = 0;
+        float elapsedSeconds = 0.f;
+        while ( !target.IsReached( sampleCount, elapsedSeconds ) )
+        {
+            uint32_t chunkSampleCount = target.m_SampleCount > 0 ? target.m_SampleCount - sampleCount : UINT32_MAX;
+            if ( target.m_TimeLimit > 0.f )
+            {
+                const float secondsPerSample = sampleCount > 0 ? elapsedSeconds / sampleCount : 0.f;
+                const float fittingSampleCount = secondsPerSample > 0.f ? ( target.m_TimeLimit - elapsedSeconds ) / secondsPerSample : 1.f;
+                chunkSampleCount = std::min( chunkSampleCount, (uint32_t)std::clamp( fittingSampleCount, 1.f, 65536.f ) );
+            }
+
+            pathTracer->Render( chunkSampleCount, sampleCount, args->GetBatchThreadCount() );
+            sampleCount += chunkSampleCount;
+            elapsedSeconds = renderTimer.GetElapsedSecondsFloat().count();
+        }
+
+        Timer writeTimer;
+        writeTimer.Start();
+        result = pathTracer->WriteFilmToFile( args->GetBatchOutputFilename() );
+        const float writeSeconds = writeTimer.GetElapsedSecondsFloat().count();
+
+        const float renderSeconds = pathTracer->GetRenderSeconds();
+        const float pixelCount = (float)pathTracer->GetResolutionWidth() * pathTracer->GetResolutionHeight();
+        LOG_STRING_FORMAT( "Batch render with the CPU integrator: %u samples per pixel at %ux%u, scene loaded in %.2fs, rendered in %.2fs, written in %.2fs, "
+            "%.2f Mrays/s, %.2f Msamples/s.\n", sampleCount, pathTracer->GetResolutionWidth(), pathTracer->GetResolutionHeight(), loadSeconds, renderSeconds, writeSeconds,
+            renderSeconds > 0.f ? pathTracer->GetRayCount() / renderSeconds * 1e-6f : 0.f, renderSeconds > 0.f ? pixelCount * sampleCount / renderSeconds * 1e-6f : 0.f );
+    }
+
+    delete pathTracer;
+    DestroySceneWithoutWindow( scene );
+
+    return result;
+}
+
+static bool RunGPUBatchRender( const SBatchTarget& target )
+{
+    const CommandLineArgs* args = CommandLineArgs::Singleton();
+
+    bool result = false;
+    CDirectComputeRayTracing* rayTracing = new CDirectComputeRayTracing( NULL );
+    rayTracing->m_ActivePathTracerIndex = args->GetBatchIntegrator() == EBatchIntegrator::Wavefront ? 1 : 0;
+    rayTracing->m_IsSmallResolutionEnabled = false;
+
+    Timer loadTimer;
+    loadTimer.Start();
+    const bool isInitialized = rayTracing->Init();
+    const float loadSeconds = loadTimer.GetElapsedSecondsFloat().count();
+
+    if ( isInitialized && rayTracing->m_Scene->m_HasValidScene )
+    {
+        // Frames are queued ahead of the GPU, the time limit is checked against the submission and the film readback waits for the rest
+        Timer renderTimer;
+        renderTimer.Start();
+        while ( !target.IsReached( rayTracing->m_SPP, renderTimer.GetElapsedSecondsFloat().count() ) )
+        {
+            rayTracing->RenderOneFrameWithoutWindow();
+        }
+
+        Timer writeTimer;
+        writeTimer.Start();
+        result = rayTracing->SaveFilmToFile( std::filesystem::path( args->GetBatchOutputFilename() ).c_str() );
+        const float writeSeconds = writeTimer.GetElapsedSecondsFloat().count();
+        const float renderSeconds = renderTimer.GetElapsedSecondsFloat().count() - writeSeconds;
+
+        const uint32_t sampleCount = rayTracing->m_SPP;
+        const float pixelCount = (float)rayTracing->m_Scene->m_ResolutionWidth * rayTracing->m_Scene->m_ResolutionHeight;
+        LOG_STRING_FORMAT( "Batch render with the %s integrator: %u samples per pixel at %ux%u, scene loaded in %.2fs, rendered in %.2fs, written in %.2fs, "
+            "%.2f Msamples/s.\n", GetBatchIntegratorName( args->GetBatchIntegrator() ), sampleCount, rayTracing->m_Scene->m_ResolutionWidth, rayTracing->m_Scene->m_ResolutionHeight,
+            loadSeconds, renderSeconds, writeSeconds, renderSeconds > 0.f ? pixelCount * sampleCount / renderSeconds * 1e-6f : 0.f );
+    }
+
+    delete rayTracing;
+
+    return result;
+}
+
+bool RunBatchRender()
+{
+    EnableLogToStandardOutput();
+
+    const CommandLineArgs* args = CommandLineArgs::Singleton();
+    if ( args->GetFilename().empty() )
+    {
+        LOG_STRING( "Batch render requires a scene file.\n" );
+        return false;
+    }
+
+    if ( args->GetBatchIntegrator() == EBatchIntegrator::Unknown )
+    {
+        LOG_ERROR_FORMAT( "Unknown batch integrator \'%s\', expected CPU, Megakernel or Wavefront.\n", args->GetUnknownBatchIntegratorName().c_str() );
+        return false;
+    }
+
+    EImageFileFormat fileFormat;
+    if ( !GetImageFileFormatFromExtension( std::filesystem::path( args->GetBatchOutputFilename() ), &fileFormat ) )
+    {
+        LOG_STRING_FORMAT( "Unknown image file extension of batch output %s.\n", args->GetBatchOutputFilename().c_str() );
+        return false;
+    }
+
+    SBatchTarget target;
+    target.m_SampleCount = args->GetBatchSampleCount();
+    target.m_TimeLimit = args->GetBatchTimeLimit();
+    if ( target.m_SampleCount == 0 && target.m_TimeLimit <= 0.f )
+    {
+        target.m_SampleCount = s_DefaultBatchSampleCount;
+    }
+
+    LOG_STRING_FORMAT( "Batch rendering %s with the %s integrator to %s.\n", args->GetFilename().c_str(), GetBatchIntegratorName( args->GetBatchIntegrator() ),
+        args->GetBatchOutputFilename().c_str() );
+
+    const bool result = args->GetBatchIntegrator() == EBatchIntegrator::CPU ? RunCPUBatchRender( target ) : RunGPUBatchRender( target );
+    if ( !result )
+    {
+        LOG_STRING( "Batch render failed.\n" );
+    }
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+
+class CScene;
+
+// Renders the scene of the command line without a window until the sample count or the time limit of the command line is reached, whichever
+// comes first, and writes the film to the output file. Logs the timings to the standard output. Returns false on failure.
+bool RunBatchRender();
+
+// Loads the scene of the command line on a WARP device created without a window, for tools that only read the CPU side of the scene. Returns
+// nullptr on failure. The scene and the device are destroyed together with DestroySceneWithoutWindow.
+CScene* LoadSceneWithoutWindow( float* loadSeconds = nullptr );
+
+void DestroySceneWithoutWindow( CScene* scene );
\ No newline at end of file
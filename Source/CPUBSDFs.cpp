@@ -0,0 +1,1451 @@
+#include "stdafx.h"
+#include "CPUBSDFs.h"
+#include "ParallelFor.h"
+#include "Logging.h"
+#include "Timers.h"
+#include "../Shaders/BxDFTextureDef.inc.hlsl"
+#include "../Shaders/Material.inc.hlsl"
+#include "../Shaders/InternalScatteringMode.inc.hlsl"
+
+using namespace DirectX;
+
+#define ALPHA_THRESHOLD 0.00052441f
+
+static const float s_Pi = 3.14159265359f;
+static const float s_InvPi = 1.f / s_Pi;
+
+static float Dot( FXMVECTOR a, FXMVECTOR b )
+{
+    return XMVectorGetX( XMVector3Dot( a, b ) );
+}
+
+static float SafeSqrt( float value )
+{
+    return sqrtf( std::max( 0.f, value ) );
+}
+
+static float Saturate( float value )
+{
+    return std::clamp( value, 0.f, 1.f );
+}
+
+//
+// Tables
+//
+
+static const float s_TableEtaStart = 1.f;
+static const float s_TableEtaEnd = 3.f;
+
+// Same as SampleTextureArrayLinear in the shaders for one slice, texel centers are at u * ( width - 1 ) and the coordinates are clamped to the edges
+static float SampleTableSlice( const float* slice, uint32_t width, uint32_t height, float u, float v )
+{
+    const float x = std::clamp( u, 0.f, 1.f ) * ( width - 1 );
+    const float y = std::clamp( v, 0.f, 1.f ) * ( height - 1 );
+    const uint32_t x0 = std::min( (uint32_t)x, width - 1 );
+    const uint32_t y0 = std::min( (uint32_t)y, height - 1 );
+    const uint32_t x1 = std::min( x0 + 1, width - 1 );
+    const uint32_t y1 = std::min( y0 + 1, height - 1 );
+    const float fx = x - x0;
+    const float fy = y - y0;
+    const float value0 = slice[ y0 * width + x0 ] * ( 1.f - fx ) + slice[ y0 * width + x1 ] * fx;
+    const float value1 = slice[ y1 * width + x0 ] * ( 1.f - fx ) + slice[ y1 * width + x1 ] * fx;
+    return value0 * ( 1.f - fy ) + value1 * fy;
+}
+
+static float SampleTableArray( const std::vector<float>& table, uint32_t width, uint32_t height, uint32_t depth, float u, float v, float w, uint32_t sliceOffset )
+{
+    // Array indices are clamped by the sampler
+    const uint32_t sliceCount = (uint32_t)( table.size() / ( (size_t)width * height ) );
+    const float slicePos = w * ( depth - 1.f );
+    const float fraction = slicePos - floorf( slicePos );
+    const uint32_t slice0 = (uint32_t)std::clamp( (int32_t)slicePos + (int32_t)sliceOffset, 0, (int32_t)sliceCount - 1 );
+    const uint32_t slice1 = (uint32_t)std::clamp( (int32_t)slicePos + 1 + (int32_t)sliceOffset, 0, (int32_t)sliceCount - 1 );
+    const float value0 = SampleTableSlice( table.data() + (size_t)slice0 * width * height, width, height, u, v );
+    const float value1 = SampleTableSlice( table.data() + (size_t)slice1 * width * height, width, height, u, v );
+    return value0 + ( value1 - value0 ) * fraction;
+}
+
+float SBxDFTables::SampleBRDF( float cosThetaO, float alpha ) const
+{
+    return SampleTableSlice( m_BRDF.data(), BXDFTEX_BRDF_SIZE_X, BXDFTEX_BRDF_SIZE_Y, cosThetaO, alpha );
+}
+
+float SBxDFTables::SampleBRDFAverage( float alpha ) const
+{
+    return SampleTableSlice( m_BRDFAverage.data(), BXDFTEX_BRDF_SIZE_Y, 1, alpha, 0.f );
+}
+
+float SBxDFTables::SampleBRDFDielectric( float cosThetaO, float alpha, float eta, bool isEntering ) const
+{
+    return SampleTableArray( m_BRDFDielectric, BXDFTEX_BRDF_DIELECTRIC_SIZE_X, BXDFTEX_BRDF_DIELECTRIC_SIZE_Y, BXDFTEX_BRDF_DIELECTRIC_SIZE_Z,
+        cosThetaO, alpha, ( eta - 1.f ) / 2.f, isEntering ? BXDFTEX_BRDF_DIELECTRIC_SIZE_Z : 0 );
+}
+
+float SBxDFTables::SampleBRDFDielectricAverage( float alpha, float eta, bool isEntering ) const
+{
+    return SampleTableArray( m_BRDFDielectricAverage, BXDFTEX_BRDF_DIELECTRIC_SIZE_Y, BXDFTEX_BRDF_DIELECTRIC_SIZE_Z, 1, alpha, ( eta - 1.f ) / 2.f, 0.f, isEntering ? 1 : 0 );
+}
+
+float SBxDFTables::SampleBSDF( float cosThetaO, float alpha, float eta, bool isEntering ) const
+{
+    return SampleTableArray( m_BSDF, BXDFTEX_BRDF_DIELECTRIC_SIZE_X, BXDFTEX_BRDF_DIELECTRIC_SIZE_Y, BXDFTEX_BRDF_DIELECTRIC_SIZE_Z,
+        cosThetaO, alpha, ( eta - 1.f ) / 2.f, isEntering ? BXDFTEX_BRDF_DIELECTRIC_SIZE_Z : 0 );
+}
+
+float SBxDFTables::SampleBSDFAverage( float alpha, float eta, bool isEntering ) const
+{
+    return SampleTableArray( m_BSDFAverage, BXDFTEX_BRDF_DIELECTRIC_SIZE_Y, BXDFTEX_BRDF_DIELECTRIC_SIZE_Z, 1, alpha, ( eta - 1.f ) / 2.f, 0.f, isEntering ? 1 : 0 );
+}
+
+//
+// Lighting context
+//
+
+struct SLightingContext
+{
+    XMVECTOR m_H;
+    float m_WOdotH;
+    bool m_IsInverted;
+};
+
+static void XM_CALLCONV LightingContextCalculateH( FXMVECTOR wo, FXMVECTOR wi, SLightingContext* lightingContext )
+{
+    const XMVECTOR H = wi + wo;
+    lightingContext->m_H = XMVector3Equal( H, XMVectorZero() ) ? XMVectorZero() : XMVector3Normalize( H );
+    lightingContext->m_WOdotH = Dot( lightingContext->m_H, wo );
+}
+
+static void XM_CALLCONV LightingContextAssignH( FXMVECTOR wo, FXMVECTOR H, SLightingContext* lightingContext )
+{
+    lightingContext->m_H = H;
+    lightingContext->m_WOdotH = Dot( H, wo );
+}
+
+static SLightingContext XM_CALLCONV LightingContextInit( FXMVECTOR wo, FXMVECTOR wi, bool isInverted )
+{
+    SLightingContext context = {};
+    LightingContextCalculateH( wo, wi, &context );
+    context.m_IsInverted = isInverted;
+    return context;
+}
+
+static SLightingContext LightingContextInit( bool isInverted )
+{
+    SLightingContext context = {};
+    context.m_H = XMVectorZero();
+    context.m_IsInverted = isInverted;
+    return context;
+}
+
+//
+// Sampling
+//
+
+XMFLOAT2 ConcentricSampleDisk( const XMFLOAT2& sample )
+{
+    const float sx = 2.f * sample.x - 1.f;
+    const float sy = 2.f * sample.y - 1.f;
+    if ( sx == 0.f && sy == 0.f )
+    {
+        return XMFLOAT2( 0.f, 0.f );
+    }
+
+    float r, theta;
+    if ( sx >= -sy )
+    {
+        if ( sx > sy )
+        {
+            r = sx;
+            theta = sy > 0.f ? sy / r : 8.f + sy / r;
+        }
+        else
+        {
+            r = sy;
+            theta = 2.f - sx / r;
+        }
+    }
+    else
+    {
+        if ( sx <= sy )
+        {
+            r = -sx;
+            theta = 4.f - sy / r;
+        }
+        else
+        {
+            r = -sy;
+            theta = 6.f + sx / r;
+        }
+    }
+    theta *= s_Pi / 4.f;
+    return XMFLOAT2( r * cosf( theta ), r * sinf( theta ) );
+}
+
+static XMVECTOR ConsineSampleHemisphere( const XMFLOAT2& sample )
+{
+    const XMFLOAT2 disk = ConcentricSampleDisk( sample );
+    return XMVectorSet( disk.x, disk.y, sqrtf( std::max( 0.f, 1.f - disk.x * disk.x - disk.y * disk.y ) ), 0.f );
+}
+
+//
+// Fresnel
+//
+
+static float FresnelDielectric( float cosThetaI, float etaO, float etaI )
+{
+    cosThetaI = std::clamp( cosThetaI, -1.f, 1.f );
+    if ( cosThetaI < 0.f )
+    {
+        std::swap( etaO, etaI );
+        cosThetaI = -cosThetaI;
+    }
+
+    const float sinThetaI = sqrtf( 1.f - cosThetaI * cosThetaI );
+    const float sinThetaT = etaO / etaI * sinThetaI;
+    if ( sinThetaT >= 1.f )
+    {
+        return 1.f;
+    }
+    const float cosThetaT = sqrtf( 1.f - sinThetaT * sinThetaT );
+    const float Rparl = ( ( etaI * cosThetaI ) - ( etaO * cosThetaT ) ) / ( ( etaI * cosThetaI ) + ( etaO * cosThetaT ) );
+    const float Rperp = ( ( etaO * cosThetaI ) - ( etaI * cosThetaT ) ) / ( ( etaO * cosThetaI ) + ( etaI * cosThetaT ) );
+    return ( Rparl * Rparl + Rperp * Rperp ) * .5f;
+}
+
+// One channel of FresnelConductor in the shaders
+static float FresnelConductor( float cosThetaI, float etaO, float etaI, float k )
+{
+    cosThetaI = std::clamp( cosThetaI, -1.f, 1.f );
+    const float eta = etaI / etaO;
+    const float etak = k / etaO;
+
+    const float cosThetaI2 = cosThetaI * cosThetaI;
+    const float sinThetaI2 = 1.f - cosThetaI2;
+    const float eta2 = eta * eta;
+    const float etak2 = etak * etak;
+
+    const float t0 = eta2 - etak2 - sinThetaI2;
+    const float a2plusb2 = SafeSqrt( t0 * t0 + 4.f * eta2 * etak2 );
+    const float t1 = a2plusb2 + cosThetaI2;
+    const float a = SafeSqrt( .5f * ( a2plusb2 + t0 ) );
+    const float t2 = 2.f * cosThetaI * a;
+    const float Rs = ( t1 - t2 ) / ( t1 + t2 );
+
+    const float t3 = cosThetaI2 * a2plusb2 + sinThetaI2 * sinThetaI2;
+    const float t4 = t2 * sinThetaI2;
+    const float Rp = Rs * ( t3 - t4 ) / ( t3 + t4 );
+
+    return .5f * ( Rp + Rs );
+}
+
+static XMVECTOR FresnelConductor( float cosThetaI, const XMFLOAT3& etaI, const XMFLOAT3& k )
+{
+    return XMVectorSet( FresnelConductor( cosThetaI, 1.f, etaI.x, k.x ), FresnelConductor( cosThetaI, 1.f, etaI.y, k.y ), FresnelConductor( cosThetaI, 1.f, etaI.z, k.z ), 0.f );
+}
+
+//
+// GGX
+//
+
+static float XM_CALLCONV EvaluateGGXGeometricShadowingOneDirection( float alpha2, FXMVECTOR m, FXMVECTOR w )
+{
+    // Can't see backfacing microfacet normal from the front and vice versa
+    const float wz = XMVectorGetZ( w );
+    if ( Dot( w, m ) * wz <= 0.f )
+    {
+        return 0.f;
+    }
+
+    const float NdotW = fabsf( wz );
+    const float denominator = sqrtf( alpha2 + ( 1.f - alpha2 ) * NdotW * NdotW ) + NdotW;
+    return 2.f * NdotW / denominator;
+}
+
+static float XM_CALLCONV EvaluateGGXGeometricShadowing( FXMVECTOR wi, FXMVECTOR wo, FXMVECTOR m, float alpha )
+{
+    const float alpha2 = alpha * alpha;
+    return EvaluateGGXGeometricShadowingOneDirection( alpha2, m, wi ) * EvaluateGGXGeometricShadowingOneDirection( alpha2, m, wo );
+}
+
+static XMVECTOR SampleGGXNDF( const XMFLOAT2& sample, float alpha )
+{
+    const float theta = atanf( alpha * sqrtf( sample.x / ( 1.f - sample.x ) ) );
+    const float phi = 2.f * s_Pi * sample.y;
+    const float s = sinf( theta );
+    return XMVectorSet( cosf( phi ) * s, sinf( phi ) * s, cosf( theta ), 0.f );
+}
+
+// From "Sampling the GGX Distribution of Visible Normals" by Eric Heitz
+static XMVECTOR XM_CALLCONV SampleGGXVNDF( FXMVECTOR wo, const XMFLOAT2& sample, float alpha )
+{
+    const XMVECTOR Vh = XMVector3Normalize( XMVectorSet( alpha * XMVectorGetX( wo ), alpha * XMVectorGetY( wo ), XMVectorGetZ( wo ), 0.f ) );
+    const float VhX = XMVectorGetX( Vh );
+    const float VhY = XMVectorGetY( Vh );
+    const float VhZ = XMVectorGetZ( Vh );
+    const float lensq = VhX * VhX + VhY * VhY;
+    const XMVECTOR T1 = lensq > 0.f ? XMVectorSet( -VhY, VhX, 0.f, 0.f ) / sqrtf( lensq ) : XMVectorSet( 1.f, 0.f, 0.f, 0.f );
+    const XMVECTOR T2 = XMVector3Cross( Vh, T1 );
+    const float r = sqrtf( sample.x );
+    const float phi = 2.f * s_Pi * sample.y;
+    const float t1 = r * cosf( phi );
+    float t2 = r * sinf( phi );
+    const float s = .5f * ( 1.f + VhZ );
+    t2 = ( 1.f - s ) * sqrtf( 1.f - t1 * t1 ) + s * t2;
+    const XMVECTOR Nh = T1 * t1 + T2 * t2 + Vh * sqrtf( std::max( 0.f, 1.f - t1 * t1 - t2 * t2 ) );
+    return XMVector3Normalize( XMVectorSet( alpha * XMVectorGetX( Nh ), alpha * XMVectorGetY( Nh ), std::max( 0.f, XMVectorGetZ( Nh ) ), 0.f ) );
+}
+
+static float XM_CALLCONV EvaluateGGXMicrofacetDistribution( FXMVECTOR m, float alpha )
+{
+    const float alpha2 = alpha * alpha;
+    const float NdotM = XMVectorGetZ( m );
+    const float factor = NdotM * NdotM * ( alpha2 - 1.f ) + 1.f;
+    return alpha2 / ( factor * factor * s_Pi );
+}
+
+static float XM_CALLCONV EvaluateGGXMicrofacetDistributionPdf( FXMVECTOR wo, FXMVECTOR m, float alpha, bool sampleVNDF )
+{
+    if ( sampleVNDF )
+    {
+        return EvaluateGGXMicrofacetDistribution( m, alpha ) * EvaluateGGXGeometricShadowingOneDirection( alpha * alpha, m, wo ) * std::max( 0.f, Dot( wo, m ) ) / XMVectorGetZ( wo );
+    }
+    return EvaluateGGXMicrofacetDistribution( m, alpha ) * fabsf( XMVectorGetZ( m ) );
+}
+
+static XMVECTOR XM_CALLCONV SampleGGXMicrofacetDistribution( FXMVECTOR wo, const XMFLOAT2& sample, float alpha, bool sampleVNDF )
+{
+    return sampleVNDF ? SampleGGXVNDF( wo, sample, alpha ) : SampleGGXNDF( sample, alpha );
+}
+
+//
+// Cook-Torrance microfacet BRDF
+//
+
+static float XM_CALLCONV EvaluateCookTorranceMircofacetBRDF( FXMVECTOR wi, FXMVECTOR wo, float alpha, const SLightingContext& lightingContext )
+{
+    const float WIdotN = XMVectorGetZ( wi );
+    const float WOdotN = XMVectorGetZ( wo );
+    if ( WIdotN <= 0.f || WOdotN <= 0.f || lightingContext.m_WOdotH <= 0.f )
+    {
+        return 0.f;
+    }
+
+    const XMVECTOR m = lightingContext.m_H;
+    if ( XMVector3Equal( m, XMVectorZero() ) )
+    {
+        return 0.f;
+    }
+
+    return EvaluateGGXMicrofacetDistribution( m, alpha ) * EvaluateGGXGeometricShadowing( wi, wo, m, alpha ) / ( 4.f * WIdotN * WOdotN );
+}
+
+static float XM_CALLCONV EvaluateCookTorranceMicrofacetBRDFPdf( FXMVECTOR wi, FXMVECTOR wo, float alpha, const SLightingContext& lightingContext, bool sampleVNDF )
+{
+    const float WOdotM = lightingContext.m_WOdotH;
+    if ( XMVectorGetZ( wi ) <= 0.f || XMVectorGetZ( wo ) <= 0.f || WOdotM <= 0.f )
+    {
+        return 0.f;
+    }
+
+    return EvaluateGGXMicrofacetDistributionPdf( wo, lightingContext.m_H, alpha, sampleVNDF ) / ( 4.f * WOdotM );
+}
+
+static XMVECTOR XM_CALLCONV SampleCookTorranceMicrofacetBRDF( FXMVECTOR wo, const XMFLOAT2& sample, float alpha, bool sampleVNDF, SLightingContext* lightingContext )
+{
+    const XMVECTOR m = SampleGGXMicrofacetDistribution( wo, sample, alpha, sampleVNDF );
+    LightingContextAssignH( wo, m, lightingContext );
+    return -XMVector3Reflect( wo, m );
+}
+
+//
+// Cook-Torrance microfacet BSDF, without the refraction scale factor when the tables are integrated
+//
+
+static float XM_CALLCONV EvaluateCookTorranceMicrofacetBSDF( FXMVECTOR wi, FXMVECTOR wo, float alpha, float etaO, float etaI, bool hasRefractionScaleFactor )
+{
+    const float WIdotN = XMVectorGetZ( wi );
+    const float WOdotN = XMVectorGetZ( wo );
+    const bool active = WOdotN != 0.f && WIdotN != 0.f;
+    const bool reflect = WIdotN * WOdotN > 0.f;
+
+    XMVECTOR m = XMVector3Normalize( wo * ( reflect ? 1.f : etaO ) + wi * ( reflect ? 1.f : etaI ) );
+    m = XMVectorGetZ( m ) < 0.f ? -m : m;
+
+    const float WIdotM = Dot( wi, m );
+    const float WOdotM = Dot( wo, m );
+
+    const float D = EvaluateGGXMicrofacetDistribution( m, alpha );
+    const float F = FresnelDielectric( WOdotM, etaO, etaI );
+    const float G = EvaluateGGXGeometricShadowing( wi, wo, m, alpha );
+
+    if ( reflect )
+    {
+        return active ? F * D * G / ( 4.f * fabsf( WIdotN ) * fabsf( WOdotN ) ) : 0.f;
+    }
+
+    const float sqrtDenom = etaO * WOdotM + etaI * WIdotM;
+    const float scale = hasRefractionScaleFactor ? etaO * etaO : etaI * etaI;
+    const float value = ( 1.f - F ) * fabsf( D * G * fabsf( WIdotM ) * fabsf( WOdotM ) * scale / ( WOdotN * WIdotN * sqrtDenom * sqrtDenom ) );
+    return active ? value : 0.f;
+}
+
+static float XM_CALLCONV EvaluateCookTorranceMicrofacetBSDFPdf( FXMVECTOR wi, FXMVECTOR wo, float alpha, float etaO, float etaI, bool sampleVNDF )
+{
+    const float WIdotN = XMVectorGetZ( wi );
+    const float WOdotN = XMVectorGetZ( wo );
+    bool active = WOdotN != 0.f && WIdotN != 0.f;
+    const bool reflect = WIdotN * WOdotN > 0.f;
+
+    XMVECTOR m = XMVector3Normalize( wo * ( reflect ? 1.f : etaO ) + wi * ( reflect ? 1.f : etaI ) );
+    m = XMVectorGetZ( m ) < 0.f ? -m : m;
+
+    const float WIdotM = Dot( wi, m );
+    const float WOdotM = Dot( wo, m );
+
+    // Can't see backfacing microfacet normal from the front and vice versa
+    active = active && ( WIdotM * WIdotN > 0.f && WOdotM * WOdotN > 0.f );
+
+    const float sqrtDenom = etaO * WOdotM + etaI * WIdotM;
+    const float dwh_dwi = reflect ? 1.f / ( 4.f * WIdotM ) : fabsf( ( etaI * etaI * WIdotM ) / ( sqrtDenom * sqrtDenom ) );
+    const float pdf = EvaluateGGXMicrofacetDistributionPdf( wo, m, alpha, sampleVNDF );
+    const float F = FresnelDielectric( WOdotM, etaO, etaI );
+    return active ? pdf * ( reflect ? F : 1.f - F ) * dwh_dwi : 0.f;
+}
+
+static XMVECTOR XM_CALLCONV SampleCookTorranceMicrofacetBSDF( FXMVECTOR wo, float selectionSample, const XMFLOAT2& bxdfSample, float alpha, float etaO, float etaI, bool sampleVNDF,
+    SLightingContext* lightingContext )
+{
+    if ( XMVectorGetZ( wo ) == 0.f )
+    {
+        return XMVectorZero();
+    }
+
+    if ( etaO == etaI )
+    {
+        return -wo;
+    }
+
+    const XMVECTOR m = SampleGGXMicrofacetDistribution( wo, bxdfSample, alpha, sampleVNDF );
+    const float WOdotM = Dot( wo, m );
+    lightingContext->m_H = m;
+    lightingContext->m_WOdotH = WOdotM;
+    if ( WOdotM <= 0.f )
+    {
+        return XMVectorZero();
+    }
+
+    const float F = FresnelDielectric( WOdotM, etaO, etaI );
+    return selectionSample < F ? -XMVector3Reflect( wo, m ) : XMVector3Refract( -wo, m, etaO / etaI );
+}
+
+//
+// Lambert BRDF
+//
+
+static float XM_CALLCONV EvaluateLambertBRDF( FXMVECTOR wi, FXMVECTOR wo )
+{
+    return XMVectorGetZ( wi ) > 0.f && XMVectorGetZ( wo ) > 0.f ? s_InvPi : 0.f;
+}
+
+static float XM_CALLCONV EvaluateLambertBRDFPdf( FXMVECTOR wi, FXMVECTOR wo )
+{
+    return XMVectorGetZ( wi ) > 0.f && XMVectorGetZ( wo ) > 0.f ? XMVectorGetZ( wi ) * s_InvPi : 0.f;
+}
+
+//
+// Specular BxDFs, value and pdf are only written when a direction is sampled
+//
+
+static XMVECTOR XM_CALLCONV SampleSpecularBRDF( FXMVECTOR wo, float* value, float* pdf, SLightingContext* lightingContext )
+{
+    const float WOdotN = XMVectorGetZ( wo );
+    const XMVECTOR wi = XMVectorSet( -XMVectorGetX( wo ), -XMVectorGetY( wo ), WOdotN, 0.f );
+    lightingContext->m_H = g_XMIdentityR2;
+    lightingContext->m_WOdotH = WOdotN;
+    if ( WOdotN > 0.f )
+    {
+        *value = 1.f / WOdotN;
+        *pdf = 1.f;
+    }
+    return wi;
+}
+
+static XMVECTOR XM_CALLCONV SampleSpecularBSDF( FXMVECTOR wo, float sample, float etaO, float etaI, bool isThin, bool hasRefractionScaleFactor, float* value, float* pdf,
+    SLightingContext* lightingContext )
+{
+    const float WOdotN = XMVectorGetZ( wo );
+    lightingContext->m_H = g_XMIdentityR2;
+    lightingContext->m_WOdotH = WOdotN;
+
+    if ( etaO == etaI )
+    {
+        *value = 1.f / WOdotN;
+        *pdf = 1.f;
+        return -wo;
+    }
+
+    if ( WOdotN == 0.f )
+    {
+        return XMVectorZero();
+    }
+
+    float F = FresnelDielectric( WOdotN, etaO, etaI );
+    float T = 1.f - F;
+    if ( isThin && F < 1.f )
+    {
+        F += T * T * F / ( 1.f - F * F );
+        T = 1.f - F;
+    }
+
+    if ( sample < F )
+    {
+        *value = F / WOdotN;
+        *pdf = F;
+        return XMVectorSet( -XMVectorGetX( wo ), -XMVectorGetY( wo ), WOdotN, 0.f );
+    }
+
+    const XMVECTOR wi = !isThin ? XMVector3Refract( -wo, g_XMIdentityR2, etaO / etaI ) : -wo;
+    const float WIdotN = XMVectorGetZ( wi );
+    if ( WIdotN == 0.f )
+    {
+        return wi;
+    }
+
+    *value = T * ( hasRefractionScaleFactor && !isThin ? ( etaO * etaO ) / ( etaI * etaI ) : 1.f ) / ( -WIdotN );
+    *pdf = T;
+    return wi;
+}
+
+//
+// Kulla-Conty multiscattering
+//
+
+static float MultiscatteringFavgDielectric( float eta )
+{
+    const float eta2 = eta * eta;
+    return eta >= 1.f
+        ? ( eta - 1.f ) / ( 4.08567f + 1.00071f * eta )
+        : 0.997118f + 0.1014f * eta - 0.965241f * eta2 - 0.130607f * eta2 * eta;
+}
+
+// Approximation for the hemispherical albedo of a smooth conductor ( Hitchikers Guide to Multiple Scattering ), Eq.(12.9)
+static float MultiscatteringFavgConductor( float eta, float k )
+{
+    const float numerator = eta * ( 133.736f - 98.9833f * eta ) + k * ( eta * ( 59.5617f - 3.98288f * eta ) - 182.37f ) + ( ( 0.30818f * eta - 13.1093f ) * eta - 62.5919f ) * k * k - 8.21474f;
+    const float denominator = k * ( eta * ( 94.6517f - 15.8558f * eta ) - 187.166f ) + ( -78.476f * eta - 395.268f ) * eta + ( eta * ( eta - 15.4387f ) - 62.0752f ) * k * k;
+    return Saturate( numerator / denominator );
+}
+
+static float MultiscatteringFresnel( float Eavg, float Favg )
+{
+    return Favg * Favg * Eavg / ( 1.f - Favg * ( 1.f - Eavg ) );
+}
+
+static XMVECTOR MultiscatteringFresnel( float Eavg, const XMFLOAT3& Favg )
+{
+    return XMVectorSet( MultiscatteringFresnel( Eavg, Favg.x ), MultiscatteringFresnel( Eavg, Favg.y ), MultiscatteringFresnel( Eavg, Favg.z ), 0.f );
+}
+
+static float MultiscatteringBxDF( float Ei, float Eo, float Eavg )
+{
+    return Eavg < 1.f ? ( 1.f - Ei ) * ( 1.f - Eo ) / ( s_Pi * ( 1.f - Eavg ) ) : 0.f;
+}
+
+static float XM_CALLCONV EvaluateCookTorranceMultiscatteringBSDF( FXMVECTOR wi, float alpha, float ratio, float eta, float Eo, float Eavg, float Eavg_inv, bool isEntering,
+    const SBxDFTables& tables )
+{
+    const float cosThetaI = fabsf( XMVectorGetZ( wi ) );
+    if ( cosThetaI == 0.f )
+    {
+        return 0.f;
+    }
+
+    const bool evaluateReflection = XMVectorGetZ( wi ) > 0.f;
+    const float Ei = tables.SampleBSDF( cosThetaI, alpha, eta, evaluateReflection ? isEntering : !isEntering );
+    const float factor = evaluateReflection ? ( 1.f - ratio ) : ratio;
+    return MultiscatteringBxDF( Ei, Eo, evaluateReflection ? Eavg : Eavg_inv ) * factor;
+}
+
+static float XM_CALLCONV EvaluateCookTorranceMultiscatteringBSDFPdf( FXMVECTOR wi, float ratio )
+{
+    const float cosThetaI = fabsf( XMVectorGetZ( wi ) );
+    if ( cosThetaI == 0.f )
+    {
+        return 0.f;
+    }
+    return cosThetaI * s_InvPi * ( XMVectorGetZ( wi ) > 0.f ? 1.f - ratio : ratio );
+}
+
+static XMVECTOR XM_CALLCONV SampleCookTorranceMultiscatteringBSDF( FXMVECTOR wo, float selectionSample, const XMFLOAT2& bxdfSample, float ratio )
+{
+    if ( XMVectorGetZ( wo ) == 0.f )
+    {
+        return XMVectorZero();
+    }
+
+    XMVECTOR wi = ConsineSampleHemisphere( bxdfSample );
+    if ( selectionSample < ratio )
+    {
+        wi = XMVectorSetZ( wi, -XMVectorGetZ( wi ) );
+    }
+    return wi;
+}
+
+static float ReciprocalFactor( float F_avg_leave, float F_avg_enter, float E_avg_leave, float E_avg_enter, float eta )
+{
+    const float inv_eta = 1.f / eta;
+    const float factor = ( 1.f - F_avg_leave ) * ( 1.f - E_avg_leave );
+    const float factor1 = ( 1.f - F_avg_enter ) * ( 1.f - E_avg_enter ) * inv_eta * inv_eta;
+    return factor1 / std::max( 0.00001f, factor + factor1 );
+}
+
+static XMVECTOR XM_CALLCONV EvaluateCookTorranceMultiscatteringBRDF( FXMVECTOR wi, FXMVECTOR wo, float alpha, float Eo, float Eavg, FXMVECTOR factor, const SBxDFTables& tables )
+{
+    const float cosThetaO = XMVectorGetZ( wo );
+    const float cosThetaI = XMVectorGetZ( wi );
+    if ( cosThetaO <= 0.f || cosThetaI <= 0.f )
+    {
+        return XMVectorZero();
+    }
+
+    const float Ei = tables.SampleBRDF( cosThetaI, alpha );
+    return factor * MultiscatteringBxDF( Ei, Eo, Eavg );
+}
+
+static float XM_CALLCONV EvaluateCookTorranceMultiscatteringBRDFPdf( FXMVECTOR wi, FXMVECTOR wo )
+{
+    if ( XMVectorGetZ( wo ) <= 0.f || XMVectorGetZ( wi ) <= 0.f )
+    {
+        return 0.f;
+    }
+    return XMVectorGetZ( wi ) * s_InvPi;
+}
+
+//
+// BSDF
+//
+
+static float SpecularWeight( float cosTheta, float alpha, float ior, bool isEntering, const SBxDFTables& tables )
+{
+    return tables.SampleBRDFDielectric( cosTheta, alpha, ior, isEntering );
+}
+
+static XMVECTOR CalculateInternalScatteringFactor( float alpha, const XMFLOAT3& albedo, float ior, uint32_t mode, const SBxDFTables& tables )
+{
+    if ( mode == INTERNAL_SCATTERING_MODE_IGNORE )
+    {
+        return g_XMOne;
+    }
+
+    const float averageInternalReflectance = tables.SampleBRDFDielectricAverage( alpha, ior, true );
+    XMVECTOR factor = XMVectorReplicate( 1.f - averageInternalReflectance );
+    if ( mode == INTERNAL_SCATTERING_MODE_MULTIPLE )
+    {
+        factor /= g_XMOne - XMLoadFloat3( &albedo ) * averageInternalReflectance;
+    }
+    return factor;
+}
+
+struct STangentFrame
+{
+    XMVECTOR m_Tangent;
+    XMVECTOR m_Binormal;
+    XMVECTOR m_Normal;
+};
+
+static STangentFrame CreateTangentFrame( const SIntersection& intersection )
+{
+    STangentFrame frame;
+    frame.m_Normal = XMLoadFloat3( &intersection.m_Normal );
+    frame.m_Tangent = XMLoadFloat3( &intersection.m_Tangent );
+    frame.m_Binormal = XMVector3Cross( frame.m_Normal, frame.m_Tangent );
+    return frame;
+}
+
+static XMVECTOR XM_CALLCONV WorldToTangent( FXMVECTOR v, const STangentFrame& frame )
+{
+    return XMVectorSet( Dot( v, frame.m_Tangent ), Dot( v, frame.m_Binormal ), Dot( v, frame.m_Normal ), 0.f );
+}
+
+static XMVECTOR XM_CALLCONV TangentToWorld( FXMVECTOR v, const STangentFrame& frame )
+{
+    return frame.m_Tangent * XMVectorGetX( v ) + frame.m_Binormal * XMVectorGetY( v ) + frame.m_Normal * XMVectorGetZ( v );
+}
+
+static XMVECTOR XM_CALLCONV FlipZ( FXMVECTOR v )
+{
+    return XMVectorSetZ( v, -XMVectorGetZ( v ) );
+}
+
+XMVECTOR XM_CALLCONV EvaluateBSDF( FXMVECTOR worldWi, FXMVECTOR worldWo, const SIntersection& intersection, const SBxDFTables& tables, bool sampleGGXVNDF )
+{
+    const STangentFrame frame = CreateTangentFrame( intersection );
+    XMVECTOR wo = WorldToTangent( worldWo, frame );
+    XMVECTOR wi = WorldToTangent( worldWi, frame );
+
+    const bool isInverted = XMVectorGetZ( wo ) < 0.f;
+    if ( isInverted )
+    {
+        wo = FlipZ( wo );
+        wi = FlipZ( wi );
+    }
+
+    const float cosThetaO = XMVectorGetZ( wo );
+    const SLightingContext lightingContext = LightingContextInit( wo, wi, isInverted );
+    const bool perfectSmooth = intersection.m_Alpha < ALPHA_THRESHOLD;
+    const float alpha = intersection.m_Alpha;
+    const float ior = intersection.m_IOR.x;
+
+    XMVECTOR value = XMVectorZero();
+
+    if ( intersection.m_MaterialType != MATERIAL_TYPE_DIELECTRIC && intersection.m_MaterialType != MATERIAL_TYPE_THIN_DIELECTRIC )
+    {
+        bool hasLambertBrdf = false;
+        bool hasCookTorranceBrdf = false;
+        bool hasCookTorranceMultiscatteringBrdf = false;
+        bool dielectricFresnel = false;
+        float ratio_lambertBrdf = 0.f;
+        float E = 0.f;
+        float E_avg = 0.f;
+        XMVECTOR F_ms = XMVectorZero();
+        XMVECTOR internalScatteringFactor = g_XMOne;
+
+        const bool hasAnyBrdf = !isInverted || intersection.m_IsTwoSided;
+
+        if ( intersection.m_Multiscattering && ( intersection.m_MaterialType == MATERIAL_TYPE_PLASTIC || intersection.m_MaterialType == MATERIAL_TYPE_CONDUCTOR ) && hasAnyBrdf && !perfectSmooth )
+        {
+            E = tables.SampleBRDF( cosThetaO, alpha );
+            E_avg = tables.SampleBRDFAverage( alpha );
+        }
+
+        if ( intersection.m_MaterialType == MATERIAL_TYPE_DIFFUSE && hasAnyBrdf )
+        {
+            hasLambertBrdf = true;
+            ratio_lambertBrdf = 1.f;
+        }
+        else if ( intersection.m_MaterialType == MATERIAL_TYPE_PLASTIC && hasAnyBrdf )
+        {
+            hasLambertBrdf = true;
+            hasCookTorranceBrdf = !perfectSmooth;
+            hasCookTorranceMultiscatteringBrdf = intersection.m_Multiscattering && !perfectSmooth;
+            dielectricFresnel = true;
+
+            ratio_lambertBrdf = 1.f - SpecularWeight( cosThetaO, alpha, ior, false, tables );
+            if ( hasCookTorranceMultiscatteringBrdf )
+            {
+                const float F_avg = MultiscatteringFavgDielectric( ior );
+                const float scalarF_ms = MultiscatteringFresnel( E_avg, F_avg );
+                F_ms = XMVectorReplicate( scalarF_ms );
+                ratio_lambertBrdf = std::max( ratio_lambertBrdf - scalarF_ms * ( 1.f - E ), 0.f );
+            }
+
+            internalScatteringFactor = CalculateInternalScatteringFactor( alpha, intersection.m_Albedo, ior, intersection.m_InternalScatteringMode, tables );
+        }
+        else if ( intersection.m_MaterialType == MATERIAL_TYPE_CONDUCTOR && hasAnyBrdf && !perfectSmooth )
+        {
+            hasCookTorranceBrdf = true;
+            hasCookTorranceMultiscatteringBrdf = intersection.m_Multiscattering;
+            dielectricFresnel = false;
+
+            if ( hasCookTorranceMultiscatteringBrdf )
+            {
+                const XMFLOAT3& k = intersection.m_Albedo;
+                const XMFLOAT3 F_avg( MultiscatteringFavgConductor( intersection.m_IOR.x, k.x ), MultiscatteringFavgConductor( intersection.m_IOR.y, k.y ),
+                    MultiscatteringFavgConductor( intersection.m_IOR.z, k.z ) );
+                F_ms = MultiscatteringFresnel( E_avg, F_avg );
+            }
+        }
+
+        if ( hasLambertBrdf )
+        {
+            value += XMLoadFloat3( &intersection.m_Albedo ) * internalScatteringFactor * ( EvaluateLambertBRDF( wi, wo ) * ratio_lambertBrdf );
+        }
+        if ( hasCookTorranceBrdf )
+        {
+            const float brdfValue = EvaluateCookTorranceMircofacetBRDF( wi, wo, alpha, lightingContext );
+            const XMVECTOR F = dielectricFresnel ? XMVectorReplicate( FresnelDielectric( lightingContext.m_WOdotH, 1.f, ior ) )
+                : FresnelConductor( lightingContext.m_WOdotH, intersection.m_IOR, intersection.m_Albedo );
+            value += F * brdfValue;
+        }
+        if ( hasCookTorranceMultiscatteringBrdf )
+        {
+            value += EvaluateCookTorranceMultiscatteringBRDF( wi, wo, alpha, E, E_avg, F_ms, tables );
+        }
+    }
+    else if ( intersection.m_MaterialType != MATERIAL_TYPE_THIN_DIELECTRIC && !perfectSmooth )
+    {
+        const float etaO = isInverted ? ior : 1.f;
+        const float etaI = isInverted ? 1.f : ior;
+
+        float scalarValue = EvaluateCookTorranceMicrofacetBSDF( wi, wo, alpha, etaO, etaI, true );
+
+        if ( intersection.m_Multiscattering )
+        {
+            const float E_avg_enter = tables.SampleBSDFAverage( alpha, ior, true );
+            const float F_avg_enter = MultiscatteringFavgDielectric( 1.f / ior );
+            const float E_avg_leave = tables.SampleBSDFAverage( alpha, ior, false );
+            const float F_avg_leave = MultiscatteringFavgDielectric( ior );
+            const float reciprocalFactor = ReciprocalFactor( F_avg_leave, F_avg_enter, E_avg_leave, E_avg_enter, ior );
+
+            const float E = tables.SampleBSDF( cosThetaO, alpha, ior, isInverted );
+            const float F_avg = isInverted ? F_avg_enter : F_avg_leave;
+            const float E_avg = isInverted ? E_avg_enter : E_avg_leave;
+            const float E_inv_avg = isInverted ? E_avg_leave : E_avg_enter;
+            const float ratio = ( isInverted ? 1.f - reciprocalFactor : reciprocalFactor ) * ( 1.f - F_avg );
+
+            scalarValue += EvaluateCookTorranceMultiscatteringBSDF( wi, alpha, ratio, ior, E, E_avg, E_inv_avg, isInverted, tables );
+        }
+        value = XMVectorReplicate( scalarValue );
+    }
+
+    return value;
+}
+
+float XM_CALLCONV EvaluateBSDFPdf( FXMVECTOR worldWi, FXMVECTOR worldWo, const SIntersection& intersection, const SBxDFTables& tables, bool sampleGGXVNDF )
+{
+    const STangentFrame frame = CreateTangentFrame( intersection );
+    XMVECTOR wo = WorldToTangent( worldWo, frame );
+    XMVECTOR wi = WorldToTangent( worldWi, frame );
+
+    const bool isInverted = XMVectorGetZ( wo ) < 0.f;
+    if ( isInverted )
+    {
+        wo = FlipZ( wo );
+        wi = FlipZ( wi );
+    }
+
+    const float cosThetaO = XMVectorGetZ( wo );
+    const SLightingContext lightingContext = LightingContextInit( wo, wi, isInverted );
+    const bool perfectSmooth = intersection.m_Alpha < ALPHA_THRESHOLD;
+    const float alpha = intersection.m_Alpha;
+    const float ior = intersection.m_IOR.x;
+
+    float pdf = 0.f;
+
+    if ( intersection.m_MaterialType != MATERIAL_TYPE_DIELECTRIC && intersection.m_MaterialType != MATERIAL_TYPE_THIN_DIELECTRIC )
+    {
+        bool hasLambertBrdf = false;
+        bool hasCookTorranceBrdf = false;
+        bool hasCookTorranceMultiscatteringBrdf = false;
+        float weight_lambertBrdf = 0.f;
+        float weight_cookTorranceBrdf = 0.f;
+        float weight_cookTorranceMultiscatteringBrdf = 0.f;
+
+        const bool hasAnyBrdf = !isInverted || intersection.m_IsTwoSided;
+
+        if ( intersection.m_MaterialType == MATERIAL_TYPE_DIFFUSE && hasAnyBrdf )
+        {
+            hasLambertBrdf = true;
+            weight_lambertBrdf = 1.f;
+        }
+        else if ( intersection.m_MaterialType == MATERIAL_TYPE_PLASTIC && hasAnyBrdf )
+        {
+            hasLambertBrdf = true;
+            hasCookTorranceBrdf = !perfectSmooth;
+            hasCookTorranceMultiscatteringBrdf = intersection.m_Multiscattering && !perfectSmooth;
+
+            weight_cookTorranceBrdf = SpecularWeight( cosThetaO, alpha, ior, false, tables );
+            weight_lambertBrdf = 1.f - weight_cookTorranceBrdf;
+            if ( hasCookTorranceMultiscatteringBrdf )
+            {
+                const float E = tables.SampleBRDF( cosThetaO, alpha );
+                const float E_avg = tables.SampleBRDFAverage( alpha );
+                const float F_avg = MultiscatteringFavgDielectric( ior );
+                const float F_ms = MultiscatteringFresnel( E_avg, F_avg );
+                weight_cookTorranceMultiscatteringBrdf = F_ms * ( 1.f - E );
+                weight_lambertBrdf = std::max( weight_lambertBrdf - weight_cookTorranceMultiscatteringBrdf, 0.f );
+            }
+        }
+        else if ( intersection.m_MaterialType == MATERIAL_TYPE_CONDUCTOR && hasAnyBrdf && !perfectSmooth )
+        {
+            hasCookTorranceBrdf = true;
+            hasCookTorranceMultiscatteringBrdf = intersection.m_Multiscattering;
+
+            weight_cookTorranceBrdf = 1.f;
+            if ( hasCookTorranceMultiscatteringBrdf )
+            {
+                // Don't know the brdf energy for conductor, hence uniformly sample it.
+                weight_cookTorranceBrdf = .5f;
+                weight_cookTorranceMultiscatteringBrdf = .5f;
+            }
+        }
+
+        if ( hasLambertBrdf )
+        {
+            pdf += EvaluateLambertBRDFPdf( wi, wo ) * weight_lambertBrdf;
+        }
+        if ( hasCookTorranceBrdf )
+        {
+            pdf += EvaluateCookTorranceMicrofacetBRDFPdf( wi, wo, alpha, lightingContext, sampleGGXVNDF ) * weight_cookTorranceBrdf;
+        }
+        if ( hasCookTorranceMultiscatteringBrdf )
+        {
+            pdf += EvaluateCookTorranceMultiscatteringBRDFPdf( wi, wo ) * weight_cookTorranceMultiscatteringBrdf;
+        }
+    }
+    else if ( intersection.m_MaterialType != MATERIAL_TYPE_THIN_DIELECTRIC && !perfectSmooth )
+    {
+        float weight_cookTorranceBsdf = 1.f;
+        float weight_cookTorranceMultiscatteringBsdf = 0.f;
+        float ratio = 0.f;
+
+        const float etaO = isInverted ? ior : 1.f;
+        const float etaI = isInverted ? 1.f : ior;
+
+        if ( intersection.m_Multiscattering )
+        {
+            const float E_avg_enter = tables.SampleBSDFAverage( alpha, ior, true );
+            const float F_avg_enter = MultiscatteringFavgDielectric( 1.f / ior );
+            const float E_avg_leave = tables.SampleBSDFAverage( alpha, ior, false );
+            const float F_avg_leave = MultiscatteringFavgDielectric( ior );
+            const float reciprocalFactor = ReciprocalFactor( F_avg_leave, F_avg_enter, E_avg_leave, E_avg_enter, ior );
+
+            const float E = tables.SampleBSDF( cosThetaO, alpha, ior, isInverted );
+            const float F_avg = isInverted ? F_avg_enter : F_avg_leave;
+            ratio = ( isInverted ? 1.f - reciprocalFactor : reciprocalFactor ) * ( 1.f - F_avg );
+
+            weight_cookTorranceBsdf = E;
+            weight_cookTorranceMultiscatteringBsdf = 1.f - E;
+        }
+
+        pdf += EvaluateCookTorranceMicrofacetBSDFPdf( wi, wo, alpha, etaO, etaI, sampleGGXVNDF ) * weight_cookTorranceBsdf;
+
+        if ( intersection.m_Multiscattering )
+        {
+            pdf += EvaluateCookTorranceMultiscatteringBSDFPdf( wi, ratio ) * weight_cookTorranceMultiscatteringBsdf;
+        }
+    }
+
+    return pdf;
+}
+
+void XM_CALLCONV SampleBSDF( FXMVECTOR worldWo, const XMFLOAT2& BRDFSample, float BRDFSelectionSample, const SIntersection& intersection, const SBxDFTables& tables,
+    bool sampleGGXVNDF, XMVECTOR* outWi, XMVECTOR* outValue, float* outPdf, bool* outIsDeltaBxdf )
+{
+    XMVECTOR wi = XMVectorZero();
+    XMVECTOR value = XMVectorZero();
+    float pdf = 0.f;
+    bool isDeltaBxdf = false;
+
+    const STangentFrame frame = CreateTangentFrame( intersection );
+    XMVECTOR wo = WorldToTangent( worldWo, frame );
+
+    const bool isInverted = XMVectorGetZ( wo ) < 0.f;
+    if ( isInverted )
+    {
+        wo = FlipZ( wo );
+    }
+
+    const float cosThetaO = XMVectorGetZ( wo );
+    SLightingContext lightingContext = LightingContextInit( isInverted );
+    const bool perfectSmooth = intersection.m_Alpha < ALPHA_THRESHOLD;
+    const float alpha = intersection.m_Alpha;
+    const float ior = intersection.m_IOR.x;
+
+    if ( intersection.m_MaterialType != MATERIAL_TYPE_DIELECTRIC && intersection.m_MaterialType != MATERIAL_TYPE_THIN_DIELECTRIC )
+    {
+        bool hasLambertBrdf = false;
+        bool hasCookTorranceBrdf = false;
+        bool hasCookTorranceMultiscatteringBrdf = false;
+
+        bool dielectricFresnel = false;
+        float weight_lambertBrdf = 0.f;
+        float weight_cookTorranceBrdf = 0.f;
+        float weight_cookTorranceMultiscatteringBrdf = 0.f;
+
+        float E = 0.f;
+        float E_avg = 0.f;
+        XMVECTOR F_ms = XMVectorZero();
+        XMVECTOR internalScatteringFactor = g_XMOne;
+
+        const bool hasAnyBrdf = !isInverted || intersection.m_IsTwoSided;
+
+        if ( intersection.m_Multiscattering && ( intersection.m_MaterialType == MATERIAL_TYPE_PLASTIC || intersection.m_MaterialType == MATERIAL_TYPE_CONDUCTOR ) && hasAnyBrdf )
+        {
+            E = tables.SampleBRDF( cosThetaO, alpha );
+            E_avg = tables.SampleBRDFAverage( alpha );
+        }
+
+        if ( intersection.m_MaterialType == MATERIAL_TYPE_DIFFUSE && hasAnyBrdf )
+        {
+            hasLambertBrdf = true;
+            weight_lambertBrdf = 1.f;
+        }
+        else if ( intersection.m_MaterialType == MATERIAL_TYPE_PLASTIC && hasAnyBrdf )
+        {
+            hasLambertBrdf = true;
+            hasCookTorranceBrdf = true;
+            hasCookTorranceMultiscatteringBrdf = intersection.m_Multiscattering && !perfectSmooth;
+            dielectricFresnel = true;
+
+            weight_cookTorranceBrdf = SpecularWeight( cosThetaO, alpha, ior, false, tables );
+            weight_lambertBrdf = 1.f - weight_cookTorranceBrdf;
+            if ( hasCookTorranceMultiscatteringBrdf )
+            {
+                const float F_avg = MultiscatteringFavgDielectric( ior );
+                const float scalarF_ms = MultiscatteringFresnel( E_avg, F_avg );
+                F_ms = XMVectorReplicate( scalarF_ms );
+                weight_cookTorranceMultiscatteringBrdf = scalarF_ms * ( 1.f - E );
+                weight_lambertBrdf = std::max( weight_lambertBrdf - weight_cookTorranceMultiscatteringBrdf, 0.f );
+            }
+
+            internalScatteringFactor = CalculateInternalScatteringFactor( alpha, intersection.m_Albedo, ior, intersection.m_InternalScatteringMode, tables );
+        }
+        else if ( intersection.m_MaterialType == MATERIAL_TYPE_CONDUCTOR && hasAnyBrdf )
+        {
+            hasCookTorranceBrdf = true;
+            hasCookTorranceMultiscatteringBrdf = intersection.m_Multiscattering && !perfectSmooth;
+            dielectricFresnel = false;
+
+            weight_cookTorranceBrdf = 1.f;
+            if ( hasCookTorranceMultiscatteringBrdf )
+            {
+                const XMFLOAT3& k = intersection.m_Albedo;
+                const XMFLOAT3 F_avg( MultiscatteringFavgConductor( intersection.m_IOR.x, k.x ), MultiscatteringFavgConductor( intersection.m_IOR.y, k.y ),
+                    MultiscatteringFavgConductor( intersection.m_IOR.z, k.z ) );
+                F_ms = MultiscatteringFresnel( E_avg, F_avg );
+
+                // Don't know the brdf energy for conductor, hence uniformly sample it.
+                weight_cookTorranceBrdf = .5f;
+                weight_cookTorranceMultiscatteringBrdf = .5f;
+            }
+        }
+
+        if ( BRDFSelectionSample < weight_lambertBrdf )
+        {
+            wi = ConsineSampleHemisphere( BRDFSample );
+            LightingContextCalculateH( wo, wi, &lightingContext );
+        }
+        else if ( BRDFSelectionSample < weight_lambertBrdf + weight_cookTorranceBrdf )
+        {
+            if ( !perfectSmooth )
+            {
+                wi = SampleCookTorranceMicrofacetBRDF( wo, BRDFSample, alpha, sampleGGXVNDF, &lightingContext );
+            }
+            else
+            {
+                float scalarValue = 0.f;
+                wi = SampleSpecularBRDF( wo, &scalarValue, &pdf, &lightingContext );
+                const XMVECTOR F = dielectricFresnel ? XMVectorReplicate( FresnelDielectric( lightingContext.m_WOdotH, 1.f, ior ) )
+                    : FresnelConductor( lightingContext.m_WOdotH, intersection.m_IOR, intersection.m_Albedo );
+                value = F * scalarValue;
+                pdf *= weight_cookTorranceBrdf;
+
+                isDeltaBxdf = true;
+                hasLambertBrdf = false;
+                hasCookTorranceBrdf = false;
+                hasCookTorranceMultiscatteringBrdf = false;
+            }
+        }
+        else
+        {
+            wi = ConsineSampleHemisphere( BRDFSample );
+            LightingContextCalculateH( wo, wi, &lightingContext );
+        }
+
+        if ( hasLambertBrdf )
+        {
+            value += XMLoadFloat3( &intersection.m_Albedo ) * internalScatteringFactor * ( EvaluateLambertBRDF( wi, wo ) * weight_lambertBrdf );
+            pdf += EvaluateLambertBRDFPdf( wi, wo ) * weight_lambertBrdf;
+        }
+        if ( hasCookTorranceBrdf && !perfectSmooth )
+        {
+            const float microfacetValue = EvaluateCookTorranceMircofacetBRDF( wi, wo, alpha, lightingContext );
+            const XMVECTOR F = dielectricFresnel ? XMVectorReplicate( FresnelDielectric( lightingContext.m_WOdotH, 1.f, ior ) )
+                : FresnelConductor( lightingContext.m_WOdotH, intersection.m_IOR, intersection.m_Albedo );
+            value += F * microfacetValue;
+            pdf += EvaluateCookTorranceMicrofacetBRDFPdf( wi, wo, alpha, lightingContext, sampleGGXVNDF ) * weight_cookTorranceBrdf;
+        }
+        if ( hasCookTorranceMultiscatteringBrdf )
+        {
+            value += EvaluateCookTorranceMultiscatteringBRDF( wi, wo, alpha, E, E_avg, F_ms, tables );
+            pdf += EvaluateCookTorranceMultiscatteringBRDFPdf( wi, wo ) * weight_cookTorranceMultiscatteringBrdf;
+        }
+    }
+    else if ( intersection.m_MaterialType == MATERIAL_TYPE_THIN_DIELECTRIC || perfectSmooth )
+    {
+        const bool isThin = intersection.m_MaterialType == MATERIAL_TYPE_THIN_DIELECTRIC;
+        const bool isEntering = isThin ? false : isInverted;
+        const float etaO = isEntering ? ior : 1.f;
+        const float etaI = isEntering ? 1.f : ior;
+
+        float scalarValue = 0.f;
+        wi = SampleSpecularBSDF( wo, BRDFSelectionSample, etaO, etaI, isThin, true, &scalarValue, &pdf, &lightingContext );
+        value = XMVectorReplicate( scalarValue );
+
+        isDeltaBxdf = true;
+    }
+    else
+    {
+        const bool hasCookTorranceMultiscatteringBsdf = intersection.m_Multiscattering;
+
+        float weight_cookTorranceBsdf = 1.f;
+        float weight_cookTorranceMultiscatteringBsdf = 0.f;
+
+        float E = 0.f;
+        float E_avg = 0.f;
+        float E_inv_avg = 0.f;
+        float ratio = 0.f;
+
+        const float etaO = isInverted ? ior : 1.f;
+        const float etaI = isInverted ? 1.f : ior;
+
+        if ( hasCookTorranceMultiscatteringBsdf )
+        {
+            const float E_avg_enter = tables.SampleBSDFAverage( alpha, ior, true );
+            const float F_avg_enter = MultiscatteringFavgDielectric( 1.f / ior );
+            const float E_avg_leave = tables.SampleBSDFAverage( alpha, ior, false );
+            const float F_avg_leave = MultiscatteringFavgDielectric( ior );
+            const float reciprocalFactor = ReciprocalFactor( F_avg_leave, F_avg_enter, E_avg_leave, E_avg_enter, ior );
+
+            E = tables.SampleBSDF( cosThetaO, alpha, ior, isInverted );
+            const float F_avg = isInverted ? F_avg_enter : F_avg_leave;
+            E_avg = isInverted ? E_avg_enter : E_avg_leave;
+            E_inv_avg = isInverted ? E_avg_leave : E_avg_enter;
+            ratio = ( isInverted ? 1.f - reciprocalFactor : reciprocalFactor ) * ( 1.f - F_avg );
+
+            weight_cookTorranceBsdf = E;
+            weight_cookTorranceMultiscatteringBsdf = 1.f - E;
+        }
+
+        if ( BRDFSelectionSample < weight_cookTorranceBsdf )
+        {
+            wi = SampleCookTorranceMicrofacetBSDF( wo, BRDFSelectionSample, BRDFSample, alpha, etaO, etaI, sampleGGXVNDF, &lightingContext );
+        }
+        else
+        {
+            wi = SampleCookTorranceMultiscatteringBSDF( wo, BRDFSelectionSample, BRDFSample, ratio );
+        }
+
+        float scalarValue = EvaluateCookTorranceMicrofacetBSDF( wi, wo, alpha, etaO, etaI, true );
+        pdf += EvaluateCookTorranceMicrofacetBSDFPdf( wi, wo, alpha, etaO, etaI, sampleGGXVNDF ) * weight_cookTorranceBsdf;
+
+        if ( hasCookTorranceMultiscatteringBsdf )
+        {
+            scalarValue += EvaluateCookTorranceMultiscatteringBSDF( wi, alpha, ratio, ior, E, E_avg, E_inv_avg, isInverted, tables );
+            pdf += EvaluateCookTorranceMultiscatteringBSDFPdf( wi, ratio ) * weight_cookTorranceMultiscatteringBsdf;
+        }
+        value = XMVectorReplicate( scalarValue );
+    }
+
+    if ( isInverted )
+    {
+        wi = FlipZ( wi );
+    }
+
+    *outWi = TangentToWorld( wi, frame );
+    *outValue = value;
+    *outPdf = pdf;
+    *outIsDeltaBxdf = isDeltaBxdf;
+}
+
+//
+// Table integration, same as BxDFTexturesBuilding.hlsl
+//
+
+static float NextSample( std::mt19937& rng )
+{
+    return ( rng() >> 8 ) / float( 1 << 24 );
+}
+
+static XMFLOAT2 NextSample2D( std::mt19937& rng )
+{
+    XMFLOAT2 sample;
+    sample.x = NextSample( rng );
+    sample.y = NextSample( rng );
+    return sample;
+}
+
+// Directional albedo of the Cook-Torrance BRDF, with the dielectric Fresnel term when ior is not zero
+static double IntegrateCookTorranceBRDF( float cosThetaO, float alpha, float ior, bool isEntering, uint32_t sampleCount, std::mt19937& rng )
+{
+    const bool perfectSmooth = alpha < ALPHA_THRESHOLD;
+    const XMVECTOR wo = XMVectorSet( sqrtf( 1.f - cosThetaO * cosThetaO ), 0.f, cosThetaO, 0.f );
+    double result = 0.0;
+    for ( uint32_t sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex )
+    {
+        SLightingContext lightingContext = LightingContextInit( false );
+        XMVECTOR wi;
+        float sampleValue = 0.f;
+        float samplePdf = 0.f;
+        if ( perfectSmooth )
+        {
+            wi = SampleSpecularBRDF( wo, &sampleValue, &samplePdf, &lightingContext );
+        }
+        else
+        {
+            wi = SampleCookTorranceMicrofacetBRDF( wo, NextSample2D( rng ), alpha, true, &lightingContext );
+            sampleValue = EvaluateCookTorranceMircofacetBRDF( wi, wo, alpha, lightingContext );
+            samplePdf = EvaluateCookTorranceMicrofacetBRDFPdf( wi, wo, alpha, lightingContext, true );
+        }
+
+        if ( samplePdf > 0.f )
+        {
+            if ( ior != 0.f )
+            {
+                const float etaO = isEntering ? ior : 1.f;
+                const float etaI = isEntering ? 1.f : ior;
+                sampleValue *= FresnelDielectric( lightingContext.m_WOdotH, etaO, etaI );
+            }
+            result += (double)sampleValue * fabsf( XMVectorGetZ( wi ) ) / samplePdf;
+        }
+    }
+    return result / sampleCount;
+}
+
+// Directional albedo of the Cook-Torrance BSDF, reflection and transmission, without the refraction scale factor
+static double IntegrateCookTorranceBSDF( float cosThetaO, float alpha, float ior, bool isEntering, uint32_t sampleCount, std::mt19937& rng )
+{
+    const bool perfectSmooth = alpha < ALPHA_THRESHOLD;
+    const XMVECTOR wo = XMVectorSet( sqrtf( 1.f - cosThetaO * cosThetaO ), 0.f, cosThetaO, 0.f );
+    const float etaO = isEntering ? ior : 1.f;
+    const float etaI = isEntering ? 1.f : ior;
+    double result = 0.0;
+    for ( uint32_t sampleIndex = 0; sampleIndex < sampleCount; ++sampleIndex )
+    {
+        SLightingContext lightingContext = LightingContextInit( false );
+        const float selectionSample = NextSample( rng );
+        XMVECTOR wi;
+        float sampleValue = 0.f;
+        float samplePdf = 0.f;
+        if ( perfectSmooth )
+        {
+            wi = SampleSpecularBSDF( wo, selectionSample, etaO, etaI, false, false, &sampleValue, &samplePdf, &lightingContext );
+        }
+        else
+        {
+            wi = SampleCookTorranceMicrofacetBSDF( wo, selectionSample, NextSample2D( rng ), alpha, etaO, etaI, true, &lightingContext );
+            sampleValue = EvaluateCookTorranceMicrofacetBSDF( wi, wo, alpha, etaO, etaI, false );
+            samplePdf = EvaluateCookTorranceMicrofacetBSDFPdf( wi, wo, alpha, etaO, etaI, true );
+        }
+
+        if ( samplePdf > 0.f )
+        {
+            result += (double)sampleValue * fabsf( XMVectorGetZ( wi ) ) / samplePdf;
+        }
+    }
+    return result / sampleCount;
+}
+
+// Same as INTEGRATE_AVERAGE in BxDFTexturesBuilding.hlsl, trapezoidal composition of E( mu ) * mu over the cosThetaO row
+static float IntegrateAverage( const float* row, uint32_t sampleCount )
+{
+    const uint32_t n = sampleCount - 1;
+    const double fa = row[ 0 ] * 0.0001; // cosTheta clamped to 0.0001
+    double sum = 0.0;
+    for ( uint32_t i = 1; i < n; ++i )
+    {
+        sum += Saturate( row[ i ] ) * ( (double)i / n );
+    }
+    const double fb = row[ n ];
+    return Saturate( (float)( ( sum + ( fa + fb ) * .5 ) / n * 2.0 ) );
+}
+
+void SBxDFTables::Build( uint32_t sampleCount, uint32_t maxWorkerCount )
+{
+    Timer timer;
+    timer.Start();
+
+    const uint32_t dielectricSliceSize = BXDFTEX_BRDF_DIELECTRIC_SIZE_X * BXDFTEX_BRDF_DIELECTRIC_SIZE_Y;
+    const uint32_t dielectricSliceCount = BXDFTEX_BRDF_DIELECTRIC_SIZE_Z * 2;
+    const float etaInterval = ( s_TableEtaEnd - s_TableEtaStart ) / ( BXDFTEX_BRDF_DIELECTRIC_SIZE_Z - 1 );
+
+    // Unsaturated integrals, the averages are computed from them before they are saturated like the GPU textures
+    std::vector<float> BRDF( BXDFTEX_BRDF_SIZE_X * BXDFTEX_BRDF_SIZE_Y );
+    std::vector<float> BRDFDielectric( (size_t)dielectricSliceSize * dielectricSliceCount );
+    std::vector<float> BSDF( (size_t)dielectricSliceSize * dielectricSliceCount );
+
+    // One item per row of cosThetaO
+    const uint32_t BRDFRowCount = BXDFTEX_BRDF_SIZE_Y;
+    const uint32_t dielectricRowCount = BXDFTEX_BRDF_DIELECTRIC_SIZE_Y * dielectricSliceCount;
+    ParallelFor( BRDFRowCount + dielectricRowCount * 2, [&]( uint32_t, uint32_t itemIndex )
+    {
+        std::mt19937 rng( itemIndex );
+        if ( itemIndex < BRDFRowCount )
+        {
+            const float alpha = itemIndex / float( BXDFTEX_BRDF_SIZE_Y - 1 );
+            for ( uint32_t x = 0; x < BXDFTEX_BRDF_SIZE_X; ++x )
+            {
+                const float cosThetaO = std::max( x / float( BXDFTEX_BRDF_SIZE_X - 1 ), 0.0001f );
+                BRDF[ itemIndex * BXDFTEX_BRDF_SIZE_X + x ] = (float)IntegrateCookTorranceBRDF( cosThetaO, alpha, 0.f, false, sampleCount, rng );
+            }
+            return;
+        }
+
+        itemIndex -= BRDFRowCount;
+        const bool isBSDF = itemIndex >= dielectricRowCount;
+        const uint32_t rowIndex = isBSDF ? itemIndex - dielectricRowCount : itemIndex;
+        const uint32_t slice = rowIndex / BXDFTEX_BRDF_DIELECTRIC_SIZE_Y;
+        const uint32_t y = rowIndex % BXDFTEX_BRDF_DIELECTRIC_SIZE_Y;
+        const bool isEntering = slice >= BXDFTEX_BRDF_DIELECTRIC_SIZE_Z;
+        const float ior = ( slice % BXDFTEX_BRDF_DIELECTRIC_SIZE_Z ) * etaInterval + s_TableEtaStart;
+        const float alpha = y / float( BXDFTEX_BRDF_DIELECTRIC_SIZE_Y - 1 );
+        float* row = ( isBSDF ? BSDF.data() : BRDFDielectric.data() ) + (size_t)rowIndex * BXDFTEX_BRDF_DIELECTRIC_SIZE_X;
+        for ( uint32_t x = 0; x < BXDFTEX_BRDF_DIELECTRIC_SIZE_X; ++x )
+        {
+            const float cosThetaO = std::max( x / float( BXDFTEX_BRDF_DIELECTRIC_SIZE_X - 1 ), 0.0001f );
+            row[ x ] = (float)( isBSDF ? IntegrateCookTorranceBSDF( cosThetaO, alpha, ior, isEntering, sampleCount, rng )
+                : IntegrateCookTorranceBRDF( cosThetaO, alpha, ior, isEntering, sampleCount, rng ) );
+        }
+    }, maxWorkerCount );
+
+    m_BRDFAverage.resize( BXDFTEX_BRDF_SIZE_Y );
+    for ( uint32_t y = 0; y < BXDFTEX_BRDF_SIZE_Y; ++y )
+    {
+        m_BRDFAverage[ y ] = IntegrateAverage( BRDF.data() + y * BXDFTEX_BRDF_SIZE_X, BXDFTEX_BRDF_SIZE_X );
+    }
+
+    // The average tables hold alpha along x and eta along y in one slice for leaving and one for entering
+    m_BRDFDielectricAverage.resize( (size_t)BXDFTEX_BRDF_DIELECTRIC_SIZE_Y * dielectricSliceCount );
+    m_BSDFAverage.resize( (size_t)BXDFTEX_BRDF_DIELECTRIC_SIZE_Y * dielectricSliceCount );
+    for ( uint32_t slice = 0; slice < dielectricSliceCount; ++slice )
+    {
+        for ( uint32_t y = 0; y < BXDFTEX_BRDF_DIELECTRIC_SIZE_Y; ++y )
+        {
+            const size_t rowOffset = ( (size_t)slice * BXDFTEX_BRDF_DIELECTRIC_SIZE_Y + y ) * BXDFTEX_BRDF_DIELECTRIC_SIZE_X;
+            const size_t averageIndex = (size_t)slice * BXDFTEX_BRDF_DIELECTRIC_SIZE_Y + y;
+            m_BRDFDielectricAverage[ averageIndex ] = IntegrateAverage( BRDFDielectric.data() + rowOffset, BXDFTEX_BRDF_DIELECTRIC_SIZE_X );
+            m_BSDFAverage[ averageIndex ] = IntegrateAverage( BSDF.data() + rowOffset, BXDFTEX_BRDF_DIELECTRIC_SIZE_X );
+        }
+    }
+
+    auto saturateTable = []( std::vector<float>* table )
+    {
+        for ( float& value : *table )
+        {
+            value = Saturate( value );
+        }
+    };
+    saturateTable( &BRDF );
+    saturateTable( &BRDFDielectric );
+    saturateTable( &BSDF );
+    m_BRDF = std::move( BRDF );
+    m_BRDFDielectric = std::move( BRDFDielectric );
+    m_BSDF = std::move( BSDF );
+
+    LOG_STRING_FORMAT( "BxDF tables integrated on the CPU with %u samples per texel in %.2fs\n", sampleCount, timer.GetElapsedSecondsFloat().count() );
+}
+
+//
+// Validation
+//
+
+static SIntersection CreateValidationIntersection( uint32_t materialType, const XMFLOAT3& albedo, const XMFLOAT3& ior, float roughness, bool multiscattering )
+{
+    SIntersection intersection = {};
+    intersection.m_Albedo = albedo;
+    intersection.m_Alpha = roughness * roughness;
+    intersection.m_Normal = XMFLOAT3( 0.f, 0.f, 1.f );
+    intersection.m_GeometryNormal = XMFLOAT3( 0.f, 0.f, 1.f );
+    intersection.m_Tangent = XMFLOAT3( 1.f, 0.f, 0.f );
+    intersection.m_IOR = ior;
+    intersection.m_Multiscattering = multiscattering;
+    intersection.m_InternalScatteringMode = INTERNAL_SCATTERING_MODE_IGNORE;
+    intersection.m_MaterialType = materialType;
+    return intersection;
+}
+
+static bool IsClose( float value, float reference, float relativeTolerance )
+{
+    return fabsf( value - reference ) <= relativeTolerance * std::max( fabsf( reference ), 1e-3f );
+}
+
+static bool ValidateMaterial( const char* name, const SIntersection& intersection, float cosThetaO, bool sampleGGXVNDF, float minAlbedo, float maxAlbedo, const SBxDFTables& tables,
+    std::mt19937& rng )
+{
+    const XMVECTOR wo = XMVectorSet( sqrtf( 1.f - cosThetaO * cosThetaO ), 0.f, cosThetaO, 0.f );
+    const uint32_t sampleCount = 1 << 18;
+
+    // Sampled values and PDFs of non delta lobes match the evaluated ones, the PDF integrates to at most one and the albedo is the mean weight
+    double albedo = 0.0;
+    double albedoSquared = 0.0;
+    uint32_t mismatchCount = 0;
+    for ( uint32_t i = 0; i < sampleCount; ++i )
+    {
+        const float selectionSample = NextSample( rng );
+        const XMFLOAT2 sample = NextSample2D( rng );
+        XMVECTOR wi, value;
+        float pdf;
+        bool isDeltaBxdf;
+        SampleBSDF( wo, sample, selectionSample, intersection, tables, sampleGGXVNDF, &wi, &value, &pdf, &isDeltaBxdf );
+        if ( pdf <= 0.f || XMVector3Equal( value, XMVectorZero() ) )
+        {
+            continue;
+        }
+
+        if ( !isDeltaBxdf )
+        {
+            const XMVECTOR evaluatedValue = EvaluateBSDF( wi, wo, intersection, tables, sampleGGXVNDF );
+            const float evaluatedPdf = EvaluateBSDFPdf( wi, wo, intersection, tables, sampleGGXVNDF );
+            if ( !IsClose( XMVectorGetX( evaluatedValue ), XMVectorGetX( value ), 1e-2f ) || !IsClose( evaluatedPdf, pdf, 1e-2f ) )
+            {
+                ++mismatchCount;
+            }
+        }
+
+        // Transmitted radiance is scaled by the squared ratio of the IORs, the energy is not
+        double weight = (double)XMVectorGetX( value ) * fabsf( XMVectorGetZ( wi ) ) / pdf;
+        if ( XMVectorGetZ( wi ) < 0.f )
+        {
+            weight *= intersection.m_IOR.x * intersection.m_IOR.x;
+        }
+        albedo += weight;
+        albedoSquared += weight * weight;
+    }
+    albedo /= sampleCount;
+    const double standardError = sqrt( std::max( albedoSquared / sampleCount - albedo * albedo, 0.0 ) / sampleCount );
+
+    // Midpoint rule over the sphere
+    const uint32_t thetaCount = 512;
+    const uint32_t phiCount = 1024;
+    double pdfIntegral = 0.0;
+    for ( uint32_t iTheta = 0; iTheta < thetaCount; ++iTheta )
+    {
+        const double cosTheta = 1.0 - 2.0 * ( iTheta + .5 ) / thetaCount;
+        const double sinTheta = sqrt( std::max( 0.0, 1.0 - cosTheta * cosTheta ) );
+        for ( uint32_t iPhi = 0; iPhi < phiCount; ++iPhi )
+        {
+            const double phi = 2.0 * M_PI * ( iPhi + .5 ) / phiCount;
+            const XMVECTOR wi = XMVectorSet( (float)( sinTheta * cos( phi ) ), (float)( sinTheta * sin( phi ) ), (float)cosTheta, 0.f );
+            pdfIntegral += EvaluateBSDFPdf( wi, wo, intersection, tables, sampleGGXVNDF );
+        }
+    }
+    pdfIntegral *= 4.0 * M_PI / ( (double)thetaCount * phiCount );
+
+    // Narrow lobes are undersampled by the quadrature
+    const float mismatchRatio = (float)mismatchCount / sampleCount;
+    const bool passed = mismatchRatio < 1e-3f && pdfIntegral < 1.02 && albedo >= minAlbedo - 5.0 * standardError && albedo <= maxAlbedo + 5.0 * standardError;
+    LOG_STRING_FORMAT( "%s, cosThetaO %.2f: albedo %.4f +- %.4f expected in [ %.2f, %.2f ], PDF integral %.4f, sample mismatches %.3f%%, %s\n",
+        name, cosThetaO, albedo, standardError, minAlbedo, maxAlbedo, pdfIntegral, mismatchRatio * 100.f, passed ? "passed" : "FAILED" );
+    return passed;
+}
+
+bool ValidateBSDFs()
+{
+    SBxDFTables tables;
+    tables.Build( 1024 );
+
+    std::mt19937 rng( 0x85DF );
+    const XMFLOAT3 white( 1.f, 1.f, 1.f );
+    const XMFLOAT3 gold( .143f, .374f, 1.442f );
+    const XMFLOAT3 goldK( 3.983f, 2.385f, 1.603f );
+    const XMFLOAT3 glass( 1.5f, 1.5f, 1.5f );
+
+    bool isValid = true;
+    for ( float cosThetaO : { .2f, .7f, 1.f } )
+    {
+        isValid &= ValidateMaterial( "Diffuse", CreateValidationIntersection( MATERIAL_TYPE_DIFFUSE, white, glass, 1.f, false ), cosThetaO, true, .999f, 1.001f, tables, rng );
+        isValid &= ValidateMaterial( "Rough plastic", CreateValidationIntersection( MATERIAL_TYPE_PLASTIC, white, glass, .5f, false ), cosThetaO, true, .8f, 1.01f, tables, rng );
+        isValid &= ValidateMaterial( "Rough gold", CreateValidationIntersection( MATERIAL_TYPE_CONDUCTOR, goldK, gold, .6f, false ), cosThetaO, false, .3f, 1.f, tables, rng );
+
+        // A white conductor and a dielectric reflect and transmit all the energy once the multiple scattering is compensated, the dielectric
+        // compensation splits the energy between the sides with averaged Fresnel terms and is only approximately conserving
+        isValid &= ValidateMaterial( "Multiscattering rough white conductor", CreateValidationIntersection( MATERIAL_TYPE_CONDUCTOR, XMFLOAT3( 0.f, 0.f, 0.f ), XMFLOAT3( 1e4f, 1e4f, 1e4f ), 1.f, true ),
+            cosThetaO, true, .97f, 1.03f, tables, rng );
+        isValid &= ValidateMaterial( "Multiscattering rough glass", CreateValidationIntersection( MATERIAL_TYPE_DIELECTRIC, white, glass, .8f, true ), cosThetaO, true, .9f, 1.1f, tables, rng );
+        isValid &= ValidateMaterial( "Smooth glass", CreateValidationIntersection( MATERIAL_TYPE_DIELECTRIC, white, glass, 0.f, false ), cosThetaO, true, .999f, 1.001f, tables, rng );
+    }
+
+    LOG_STRING_FORMAT( "BSDF validation %s.\n", isValid ? "passed" : "FAILED" );
+    return isValid;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// Kulla-Conty energy compensation tables integrated on the CPU with the same layout and parameterization as the textures built by
+// BxDFTexturesBuilding. Lookups mirror the Sample*Texture functions in the shaders, including the bilinear filtering of the clamp sampler.
+struct SBxDFTables
+{
+    // Integrates every texel with sampleCount samples on worker threads
+    void Build( uint32_t sampleCount = 8192, uint32_t maxWorkerCount = 0 );
+
+    float SampleBRDF( float cosThetaO, float alpha ) const;
+
+    float SampleBRDFAverage( float alpha ) const;
+
+    float SampleBRDFDielectric( float cosThetaO, float alpha, float eta, bool isEntering ) const;
+
+    float SampleBRDFDielectricAverage( float alpha, float eta, bool isEntering ) const;
+
+    float SampleBSDF( float cosThetaO, float alpha, float eta, bool isEntering ) const;
+
+    float SampleBSDFAverage( float alpha, float eta, bool isEntering ) const;
+
+    std::vector<float> m_BRDF;                      // cosThetaO x alpha
+    std::vector<float> m_BRDFAverage;               // alpha
+    std::vector<float> m_BRDFDielectric;            // cosThetaO x alpha x eta, leaving slices followed by entering slices
+    std::vector<float> m_BRDFDielectricAverage;     // alpha x eta, leaving slice followed by entering slice
+    std::vector<float> m_BSDF;
+    std::vector<float> m_BSDFAverage;
+};
+
+// Same as Intersection in the shaders
+struct SIntersection
+{
+    DirectX::XMFLOAT3 m_Albedo;
+    float m_Alpha;
+    DirectX::XMFLOAT3 m_Position;
+    DirectX::XMFLOAT3 m_Normal;
+    DirectX::XMFLOAT3 m_Tangent;
+    DirectX::XMFLOAT3 m_GeometryNormal;
+    DirectX::XMFLOAT3 m_IOR;
+    bool m_IsTwoSided;
+    bool m_Backface;
+    bool m_Multiscattering;
+    uint32_t m_InternalScatteringMode;
+    uint32_t m_MaterialType;
+    uint32_t m_LightIndex;
+    uint32_t m_TriangleIndex;
+};
+
+// Same as ConcentricSampleDisk in the shaders
+DirectX::XMFLOAT2 ConcentricSampleDisk( const DirectX::XMFLOAT2& sample );
+
+// Same as EvaluateBSDF, EvaluateBSDFPdf and SampleBSDF in the shaders, wi and wo are in world space
+DirectX::XMVECTOR XM_CALLCONV EvaluateBSDF( DirectX::FXMVECTOR wi, DirectX::FXMVECTOR wo, const SIntersection& intersection, const SBxDFTables& tables, bool sampleGGXVNDF );
+
+float XM_CALLCONV EvaluateBSDFPdf( DirectX::FXMVECTOR wi, DirectX::FXMVECTOR wo, const SIntersection& intersection, const SBxDFTables& tables, bool sampleGGXVNDF );
+
+void XM_CALLCONV SampleBSDF( DirectX::FXMVECTOR wo, const DirectX::XMFLOAT2& BRDFSample, float BRDFSelectionSample, const SIntersection& intersection, const SBxDFTables& tables,
+    bool sampleGGXVNDF, DirectX::XMVECTOR* wi, DirectX::XMVECTOR* value, float* pdf, bool* isDeltaBxdf );
+
+// Checks for every material type that sampling returns the value and PDF evaluated for the sampled direction, that the PDFs integrate to
+// at most one and that the multiscattering BxDFs with a white albedo conserve energy. Logs the results and returns false on failure.
+bool ValidateBSDFs();
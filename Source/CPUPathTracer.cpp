@@ -0,0 +1,1303 @@
+#include "stdafx.h"
+#include "CPUPathTracer.h"
+#include "Scene.h"
+#include "AliasTable.h"
+#include "SphericalTriangle.h"
+#include "RussianRoulette.h"
+#include "TextureCompression.h"
+#include "ImageWriting.h"
+#include "ParallelFor.h"
+#include "Logging.h"
+#include "Timers.h"
+#include "../Shaders/InstanceSharedDef.inc.hlsl"
+#include "../Shaders/BVHSharedDef.inc.hlsl"
+
+using namespace DirectX;
+
+static const uint32_t s_MaxBVHTraversalStackSize = 128;
+static const uint32_t s_TileSize = 16;
+static const uint32_t s_MaxChunkSampleCount = 64;
+static const size_t s_ChunkSampleBufferBudget = 256 * 1024 * 1024;
+static const float s_ShadowEpsilon = 1e-3f;
+static const float s_DegenerateTangentLengthThreshold = 0.000001f;
+
+// Same as Xoshiro128StarStar in the shaders
+struct SXoshiro128StarStar
+{
+    uint32_t m_State[ 4 ];
+};
+
+static uint32_t RotateLeft( uint32_t x, int k )
+{
+    return ( x << k ) | ( x >> ( 32 - k ) );
+}
+
+static uint32_t NextRandom( SXoshiro128StarStar* rng )
+{
+    uint32_t* s = rng->m_State;
+    const uint32_t result = RotateLeft( s[ 0 ] * 5, 7 ) * 9;
+    const uint32_t t = s[ 1 ] << 9;
+
+    s[ 2 ] ^= s[ 0 ];
+    s[ 3 ] ^= s[ 1 ];
+    s[ 1 ] ^= s[ 2 ];
+    s[ 0 ] ^= s[ 3 ];
+
+    s[ 2 ] ^= t;
+    s[ 3 ] = RotateLeft( s[ 3 ], 11 );
+
+    return result;
+}
+
+static float GetNextSample1D( SXoshiro128StarStar* rng )
+{
+    return ( NextRandom( rng ) >> 8 ) / float( 1 << 24 );
+}
+
+static XMFLOAT2 GetNextSample2D( SXoshiro128StarStar* rng )
+{
+    XMFLOAT2 sample;
+    sample.x = GetNextSample1D( rng );
+    sample.y = GetNextSample1D( rng );
+    return sample;
+}
+
+static uint32_t Interleave32Bit( uint32_t x, uint32_t y )
+{
+    x &= 0x0000FFFF;
+    y &= 0x0000FFFF;
+
+    x = ( x | ( x << 8 ) ) & 0x00FF00FF;
+    x = ( x | ( x << 4 ) ) & 0x0F0F0F0F;
+    x = ( x | ( x << 2 ) ) & 0x33333333;
+    x = ( x | ( x << 1 ) ) & 0x55555555;
+
+    y = ( y | ( y << 8 ) ) & 0x00FF00FF;
+    y = ( y | ( y << 4 ) ) & 0x0F0F0F0F;
+    y = ( y | ( y << 2 ) ) & 0x33333333;
+    y = ( y | ( y << 1 ) ) & 0x55555555;
+
+    return x | ( y << 1 );
+}
+
+static uint64_t SplitMix64NextRandom( uint64_t* state )
+{
+    uint64_t z = ( *state += 0x9E3779B97F4A7C15ull );
+    z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+    z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBull;
+    return z ^ ( z >> 31 );
+}
+
+// Same as InitializeRandomNumberGenerator in the shaders
+static SXoshiro128StarStar InitializeRandomNumberGenerator( uint32_t pixelX, uint32_t pixelY, uint32_t frameSeed )
+{
+    uint64_t splitMixState = ( (uint64_t)frameSeed << 32 ) | Interleave32Bit( pixelX, pixelY );
+    const uint64_t s0 = SplitMix64NextRandom( &splitMixState );
+    const uint64_t s1 = SplitMix64NextRandom( &splitMixState );
+
+    SXoshiro128StarStar rng;
+    rng.m_State[ 0 ] = (uint32_t)s0;
+    rng.m_State[ 1 ] = (uint32_t)( s0 >> 32 );
+    rng.m_State[ 2 ] = (uint32_t)s1;
+    rng.m_State[ 3 ] = (uint32_t)( s1 >> 32 );
+    return rng;
+}
+
+static float GetComponent( const XMFLOAT3& v, uint32_t index )
+{
+    return ( &v.x )[ index ];
+}
+
+static float PowerHeuristic( float fPdf, float gPdf )
+{
+    return ( fPdf * fPdf ) / ( fPdf * fPdf + gPdf * gPdf );
+}
+
+static float Sign( float x )
+{
+    return x > 0.f ? 1.f : ( x < 0.f ? -1.f : 0.f );
+}
+
+static XMVECTOR XM_CALLCONV VectorBaryCentric( FXMVECTOR p0, FXMVECTOR p1, FXMVECTOR p2, float u, float v )
+{
+    return p0 + ( p1 - p0 ) * u + ( p2 - p0 ) * v;
+}
+
+static XMFLOAT2 SampleTriangle( const XMFLOAT2& sample )
+{
+    const float s = sqrtf( sample.x );
+    return XMFLOAT2( 1.f - s, sample.y * s );
+}
+
+static XMFLOAT3 SampleSphere( const XMFLOAT2& sample )
+{
+    const float z = 1.f - 2.f * sample.x;
+    const float r = sqrtf( std::max( 0.f, 1.f - z * z ) );
+    const float phi = 2.f * XM_PI * sample.y;
+    return XMFLOAT3( r * cosf( phi ), r * sinf( phi ), z );
+}
+
+static float UniformSpherePDF()
+{
+    return 1.f / ( 4.f * XM_PI );
+}
+
+// Same as OffsetRayOrigin in the shaders
+static XMFLOAT3 OffsetRayOrigin( const XMFLOAT3& p, const XMFLOAT3& n, const XMFLOAT3& d )
+{
+    const float s = Sign( n.x * d.x + n.y * d.y + n.z * d.z );
+    const float offsetNormal[ 3 ] = { n.x * s, n.y * s, n.z * s };
+    const float position[ 3 ] = { p.x, p.y, p.z };
+    float result[ 3 ];
+    for ( uint32_t i = 0; i < 3; ++i )
+    {
+        const int32_t intOffset = (int32_t)( 256.f * offsetNormal[ i ] );
+        int32_t intPosition;
+        memcpy( &intPosition, &position[ i ], sizeof( float ) );
+        intPosition += position[ i ] < 0.f ? -intOffset : intOffset;
+        float offsetPosition;
+        memcpy( &offsetPosition, &intPosition, sizeof( float ) );
+        result[ i ] = fabsf( position[ i ] ) < 1.f / 32.f ? position[ i ] + offsetNormal[ i ] / 65536.f : offsetPosition;
+    }
+    return XMFLOAT3( result[ 0 ], result[ 1 ], result[ 2 ] );
+}
+
+static bool RayAABBIntersect( const XMFLOAT3& origin, const XMFLOAT3& invDirection, float tMin, float tMax, const XMFLOAT3& bboxMin, const XMFLOAT3& bboxMax )
+{
+    const float tx0 = ( bboxMin.x - origin.x ) * invDirection.x;
+    const float tx1 = ( bboxMax.x - origin.x ) * invDirection.x;
+
+    float t0 = fminf( tx0, tx1 );
+    float t1 = fmaxf( tx0, tx1 );
+
+    const float ty0 = ( bboxMin.y - origin.y ) * invDirection.y;
+    const float ty1 = ( bboxMax.y - origin.y ) * invDirection.y;
+
+    t0 = fmaxf( t0, fminf( ty0, ty1 ) );
+    t1 = fminf( t1, fmaxf( ty0, ty1 ) );
+
+    const float tz0 = ( bboxMin.z - origin.z ) * invDirection.z;
+    const float tz1 = ( bboxMax.z - origin.z ) * invDirection.z;
+
+    t0 = fmaxf( t0, fminf( tz0, tz1 ) );
+    t1 = fminf( t1, fmaxf( tz0, tz1 ) );
+
+    return t1 >= t0 && ( t0 < tMax && t1 >= tMin );
+}
+
+static void CalculateRayPermuteAndShearing( const XMFLOAT3& direction, uint32_t permute[ 3 ], XMFLOAT3* shearing )
+{
+    const XMFLOAT3 absDirection( fabsf( direction.x ), fabsf( direction.y ), fabsf( direction.z ) );
+    uint32_t maxIndex = absDirection.x >= absDirection.y ? 0 : 1;
+    maxIndex = GetComponent( absDirection, maxIndex ) >= absDirection.z ? maxIndex : 2;
+    permute[ 2 ] = maxIndex;
+    permute[ 0 ] = permute[ 2 ] + 1 == 3 ? 0 : permute[ 2 ] + 1;
+    permute[ 1 ] = permute[ 0 ] + 1 == 3 ? 0 : permute[ 0 ] + 1;
+
+    const float invZ = 1.f / GetComponent( direction, permute[ 2 ] );
+    shearing->x = -GetComponent( direction, permute[ 0 ] ) * invZ;
+    shearing->y = -GetComponent( direction, permute[ 1 ] ) * invZ;
+    shearing->z = invZ;
+}
+
+// Same as the watertight RayTriangleIntersect in the shaders
+static bool RayTriangleIntersectWatertight( const XMFLOAT3& origin, const XMFLOAT3& shearing, const uint32_t permute[ 3 ], float tMin, float tMax,
+    const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2, float* t, float* u, float* v, bool* backface )
+{
+    const XMVECTOR xmV0 = XMLoadFloat3( &v0 );
+    const XMVECTOR xmV1 = XMLoadFloat3( &v1 );
+    const XMVECTOR xmV2 = XMLoadFloat3( &v2 );
+    const XMVECTOR crossProduct = XMVector3Cross( xmV1 - xmV0, xmV2 - xmV0 );
+    if ( XMVectorGetX( XMVector3LengthSq( crossProduct ) ) == 0.f )
+    {
+        // Always miss a degenerated triangle
+        return false;
+    }
+
+    const XMFLOAT3* vertices[ 3 ] = { &v0, &v1, &v2 };
+    float px[ 3 ], py[ 3 ], pz[ 3 ];
+    for ( uint32_t i = 0; i < 3; ++i )
+    {
+        const XMFLOAT3 translated( vertices[ i ]->x - origin.x, vertices[ i ]->y - origin.y, vertices[ i ]->z - origin.z );
+        pz[ i ] = GetComponent( translated, permute[ 2 ] );
+        px[ i ] = GetComponent( translated, permute[ 0 ] ) + shearing.x * pz[ i ];
+        py[ i ] = GetComponent( translated, permute[ 1 ] ) + shearing.y * pz[ i ];
+    }
+
+    const float e0 = px[ 1 ] * py[ 2 ] - px[ 2 ] * py[ 1 ];
+    const float e1 = px[ 2 ] * py[ 0 ] - px[ 0 ] * py[ 2 ];
+    const float e2 = px[ 0 ] * py[ 1 ] - px[ 1 ] * py[ 0 ];
+    if ( ( e0 < 0.f || e1 < 0.f || e2 < 0.f ) && ( e0 > 0.f || e1 > 0.f || e2 > 0.f ) )
+    {
+        return false;
+    }
+
+    const float det = e0 + e1 + e2;
+    const float tScaled = e0 * pz[ 0 ] * shearing.z + e1 * pz[ 1 ] * shearing.z + e2 * pz[ 2 ] * shearing.z;
+    const float invDet = 1.f / det;
+    *t = tScaled * invDet;
+    *u = e1 * invDet;
+    *v = e2 * invDet;
+    *backface = ( Sign( shearing.z ) * det ) < 0.f;
+
+    return det != 0.f && *t >= tMin && *t < tMax;
+}
+
+// Same as the non-watertight RayTriangleIntersect in the shaders
+static bool RayTriangleIntersect( const XMFLOAT3& origin, const XMFLOAT3& direction, float tMin, float tMax,
+    const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2, float* t, float* u, float* v, bool* backface )
+{
+    const XMVECTOR xmV0 = XMLoadFloat3( &v0 );
+    const XMVECTOR xmDirection = XMLoadFloat3( &direction );
+    const XMVECTOR v0v1 = XMLoadFloat3( &v1 ) - xmV0;
+    const XMVECTOR v0v2 = XMLoadFloat3( &v2 ) - xmV0;
+
+    const XMVECTOR pvec = XMVector3Cross( xmDirection, v0v2 );
+    const float det = XMVectorGetX( XMVector3Dot( v0v1, pvec ) );
+    const float invDet = 1.f / det;
+
+    const XMVECTOR tvec = XMLoadFloat3( &origin ) - xmV0;
+    *u = XMVectorGetX( XMVector3Dot( tvec, pvec ) ) * invDet;
+
+    const XMVECTOR qvec = XMVector3Cross( tvec, v0v1 );
+    *v = XMVectorGetX( XMVector3Dot( xmDirection, qvec ) ) * invDet;
+
+    *t = XMVectorGetX( XMVector3Dot( v0v2, qvec ) ) * invDet;
+
+    *backface = det > -1e-10f;
+
+    return fabsf( det ) >= 1e-10f && *u >= 0.f && *u <= 1.f && *v >= 0.f && *u + *v <= 1.f && *t >= tMin && *t < tMax;
+}
+
+static float SRGBToLinear( uint8_t value )
+{
+    static const struct SSRGBToLinearTable
+    {
+        SSRGBToLinearTable()
+        {
+            for ( uint32_t i = 0; i < 256; ++i )
+            {
+                const float value = i / 255.f;
+                m_Values[ i ] = value <= 0.04045f ? value / 12.92f : powf( ( value + 0.055f ) / 1.055f, 2.4f );
+            }
+        }
+
+        float m_Values[ 256 ];
+    } s_Table;
+    return s_Table.m_Values[ value ];
+}
+
+// Decodes the top level to what the shaders read through the shader resource view, sRGB texels are linearized and single channel texels read ( r, 0, 0, 1 )
+static bool DecodeTexture( const CTexture& texture, SCPUTexture* CPUTexture )
+{
+    CPUTexture->m_Width = texture.m_Width;
+    CPUTexture->m_Height = texture.m_Height;
+    CPUTexture->m_Texels.resize( (size_t)texture.m_Width * texture.m_Height );
+
+    auto writeTexel = [ CPUTexture ]( uint32_t x, uint32_t y, const uint8_t* texel, bool isSingleChannel )
+    {
+        if ( x >= CPUTexture->m_Width || y >= CPUTexture->m_Height )
+        {
+            return;
+        }
+        CPUTexture->m_Texels[ (size_t)y * CPUTexture->m_Width + x ] = isSingleChannel ? XMFLOAT4( texel[ 0 ] / 255.f, 0.f, 0.f, 1.f )
+            : XMFLOAT4( SRGBToLinear( texel[ 0 ] ), SRGBToLinear( texel[ 1 ] ), SRGBToLinear( texel[ 2 ] ), texel[ 3 ] / 255.f );
+    };
+
+    const uint8_t* data = texture.m_PixelData.data() + texture.GetMipOffset( 0 );
+    const uint32_t rowPitch = texture.CalculateRowPitch( 0 );
+    const uint32_t rowCount = texture.CalculateRowCount( 0 );
+    switch ( texture.m_PixelFormat )
+    {
+    case ETexturePixelFormat::R8G8B8A8_sRGB:
+    case ETexturePixelFormat::R8_Unorm:
+    {
+        const bool isSingleChannel = texture.m_PixelFormat == ETexturePixelFormat::R8_Unorm;
+        const uint32_t bytesPerTexel = GetTexturePixelFormatBPP( texture.m_PixelFormat );
+        for ( uint32_t y = 0; y < rowCount; ++y )
+        {
+            for ( uint32_t x = 0; x < texture.m_Width; ++x )
+            {
+                writeTexel( x, y, data + (size_t)y * rowPitch + x * bytesPerTexel, isSingleChannel );
+            }
+        }
+        break;
+    }
+    case ETexturePixelFormat::R32G32B32A32_Float:
+    {
+        for ( uint32_t y = 0; y < rowCount; ++y )
+        {
+            memcpy( CPUTexture->m_Texels.data() + (size_t)y * texture.m_Width, data + (size_t)y * rowPitch, (size_t)texture.m_Width * sizeof( XMFLOAT4 ) );
+        }
+        break;
+    }
+    case ETexturePixelFormat::BC1_sRGB:
+    case ETexturePixelFormat::BC4_Unorm:
+    case ETexturePixelFormat::BC7_sRGB:
+    {
+        const uint32_t blockSize = GetTexturePixelFormatBlockSize( texture.m_PixelFormat );
+        const bool isSingleChannel = texture.m_PixelFormat == ETexturePixelFormat::BC4_Unorm;
+        for ( uint32_t blockY = 0; blockY < rowCount; ++blockY )
+        {
+            for ( uint32_t blockX = 0; blockX * blockSize < rowPitch; ++blockX )
+            {
+                const uint8_t* block = data + (size_t)blockY * rowPitch + blockX * blockSize;
+                uint8_t texels[ 64 ];
+                if ( texture.m_PixelFormat == ETexturePixelFormat::BC1_sRGB )
+                {
+                    DecodeBC1Block( block, texels );
+                }
+                else if ( texture.m_PixelFormat == ETexturePixelFormat::BC7_sRGB )
+                {
+                    DecodeBC7Block( block, texels );
+                }
+                else
+                {
+                    DecodeBC4Block( block, texels );
+                }
+                for ( uint32_t i = 0; i < 16; ++i )
+                {
+                    writeTexel( blockX * 4 + i % 4, blockY * 4 + i / 4, isSingleChannel ? texels + i : texels + i * 4, isSingleChannel );
+                }
+            }
+        }
+        break;
+    }
+    default:
+        return false;
+    }
+    return true;
+}
+
+XMFLOAT4 SCPUTexture::Sample( const XMFLOAT2& texcoord ) const
+{
+    if ( m_Texels.empty() )
+    {
+        return XMFLOAT4( 0.f, 0.f, 0.f, 0.f );
+    }
+
+    // Texel centers are at half integers
+    const float x = std::isfinite( texcoord.x ) ? texcoord.x * m_Width - .5f : 0.f;
+    const float y = std::isfinite( texcoord.y ) ? texcoord.y * m_Height - .5f : 0.f;
+    const float floorX = floorf( x );
+    const float floorY = floorf( y );
+    const float fractionX = x - floorX;
+    const float fractionY = y - floorY;
+
+    auto wrap = []( float coordinate, uint32_t size )
+    {
+        const int64_t index = (int64_t)fmodf( coordinate, (float)size );
+        return (uint32_t)( index < 0 ? index + size : index ) % size;
+    };
+    const uint32_t x0 = wrap( floorX, m_Width );
+    const uint32_t x1 = ( x0 + 1 ) % m_Width;
+    const uint32_t y0 = wrap( floorY, m_Height );
+    const uint32_t y1 = ( y0 + 1 ) % m_Height;
+
+    const XMVECTOR t00 = XMLoadFloat4( &m_Texels[ (size_t)y0 * m_Width + x0 ] );
+    const XMVECTOR t10 = XMLoadFloat4( &m_Texels[ (size_t)y0 * m_Width + x1 ] );
+    const XMVECTOR t01 = XMLoadFloat4( &m_Texels[ (size_t)y1 * m_Width + x0 ] );
+    const XMVECTOR t11 = XMLoadFloat4( &m_Texels[ (size_t)y1 * m_Width + x1 ] );
+    XMFLOAT4 result;
+    XMStoreFloat4( &result, XMVectorLerp( XMVectorLerp( t00, t10, fractionX ), XMVectorLerp( t01, t11, fractionX ), fractionY ) );
+    return result;
+}
+
+bool CCPUPathTracer::Create( CScene* scene, uint32_t BxDFTableSampleCount )
+{
+    if ( !scene->m_HasValidScene )
+    {
+        LOG_STRING( "CPU path tracer requires a loaded scene.\n" );
+        return false;
+    }
+    if ( scene->m_BVHTraversalStackSize > s_MaxBVHTraversalStackSize )
+    {
+        LOG_STRING_FORMAT( "BVH traversal stack size %u exceeds the limit %u of the CPU path tracer.\n", scene->m_BVHTraversalStackSize, s_MaxBVHTraversalStackSize );
+        return false;
+    }
+
+    scene->RebuildMeshFlagsIfDirty();
+    scene->BuildGeometryData( &m_Vertices, &m_Triangles, &m_MaterialIds, &m_BVHNodes );
+    scene->BuildInstanceData( &m_InstanceTransforms, &m_InstanceLightIndices, &m_InstanceMaterialOverrides );
+    scene->BuildInstanceFlags( &m_InstanceFlags );
+    scene->BuildMaterialData( &m_Materials );
+    scene->BuildLightData( &m_Lights, &m_LightAliasTable );
+    m_TriangleAliasTable = scene->m_TriangleAliasTable;
+    m_LightBVH = scene->m_LightBVH;
+
+    m_InstanceInvTransforms.resize( m_InstanceTransforms.size() );
+    for ( size_t i = 0; i < m_InstanceTransforms.size(); ++i )
+    {
+        const XMMATRIX transform = XMLoadFloat4x3( &m_InstanceTransforms[ i ] );
+        XMStoreFloat4x3( &m_InstanceInvTransforms[ i ], XMMatrixInverse( nullptr, transform ) );
+    }
+
+    m_Textures.resize( scene->m_Textures.size() );
+    for ( size_t i = 0; i < scene->m_Textures.size(); ++i )
+    {
+        if ( !DecodeTexture( scene->m_Textures[ i ], &m_Textures[ i ] ) )
+        {
+            LOG_STRING_FORMAT( "Texture %s can not be read by the CPU path tracer, it is sampled as black.\n", scene->m_Textures[ i ].m_Name.c_str() );
+            m_Textures[ i ] = SCPUTexture();
+        }
+    }
+
+    m_EnvironmentLightIndex = scene->m_EnvironmentLight ? (uint32_t)scene->m_MeshLights.size() : LIGHT_INDEX_INVALID; // Environment light is right after the mesh lights.
+    m_HasEnvironmentTexture = scene->m_EnvironmentLight && scene->m_EnvironmentLight->m_Texture;
+    m_EnvironmentDistribution = SEnvironmentLightDistribution();
+    m_EnvironmentRadiance = SEnvironmentLightRadiance();
+    if ( m_HasEnvironmentTexture )
+    {
+        m_EnvironmentDistribution = scene->m_EnvironmentLight->m_CPUDistribution;
+        m_EnvironmentRadiance = scene->m_EnvironmentLight->m_CPURadiance;
+        if ( m_EnvironmentRadiance.m_FaceSize == 0 )
+        {
+            LOG_STRING( "Environment texture can not be read by the CPU path tracer, it is sampled as white.\n" );
+        }
+    }
+
+    scene->m_Camera.GetTransformMatrix( &m_CameraTransform );
+    m_FilmSize = scene->m_FilmSize;
+    m_FilmDistance = scene->CalculateFilmDistance();
+    m_ApertureRadius = scene->CalculateApertureDiameter() * 0.5f;
+    m_FocalDistance = scene->m_FocalDistance;
+    m_BladeCount = scene->m_ApertureBladeCount;
+    const float halfBladeAngle = XM_PI / scene->m_ApertureBladeCount;
+    m_BladeVertexPos.x = cosf( halfBladeAngle ) * m_ApertureRadius;
+    m_BladeVertexPos.y = sinf( halfBladeAngle ) * m_ApertureRadius;
+    m_ApertureBaseAngle = scene->m_ApertureRotation;
+    m_MaxBounceCount = scene->m_MaxBounceCount;
+    m_RussianRouletteBounceCount = scene->m_RussianRouletteBounceCount;
+
+    m_Filter = (uint32_t)scene->m_Filter;
+    m_FilterRadius = scene->m_FilterRadius;
+    m_GaussianAlpha = scene->m_GaussianFilterAlpha;
+    m_GaussianExp = std::exp( -scene->m_GaussianFilterAlpha * scene->m_FilterRadius * scene->m_FilterRadius );
+    const float B = scene->m_MitchellB;
+    const float C = scene->m_MitchellC;
+    m_MitchellFactors[ 0 ] = -B - 6 * C;
+    m_MitchellFactors[ 1 ] = 6 * B + 30 * C;
+    m_MitchellFactors[ 2 ] = -12 * B - 48 * C;
+    m_MitchellFactors[ 3 ] = 8 * B + 24 * C;
+    m_MitchellFactors[ 4 ] = 12 - 9 * B - 6 * C;
+    m_MitchellFactors[ 5 ] = -18 + 12 * B + 6 * C;
+    m_MitchellFactors[ 6 ] = 6 - 2 * B;
+    m_LanczosSincTau = scene->m_LanczosSincTau;
+
+    m_TraverseBVHFrontToBack = scene->m_TraverseBVHFrontToBack;
+    m_IsGGXVNDFSamplingEnabled = scene->m_IsGGXVNDFSamplingEnabled;
+    m_IsLightVisible = scene->m_IsLightVisible;
+    m_WatertightRayTriangleIntersection = scene->m_WatertightRayTriangleIntersection;
+    m_AllowAnyHitShader = scene->m_AllowAnyHitShader;
+
+    if ( m_BxDFTables.m_BRDF.empty() )
+    {
+        Timer timer;
+        timer.Start();
+        m_BxDFTables.Build( BxDFTableSampleCount );
+        LOG_STRING_FORMAT( "BxDF tables integrated on the CPU in %.2fs.\n", timer.GetElapsedSecondsFloat().count() );
+    }
+
+    m_ResolutionWidth = scene->m_ResolutionWidth;
+    m_ResolutionHeight = scene->m_ResolutionHeight;
+    ResetFilm();
+
+    LOG_STRING_FORMAT( "CPU path tracer created with %u triangles, %u BVH nodes and %u lights.\n",
+        (uint32_t)( m_Triangles.size() / 3 ), (uint32_t)m_BVHNodes.size(), (uint32_t)m_Lights.size() );
+    return true;
+}
+
+void CCPUPathTracer::ResetFilm()
+{
+    m_Film.assign( (size_t)m_ResolutionWidth * m_ResolutionHeight, XMFLOAT4( 0.f, 0.f, 0.f, 0.f ) );
+    m_SampleCount = 0;
+    m_RayCount = 0;
+    m_RenderSeconds = 0.f;
+}
+
+void CCPUPathTracer::Render( uint32_t sampleCount, uint32_t firstFrameSeed, uint32_t maxWorkerCount )
+{
+    if ( m_Film.empty() )
+    {
+        return;
+    }
+
+    Timer timer;
+    timer.Start();
+
+    const uint32_t tileCountX = ( m_ResolutionWidth + s_TileSize - 1 ) / s_TileSize;
+    const uint32_t tileCountY = ( m_ResolutionHeight + s_TileSize - 1 ) / s_TileSize;
+    const uint32_t tileCount = tileCountX * tileCountY;
+    const size_t pixelCount = m_Film.size();
+
+    // Samples are traced and filtered in chunks so each dispatch amortizes the worker start-up over several samples per pixel,
+    // the chunk size is bounded by the memory of the per-sample buffers
+    const size_t bytesPerSample = pixelCount * ( sizeof( XMFLOAT2 ) + sizeof( XMFLOAT3 ) );
+    const size_t chunkSampleCountByBudget = std::max( (size_t)1, s_ChunkSampleBufferBudget / bytesPerSample );
+    const uint32_t chunkSampleCount = (uint32_t)std::min( chunkSampleCountByBudget, (size_t)std::min( sampleCount, s_MaxChunkSampleCount ) );
+    std::vector<XMFLOAT2> samplePositions( pixelCount * chunkSampleCount );
+    std::vector<XMFLOAT3> sampleValues( pixelCount * chunkSampleCount );
+    std::vector<uint64_t> workerRayCounts( GetParallelForWorkerCount( tileCount, maxWorkerCount ), 0 );
+
+    for ( uint32_t iChunkSample = 0; iChunkSample < sampleCount; iChunkSample += chunkSampleCount )
+    {
+        const uint32_t currentChunkSampleCount = std::min( chunkSampleCount, sampleCount - iChunkSample );
+        const uint32_t chunkFrameSeed = firstFrameSeed + iChunkSample;
+        ParallelFor( tileCount, [ & ]( uint32_t workerIndex, uint32_t tileIndex )
+            {
+                const uint32_t xBegin = ( tileIndex % tileCountX ) * s_TileSize;
+                const uint32_t yBegin = ( tileIndex / tileCountX ) * s_TileSize;
+                const uint32_t xEnd = std::min( xBegin + s_TileSize, m_ResolutionWidth );
+                const uint32_t yEnd = std::min( yBegin + s_TileSize, m_ResolutionHeight );
+                uint32_t rayCount = 0;
+                for ( uint32_t iSample = 0; iSample < currentChunkSampleCount; ++iSample )
+                {
+                    const size_t sampleOffset = pixelCount * iSample;
+                    for ( uint32_t y = yBegin; y < yEnd; ++y )
+                    {
+                        for ( uint32_t x = xBegin; x < xEnd; ++x )
+                        {
+                            const size_t sampleIndex = sampleOffset + (size_t)y * m_ResolutionWidth + x;
+                            sampleValues[ sampleIndex ] = TracePath( x, y, chunkFrameSeed + iSample, &samplePositions[ sampleIndex ], &rayCount );
+                        }
+                    }
+                }
+                workerRayCounts[ workerIndex ] += rayCount;
+            }, maxWorkerCount );
+
+        // Same as the sample convolution pass, each pixel gathers the samples of its neighbours within the filter radius
+        ParallelFor( m_ResolutionHeight, [ & ]( uint32_t, uint32_t y )
+            {
+                for ( uint32_t x = 0; x < m_ResolutionWidth; ++x )
+                {
+                    const float pixelCenterX = x + .5f;
+                    const float pixelCenterY = y + .5f;
+                    const int32_t xStart = std::max( 0, (int32_t)floorf( pixelCenterX - m_FilterRadius ) );
+                    const int32_t xEnd = std::min( (int32_t)m_ResolutionWidth - 1, (int32_t)floorf( pixelCenterX + m_FilterRadius ) );
+                    const int32_t yStart = std::max( 0, (int32_t)floorf( pixelCenterY - m_FilterRadius ) );
+                    const int32_t yEnd = std::min( (int32_t)m_ResolutionHeight - 1, (int32_t)floorf( pixelCenterY + m_FilterRadius ) );
+
+                    XMFLOAT4& filmTexel = m_Film[ (size_t)y * m_ResolutionWidth + x ];
+                    for ( uint32_t iSample = 0; iSample < currentChunkSampleCount; ++iSample )
+                    {
+                        const size_t sampleOffset = pixelCount * iSample;
+                        for ( int32_t sampleY = yStart; sampleY <= yEnd; ++sampleY )
+                        {
+                            for ( int32_t sampleX = xStart; sampleX <= xEnd; ++sampleX )
+                            {
+                                const size_t sampleIndex = sampleOffset + (size_t)sampleY * m_ResolutionWidth + sampleX;
+                                const XMFLOAT2& samplePosition = samplePositions[ sampleIndex ];
+                                const XMFLOAT3& sampleValue = sampleValues[ sampleIndex ];
+                                const float filterWeight = EvaluateFilter( pixelCenterX - ( samplePosition.x + sampleX ), pixelCenterY - ( samplePosition.y + sampleY ) );
+                                filmTexel.x += filterWeight * sampleValue.x;
+                                filmTexel.y += filterWeight * sampleValue.y;
+                                filmTexel.z += filterWeight * sampleValue.z;
+                                filmTexel.w += filterWeight;
+                            }
+                        }
+                    }
+                }
+            }, maxWorkerCount );
+    }
+
+    uint64_t rayCount = 0;
+    for ( uint64_t workerRayCount : workerRayCounts )
+    {
+        rayCount += workerRayCount;
+    }
+    const float elapsedSeconds = timer.GetElapsedSecondsFloat().count();
+    m_SampleCount += sampleCount;
+    m_RayCount += rayCount;
+    m_RenderSeconds += elapsedSeconds;
+
+    LOG_STRING_FORMAT( "CPU path tracer rendered %u samples per pixel at %ux%u on %u threads in %.2fs, %.2f Mrays/s, %.2f Msamples/s.\n",
+        sampleCount, m_ResolutionWidth, m_ResolutionHeight, (uint32_t)workerRayCounts.size(), elapsedSeconds,
+        elapsedSeconds > 0.f ? rayCount / elapsedSeconds * 1e-6f : 0.f,
+        elapsedSeconds > 0.f ? (float)m_Film.size() * sampleCount / elapsedSeconds * 1e-6f : 0.f );
+}
+
+bool CCPUPathTracer::WriteFilmToFile( const std::filesystem::path& filepath ) const
+{
+    EImageFileFormat fileFormat;
+    if ( m_Film.empty() || !GetImageFileFormatFromExtension( filepath, &fileFormat ) )
+    {
+        return false;
+    }
+
+    SImageWriteDesc desc;
+    desc.m_Width = m_ResolutionWidth;
+    desc.m_Height = m_ResolutionHeight;
+    desc.m_RowFormat = EImageRowFormat::R32G32B32_Float;
+    desc.m_FileFormat = fileFormat;
+    return WriteImageToFile( filepath, desc, [ this ]( uint32_t y, void* row )
+        {
+            float* dest = (float*)row;
+            for ( uint32_t x = 0; x < m_ResolutionWidth; ++x )
+            {
+                const XMFLOAT4& texel = m_Film[ (size_t)y * m_ResolutionWidth + x ];
+                const float invWeight = texel.w > 0.f ? 1.f / texel.w : 0.f;
+                dest[ x * 3 ] = texel.x * invWeight;
+                dest[ x * 3 + 1 ] = texel.y * invWeight;
+                dest[ x * 3 + 2 ] = texel.z * invWeight;
+            }
+        } );
+}
+
+bool XM_CALLCONV CCPUPathTracer::IntersectClosest( FXMVECTOR origin, FXMVECTOR direction, float opacitySample, SHitInfo* hitInfo ) const
+{
+    return Traverse<false>( origin, direction, std::numeric_limits<float>::infinity(), opacitySample, hitInfo );
+}
+
+bool XM_CALLCONV CCPUPathTracer::IntersectAny( FXMVECTOR origin, FXMVECTOR direction, float tMax, float opacitySample ) const
+{
+    return Traverse<true>( origin, direction, tMax, opacitySample, nullptr );
+}
+
+// Same as BVHIntersectNoInterp and BVHIntersect in the shaders
+template <bool IsAnyHit>
+bool XM_CALLCONV CCPUPathTracer::Traverse( FXMVECTOR origin, FXMVECTOR direction, float tMax, float opacitySample, SHitInfo* hitInfo ) const
+{
+    const float tMin = 0.f;
+    uint32_t stack[ s_MaxBVHTraversalStackSize ];
+    uint32_t stackCount = 0;
+
+    uint32_t nodeIndex = 0;
+    uint32_t instanceIndex = 0;
+    bool isBLAS = false;
+    bool isOpaque = false;
+    bool hasHit = false;
+    uint32_t materialOverride = INSTANCE_MATERIAL_OVERRIDE_NONE;
+
+    XMFLOAT3 worldRayOrigin, worldRayDirection;
+    XMStoreFloat3( &worldRayOrigin, origin );
+    XMStoreFloat3( &worldRayDirection, direction );
+    XMFLOAT3 localRayOrigin = worldRayOrigin;
+    XMFLOAT3 localRayDirection = worldRayDirection;
+    XMFLOAT3 invLocalRayDirection( 1.f / localRayDirection.x, 1.f / localRayDirection.y, 1.f / localRayDirection.z );
+    while ( true )
+    {
+        const GPU::BVHNode& node = m_BVHNodes[ nodeIndex ];
+        bool popNode = false;
+        if ( RayAABBIntersect( localRayOrigin, invLocalRayDirection, tMin, tMax, node.bboxMin, node.bboxMax ) )
+        {
+            const bool hasBLAS = ( node.misc & 0x4 ) != 0;
+            const uint32_t primCountOrInstanceIndex = ( node.misc >> 3 ) & BVHNODE_MISC_MASK_PRIMITIVE_COUNT;
+            if ( hasBLAS )
+            {
+                // Going in from TLAS to BLAS
+                const XMMATRIX instanceInvTransform = XMLoadFloat4x3( &m_InstanceInvTransforms[ primCountOrInstanceIndex ] );
+                XMStoreFloat3( &localRayOrigin, XMVector3Transform( origin, instanceInvTransform ) );
+                XMStoreFloat3( &localRayDirection, XMVector3TransformNormal( direction, instanceInvTransform ) );
+                invLocalRayDirection = XMFLOAT3( 1.f / localRayDirection.x, 1.f / localRayDirection.y, 1.f / localRayDirection.z );
+                isBLAS = true;
+                instanceIndex = primCountOrInstanceIndex;
+                nodeIndex = node.rightChildOrPrimIndex;
+
+                isOpaque = ( m_InstanceFlags[ primCountOrInstanceIndex ] & INSTANCE_FLAG_OPAQUE ) != 0;
+                materialOverride = m_InstanceMaterialOverrides[ primCountOrInstanceIndex ];
+            }
+            else if ( primCountOrInstanceIndex == 0 )
+            {
+                const uint32_t splitAxis = node.misc & 0x3;
+                const bool isDirectionNegative = m_TraverseBVHFrontToBack ? GetComponent( localRayDirection, splitAxis ) < 0.f : false;
+                const uint32_t pushNodeIndex = isDirectionNegative ? nodeIndex + 1 : node.rightChildOrPrimIndex;
+                nodeIndex = isDirectionNegative ? node.rightChildOrPrimIndex : nodeIndex + 1;
+                assert( stackCount < s_MaxBVHTraversalStackSize );
+                stack[ stackCount++ ] = ( pushNodeIndex & 0x7FFFFFFF ) | ( isBLAS ? 0x80000000 : 0 );
+            }
+            else
+            {
+                uint32_t rayPermute[ 3 ];
+                XMFLOAT3 rayShearing;
+                if ( m_WatertightRayTriangleIntersection )
+                {
+                    CalculateRayPermuteAndShearing( localRayDirection, rayPermute, &rayShearing );
+                }
+
+                const uint32_t primBegin = node.rightChildOrPrimIndex;
+                const uint32_t primEnd = primBegin + primCountOrInstanceIndex;
+                for ( uint32_t iPrim = primBegin; iPrim < primEnd; ++iPrim )
+                {
+                    const XMFLOAT3& v0 = m_Vertices[ m_Triangles[ iPrim * 3 ] ].position;
+                    const XMFLOAT3& v1 = m_Vertices[ m_Triangles[ iPrim * 3 + 1 ] ].position;
+                    const XMFLOAT3& v2 = m_Vertices[ m_Triangles[ iPrim * 3 + 2 ] ].position;
+                    float t, u, v;
+                    bool backface;
+                    const bool isIntersected = m_WatertightRayTriangleIntersection
+                        ? RayTriangleIntersectWatertight( localRayOrigin, rayShearing, rayPermute, tMin, tMax, v0, v1, v2, &t, &u, &v, &backface )
+                        : RayTriangleIntersect( localRayOrigin, localRayDirection, tMin, tMax, v0, v1, v2, &t, &u, &v, &backface );
+                    if ( isIntersected )
+                    {
+                        const bool hitAccepted = !m_AllowAnyHitShader || isOpaque || AnyHitShader( iPrim, materialOverride, u, v, opacitySample );
+                        if ( hitAccepted )
+                        {
+                            if ( IsAnyHit )
+                            {
+                                return true;
+                            }
+                            tMax = t;
+                            hasHit = true;
+                            hitInfo->m_T = t;
+                            hitInfo->m_U = u;
+                            hitInfo->m_V = v;
+                            hitInfo->m_Backface = backface;
+                            hitInfo->m_TriangleIndex = iPrim;
+                            hitInfo->m_InstanceIndex = instanceIndex;
+                        }
+                    }
+                }
+                popNode = true;
+            }
+        }
+        else
+        {
+            popNode = true;
+        }
+
+        if ( popNode )
+        {
+            if ( stackCount == 0 )
+            {
+                break;
+            }
+            const bool lastNodeIsBLAS = isBLAS;
+            const uint32_t packedNodeIndex = stack[ --stackCount ];
+            nodeIndex = packedNodeIndex & 0x7FFFFFFF;
+            isBLAS = ( packedNodeIndex & 0x80000000 ) != 0;
+            // Popping back from a BLAS to the TLAS
+            if ( lastNodeIsBLAS != isBLAS )
+            {
+                localRayOrigin = worldRayOrigin;
+                localRayDirection = worldRayDirection;
+                invLocalRayDirection = XMFLOAT3( 1.f / localRayDirection.x, 1.f / localRayDirection.y, 1.f / localRayDirection.z );
+            }
+        }
+    }
+
+    return hasHit;
+}
+
+bool CCPUPathTracer::AnyHitShader( uint32_t triangleIndex, uint32_t materialOverride, float u, float v, float opacitySample ) const
+{
+    const uint32_t materialId = materialOverride != INSTANCE_MATERIAL_OVERRIDE_NONE ? materialOverride : m_MaterialIds[ triangleIndex ];
+    const GPU::Material& material = m_Materials[ materialId ];
+    float opacity = material.opacity;
+    if ( material.opacityTextureIndex != -1 )
+    {
+        const XMFLOAT2& texcoord0 = m_Vertices[ m_Triangles[ triangleIndex * 3 ] ].texcoord;
+        const XMFLOAT2& texcoord1 = m_Vertices[ m_Triangles[ triangleIndex * 3 + 1 ] ].texcoord;
+        const XMFLOAT2& texcoord2 = m_Vertices[ m_Triangles[ triangleIndex * 3 + 2 ] ].texcoord;
+        XMFLOAT2 texcoord;
+        XMStoreFloat2( &texcoord, VectorBaryCentric( XMLoadFloat2( &texcoord0 ), XMLoadFloat2( &texcoord1 ), XMLoadFloat2( &texcoord2 ), u, v ) );
+        texcoord.x *= material.texTiling.x;
+        texcoord.y *= material.texTiling.y;
+        opacity *= m_Textures[ material.opacityTextureIndex ].Sample( texcoord ).x;
+    }
+    return opacitySample < opacity;
+}
+
+// Same as HitInfoToIntersection and HitShader in the shaders
+void CCPUPathTracer::HitInfoToIntersection( const SHitInfo& hitInfo, SIntersection* intersection ) const
+{
+    intersection->m_LightIndex = m_InstanceLightIndices[ hitInfo.m_InstanceIndex ];
+    intersection->m_TriangleIndex = hitInfo.m_TriangleIndex;
+
+    const uint32_t materialOverride = m_InstanceMaterialOverrides[ hitInfo.m_InstanceIndex ];
+    const GPU::Vertex& v0 = m_Vertices[ m_Triangles[ hitInfo.m_TriangleIndex * 3 ] ];
+    const GPU::Vertex& v1 = m_Vertices[ m_Triangles[ hitInfo.m_TriangleIndex * 3 + 1 ] ];
+    const GPU::Vertex& v2 = m_Vertices[ m_Triangles[ hitInfo.m_TriangleIndex * 3 + 2 ] ];
+    const float u = hitInfo.m_U;
+    const float v = hitInfo.m_V;
+
+    const XMVECTOR position = VectorBaryCentric( XMLoadFloat3( &v0.position ), XMLoadFloat3( &v1.position ), XMLoadFloat3( &v2.position ), u, v );
+    const XMVECTOR normal = XMVector3Normalize( VectorBaryCentric( XMLoadFloat3( &v0.normal ), XMLoadFloat3( &v1.normal ), XMLoadFloat3( &v2.normal ), u, v ) );
+
+    // Make sure the tangent is not degenerated and is orthogonal to the normal
+    XMVECTOR tangent = VectorBaryCentric( XMLoadFloat3( &v0.tangent ), XMLoadFloat3( &v1.tangent ), XMLoadFloat3( &v2.tangent ), u, v );
+    float tangentLength = XMVectorGetX( XMVector3Length( tangent ) );
+    if ( tangentLength >= s_DegenerateTangentLengthThreshold )
+    {
+        tangent = tangent - XMVector3Dot( tangent, normal ) * normal;
+        tangentLength = XMVectorGetX( XMVector3Length( tangent ) );
+    }
+    if ( tangentLength < s_DegenerateTangentLengthThreshold )
+    {
+        tangent = XMVector3Cross( normal, XMVectorSet( 0.f, 1.f, 0.f, 0.f ) );
+        tangentLength = XMVectorGetX( XMVector3Length( tangent ) );
+        if ( tangentLength < s_DegenerateTangentLengthThreshold )
+        {
+            tangent = XMVectorSet( 1.f, 0.f, 0.f, 0.f );
+            tangentLength = 1.f;
+        }
+    }
+    tangent = tangent / tangentLength;
+
+    const XMVECTOR v0v1 = XMLoadFloat3( &v1.position ) - XMLoadFloat3( &v0.position );
+    const XMVECTOR v0v2 = XMLoadFloat3( &v2.position ) - XMLoadFloat3( &v0.position );
+    const XMVECTOR geometryNormal = XMVector3Normalize( XMVector3Cross( v0v2, v0v1 ) );
+
+    const uint32_t materialId = materialOverride != INSTANCE_MATERIAL_OVERRIDE_NONE ? materialOverride : m_MaterialIds[ hitInfo.m_TriangleIndex ];
+    const GPU::Material& material = m_Materials[ materialId ];
+
+    XMFLOAT2 texcoord;
+    XMStoreFloat2( &texcoord, VectorBaryCentric( XMLoadFloat2( &v0.texcoord ), XMLoadFloat2( &v1.texcoord ), XMLoadFloat2( &v2.texcoord ), u, v ) );
+    texcoord.x *= material.texTiling.x;
+    texcoord.y *= material.texTiling.y;
+
+    XMFLOAT3 albedo = material.albedo;
+    if ( material.albedoTextureIndex != -1 )
+    {
+        const XMFLOAT4 texel = m_Textures[ material.albedoTextureIndex ].Sample( texcoord );
+        albedo.x *= texel.x;
+        albedo.y *= texel.y;
+        albedo.z *= texel.z;
+    }
+
+    const float checkerboard = ( ( (uint32_t)( texcoord.x * 2 ) + (uint32_t)( texcoord.y * 2 ) ) & 0x1 ) != 0 ? 1.f : 0.f;
+    float roughness = material.roughness;
+    roughness *= ( material.flags & MATERIAL_FLAG_ROUGHNESS_TEXTURE ) != 0 ? checkerboard : 1.f;
+
+    intersection->m_Albedo = albedo;
+    intersection->m_Alpha = roughness * roughness;
+    intersection->m_IOR = material.ior;
+    intersection->m_MaterialType = material.flags & MATERIAL_FLAG_TYPE_MASK;
+    intersection->m_IsTwoSided = ( material.flags & MATERIAL_FLAG_IS_TWOSIDED ) != 0;
+    intersection->m_Multiscattering = ( material.flags & MATERIAL_FLAG_MULTISCATTERING ) != 0;
+    intersection->m_InternalScatteringMode = ( material.flags & MATERIAL_FLAG_INTERNAL_SCATTERING_MASK ) >> MATERIAL_FLAG_INTERNAL_SCATTERING_SHIFT;
+    intersection->m_Backface = hitInfo.m_Backface;
+
+    // Assuming the transform only contains uniform scaling otherwise the transformed vectors are wrong
+    const XMMATRIX transform = XMLoadFloat4x3( &m_InstanceTransforms[ hitInfo.m_InstanceIndex ] );
+    XMStoreFloat3( &intersection->m_Position, XMVector3Transform( position, transform ) );
+    XMStoreFloat3( &intersection->m_Normal, XMVector3Normalize( XMVector3TransformNormal( normal, transform ) ) );
+    XMStoreFloat3( &intersection->m_GeometryNormal, XMVector3Normalize( XMVector3TransformNormal( geometryNormal, transform ) ) );
+    XMStoreFloat3( &intersection->m_Tangent, XMVector3Normalize( XMVector3TransformNormal( tangent, transform ) ) );
+}
+
+XMFLOAT3 CCPUPathTracer::EvaluateEnvironmentTexture( const XMFLOAT3& direction ) const
+{
+    return m_EnvironmentRadiance.m_FaceSize != 0 ? m_EnvironmentRadiance.Sample( direction ) : XMFLOAT3( 1.f, 1.f, 1.f );
+}
+
+// Same as TriangleLight_Sample in the shaders
+static void TriangleLightSample( const GPU::SLight& light, const XMFLOAT4X3& transform, const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2, const XMFLOAT2& sample,
+    const XMFLOAT3& p, XMFLOAT3* radiance, XMFLOAT3* wi, float* distance, float* pdf )
+{
+    const XMMATRIX xmTransform = XMLoadFloat4x3( &transform );
+    const XMVECTOR xmV0 = XMLoadFloat3( &v0 );
+    const XMVECTOR xmV1 = XMLoadFloat3( &v1 );
+    const XMVECTOR xmV2 = XMLoadFloat3( &v2 );
+    const XMVECTOR vws0 = XMVector3Transform( xmV0, xmTransform );
+    const XMVECTOR vws1 = XMVector3Transform( xmV1, xmTransform );
+    const XMVECTOR vws2 = XMVector3Transform( xmV2, xmTransform );
+    const XMVECTOR normal = XMVector3Normalize( XMVector3TransformNormal( XMVector3Normalize( XMVector3Cross( xmV2 - xmV0, xmV1 - xmV0 ) ), xmTransform ) );
+    const XMVECTOR xmP = XMLoadFloat3( &p );
+
+    const XMVECTOR a = XMVector3Normalize( vws0 - xmP );
+    const XMVECTOR b = XMVector3Normalize( vws1 - xmP );
+    const XMVECTOR c = XMVector3Normalize( vws2 - xmP );
+    const float solidAngle = CalculateSphericalTriangleSolidAngle( a, b, c );
+    if ( ShouldSampleTriangleLightSolidAngle( solidAngle ) )
+    {
+        const XMVECTOR xmWi = SampleSphericalTriangle( a, b, c, sample, pdf );
+
+        const XMVECTOR planeNormal = XMVector3Cross( vws2 - vws0, vws1 - vws0 );
+        const float WIdotPlaneNormal = XMVectorGetX( XMVector3Dot( xmWi, planeNormal ) );
+        *distance = WIdotPlaneNormal != 0.f ? XMVectorGetX( XMVector3Dot( vws0 - xmP, planeNormal ) ) / WIdotPlaneNormal : 0.f;
+        *pdf = *distance > 0.f ? *pdf : 0.f;
+
+        const float WIdotN = -XMVectorGetX( XMVector3Dot( xmWi, normal ) );
+        *radiance = WIdotN > 0.f && *pdf > 0.f ? light.radiance : XMFLOAT3( 0.f, 0.f, 0.f );
+        *pdf = WIdotN > 0.f ? *pdf : 0.f;
+        XMStoreFloat3( wi, xmWi );
+        return;
+    }
+
+    const float surfaceArea = XMVectorGetX( XMVector3Length( XMVector3Cross( vws2 - vws0, vws1 - vws0 ) ) ) * .5f;
+
+    const XMFLOAT2 samplePosBarycentric = SampleTriangle( sample );
+    const XMVECTOR samplePos = VectorBaryCentric( vws0, vws1, vws2, samplePosBarycentric.x, samplePosBarycentric.y );
+    *pdf = surfaceArea >= 1e-6f ? 1.f / surfaceArea : 0.f;
+
+    XMVECTOR xmWi = samplePos - xmP;
+    *distance = XMVectorGetX( XMVector3Length( xmWi ) );
+    xmWi /= *distance;
+    const float WIdotN = -XMVectorGetX( XMVector3Dot( xmWi, normal ) );
+    *pdf *= *distance * *distance / WIdotN;
+
+    *radiance = WIdotN > 0.f && *pdf > 0.f ? light.radiance : XMFLOAT3( 0.f, 0.f, 0.f );
+    *pdf = WIdotN > 0.f ? *pdf : 0.f;
+    XMStoreFloat3( wi, xmWi );
+}
+
+// Same as TriangleLight_EvaluateWithPDF in the shaders
+static void TriangleLightEvaluateWithPDF( const GPU::SLight& light, const XMFLOAT4X3& transform, const XMFLOAT3& v0, const XMFLOAT3& v1, const XMFLOAT3& v2,
+    const XMFLOAT3& p, const XMFLOAT3& wi, const XMFLOAT3& normal, float distance, XMFLOAT3* radiance, float* pdf )
+{
+    const XMMATRIX xmTransform = XMLoadFloat4x3( &transform );
+    const XMVECTOR vws0 = XMVector3Transform( XMLoadFloat3( &v0 ), xmTransform );
+    const XMVECTOR vws1 = XMVector3Transform( XMLoadFloat3( &v1 ), xmTransform );
+    const XMVECTOR vws2 = XMVector3Transform( XMLoadFloat3( &v2 ), xmTransform );
+    const XMVECTOR xmP = XMLoadFloat3( &p );
+
+    const float WIdotN = -( wi.x * normal.x + wi.y * normal.y + wi.z * normal.z );
+    *radiance = WIdotN > 0.f ? light.radiance : XMFLOAT3( 0.f, 0.f, 0.f );
+
+    const float solidAngle = CalculateSphericalTriangleSolidAngle( XMVector3Normalize( vws0 - xmP ), XMVector3Normalize( vws1 - xmP ), XMVector3Normalize( vws2 - xmP ) );
+    if ( ShouldSampleTriangleLightSolidAngle( solidAngle ) )
+    {
+        *pdf = WIdotN > 0.f ? 1.f / solidAngle : 0.f;
+        return;
+    }
+
+    const float surfaceArea = XMVectorGetX( XMVector3Length( XMVector3Cross( vws2 - vws0, vws1 - vws0 ) ) ) * .5f;
+    *pdf = surfaceArea >= 1e-6f ? 1.f / surfaceArea : 0.f;
+    *pdf *= WIdotN > 0.f ? distance * distance / WIdotN : 0.f;
+}
+
+// Same as SampleLightDirect in the shaders
+void CCPUPathTracer::SampleLightDirect( const XMFLOAT3& p, SXoshiro128StarStar* rng, SLightSampleResult* result ) const
+{
+    const uint32_t lightCount = (uint32_t)m_Lights.size();
+
+    // Select a light at infinity proportionally to its estimated power, or the light BVH in the last entry
+    const XMFLOAT2 lightSelectionSample = GetNextSample2D( rng );
+    uint32_t lightIndex = SampleAliasTable( m_LightAliasTable.data(), lightCount + 1, lightSelectionSample.x, lightSelectionSample.y );
+    float lightPmf = m_LightAliasTable[ lightIndex ].probability;
+    if ( lightIndex == lightCount )
+    {
+        float lightBVHPmf;
+        lightIndex = m_LightBVH.Sample( p, GetNextSample1D( rng ), &lightBVHPmf );
+        if ( lightIndex == LIGHT_INDEX_INVALID )
+        {
+            result->m_Radiance = XMFLOAT3( 0.f, 0.f, 0.f );
+            result->m_Wi = XMFLOAT3( 0.f, 0.f, 1.f );
+            result->m_Pdf = 0.f;
+            result->m_Distance = 0.f;
+            result->m_IsDeltaLight = false;
+            return;
+        }
+        lightPmf *= lightBVHPmf;
+    }
+    const GPU::SLight& light = m_Lights[ lightIndex ];
+
+    result->m_IsDeltaLight = false;
+    if ( light.flags & LIGHT_FLAGS_POINT_LIGHT )
+    {
+        XMVECTOR wi = XMLoadFloat3( &light.position_or_triangleRange ) - XMLoadFloat3( &p );
+        result->m_Distance = XMVectorGetX( XMVector3Length( wi ) );
+        XMStoreFloat3( &result->m_Wi, wi / result->m_Distance );
+        const float invSquaredDistance = 1.f / ( result->m_Distance * result->m_Distance );
+        result->m_Radiance = XMFLOAT3( light.radiance.x * invSquaredDistance, light.radiance.y * invSquaredDistance, light.radiance.z * invSquaredDistance );
+        result->m_Pdf = 1.f;
+        result->m_IsDeltaLight = true;
+    }
+    else if ( light.flags & LIGHT_FLAGS_DIRECTIONAL_LIGHT )
+    {
+        result->m_Wi = XMFLOAT3( -light.position_or_triangleRange.x, -light.position_or_triangleRange.y, -light.position_or_triangleRange.z );
+        result->m_Distance = std::numeric_limits<float>::infinity();
+        result->m_Radiance = light.radiance;
+        result->m_Pdf = 1.f;
+        result->m_IsDeltaLight = true;
+    }
+    else if ( light.flags & LIGHT_FLAGS_MESH_LIGHT )
+    {
+        uint32_t triangleOffset, triangleCount, instanceIndex;
+        memcpy( &triangleOffset, &light.position_or_triangleRange.x, sizeof( uint32_t ) );
+        memcpy( &triangleCount, &light.position_or_triangleRange.y, sizeof( uint32_t ) );
+        memcpy( &instanceIndex, &light.position_or_triangleRange.z, sizeof( uint32_t ) );
+
+        // Select one triangle proportionally to its area
+        const XMFLOAT2 triangleSelectionSample = GetNextSample2D( rng );
+        const uint32_t localTriangleIndex = SampleAliasTable( m_TriangleAliasTable.data() + light.triangleAliasTableOffset, triangleCount, triangleSelectionSample.x, triangleSelectionSample.y );
+        const XMFLOAT2 triangleSample = GetNextSample2D( rng );
+        const uint32_t triangleIndex = triangleOffset + localTriangleIndex;
+
+        const XMFLOAT3& v0 = m_Vertices[ m_Triangles[ triangleIndex * 3 ] ].position;
+        const XMFLOAT3& v1 = m_Vertices[ m_Triangles[ triangleIndex * 3 + 1 ] ].position;
+        const XMFLOAT3& v2 = m_Vertices[ m_Triangles[ triangleIndex * 3 + 2 ] ].position;
+        TriangleLightSample( light, m_InstanceTransforms[ instanceIndex ], v0, v1, v2, triangleSample, p, &result->m_Radiance, &result->m_Wi, &result->m_Distance, &result->m_Pdf );
+
+        result->m_Pdf *= m_TriangleAliasTable[ light.triangleAliasTableOffset + localTriangleIndex ].probability;
+    }
+    else if ( light.flags & LIGHT_FLAGS_ENVIRONMENT_LIGHT )
+    {
+        XMFLOAT4 samples;
+        const XMFLOAT2 samples0 = GetNextSample2D( rng );
+        const XMFLOAT2 samples1 = GetNextSample2D( rng );
+        samples = XMFLOAT4( samples0.x, samples0.y, samples1.x, samples1.y );
+        if ( m_HasEnvironmentTexture && m_EnvironmentDistribution.m_CellCount != 0 )
+        {
+            result->m_Wi = m_EnvironmentDistribution.Sample( samples, &result->m_Pdf );
+        }
+        else
+        {
+            result->m_Wi = SampleSphere( samples0 );
+            result->m_Pdf = UniformSpherePDF();
+        }
+        const XMFLOAT3 texel = m_HasEnvironmentTexture ? EvaluateEnvironmentTexture( result->m_Wi ) : XMFLOAT3( 1.f, 1.f, 1.f );
+        result->m_Radiance = XMFLOAT3( texel.x * light.radiance.x, texel.y * light.radiance.y, texel.z * light.radiance.z );
+        result->m_Distance = std::numeric_limits<float>::infinity();
+    }
+
+    result->m_Pdf *= lightPmf;
+
+    if ( result->m_Distance != std::numeric_limits<float>::infinity() )
+    {
+        result->m_Distance *= 1.f - s_ShadowEpsilon;
+    }
+}
+
+// Same as EvaluateLightDirect in the shaders
+void CCPUPathTracer::EvaluateLightDirect( const XMFLOAT3& p, uint32_t lightIndex, uint32_t triangleIndex, const XMFLOAT3& normal, const XMFLOAT3& wi,
+    float distance, XMFLOAT3* radiance, float* pdf ) const
+{
+    *radiance = XMFLOAT3( 0.f, 0.f, 0.f );
+    *pdf = 0.f;
+
+    const GPU::SLight& light = m_Lights[ lightIndex ];
+    if ( light.flags & LIGHT_FLAGS_MESH_LIGHT )
+    {
+        uint32_t triangleOffset, instanceIndex;
+        memcpy( &triangleOffset, &light.position_or_triangleRange.x, sizeof( uint32_t ) );
+        memcpy( &instanceIndex, &light.position_or_triangleRange.z, sizeof( uint32_t ) );
+
+        const XMFLOAT3& v0 = m_Vertices[ m_Triangles[ triangleIndex * 3 ] ].position;
+        const XMFLOAT3& v1 = m_Vertices[ m_Triangles[ triangleIndex * 3 + 1 ] ].position;
+        const XMFLOAT3& v2 = m_Vertices[ m_Triangles[ triangleIndex * 3 + 2 ] ].position;
+        TriangleLightEvaluateWithPDF( light, m_InstanceTransforms[ instanceIndex ], v0, v1, v2, p, wi, normal, distance, radiance, pdf );
+        *pdf *= m_TriangleAliasTable[ light.triangleAliasTableOffset + triangleIndex - triangleOffset ].probability;
+    }
+    else if ( light.flags & LIGHT_FLAGS_ENVIRONMENT_LIGHT )
+    {
+        const XMFLOAT3 texel = m_HasEnvironmentTexture ? EvaluateEnvironmentTexture( wi ) : XMFLOAT3( 1.f, 1.f, 1.f );
+        *radiance = XMFLOAT3( texel.x * light.radiance.x, texel.y * light.radiance.y, texel.z * light.radiance.z );
+        *pdf = m_HasEnvironmentTexture && m_EnvironmentDistribution.m_CellCount != 0 ? m_EnvironmentDistribution.EvaluatePDF( wi ) : UniformSpherePDF();
+    }
+
+    if ( light.flags & ( LIGHT_FLAGS_ENVIRONMENT_LIGHT | LIGHT_FLAGS_DIRECTIONAL_LIGHT ) )
+    {
+        *pdf *= m_LightAliasTable[ lightIndex ].probability;
+    }
+    else
+    {
+        *pdf *= m_LightAliasTable[ m_Lights.size() ].probability * m_LightBVH.EvaluatePMF( p, light.lightBVHBitTrail );
+    }
+}
+
+// Same as GenerateRay and SampleAperture in the shaders
+void CCPUPathTracer::GenerateRay( const XMFLOAT2& filmSample, const XMFLOAT3& apertureSample, XMVECTOR* origin, XMVECTOR* direction ) const
+{
+    const XMVECTOR filmPos = XMVectorSet( ( -filmSample.x + 0.5f ) * m_FilmSize.x, ( filmSample.y - 0.5f ) * m_FilmSize.y, -m_FilmDistance, 0.f );
+
+    XMVECTOR localOrigin = XMVectorZero();
+    XMVECTOR localDirection = XMVector3Normalize( -filmPos );
+
+    if ( m_ApertureRadius > 0.f )
+    {
+        XMFLOAT2 aperturePos;
+        if ( m_BladeCount <= 2 )
+        {
+            aperturePos = ConcentricSampleDisk( XMFLOAT2( apertureSample.x, apertureSample.y ) );
+            aperturePos.x *= m_ApertureRadius;
+            aperturePos.y *= m_ApertureRadius;
+        }
+        else
+        {
+            // First sample the identity triangle, get the point p and then rotate it to the sampling blade
+            const XMFLOAT2 uv = SampleTriangle( XMFLOAT2( apertureSample.x, apertureSample.y ) );
+            const XMFLOAT2 p( m_BladeVertexPos.x * ( uv.x + uv.y ), m_BladeVertexPos.y * uv.x - m_BladeVertexPos.y * uv.y );
+            const float n = floorf( apertureSample.z * m_BladeCount );
+            const float theta = n * ( 2.f * XM_PI / m_BladeCount ) + m_ApertureBaseAngle;
+            aperturePos = XMFLOAT2( p.x * cosf( theta ) - p.y * sinf( theta ), p.y * cosf( theta ) + p.x * sinf( theta ) );
+        }
+        const XMVECTOR focusPoint = localDirection * ( m_FocalDistance / XMVectorGetZ( localDirection ) );
+        localOrigin = XMVectorSet( aperturePos.x, aperturePos.y, 0.f, 0.f );
+        localDirection = XMVector3Normalize( focusPoint - localOrigin );
+    }
+
+    const XMMATRIX cameraTransform = XMLoadFloat4x4( &m_CameraTransform );
+    *origin = XMVector3Transform( localOrigin, cameraTransform );
+    *direction = XMVector3TransformNormal( localDirection, cameraTransform );
+}
+
+// Same as the main function of the megakernel path tracer
+XMFLOAT3 CCPUPathTracer::TracePath( uint32_t pixelX, uint32_t pixelY, uint32_t frameSeed, XMFLOAT2* pixelSample, uint32_t* rayCount ) const
+{
+    SXoshiro128StarStar rng = InitializeRandomNumberGenerator( pixelX, pixelY, frameSeed );
+
+    const uint32_t lightCount = (uint32_t)m_Lights.size();
+    XMVECTOR pathThroughput = XMVectorSplatOne();
+    XMVECTOR l = XMVectorZero();
+    XMVECTOR wi;
+    SIntersection intersection;
+
+    *pixelSample = GetNextSample2D( &rng );
+    const XMFLOAT2 filmSample( ( pixelSample->x + pixelX ) / m_ResolutionWidth, ( pixelSample->y + pixelY ) / m_ResolutionHeight );
+    XMFLOAT3 apertureSample;
+    const XMFLOAT2 apertureSample2D = GetNextSample2D( &rng );
+    apertureSample = XMFLOAT3( apertureSample2D.x, apertureSample2D.y, GetNextSample1D( &rng ) );
+    XMVECTOR origin;
+    GenerateRay( filmSample, apertureSample, &origin, &wi );
+
+    // Same as IntersectScene in the shaders, the opacity sample is only drawn when any-hit shaders are allowed
+    float hitDistance = 0.f;
+    auto intersectScene = [ & ]( FXMVECTOR rayOrigin, FXMVECTOR rayDirection )
+    {
+        ++*rayCount;
+        intersection.m_LightIndex = LIGHT_INDEX_INVALID;
+        intersection.m_TriangleIndex = 0;
+        hitDistance = std::numeric_limits<float>::infinity();
+        const float opacitySample = m_AllowAnyHitShader ? GetNextSample1D( &rng ) : 0.f;
+        SHitInfo hitInfo;
+        if ( IntersectClosest( rayOrigin, rayDirection, opacitySample, &hitInfo ) )
+        {
+            hitDistance = hitInfo.m_T;
+            HitInfoToIntersection( hitInfo, &intersection );
+            return true;
+        }
+        return false;
+    };
+
+    bool hasHit = intersectScene( origin, wi );
+    if ( hasHit )
+    {
+        if ( m_IsLightVisible && intersection.m_LightIndex != LIGHT_INDEX_INVALID )
+        {
+            const XMVECTOR geometryNormal = XMLoadFloat3( &intersection.m_GeometryNormal );
+            l = XMVectorGetX( XMVector3Dot( -wi, geometryNormal ) ) > 0.f ? XMLoadFloat3( &m_Lights[ intersection.m_LightIndex ].radiance ) : XMVectorZero();
+        }
+
+        uint32_t iBounce = 0;
+        while ( iBounce <= m_MaxBounceCount && hasHit )
+        {
+            const XMVECTOR wo = -wi;
+            const XMVECTOR normal = XMLoadFloat3( &intersection.m_Normal );
+
+            // Sample light
+            if ( lightCount != 0 )
+            {
+                SLightSampleResult sampleResult;
+                SampleLightDirect( intersection.m_Position, &rng, &sampleResult );
+                const XMVECTOR lightWi = XMLoadFloat3( &sampleResult.m_Wi );
+                if ( ( sampleResult.m_Radiance.x > 0.f || sampleResult.m_Radiance.y > 0.f || sampleResult.m_Radiance.z > 0.f ) && sampleResult.m_Pdf > 0.f )
+                {
+                    ++*rayCount;
+                    const float opacitySample = m_AllowAnyHitShader ? GetNextSample1D( &rng ) : 0.f;
+                    const XMFLOAT3 shadowRayOrigin = OffsetRayOrigin( intersection.m_Position, intersection.m_GeometryNormal, sampleResult.m_Wi );
+                    if ( !IntersectAny( XMLoadFloat3( &shadowRayOrigin ), lightWi, sampleResult.m_Distance, opacitySample ) )
+                    {
+                        const XMVECTOR bsdf = EvaluateBSDF( lightWi, wo, intersection, m_BxDFTables, m_IsGGXVNDFSamplingEnabled );
+                        const float NdotWI = fabsf( XMVectorGetX( XMVector3Dot( normal, lightWi ) ) );
+                        const float bsdfPdf = EvaluateBSDFPdf( lightWi, wo, intersection, m_BxDFTables, m_IsGGXVNDFSamplingEnabled );
+                        const float weight = sampleResult.m_IsDeltaLight ? 1.f : PowerHeuristic( sampleResult.m_Pdf, bsdfPdf );
+                        l += pathThroughput * XMLoadFloat3( &sampleResult.m_Radiance ) * bsdf * ( NdotWI * weight / sampleResult.m_Pdf );
+                    }
+                }
+            }
+
+            // Sample BSDF
+            const float bsdfSelectionSample = GetNextSample1D( &rng );
+            const XMFLOAT2 bsdfSample = GetNextSample2D( &rng );
+
+            XMVECTOR bsdf;
+            float bsdfPdf;
+            bool isDeltaBxdf;
+            SampleBSDF( wo, bsdfSample, bsdfSelectionSample, intersection, m_BxDFTables, m_IsGGXVNDFSamplingEnabled, &wi, &bsdf, &bsdfPdf, &isDeltaBxdf );
+
+            if ( XMVector3Equal( bsdf, XMVectorZero() ) || bsdfPdf == 0.f )
+            {
+                break;
+            }
+
+            const float NdotWI = fabsf( XMVectorGetX( XMVector3Dot( normal, wi ) ) );
+            pathThroughput = pathThroughput * bsdf * ( NdotWI / bsdfPdf );
+
+            if ( iBounce >= m_RussianRouletteBounceCount )
+            {
+                XMFLOAT3 throughput;
+                XMStoreFloat3( &throughput, pathThroughput );
+                const float survivalProbability = CalculateRussianRouletteSurvivalProbability( throughput );
+                if ( GetNextSample1D( &rng ) >= survivalProbability )
+                {
+                    break;
+                }
+                pathThroughput /= XMVectorReplicate( survivalProbability );
+            }
+
+            const XMFLOAT3 shadingPosition = intersection.m_Position;
+            XMFLOAT3 wiFloat3;
+            XMStoreFloat3( &wiFloat3, wi );
+            const XMFLOAT3 rayOrigin = OffsetRayOrigin( intersection.m_Position, intersection.m_GeometryNormal, wiFloat3 );
+            hasHit = intersectScene( XMLoadFloat3( &rayOrigin ), wi );
+
+            const uint32_t lightIndex = hasHit ? intersection.m_LightIndex : m_EnvironmentLightIndex;
+            if ( lightIndex != LIGHT_INDEX_INVALID )
+            {
+                XMFLOAT3 radiance;
+                float lightPdf;
+                EvaluateLightDirect( shadingPosition, lightIndex, intersection.m_TriangleIndex, intersection.m_GeometryNormal, wiFloat3, hitDistance, &radiance, &lightPdf );
+                if ( lightPdf > 0.f )
+                {
+                    const float weight = !isDeltaBxdf ? PowerHeuristic( bsdfPdf, lightPdf ) : 1.f;
+                    l += pathThroughput * XMLoadFloat3( &radiance ) * weight;
+                }
+            }
+
+            ++iBounce;
+        }
+    }
+    else if ( m_IsLightVisible && m_EnvironmentLightIndex != LIGHT_INDEX_INVALID )
+    {
+        XMFLOAT3 direction;
+        XMStoreFloat3( &direction, wi );
+        const GPU::SLight& light = m_Lights[ m_EnvironmentLightIndex ];
+        const XMFLOAT3 texel = m_HasEnvironmentTexture ? EvaluateEnvironmentTexture( direction ) : XMFLOAT3( 1.f, 1.f, 1.f );
+        l = XMVectorSet( texel.x * light.radiance.x, texel.y * light.radiance.y, texel.z * light.radiance.z, 0.f );
+    }
+
+    XMFLOAT3 result;
+    XMStoreFloat3( &result, l );
+    return result;
+}
+
+float CCPUPathTracer::EvaluateFilter( float x, float y ) const
+{
+    auto gaussian = [ this ]( float d )
+    {
+        return std::max( 0.f, expf( -m_GaussianAlpha * d * d ) - m_GaussianExp );
+    };
+    auto mitchell1D = [ this ]( float x )
+    {
+        x = fabsf( 2 * x );
+        const float* f = m_MitchellFactors;
+        const float result = x < 1 ? f[ 4 ] * x * x * x + f[ 5 ] * x * x + f[ 6 ]
+            : ( x < 2 ? f[ 0 ] * x * x * x + f[ 1 ] * x * x + f[ 2 ] * x + f[ 3 ] : 0.f );
+        return result * ( 1.f / 6.f );
+    };
+    auto sinc = []( float x )
+    {
+        x = fabsf( x );
+        return x >= 1e-5f ? sinf( XM_PI * x ) / ( XM_PI * x ) : 1.f;
+    };
+    auto windowedSinc = [ this, &sinc ]( float x )
+    {
+        x = fabsf( x );
+        const float lanczos = sinc( x / m_LanczosSincTau );
+        return x > m_FilterRadius ? 0.f : sinc( x ) * lanczos;
+    };
+
+    switch ( (EFilter)m_Filter )
+    {
+    case EFilter::Triangle:
+        return std::max( 0.f, m_FilterRadius - fabsf( x ) ) * std::max( 0.f, m_FilterRadius - fabsf( y ) );
+    case EFilter::Gaussian:
+        return gaussian( x ) * gaussian( y );
+    case EFilter::Mitchell:
+        return mitchell1D( x / m_FilterRadius ) * mitchell1D( y / m_FilterRadius );
+    case EFilter::LanczosSinc:
+        return windowedSinc( x ) * windowedSinc( y );
+    default:
+        return fabsf( x ) <= m_FilterRadius && fabsf( y ) <= m_FilterRadius ? 1.f : 0.f;
+    }
+}
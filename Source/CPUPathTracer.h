@@ -0,0 +1,153 @@
+#pragma once
+
+#include "CPUBSDFs.h"
+#include "LightBVH.h"
+#include "EnvironmentLightDistribution.h"
+#include "../Shaders/Vertex.inc.hlsl"
+#include "../Shaders/BVHNode.inc.hlsl"
+#include "../Shaders/Material.inc.hlsl"
+#include "../Shaders/LightSharedDef.inc.hlsl"
+
+class CScene;
+struct SXoshiro128StarStar;
+
+// Top level of a scene texture decoded to linear RGBA, read the same way as through the shader resource view
+struct SCPUTexture
+{
+    // Bilinear filtering with wrap addressing, same as SampleLevel( UVWrapSampler, texcoord, 0 )
+    DirectX::XMFLOAT4 Sample( const DirectX::XMFLOAT2& texcoord ) const;
+
+    uint32_t m_Width = 0;
+    uint32_t m_Height = 0;
+    std::vector<DirectX::XMFLOAT4> m_Texels;
+};
+
+// Runs the algorithm of the megakernel path tracer on the CPU, the same random numbers are drawn in the same order so a frame rendered with the
+// same frame seed converges to the same image. The scene is copied in the layout of the GPU buffers when the path tracer is created, later edits
+// of the scene are not seen until it is created again. Frames are rendered in tiles on worker threads and accumulated in an HDR film with the
+// filter of the scene.
+class CCPUPathTracer
+{
+public:
+    // Kulla-Conty tables are integrated on the first call with BxDFTableSampleCount samples per texel and kept for later calls
+    bool Create( CScene* scene, uint32_t BxDFTableSampleCount = 8192 );
+
+    // Renders one sample per pixel for each frame seed in [ firstFrameSeed, firstFrameSeed + sampleCount ), same as that many frames of the megakernel
+    // path tracer with the sample count frame seed type
+    void Render( uint32_t sampleCount, uint32_t firstFrameSeed = 0, uint32_t maxWorkerCount = 0 );
+
+    void ResetFilm();
+
+    // Writes the film divided by the filter weights
+    bool WriteFilmToFile( const std::filesystem::path& filepath ) const;
+
+    uint32_t GetResolutionWidth() const { return m_ResolutionWidth; }
+
+    uint32_t GetResolutionHeight() const { return m_ResolutionHeight; }
+
+    uint32_t GetSampleCount() const { return m_SampleCount; }
+
+    // Sum of the filtered samples in xyz and of the filter weights in w, same as the film texture
+    const std::vector<DirectX::XMFLOAT4>& GetFilm() const { return m_Film; }
+
+    uint64_t GetRayCount() const { return m_RayCount; }
+
+    float GetRenderSeconds() const { return m_RenderSeconds; }
+
+private:
+    struct SHitInfo
+    {
+        float m_T;
+        float m_U;
+        float m_V;
+        uint32_t m_TriangleIndex;
+        uint32_t m_InstanceIndex;
+        bool m_Backface;
+    };
+
+    struct SLightSampleResult
+    {
+        DirectX::XMFLOAT3 m_Radiance;
+        DirectX::XMFLOAT3 m_Wi;
+        float m_Pdf;
+        float m_Distance;
+        bool m_IsDeltaLight;
+    };
+
+    bool XM_CALLCONV IntersectClosest( DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float opacitySample, SHitInfo* hitInfo ) const;
+
+    bool XM_CALLCONV IntersectAny( DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float tMax, float opacitySample ) const;
+
+    template <bool IsAnyHit>
+    bool XM_CALLCONV Traverse( DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float tMax, float opacitySample, SHitInfo* hitInfo ) const;
+
+    bool AnyHitShader( uint32_t triangleIndex, uint32_t materialOverride, float u, float v, float opacitySample ) const;
+
+    void HitInfoToIntersection( const SHitInfo& hitInfo, SIntersection* intersection ) const;
+
+    DirectX::XMFLOAT3 EvaluateEnvironmentTexture( const DirectX::XMFLOAT3& direction ) const;
+
+    void SampleLightDirect( const DirectX::XMFLOAT3& p, SXoshiro128StarStar* rng, SLightSampleResult* result ) const;
+
+    void EvaluateLightDirect( const DirectX::XMFLOAT3& p, uint32_t lightIndex, uint32_t triangleIndex, const DirectX::XMFLOAT3& normal, const DirectX::XMFLOAT3& wi,
+        float distance, DirectX::XMFLOAT3* radiance, float* pdf ) const;
+
+    void GenerateRay( const DirectX::XMFLOAT2& filmSample, const DirectX::XMFLOAT3& apertureSample, DirectX::XMVECTOR* origin, DirectX::XMVECTOR* direction ) const;
+
+    DirectX::XMFLOAT3 TracePath( uint32_t pixelX, uint32_t pixelY, uint32_t frameSeed, DirectX::XMFLOAT2* pixelSample, uint32_t* rayCount ) const;
+
+    float EvaluateFilter( float x, float y ) const;
+
+private:
+    std::vector<GPU::Vertex> m_Vertices;
+    std::vector<uint32_t> m_Triangles;
+    std::vector<uint32_t> m_MaterialIds;
+    std::vector<GPU::BVHNode> m_BVHNodes;
+    std::vector<DirectX::XMFLOAT4X3> m_InstanceTransforms;
+    std::vector<DirectX::XMFLOAT4X3> m_InstanceInvTransforms;
+    std::vector<uint32_t> m_InstanceLightIndices;
+    std::vector<uint32_t> m_InstanceMaterialOverrides;
+    std::vector<uint32_t> m_InstanceFlags;
+    std::vector<GPU::Material> m_Materials;
+    std::vector<SCPUTexture> m_Textures;
+    std::vector<GPU::SLight> m_Lights;
+    std::vector<GPU::SAliasTableEntry> m_LightAliasTable;
+    std::vector<GPU::SAliasTableEntry> m_TriangleAliasTable;
+    SLightBVH m_LightBVH;
+    SEnvironmentLightDistribution m_EnvironmentDistribution;
+    SEnvironmentLightRadiance m_EnvironmentRadiance;
+    bool m_HasEnvironmentTexture = false;
+    uint32_t m_EnvironmentLightIndex = LIGHT_INDEX_INVALID;
+    SBxDFTables m_BxDFTables;
+
+    DirectX::XMFLOAT4X4 m_CameraTransform;
+    DirectX::XMFLOAT2 m_FilmSize;
+    float m_FilmDistance = 0.f;
+    float m_ApertureRadius = 0.f;
+    float m_FocalDistance = 0.f;
+    uint32_t m_BladeCount = 0;
+    DirectX::XMFLOAT2 m_BladeVertexPos;
+    float m_ApertureBaseAngle = 0.f;
+    uint32_t m_MaxBounceCount = 0;
+    uint32_t m_RussianRouletteBounceCount = 0;
+
+    uint32_t m_Filter = 0;
+    float m_FilterRadius = 1.f;
+    float m_GaussianAlpha = 0.f;
+    float m_GaussianExp = 0.f;
+    float m_MitchellFactors[ 7 ] = {};
+    uint32_t m_LanczosSincTau = 3;
+
+    bool m_TraverseBVHFrontToBack = true;
+    bool m_IsGGXVNDFSamplingEnabled = true;
+    bool m_IsLightVisible = true;
+    bool m_WatertightRayTriangleIntersection = true;
+    bool m_AllowAnyHitShader = false;
+
+    uint32_t m_ResolutionWidth = 0;
+    uint32_t m_ResolutionHeight = 0;
+    uint32_t m_SampleCount = 0;
+    std::vector<DirectX::XMFLOAT4> m_Film;
+    uint64_t m_RayCount = 0;
+    float m_RenderSeconds = 0.f;
+};
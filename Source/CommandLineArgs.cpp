@@ -9,6 +9,19 @@ CommandLineArgs::CommandLineArgs()
     , m_ShaderDebugEnabled( false )
     , m_UseDebugDevice( false )
     , m_OutputBVHToFile( false )
+    , m_XMLParsingBenchmarkShapeCount( 0 )
+    , m_LogBenchmark( false )
+    , m_ValidateLightSampling( false )
+    , m_ValidateRussianRoulette( false )
+    , m_ValidateBSDFs( false )
+    , m_ValidateMipGeneration( false )
+    , m_TextureCompressionEnabled( false )
+    , m_TextureCacheEnabled( false )
+    , m_TextureCacheSizeLimit( 4096ull * 1024 * 1024 )
+    , m_BatchSampleCount( 0 )
+    , m_BatchTimeLimit( 0.f )
+    , m_BatchThreadCount( 0 )
+    , m_BatchIntegrator( EBatchIntegrator::CPU )
 {
     assert( s_Singleton == nullptr );
     s_Singleton = this;
@@ -52,6 +65,156 @@ void CommandLineArgs::Parse( const wchar_t* cmdLine )
         {
             m_OutputBVHToFile = true;
         }
+        else if ( wcscmp( argStr, L"-TextureDecodingBenchmark" ) == 0 && iArg + 1 < numArgs )
+        {
+            wchar_t* argStr1 = argv[ ++iArg ];
+            char mbDirectory[ MAX_PATH ];
+            errno_t err = (errno_t)wcstombs( mbDirectory, argStr1, MAX_PATH );
+            m_TextureDecodingBenchmarkDirectory = mbDirectory;
+        }
+        else if ( wcscmp( argStr, L"-TextureCompressionBenchmark" ) == 0 && iArg + 1 < numArgs )
+        {
+            wchar_t* argStr1 = argv[ ++iArg ];
+            char mbDirectory[ MAX_PATH ];
+            errno_t err = (errno_t)wcstombs( mbDirectory, argStr1, MAX_PATH );
+            m_TextureCompressionBenchmarkDirectory = mbDirectory;
+        }
+        else if ( wcscmp( argStr, L"-ImageWritingBenchmark" ) == 0 && iArg + 1 < numArgs )
+        {
+            wchar_t* argStr1 = argv[ ++iArg ];
+            char mbDirectory[ MAX_PATH ];
+            errno_t err = (errno_t)wcstombs( mbDirectory, argStr1, MAX_PATH );
+            m_ImageWritingBenchmarkDirectory = mbDirectory;
+        }
+        else if ( wcscmp( argStr, L"-TraversalBenchmark" ) == 0 && iArg + 1 < numArgs )
+        {
+            wchar_t* argStr1 = argv[ ++iArg ];
+            char mbFilename[ MAX_PATH ];
+            errno_t err = (errno_t)wcstombs( mbFilename, argStr1, MAX_PATH );
+            m_TraversalBenchmarkFilename = mbFilename;
+        }
+        else if ( wcscmp( argStr, L"-MeshLoadingBenchmark" ) == 0 && iArg + 2 < numArgs )
+        {
+            char mbFilename[ MAX_PATH ];
+            errno_t err = (errno_t)wcstombs( mbFilename, argv[ ++iArg ], MAX_PATH );
+            m_MeshLoadingBenchmarkOBJFilename = mbFilename;
+            err = (errno_t)wcstombs( mbFilename, argv[ ++iArg ], MAX_PATH );
+            m_MeshLoadingBenchmarkPLYFilename = mbFilename;
+        }
+        else if ( wcscmp( argStr, L"-XMLParsingBenchmark" ) == 0 && iArg + 1 < numArgs )
+        {
+            wchar_t* argStr1 = argv[ ++iArg ];
+            wchar_t* end;
+            m_XMLParsingBenchmarkShapeCount = (uint32_t) wcstoul( argStr1, &end, 10 );
+        }
+        else if ( wcscmp( argStr, L"-TraceLoad" ) == 0 && iArg + 1 < numArgs )
+        {
+            wchar_t* argStr1 = argv[ ++iArg ];
+            char mbFilename[ MAX_PATH ];
+            errno_t err = (errno_t)wcstombs( mbFilename, argStr1, MAX_PATH );
+            m_LoadTraceFilename = mbFilename;
+        }
+        else if ( wcscmp( argStr, L"-MemoryReport" ) == 0 && iArg + 1 < numArgs )
+        {
+            wchar_t* argStr1 = argv[ ++iArg ];
+            char mbFilename[ MAX_PATH ];
+            errno_t err = (errno_t)wcstombs( mbFilename, argStr1, MAX_PATH );
+            m_MemoryReportFilename = mbFilename;
+        }
+        else if ( wcscmp( argStr, L"-LogFile" ) == 0 && iArg + 1 < numArgs )
+        {
+            wchar_t* argStr1 = argv[ ++iArg ];
+            char mbFilename[ MAX_PATH ];
+            errno_t err = (errno_t)wcstombs( mbFilename, argStr1, MAX_PATH );
+            m_LogFilename = mbFilename;
+        }
+        else if ( wcscmp( argStr, L"-LogBenchmark" ) == 0 )
+        {
+            m_LogBenchmark = true;
+        }
+        else if ( wcscmp( argStr, L"-ValidateLightSampling" ) == 0 )
+        {
+            m_ValidateLightSampling = true;
+        }
+        else if ( wcscmp( argStr, L"-ValidateRussianRoulette" ) == 0 )
+        {
+            m_ValidateRussianRoulette = true;
+        }
+        else if ( wcscmp( argStr, L"-ValidateBSDFs" ) == 0 )
+        {
+            m_ValidateBSDFs = true;
+        }
+        else if ( wcscmp( argStr, L"-ValidateMipGeneration" ) == 0 )
+        {
+            m_ValidateMipGeneration = true;
+        }
+        else if ( wcscmp( argStr, L"-CompressTextures" ) == 0 )
+        {
+            m_TextureCompressionEnabled = true;
+        }
+        else if ( wcscmp( argStr, L"-TextureCache" ) == 0 && iArg + 1 < numArgs )
+        {
+            // The cache is opt-in since it writes up to the size limit into the given directory
+            wchar_t* argStr1 = argv[ ++iArg ];
+            char mbDirectory[ MAX_PATH ];
+            errno_t err = (errno_t)wcstombs( mbDirectory, argStr1, MAX_PATH );
+            m_TextureCacheDirectory = mbDirectory;
+            m_TextureCacheEnabled = true;
+        }
+        else if ( wcscmp( argStr, L"-TextureCacheSizeMB" ) == 0 && iArg + 1 < numArgs )
+        {
+            wchar_t* argStr1 = argv[ ++iArg ];
+            wchar_t* end;
+            m_TextureCacheSizeLimit = (uint64_t) wcstoull( argStr1, &end, 10 ) * 1024 * 1024;
+        }
+        else if ( wcscmp( argStr, L"-out" ) == 0 && iArg + 1 < numArgs )
+        {
+            wchar_t* argStr1 = argv[ ++iArg ];
+            char mbFilename[ MAX_PATH ];
+            errno_t err = (errno_t)wcstombs( mbFilename, argStr1, MAX_PATH );
+            m_BatchOutputFilename = mbFilename;
+        }
+        else if ( wcscmp( argStr, L"-spp" ) == 0 && iArg + 1 < numArgs )
+        {
+            wchar_t* argStr1 = argv[ ++iArg ];
+            wchar_t* end;
+            m_BatchSampleCount = (uint32_t) wcstoul( argStr1, &end, 10 );
+        }
+        else if ( wcscmp( argStr, L"-time" ) == 0 && iArg + 1 < numArgs )
+        {
+            wchar_t* argStr1 = argv[ ++iArg ];
+            wchar_t* end;
+            m_BatchTimeLimit = (float) wcstod( argStr1, &end );
+        }
+        else if ( wcscmp( argStr, L"-threads" ) == 0 && iArg + 1 < numArgs )
+        {
+            wchar_t* argStr1 = argv[ ++iArg ];
+            wchar_t* end;
+            m_BatchThreadCount = (uint32_t) wcstoul( argStr1, &end, 10 );
+        }
+        else if ( wcscmp( argStr, L"-integrator" ) == 0 && iArg + 1 < numArgs )
+        {
+            wchar_t* argStr1 = argv[ ++iArg ];
+            if ( _wcsicmp( argStr1, L"Megakernel" ) == 0 )
+            {
+                m_BatchIntegrator = EBatchIntegrator::Megakernel;
+            }
+            else if ( _wcsicmp( argStr1, L"Wavefront" ) == 0 )
+            {
+                m_BatchIntegrator = EBatchIntegrator::Wavefront;
+            }
+            else if ( _wcsicmp( argStr1, L"CPU" ) == 0 )
+            {
+                m_BatchIntegrator = EBatchIntegrator::CPU;
+            }
+            else
+            {
+                char mbIntegrator[ MAX_PATH ];
+                errno_t err = (errno_t)wcstombs( mbIntegrator, argStr1, MAX_PATH );
+                m_UnknownBatchIntegratorName = mbIntegrator;
+                m_BatchIntegrator = EBatchIntegrator::Unknown;
+            }
+        }
         else if ( iArg == numArgs - 1 )
         {
             char mbFinename[ MAX_PATH ];
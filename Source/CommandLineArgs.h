@@ -1,5 +1,7 @@
 #pragma once
 
+enum class EBatchIntegrator { CPU, Megakernel, Wavefront, Unknown };
+
 class CommandLineArgs
 {
 public:
@@ -17,6 +19,58 @@ public:
 
     bool GetOutputBVHToFile() const { return m_OutputBVHToFile; }
 
+    const std::string& GetTextureDecodingBenchmarkDirectory() const { return m_TextureDecodingBenchmarkDirectory; }
+
+    const std::string& GetTextureCompressionBenchmarkDirectory() const { return m_TextureCompressionBenchmarkDirectory; }
+
+    const std::string& GetImageWritingBenchmarkDirectory() const { return m_ImageWritingBenchmarkDirectory; }
+
+    const std::string& GetTraversalBenchmarkFilename() const { return m_TraversalBenchmarkFilename; }
+
+    const std::string& GetMeshLoadingBenchmarkOBJFilename() const { return m_MeshLoadingBenchmarkOBJFilename; }
+
+    const std::string& GetMeshLoadingBenchmarkPLYFilename() const { return m_MeshLoadingBenchmarkPLYFilename; }
+
+    uint32_t GetXMLParsingBenchmarkShapeCount() const { return m_XMLParsingBenchmarkShapeCount; }
+
+    const std::string& GetLoadTraceFilename() const { return m_LoadTraceFilename; }
+
+    const std::string& GetMemoryReportFilename() const { return m_MemoryReportFilename; }
+
+    const std::string& GetLogFilename() const { return m_LogFilename; }
+
+    bool GetLogBenchmark() const { return m_LogBenchmark; }
+
+    bool GetValidateLightSampling() const { return m_ValidateLightSampling; }
+
+    bool GetValidateRussianRoulette() const { return m_ValidateRussianRoulette; }
+
+    bool GetValidateBSDFs() const { return m_ValidateBSDFs; }
+
+    bool GetValidateMipGeneration() const { return m_ValidateMipGeneration; }
+
+    bool GetTextureCompressionEnabled() const { return m_TextureCompressionEnabled; }
+
+    bool GetTextureCacheEnabled() const { return m_TextureCacheEnabled; }
+
+    const std::string& GetTextureCacheDirectory() const { return m_TextureCacheDirectory; }
+
+    uint64_t GetTextureCacheSizeLimit() const { return m_TextureCacheSizeLimit; }
+
+    bool IsBatchRenderEnabled() const { return !m_BatchOutputFilename.empty(); }
+
+    const std::string& GetBatchOutputFilename() const { return m_BatchOutputFilename; }
+
+    uint32_t GetBatchSampleCount() const { return m_BatchSampleCount; }
+
+    float GetBatchTimeLimit() const { return m_BatchTimeLimit; }
+
+    uint32_t GetBatchThreadCount() const { return m_BatchThreadCount; }
+
+    EBatchIntegrator GetBatchIntegrator() const { return m_BatchIntegrator; }
+
+    const std::string& GetUnknownBatchIntegratorName() const { return m_UnknownBatchIntegratorName; }
+
     static const CommandLineArgs* Singleton() { return s_Singleton; }
 
 private:
@@ -26,6 +80,31 @@ private:
     bool        m_UseDebugDevice;
     std::string m_Filename;
     bool        m_OutputBVHToFile;
+    std::string m_TextureDecodingBenchmarkDirectory;
+    std::string m_TextureCompressionBenchmarkDirectory;
+    std::string m_ImageWritingBenchmarkDirectory;
+    std::string m_TraversalBenchmarkFilename;
+    std::string m_MeshLoadingBenchmarkOBJFilename;
+    std::string m_MeshLoadingBenchmarkPLYFilename;
+    uint32_t    m_XMLParsingBenchmarkShapeCount;
+    std::string m_LoadTraceFilename;
+    std::string m_MemoryReportFilename;
+    std::string m_LogFilename;
+    bool        m_LogBenchmark;
+    bool        m_ValidateLightSampling;
+    bool        m_ValidateRussianRoulette;
+    bool        m_ValidateBSDFs;
+    bool        m_ValidateMipGeneration;
+    bool        m_TextureCompressionEnabled;
+    bool        m_TextureCacheEnabled;
+    std::string m_TextureCacheDirectory;
+    uint64_t    m_TextureCacheSizeLimit;
+    std::string m_BatchOutputFilename;
+    uint32_t    m_BatchSampleCount;
+    float       m_BatchTimeLimit;
+    uint32_t    m_BatchThreadCount;
+    EBatchIntegrator m_BatchIntegrator;
+    std::string m_UnknownBatchIntegratorName;
 
     static CommandLineArgs* s_Singleton;
 };
\ No newline at end of file
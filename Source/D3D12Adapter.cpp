@@ -123,7 +123,7 @@ SD3D12DescriptorHandle D3D12Adapter::GetNullBufferUAV()
     return g_NullBufferUAV;
 }
 
-bool D3D12Adapter::Init( HWND hWnd )
+bool D3D12Adapter::Init( HWND hWnd, bool useWarpAdapter )
 {
     if ( CommandLineArgs::Singleton()->UseDebugDevice() )
     {
@@ -147,13 +147,30 @@ bool D3D12Adapter::Init( HWND hWnd )
         g_SupportTearing = SUCCEEDED( hr ) && allowTearing;
     }
 
-    HRESULT hr = D3D12CreateDevice( nullptr, D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS( &g_Device ) );
+    ComPtr<IDXGIAdapter> warpAdapter;
+    if ( useWarpAdapter )
+    {
+        ComPtr<IDXGIFactory4> factory;
+        HRESULT hr = CreateDXGIFactory1( IID_PPV_ARGS( &factory ) );
+        if ( SUCCEEDED( hr ) )
+        {
+            hr = factory->EnumWarpAdapter( IID_PPV_ARGS( &warpAdapter ) );
+        }
+        if ( FAILED( hr ) )
+        {
+            LOG_STRING_FORMAT( "Failed to enumerate the WARP adapter with result %x.\n", hr );
+            return false;
+        }
+    }
+
+    HRESULT hr = D3D12CreateDevice( warpAdapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS( &g_Device ) );
     if ( FAILED( hr ) )
     {
         return false;
     }
 
-    // Requires shader mode 6.6
+    // Requires shader mode 6.6, no shader is run on the WARP device
+    if ( !useWarpAdapter )
     {
         D3D12_FEATURE_DATA_SHADER_MODEL featureData;
         featureData.HighestShaderModel = D3D_SHADER_MODEL_6_6;
@@ -181,30 +198,34 @@ bool D3D12Adapter::Init( HWND hWnd )
         return false;
     }
 
-    UINT dxgiFactoryFlags = CommandLineArgs::Singleton()->UseDebugDevice() ? DXGI_CREATE_FACTORY_DEBUG : 0;
-    ComPtr<IDXGIFactory4> factory;
-    hr = CreateDXGIFactory2( dxgiFactoryFlags, IID_PPV_ARGS( &factory ) );
-    if ( FAILED( hr ) )
+    // Without a window nothing is presented, the frames still cycle through the backbuffer count of command allocators and upload arenas
+    if ( hWnd )
     {
-        return false;
-    }
+        UINT dxgiFactoryFlags = CommandLineArgs::Singleton()->UseDebugDevice() ? DXGI_CREATE_FACTORY_DEBUG : 0;
+        ComPtr<IDXGIFactory4> factory;
+        hr = CreateDXGIFactory2( dxgiFactoryFlags, IID_PPV_ARGS( &factory ) );
+        if ( FAILED( hr ) )
+        {
+            return false;
+        }
 
-    DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
-    swapChainDesc.Format = DXGI_FORMAT::DXGI_FORMAT_R8G8B8A8_UNORM;
-    swapChainDesc.SampleDesc.Count = 1;
-    swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-    swapChainDesc.BufferCount = BACKBUFFER_COUNT;
-    swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT::DXGI_SWAP_EFFECT_FLIP_DISCARD;
-    swapChainDesc.Flags = g_SupportTearing ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0;
+        DXGI_SWAP_CHAIN_DESC1 swapChainDesc = {};
+        swapChainDesc.Format = DXGI_FORMAT::DXGI_FORMAT_R8G8B8A8_UNORM;
+        swapChainDesc.SampleDesc.Count = 1;
+        swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+        swapChainDesc.BufferCount = BACKBUFFER_COUNT;
+        swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT::DXGI_SWAP_EFFECT_FLIP_DISCARD;
+        swapChainDesc.Flags = g_SupportTearing ? DXGI_SWAP_CHAIN_FLAG_ALLOW_TEARING : 0;
 
-    ComPtr<IDXGISwapChain1> swapChain;
-    hr = factory->CreateSwapChainForHwnd( g_CommandQueue.Get(), hWnd, &swapChainDesc, nullptr, nullptr, swapChain.GetAddressOf() );
-    if ( FAILED( hr ) )
-    {
-        return false;
-    }
+        ComPtr<IDXGISwapChain1> swapChain;
+        hr = factory->CreateSwapChainForHwnd( g_CommandQueue.Get(), hWnd, &swapChainDesc, nullptr, nullptr, swapChain.GetAddressOf() );
+        if ( FAILED( hr ) )
+        {
+            return false;
+        }
 
-    swapChain.As( &g_SwapChain );
+        swapChain.As( &g_SwapChain );
+    }
 
     for ( uint32_t index = 0; index < BACKBUFFER_COUNT; ++index )
     {
@@ -215,7 +236,7 @@ bool D3D12Adapter::Init( HWND hWnd )
         }
     }
 
-    g_BackbufferIndex = g_SwapChain->GetCurrentBackBufferIndex();
+    g_BackbufferIndex = g_SwapChain ? g_SwapChain->GetCurrentBackBufferIndex() : 0;
 
     hr = g_Device->CreateCommandList( 0, D3D12_COMMAND_LIST_TYPE_DIRECT, g_CommandAllocators[ g_BackbufferIndex ].Get(), nullptr, IID_PPV_ARGS( &g_CommandList ) );
     if ( FAILED( hr ) )
@@ -421,7 +442,7 @@ bool D3D12Adapter::MoveToNextFrame()
     }
 
     // Update the backbuffer index.
-    g_BackbufferIndex = g_SwapChain->GetCurrentBackBufferIndex();
+    g_BackbufferIndex = g_SwapChain ? g_SwapChain->GetCurrentBackBufferIndex() : ( g_BackbufferIndex + 1 ) % BACKBUFFER_COUNT;
 
     // If the next frame is not ready to be rendered yet, wait until it is ready.
     if ( g_Fence->GetCompletedValue() < g_FenceValues[ g_BackbufferIndex ] )
@@ -473,5 +494,10 @@ void D3D12Adapter::ResizeSwapChainBuffers( uint32_t width, uint32_t height )
 
 void D3D12Adapter::Present( UINT syncInterval )
 {
+    if ( !g_SwapChain )
+    {
+        return;
+    }
+
     g_SwapChain->Present( syncInterval, g_SupportTearing ? DXGI_PRESENT_ALLOW_TEARING : 0 );
 }
@@ -26,7 +26,9 @@ namespace D3D12Adapter
 
     uint32_t GetDescriptorSize( D3D12_DESCRIPTOR_HEAP_TYPE type );
 
-    bool Init( HWND hWnd );
+    // No swap chain is created without a window. The WARP adapter is the software rasterizer, it lets scenes be loaded for the CPU path tracer
+    // on machines without a GPU and is not checked for shader model 6.6.
+    bool Init( HWND hWnd, bool useWarpAdapter = false );
 
     void Destroy();
 
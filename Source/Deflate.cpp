@@ -0,0 +1,559 @@
+#include "stdafx.h"
+#include "Deflate.h"
+
+namespace
+{
+    const uint32_t s_MaxCodeBits = 15;
+    const uint32_t s_MaxCodeLengthCodeBits = 7;
+    const uint32_t s_LiteralLengthCodeCount = 286;
+    const uint32_t s_DistanceCodeCount = 30;
+    const uint32_t s_CodeLengthCodeCount = 19;
+    const uint32_t s_EndOfBlockSymbol = 256;
+
+    const uint32_t s_MinMatchLength = 3;
+    const uint32_t s_MaxMatchLength = 258;
+    const uint32_t s_WindowSize = 32768;
+    const uint32_t s_HashBits = 15;
+    const uint32_t s_MaxChainLength = 16;
+    const uint32_t s_MaxInsertMatchLength = 16;
+    const uint32_t s_MaxBlockTokenCount = 32768;
+    const uint32_t s_MaxStoredBlockSize = 65535;
+
+    const uint16_t s_LengthBase[ 29 ] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint16_t s_LengthExtraBits[ 29 ] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t s_DistanceBase[ 30 ] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint16_t s_DistanceExtraBits[ 30 ] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    const uint8_t s_CodeLengthOrder[ 19 ] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    // Maps match lengths and distances to their codes. Distances above 256 are looked up by ( distance - 1 ) >> 7 like zlib does.
+    struct SSymbolTables
+    {
+        SSymbolTables()
+        {
+            for ( uint32_t code = 0; code < 29; ++code )
+            {
+                const uint32_t end = code == 28 ? s_MaxMatchLength + 1 : s_LengthBase[ code + 1 ];
+                for ( uint32_t length = s_LengthBase[ code ]; length < end; ++length )
+                {
+                    m_LengthCodes[ length ] = (uint8_t)code;
+                }
+            }
+
+            for ( uint32_t code = 0; code < s_DistanceCodeCount; ++code )
+            {
+                const uint32_t end = code == s_DistanceCodeCount - 1 ? s_WindowSize + 1 : s_DistanceBase[ code + 1 ];
+                for ( uint32_t distance = s_DistanceBase[ code ]; distance < end; ++distance )
+                {
+                    if ( distance <= 256 )
+                    {
+                        m_DistanceCodes[ distance - 1 ] = (uint8_t)code;
+                    }
+                    else
+                    {
+                        m_DistanceCodes[ 256 + ( ( distance - 1 ) >> 7 ) ] = (uint8_t)code;
+                    }
+                }
+            }
+
+            for ( uint32_t i = 0; i < 256; ++i )
+            {
+                uint32_t crc = i;
+                for ( uint32_t bit = 0; bit < 8; ++bit )
+                {
+                    crc = ( crc & 1 ) ? 0xEDB88320 ^ ( crc >> 1 ) : crc >> 1;
+                }
+                m_CRCTable[ i ] = crc;
+            }
+        }
+
+        uint32_t GetDistanceCode( uint32_t distance ) const
+        {
+            return distance <= 256 ? m_DistanceCodes[ distance - 1 ] : m_DistanceCodes[ 256 + ( ( distance - 1 ) >> 7 ) ];
+        }
+
+        uint8_t m_LengthCodes[ s_MaxMatchLength + 1 ];
+        uint8_t m_DistanceCodes[ 512 ];
+        uint32_t m_CRCTable[ 256 ];
+    };
+
+    const SSymbolTables s_SymbolTables;
+
+    // A literal, or a match when m_Distance is not 0
+    struct SToken
+    {
+        uint16_t m_LiteralOrLength;
+        uint16_t m_Distance;
+    };
+
+    struct SHuffmanCode
+    {
+        uint16_t m_Codes[ s_LiteralLengthCodeCount ];
+        uint8_t m_Lengths[ s_LiteralLengthCodeCount ];
+    };
+
+    struct SBitWriter
+    {
+        std::vector<uint8_t>* m_Output;
+        uint64_t m_BitBuffer = 0;
+        uint32_t m_BitCount = 0;
+
+        void WriteBits( uint32_t bits, uint32_t count )
+        {
+            m_BitBuffer |= (uint64_t)bits << m_BitCount;
+            m_BitCount += count;
+            while ( m_BitCount >= 8 )
+            {
+                m_Output->push_back( (uint8_t)m_BitBuffer );
+                m_BitBuffer >>= 8;
+                m_BitCount -= 8;
+            }
+        }
+
+        void AlignToByte()
+        {
+            if ( m_BitCount > 0 )
+            {
+                WriteBits( 0, 8 - m_BitCount );
+            }
+        }
+    };
+}
+
+// Builds code lengths limited to maxBits. Frequencies are flattened and the tree rebuilt until it fits, which costs a little ratio on
+// pathological inputs but is much simpler than package-merge. At least two symbols always get a code so every decoder accepts the tree.
+static void BuildHuffmanCodeLengths( const uint32_t* frequencies, uint32_t symbolCount, uint32_t maxBits, uint8_t* lengths )
+{
+    std::vector<uint32_t> scaledFrequencies( frequencies, frequencies + symbolCount );
+    uint32_t usedSymbolCount = 0;
+    for ( uint32_t symbol = 0; symbol < symbolCount && usedSymbolCount < 2; ++symbol )
+    {
+        usedSymbolCount += scaledFrequencies[ symbol ] > 0 ? 1 : 0;
+    }
+    for ( uint32_t symbol = 0; symbol < symbolCount && usedSymbolCount < 2; ++symbol )
+    {
+        if ( scaledFrequencies[ symbol ] == 0 )
+        {
+            scaledFrequencies[ symbol ] = 1;
+            ++usedSymbolCount;
+        }
+    }
+
+    struct SNode
+    {
+        uint64_t m_Frequency;
+        int32_t m_Children[ 2 ]; // Symbol index when m_Children[ 1 ] is -1
+    };
+    std::vector<SNode> nodes;
+    std::vector<uint32_t> depths;
+    while ( true )
+    {
+        nodes.clear();
+        typedef std::pair<uint64_t, int32_t> FrequencyNodePair;
+        std::priority_queue<FrequencyNodePair, std::vector<FrequencyNodePair>, std::greater<FrequencyNodePair>> queue;
+        for ( uint32_t symbol = 0; symbol < symbolCount; ++symbol )
+        {
+            if ( scaledFrequencies[ symbol ] > 0 )
+            {
+                queue.push( { scaledFrequencies[ symbol ], (int32_t)nodes.size() } );
+                nodes.push_back( { scaledFrequencies[ symbol ], { (int32_t)symbol, -1 } } );
+            }
+        }
+        while ( queue.size() > 1 )
+        {
+            const FrequencyNodePair first = queue.top();
+            queue.pop();
+            const FrequencyNodePair second = queue.top();
+            queue.pop();
+            queue.push( { first.first + second.first, (int32_t)nodes.size() } );
+            nodes.push_back( { first.first + second.first, { first.second, second.second } } );
+        }
+
+        // Children always precede their parent, so depths are propagated from the root downwards in a single reverse pass
+        depths.assign( nodes.size(), 0 );
+        uint32_t maxDepth = 0;
+        memset( lengths, 0, symbolCount );
+        for ( size_t iNode = nodes.size(); iNode-- > 0; )
+        {
+            const SNode& node = nodes[ iNode ];
+            if ( node.m_Children[ 1 ] == -1 )
+            {
+                lengths[ node.m_Children[ 0 ] ] = (uint8_t)std::min( depths[ iNode ], 255u );
+                maxDepth = std::max( maxDepth, depths[ iNode ] );
+            }
+            else
+            {
+                depths[ node.m_Children[ 0 ] ] = depths[ iNode ] + 1;
+                depths[ node.m_Children[ 1 ] ] = depths[ iNode ] + 1;
+            }
+        }
+
+        if ( maxDepth <= maxBits )
+        {
+            break;
+        }
+        for ( uint32_t& frequency : scaledFrequencies )
+        {
+            frequency = frequency > 0 ? ( frequency >> 1 ) | 1 : 0;
+        }
+    }
+}
+
+// Assigns canonical codes, bit reversed since deflate packs Huffman codes starting from their most significant bit
+static void BuildHuffmanCodes( const uint8_t* lengths, uint32_t symbolCount, uint16_t* codes )
+{
+    uint32_t lengthCounts[ s_MaxCodeBits + 1 ] = {};
+    for ( uint32_t symbol = 0; symbol < symbolCount; ++symbol )
+    {
+        ++lengthCounts[ lengths[ symbol ] ];
+    }
+    lengthCounts[ 0 ] = 0;
+
+    uint32_t nextCodes[ s_MaxCodeBits + 1 ] = {};
+    uint32_t code = 0;
+    for ( uint32_t bits = 1; bits <= s_MaxCodeBits; ++bits )
+    {
+        code = ( code + lengthCounts[ bits - 1 ] ) << 1;
+        nextCodes[ bits ] = code;
+    }
+
+    for ( uint32_t symbol = 0; symbol < symbolCount; ++symbol )
+    {
+        const uint32_t length = lengths[ symbol ];
+        if ( length == 0 )
+        {
+            codes[ symbol ] = 0;
+            continue;
+        }
+        uint32_t symbolCode = nextCodes[ length ]++;
+        uint32_t reversedCode = 0;
+        for ( uint32_t bit = 0; bit < length; ++bit )
+        {
+            reversedCode = ( reversedCode << 1 ) | ( symbolCode & 1 );
+            symbolCode >>= 1;
+        }
+        codes[ symbol ] = (uint16_t)reversedCode;
+    }
+}
+
+// Run length encodes the concatenated literal/length and distance code lengths with the code length alphabet, extra bits are stored in the high byte
+static void EncodeCodeLengths( const uint8_t* lengths, uint32_t count, std::vector<uint16_t>* symbols )
+{
+    for ( uint32_t i = 0; i < count; )
+    {
+        const uint8_t length = lengths[ i ];
+        uint32_t runLength = 1;
+        while ( i + runLength < count && lengths[ i + runLength ] == length )
+        {
+            ++runLength;
+        }
+
+        if ( length == 0 && runLength >= 3 )
+        {
+            runLength = std::min( runLength, 138u );
+            symbols->push_back( runLength <= 10 ? (uint16_t)( 17 | ( ( runLength - 3 ) << 8 ) ) : (uint16_t)( 18 | ( ( runLength - 11 ) << 8 ) ) );
+        }
+        else if ( length != 0 && runLength >= 4 )
+        {
+            runLength = std::min( runLength, 7u );
+            symbols->push_back( length );
+            symbols->push_back( (uint16_t)( 16 | ( ( runLength - 4 ) << 8 ) ) );
+        }
+        else
+        {
+            runLength = 1;
+            symbols->push_back( length );
+        }
+        i += runLength;
+    }
+}
+
+static void WriteStoredBlocks( SBitWriter* writer, const uint8_t* data, size_t size, bool isFinal )
+{
+    do
+    {
+        const uint32_t blockSize = (uint32_t)std::min( size, (size_t)s_MaxStoredBlockSize );
+        const bool isLastBlock = blockSize == size;
+        writer->WriteBits( isFinal && isLastBlock ? 1 : 0, 1 );
+        writer->WriteBits( 0, 2 );
+        writer->AlignToByte();
+        writer->WriteBits( blockSize, 16 );
+        writer->WriteBits( ~blockSize & 0xFFFF, 16 );
+        writer->m_Output->insert( writer->m_Output->end(), data, data + blockSize );
+        data += blockSize;
+        size -= blockSize;
+    } while ( size > 0 );
+}
+
+// Writes the tokens as a dynamic Huffman block, or as stored blocks when that turns out smaller
+static void WriteBlock( SBitWriter* writer, const std::vector<SToken>& tokens, const uint8_t* blockData, size_t blockSize, bool isFinal )
+{
+    uint32_t literalLengthFrequencies[ s_LiteralLengthCodeCount ] = {};
+    uint32_t distanceFrequencies[ s_DistanceCodeCount ] = {};
+    for ( const SToken& token : tokens )
+    {
+        if ( token.m_Distance == 0 )
+        {
+            ++literalLengthFrequencies[ token.m_LiteralOrLength ];
+        }
+        else
+        {
+            ++literalLengthFrequencies[ 257 + s_SymbolTables.m_LengthCodes[ token.m_LiteralOrLength ] ];
+            ++distanceFrequencies[ s_SymbolTables.GetDistanceCode( token.m_Distance ) ];
+        }
+    }
+    literalLengthFrequencies[ s_EndOfBlockSymbol ] = 1;
+
+    SHuffmanCode literalLengthCode;
+    SHuffmanCode distanceCode;
+    BuildHuffmanCodeLengths( literalLengthFrequencies, s_LiteralLengthCodeCount, s_MaxCodeBits, literalLengthCode.m_Lengths );
+    BuildHuffmanCodeLengths( distanceFrequencies, s_DistanceCodeCount, s_MaxCodeBits, distanceCode.m_Lengths );
+    BuildHuffmanCodes( literalLengthCode.m_Lengths, s_LiteralLengthCodeCount, literalLengthCode.m_Codes );
+    BuildHuffmanCodes( distanceCode.m_Lengths, s_DistanceCodeCount, distanceCode.m_Codes );
+
+    uint32_t literalLengthCodeCount = s_LiteralLengthCodeCount;
+    while ( literalLengthCodeCount > 257 && literalLengthCode.m_Lengths[ literalLengthCodeCount - 1 ] == 0 )
+    {
+        --literalLengthCodeCount;
+    }
+    uint32_t distanceCodeCount = s_DistanceCodeCount;
+    while ( distanceCodeCount > 1 && distanceCode.m_Lengths[ distanceCodeCount - 1 ] == 0 )
+    {
+        --distanceCodeCount;
+    }
+
+    uint8_t codeLengths[ s_LiteralLengthCodeCount + s_DistanceCodeCount ];
+    memcpy( codeLengths, literalLengthCode.m_Lengths, literalLengthCodeCount );
+    memcpy( codeLengths + literalLengthCodeCount, distanceCode.m_Lengths, distanceCodeCount );
+    std::vector<uint16_t> codeLengthSymbols;
+    EncodeCodeLengths( codeLengths, literalLengthCodeCount + distanceCodeCount, &codeLengthSymbols );
+
+    uint32_t codeLengthFrequencies[ s_CodeLengthCodeCount ] = {};
+    for ( uint16_t symbol : codeLengthSymbols )
+    {
+        ++codeLengthFrequencies[ symbol & 0xFF ];
+    }
+    SHuffmanCode codeLengthCode;
+    BuildHuffmanCodeLengths( codeLengthFrequencies, s_CodeLengthCodeCount, s_MaxCodeLengthCodeBits, codeLengthCode.m_Lengths );
+    BuildHuffmanCodes( codeLengthCode.m_Lengths, s_CodeLengthCodeCount, codeLengthCode.m_Codes );
+
+    uint32_t codeLengthCodeCount = s_CodeLengthCodeCount;
+    while ( codeLengthCodeCount > 4 && codeLengthCode.m_Lengths[ s_CodeLengthOrder[ codeLengthCodeCount - 1 ] ] == 0 )
+    {
+        --codeLengthCodeCount;
+    }
+
+    // Compare the exact size of the dynamic block against storing the bytes as they are
+    const uint32_t s_CodeLengthExtraBits[ 3 ] = { 2, 3, 7 };
+    uint64_t dynamicBlockBits = 3 + 5 + 5 + 4 + 3 * codeLengthCodeCount;
+    for ( uint16_t symbol : codeLengthSymbols )
+    {
+        const uint32_t code = symbol & 0xFF;
+        dynamicBlockBits += codeLengthCode.m_Lengths[ code ] + ( code >= 16 ? s_CodeLengthExtraBits[ code - 16 ] : 0 );
+    }
+    for ( uint32_t symbol = 0; symbol < s_LiteralLengthCodeCount; ++symbol )
+    {
+        dynamicBlockBits += (uint64_t)literalLengthFrequencies[ symbol ] * ( literalLengthCode.m_Lengths[ symbol ] + ( symbol > 256 ? s_LengthExtraBits[ symbol - 257 ] : 0 ) );
+    }
+    for ( uint32_t symbol = 0; symbol < s_DistanceCodeCount; ++symbol )
+    {
+        dynamicBlockBits += (uint64_t)distanceFrequencies[ symbol ] * ( distanceCode.m_Lengths[ symbol ] + s_DistanceExtraBits[ symbol ] );
+    }
+    const uint64_t storedBlockBits = ( blockSize + 5 * ( blockSize / s_MaxStoredBlockSize + 1 ) ) * 8 + 7;
+    if ( storedBlockBits < dynamicBlockBits )
+    {
+        WriteStoredBlocks( writer, blockData, blockSize, isFinal );
+        return;
+    }
+
+    writer->WriteBits( isFinal ? 1 : 0, 1 );
+    writer->WriteBits( 2, 2 );
+    writer->WriteBits( literalLengthCodeCount - 257, 5 );
+    writer->WriteBits( distanceCodeCount - 1, 5 );
+    writer->WriteBits( codeLengthCodeCount - 4, 4 );
+    for ( uint32_t i = 0; i < codeLengthCodeCount; ++i )
+    {
+        writer->WriteBits( codeLengthCode.m_Lengths[ s_CodeLengthOrder[ i ] ], 3 );
+    }
+    for ( uint16_t symbol : codeLengthSymbols )
+    {
+        const uint32_t code = symbol & 0xFF;
+        writer->WriteBits( codeLengthCode.m_Codes[ code ], codeLengthCode.m_Lengths[ code ] );
+        if ( code >= 16 )
+        {
+            writer->WriteBits( symbol >> 8, s_CodeLengthExtraBits[ code - 16 ] );
+        }
+    }
+
+    for ( const SToken& token : tokens )
+    {
+        if ( token.m_Distance == 0 )
+        {
+            writer->WriteBits( literalLengthCode.m_Codes[ token.m_LiteralOrLength ], literalLengthCode.m_Lengths[ token.m_LiteralOrLength ] );
+        }
+        else
+        {
+            const uint32_t lengthCode = s_SymbolTables.m_LengthCodes[ token.m_LiteralOrLength ];
+            writer->WriteBits( literalLengthCode.m_Codes[ 257 + lengthCode ], literalLengthCode.m_Lengths[ 257 + lengthCode ] );
+            writer->WriteBits( token.m_LiteralOrLength - s_LengthBase[ lengthCode ], s_LengthExtraBits[ lengthCode ] );
+            const uint32_t distanceCodeIndex = s_SymbolTables.GetDistanceCode( token.m_Distance );
+            writer->WriteBits( distanceCode.m_Codes[ distanceCodeIndex ], distanceCode.m_Lengths[ distanceCodeIndex ] );
+            writer->WriteBits( token.m_Distance - s_DistanceBase[ distanceCodeIndex ], s_DistanceExtraBits[ distanceCodeIndex ] );
+        }
+    }
+    writer->WriteBits( literalLengthCode.m_Codes[ s_EndOfBlockSymbol ], literalLengthCode.m_Lengths[ s_EndOfBlockSymbol ] );
+}
+
+static uint32_t HashTriplet( const uint8_t* data )
+{
+    const uint32_t value = data[ 0 ] | ( data[ 1 ] << 8 ) | ( data[ 2 ] << 16 );
+    return ( value * 2654435761u ) >> ( 32 - s_HashBits );
+}
+
+void DeflateBlocks( const uint8_t* data, size_t size, bool isFinal, std::vector<uint8_t>* outData )
+{
+    SBitWriter writer;
+    writer.m_Output = outData;
+
+    // Greedy LZ77 over hash chains, positions are stored in a ring so memory does not grow with the input
+    std::vector<int64_t> hashHeads( (size_t)1 << s_HashBits, -1 );
+    std::vector<int64_t> previousPositions( s_WindowSize, -1 );
+    std::vector<SToken> tokens;
+    tokens.reserve( s_MaxBlockTokenCount );
+
+    auto InsertPosition = [&]( size_t position )
+    {
+        const uint32_t hash = HashTriplet( data + position );
+        previousPositions[ position & ( s_WindowSize - 1 ) ] = hashHeads[ hash ];
+        hashHeads[ hash ] = (int64_t)position;
+    };
+
+    size_t blockBegin = 0;
+    size_t position = 0;
+    while ( position < size )
+    {
+        uint32_t bestLength = 0;
+        uint32_t bestDistance = 0;
+        if ( position + s_MinMatchLength <= size )
+        {
+            const uint32_t maxLength = (uint32_t)std::min( (size_t)s_MaxMatchLength, size - position );
+            int64_t candidate = hashHeads[ HashTriplet( data + position ) ];
+            for ( uint32_t chain = 0; chain < s_MaxChainLength && candidate >= 0 && position - (size_t)candidate <= s_WindowSize; ++chain )
+            {
+                const uint8_t* candidateData = data + candidate;
+                const uint8_t* currentData = data + position;
+                if ( candidateData[ bestLength ] == currentData[ bestLength ] )
+                {
+                    uint32_t length = 0;
+                    while ( length < maxLength && candidateData[ length ] == currentData[ length ] )
+                    {
+                        ++length;
+                    }
+                    if ( length > bestLength )
+                    {
+                        bestLength = length;
+                        bestDistance = (uint32_t)( position - (size_t)candidate );
+                        if ( length == maxLength )
+                        {
+                            break;
+                        }
+                    }
+                }
+
+                // The ring slot may already hold a newer position, which would not be older than the candidate
+                const int64_t nextCandidate = previousPositions[ candidate & ( s_WindowSize - 1 ) ];
+                if ( nextCandidate >= candidate )
+                {
+                    break;
+                }
+                candidate = nextCandidate;
+            }
+            InsertPosition( position );
+        }
+
+        if ( bestLength >= s_MinMatchLength )
+        {
+            tokens.push_back( { (uint16_t)bestLength, (uint16_t)bestDistance } );
+            // Long matches only hash their last position, which is enough to continue runs at a short distance
+            const size_t insertBegin = bestLength <= s_MaxInsertMatchLength ? position + 1 : position + bestLength - 1;
+            for ( size_t matchPosition = insertBegin; matchPosition < position + bestLength && matchPosition + s_MinMatchLength <= size; ++matchPosition )
+            {
+                InsertPosition( matchPosition );
+            }
+            position += bestLength;
+        }
+        else
+        {
+            tokens.push_back( { data[ position ], 0 } );
+            ++position;
+        }
+
+        if ( tokens.size() == s_MaxBlockTokenCount )
+        {
+            WriteBlock( &writer, tokens, data + blockBegin, position - blockBegin, isFinal && position == size );
+            tokens.clear();
+            blockBegin = position;
+        }
+    }
+
+    if ( !tokens.empty() )
+    {
+        WriteBlock( &writer, tokens, data + blockBegin, position - blockBegin, isFinal );
+    }
+    else if ( isFinal && size == 0 )
+    {
+        WriteStoredBlocks( &writer, nullptr, 0, true );
+    }
+
+    if ( !isFinal )
+    {
+        // Sync flush, an empty non-final stored block leaves the stream byte aligned
+        WriteStoredBlocks( &writer, nullptr, 0, false );
+    }
+    writer.AlignToByte();
+}
+
+uint32_t CalculateAdler32( const uint8_t* data, size_t size, uint32_t adler )
+{
+    const uint32_t s_Modulo = 65521;
+    const size_t s_MaxBlockSize = 5552; // Largest block before the sums may overflow 32 bits
+    uint32_t a = adler & 0xFFFF, b = adler >> 16;
+    while ( size > 0 )
+    {
+        const size_t blockSize = std::min( size, s_MaxBlockSize );
+        for ( size_t i = 0; i < blockSize; ++i )
+        {
+            a += data[ i ];
+            b += a;
+        }
+        a %= s_Modulo;
+        b %= s_Modulo;
+        data += blockSize;
+        size -= blockSize;
+    }
+    return ( b << 16 ) | a;
+}
+
+uint32_t CombineAdler32( uint32_t adler1, uint32_t adler2, size_t size2 )
+{
+    const uint32_t s_Modulo = 65521;
+    const uint32_t remainder = (uint32_t)( size2 % s_Modulo );
+    uint32_t a = adler1 & 0xFFFF;
+    uint32_t b = (uint32_t)( ( (uint64_t)remainder * a ) % s_Modulo );
+    a += ( adler2 & 0xFFFF ) + s_Modulo - 1;
+    b += ( adler1 >> 16 ) + ( adler2 >> 16 ) + s_Modulo - remainder;
+    a = a >= s_Modulo ? a - s_Modulo : a;
+    a = a >= s_Modulo ? a - s_Modulo : a;
+    b = b >= 2 * s_Modulo ? b - 2 * s_Modulo : b;
+    b = b >= s_Modulo ? b - s_Modulo : b;
+    return ( b << 16 ) | a;
+}
+
+uint32_t CalculateCRC32( const uint8_t* data, size_t size, uint32_t crc )
+{
+    crc = ~crc;
+    for ( size_t i = 0; i < size; ++i )
+    {
+        crc = s_SymbolTables.m_CRCTable[ ( crc ^ data[ i ] ) & 0xFF ] ^ ( crc >> 8 );
+    }
+    return ~crc;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// Compresses data into raw deflate blocks (RFC 1951) appended to outData. Every call starts a new LZ77 window, when isFinal is false the output
+// ends with an empty stored block so it is byte aligned and the output of further calls can be concatenated to form a single deflate stream.
+void DeflateBlocks( const uint8_t* data, size_t size, bool isFinal, std::vector<uint8_t>* outData );
+
+uint32_t CalculateAdler32( const uint8_t* data, size_t size, uint32_t adler = 1 );
+
+// Adler-32 of the concatenation of two byte ranges given the checksum of each and the size of the second one
+uint32_t CombineAdler32( uint32_t adler1, uint32_t adler2, size_t size2 );
+
+uint32_t CalculateCRC32( const uint8_t* data, size_t size, uint32_t crc = 0 );
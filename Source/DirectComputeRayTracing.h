@@ -75,6 +75,12 @@ public:
 
     void RenderOneFrame();
 
+    // Accumulates the samples of one frame in the film without post processing, UI or presenting, for instances created without a window
+    void RenderOneFrameWithoutWindow();
+
+    // Reads the film back and waits for it, so it is written with the samples of every frame rendered so far
+    bool SaveFilmToFile( const wchar_t* filepath );
+
     bool LoadScene( const char* filepath, bool reset );
 
     bool HandleFilmResolutionChange();
@@ -87,7 +93,7 @@ public:
 
     void DrawImGui( ID3D12GraphicsCommandList* commandList );
 
-    void OnImGUI( SRenderContext* renderContext, std::wstring* outSaveImageFilepath );
+    void OnImGUI( SRenderContext* renderContext, std::wstring* outSaveImageFilepath, std::wstring* outSaveFilmFilepath );
 
     void ExecuteSampleConvolution( const SRenderContext& renderContext );
 
@@ -104,6 +110,8 @@ public:
     std::vector<GPUTexturePtr> m_sRGBBackbuffers;
 
     class CScene* m_Scene = nullptr;
+    class CCPUPathTracer* m_CPUPathTracer = nullptr;
+    uint32_t m_CPUReferenceSampleCount = 64;
     SSceneObjectSelection m_ObjectSelection;
 
     uint32_t m_ActivePathTracerIndex = 0;
@@ -115,6 +123,7 @@ public:
     uint32_t m_NewResolutionHeight;
     uint32_t m_SmallResolutionWidth = 480;
     uint32_t m_SmallResolutionHeight = 270;
+    bool m_IsSmallResolutionEnabled = true; // Render at the small resolution while the film is dirty
 
     FrameTimer m_FrameTimer;
 
@@ -126,7 +135,7 @@ public:
     uint32_t m_RayTracingPixelPos[ 2 ] = { 0, 0 };
     float m_RayTracingSubPixelPos[ 2 ] = { 0.f, 0.f };
 
-    uint32_t m_SPP;
+    uint32_t m_SPP = 0;
     uint32_t m_CursorPixelPosOnRenderViewport[ 2 ];
     uint32_t m_CursorPixelPosOnFilm[ 2 ];
     bool m_ShowUI = true;
@@ -0,0 +1,500 @@
+#include "stdafx.h"
+#include "EnvironmentLightDistribution.h"
+#include "Logging.h"
+#include <DirectXPackedVector.h>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+// Every cell gets this fraction of the average luminance on top of its own so cells darker than the bilinear footprint of their texels and
+// texels brightened by the light color are still reachable by light sampling
+static const double s_LuminanceFloorFraction = 0.01;
+
+static float CalculateLuminance( float r, float g, float b )
+{
+    return r * .299f + g * .587f + b * .114f;
+}
+
+static float SRGBToLinear( uint8_t value )
+{
+    const float normalized = value / 255.f;
+    return normalized <= 0.04045f ? normalized / 12.92f : powf( ( normalized + 0.055f ) / 1.055f, 2.4f );
+}
+
+// u and v are in [-1, 1] with v pointing down the face, same as the texel addressing of TextureCube
+static XMFLOAT3 CubemapFaceToDirection( uint32_t face, float u, float v )
+{
+    switch ( face )
+    {
+    case 0: return XMFLOAT3( 1.f, -v, -u );
+    case 1: return XMFLOAT3( -1.f, -v, u );
+    case 2: return XMFLOAT3( u, 1.f, v );
+    case 3: return XMFLOAT3( u, -1.f, -v );
+    case 4: return XMFLOAT3( u, -v, 1.f );
+    default: return XMFLOAT3( -u, -v, -1.f );
+    }
+}
+
+static uint32_t DirectionToCubemapFace( const XMFLOAT3& direction, float* u, float* v )
+{
+    const float absX = fabsf( direction.x );
+    const float absY = fabsf( direction.y );
+    const float absZ = fabsf( direction.z );
+    if ( absX >= absY && absX >= absZ )
+    {
+        *u = ( direction.x > 0.f ? -direction.z : direction.z ) / absX;
+        *v = -direction.y / absX;
+        return direction.x > 0.f ? 0 : 1;
+    }
+    else if ( absY >= absZ )
+    {
+        *u = direction.x / absY;
+        *v = ( direction.y > 0.f ? direction.z : -direction.z ) / absY;
+        return direction.y > 0.f ? 2 : 3;
+    }
+    *u = ( direction.z > 0.f ? direction.x : -direction.x ) / absZ;
+    *v = -direction.y / absZ;
+    return direction.z > 0.f ? 4 : 5;
+}
+
+static uint32_t DirectionToCellIndex( const XMFLOAT3& direction, uint32_t cellCount, float* u, float* v )
+{
+    const uint32_t face = DirectionToCubemapFace( direction, u, v );
+    const uint32_t x = std::min( (uint32_t)std::max( ( *u + 1.f ) * .5f * cellCount, 0.f ), cellCount - 1 );
+    const uint32_t y = std::min( (uint32_t)std::max( ( *v + 1.f ) * .5f * cellCount, 0.f ), cellCount - 1 );
+    return ( face * cellCount + y ) * cellCount + x;
+}
+
+// Solid angle subtended by the part of a face between its center and ( u, v )
+static double CalculateCubemapAreaElement( double u, double v )
+{
+    return atan2( u * v, sqrt( u * u + v * v + 1.0 ) );
+}
+
+bool SEnvironmentLightDistribution::Build( const float* faceLuminance, uint32_t faceSize, uint32_t maxCellCount )
+{
+    m_CellCount = 0;
+    m_AverageLuminance = 0.f;
+    m_AliasTable.clear();
+    if ( faceSize == 0 )
+    {
+        return false;
+    }
+
+    uint32_t cellCount = faceSize;
+    while ( cellCount > maxCellCount && cellCount % 2 == 0 )
+    {
+        cellCount /= 2;
+    }
+    const uint32_t footprint = faceSize / cellCount;
+
+    // Same for every face
+    std::vector<double> solidAngles( cellCount * cellCount );
+    for ( uint32_t y = 0; y < cellCount; ++y )
+    {
+        const double v0 = y * 2.0 / cellCount - 1.0;
+        const double v1 = ( y + 1 ) * 2.0 / cellCount - 1.0;
+        for ( uint32_t x = 0; x < cellCount; ++x )
+        {
+            const double u0 = x * 2.0 / cellCount - 1.0;
+            const double u1 = ( x + 1 ) * 2.0 / cellCount - 1.0;
+            solidAngles[ y * cellCount + x ] = CalculateCubemapAreaElement( u0, v0 ) - CalculateCubemapAreaElement( u0, v1 )
+                - CalculateCubemapAreaElement( u1, v0 ) + CalculateCubemapAreaElement( u1, v1 );
+        }
+    }
+
+    std::vector<float> cellLuminance( 6 * cellCount * cellCount );
+    double luminanceIntegral = 0.0;
+    for ( uint32_t face = 0; face < 6; ++face )
+    {
+        for ( uint32_t y = 0; y < cellCount; ++y )
+        {
+            for ( uint32_t x = 0; x < cellCount; ++x )
+            {
+                double luminance = 0.0;
+                for ( uint32_t texelY = y * footprint; texelY < ( y + 1 ) * footprint; ++texelY )
+                {
+                    const float* row = faceLuminance + ( (size_t)face * faceSize + texelY ) * faceSize;
+                    for ( uint32_t texelX = x * footprint; texelX < ( x + 1 ) * footprint; ++texelX )
+                    {
+                        if ( row[ texelX ] > 0.f && std::isfinite( row[ texelX ] ) )
+                        {
+                            luminance += row[ texelX ];
+                        }
+                    }
+                }
+                luminance /= footprint * footprint;
+                cellLuminance[ ( face * cellCount + y ) * cellCount + x ] = (float)luminance;
+                luminanceIntegral += luminance * solidAngles[ y * cellCount + x ];
+            }
+        }
+    }
+
+    if ( !( luminanceIntegral > 0.0 ) )
+    {
+        return false;
+    }
+
+    const double luminanceFloor = s_LuminanceFloorFraction * luminanceIntegral / ( 4.0 * M_PI );
+    std::vector<float> weights( cellLuminance.size() );
+    for ( size_t i = 0; i < weights.size(); ++i )
+    {
+        weights[ i ] = (float)( ( cellLuminance[ i ] + luminanceFloor ) * solidAngles[ i % ( cellCount * cellCount ) ] );
+    }
+
+    if ( !BuildAliasTable( weights.data(), (uint32_t)weights.size(), &m_AliasTable ) )
+    {
+        return false;
+    }
+    m_CellCount = cellCount;
+    m_AverageLuminance = (float)( luminanceIntegral / ( 4.0 * M_PI ) );
+    return true;
+}
+
+static bool ReadRowRadiance( DXGI_FORMAT format, const uint8_t* row, uint32_t width, XMFLOAT3* radiance )
+{
+    switch ( format )
+    {
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+    case DXGI_FORMAT_R32G32B32_FLOAT:
+    {
+        const uint32_t stride = format == DXGI_FORMAT_R32G32B32A32_FLOAT ? 4 : 3;
+        for ( uint32_t x = 0; x < width; ++x )
+        {
+            float texel[ 3 ];
+            memcpy( texel, row + x * stride * sizeof( float ), sizeof( texel ) );
+            radiance[ x ] = XMFLOAT3( texel[ 0 ], texel[ 1 ], texel[ 2 ] );
+        }
+        return true;
+    }
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+        for ( uint32_t x = 0; x < width; ++x )
+        {
+            XMHALF4 packed;
+            memcpy( &packed, row + x * sizeof( XMHALF4 ), sizeof( XMHALF4 ) );
+            XMFLOAT4 texel;
+            XMStoreFloat4( &texel, XMLoadHalf4( &packed ) );
+            radiance[ x ] = XMFLOAT3( texel.x, texel.y, texel.z );
+        }
+        return true;
+    case DXGI_FORMAT_R11G11B10_FLOAT:
+    case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+        for ( uint32_t x = 0; x < width; ++x )
+        {
+            uint32_t packed;
+            memcpy( &packed, row + x * sizeof( uint32_t ), sizeof( uint32_t ) );
+            XMFLOAT3 texel;
+            if ( format == DXGI_FORMAT_R11G11B10_FLOAT )
+            {
+                XMFLOAT3PK packedTexel( packed );
+                XMStoreFloat3( &texel, XMLoadFloat3PK( &packedTexel ) );
+            }
+            else
+            {
+                XMFLOAT3SE packedTexel( packed );
+                XMStoreFloat3( &texel, XMLoadFloat3SE( &packedTexel ) );
+            }
+            radiance[ x ] = XMFLOAT3( texel.x, texel.y, texel.z );
+        }
+        return true;
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+    case DXGI_FORMAT_B8G8R8A8_UNORM:
+    case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+    {
+        const bool isSRGB = format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+        const bool isBGR = format == DXGI_FORMAT_B8G8R8A8_UNORM || format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+        for ( uint32_t x = 0; x < width; ++x )
+        {
+            float texel[ 3 ];
+            for ( uint32_t channel = 0; channel < 3; ++channel )
+            {
+                const uint8_t value = row[ x * 4 + channel ];
+                texel[ channel ] = isSRGB ? SRGBToLinear( value ) : value / 255.f;
+            }
+            radiance[ x ] = isBGR ? XMFLOAT3( texel[ 2 ], texel[ 1 ], texel[ 0 ] ) : XMFLOAT3( texel[ 0 ], texel[ 1 ], texel[ 2 ] );
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static bool IsSquareCubemap( const D3D12_RESOURCE_DESC& desc, bool isCubemap, const std::vector<D3D12_SUBRESOURCE_DATA>& subresources )
+{
+    return isCubemap && desc.Height == desc.Width && desc.DepthOrArraySize >= 6 && subresources.size() >= 6 * (size_t)desc.MipLevels;
+}
+
+// Subresources are ordered by array slice first, the top mip of each face is the first one of its slice
+static const uint8_t* GetCubemapRow( const D3D12_RESOURCE_DESC& desc, const std::vector<D3D12_SUBRESOURCE_DATA>& subresources, uint32_t face, uint32_t y )
+{
+    const D3D12_SUBRESOURCE_DATA& subresource = subresources[ face * desc.MipLevels ];
+    return (const uint8_t*)subresource.pData + y * subresource.RowPitch;
+}
+
+bool SEnvironmentLightDistribution::BuildFromSubresources( const D3D12_RESOURCE_DESC& desc, bool isCubemap, const std::vector<D3D12_SUBRESOURCE_DATA>& subresources )
+{
+    m_CellCount = 0;
+    m_AverageLuminance = 0.f;
+    m_AliasTable.clear();
+
+    const uint32_t faceSize = (uint32_t)desc.Width;
+    if ( !IsSquareCubemap( desc, isCubemap, subresources ) )
+    {
+        LOG_STRING( "Environment texture is not a square cubemap, it will be sampled uniformly.\n" );
+        return false;
+    }
+
+    std::vector<float> faceLuminance( 6 * (size_t)faceSize * faceSize );
+    std::vector<XMFLOAT3> rowRadiance( faceSize );
+    for ( uint32_t face = 0; face < 6; ++face )
+    {
+        for ( uint32_t y = 0; y < faceSize; ++y )
+        {
+            if ( !ReadRowRadiance( desc.Format, GetCubemapRow( desc, subresources, face, y ), faceSize, rowRadiance.data() ) )
+            {
+                LOG_STRING_FORMAT( "Environment texture format %d is not supported by importance sampling, it will be sampled uniformly.\n", (int)desc.Format );
+                return false;
+            }
+            float* rowLuminance = faceLuminance.data() + ( (size_t)face * faceSize + y ) * faceSize;
+            for ( uint32_t x = 0; x < faceSize; ++x )
+            {
+                rowLuminance[ x ] = CalculateLuminance( rowRadiance[ x ].x, rowRadiance[ x ].y, rowRadiance[ x ].z );
+            }
+        }
+    }
+
+    return Build( faceLuminance.data(), faceSize );
+}
+
+XMFLOAT3 SEnvironmentLightDistribution::Sample( const XMFLOAT4& samples, float* pdf ) const
+{
+    const uint32_t faceCellCount = m_CellCount * m_CellCount;
+    const uint32_t index = SampleAliasTable( m_AliasTable.data(), (uint32_t)m_AliasTable.size(), samples.x, samples.y );
+    const uint32_t face = index / faceCellCount;
+    const uint32_t y = ( index % faceCellCount ) / m_CellCount;
+    const uint32_t x = index % m_CellCount;
+    const float u = ( x + samples.z ) * 2.f / m_CellCount - 1.f;
+    const float v = ( y + samples.w ) * 2.f / m_CellCount - 1.f;
+
+    // Uniform over the cell area of 4 / m_CellCount^2 on the face plane, dA = r^3 * dw
+    const float squaredDistance = 1.f + u * u + v * v;
+    const float distance = sqrtf( squaredDistance );
+    *pdf = m_AliasTable[ index ].probability * faceCellCount * .25f * squaredDistance * distance;
+
+    const XMFLOAT3 direction = CubemapFaceToDirection( face, u, v );
+    return XMFLOAT3( direction.x / distance, direction.y / distance, direction.z / distance );
+}
+
+float SEnvironmentLightDistribution::EvaluatePDF( const XMFLOAT3& direction ) const
+{
+    float u, v;
+    const uint32_t index = DirectionToCellIndex( direction, m_CellCount, &u, &v );
+    const float squaredDistance = 1.f + u * u + v * v;
+    return m_AliasTable[ index ].probability * m_CellCount * m_CellCount * .25f * squaredDistance * sqrtf( squaredDistance );
+}
+
+bool SEnvironmentLightRadiance::BuildFromSubresources( const D3D12_RESOURCE_DESC& desc, bool isCubemap, const std::vector<D3D12_SUBRESOURCE_DATA>& subresources, uint32_t maxFaceSize )
+{
+    m_FaceSize = 0;
+    m_Texels.clear();
+
+    if ( !IsSquareCubemap( desc, isCubemap, subresources ) )
+    {
+        return false;
+    }
+
+    const uint32_t sourceFaceSize = (uint32_t)desc.Width;
+    uint32_t faceSize = sourceFaceSize;
+    while ( faceSize > maxFaceSize && faceSize % 2 == 0 )
+    {
+        faceSize /= 2;
+    }
+    const uint32_t footprint = sourceFaceSize / faceSize;
+
+    m_Texels.resize( 6 * (size_t)faceSize * faceSize, XMFLOAT3( 0.f, 0.f, 0.f ) );
+    std::vector<XMFLOAT3> rowRadiance( sourceFaceSize );
+    const float weight = 1.f / ( footprint * footprint );
+    for ( uint32_t face = 0; face < 6; ++face )
+    {
+        for ( uint32_t sourceY = 0; sourceY < sourceFaceSize; ++sourceY )
+        {
+            if ( !ReadRowRadiance( desc.Format, GetCubemapRow( desc, subresources, face, sourceY ), sourceFaceSize, rowRadiance.data() ) )
+            {
+                m_Texels.clear();
+                return false;
+            }
+            XMFLOAT3* row = m_Texels.data() + ( (size_t)face * faceSize + sourceY / footprint ) * faceSize;
+            for ( uint32_t sourceX = 0; sourceX < sourceFaceSize; ++sourceX )
+            {
+                XMFLOAT3& texel = row[ sourceX / footprint ];
+                texel.x += rowRadiance[ sourceX ].x * weight;
+                texel.y += rowRadiance[ sourceX ].y * weight;
+                texel.z += rowRadiance[ sourceX ].z * weight;
+            }
+        }
+    }
+    m_FaceSize = faceSize;
+    return true;
+}
+
+XMFLOAT3 SEnvironmentLightRadiance::Sample( const XMFLOAT3& direction ) const
+{
+    float u, v;
+    const uint32_t face = DirectionToCubemapFace( direction, &u, &v );
+
+    // Texel centers are at half integers, the footprint is clamped to the face
+    const float x = std::clamp( ( u + 1.f ) * .5f * m_FaceSize - .5f, 0.f, m_FaceSize - 1.f );
+    const float y = std::clamp( ( v + 1.f ) * .5f * m_FaceSize - .5f, 0.f, m_FaceSize - 1.f );
+    const uint32_t x0 = (uint32_t)x;
+    const uint32_t y0 = (uint32_t)y;
+    const uint32_t x1 = std::min( x0 + 1, m_FaceSize - 1 );
+    const uint32_t y1 = std::min( y0 + 1, m_FaceSize - 1 );
+    const float fx = x - x0;
+    const float fy = y - y0;
+
+    const XMFLOAT3* texels = m_Texels.data() + (size_t)face * m_FaceSize * m_FaceSize;
+    const XMVECTOR top = XMVectorLerp( XMLoadFloat3( &texels[ y0 * m_FaceSize + x0 ] ), XMLoadFloat3( &texels[ y0 * m_FaceSize + x1 ] ), fx );
+    const XMVECTOR bottom = XMVectorLerp( XMLoadFloat3( &texels[ y1 * m_FaceSize + x0 ] ), XMLoadFloat3( &texels[ y1 * m_FaceSize + x1 ] ), fx );
+    XMFLOAT3 radiance;
+    XMStoreFloat3( &radiance, XMVectorLerp( top, bottom, fy ) );
+    return radiance;
+}
+
+static bool ValidateDistribution( const char* name, const SEnvironmentLightDistribution& distribution )
+{
+    const uint32_t cellCount = distribution.m_CellCount;
+    bool isValid = true;
+
+    // Midpoint rule with 4x4 points per cell over the face planes, dw = dA / r^3
+    {
+        const uint32_t pointCount = cellCount * 4;
+        const double pointArea = 4.0 / ( (double)pointCount * pointCount );
+        double integral = 0.0;
+        for ( uint32_t face = 0; face < 6; ++face )
+        {
+            for ( uint32_t y = 0; y < pointCount; ++y )
+            {
+                for ( uint32_t x = 0; x < pointCount; ++x )
+                {
+                    const float u = ( x + .5f ) * 2.f / pointCount - 1.f;
+                    const float v = ( y + .5f ) * 2.f / pointCount - 1.f;
+                    const float squaredDistance = 1.f + u * u + v * v;
+                    const float distance = sqrtf( squaredDistance );
+                    const XMFLOAT3 direction = CubemapFaceToDirection( face, u, v );
+                    const float pdf = distribution.EvaluatePDF( XMFLOAT3( direction.x / distance, direction.y / distance, direction.z / distance ) );
+                    integral += pdf * pointArea / ( squaredDistance * distance );
+                }
+            }
+        }
+        const bool passed = fabs( integral - 1.0 ) < 1e-3;
+        LOG_STRING_FORMAT( "%s: PDF integral %.6f, %s\n", name, integral, passed ? "passed" : "FAILED" );
+        isValid &= passed;
+    }
+
+    // Sampled PDFs against evaluated ones and a chi-square test of the histogram of samples over the cells
+    {
+        const uint32_t sampleCount = 1 << 22;
+        std::mt19937 rng( 0x5EED );
+        auto nextSample = [ &rng ]() { return ( rng() >> 8 ) / float( 1 << 24 ); };
+
+        std::vector<uint32_t> histogram( distribution.m_AliasTable.size(), 0 );
+        uint32_t mismatchCount = 0;
+        for ( uint32_t i = 0; i < sampleCount; ++i )
+        {
+            const XMFLOAT4 samples( nextSample(), nextSample(), nextSample(), nextSample() );
+            float pdf;
+            const XMFLOAT3 direction = distribution.Sample( samples, &pdf );
+            const float evaluatedPdf = distribution.EvaluatePDF( direction );
+            if ( !( fabsf( pdf - evaluatedPdf ) <= 1e-3f * pdf ) )
+            {
+                ++mismatchCount;
+            }
+
+            float u, v;
+            ++histogram[ DirectionToCellIndex( direction, cellCount, &u, &v ) ];
+        }
+        // Directions right on a face edge may be attributed to the neighboring cell
+        const bool pdfPassed = mismatchCount <= sampleCount / 10000;
+        LOG_STRING_FORMAT( "%s: %u of %u sampled PDFs differ from the evaluated ones, %s\n", name, mismatchCount, sampleCount, pdfPassed ? "passed" : "FAILED" );
+        isValid &= pdfPassed;
+
+        // Cells expecting too few samples are pooled into one bin
+        double chiSquare = 0.0;
+        uint32_t binCount = 0;
+        double pooledExpected = 0.0;
+        double pooledObserved = 0.0;
+        for ( size_t i = 0; i < histogram.size(); ++i )
+        {
+            const double expected = (double)distribution.m_AliasTable[ i ].probability * sampleCount;
+            if ( expected < 5.0 )
+            {
+                pooledExpected += expected;
+                pooledObserved += histogram[ i ];
+                continue;
+            }
+            chiSquare += ( histogram[ i ] - expected ) * ( histogram[ i ] - expected ) / expected;
+            ++binCount;
+        }
+        if ( pooledExpected >= 5.0 )
+        {
+            chiSquare += ( pooledObserved - pooledExpected ) * ( pooledObserved - pooledExpected ) / pooledExpected;
+            ++binCount;
+        }
+        // About 5 standard deviations above the mean of the chi-square distribution
+        const double degreesOfFreedom = binCount > 1 ? binCount - 1.0 : 1.0;
+        const double threshold = degreesOfFreedom + 5.0 * sqrt( 2.0 * degreesOfFreedom );
+        const bool histogramPassed = chiSquare <= threshold;
+        LOG_STRING_FORMAT( "%s: histogram chi-square %.1f over %u bins, threshold %.1f, %s\n", name, chiSquare, binCount, threshold, histogramPassed ? "passed" : "FAILED" );
+        isValid &= histogramPassed;
+    }
+
+    return isValid;
+}
+
+bool ValidateEnvironmentLightSampling()
+{
+    const uint32_t faceSize = 64;
+    std::vector<float> faceLuminance( 6 * faceSize * faceSize );
+    auto buildSky = [ & ]( const std::function<float( const XMFLOAT3& )>& skyLuminance )
+    {
+        for ( uint32_t face = 0; face < 6; ++face )
+        {
+            for ( uint32_t y = 0; y < faceSize; ++y )
+            {
+                for ( uint32_t x = 0; x < faceSize; ++x )
+                {
+                    const XMFLOAT3 direction = CubemapFaceToDirection( face, ( x + .5f ) * 2.f / faceSize - 1.f, ( y + .5f ) * 2.f / faceSize - 1.f );
+                    const float length = sqrtf( direction.x * direction.x + direction.y * direction.y + direction.z * direction.z );
+                    faceLuminance[ ( face * faceSize + y ) * faceSize + x ] = skyLuminance( XMFLOAT3( direction.x / length, direction.y / length, direction.z / length ) );
+                }
+            }
+        }
+    };
+
+    bool isValid = true;
+    SEnvironmentLightDistribution distribution;
+
+    buildSky( []( const XMFLOAT3& direction ) { return 1.f; } );
+    isValid &= distribution.Build( faceLuminance.data(), faceSize ) && ValidateDistribution( "Constant sky", distribution );
+
+    // A sky gradient with a sun about 2 degrees wide and 10^5 times brighter
+    buildSky( []( const XMFLOAT3& direction )
+    {
+        const float sunCosine = direction.x * 0.3f + direction.y * 0.8f + direction.z * 0.52f;
+        return sunCosine > 0.9994f ? 1e5f : 0.2f + std::max( direction.y, 0.f );
+    } );
+    isValid &= distribution.Build( faceLuminance.data(), faceSize ) && ValidateDistribution( "Sun and sky", distribution );
+
+    // Downsampled to 16x16 cells per face
+    isValid &= distribution.Build( faceLuminance.data(), faceSize, 16 ) && ValidateDistribution( "Sun and sky, downsampled", distribution );
+
+    // Nothing but a single texel, exercises the luminance floor
+    std::fill( faceLuminance.begin(), faceLuminance.end(), 0.f );
+    faceLuminance[ ( 5 * faceSize + 7 ) * faceSize + 41 ] = 100.f;
+    isValid &= distribution.Build( faceLuminance.data(), faceSize ) && ValidateDistribution( "Single texel", distribution );
+
+    LOG_STRING_FORMAT( "Environment light sampling validation %s.\n", isValid ? "passed" : "FAILED" );
+    return isValid;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "AliasTable.h"
+
+// Piecewise-constant distribution over the cells of a cubemap proportional to the luminance times the solid angle of each cell.
+// A direction is sampled uniformly in the face plane within the selected cell, so the PDF varies inside a cell with the cube to sphere
+// projection. Sample and EvaluatePDF mirror EnvironmentLight_Sample and EnvironmentLight_EvaluateWithPDF in the shaders.
+struct SEnvironmentLightDistribution
+{
+    // faceLuminance holds faceSize x faceSize texels for each of the 6 faces in D3D cubemap order. Faces larger than maxCellCount
+    // are box filtered down by powers of two.
+    bool Build( const float* faceLuminance, uint32_t faceSize, uint32_t maxCellCount = 256 );
+
+    // Builds from the top mip of a cubemap loaded from file, fails for formats which can not be read on the CPU
+    bool BuildFromSubresources( const D3D12_RESOURCE_DESC& desc, bool isCubemap, const std::vector<D3D12_SUBRESOURCE_DATA>& subresources );
+
+    DirectX::XMFLOAT3 Sample( const DirectX::XMFLOAT4& samples, float* pdf ) const;
+
+    float EvaluatePDF( const DirectX::XMFLOAT3& direction ) const;
+
+    uint32_t m_CellCount = 0; // Cells along an edge of a face, 0 when the distribution is empty
+    float m_AverageLuminance = 0.f; // Over the sphere, without the luminance floor
+    std::vector<GPU::SAliasTableEntry> m_AliasTable; // Indexed by ( face * m_CellCount + y ) * m_CellCount + x
+};
+
+// Radiance of the top mip of an environment cubemap read back for the CPU path tracer. Faces larger than maxFaceSize are box filtered down
+// by powers of two. Sample filters bilinearly within a face, so it differs from the TextureCube sampling of the shaders along the face edges.
+struct SEnvironmentLightRadiance
+{
+    // Fails for formats which can not be read on the CPU
+    bool BuildFromSubresources( const D3D12_RESOURCE_DESC& desc, bool isCubemap, const std::vector<D3D12_SUBRESOURCE_DATA>& subresources, uint32_t maxFaceSize = 512 );
+
+    DirectX::XMFLOAT3 Sample( const DirectX::XMFLOAT3& direction ) const;
+
+    uint32_t m_FaceSize = 0; // 0 when the radiance is empty
+    std::vector<DirectX::XMFLOAT3> m_Texels; // Indexed by ( face * m_FaceSize + y ) * m_FaceSize + x
+};
+
+// Checks on synthetic skies that the PDF integrates to one, that sampling returns the PDF of the sampled direction and that the histogram of
+// samples over the cells follows the distribution. Logs the results and returns false on failure.
+bool ValidateEnvironmentLightSampling();
@@ -18,7 +18,7 @@ GPUTexture* GPUTexture::Create( uint32_t width, uint32_t height, DXGI_FORMAT for
     desc.Width = width;
     desc.Height = height;
     desc.DepthOrArraySize = arraySize;
-    desc.MipLevels = 1;
+    desc.MipLevels = initialData.empty() ? 1 : (UINT16)( initialData.size() / arraySize );
     desc.Format = format;
     desc.SampleDesc.Count = 1;
     desc.Layout = D3D12_TEXTURE_LAYOUT_UNKNOWN;
@@ -162,7 +162,7 @@ GPUTexture* GPUTexture::CreateFromSwapChainInternal( const D3D12_RENDER_TARGET_V
     return gpuTexture;
 }
 
-GPUTexture* GPUTexture::CreateFromFile( const wchar_t* filename )
+GPUTexture* GPUTexture::CreateFromFile( const wchar_t* filename, const GPUTextureSubresourceReader& subresourceReader )
 {
     std::unique_ptr<uint8_t[]> ddsData;
     std::vector<D3D12_SUBRESOURCE_DATA> subresources;
@@ -176,6 +176,11 @@ GPUTexture* GPUTexture::CreateFromFile( const wchar_t* filename )
 
     CD3D12ComPtr<ID3D12Resource> texture( D3DTexture );
 
+    if ( subresourceReader )
+    {
+        subresourceReader( texture->GetDesc(), isCubemap, subresources );
+    }
+
     const UINT64 textureByteSize = GetRequiredIntermediateSize( texture.Get(), 0, (UINT)subresources.size() );
     const CD3DX12_HEAP_PROPERTIES heapProperties( D3D12_HEAP_TYPE_UPLOAD );
     const CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer( textureByteSize );
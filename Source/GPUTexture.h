@@ -10,9 +10,13 @@ enum EGPUTextureBindFlag : uint32_t
     EGPUTextureBindFlag_UnorderedAccess = 0x4,
 };
 
+// Receives the subresources of every array slice of a texture loaded from file while they are still in CPU memory
+typedef std::function<void( const D3D12_RESOURCE_DESC& desc, bool isCubemap, const std::vector<D3D12_SUBRESOURCE_DATA>& subresources )> GPUTextureSubresourceReader;
+
 class GPUTexture : public CD3D12Resource
 {
 public:
+    // initialData holds the subresources of every array slice, the mip level count is derived from its size
     static GPUTexture* Create( uint32_t width, uint32_t height, DXGI_FORMAT format, uint32_t bindFlags, const std::vector<D3D12_SUBRESOURCE_DATA>& initialData, 
         uint32_t arraySize = 1, D3D12_RESOURCE_STATES resourceStates = D3D12_RESOURCE_STATE_COMMON, const wchar_t* debugName = nullptr,
         DirectX::XMFLOAT4 clearColor = DirectX::XMFLOAT4( 0.f, 0.f, 0.f, 0.f ) );
@@ -25,7 +29,7 @@ public:
 
     static GPUTexture* CreateFromSwapChain( DXGI_FORMAT format, uint32_t index );
 
-    static GPUTexture* CreateFromFile( const wchar_t* filename );
+    static GPUTexture* CreateFromFile( const wchar_t* filename, const GPUTextureSubresourceReader& subresourceReader = nullptr );
 
     ~GPUTexture();
 
@@ -6,6 +6,8 @@
 #include "ScopedRenderAnnotation.h"
 #include "PathTracer.h"
 #include "RenderContext.h"
+#include "CPUPathTracer.h"
+#include "Logging.h"
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_dx12.h"
 #include "imgui/imgui_impl_win32.h"
@@ -28,7 +30,7 @@ static bool DragFloat3RadianInDegree( const char* label, float v[3], float v_spe
     return false;
 }
 
-static bool SelectSaveImageFilepath( HWND hWnd, std::wstring* outFilepath )
+static bool SelectSaveImageFilepath( HWND hWnd, const wchar_t* filter, const wchar_t* defaultExtension, std::wstring* outFilepath )
 {
     OPENFILENAMEW ofn;
     wchar_t filepath[ MAX_PATH ];
@@ -38,9 +40,9 @@ static bool SelectSaveImageFilepath( HWND hWnd, std::wstring* outFilepath )
     ofn.hwndOwner = hWnd;
     ofn.lpstrFile = filepath;
     ofn.nMaxFile = MAX_PATH;
-    ofn.lpstrFilter = L"Bitmap Image (*.bmp)\0*.bmp\0";
+    ofn.lpstrFilter = filter;
     ofn.nFilterIndex = 1;
-    ofn.lpstrDefExt = L"bmp";
+    ofn.lpstrDefExt = defaultExtension;
     ofn.Flags = OFN_PATHMUSTEXIST | OFN_OVERWRITEPROMPT | OFN_NOCHANGEDIR;
     if ( GetSaveFileNameW( &ofn ) == TRUE )
     {
@@ -121,9 +123,10 @@ void CDirectComputeRayTracing::DrawImGui( ID3D12GraphicsCommandList* commandList
     ImGui_ImplDX12_RenderDrawData( ImGui::GetDrawData(), commandList );
 }
 
-void CDirectComputeRayTracing::OnImGUI( SRenderContext* renderContext, std::wstring* outSaveImageFilepath )
+void CDirectComputeRayTracing::OnImGUI( SRenderContext* renderContext, std::wstring* outSaveImageFilepath, std::wstring* outSaveFilmFilepath )
 {
     outSaveImageFilepath->clear();
+    outSaveFilmFilepath->clear();
 
     ImGui_ImplDX12_NewFrame();
     ImGui_ImplWin32_NewFrame();
@@ -181,7 +184,28 @@ void CDirectComputeRayTracing::OnImGUI( SRenderContext* renderContext, std::wstr
 
             if ( ImGui::Button( "Save Image to File" ) )
             {
-                SelectSaveImageFilepath( m_hWnd, outSaveImageFilepath );
+                SelectSaveImageFilepath( m_hWnd, L"Bitmap Image (*.bmp)\0*.bmp\0PNG Image (*.png)\0*.png\0Targa Image (*.tga)\0*.tga\0Portable Float Map (*.pfm)\0*.pfm\0",
+                    L"bmp", outSaveImageFilepath );
+            }
+
+            if ( ImGui::Button( "Save HDR Film to File" ) )
+            {
+                SelectSaveImageFilepath( m_hWnd, L"Portable Float Map (*.pfm)\0*.pfm\0", L"pfm", outSaveFilmFilepath );
+            }
+
+            ImGui::DragInt( "CPU Reference Samples", (int*)&m_CPUReferenceSampleCount, 1, 1, 65536, "%d", ImGuiSliderFlags_AlwaysClamp );
+            if ( ImGui::Button( "Render CPU Reference to File" ) )
+            {
+                // Same frame seeds as the GPU film accumulated with the sample count frame seed type
+                std::wstring filepath;
+                if ( SelectSaveImageFilepath( m_hWnd, L"Portable Float Map (*.pfm)\0*.pfm\0", L"pfm", &filepath ) && m_CPUPathTracer->Create( m_Scene ) )
+                {
+                    m_CPUPathTracer->Render( m_CPUReferenceSampleCount );
+                    if ( !m_CPUPathTracer->WriteFilmToFile( filepath ) )
+                    {
+                        LOG_STRING( "Failed to write the CPU reference to file.\n" );
+                    }
+                }
             }
 
             uint32_t lastActivePathTracerIndex = m_ActivePathTracerIndex;
@@ -206,6 +230,11 @@ void CDirectComputeRayTracing::OnImGUI( SRenderContext* renderContext, std::wstr
                 m_Scene->m_IsFilmDirty = true;
             }
 
+            if ( ImGui::DragInt( "Russian Roulette Bounce Count", (int*)&m_Scene->m_RussianRouletteBounceCount, 0.5f, 0, m_Scene->s_MaxRayBounce ) )
+            {
+                m_Scene->m_IsFilmDirty = true;
+            }
+
             static const char* s_FilterNames[] = { "Box", "Triangle", "Gaussian", "Mitchell", "Lanczos Sinc" };
             if ( ImGui::Combo( "Filter", (int*)&m_Scene->m_Filter, s_FilterNames, IM_ARRAYSIZE( s_FilterNames ) ) )
             {
@@ -524,6 +553,7 @@ void CDirectComputeRayTracing::OnImGUI( SRenderContext* renderContext, std::wstr
                     {
                         m_Scene->m_PathTracer[ m_ActivePathTracerIndex ]->OnSceneLoaded( m_Scene );
                     }
+                    m_Scene->m_IsLightGPUBufferDirty = true;
                     m_Scene->m_IsFilmDirty = true;
                 }
             }
@@ -533,8 +563,9 @@ void CDirectComputeRayTracing::OnImGUI( SRenderContext* renderContext, std::wstr
                 if ( ImGui::Button( "Clear##ClearEnvImage" ) )
                 {
                     m_Scene->m_EnvironmentLight->m_TextureFileName = "";
-                    m_Scene->m_EnvironmentLight->m_Texture.Reset();
+                    m_Scene->m_EnvironmentLight->ClearTexture();
                     m_Scene->m_PathTracer[ m_ActivePathTracerIndex ]->OnSceneLoaded( m_Scene );
+                    m_Scene->m_IsLightGPUBufferDirty = true;
                     m_Scene->m_IsFilmDirty = true;
                 }
             }
@@ -741,6 +772,11 @@ void CDirectComputeRayTracing::OnImGUI( SRenderContext* renderContext, std::wstr
             ImGui::Text( "Cursor Pos (Film): %d %d", m_CursorPixelPosOnFilm[ 0 ], m_CursorPixelPosOnFilm[ 1 ] );
         }
 
+        if ( ImGui::CollapsingHeader( "Scene Memory" ) )
+        {
+            m_Scene->m_MemoryAccounting.OnImGUI();
+        }
+
         ImGui::End();
     }
 
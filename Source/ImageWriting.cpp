@@ -0,0 +1,543 @@
+#include "stdafx.h"
+#include "ImageWriting.h"
+#include "Deflate.h"
+#include "ParallelFor.h"
+#include "Timers.h"
+#include "Logging.h"
+
+#define LINEAR_TO_SRGB_TABLE_SIZE   16384
+#define IMAGE_WRITING_STRIP_SIZE    ( 2 * 1024 * 1024 ) // Approximate size of the source rows of a strip, also the granularity of the PNG deflate streams
+
+struct SColorConversionTables
+{
+    SColorConversionTables()
+    {
+        for ( uint32_t i = 0; i < 256; ++i )
+        {
+            const float value = i / 255.f;
+            m_SRGBToLinear[ i ] = value <= 0.04045f ? value / 12.92f : powf( ( value + 0.055f ) / 1.055f, 2.4f );
+        }
+        for ( uint32_t i = 0; i < LINEAR_TO_SRGB_TABLE_SIZE; ++i )
+        {
+            const float value = i / (float)( LINEAR_TO_SRGB_TABLE_SIZE - 1 );
+            const float sRGBValue = value <= 0.0031308f ? value * 12.92f : 1.055f * powf( value, 1.f / 2.4f ) - 0.055f;
+            m_LinearToSRGB[ i ] = (uint8_t)std::min( sRGBValue * 255.f + 0.5f, 255.f );
+        }
+    }
+
+    float m_SRGBToLinear[ 256 ];
+    uint8_t m_LinearToSRGB[ LINEAR_TO_SRGB_TABLE_SIZE ];
+};
+
+static const SColorConversionTables s_ColorConversionTables;
+
+struct SStripWorkspace
+{
+    std::vector<uint8_t> m_SourceRow;
+    std::vector<uint8_t> m_FileRows;
+    std::vector<uint8_t> m_FilteredRows;
+};
+
+struct SEncodedStrip
+{
+    std::vector<uint8_t> m_Data;
+    uint32_t m_Adler32;
+    size_t m_RawSize;
+};
+
+static uint32_t GetRowFormatPixelSize( EImageRowFormat format )
+{
+    return format == EImageRowFormat::R8G8B8A8_sRGB ? 4 : 12;
+}
+
+static uint32_t GetFileFormatPixelSize( EImageFileFormat format )
+{
+    return format == EImageFileFormat::PFM ? 12 : 3;
+}
+
+static uint8_t EncodeSRGB( float value )
+{
+    // Also maps NaNs to 0
+    value = value > 0.f ? std::min( value, 1.f ) : 0.f;
+    return s_ColorConversionTables.m_LinearToSRGB[ (uint32_t)( value * ( LINEAR_TO_SRGB_TABLE_SIZE - 1 ) + 0.5f ) ];
+}
+
+// Converts a row to the pixel layout of the file, BGR for BMP and TGA, RGB for PNG and float RGB for PFM
+static void ConvertRow( const uint8_t* source, EImageRowFormat rowFormat, EImageFileFormat fileFormat, uint32_t width, uint8_t* destination )
+{
+    if ( fileFormat == EImageFileFormat::PFM )
+    {
+        if ( rowFormat == EImageRowFormat::R32G32B32_Float )
+        {
+            memcpy( destination, source, (size_t)width * 12 );
+        }
+        else
+        {
+            float* destinationPixel = (float*)destination;
+            for ( uint32_t x = 0; x < width; ++x, source += 4, destinationPixel += 3 )
+            {
+                destinationPixel[ 0 ] = s_ColorConversionTables.m_SRGBToLinear[ source[ 0 ] ];
+                destinationPixel[ 1 ] = s_ColorConversionTables.m_SRGBToLinear[ source[ 1 ] ];
+                destinationPixel[ 2 ] = s_ColorConversionTables.m_SRGBToLinear[ source[ 2 ] ];
+            }
+        }
+        return;
+    }
+
+    const uint32_t redIndex = fileFormat == EImageFileFormat::PNG ? 0 : 2;
+    const uint32_t blueIndex = 2 - redIndex;
+    if ( rowFormat == EImageRowFormat::R8G8B8A8_sRGB )
+    {
+        for ( uint32_t x = 0; x < width; ++x, source += 4, destination += 3 )
+        {
+            destination[ redIndex ] = source[ 0 ];
+            destination[ 1 ] = source[ 1 ];
+            destination[ blueIndex ] = source[ 2 ];
+        }
+    }
+    else
+    {
+        const float* sourcePixel = (const float*)source;
+        for ( uint32_t x = 0; x < width; ++x, sourcePixel += 3, destination += 3 )
+        {
+            destination[ redIndex ] = EncodeSRGB( sourcePixel[ 0 ] );
+            destination[ 1 ] = EncodeSRGB( sourcePixel[ 1 ] );
+            destination[ blueIndex ] = EncodeSRGB( sourcePixel[ 2 ] );
+        }
+    }
+}
+
+static uint8_t PaethPredictor( int32_t a, int32_t b, int32_t c )
+{
+    const int32_t p = a + b - c;
+    const int32_t pa = abs( p - a );
+    const int32_t pb = abs( p - b );
+    const int32_t pc = abs( p - c );
+    return (uint8_t)( ( pa <= pb && pa <= pc ) ? a : ( pb <= pc ? b : c ) );
+}
+
+template <uint32_t FilterType>
+static uint8_t FilterPNGByte( const uint8_t* row, const uint8_t* previousRow, uint32_t x )
+{
+    const uint32_t BPP = 3;
+    const uint8_t a = x >= BPP ? row[ x - BPP ] : 0;
+    const uint8_t b = previousRow[ x ];
+    const uint8_t c = x >= BPP ? previousRow[ x - BPP ] : 0;
+    switch ( FilterType )
+    {
+    case 1: return (uint8_t)( row[ x ] - a );
+    case 2: return (uint8_t)( row[ x ] - b );
+    case 3: return (uint8_t)( row[ x ] - ( ( a + b ) >> 1 ) );
+    case 4: return (uint8_t)( row[ x ] - PaethPredictor( a, b, c ) );
+    default: return row[ x ];
+    }
+}
+
+// Filters the row into filteredRow, or only accumulates the cost when filteredRow is null
+template <uint32_t FilterType>
+static uint64_t FilterPNGRow( const uint8_t* row, const uint8_t* previousRow, uint32_t rowSize, uint8_t* filteredRow )
+{
+    uint64_t cost = 0;
+    for ( uint32_t x = 0; x < rowSize; ++x )
+    {
+        const uint8_t value = FilterPNGByte<FilterType>( row, previousRow, x );
+        if ( filteredRow )
+        {
+            filteredRow[ x ] = value;
+        }
+        else
+        {
+            cost += abs( (int8_t)value );
+        }
+    }
+    return cost;
+}
+
+typedef uint64_t ( *FilterPNGRowFunction )( const uint8_t*, const uint8_t*, uint32_t, uint8_t* );
+static const FilterPNGRowFunction s_FilterPNGRowFunctions[ 5 ] = { FilterPNGRow<0>, FilterPNGRow<1>, FilterPNGRow<2>, FilterPNGRow<3>, FilterPNGRow<4> };
+
+// Picks the filter with the smallest sum of absolute signed residuals, the usual heuristic of PNG encoders
+static void FilterPNGRow( const uint8_t* row, const uint8_t* previousRow, uint32_t rowSize, uint8_t* filteredRow )
+{
+    uint32_t bestFilterType = 0;
+    uint64_t bestCost = std::numeric_limits<uint64_t>::max();
+    for ( uint32_t filterType = 0; filterType < 5; ++filterType )
+    {
+        const uint64_t cost = s_FilterPNGRowFunctions[ filterType ]( row, previousRow, rowSize, nullptr );
+        if ( cost < bestCost )
+        {
+            bestCost = cost;
+            bestFilterType = filterType;
+        }
+    }
+
+    filteredRow[ 0 ] = (uint8_t)bestFilterType;
+    s_FilterPNGRowFunctions[ bestFilterType ]( row, previousRow, rowSize, filteredRow + 1 );
+}
+
+// Encodes file rows [ rowBegin, rowEnd ), PFM stores the bottom row first
+static void EncodeStrip( const SImageWriteDesc& desc, const ImageRowProvider& rowProvider, uint32_t rowBegin, uint32_t rowEnd, bool isLastStrip,
+    SStripWorkspace* workspace, SEncodedStrip* strip )
+{
+    const uint32_t fileRowSize = desc.m_Width * GetFileFormatPixelSize( desc.m_FileFormat );
+    const bool isPNG = desc.m_FileFormat == EImageFileFormat::PNG;
+    const uint32_t firstRow = isPNG && rowBegin > 0 ? rowBegin - 1 : rowBegin;
+
+    workspace->m_SourceRow.resize( (size_t)desc.m_Width * GetRowFormatPixelSize( desc.m_RowFormat ) );
+    workspace->m_FileRows.resize( (size_t)( rowEnd - firstRow ) * fileRowSize );
+    for ( uint32_t row = firstRow; row < rowEnd; ++row )
+    {
+        const uint32_t y = desc.m_FileFormat == EImageFileFormat::PFM ? desc.m_Height - 1 - row : row;
+        rowProvider( y, workspace->m_SourceRow.data() );
+        ConvertRow( workspace->m_SourceRow.data(), desc.m_RowFormat, desc.m_FileFormat, desc.m_Width, workspace->m_FileRows.data() + (size_t)( row - firstRow ) * fileRowSize );
+    }
+
+    strip->m_Data.clear();
+    if ( isPNG )
+    {
+        // The row above the strip is only used for prediction, the first row of the image is predicted from zeros
+        std::vector<uint8_t> zeroRow;
+        const uint8_t* previousRow = workspace->m_FileRows.data();
+        const uint8_t* row = previousRow;
+        if ( rowBegin == 0 )
+        {
+            zeroRow.resize( fileRowSize, 0 );
+            previousRow = zeroRow.data();
+        }
+        else
+        {
+            row += fileRowSize;
+        }
+
+        workspace->m_FilteredRows.resize( (size_t)( rowEnd - rowBegin ) * ( fileRowSize + 1 ) );
+        for ( uint32_t iRow = 0; iRow < rowEnd - rowBegin; ++iRow )
+        {
+            FilterPNGRow( row, previousRow, fileRowSize, workspace->m_FilteredRows.data() + (size_t)iRow * ( fileRowSize + 1 ) );
+            previousRow = row;
+            row += fileRowSize;
+        }
+
+        if ( rowBegin == 0 )
+        {
+            // zlib header, 32K window and no preset dictionary
+            strip->m_Data.push_back( 0x78 );
+            strip->m_Data.push_back( 0x01 );
+        }
+        DeflateBlocks( workspace->m_FilteredRows.data(), workspace->m_FilteredRows.size(), isLastStrip, &strip->m_Data );
+        strip->m_Adler32 = CalculateAdler32( workspace->m_FilteredRows.data(), workspace->m_FilteredRows.size() );
+        strip->m_RawSize = workspace->m_FilteredRows.size();
+    }
+    else if ( desc.m_FileFormat == EImageFileFormat::BMP )
+    {
+        const uint32_t paddedRowSize = ( fileRowSize + 3 ) & ~3u;
+        strip->m_Data.resize( (size_t)( rowEnd - rowBegin ) * paddedRowSize, 0 );
+        for ( uint32_t iRow = 0; iRow < rowEnd - rowBegin; ++iRow )
+        {
+            memcpy( strip->m_Data.data() + (size_t)iRow * paddedRowSize, workspace->m_FileRows.data() + (size_t)iRow * fileRowSize, fileRowSize );
+        }
+    }
+    else
+    {
+        strip->m_Data.swap( workspace->m_FileRows );
+    }
+}
+
+static void AppendUInt16LE( std::vector<uint8_t>* data, uint32_t value )
+{
+    data->push_back( (uint8_t)value );
+    data->push_back( (uint8_t)( value >> 8 ) );
+}
+
+static void AppendUInt32LE( std::vector<uint8_t>* data, uint32_t value )
+{
+    AppendUInt16LE( data, value & 0xFFFF );
+    AppendUInt16LE( data, value >> 16 );
+}
+
+static void AppendUInt32BE( std::vector<uint8_t>* data, uint32_t value )
+{
+    data->push_back( (uint8_t)( value >> 24 ) );
+    data->push_back( (uint8_t)( value >> 16 ) );
+    data->push_back( (uint8_t)( value >> 8 ) );
+    data->push_back( (uint8_t)value );
+}
+
+static void WritePNGChunk( std::ofstream& file, const char* type, const uint8_t* data, size_t size )
+{
+    std::vector<uint8_t> header;
+    AppendUInt32BE( &header, (uint32_t)size );
+    header.insert( header.end(), type, type + 4 );
+    file.write( (const char*)header.data(), header.size() );
+    file.write( (const char*)data, size );
+
+    uint32_t crc = CalculateCRC32( (const uint8_t*)type, 4 );
+    crc = CalculateCRC32( data, size, crc );
+    std::vector<uint8_t> footer;
+    AppendUInt32BE( &footer, crc );
+    file.write( (const char*)footer.data(), footer.size() );
+}
+
+static bool WriteImageHeader( std::ofstream& file, const SImageWriteDesc& desc )
+{
+    std::vector<uint8_t> header;
+    switch ( desc.m_FileFormat )
+    {
+    case EImageFileFormat::BMP:
+    {
+        const uint64_t imageSize = (uint64_t)( ( desc.m_Width * 3 + 3 ) & ~3u ) * desc.m_Height;
+        if ( 54 + imageSize > std::numeric_limits<uint32_t>::max() || desc.m_Height > (uint32_t)std::numeric_limits<int32_t>::max() )
+        {
+            LOG_STRING( "Image is too large for the BMP format.\n" );
+            return false;
+        }
+        header.push_back( 'B' );
+        header.push_back( 'M' );
+        AppendUInt32LE( &header, (uint32_t)( 54 + imageSize ) );
+        AppendUInt32LE( &header, 0 );
+        AppendUInt32LE( &header, 54 );
+        AppendUInt32LE( &header, 40 );
+        AppendUInt32LE( &header, desc.m_Width );
+        AppendUInt32LE( &header, (uint32_t)-(int32_t)desc.m_Height ); // Negative height stores the rows top-down
+        AppendUInt16LE( &header, 1 );
+        AppendUInt16LE( &header, 24 );
+        AppendUInt32LE( &header, 0 );
+        AppendUInt32LE( &header, (uint32_t)imageSize );
+        AppendUInt32LE( &header, 2835 ); // 72 DPI
+        AppendUInt32LE( &header, 2835 );
+        AppendUInt32LE( &header, 0 );
+        AppendUInt32LE( &header, 0 );
+        break;
+    }
+    case EImageFileFormat::TGA:
+    {
+        if ( desc.m_Width > 0xFFFF || desc.m_Height > 0xFFFF )
+        {
+            LOG_STRING( "Image is too large for the TGA format.\n" );
+            return false;
+        }
+        header.resize( 12, 0 );
+        header[ 2 ] = 2; // Uncompressed true color
+        AppendUInt16LE( &header, desc.m_Width );
+        AppendUInt16LE( &header, desc.m_Height );
+        header.push_back( 24 );
+        header.push_back( 0x20 ); // Top-left origin
+        break;
+    }
+    case EImageFileFormat::PNG:
+    {
+        const uint8_t signature[ 8 ] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        file.write( (const char*)signature, sizeof( signature ) );
+        AppendUInt32BE( &header, desc.m_Width );
+        AppendUInt32BE( &header, desc.m_Height );
+        header.push_back( 8 ); // Bit depth
+        header.push_back( 2 ); // RGB
+        header.push_back( 0 );
+        header.push_back( 0 );
+        header.push_back( 0 );
+        WritePNGChunk( file, "IHDR", header.data(), header.size() );
+        return true;
+    }
+    case EImageFileFormat::PFM:
+    {
+        // The negative scale marks the data as little endian
+        const std::string text = "PF\n" + std::to_string( desc.m_Width ) + " " + std::to_string( desc.m_Height ) + "\n-1.0\n";
+        header.assign( text.begin(), text.end() );
+        break;
+    }
+    }
+    file.write( (const char*)header.data(), header.size() );
+    return true;
+}
+
+static bool WriteImage( const std::filesystem::path& filepath, const SImageWriteDesc& desc, const ImageRowProvider& rowProvider, size_t* outWorkingMemorySize )
+{
+    if ( desc.m_Width == 0 || desc.m_Height == 0 )
+    {
+        return false;
+    }
+
+    std::ofstream file( filepath, std::ios::binary | std::ios::trunc );
+    if ( !file )
+    {
+        LOG_STRING_FORMAT( "Failed to open image file \"%s\" for writing.\n", filepath.u8string().c_str() );
+        return false;
+    }
+
+    if ( !WriteImageHeader( file, desc ) )
+    {
+        return false;
+    }
+
+    const size_t sourceRowSize = (size_t)desc.m_Width * GetRowFormatPixelSize( desc.m_RowFormat );
+    const uint32_t rowsPerStrip = (uint32_t)std::max( (size_t)1, std::min( (size_t)IMAGE_WRITING_STRIP_SIZE / sourceRowSize, (size_t)desc.m_Height ) );
+    const uint32_t stripCount = ( desc.m_Height + rowsPerStrip - 1 ) / rowsPerStrip;
+    const uint32_t workerCount = GetParallelForWorkerCount( stripCount );
+
+    // Strips are encoded a batch at a time and written in order, which bounds the memory to one batch of strips
+    std::vector<SStripWorkspace> workspaces( workerCount );
+    std::vector<SEncodedStrip> strips( workerCount );
+    uint32_t adler32 = 1;
+    size_t workingMemorySize = 0;
+    for ( uint32_t batchBegin = 0; batchBegin < stripCount && file; batchBegin += workerCount )
+    {
+        const uint32_t batchStripCount = std::min( workerCount, stripCount - batchBegin );
+        ParallelFor( batchStripCount, [&]( uint32_t workerIndex, uint32_t index )
+        {
+            const uint32_t stripIndex = batchBegin + index;
+            const uint32_t rowBegin = stripIndex * rowsPerStrip;
+            const uint32_t rowEnd = std::min( rowBegin + rowsPerStrip, desc.m_Height );
+            EncodeStrip( desc, rowProvider, rowBegin, rowEnd, stripIndex == stripCount - 1, &workspaces[ workerIndex ], &strips[ index ] );
+        }, workerCount );
+
+        size_t batchMemorySize = 0;
+        for ( uint32_t index = 0; index < batchStripCount; ++index )
+        {
+            const SEncodedStrip& strip = strips[ index ];
+            if ( desc.m_FileFormat == EImageFileFormat::PNG )
+            {
+                WritePNGChunk( file, "IDAT", strip.m_Data.data(), strip.m_Data.size() );
+                adler32 = CombineAdler32( adler32, strip.m_Adler32, strip.m_RawSize );
+            }
+            else
+            {
+                file.write( (const char*)strip.m_Data.data(), strip.m_Data.size() );
+            }
+            batchMemorySize += strip.m_Data.capacity();
+        }
+        for ( const SStripWorkspace& workspace : workspaces )
+        {
+            batchMemorySize += workspace.m_SourceRow.capacity() + workspace.m_FileRows.capacity() + workspace.m_FilteredRows.capacity();
+        }
+        workingMemorySize = std::max( workingMemorySize, batchMemorySize );
+    }
+
+    if ( desc.m_FileFormat == EImageFileFormat::PNG )
+    {
+        std::vector<uint8_t> checksum;
+        AppendUInt32BE( &checksum, adler32 );
+        WritePNGChunk( file, "IDAT", checksum.data(), checksum.size() );
+        WritePNGChunk( file, "IEND", nullptr, 0 );
+    }
+
+    if ( !file )
+    {
+        LOG_STRING_FORMAT( "Failed to write image file \"%s\".\n", filepath.u8string().c_str() );
+        return false;
+    }
+
+    if ( outWorkingMemorySize )
+    {
+        *outWorkingMemorySize = workingMemorySize;
+    }
+    return true;
+}
+
+bool GetImageFileFormatFromExtension( const std::filesystem::path& filepath, EImageFileFormat* format )
+{
+    std::string extension = filepath.extension().u8string();
+    std::transform( extension.begin(), extension.end(), extension.begin(), []( char c ) { return (char)tolower( c ); } );
+    if ( extension == ".bmp" )
+    {
+        *format = EImageFileFormat::BMP;
+    }
+    else if ( extension == ".tga" )
+    {
+        *format = EImageFileFormat::TGA;
+    }
+    else if ( extension == ".png" )
+    {
+        *format = EImageFileFormat::PNG;
+    }
+    else if ( extension == ".pfm" )
+    {
+        *format = EImageFileFormat::PFM;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+bool WriteImageToFile( const std::filesystem::path& filepath, const SImageWriteDesc& desc, const ImageRowProvider& rowProvider )
+{
+    return WriteImage( filepath, desc, rowProvider, nullptr );
+}
+
+void RunImageWritingBenchmark( const std::filesystem::path& directory, uint32_t size )
+{
+    struct SBenchmarkFormat
+    {
+        EImageFileFormat m_FileFormat;
+        EImageRowFormat m_RowFormat;
+        const char* m_Extension;
+    };
+    const SBenchmarkFormat formats[] =
+    {
+        { EImageFileFormat::BMP, EImageRowFormat::R8G8B8A8_sRGB, "bmp" },
+        { EImageFileFormat::TGA, EImageRowFormat::R8G8B8A8_sRGB, "tga" },
+        { EImageFileFormat::PNG, EImageRowFormat::R8G8B8A8_sRGB, "png" },
+        { EImageFileFormat::PFM, EImageRowFormat::R32G32B32_Float, "pfm" },
+    };
+
+    // Smooth gradients with a little per pixel noise, roughly what a partially converged render compresses like
+    auto SyntheticValue = [size]( uint32_t x, uint32_t y, uint32_t channel )
+    {
+        uint32_t hash = ( x * 73856093u ) ^ ( y * 19349663u ) ^ ( channel * 83492791u );
+        hash = ( hash ^ ( hash >> 13 ) ) * 0x5bd1e995u;
+        const uint32_t gradient = channel == 0 ? x : ( channel == 1 ? y : ( x + y ) / 2 );
+        return std::min( ( gradient * 240.f ) / size + ( ( hash >> 24 ) & 15 ), 255.f ) / 255.f;
+    };
+
+    std::error_code errorCode;
+    std::filesystem::create_directories( directory, errorCode );
+    for ( const SBenchmarkFormat& format : formats )
+    {
+        SImageWriteDesc desc;
+        desc.m_Width = size;
+        desc.m_Height = size;
+        desc.m_RowFormat = format.m_RowFormat;
+        desc.m_FileFormat = format.m_FileFormat;
+
+        const std::filesystem::path filepath = directory / ( std::string( "ImageWritingBenchmark." ) + format.m_Extension );
+        Timer timer;
+        timer.Start();
+        size_t workingMemorySize = 0;
+        const bool result = WriteImage( filepath, desc, [&]( uint32_t y, void* row )
+        {
+            if ( format.m_RowFormat == EImageRowFormat::R8G8B8A8_sRGB )
+            {
+                uint8_t* texel = (uint8_t*)row;
+                for ( uint32_t x = 0; x < size; ++x, texel += 4 )
+                {
+                    texel[ 0 ] = (uint8_t)( SyntheticValue( x, y, 0 ) * 255.f );
+                    texel[ 1 ] = (uint8_t)( SyntheticValue( x, y, 1 ) * 255.f );
+                    texel[ 2 ] = (uint8_t)( SyntheticValue( x, y, 2 ) * 255.f );
+                    texel[ 3 ] = 255;
+                }
+            }
+            else
+            {
+                float* texel = (float*)row;
+                for ( uint32_t x = 0; x < size; ++x, texel += 3 )
+                {
+                    texel[ 0 ] = SyntheticValue( x, y, 0 );
+                    texel[ 1 ] = SyntheticValue( x, y, 1 );
+                    texel[ 2 ] = SyntheticValue( x, y, 2 );
+                }
+            }
+        }, &workingMemorySize );
+        const float elapsedSeconds = std::max( timer.GetElapsedSecondsFloat().count(), 1e-6f );
+
+        if ( !result )
+        {
+            LOG_STRING_FORMAT( "%s: writing %ux%u image failed.\n", format.m_Extension, size, size );
+            continue;
+        }
+
+        const uint64_t fileSize = std::filesystem::file_size( filepath, errorCode );
+        LOG_STRING_FORMAT( "%s: %ux%u in %.3f s, %.2f MPixels/s, %.2f MB written (%.2f MB/s), %.2f MB working memory.\n", format.m_Extension, size, size, elapsedSeconds,
+            (float)size * size / 1000000.f / elapsedSeconds, fileSize / ( 1024.f * 1024.f ), fileSize / ( 1024.f * 1024.f ) / elapsedSeconds, workingMemorySize / ( 1024.f * 1024.f ) );
+        std::filesystem::remove( filepath, errorCode );
+    }
+}
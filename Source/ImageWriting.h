@@ -0,0 +1,35 @@
+#pragma once
+
+enum class EImageFileFormat
+{
+    BMP,    // 24-bit, uncompressed
+    TGA,    // 24-bit, uncompressed
+    PNG,    // 24-bit
+    PFM,    // 32-bit float RGB
+};
+
+enum class EImageRowFormat
+{
+    R8G8B8A8_sRGB,      // Alpha is ignored
+    R32G32B32_Float,    // Linear
+};
+
+// Writes row y, counted from the top, into the buffer in the row format of the image. It is called from worker threads concurrently and for rows in any order.
+typedef std::function<void( uint32_t y, void* row )> ImageRowProvider;
+
+struct SImageWriteDesc
+{
+    uint32_t m_Width;
+    uint32_t m_Height;
+    EImageRowFormat m_RowFormat;
+    EImageFileFormat m_FileFormat;
+};
+
+bool GetImageFileFormatFromExtension( const std::filesystem::path& filepath, EImageFileFormat* format );
+
+// Pulls rows from the provider in strips and encodes them on worker threads, so the memory used is bounded by a few strips per worker
+// no matter how large the image is. Float rows are clamped and sRGB encoded for the 8-bit formats, sRGB rows are linearized for PFM.
+bool WriteImageToFile( const std::filesystem::path& filepath, const SImageWriteDesc& desc, const ImageRowProvider& rowProvider );
+
+// Writes a synthetic size x size image in every file format and logs the throughput and the working memory of the writer
+void RunImageWritingBenchmark( const std::filesystem::path& directory, uint32_t size );
@@ -0,0 +1,443 @@
+#include "stdafx.h"
+#include "Inflate.h"
+#include "Deflate.h"
+
+namespace
+{
+    const uint32_t s_MaxCodeBits = 15;
+    const uint32_t s_MaxLiteralLengthCodes = 286;
+    const uint32_t s_MaxDistanceCodes = 30;
+    const uint32_t s_FixedLiteralLengthCodes = 288;
+    const uint32_t s_FastLookupBits = 9;
+
+    const uint16_t s_LengthBase[ 29 ] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const uint16_t s_LengthExtraBits[ 29 ] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const uint16_t s_DistanceBase[ 30 ] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const uint16_t s_DistanceExtraBits[ 30 ] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    const uint8_t s_CodeLengthOrder[ 19 ] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    // Canonical Huffman table. Codes up to s_FastLookupBits long are decoded with a single lookup of the next input bits, each entry holding
+    // the symbol in the upper bits and the code length in the lower 4 bits, 0 for longer codes. Those are decoded one bit at a time by
+    // walking the code counts of each length.
+    struct SHuffmanTable
+    {
+        uint16_t m_FastEntries[ 1 << s_FastLookupBits ];
+        uint16_t m_Counts[ s_MaxCodeBits + 1 ];
+        uint16_t m_Symbols[ s_FixedLiteralLengthCodes ];
+    };
+
+    struct SInflateState
+    {
+        const uint8_t* m_Data;
+        size_t m_Size;
+        size_t m_Position;
+        uint32_t m_BitBuffer;
+        uint32_t m_BitCount;
+        bool m_Overrun;
+        std::vector<uint8_t>* m_Output;
+        size_t m_OutputBase;
+    };
+}
+
+static void RefillBits( SInflateState* state )
+{
+    while ( state->m_BitCount <= 24 && state->m_Position < state->m_Size )
+    {
+        state->m_BitBuffer |= (uint32_t)state->m_Data[ state->m_Position++ ] << state->m_BitCount;
+        state->m_BitCount += 8;
+    }
+}
+
+// Drops the bits left in the current byte and returns the whole bytes buffered ahead to the input
+static void AlignToByte( SInflateState* state )
+{
+    state->m_Position -= state->m_BitCount / 8;
+    state->m_BitBuffer = 0;
+    state->m_BitCount = 0;
+}
+
+static uint32_t ReadBits( SInflateState* state, uint32_t count )
+{
+    uint32_t bitBuffer = state->m_BitBuffer;
+    while ( state->m_BitCount < count )
+    {
+        if ( state->m_Position == state->m_Size )
+        {
+            state->m_Overrun = true;
+            return 0;
+        }
+        bitBuffer |= (uint32_t)state->m_Data[ state->m_Position++ ] << state->m_BitCount;
+        state->m_BitCount += 8;
+    }
+    state->m_BitBuffer = bitBuffer >> count;
+    state->m_BitCount -= count;
+    return bitBuffer & ( ( 1u << count ) - 1 );
+}
+
+// Returns false if the code lengths are over-subscribed
+static bool BuildHuffmanTable( const uint8_t* lengths, uint32_t count, SHuffmanTable* table )
+{
+    memset( table->m_FastEntries, 0, sizeof( table->m_FastEntries ) );
+    memset( table->m_Counts, 0, sizeof( table->m_Counts ) );
+    for ( uint32_t symbol = 0; symbol < count; ++symbol )
+    {
+        table->m_Counts[ lengths[ symbol ] ]++;
+    }
+    if ( table->m_Counts[ 0 ] == count )
+    {
+        return true;
+    }
+
+    int32_t left = 1;
+    for ( uint32_t length = 1; length <= s_MaxCodeBits; ++length )
+    {
+        left <<= 1;
+        left -= table->m_Counts[ length ];
+        if ( left < 0 )
+        {
+            return false;
+        }
+    }
+
+    uint16_t offsets[ s_MaxCodeBits + 1 ];
+    offsets[ 1 ] = 0;
+    for ( uint32_t length = 1; length < s_MaxCodeBits; ++length )
+    {
+        offsets[ length + 1 ] = offsets[ length ] + table->m_Counts[ length ];
+    }
+    for ( uint32_t symbol = 0; symbol < count; ++symbol )
+    {
+        if ( lengths[ symbol ] != 0 )
+        {
+            table->m_Symbols[ offsets[ lengths[ symbol ] ]++ ] = (uint16_t)symbol;
+        }
+    }
+
+    // Codes are packed starting from their most significant bit while the input is read from the least significant one, so the lookup
+    // index is the bit reversed code, repeated for every value of the bits following it
+    uint32_t nextCodes[ s_FastLookupBits + 1 ];
+    uint32_t code = 0;
+    nextCodes[ 1 ] = 0;
+    for ( uint32_t length = 1; length < s_FastLookupBits; ++length )
+    {
+        code = ( code + table->m_Counts[ length ] ) << 1;
+        nextCodes[ length + 1 ] = code;
+    }
+    for ( uint32_t symbol = 0; symbol < count; ++symbol )
+    {
+        const uint32_t length = lengths[ symbol ];
+        if ( length == 0 || length > s_FastLookupBits )
+        {
+            continue;
+        }
+        const uint32_t symbolCode = nextCodes[ length ]++;
+        uint32_t reversedCode = 0;
+        for ( uint32_t bit = 0; bit < length; ++bit )
+        {
+            reversedCode |= ( ( symbolCode >> bit ) & 1 ) << ( length - 1 - bit );
+        }
+        const uint16_t entry = (uint16_t)( ( symbol << 4 ) | length );
+        for ( uint32_t index = reversedCode; index < ( 1u << s_FastLookupBits ); index += 1u << length )
+        {
+            table->m_FastEntries[ index ] = entry;
+        }
+    }
+    return true;
+}
+
+// Returns -1 on invalid code or input overrun
+static int32_t DecodeSymbol( SInflateState* state, const SHuffmanTable& table )
+{
+    RefillBits( state );
+    const uint32_t entry = table.m_FastEntries[ state->m_BitBuffer & ( ( 1u << s_FastLookupBits ) - 1 ) ];
+    const uint32_t entryLength = entry & 0xF;
+    if ( entry != 0 && entryLength <= state->m_BitCount )
+    {
+        state->m_BitBuffer >>= entryLength;
+        state->m_BitCount -= entryLength;
+        return (int32_t)( entry >> 4 );
+    }
+
+    // Codes longer than the lookup, invalid codes and the end of the input
+    int32_t code = 0;
+    int32_t first = 0;
+    int32_t index = 0;
+    for ( uint32_t length = 1; length <= s_MaxCodeBits; ++length )
+    {
+        code |= (int32_t)ReadBits( state, 1 );
+        if ( state->m_Overrun )
+        {
+            return -1;
+        }
+        const int32_t count = table.m_Counts[ length ];
+        if ( code - count < first )
+        {
+            return table.m_Symbols[ index + ( code - first ) ];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+static bool InflateStoredBlock( SInflateState* state )
+{
+    // Stored blocks start at a byte boundary
+    AlignToByte( state );
+
+    if ( state->m_Position + 4 > state->m_Size )
+    {
+        return false;
+    }
+    const uint32_t length = state->m_Data[ state->m_Position ] | ( state->m_Data[ state->m_Position + 1 ] << 8 );
+    const uint32_t lengthComplement = state->m_Data[ state->m_Position + 2 ] | ( state->m_Data[ state->m_Position + 3 ] << 8 );
+    state->m_Position += 4;
+    if ( length != ( ~lengthComplement & 0xFFFF ) || state->m_Position + length > state->m_Size )
+    {
+        return false;
+    }
+
+    state->m_Output->insert( state->m_Output->end(), state->m_Data + state->m_Position, state->m_Data + state->m_Position + length );
+    state->m_Position += length;
+    return true;
+}
+
+static bool InflateHuffmanBlock( SInflateState* state, const SHuffmanTable& literalLengthTable, const SHuffmanTable& distanceTable )
+{
+    std::vector<uint8_t>& output = *state->m_Output;
+    while ( true )
+    {
+        int32_t symbol = DecodeSymbol( state, literalLengthTable );
+        if ( symbol < 0 )
+        {
+            return false;
+        }
+
+        if ( symbol < 256 )
+        {
+            output.push_back( (uint8_t)symbol );
+        }
+        else if ( symbol == 256 )
+        {
+            return true;
+        }
+        else
+        {
+            symbol -= 257;
+            if ( symbol >= 29 )
+            {
+                return false;
+            }
+            const uint32_t length = s_LengthBase[ symbol ] + ReadBits( state, s_LengthExtraBits[ symbol ] );
+
+            const int32_t distanceSymbol = DecodeSymbol( state, distanceTable );
+            if ( distanceSymbol < 0 || distanceSymbol >= 30 )
+            {
+                return false;
+            }
+            const uint32_t distance = s_DistanceBase[ distanceSymbol ] + ReadBits( state, s_DistanceExtraBits[ distanceSymbol ] );
+            if ( state->m_Overrun || distance > output.size() - state->m_OutputBase )
+            {
+                return false;
+            }
+
+            // Byte by byte since the source may overlap the bytes being written
+            size_t source = output.size() - distance;
+            output.resize( output.size() + length );
+            uint8_t* destination = output.data() + output.size() - length;
+            const uint8_t* sourceData = output.data() + source;
+            for ( uint32_t i = 0; i < length; ++i )
+            {
+                destination[ i ] = sourceData[ i ];
+            }
+        }
+    }
+}
+
+struct SFixedHuffmanTables
+{
+    SFixedHuffmanTables()
+    {
+        uint8_t lengths[ s_FixedLiteralLengthCodes ];
+        uint32_t symbol = 0;
+        for ( ; symbol < 144; ++symbol ) lengths[ symbol ] = 8;
+        for ( ; symbol < 256; ++symbol ) lengths[ symbol ] = 9;
+        for ( ; symbol < 280; ++symbol ) lengths[ symbol ] = 7;
+        for ( ; symbol < s_FixedLiteralLengthCodes; ++symbol ) lengths[ symbol ] = 8;
+        BuildHuffmanTable( lengths, s_FixedLiteralLengthCodes, &m_LiteralLengthTable );
+
+        for ( symbol = 0; symbol < s_MaxDistanceCodes; ++symbol ) lengths[ symbol ] = 5;
+        BuildHuffmanTable( lengths, s_MaxDistanceCodes, &m_DistanceTable );
+    }
+
+    SHuffmanTable m_LiteralLengthTable;
+    SHuffmanTable m_DistanceTable;
+};
+
+static bool InflateFixedBlock( SInflateState* state )
+{
+    static const SFixedHuffmanTables s_FixedTables;
+    return InflateHuffmanBlock( state, s_FixedTables.m_LiteralLengthTable, s_FixedTables.m_DistanceTable );
+}
+
+static bool InflateDynamicBlock( SInflateState* state )
+{
+    const uint32_t literalLengthCount = ReadBits( state, 5 ) + 257;
+    const uint32_t distanceCount = ReadBits( state, 5 ) + 1;
+    const uint32_t codeLengthCount = ReadBits( state, 4 ) + 4;
+    if ( state->m_Overrun || literalLengthCount > s_MaxLiteralLengthCodes || distanceCount > s_MaxDistanceCodes )
+    {
+        return false;
+    }
+
+    uint8_t lengths[ s_MaxLiteralLengthCodes + s_MaxDistanceCodes ] = {};
+    for ( uint32_t i = 0; i < codeLengthCount; ++i )
+    {
+        lengths[ s_CodeLengthOrder[ i ] ] = (uint8_t)ReadBits( state, 3 );
+    }
+
+    SHuffmanTable codeLengthTable;
+    if ( state->m_Overrun || !BuildHuffmanTable( lengths, 19, &codeLengthTable ) )
+    {
+        return false;
+    }
+
+    uint32_t index = 0;
+    while ( index < literalLengthCount + distanceCount )
+    {
+        int32_t symbol = DecodeSymbol( state, codeLengthTable );
+        if ( symbol < 0 )
+        {
+            return false;
+        }
+
+        if ( symbol < 16 )
+        {
+            lengths[ index++ ] = (uint8_t)symbol;
+            continue;
+        }
+
+        uint8_t repeatedLength = 0;
+        uint32_t repeatCount = 0;
+        if ( symbol == 16 )
+        {
+            if ( index == 0 )
+            {
+                return false;
+            }
+            repeatedLength = lengths[ index - 1 ];
+            repeatCount = 3 + ReadBits( state, 2 );
+        }
+        else if ( symbol == 17 )
+        {
+            repeatCount = 3 + ReadBits( state, 3 );
+        }
+        else
+        {
+            repeatCount = 11 + ReadBits( state, 7 );
+        }
+
+        if ( state->m_Overrun || index + repeatCount > literalLengthCount + distanceCount )
+        {
+            return false;
+        }
+        while ( repeatCount-- )
+        {
+            lengths[ index++ ] = repeatedLength;
+        }
+    }
+
+    // The end of block code must be present
+    if ( lengths[ 256 ] == 0 )
+    {
+        return false;
+    }
+
+    SHuffmanTable literalLengthTable;
+    SHuffmanTable distanceTable;
+    if ( !BuildHuffmanTable( lengths, literalLengthCount, &literalLengthTable )
+        || !BuildHuffmanTable( lengths + literalLengthCount, distanceCount, &distanceTable ) )
+    {
+        return false;
+    }
+
+    return InflateHuffmanBlock( state, literalLengthTable, distanceTable );
+}
+
+bool InflateZlibStream( const uint8_t* data, size_t size, std::vector<uint8_t>* outData, size_t* outConsumedSize )
+{
+    if ( size < 6 )
+    {
+        return false;
+    }
+
+    const uint8_t compressionMethodAndFlags = data[ 0 ];
+    const uint8_t flags = data[ 1 ];
+    if ( ( compressionMethodAndFlags & 0x0F ) != 8 || ( ( compressionMethodAndFlags << 8 ) | flags ) % 31 != 0 || ( flags & 0x20 ) != 0 )
+    {
+        // Not deflate, corrupted header or a preset dictionary is required
+        return false;
+    }
+
+    SInflateState state;
+    state.m_Data = data;
+    state.m_Size = size;
+    state.m_Position = 2;
+    state.m_BitBuffer = 0;
+    state.m_BitCount = 0;
+    state.m_Overrun = false;
+    state.m_Output = outData;
+    state.m_OutputBase = outData->size();
+
+    bool isFinalBlock = false;
+    while ( !isFinalBlock )
+    {
+        isFinalBlock = ReadBits( &state, 1 ) != 0;
+        const uint32_t blockType = ReadBits( &state, 2 );
+        if ( state.m_Overrun )
+        {
+            return false;
+        }
+
+        bool succeeded = false;
+        switch ( blockType )
+        {
+        case 0:
+            succeeded = InflateStoredBlock( &state );
+            break;
+        case 1:
+            succeeded = InflateFixedBlock( &state );
+            break;
+        case 2:
+            succeeded = InflateDynamicBlock( &state );
+            break;
+        default:
+            break;
+        }
+        if ( !succeeded )
+        {
+            return false;
+        }
+    }
+
+    // The checksum follows at the next byte boundary
+    AlignToByte( &state );
+    if ( state.m_Position + 4 > state.m_Size )
+    {
+        return false;
+    }
+    const uint8_t* checksumData = state.m_Data + state.m_Position;
+    const uint32_t checksum = ( checksumData[ 0 ] << 24 ) | ( checksumData[ 1 ] << 16 ) | ( checksumData[ 2 ] << 8 ) | checksumData[ 3 ];
+    if ( checksum != CalculateAdler32( outData->data() + state.m_OutputBase, outData->size() - state.m_OutputBase ) )
+    {
+        return false;
+    }
+
+    if ( outConsumedSize )
+    {
+        *outConsumedSize = state.m_Position + 4;
+    }
+    return true;
+}
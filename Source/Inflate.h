@@ -0,0 +1,4 @@
+#pragma once
+
+// Decompresses a zlib stream (RFC 1950 wrapping RFC 1951 deflate). The decompressed bytes are appended to outData.
+bool InflateZlibStream( const uint8_t* data, size_t size, std::vector<uint8_t>* outData, size_t* outConsumedSize = nullptr );
@@ -14,6 +14,7 @@
 #include "ScopedRenderAnnotation.h"
 #include "BxDFTexturesBuilding.h"
 #include "SaveImageToFile.h"
+#include "CPUPathTracer.h"
 
 using namespace DirectX;
 
@@ -21,13 +22,17 @@ CDirectComputeRayTracing::CDirectComputeRayTracing( HWND hWnd )
 {
     m_hWnd = hWnd;
     m_Scene = new CScene();
+    m_CPUPathTracer = new CCPUPathTracer();
 }
 
 CDirectComputeRayTracing::~CDirectComputeRayTracing()
 {
     D3D12Adapter::WaitForGPU(); // Wait for the latest frame (the last frame) to finish
 
-    ShutdownImGui();
+    if ( m_hWnd )
+    {
+        ShutdownImGui();
+    }
     
     m_Scene->m_PathTracer[ m_ActivePathTracerIndex ]->Destroy();
     for ( auto& it : m_Scene->m_PathTracer )
@@ -35,6 +40,7 @@ CDirectComputeRayTracing::~CDirectComputeRayTracing()
         delete it;
     }
     delete m_Scene;
+    delete m_CPUPathTracer;
 
     for ( auto& backbuffer : m_sRGBBackbuffers )
     {
@@ -50,7 +56,7 @@ bool CDirectComputeRayTracing::Init()
     if ( !D3D12Adapter::Init( m_hWnd ) )
         return false;
 
-    if ( !InitImGui( m_hWnd ) )
+    if ( m_hWnd && !InitImGui( m_hWnd ) )
         return false;
 
     CD3D12Resource::CreateDeferredDeleteQueue();
@@ -69,13 +75,16 @@ bool CDirectComputeRayTracing::Init()
         return false;
     }
 
-    m_sRGBBackbuffers.resize( D3D12Adapter::GetBackbufferCount() );
-    for ( uint32_t index = 0; index < D3D12Adapter::GetBackbufferCount(); ++index )
-    { 
-        m_sRGBBackbuffers[ index ].reset( GPUTexture::CreateFromSwapChain( DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, index ) );
-        if ( !m_sRGBBackbuffers[ index ] )
+    if ( m_hWnd )
+    {
+        m_sRGBBackbuffers.resize( D3D12Adapter::GetBackbufferCount() );
+        for ( uint32_t index = 0; index < D3D12Adapter::GetBackbufferCount(); ++index )
         { 
-            return false;
+            m_sRGBBackbuffers[ index ].reset( GPUTexture::CreateFromSwapChain( DXGI_FORMAT_R8G8B8A8_UNORM_SRGB, index ) );
+            if ( !m_sRGBBackbuffers[ index ] )
+            { 
+                return false;
+            }
         }
     }
 
@@ -203,8 +212,8 @@ static void DispatchRayTracing( CDirectComputeRayTracing* r, CScene* scene, SRen
     scene->m_IsFilmDirty = scene->m_IsFilmDirty || scene->m_IsLightGPUBufferDirty || scene->m_IsMaterialGPUBufferDirty || scene->m_IsInstanceFlagsBufferDirty
         || scene->m_Camera.IsDirty() || scene->m_PathTracer[ r->m_ActivePathTracerIndex ]->AcquireFilmClearTrigger();
 
-    const bool isResolutionChanged = ( scene->m_IsFilmDirty != scene->m_IsLastFrameFilmDirty );
-    renderContext->m_IsSmallResolutionEnabled = scene->m_IsFilmDirty;
+    const bool isResolutionChanged = r->m_IsSmallResolutionEnabled && ( scene->m_IsFilmDirty != scene->m_IsLastFrameFilmDirty );
+    renderContext->m_IsSmallResolutionEnabled = r->m_IsSmallResolutionEnabled && scene->m_IsFilmDirty;
 
     scene->m_IsLastFrameFilmDirty = scene->m_IsFilmDirty;
 
@@ -344,8 +353,9 @@ void CDirectComputeRayTracing::RenderOneFrame()
     }
 
     std::wstring saveImageFilepath;
+    std::wstring saveFilmFilepath;
 
-    OnImGUI( &renderContext, &saveImageFilepath );
+    OnImGUI( &renderContext, &saveImageFilepath, &saveFilmFilepath );
     DrawImGui( commandList );
 
     // Issue a render result texture readback if requested
@@ -356,6 +366,12 @@ void CDirectComputeRayTracing::RenderOneFrame()
         saveImageReadback.ReadbackRenderResult( m_Scene );
     }
 
+    SImageReadback saveFilmReadback;
+    if ( !saveFilmFilepath.empty() )
+    {
+        saveFilmReadback.ReadbackFilm( m_Scene );
+    }
+
     commandList->OMSetRenderTargets( 0, nullptr, true, nullptr );
 
     // Transition the current backbuffer
@@ -374,12 +390,19 @@ void CDirectComputeRayTracing::RenderOneFrame()
     ID3D12CommandList* commandLists[] = { commandList };
     D3D12Adapter::GetCommandQueue()->ExecuteCommandLists( 1, commandLists );
 
-    // Flush the image readback and write to file
-    if ( saveImageReadback.m_Buffer )
+    // Flush the image readbacks and write to files
+    if ( saveImageReadback.m_Buffer || saveFilmReadback.m_Buffer )
     {
         D3D12Adapter::WaitForGPU();
+    }
+    if ( saveImageReadback.m_Buffer )
+    {
         saveImageReadback.SaveToFile( saveImageFilepath.c_str() );
     }
+    if ( saveFilmReadback.m_Buffer )
+    {
+        saveFilmReadback.SaveToFile( saveFilmFilepath.c_str() );
+    }
 
     D3D12Adapter::Present( 0 );
     D3D12Adapter::MoveToNextFrame();
@@ -392,6 +415,73 @@ void CDirectComputeRayTracing::RenderOneFrame()
     m_Scene->m_IsInstanceFlagsBufferRead = true;
 }
 
+void CDirectComputeRayTracing::RenderOneFrameWithoutWindow()
+{
+    SRenderContext renderContext;
+
+    D3D12Adapter::BeginCurrentFrame();
+
+    if ( m_Scene->m_HasValidScene )
+    {
+        m_Scene->RebuildMeshFlagsIfDirty();
+
+        m_Scene->AllocateAndUpdateTextureDescriptorTable();
+
+        DispatchRayTracing( this, m_Scene, &renderContext );
+
+        if ( m_Scene->m_PathTracer[ m_ActivePathTracerIndex ]->IsImageComplete() || renderContext.m_IsSmallResolutionEnabled )
+        {
+            ExecuteSampleConvolution( renderContext );
+        }
+    }
+
+    ID3D12GraphicsCommandList* commandList = D3D12Adapter::GetCommandList();
+    HRESULT hr = commandList->Close();
+    if ( FAILED( hr ) )
+    {
+        LOG_STRING_FORMAT( "CommandList close failure: %x\n", hr );
+    }
+
+    ID3D12CommandList* commandLists[] = { commandList };
+    D3D12Adapter::GetCommandQueue()->ExecuteCommandLists( 1, commandLists );
+
+    D3D12Adapter::MoveToNextFrame();
+
+    CD3D12Resource::FlushDelete();
+
+    // State decay to common state
+    m_Scene->m_IsLightBufferRead = true;
+    m_Scene->m_IsMaterialBufferRead = true;
+    m_Scene->m_IsInstanceFlagsBufferRead = true;
+}
+
+bool CDirectComputeRayTracing::SaveFilmToFile( const wchar_t* filepath )
+{
+    D3D12Adapter::BeginCurrentFrame();
+
+    SImageReadback readback;
+    const bool isReadbackIssued = readback.ReadbackFilm( m_Scene );
+
+    ID3D12GraphicsCommandList* commandList = D3D12Adapter::GetCommandList();
+    HRESULT hr = commandList->Close();
+    if ( FAILED( hr ) )
+    {
+        LOG_STRING_FORMAT( "CommandList close failure: %x\n", hr );
+    }
+
+    ID3D12CommandList* commandLists[] = { commandList };
+    D3D12Adapter::GetCommandQueue()->ExecuteCommandLists( 1, commandLists );
+    D3D12Adapter::WaitForGPU();
+
+    const bool result = isReadbackIssued && readback.SaveToFile( filepath );
+
+    D3D12Adapter::MoveToNextFrame();
+
+    CD3D12Resource::FlushDelete();
+
+    return result;
+}
+
 bool CDirectComputeRayTracing::HandleFilmResolutionChange()
 {
     if ( !m_Scene->ResizeSceneLuminanceInputResolution( m_Scene->m_ResolutionWidth, m_Scene->m_ResolutionHeight ) )
@@ -399,7 +489,10 @@ bool CDirectComputeRayTracing::HandleFilmResolutionChange()
         return false;
     }
 
-    UpdateRenderViewport( this );
+    if ( m_hWnd )
+    {
+        UpdateRenderViewport( this );
+    }
 
     // Aspect ratio might change due to rounding error, but this is neglectable
     m_SmallResolutionWidth = std::max( 1u, (uint32_t)std::roundf( m_Scene->m_ResolutionWidth * 0.25f ) );
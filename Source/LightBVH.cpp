@@ -0,0 +1,542 @@
+#include "stdafx.h"
+#include "LightBVH.h"
+#include "../Shaders/LightSharedDef.inc.hlsl"
+#include "Logging.h"
+#include "Timers.h"
+
+using namespace DirectX;
+
+static float SafeSqrt( float value )
+{
+    return sqrtf( std::max( 0.f, value ) );
+}
+
+static float SafeAcos( float value )
+{
+    return acosf( std::clamp( value, -1.f, 1.f ) );
+}
+
+// Union of two cones of directions, based on DirectionCone::Union of PBRT-v4
+static void UnionCones( const XMFLOAT3& axisA, float cosThetaA, const XMFLOAT3& axisB, float cosThetaB, XMFLOAT3* outAxis, float* outCosTheta )
+{
+    const float thetaA = SafeAcos( cosThetaA );
+    const float thetaB = SafeAcos( cosThetaB );
+    const XMVECTOR vAxisA = XMLoadFloat3( &axisA );
+    const XMVECTOR vAxisB = XMLoadFloat3( &axisB );
+    const float thetaD = SafeAcos( XMVectorGetX( XMVector3Dot( vAxisA, vAxisB ) ) );
+    if ( std::min( thetaD + thetaB, (float)M_PI ) <= thetaA )
+    {
+        *outAxis = axisA;
+        *outCosTheta = cosThetaA;
+        return;
+    }
+    if ( std::min( thetaD + thetaA, (float)M_PI ) <= thetaB )
+    {
+        *outAxis = axisB;
+        *outCosTheta = cosThetaB;
+        return;
+    }
+
+    const float thetaO = ( thetaA + thetaD + thetaB ) * .5f;
+    const XMVECTOR rotationAxis = XMVector3Cross( vAxisA, vAxisB );
+    if ( thetaO >= (float)M_PI || XMVectorGetX( XMVector3LengthSq( rotationAxis ) ) == 0.f )
+    {
+        *outAxis = axisA;
+        *outCosTheta = -1.f;
+        return;
+    }
+
+    // Rotate axis A towards axis B so the new cone just covers both
+    const XMVECTOR rotation = XMQuaternionRotationNormal( XMVector3Normalize( rotationAxis ), thetaO - thetaA );
+    XMStoreFloat3( outAxis, XMVector3Normalize( XMVector3Rotate( vAxisA, rotation ) ) );
+    *outCosTheta = cosf( thetaO );
+}
+
+static SLightBounds UnionLightBounds( const SLightBounds& a, const SLightBounds& b )
+{
+    // Lights without power do not widen the cone
+    if ( a.m_Power == 0.f )
+    {
+        return b;
+    }
+    if ( b.m_Power == 0.f )
+    {
+        return a;
+    }
+
+    SLightBounds result;
+    XMStoreFloat3( &result.m_BoundsMin, XMVectorMin( XMLoadFloat3( &a.m_BoundsMin ), XMLoadFloat3( &b.m_BoundsMin ) ) );
+    XMStoreFloat3( &result.m_BoundsMax, XMVectorMax( XMLoadFloat3( &a.m_BoundsMax ), XMLoadFloat3( &b.m_BoundsMax ) ) );
+    UnionCones( a.m_Axis, a.m_CosThetaO, b.m_Axis, b.m_CosThetaO, &result.m_Axis, &result.m_CosThetaO );
+    result.m_CosThetaE = std::min( a.m_CosThetaE, b.m_CosThetaE );
+    result.m_Power = a.m_Power + b.m_Power;
+    return result;
+}
+
+static float GetAxis( const XMFLOAT3& v, uint32_t axis )
+{
+    return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+// Surface area orientation heuristic, nodeExtent is the extent of the node being split
+static float EvaluateSplitCost( const SLightBounds& bounds, const XMFLOAT3& nodeExtent, uint32_t axis )
+{
+    if ( bounds.m_Power == 0.f )
+    {
+        return 0.f;
+    }
+
+    const float thetaO = SafeAcos( bounds.m_CosThetaO );
+    const float thetaE = SafeAcos( bounds.m_CosThetaE );
+    const float thetaW = std::min( thetaO + thetaE, (float)M_PI );
+    const float sinThetaO = SafeSqrt( 1.f - bounds.m_CosThetaO * bounds.m_CosThetaO );
+    const float solidAngleMeasure = 2.f * (float)M_PI * ( 1.f - bounds.m_CosThetaO )
+        + (float)M_PI * .5f * ( 2.f * thetaW * sinThetaO - cosf( thetaO - 2.f * thetaW ) - 2.f * thetaO * sinThetaO + bounds.m_CosThetaO );
+
+    const float maxExtent = std::max( { nodeExtent.x, nodeExtent.y, nodeExtent.z } );
+    const float regularity = maxExtent / GetAxis( nodeExtent, axis );
+
+    const XMFLOAT3 extent( bounds.m_BoundsMax.x - bounds.m_BoundsMin.x, bounds.m_BoundsMax.y - bounds.m_BoundsMin.y, bounds.m_BoundsMax.z - bounds.m_BoundsMin.z );
+    const float surfaceArea = 2.f * ( extent.x * extent.y + extent.y * extent.z + extent.z * extent.x );
+
+    return bounds.m_Power * solidAngleMeasure * regularity * surfaceArea;
+}
+
+struct SLightBVHPrimitive
+{
+    SLightBounds m_Bounds;
+    XMFLOAT3 m_Centroid;
+    uint32_t m_InputIndex;
+};
+
+static void FillNode( const SLightBounds& bounds, GPU::SLightBVHNode* node )
+{
+    node->boundsMin = bounds.m_BoundsMin;
+    node->boundsMax = bounds.m_BoundsMax;
+    node->power = bounds.m_Power;
+    node->axis = bounds.m_Axis;
+    node->cosThetaO = bounds.m_CosThetaO;
+    node->cosThetaE = bounds.m_CosThetaE;
+}
+
+static SLightBounds BuildRecursive( SLightBVHPrimitive* primitives, uint32_t count, const uint32_t* lightIndices, uint32_t bitTrail, uint32_t depth,
+    std::vector<GPU::SLightBVHNode>* nodes, std::vector<uint32_t>* bitTrails )
+{
+    const uint32_t nodeIndex = (uint32_t)nodes->size();
+    nodes->emplace_back();
+
+    if ( count == 1 )
+    {
+        GPU::SLightBVHNode* node = nodes->data() + nodeIndex;
+        FillNode( primitives[ 0 ].m_Bounds, node );
+        node->childOrLightIndex = lightIndices[ primitives[ 0 ].m_InputIndex ];
+        node->isLeaf = 1;
+        ( *bitTrails )[ primitives[ 0 ].m_InputIndex ] = bitTrail;
+        return primitives[ 0 ].m_Bounds;
+    }
+
+    XMVECTOR boundsMin = XMLoadFloat3( &primitives[ 0 ].m_Bounds.m_BoundsMin );
+    XMVECTOR boundsMax = XMLoadFloat3( &primitives[ 0 ].m_Bounds.m_BoundsMax );
+    XMVECTOR centroidMin = XMLoadFloat3( &primitives[ 0 ].m_Centroid );
+    XMVECTOR centroidMax = centroidMin;
+    for ( uint32_t i = 1; i < count; ++i )
+    {
+        boundsMin = XMVectorMin( boundsMin, XMLoadFloat3( &primitives[ i ].m_Bounds.m_BoundsMin ) );
+        boundsMax = XMVectorMax( boundsMax, XMLoadFloat3( &primitives[ i ].m_Bounds.m_BoundsMax ) );
+        centroidMin = XMVectorMin( centroidMin, XMLoadFloat3( &primitives[ i ].m_Centroid ) );
+        centroidMax = XMVectorMax( centroidMax, XMLoadFloat3( &primitives[ i ].m_Centroid ) );
+    }
+    XMFLOAT3 nodeExtent, centroidMinF, centroidExtent;
+    XMStoreFloat3( &nodeExtent, boundsMax - boundsMin );
+    XMStoreFloat3( &centroidMinF, centroidMin );
+    XMStoreFloat3( &centroidExtent, centroidMax - centroidMin );
+
+    // The remaining depth is bounded by median splits once the bit trail is about to run out of bits
+    const uint32_t medianSplitDepth = (uint32_t)ceilf( log2f( (float)count ) );
+    const bool forceMedianSplit = depth + medianSplitDepth >= LIGHT_BVH_MAX_DEPTH;
+
+    uint32_t splitAxis = 0;
+    uint32_t splitBucket = 0;
+    float minCost = FLT_MAX;
+    const uint32_t s_BucketCount = 12;
+    if ( !forceMedianSplit )
+    {
+        for ( uint32_t axis = 0; axis < 3; ++axis )
+        {
+            const float axisCentroidMin = GetAxis( centroidMinF, axis );
+            const float axisCentroidExtent = GetAxis( centroidExtent, axis );
+            if ( axisCentroidExtent == 0.f )
+            {
+                continue;
+            }
+
+            SLightBounds bucketBounds[ s_BucketCount ];
+            bool isBucketEmpty[ s_BucketCount ];
+            std::fill( isBucketEmpty, isBucketEmpty + s_BucketCount, true );
+            for ( uint32_t i = 0; i < count; ++i )
+            {
+                const uint32_t bucket = std::min( (uint32_t)( s_BucketCount * ( GetAxis( primitives[ i ].m_Centroid, axis ) - axisCentroidMin ) / axisCentroidExtent ), s_BucketCount - 1 );
+                bucketBounds[ bucket ] = isBucketEmpty[ bucket ] ? primitives[ i ].m_Bounds : UnionLightBounds( bucketBounds[ bucket ], primitives[ i ].m_Bounds );
+                isBucketEmpty[ bucket ] = false;
+            }
+
+            // Costs of splitting after each bucket from a sweep over the buckets in each direction, splits leaving one side empty are skipped
+            SLightBounds suffixBounds[ s_BucketCount ];
+            bool isSuffixEmpty[ s_BucketCount + 1 ];
+            isSuffixEmpty[ s_BucketCount ] = true;
+            for ( int32_t bucket = s_BucketCount - 1; bucket >= 0; --bucket )
+            {
+                const bool isNextEmpty = isSuffixEmpty[ bucket + 1 ];
+                suffixBounds[ bucket ] = isBucketEmpty[ bucket ] ? ( isNextEmpty ? SLightBounds() : suffixBounds[ bucket + 1 ] )
+                    : isNextEmpty ? bucketBounds[ bucket ] : UnionLightBounds( bucketBounds[ bucket ], suffixBounds[ bucket + 1 ] );
+                isSuffixEmpty[ bucket ] = isBucketEmpty[ bucket ] && isNextEmpty;
+            }
+
+            SLightBounds prefixBounds;
+            bool isPrefixEmpty = true;
+            for ( uint32_t split = 0; split < s_BucketCount - 1; ++split )
+            {
+                if ( !isBucketEmpty[ split ] )
+                {
+                    prefixBounds = isPrefixEmpty ? bucketBounds[ split ] : UnionLightBounds( prefixBounds, bucketBounds[ split ] );
+                    isPrefixEmpty = false;
+                }
+                if ( isPrefixEmpty || isSuffixEmpty[ split + 1 ] )
+                {
+                    continue;
+                }
+                const float cost = EvaluateSplitCost( prefixBounds, nodeExtent, axis ) + EvaluateSplitCost( suffixBounds[ split + 1 ], nodeExtent, axis );
+                if ( cost > 0.f && cost < minCost )
+                {
+                    minCost = cost;
+                    splitAxis = axis;
+                    splitBucket = split;
+                }
+            }
+        }
+    }
+
+    uint32_t splitCount = 0;
+    if ( minCost != FLT_MAX )
+    {
+        const float axisCentroidMin = GetAxis( centroidMinF, splitAxis );
+        const float axisCentroidExtent = GetAxis( centroidExtent, splitAxis );
+        SLightBVHPrimitive* middle = std::partition( primitives, primitives + count, [ & ]( const SLightBVHPrimitive& primitive )
+            {
+                const uint32_t bucket = std::min( (uint32_t)( s_BucketCount * ( GetAxis( primitive.m_Centroid, splitAxis ) - axisCentroidMin ) / axisCentroidExtent ), s_BucketCount - 1 );
+                return bucket <= splitBucket;
+            } );
+        splitCount = (uint32_t)( middle - primitives );
+    }
+    if ( splitCount == 0 || splitCount == count )
+    {
+        // Median split along the axis with the largest centroid extent
+        const uint32_t axis = centroidExtent.x >= centroidExtent.y && centroidExtent.x >= centroidExtent.z ? 0 : centroidExtent.y >= centroidExtent.z ? 1 : 2;
+        splitCount = count / 2;
+        std::nth_element( primitives, primitives + splitCount, primitives + count, [ axis ]( const SLightBVHPrimitive& lhs, const SLightBVHPrimitive& rhs )
+            {
+                return GetAxis( lhs.m_Centroid, axis ) < GetAxis( rhs.m_Centroid, axis );
+            } );
+    }
+
+    const SLightBounds bounds0 = BuildRecursive( primitives, splitCount, lightIndices, bitTrail, depth + 1, nodes, bitTrails );
+    const uint32_t secondChildIndex = (uint32_t)nodes->size();
+    const SLightBounds bounds1 = BuildRecursive( primitives + splitCount, count - splitCount, lightIndices, bitTrail | ( 1u << depth ), depth + 1, nodes, bitTrails );
+    const SLightBounds bounds = UnionLightBounds( bounds0, bounds1 );
+
+    GPU::SLightBVHNode* node = nodes->data() + nodeIndex;
+    FillNode( bounds, node );
+    node->childOrLightIndex = secondChildIndex;
+    node->isLeaf = 0;
+    return bounds;
+}
+
+bool SLightBVH::Build( const SLightBounds* bounds, const uint32_t* lightIndices, uint32_t count )
+{
+    m_Nodes.clear();
+    m_BitTrails.clear();
+    if ( count == 0 )
+    {
+        return false;
+    }
+
+    std::vector<SLightBVHPrimitive> primitives( count );
+    for ( uint32_t i = 0; i < count; ++i )
+    {
+        primitives[ i ].m_Bounds = bounds[ i ];
+        XMStoreFloat3( &primitives[ i ].m_Centroid, ( XMLoadFloat3( &bounds[ i ].m_BoundsMin ) + XMLoadFloat3( &bounds[ i ].m_BoundsMax ) ) * .5f );
+        primitives[ i ].m_InputIndex = i;
+    }
+
+    m_Nodes.reserve( count * 2 - 1 );
+    m_BitTrails.resize( count );
+    BuildRecursive( primitives.data(), count, lightIndices, 0, 0, &m_Nodes, &m_BitTrails );
+    return true;
+}
+
+static float CosSubClamped( float sinThetaA, float cosThetaA, float sinThetaB, float cosThetaB )
+{
+    return cosThetaA > cosThetaB ? 1.f : cosThetaA * cosThetaB + sinThetaA * sinThetaB;
+}
+
+static float SinSubClamped( float sinThetaA, float cosThetaA, float sinThetaB, float cosThetaB )
+{
+    return cosThetaA > cosThetaB ? 0.f : sinThetaA * cosThetaB - cosThetaA * sinThetaB;
+}
+
+// Same as LightBVH_Importance in the shaders
+static float EvaluateImportance( const GPU::SLightBVHNode& node, const XMFLOAT3& p )
+{
+    const XMVECTOR boundsMin = XMLoadFloat3( &node.boundsMin );
+    const XMVECTOR boundsMax = XMLoadFloat3( &node.boundsMax );
+    const XMVECTOR center = ( boundsMin + boundsMax ) * .5f;
+    const XMVECTOR halfDiagonal = ( boundsMax - boundsMin ) * .5f;
+    const float squaredRadius = XMVectorGetX( XMVector3Dot( halfDiagonal, halfDiagonal ) );
+    const XMVECTOR centerToP = XMLoadFloat3( &p ) - center;
+    const float squaredDistance = XMVectorGetX( XMVector3Dot( centerToP, centerToP ) );
+
+    const float cosThetaW = squaredDistance > 0.f ? XMVectorGetX( XMVector3Dot( XMLoadFloat3( &node.axis ), centerToP ) ) / sqrtf( squaredDistance ) : 1.f;
+    const float sinThetaW = SafeSqrt( 1.f - cosThetaW * cosThetaW );
+
+    const float cosThetaB = squaredDistance > squaredRadius ? SafeSqrt( 1.f - squaredRadius / squaredDistance ) : -1.f;
+    const float sinThetaB = SafeSqrt( 1.f - cosThetaB * cosThetaB );
+
+    const float sinThetaO = SafeSqrt( 1.f - node.cosThetaO * node.cosThetaO );
+    const float cosThetaX = CosSubClamped( sinThetaW, cosThetaW, sinThetaO, node.cosThetaO );
+    const float sinThetaX = SinSubClamped( sinThetaW, cosThetaW, sinThetaO, node.cosThetaO );
+    const float cosThetaP = CosSubClamped( sinThetaX, cosThetaX, sinThetaB, cosThetaB );
+    if ( cosThetaP <= node.cosThetaE )
+    {
+        return 0.f;
+    }
+    return node.power * cosThetaP / std::max( squaredDistance, squaredRadius );
+}
+
+uint32_t SLightBVH::Sample( const XMFLOAT3& p, float sample, float* pmf ) const
+{
+    *pmf = 1.f;
+    uint32_t nodeIndex = 0;
+    for ( uint32_t depth = 0; depth <= LIGHT_BVH_MAX_DEPTH && !m_Nodes.empty(); ++depth )
+    {
+        const GPU::SLightBVHNode& node = m_Nodes[ nodeIndex ];
+        if ( node.isLeaf )
+        {
+            if ( nodeIndex > 0 || EvaluateImportance( node, p ) > 0.f )
+            {
+                return node.childOrLightIndex;
+            }
+            break;
+        }
+
+        const float importance0 = EvaluateImportance( m_Nodes[ nodeIndex + 1 ], p );
+        const float importance1 = EvaluateImportance( m_Nodes[ node.childOrLightIndex ], p );
+        if ( importance0 == 0.f && importance1 == 0.f )
+        {
+            break;
+        }
+
+        const float probability0 = importance0 / ( importance0 + importance1 );
+        if ( sample < probability0 )
+        {
+            nodeIndex = nodeIndex + 1;
+            sample = std::min( sample / probability0, 0.99999994f );
+            *pmf *= probability0;
+        }
+        else
+        {
+            nodeIndex = node.childOrLightIndex;
+            sample = std::min( ( sample - probability0 ) / ( 1.f - probability0 ), 0.99999994f );
+            *pmf *= 1.f - probability0;
+        }
+    }
+    *pmf = 0.f;
+    return LIGHT_INDEX_INVALID;
+}
+
+float SLightBVH::EvaluatePMF( const XMFLOAT3& p, uint32_t bitTrail ) const
+{
+    float pmf = 1.f;
+    uint32_t nodeIndex = 0;
+    for ( uint32_t depth = 0; depth <= LIGHT_BVH_MAX_DEPTH && !m_Nodes.empty(); ++depth )
+    {
+        const GPU::SLightBVHNode& node = m_Nodes[ nodeIndex ];
+        if ( node.isLeaf )
+        {
+            return nodeIndex > 0 || EvaluateImportance( node, p ) > 0.f ? pmf : 0.f;
+        }
+
+        const float importance0 = EvaluateImportance( m_Nodes[ nodeIndex + 1 ], p );
+        const float importance1 = EvaluateImportance( m_Nodes[ node.childOrLightIndex ], p );
+        if ( importance0 == 0.f && importance1 == 0.f )
+        {
+            return 0.f;
+        }
+
+        const bool isSecondChild = ( bitTrail & 0x1 ) != 0;
+        pmf *= ( isSecondChild ? importance1 : importance0 ) / ( importance0 + importance1 );
+        nodeIndex = isSecondChild ? node.childOrLightIndex : nodeIndex + 1;
+        bitTrail >>= 1;
+    }
+    return 0.f;
+}
+
+static bool ValidateLightBVH( const char* name, const std::vector<SLightBounds>& bounds, uint32_t shadingPointCount, std::mt19937& rng )
+{
+    auto nextSample = [ &rng ]() { return ( rng() >> 8 ) / float( 1 << 24 ); };
+
+    // Light indices are scrambled so leaves do not simply hold their input index
+    const uint32_t lightCount = (uint32_t)bounds.size();
+    std::vector<uint32_t> lightIndices( lightCount );
+    std::vector<uint32_t> inputIndices( lightCount );
+    for ( uint32_t i = 0; i < lightCount; ++i )
+    {
+        lightIndices[ i ] = ( i * 7919 ) % lightCount;
+        inputIndices[ lightIndices[ i ] ] = i;
+    }
+
+    SLightBVH BVH;
+    Timer timer;
+    timer.Start();
+    if ( !BVH.Build( bounds.data(), lightIndices.data(), lightCount ) )
+    {
+        LOG_STRING_FORMAT( "%s: failed to build the light BVH, FAILED\n", name );
+        return false;
+    }
+    const float elapsedMilliseconds = timer.GetElapsedSecondsFloat().count() * 1000.f;
+    LOG_STRING_FORMAT( "%s: %u lights, %u nodes built in %.2f ms\n", name, lightCount, (uint32_t)BVH.m_Nodes.size(), elapsedMilliseconds );
+
+    bool isValid = true;
+    uint32_t failedSumCount = 0;
+    uint32_t mismatchCount = 0;
+    uint32_t failedHistogramCount = 0;
+    const uint32_t sampleCount = 1 << 16;
+    std::vector<float> pmfs( lightCount );
+    std::vector<uint32_t> histogram( lightCount );
+    for ( uint32_t iPoint = 0; iPoint < shadingPointCount; ++iPoint )
+    {
+        const XMFLOAT3 p( nextSample() * 24.f - 12.f, nextSample() * 24.f - 12.f, nextSample() * 24.f - 12.f );
+
+        double pmfSum = 0.0;
+        for ( uint32_t i = 0; i < lightCount; ++i )
+        {
+            pmfs[ i ] = BVH.EvaluatePMF( p, BVH.m_BitTrails[ i ] );
+            pmfSum += pmfs[ i ];
+        }
+        // Sampling fails when it reaches a node whose children both have zero importance, the PMFs then sum to less than one
+        if ( pmfSum > 1.0 + 1e-4 )
+        {
+            ++failedSumCount;
+        }
+
+        std::fill( histogram.begin(), histogram.end(), 0 );
+        uint32_t failedSampleCount = 0;
+        for ( uint32_t iSample = 0; iSample < sampleCount; ++iSample )
+        {
+            float pmf;
+            const uint32_t lightIndex = BVH.Sample( p, nextSample(), &pmf );
+            if ( lightIndex == LIGHT_INDEX_INVALID )
+            {
+                ++failedSampleCount;
+                continue;
+            }
+            const uint32_t inputIndex = inputIndices[ lightIndex ];
+            if ( !( fabsf( pmf - pmfs[ inputIndex ] ) <= 1e-3f * pmf ) )
+            {
+                ++mismatchCount;
+            }
+            ++histogram[ inputIndex ];
+        }
+
+        // Chi-square test with failed samples in their own bin, lights expecting too few samples are pooled into one bin
+        double chiSquare = 0.0;
+        uint32_t binCount = 0;
+        double pooledExpected = 0.0;
+        double pooledObserved = 0.0;
+        for ( uint32_t i = 0; i <= lightCount; ++i )
+        {
+            const double expected = ( i < lightCount ? pmfs[ i ] : std::max( 1.0 - pmfSum, 0.0 ) ) * sampleCount;
+            const double observed = i < lightCount ? histogram[ i ] : failedSampleCount;
+            if ( expected < 5.0 )
+            {
+                pooledExpected += expected;
+                pooledObserved += observed;
+                continue;
+            }
+            chiSquare += ( observed - expected ) * ( observed - expected ) / expected;
+            ++binCount;
+        }
+        if ( pooledExpected >= 5.0 )
+        {
+            chiSquare += ( pooledObserved - pooledExpected ) * ( pooledObserved - pooledExpected ) / pooledExpected;
+            ++binCount;
+        }
+        // Many histograms with few bins are tested, so the threshold is the Wilson-Hilferty approximation of the 1 - 3e-7 quantile
+        // rather than a number of standard deviations above the mean
+        const double degreesOfFreedom = binCount > 1 ? binCount - 1.0 : 1.0;
+        const double cubeRoot = 1.0 - 2.0 / ( 9.0 * degreesOfFreedom ) + 5.0 * sqrt( 2.0 / ( 9.0 * degreesOfFreedom ) );
+        if ( chiSquare > degreesOfFreedom * cubeRoot * cubeRoot * cubeRoot )
+        {
+            ++failedHistogramCount;
+        }
+    }
+
+    const bool passed = failedSumCount == 0 && mismatchCount == 0 && failedHistogramCount == 0;
+    LOG_STRING_FORMAT( "%s: over %u shading points, %u PMF sums exceed one, %u sampled PMFs differ from the evaluated ones, %u histograms fail the chi-square test, %s\n",
+        name, shadingPointCount, failedSumCount, mismatchCount, failedHistogramCount, passed ? "passed" : "FAILED" );
+    isValid &= passed;
+    return isValid;
+}
+
+bool ValidateLightBVHSampling()
+{
+    std::mt19937 rng( 0xB1A5 );
+    auto nextSample = [ &rng ]() { return ( rng() >> 8 ) / float( 1 << 24 ); };
+
+    // Point lights and one sided emitters of various sizes, orientations and powers spanning four orders of magnitude, including black ones
+    auto generateLights = [ & ]( uint32_t count, std::vector<SLightBounds>* bounds )
+    {
+        bounds->resize( count );
+        for ( SLightBounds& light : *bounds )
+        {
+            const XMFLOAT3 center( nextSample() * 20.f - 10.f, nextSample() * 20.f - 10.f, nextSample() * 20.f - 10.f );
+            const bool isPointLight = nextSample() < .3f;
+            const float halfSize = isPointLight ? 0.f : nextSample() * nextSample() * 2.f;
+            light.m_BoundsMin = XMFLOAT3( center.x - halfSize, center.y - halfSize * nextSample(), center.z - halfSize );
+            light.m_BoundsMax = XMFLOAT3( center.x + halfSize, center.y + halfSize * nextSample(), center.z + halfSize );
+            const float z = nextSample() * 2.f - 1.f;
+            const float phi = nextSample() * 2.f * (float)M_PI;
+            light.m_Axis = XMFLOAT3( SafeSqrt( 1.f - z * z ) * cosf( phi ), SafeSqrt( 1.f - z * z ) * sinf( phi ), z );
+            light.m_CosThetaO = isPointLight ? -1.f : nextSample() < .5f ? 1.f : nextSample() * 2.f - 1.f;
+            light.m_CosThetaE = isPointLight ? 0.f : cosf( (float)M_PI * .5f );
+            light.m_Power = nextSample() < .05f ? 0.f : powf( 10.f, nextSample() * 4.f );
+        }
+    };
+
+    bool isValid = true;
+    std::vector<SLightBounds> bounds;
+
+    generateLights( 1, &bounds );
+    bounds[ 0 ].m_Power = 1.f;
+    isValid &= ValidateLightBVH( "Single light", bounds, 64, rng );
+
+    generateLights( 7, &bounds );
+    isValid &= ValidateLightBVH( "Few lights", bounds, 256, rng );
+
+    generateLights( 300, &bounds );
+    isValid &= ValidateLightBVH( "Many lights", bounds, 64, rng );
+
+    // Coincident lights can not be split spatially
+    generateLights( 64, &bounds );
+    for ( SLightBounds& light : bounds )
+    {
+        light.m_BoundsMin = light.m_BoundsMax = bounds[ 0 ].m_BoundsMin;
+    }
+    isValid &= ValidateLightBVH( "Coincident lights", bounds, 64, rng );
+
+    // As many lights as a scene can hold, mostly to check the build time
+    generateLights( 5000, &bounds );
+    isValid &= ValidateLightBVH( "Light count limit", bounds, 2, rng );
+
+    LOG_STRING_FORMAT( "Light BVH sampling validation %s.\n", isValid ? "passed" : "FAILED" );
+    return isValid;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "../Shaders/LightBVHSharedDef.inc.hlsl"
+
+// Spatial and directional bounds of a light at a finite distance
+struct SLightBounds
+{
+    DirectX::XMFLOAT3 m_BoundsMin;
+    DirectX::XMFLOAT3 m_BoundsMax;
+    DirectX::XMFLOAT3 m_Axis;
+    float m_CosThetaO = -1.f; // Half angle of the cone bounding the emitter normals
+    float m_CosThetaE = 0.f; // Angle around the normals within which light is emitted
+    float m_Power = 0.f;
+};
+
+// Binary BVH over lights for picking a light proportionally to an estimate of its contribution to a shading point.
+// Sample and EvaluatePMF mirror LightBVH_Sample and LightBVH_PMF in the shaders.
+struct SLightBVH
+{
+    // Leaf i holds lightIndices[ i ]. Builds with the surface area orientation heuristic of PBRT-v4.
+    bool Build( const SLightBounds* bounds, const uint32_t* lightIndices, uint32_t count );
+
+    // Returns LIGHT_INDEX_INVALID with a zero PMF when no light can illuminate p
+    uint32_t Sample( const DirectX::XMFLOAT3& p, float sample, float* pmf ) const;
+
+    float EvaluatePMF( const DirectX::XMFLOAT3& p, uint32_t bitTrail ) const;
+
+    std::vector<GPU::SLightBVHNode> m_Nodes;
+    std::vector<uint32_t> m_BitTrails; // Path from the root to the leaf of each input light, the lowest bit selects the child of the root
+};
+
+// Checks on random light sets that the PMFs sum to one, that sampling returns the PMF of the sampled light and that the histogram of
+// samples follows the PMFs. Logs the results and returns false on failure.
+bool ValidateLightBVHSampling();
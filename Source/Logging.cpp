@@ -1,20 +1,583 @@
 #include "stdafx.h"
 #include "Logging.h"
+#include "Timers.h"
+#include <condition_variable>
 
-void LogString( const char* str )
+// A record takes one slot per s_LogSlotTextSize characters, longer messages are truncated at s_MaxLogRecordSlotCount slots
+static const uint32_t s_LogSlotCount = 8192;
+static const uint32_t s_LogSlotTextSize = 104;
+static const uint32_t s_MaxLogRecordSlotCount = 40;
+static const uint32_t s_MaxLogRecordLength = s_LogSlotTextSize * s_MaxLogRecordSlotCount;
+
+// The sequence is the write position the slot is free for, or that position plus one once the record is published. The header is only
+// valid in the first slot of a record.
+struct alignas( 64 ) SLogSlot
+{
+    std::atomic<uint64_t> m_Sequence;
+    uint64_t m_Timestamp;
+    uint32_t m_ThreadId;
+    ELogSeverity m_Severity;
+    uint8_t m_SlotCount;
+    uint16_t m_Length;
+    char m_Text[ s_LogSlotTextSize ];
+};
+
+static_assert( sizeof( SLogSlot ) == 128, "Log slots are expected to span two cache lines." );
+
+static SLogSlot s_LogSlots[ s_LogSlotCount ];
+alignas( 64 ) static std::atomic<uint64_t> s_LogWritePosition = 0;
+alignas( 64 ) static std::atomic<uint64_t> s_LogReadPosition = 0;
+static std::atomic<uint64_t> s_DroppedLogRecordCount = 0;
+static std::atomic<bool> s_IsLoggingThreadRunning = false;
+static std::atomic<bool> s_IsLoggingThreadStopping = false;
+static std::thread s_LoggingThread;
+static std::mutex s_LoggingThreadMutex;
+static std::condition_variable s_LoggingThreadWakeUp;
+static std::condition_variable s_LogDrained;
+static Timer s_LogTimer = []()
+{
+    Timer timer;
+    timer.Start();
+    return timer;
+}();
+
+class CDebugOutputLogSink : public CLogSink
+{
+public:
+    virtual void Write( ELogSeverity severity, const char* line, uint32_t length ) override
+    {
+        OutputDebugStringA( line );
+    }
+};
+
+class CStandardOutputLogSink : public CLogSink
+{
+public:
+    virtual void Write( ELogSeverity severity, const char* line, uint32_t length ) override
+    {
+        fwrite( line, 1, length, stdout );
+    }
+
+    virtual void Flush() override
+    {
+        fflush( stdout );
+    }
+};
+
+class CFileLogSink : public CLogSink
+{
+public:
+    explicit CFileLogSink( FILE* file ) : m_File( file ) {}
+
+    virtual ~CFileLogSink()
+    {
+        fclose( m_File );
+    }
+
+    virtual void Write( ELogSeverity severity, const char* line, uint32_t length ) override
+    {
+        fwrite( line, 1, length, m_File );
+    }
+
+    virtual void Flush() override
+    {
+        fflush( m_File );
+    }
+
+private:
+    FILE* m_File;
+};
+
+static std::mutex s_LogSinksMutex;
+
+static std::vector<std::unique_ptr<CLogSink>>& GetLogSinks()
 {
-    OutputDebugStringA( str );
+    static std::vector<std::unique_ptr<CLogSink>> s_LogSinks = []()
+    {
+        std::vector<std::unique_ptr<CLogSink>> sinks;
+        sinks.emplace_back( std::make_unique<CDebugOutputLogSink>() );
+        return sinks;
+    }();
+    return s_LogSinks;
 }
 
-void LogStringFormat( const char* format, ... )
+static const char* GetLogSeverityName( ELogSeverity severity )
+{
+    switch ( severity )
+    {
+    case ELogSeverity::Verbose:
+        return "Verbose";
+    case ELogSeverity::Warning:
+        return "Warning";
+    case ELogSeverity::Error:
+        return "Error";
+    default:
+        return "Info";
+    }
+}
+
+// Must be called with the sink mutex held
+static void WriteToLogSinks( ELogSeverity severity, uint64_t timestamp, uint32_t threadId, const char* text, uint32_t length, bool flush )
+{
+    char line[ s_MaxLogRecordLength + 64 ];
+    int prefixLength = sprintf_s( line, ARRAY_LENGTH( line ), "[%10.3f][%5u][%s] ", timestamp / 1000000.0, threadId, GetLogSeverityName( severity ) );
+    if ( prefixLength < 0 )
+    {
+        prefixLength = 0;
+    }
+    memcpy( line + prefixLength, text, length );
+    line[ prefixLength + length ] = '\0';
+
+    for ( std::unique_ptr<CLogSink>& sink : GetLogSinks() )
+    {
+        sink->Write( severity, line, (uint32_t)prefixLength + length );
+        if ( flush )
+        {
+            sink->Flush();
+        }
+    }
+}
+
+static uint64_t GetLogTimestamp()
+{
+    return (uint64_t)s_LogTimer.GetElapsedMicroseconds().count();
+}
+
+static void DrainLogRecords();
+
+// Reserves consecutive slots for the record by advancing the write position, which only succeeds when none of them still holds a record
+// that has not been drained
+static bool EnqueueLogRecord( ELogSeverity severity, uint64_t timestamp, const char* text, uint32_t length )
+{
+    const uint32_t slotCount = std::max( 1U, ( length + s_LogSlotTextSize - 1 ) / s_LogSlotTextSize );
+
+    uint64_t position = s_LogWritePosition.load( std::memory_order_relaxed );
+    while ( true )
+    {
+        bool isFull = false;
+        bool isPositionStale = false;
+        for ( uint32_t iSlot = 0; iSlot < slotCount; ++iSlot )
+        {
+            const uint64_t sequence = s_LogSlots[ ( position + iSlot ) % s_LogSlotCount ].m_Sequence.load( std::memory_order_acquire );
+            const int64_t difference = (int64_t)( sequence - ( position + iSlot ) );
+            if ( difference < 0 )
+            {
+                isFull = true;
+                break;
+            }
+            else if ( difference > 0 )
+            {
+                isPositionStale = true;
+                break;
+            }
+        }
+
+        if ( isPositionStale )
+        {
+            position = s_LogWritePosition.load( std::memory_order_relaxed );
+        }
+        else if ( isFull )
+        {
+            if ( severity < ELogSeverity::Error )
+            {
+                s_DroppedLogRecordCount.fetch_add( 1, std::memory_order_relaxed );
+                return false;
+            }
+            if ( !s_IsLoggingThreadRunning.load( std::memory_order_acquire ) )
+            {
+                // The logging thread has stopped and will not free any slot
+                std::lock_guard<std::mutex> lock( s_LogSinksMutex );
+                WriteToLogSinks( severity, timestamp, GetCurrentThreadId(), text, length, true );
+                return false;
+            }
+            s_LoggingThreadWakeUp.notify_one();
+            std::this_thread::yield();
+            position = s_LogWritePosition.load( std::memory_order_relaxed );
+        }
+        else if ( s_LogWritePosition.compare_exchange_weak( position, position + slotCount, std::memory_order_relaxed ) )
+        {
+            break;
+        }
+    }
+
+    // The first slot is published last so the logging thread sees the whole record once it sees the first slot
+    for ( uint32_t iSlot = slotCount; iSlot-- > 0; )
+    {
+        SLogSlot& slot = s_LogSlots[ ( position + iSlot ) % s_LogSlotCount ];
+        const uint32_t textOffset = iSlot * s_LogSlotTextSize;
+        memcpy( slot.m_Text, text + textOffset, std::min( s_LogSlotTextSize, length - textOffset ) );
+        if ( iSlot == 0 )
+        {
+            slot.m_Timestamp = timestamp;
+            slot.m_ThreadId = GetCurrentThreadId();
+            slot.m_Severity = severity;
+            slot.m_SlotCount = (uint8_t)slotCount;
+            slot.m_Length = (uint16_t)length;
+        }
+        slot.m_Sequence.store( position + iSlot + 1, std::memory_order_release );
+    }
+
+    // The slots were reserved before the logging thread was told to stop but may be published after its last pass. Pairs with the fence
+    // in ~CLoggingThread, either this thread sees the flag cleared or the final drain there sees the record.
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    if ( !s_IsLoggingThreadRunning.load( std::memory_order_relaxed ) )
+    {
+        DrainLogRecords();
+    }
+    return true;
+}
+
+// Called on the logging thread, and on the producers and the owner of the thread once it is stopping. The sink mutex serializes the calls.
+static void DrainLogRecords()
+{
+    char text[ s_MaxLogRecordLength ];
+
+    std::lock_guard<std::mutex> lock( s_LogSinksMutex );
+
+    uint64_t position = s_LogReadPosition.load( std::memory_order_relaxed );
+    bool hasWritten = false;
+    while ( true )
+    {
+        SLogSlot& firstSlot = s_LogSlots[ position % s_LogSlotCount ];
+        if ( firstSlot.m_Sequence.load( std::memory_order_acquire ) != position + 1 )
+        {
+            break;
+        }
+
+        const uint32_t slotCount = firstSlot.m_SlotCount;
+        const uint32_t length = firstSlot.m_Length;
+        for ( uint32_t iSlot = 0; iSlot < slotCount; ++iSlot )
+        {
+            const uint32_t textOffset = iSlot * s_LogSlotTextSize;
+            memcpy( text + textOffset, s_LogSlots[ ( position + iSlot ) % s_LogSlotCount ].m_Text, std::min( s_LogSlotTextSize, length - textOffset ) );
+        }
+        WriteToLogSinks( firstSlot.m_Severity, firstSlot.m_Timestamp, firstSlot.m_ThreadId, text, length, false );
+        hasWritten = true;
+
+        for ( uint32_t iSlot = 0; iSlot < slotCount; ++iSlot )
+        {
+            s_LogSlots[ ( position + iSlot ) % s_LogSlotCount ].m_Sequence.store( position + iSlot + s_LogSlotCount, std::memory_order_release );
+        }
+        position += slotCount;
+        s_LogReadPosition.store( position, std::memory_order_release );
+    }
+
+    const uint64_t droppedRecordCount = s_DroppedLogRecordCount.exchange( 0, std::memory_order_relaxed );
+    if ( droppedRecordCount > 0 )
+    {
+        char message[ 128 ];
+        const int length = sprintf_s( message, ARRAY_LENGTH( message ), "%llu log messages were dropped because the log buffer was full.\n", droppedRecordCount );
+        WriteToLogSinks( ELogSeverity::Warning, GetLogTimestamp(), GetCurrentThreadId(), message, (uint32_t)std::max( length, 0 ), false );
+        hasWritten = true;
+    }
+
+    if ( hasWritten )
+    {
+        for ( std::unique_ptr<CLogSink>& sink : GetLogSinks() )
+        {
+            sink->Flush();
+        }
+    }
+}
+
+static void LoggingThreadMain()
+{
+    while ( true )
+    {
+        const bool isStopping = s_IsLoggingThreadStopping.load( std::memory_order_acquire );
+
+        DrainLogRecords();
+
+        std::unique_lock<std::mutex> lock( s_LoggingThreadMutex );
+        s_LogDrained.notify_all();
+        if ( isStopping )
+        {
+            break;
+        }
+        // Producers only wake the thread up when they have to wait, otherwise the log is written with a few milliseconds of latency
+        s_LoggingThreadWakeUp.wait_for( lock, std::chrono::milliseconds( 5 ) );
+    }
+}
+
+static void LogText( ELogSeverity severity, const char* text, uint32_t length )
+{
+    const uint64_t timestamp = GetLogTimestamp();
+    length = std::min( length, s_MaxLogRecordLength );
+
+    if ( s_IsLoggingThreadRunning.load( std::memory_order_acquire ) )
+    {
+        if ( EnqueueLogRecord( severity, timestamp, text, length ) && severity == ELogSeverity::Error )
+        {
+            FlushLog();
+        }
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock( s_LogSinksMutex );
+        WriteToLogSinks( severity, timestamp, GetCurrentThreadId(), text, length, true );
+    }
+}
+
+static void LogTextFormat( ELogSeverity severity, const char* format, va_list argptr )
 {
     const uint32_t s_MaxBufferLength = 512;
     char buffer[ s_MaxBufferLength ];
 
+    va_list argptrCopy;
+    va_copy( argptrCopy, argptr );
+    const int length = vsnprintf( buffer, s_MaxBufferLength, format, argptrCopy );
+    va_end( argptrCopy );
+    if ( length < 0 )
+    {
+        return;
+    }
+
+    if ( (uint32_t)length < s_MaxBufferLength )
+    {
+        LogText( severity, buffer, (uint32_t)length );
+    }
+    else
+    {
+        // Long messages are formatted again into a buffer of their size instead of being truncated
+        std::vector<char> longBuffer( (size_t)length + 1 );
+        vsnprintf( longBuffer.data(), longBuffer.size(), format, argptr );
+        LogText( severity, longBuffer.data(), (uint32_t)length );
+    }
+}
+
+void LogString( const char* str )
+{
+    LogText( ELogSeverity::Info, str, (uint32_t)strlen( str ) );
+}
+
+void LogStringFormat( const char* format, ... )
+{
     va_list argptr;
     va_start( argptr, format );
-    vsprintf_s( buffer, s_MaxBufferLength, format, argptr );
+    LogTextFormat( ELogSeverity::Info, format, argptr );
     va_end( argptr );
+}
+
+void LogMessage( ELogSeverity severity, const char* str )
+{
+    LogText( severity, str, (uint32_t)strlen( str ) );
+}
+
+void LogMessageFormat( ELogSeverity severity, const char* format, ... )
+{
+    va_list argptr;
+    va_start( argptr, format );
+    LogTextFormat( severity, format, argptr );
+    va_end( argptr );
+}
+
+void AddLogSink( std::unique_ptr<CLogSink> sink )
+{
+    std::lock_guard<std::mutex> lock( s_LogSinksMutex );
+    GetLogSinks().emplace_back( std::move( sink ) );
+}
+
+void EnableLogToStandardOutput()
+{
+    static bool s_IsLogToStandardOutputEnabled = false;
+    if ( s_IsLogToStandardOutputEnabled )
+    {
+        return;
+    }
+
+    // A redirected standard output is inherited and already bound to stdout
+    const HANDLE outputHandle = GetStdHandle( STD_OUTPUT_HANDLE );
+    if ( outputHandle == NULL || outputHandle == INVALID_HANDLE_VALUE || GetFileType( outputHandle ) == FILE_TYPE_UNKNOWN )
+    {
+        if ( !AttachConsole( ATTACH_PARENT_PROCESS ) )
+        {
+            return;
+        }
+
+        FILE* file = nullptr;
+        if ( freopen_s( &file, "CONOUT$", "w", stdout ) != 0 )
+        {
+            return;
+        }
+    }
+
+    AddLogSink( std::make_unique<CStandardOutputLogSink>() );
+    s_IsLogToStandardOutputEnabled = true;
+}
+
+bool EnableLogToFile( const std::filesystem::path& filepath )
+{
+    FILE* file = _wfsopen( filepath.c_str(), L"w", _SH_DENYWR );
+    if ( !file )
+    {
+        LOG_STRING_FORMAT( "Failed to open log file %s.\n", filepath.u8string().c_str() );
+        return false;
+    }
+
+    AddLogSink( std::make_unique<CFileLogSink>( file ) );
+    return true;
+}
+
+void FlushLog()
+{
+    if ( !s_IsLoggingThreadRunning.load( std::memory_order_acquire ) )
+    {
+        return;
+    }
 
-    LogString( buffer );
+    const uint64_t position = s_LogWritePosition.load( std::memory_order_relaxed );
+    std::unique_lock<std::mutex> lock( s_LoggingThreadMutex );
+    s_LoggingThreadWakeUp.notify_one();
+    s_LogDrained.wait( lock, [ position ]() { return s_LogReadPosition.load( std::memory_order_acquire ) >= position; } );
 }
+
+CLoggingThread::CLoggingThread()
+{
+    for ( uint32_t iSlot = 0; iSlot < s_LogSlotCount; ++iSlot )
+    {
+        s_LogSlots[ iSlot ].m_Sequence.store( iSlot, std::memory_order_relaxed );
+    }
+    s_LogWritePosition.store( 0, std::memory_order_relaxed );
+    s_LogReadPosition.store( 0, std::memory_order_relaxed );
+
+    s_IsLoggingThreadStopping.store( false, std::memory_order_relaxed );
+    s_LoggingThread = std::thread( LoggingThreadMain );
+    s_IsLoggingThreadRunning.store( true, std::memory_order_release );
+}
+
+CLoggingThread::~CLoggingThread()
+{
+    // Messages queued before the flag is cleared are drained by the last pass, later ones are written synchronously
+    s_IsLoggingThreadRunning.store( false, std::memory_order_release );
+    {
+        std::lock_guard<std::mutex> lock( s_LoggingThreadMutex );
+        s_IsLoggingThreadStopping.store( true, std::memory_order_release );
+        s_LoggingThreadWakeUp.notify_one();
+    }
+    s_LoggingThread.join();
+
+    // Records published between the last pass of the thread and the join
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    DrainLogRecords();
+}
+
+class CCountingLogSink : public CLogSink
+{
+public:
+    virtual void Write( ELogSeverity severity, const char* line, uint32_t length ) override
+    {
+        if ( severity == ELogSeverity::Verbose )
+        {
+            ++m_LineCount;
+        }
+    }
+
+    uint64_t m_LineCount = 0;
+};
+
+// Returns the average cost of a call in nanoseconds as seen by the calling threads
+static double MeasureLoggingCalls( uint32_t threadCount, uint32_t callCountPerThread, bool isSynchronous )
+{
+    std::vector<std::thread> threads;
+    std::vector<double> threadSeconds( threadCount, 0.0 );
+    std::atomic<uint32_t> readyThreadCount = 0;
+    std::atomic<bool> start = false;
+    for ( uint32_t iThread = 0; iThread < threadCount; ++iThread )
+    {
+        threads.emplace_back( [ &, iThread ]()
+            {
+                readyThreadCount.fetch_add( 1 );
+                while ( !start.load() )
+                {
+                    std::this_thread::yield();
+                }
+
+                Timer timer;
+                timer.Start();
+                for ( uint32_t iCall = 0; iCall < callCountPerThread; ++iCall )
+                {
+                    if ( isSynchronous )
+                    {
+                        // What a logging call used to do, formatting and writing to the debug output on the calling thread
+                        char buffer[ 512 ];
+                        sprintf_s( buffer, ARRAY_LENGTH( buffer ), "Benchmark message %u from worker %u, value %.3f.\n", iCall, iThread, iCall * .5f );
+                        OutputDebugStringA( buffer );
+                    }
+                    else
+                    {
+                        LogMessageFormat( ELogSeverity::Verbose, "Benchmark message %u from worker %u, value %.3f.\n", iCall, iThread, iCall * .5f );
+                    }
+                }
+                threadSeconds[ iThread ] = timer.GetElapsedSecondsFloat().count();
+            } );
+    }
+
+    while ( readyThreadCount.load() < threadCount )
+    {
+        std::this_thread::yield();
+    }
+    start.store( true );
+    for ( std::thread& thread : threads )
+    {
+        thread.join();
+    }
+
+    double totalSeconds = 0.0;
+    for ( double seconds : threadSeconds )
+    {
+        totalSeconds += seconds;
+    }
+    return totalSeconds * 1e9 / ( (double)threadCount * callCountPerThread );
+}
+
+void RunLoggingBenchmark()
+{
+    const bool isLoggingThreadRunning = s_IsLoggingThreadRunning.load();
+    std::unique_ptr<CLoggingThread> loggingThread;
+    if ( !isLoggingThreadRunning )
+    {
+        loggingThread = std::make_unique<CLoggingThread>();
+    }
+
+    EnableLogToStandardOutput();
+
+    const uint32_t callCountPerThread = 20000;
+    const uint32_t maxThreadCount = std::max( 1U, std::thread::hardware_concurrency() );
+    LOG_STRING_FORMAT( "Logging benchmark, %u calls per thread, ring buffer of %u slots of %u characters.\n", callCountPerThread, s_LogSlotCount, s_LogSlotTextSize );
+
+    for ( uint32_t threadCount = 1; ; threadCount = std::min( threadCount * 2, maxThreadCount ) )
+    {
+        FlushLog();
+
+        const double synchronousNanoseconds = MeasureLoggingCalls( threadCount, callCountPerThread, true );
+
+        // The sinks are swapped for one that only counts the lines so the benchmark does not flood them, the drain cost is still paid
+        std::vector<std::unique_ptr<CLogSink>> sinks;
+        {
+            std::lock_guard<std::mutex> lock( s_LogSinksMutex );
+            sinks.swap( GetLogSinks() );
+            GetLogSinks().emplace_back( std::make_unique<CCountingLogSink>() );
+        }
+
+        const double asynchronousNanoseconds = MeasureLoggingCalls( threadCount, callCountPerThread, false );
+        FlushLog();
+
+        uint64_t lineCount = 0;
+        {
+            std::lock_guard<std::mutex> lock( s_LogSinksMutex );
+            lineCount = static_cast<CCountingLogSink*>( GetLogSinks()[ 0 ].get() )->m_LineCount;
+            sinks.swap( GetLogSinks() );
+        }
+
+        const uint64_t callCount = (uint64_t)threadCount * callCountPerThread;
+        LOG_STRING_FORMAT( "%2u threads: synchronous %8.1f ns per call, queued %8.1f ns per call, %llu of %llu messages written, %llu dropped.\n",
+            threadCount, synchronousNanoseconds, asynchronousNanoseconds, lineCount, callCount, callCount - lineCount );
+
+        if ( threadCount == maxThreadCount )
+        {
+            break;
+        }
+    }
+
+    FlushLog();
+}
\ No newline at end of file
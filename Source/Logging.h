@@ -1,9 +1,67 @@
 #pragma once
 
+enum class ELogSeverity : uint8_t
+{
+    Verbose,
+    Info,
+    Warning,
+    Error
+};
+
+// Receives the lines of the log on the logging thread, or on the calling thread when the logging thread is not running. Lines start with
+// the time since the process started, the calling thread id and the severity.
+class CLogSink
+{
+public:
+    virtual ~CLogSink() {}
+
+    virtual void Write( ELogSeverity severity, const char* line, uint32_t length ) = 0;
+
+    virtual void Flush() {}
+};
+
 void LogString( const char* str );
 
 void LogStringFormat( const char* format, ... );
 
+void LogMessage( ELogSeverity severity, const char* str );
+
+void LogMessageFormat( ELogSeverity severity, const char* format, ... );
+
+// The log starts with a sink writing to the debug output
+void AddLogSink( std::unique_ptr<CLogSink> sink );
+
+// Also writes the log to the standard output, or to the console of the parent process when the standard output is not redirected. The
+// application has no console of its own, this is for runs without a window.
+void EnableLogToStandardOutput();
+
+bool EnableLogToFile( const std::filesystem::path& filepath );
+
+// Blocks until every message logged before the call has been written to the sinks
+void FlushLog();
+
+// Messages are queued in a fixed size ring buffer by the calling threads without locking and written to the sinks by a logging thread that
+// runs for the lifetime of this object. When the ring is full, messages below the error severity are dropped and counted, errors wait for
+// room and are flushed before the call returns. Outside of its lifetime messages are written synchronously.
+class CLoggingThread
+{
+public:
+    CLoggingThread();
+
+    ~CLoggingThread();
+};
+
+// Measures the cost of a logging call made from several threads at once, with the logging thread running
+void RunLoggingBenchmark();
+
 #define LOG_STRING( str )                   LogString( str )
 
-#define LOG_STRING_FORMAT( format, ... )    LogStringFormat( format, __VA_ARGS__ )
\ No newline at end of file
+#define LOG_STRING_FORMAT( format, ... )    LogStringFormat( format, __VA_ARGS__ )
+
+#define LOG_WARNING( str )                  LogMessage( ELogSeverity::Warning, str )
+
+#define LOG_WARNING_FORMAT( format, ... )   LogMessageFormat( ELogSeverity::Warning, format, __VA_ARGS__ )
+
+#define LOG_ERROR( str )                    LogMessage( ELogSeverity::Error, str )
+
+#define LOG_ERROR_FORMAT( format, ... )     LogMessageFormat( ELogSeverity::Error, format, __VA_ARGS__ )
\ No newline at end of file
@@ -0,0 +1,54 @@
+#include "stdafx.h"
+#include "MappedFile.h"
+
+CMappedFile::~CMappedFile()
+{
+    Close();
+}
+
+bool CMappedFile::Open( const std::filesystem::path& filenamePath )
+{
+    Close();
+
+    m_FileHandle = CreateFileW( filenamePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+    if ( m_FileHandle == INVALID_HANDLE_VALUE )
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if ( !GetFileSizeEx( m_FileHandle, &fileSize ) || fileSize.QuadPart == 0 )
+    {
+        return false;
+    }
+    m_Size = (size_t)fileSize.QuadPart;
+
+    m_MappingHandle = CreateFileMappingW( m_FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    if ( !m_MappingHandle )
+    {
+        return false;
+    }
+
+    m_Data = (const uint8_t*)MapViewOfFile( m_MappingHandle, FILE_MAP_READ, 0, 0, 0 );
+    return m_Data != nullptr;
+}
+
+void CMappedFile::Close()
+{
+    if ( m_Data )
+    {
+        UnmapViewOfFile( m_Data );
+        m_Data = nullptr;
+    }
+    if ( m_MappingHandle )
+    {
+        CloseHandle( m_MappingHandle );
+        m_MappingHandle = NULL;
+    }
+    if ( m_FileHandle != INVALID_HANDLE_VALUE )
+    {
+        CloseHandle( m_FileHandle );
+        m_FileHandle = INVALID_HANDLE_VALUE;
+    }
+    m_Size = 0;
+}
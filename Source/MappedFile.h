@@ -0,0 +1,22 @@
+#pragma once
+
+// Maps a file read-only into the address space so it can be parsed in place without copying.
+class CMappedFile
+{
+public:
+    ~CMappedFile();
+
+    bool Open( const std::filesystem::path& filenamePath );
+
+    void Close();
+
+    const uint8_t* GetData() const { return m_Data; }
+
+    size_t GetSize() const { return m_Size; }
+
+private:
+    HANDLE m_FileHandle = INVALID_HANDLE_VALUE;
+    HANDLE m_MappingHandle = NULL;
+    const uint8_t* m_Data = nullptr;
+    size_t m_Size = 0;
+};
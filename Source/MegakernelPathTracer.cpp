@@ -40,9 +40,10 @@ struct alignas( 256 ) SRayTracingConstants
     uint32_t            tileOffsetY;
     uint32_t            environmentLightIndex;
     uint32_t            frameSeed;
+    uint32_t            russianRouletteBounceCount;
 };
 
-static SD3D12DescriptorTableLayout s_DescriptorTableLayout = SD3D12DescriptorTableLayout( 18, 2 );
+static SD3D12DescriptorTableLayout s_DescriptorTableLayout = SD3D12DescriptorTableLayout( 22, 2 );
 
 bool CMegakernelPathTracer::Create()
 {
@@ -144,6 +145,7 @@ void CMegakernelPathTracer::Render( CScene* scene, const SRenderContext& renderC
             constants->filmSize = scene->m_FilmSize;
             constants->lightCount = scene->GetLightCount();
             constants->maxBounceCount = scene->m_MaxBounceCount;
+            constants->russianRouletteBounceCount = scene->m_RussianRouletteBounceCount;
             constants->apertureRadius = scene->CalculateApertureDiameter() * 0.5f;
             constants->focalDistance = scene->m_FocalDistance;
             constants->apertureBaseAngle = scene->m_ApertureRotation;
@@ -184,6 +186,13 @@ void CMegakernelPathTracer::Render( CScene* scene, const SRenderContext& renderC
         {
             barriers.emplace_back( CD3DX12_RESOURCE_BARRIER::Transition( scene->m_LightsBuffer->GetBuffer(),
                 D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE ) );
+            barriers.emplace_back( CD3DX12_RESOURCE_BARRIER::Transition( scene->m_LightAliasTableBuffer->GetBuffer(),
+                D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE ) );
+            if ( !scene->m_LightBVH.m_Nodes.empty() )
+            {
+                barriers.emplace_back( CD3DX12_RESOURCE_BARRIER::Transition( scene->m_LightBVHNodesBuffer->GetBuffer(),
+                    D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE ) );
+            }
             scene->m_IsLightBufferRead = true;
         }
         if ( !scene->m_IsMaterialBufferRead )
@@ -212,11 +221,16 @@ void CMegakernelPathTracer::Render( CScene* scene, const SRenderContext& renderC
     }
 
     SD3D12DescriptorHandle environmentTextureSRV = D3D12Adapter::GetNullBufferSRV();
+    SD3D12DescriptorHandle environmentDistributionSRV = D3D12Adapter::GetNullBufferSRV();
     if ( scene->m_EnvironmentLight && scene->m_EnvironmentLight->m_Texture )
     {
         environmentTextureSRV = scene->m_EnvironmentLight->m_Texture->GetSRV();
+        if ( scene->m_EnvironmentLight->m_Distribution )
+        {
+            environmentDistributionSRV = scene->m_EnvironmentLight->m_Distribution->GetSRV();
+        }
     }
-    SD3D12DescriptorHandle srcDescriptors[ 20 ] =
+    SD3D12DescriptorHandle srcDescriptors[ 24 ] =
     {
           scene->m_VerticesBuffer->GetSRV()
         , scene->m_TrianglesBuffer->GetSRV()
@@ -236,6 +250,10 @@ void CMegakernelPathTracer::Render( CScene* scene, const SRenderContext& renderC
         , scene->m_MaterialsBuffer->GetSRV()
         , scene->m_InstanceLightIndicesBuffer->GetSRV()
         , environmentTextureSRV
+        , environmentDistributionSRV
+        , scene->m_LightAliasTableBuffer->GetSRV()
+        , scene->m_TriangleAliasTableBuffer ? scene->m_TriangleAliasTableBuffer->GetSRV() : D3D12Adapter::GetNullBufferSRV()
+        , scene->m_LightBVHNodesBuffer->GetSRV()
         , scene->m_SamplePositionTexture->GetUAV()
         , scene->m_SampleValueTexture->GetUAV()
     };
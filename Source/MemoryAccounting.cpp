@@ -0,0 +1,187 @@
+#include "stdafx.h"
+#include "MemoryAccounting.h"
+#include "Logging.h"
+#include "imgui/imgui.h"
+
+static const char* s_MemoryCategoryNames[] =
+{
+      "Mesh vertices"
+    , "Mesh indices"
+    , "Material ids"
+    , "BLAS nodes"
+    , "TLAS"
+    , "Instances"
+    , "Materials"
+    , "Textures"
+    , "Lights"
+    , "Load time copies"
+    , "Upload staging"
+};
+
+static_assert( ARRAY_LENGTH( s_MemoryCategoryNames ) == (size_t)EMemoryCategory::Count, "Every memory category needs a name." );
+
+static const char* s_MemoryLocationNames[] = { "CPU", "GPU" };
+
+static const float s_BytesToMB = 1.f / ( 1024.f * 1024.f );
+
+CMemoryAccounting::CMemoryAccounting()
+{
+    Reset();
+}
+
+void CMemoryAccounting::Reset()
+{
+    memset( m_Bytes, 0, sizeof( m_Bytes ) );
+    memset( m_PeakBytes, 0, sizeof( m_PeakBytes ) );
+    memset( m_TotalBytes, 0, sizeof( m_TotalBytes ) );
+    memset( m_PeakTotalBytes, 0, sizeof( m_PeakTotalBytes ) );
+    m_OversizedBuffers.clear();
+}
+
+void CMemoryAccounting::ResetPeaks()
+{
+    memcpy( m_PeakBytes, m_Bytes, sizeof( m_Bytes ) );
+    memcpy( m_PeakTotalBytes, m_TotalBytes, sizeof( m_TotalBytes ) );
+    m_OversizedBuffers.clear();
+}
+
+void CMemoryAccounting::Set( EMemoryCategory category, EMemoryLocation location, uint64_t bytes )
+{
+    uint64_t& currentBytes = m_Bytes[ (uint32_t)category ][ (uint32_t)location ];
+    uint64_t& totalBytes = m_TotalBytes[ (uint32_t)location ];
+    totalBytes = totalBytes - currentBytes + bytes;
+    currentBytes = bytes;
+
+    uint64_t& peakBytes = m_PeakBytes[ (uint32_t)category ][ (uint32_t)location ];
+    peakBytes = std::max( peakBytes, currentBytes );
+    uint64_t& peakTotalBytes = m_PeakTotalBytes[ (uint32_t)location ];
+    peakTotalBytes = std::max( peakTotalBytes, totalBytes );
+}
+
+void CMemoryAccounting::Allocate( EMemoryCategory category, EMemoryLocation location, uint64_t bytes )
+{
+    Set( category, location, GetBytes( category, location ) + bytes );
+}
+
+void CMemoryAccounting::Free( EMemoryCategory category, EMemoryLocation location, uint64_t bytes )
+{
+    const uint64_t currentBytes = GetBytes( category, location );
+    assert( currentBytes >= bytes );
+    Set( category, location, currentBytes - std::min( currentBytes, bytes ) );
+}
+
+bool CMemoryAccounting::CheckBufferSize( const char* name, uint64_t bytes )
+{
+    if ( bytes <= UINT32_MAX )
+    {
+        return true;
+    }
+
+    LOG_STRING_FORMAT( "%s needs %llu bytes, which exceeds the 32-bit buffer size limit by %.2f MB.\n", name, bytes, ( bytes - UINT32_MAX ) * s_BytesToMB );
+    m_OversizedBuffers.push_back( { name, bytes } );
+    return false;
+}
+
+void CMemoryAccounting::LogReport() const
+{
+    LOG_STRING( "Scene memory            CPU steady   CPU peak     GPU steady   GPU peak (MB)\n" );
+    for ( uint32_t iCategory = 0; iCategory < (uint32_t)EMemoryCategory::Count; ++iCategory )
+    {
+        LOG_STRING_FORMAT( "%-22s %11.2f %10.2f %12.2f %10.2f\n", s_MemoryCategoryNames[ iCategory ]
+            , m_Bytes[ iCategory ][ (uint32_t)EMemoryLocation::CPU ] * s_BytesToMB, m_PeakBytes[ iCategory ][ (uint32_t)EMemoryLocation::CPU ] * s_BytesToMB
+            , m_Bytes[ iCategory ][ (uint32_t)EMemoryLocation::GPU ] * s_BytesToMB, m_PeakBytes[ iCategory ][ (uint32_t)EMemoryLocation::GPU ] * s_BytesToMB );
+    }
+    // The peak of the total is not the sum of the peaks of the categories, they peak at different times
+    LOG_STRING_FORMAT( "%-22s %11.2f %10.2f %12.2f %10.2f\n", "Total"
+        , GetTotalBytes( EMemoryLocation::CPU ) * s_BytesToMB, GetPeakTotalBytes( EMemoryLocation::CPU ) * s_BytesToMB
+        , GetTotalBytes( EMemoryLocation::GPU ) * s_BytesToMB, GetPeakTotalBytes( EMemoryLocation::GPU ) * s_BytesToMB );
+
+    for ( const SOversizedBuffer& buffer : m_OversizedBuffers )
+    {
+        LOG_STRING_FORMAT( "Size limit exceeded: %s needs %.2f MB.\n", buffer.m_Name.c_str(), buffer.m_Bytes * s_BytesToMB );
+    }
+}
+
+bool CMemoryAccounting::WriteReportToFile( const std::string& filename ) const
+{
+    FILE* file = fopen( filename.c_str(), "w" );
+    if ( !file )
+    {
+        LOG_STRING_FORMAT( "Failed to open memory report file %s.\n", filename.c_str() );
+        return false;
+    }
+
+    fprintf( file, "{\n  \"categories\": [\n" );
+    for ( uint32_t iCategory = 0; iCategory < (uint32_t)EMemoryCategory::Count; ++iCategory )
+    {
+        fprintf( file, "    { \"name\": \"%s\"", s_MemoryCategoryNames[ iCategory ] );
+        for ( uint32_t iLocation = 0; iLocation < (uint32_t)EMemoryLocation::Count; ++iLocation )
+        {
+            fprintf( file, ", \"%sSteadyBytes\": %llu, \"%sPeakBytes\": %llu", s_MemoryLocationNames[ iLocation ], m_Bytes[ iCategory ][ iLocation ]
+                , s_MemoryLocationNames[ iLocation ], m_PeakBytes[ iCategory ][ iLocation ] );
+        }
+        fprintf( file, " }%s\n", iCategory + 1 < (uint32_t)EMemoryCategory::Count ? "," : "" );
+    }
+    fprintf( file, "  ],\n  \"total\": {" );
+    for ( uint32_t iLocation = 0; iLocation < (uint32_t)EMemoryLocation::Count; ++iLocation )
+    {
+        fprintf( file, "%s \"%sSteadyBytes\": %llu, \"%sPeakBytes\": %llu", iLocation > 0 ? "," : "", s_MemoryLocationNames[ iLocation ], m_TotalBytes[ iLocation ]
+            , s_MemoryLocationNames[ iLocation ], m_PeakTotalBytes[ iLocation ] );
+    }
+    fprintf( file, " },\n  \"oversizedBuffers\": [" );
+    for ( size_t iBuffer = 0; iBuffer < m_OversizedBuffers.size(); ++iBuffer )
+    {
+        fprintf( file, "%s\n    { \"name\": \"%s\", \"bytes\": %llu }", iBuffer > 0 ? "," : "", m_OversizedBuffers[ iBuffer ].m_Name.c_str(), m_OversizedBuffers[ iBuffer ].m_Bytes );
+    }
+    fprintf( file, "%s]\n}\n", m_OversizedBuffers.empty() ? "" : "\n  " );
+
+    const bool result = ferror( file ) == 0;
+    fclose( file );
+    if ( result )
+    {
+        LOG_STRING_FORMAT( "Memory report written to %s.\n", filename.c_str() );
+    }
+    return result;
+}
+
+void CMemoryAccounting::OnImGUI() const
+{
+    if ( ImGui::BeginTable( "Memory", 5, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit ) )
+    {
+        ImGui::TableSetupColumn( "MB" );
+        ImGui::TableSetupColumn( "CPU" );
+        ImGui::TableSetupColumn( "CPU Peak" );
+        ImGui::TableSetupColumn( "GPU" );
+        ImGui::TableSetupColumn( "GPU Peak" );
+        ImGui::TableHeadersRow();
+
+        auto AddRow = []( const char* name, uint64_t CPUBytes, uint64_t CPUPeakBytes, uint64_t GPUBytes, uint64_t GPUPeakBytes )
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::TextUnformatted( name );
+            ImGui::TableNextColumn();
+            ImGui::Text( "%.2f", CPUBytes * s_BytesToMB );
+            ImGui::TableNextColumn();
+            ImGui::Text( "%.2f", CPUPeakBytes * s_BytesToMB );
+            ImGui::TableNextColumn();
+            ImGui::Text( "%.2f", GPUBytes * s_BytesToMB );
+            ImGui::TableNextColumn();
+            ImGui::Text( "%.2f", GPUPeakBytes * s_BytesToMB );
+        };
+
+        for ( uint32_t iCategory = 0; iCategory < (uint32_t)EMemoryCategory::Count; ++iCategory )
+        {
+            AddRow( s_MemoryCategoryNames[ iCategory ], m_Bytes[ iCategory ][ (uint32_t)EMemoryLocation::CPU ], m_PeakBytes[ iCategory ][ (uint32_t)EMemoryLocation::CPU ]
+                , m_Bytes[ iCategory ][ (uint32_t)EMemoryLocation::GPU ], m_PeakBytes[ iCategory ][ (uint32_t)EMemoryLocation::GPU ] );
+        }
+        AddRow( "Total", GetTotalBytes( EMemoryLocation::CPU ), GetPeakTotalBytes( EMemoryLocation::CPU ), GetTotalBytes( EMemoryLocation::GPU ), GetPeakTotalBytes( EMemoryLocation::GPU ) );
+
+        ImGui::EndTable();
+    }
+
+    for ( const SOversizedBuffer& buffer : m_OversizedBuffers )
+    {
+        ImGui::TextColored( ImVec4( 1.f, .3f, .3f, 1.f ), "%s exceeds the 32-bit size limit (%.2f MB)", buffer.m_Name.c_str(), buffer.m_Bytes * s_BytesToMB );
+    }
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+enum class EMemoryCategory
+{
+    MeshVertices,
+    MeshIndices,
+    MaterialIds,
+    BLASNodes,
+    TLAS,
+    Instances,
+    Materials,
+    Textures,
+    Lights,
+    LoadTimeCopies,     // Temporary arrays built while loading, e.g. the packed geometry before it is uploaded
+    UploadStaging,      // Upload arena memory holding the initial data of the GPU resources until the load is executed
+    Count
+};
+
+enum class EMemoryLocation
+{
+    CPU,
+    GPU,
+    Count
+};
+
+// Tallies the bytes of a scene per category and location. Besides the current bytes, the peak of every category and the peak of the total
+// of each location are kept, so the transient copies made while loading show up in the peaks but not in the steady state. Not thread safe.
+class CMemoryAccounting
+{
+public:
+    CMemoryAccounting();
+
+    void Reset();
+
+    // Starts measuring the peaks from the current bytes
+    void ResetPeaks();
+
+    void Set( EMemoryCategory category, EMemoryLocation location, uint64_t bytes );
+
+    void Allocate( EMemoryCategory category, EMemoryLocation location, uint64_t bytes );
+
+    void Free( EMemoryCategory category, EMemoryLocation location, uint64_t bytes );
+
+    // Buffer sizes are passed to the GPU buffers as 32-bit integers, returns false and records the buffer for the report when the size does not fit
+    bool CheckBufferSize( const char* name, uint64_t bytes );
+
+    uint64_t GetBytes( EMemoryCategory category, EMemoryLocation location ) const { return m_Bytes[ (uint32_t)category ][ (uint32_t)location ]; }
+
+    uint64_t GetPeakBytes( EMemoryCategory category, EMemoryLocation location ) const { return m_PeakBytes[ (uint32_t)category ][ (uint32_t)location ]; }
+
+    uint64_t GetTotalBytes( EMemoryLocation location ) const { return m_TotalBytes[ (uint32_t)location ]; }
+
+    uint64_t GetPeakTotalBytes( EMemoryLocation location ) const { return m_PeakTotalBytes[ (uint32_t)location ]; }
+
+    void LogReport() const;
+
+    bool WriteReportToFile( const std::string& filename ) const;
+
+    void OnImGUI() const;
+
+private:
+    struct SOversizedBuffer
+    {
+        std::string m_Name;
+        uint64_t m_Bytes;
+    };
+
+    uint64_t m_Bytes[ (uint32_t)EMemoryCategory::Count ][ (uint32_t)EMemoryLocation::Count ];
+    uint64_t m_PeakBytes[ (uint32_t)EMemoryCategory::Count ][ (uint32_t)EMemoryLocation::Count ];
+    uint64_t m_TotalBytes[ (uint32_t)EMemoryLocation::Count ];
+    uint64_t m_PeakTotalBytes[ (uint32_t)EMemoryLocation::Count ];
+    std::vector<SOversizedBuffer> m_OversizedBuffers;
+};
+
+class CScopedMemoryAllocation
+{
+public:
+    CScopedMemoryAllocation( CMemoryAccounting* accounting, EMemoryCategory category, EMemoryLocation location, uint64_t bytes )
+        : m_Accounting( accounting ), m_Category( category ), m_Location( location ), m_Bytes( bytes )
+    {
+        m_Accounting->Allocate( m_Category, m_Location, m_Bytes );
+    }
+
+    ~CScopedMemoryAllocation()
+    {
+        m_Accounting->Free( m_Category, m_Location, m_Bytes );
+    }
+
+private:
+    CMemoryAccounting* m_Accounting;
+    EMemoryCategory m_Category;
+    EMemoryLocation m_Location;
+    uint64_t m_Bytes;
+};
\ No newline at end of file
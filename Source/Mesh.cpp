@@ -1,9 +1,162 @@
 #include "stdafx.h"
+#include "MikkTSpace/mikktspace.h"
 #include "Mesh.h"
 #include "Logging.h"
+#include "Constants.h"
+#include "Profiling.h"
 
 using namespace DirectX;
 
+static void GenerateVertexNormals( const std::vector<uint32_t>& indices, std::vector<GPU::Vertex>* vertices )
+{
+    PROFILE_SCOPE( "Generate normals" );
+
+    // Area weighted, since the unnormalized cross product is proportional to the triangle area
+    for ( size_t iIndex = 0; iIndex + 2 < indices.size(); iIndex += 3 )
+    {
+        GPU::Vertex& v0 = ( *vertices )[ indices[ iIndex ] ];
+        GPU::Vertex& v1 = ( *vertices )[ indices[ iIndex + 1 ] ];
+        GPU::Vertex& v2 = ( *vertices )[ indices[ iIndex + 2 ] ];
+        XMVECTOR vP0 = XMLoadFloat3( &v0.position );
+        XMVECTOR vFaceNormal = XMVector3Cross( XMLoadFloat3( &v1.position ) - vP0, XMLoadFloat3( &v2.position ) - vP0 );
+        XMStoreFloat3( &v0.normal, XMLoadFloat3( &v0.normal ) + vFaceNormal );
+        XMStoreFloat3( &v1.normal, XMLoadFloat3( &v1.normal ) + vFaceNormal );
+        XMStoreFloat3( &v2.normal, XMLoadFloat3( &v2.normal ) + vFaceNormal );
+    }
+
+    for ( GPU::Vertex& vertex : *vertices )
+    {
+        XMStoreFloat3( &vertex.normal, XMVector3Normalize( XMLoadFloat3( &vertex.normal ) ) );
+    }
+}
+
+struct SIndexedMeshMikkTSpaceContext
+{
+    SIndexedMeshMikkTSpaceContext( const std::vector<GPU::Vertex>& vertices, const std::vector<uint32_t>& indices, std::vector<XMFLOAT3>* tangents )
+        : m_Vertices( vertices ), m_Indices( indices ), m_Tangents( tangents )
+    {}
+
+    const std::vector<GPU::Vertex>& m_Vertices;
+    const std::vector<uint32_t>& m_Indices;
+    std::vector<XMFLOAT3>* m_Tangents;
+};
+
+static int MikkTSpaceGetNumFaces( const SMikkTSpaceContext* pContext )
+{
+    SIndexedMeshMikkTSpaceContext* meshContext = (SIndexedMeshMikkTSpaceContext*)pContext->m_pUserData;
+    assert( meshContext->m_Indices.size() / 3 <= std::numeric_limits<int>::max() );
+    return (int)( meshContext->m_Indices.size() / 3 );
+}
+
+static int MikkTSpaceGetNumVerticesOfFace( const SMikkTSpaceContext* pContext, const int iFace )
+{
+    return 3;
+}
+
+static void MikkTSpaceGetPosition( const SMikkTSpaceContext* pContext, float fvPosOut[], const int iFace, const int iVert )
+{
+    SIndexedMeshMikkTSpaceContext* meshContext = (SIndexedMeshMikkTSpaceContext*)pContext->m_pUserData;
+    const GPU::Vertex& vertex = meshContext->m_Vertices[ meshContext->m_Indices[ iFace * 3 + iVert ] ];
+    fvPosOut[ 0 ] = vertex.position.x;
+    fvPosOut[ 1 ] = vertex.position.y;
+    fvPosOut[ 2 ] = vertex.position.z;
+}
+
+static void MikkTSpaceGetNormal( const SMikkTSpaceContext* pContext, float fvNormOut[], const int iFace, const int iVert )
+{
+    SIndexedMeshMikkTSpaceContext* meshContext = (SIndexedMeshMikkTSpaceContext*)pContext->m_pUserData;
+    const GPU::Vertex& vertex = meshContext->m_Vertices[ meshContext->m_Indices[ iFace * 3 + iVert ] ];
+    fvNormOut[ 0 ] = vertex.normal.x;
+    fvNormOut[ 1 ] = vertex.normal.y;
+    fvNormOut[ 2 ] = vertex.normal.z;
+}
+
+static void MikkTSpaceGetTexcoord( const SMikkTSpaceContext* pContext, float fvTexcOut[], const int iFace, const int iVert )
+{
+    SIndexedMeshMikkTSpaceContext* meshContext = (SIndexedMeshMikkTSpaceContext*)pContext->m_pUserData;
+    const GPU::Vertex& vertex = meshContext->m_Vertices[ meshContext->m_Indices[ iFace * 3 + iVert ] ];
+    fvTexcOut[ 0 ] = vertex.texcoord.x;
+    fvTexcOut[ 1 ] = vertex.texcoord.y;
+}
+
+static void MikkTSpaceSetTSpaceBasic( const SMikkTSpaceContext* pContext, const float fvTangent[], const float fSign, const int iFace, const int iVert )
+{
+    SIndexedMeshMikkTSpaceContext* meshContext = (SIndexedMeshMikkTSpaceContext*)pContext->m_pUserData;
+    ( *meshContext->m_Tangents )[ iFace * 3 + iVert ] = XMFLOAT3( fvTangent[ 0 ], fvTangent[ 1 ], fvTangent[ 2 ] );
+}
+
+// Generates per face-vertex tangents with MikkTSpace, then splits the shared vertices whose tangents disagree.
+static bool GenerateTangentsForIndexedMesh( std::vector<GPU::Vertex>* vertices, std::vector<uint32_t>* indices )
+{
+    PROFILE_SCOPE( "Generate tangents" );
+
+    std::vector<XMFLOAT3> tangents( indices->size() );
+
+    SMikkTSpaceContext mikkTSpaceContext;
+    SMikkTSpaceInterface mikkTSpaceInterface;
+    mikkTSpaceContext.m_pInterface = &mikkTSpaceInterface;
+    ZeroMemory( &mikkTSpaceInterface, sizeof( SMikkTSpaceInterface ) );
+    mikkTSpaceInterface.m_getNumFaces = MikkTSpaceGetNumFaces;
+    mikkTSpaceInterface.m_getNumVerticesOfFace = MikkTSpaceGetNumVerticesOfFace;
+    mikkTSpaceInterface.m_getPosition = MikkTSpaceGetPosition;
+    mikkTSpaceInterface.m_getNormal = MikkTSpaceGetNormal;
+    mikkTSpaceInterface.m_getTexCoord = MikkTSpaceGetTexcoord;
+    mikkTSpaceInterface.m_setTSpaceBasic = MikkTSpaceSetTSpaceBasic;
+
+    SIndexedMeshMikkTSpaceContext meshContext( *vertices, *indices, &tangents );
+    mikkTSpaceContext.m_pUserData = &meshContext;
+    if ( !genTangSpaceDefault( &mikkTSpaceContext ) )
+    {
+        return false;
+    }
+
+    // The first face-vertex referencing a vertex claims it, later ones with a different tangent get a copy
+    const uint32_t originalVertexCount = (uint32_t)vertices->size();
+    std::vector<bool> isTangentAssigned( originalVertexCount, false );
+    std::vector<uint32_t> splitVertexChain( originalVertexCount, UINT_MAX ); // Links a vertex to its next split copy
+    for ( size_t iIndex = 0; iIndex < indices->size(); ++iIndex )
+    {
+        uint32_t vertexIndex = ( *indices )[ iIndex ];
+        const XMFLOAT3& tangent = tangents[ iIndex ];
+        if ( !isTangentAssigned[ vertexIndex ] )
+        {
+            ( *vertices )[ vertexIndex ].tangent = tangent;
+            isTangentAssigned[ vertexIndex ] = true;
+            continue;
+        }
+
+        while ( true )
+        {
+            const XMFLOAT3& existingTangent = ( *vertices )[ vertexIndex ].tangent;
+            if ( existingTangent.x == tangent.x && existingTangent.y == tangent.y && existingTangent.z == tangent.z )
+            {
+                break;
+            }
+
+            if ( splitVertexChain[ vertexIndex ] == UINT_MAX )
+            {
+                if ( vertices->size() == UINT_MAX )
+                {
+                    return false;
+                }
+
+                const uint32_t newVertexIndex = (uint32_t)vertices->size();
+                GPU::Vertex newVertex = ( *vertices )[ vertexIndex ];
+                newVertex.tangent = tangent;
+                vertices->emplace_back( newVertex );
+                splitVertexChain.push_back( UINT_MAX );
+                splitVertexChain[ vertexIndex ] = newVertexIndex;
+                vertexIndex = newVertexIndex;
+                break;
+            }
+            vertexIndex = splitVertexChain[ vertexIndex ];
+        }
+        ( *indices )[ iIndex ] = vertexIndex;
+    }
+
+    return true;
+}
+
 bool Mesh::GenerateRectangle( uint32_t materialId, bool applyTransform, const DirectX::XMFLOAT4X4& transform )
 {
     if ( GetVertexCount() + 4 <= UINT_MAX )
@@ -56,8 +209,71 @@ bool Mesh::GenerateRectangle( uint32_t materialId, bool applyTransform, const Di
     }
 }
 
+bool Mesh::AppendTriangles( std::vector<GPU::Vertex>* vertices, std::vector<uint32_t>* indices, bool hasNormals, const SMeshProcessingParams& params )
+{
+    if ( params.m_FlipTexcoordV )
+    {
+        for ( GPU::Vertex& vertex : *vertices )
+        {
+            vertex.texcoord.y = 1.f - vertex.texcoord.y;
+        }
+    }
+
+    if ( !hasNormals )
+    {
+        GenerateVertexNormals( *indices, vertices );
+    }
+
+    if ( !GenerateTangentsForIndexedMesh( vertices, indices ) )
+    {
+        LOG_STRING( "Generating tangent failed when appending triangles.\n" );
+        return false;
+    }
+
+    // Normals and tangents are generated with the original winding order
+    if ( params.m_ChangeWindingOrder )
+    {
+        for ( size_t iIndex = 0; iIndex < indices->size(); iIndex += 3 )
+        {
+            std::swap( ( *indices )[ iIndex + 1 ], ( *indices )[ iIndex + 2 ] );
+        }
+    }
+
+    if ( params.m_ApplyTransform )
+    {
+        XMMATRIX vTransform = XMLoadFloat4x4( &params.m_Transform );
+        XMVECTOR vDet;
+        XMMATRIX vNormalTransform = XMMatrixTranspose( XMMatrixInverse( &vDet, vTransform ) );
+        for ( GPU::Vertex& vertex : *vertices )
+        {
+            XMStoreFloat3( &vertex.position, XMVector3Transform( XMLoadFloat3( &vertex.position ), vTransform ) );
+            XMStoreFloat3( &vertex.normal, XMVector3TransformNormal( XMLoadFloat3( &vertex.normal ), vNormalTransform ) );
+            XMStoreFloat3( &vertex.tangent, XMVector3TransformNormal( XMLoadFloat3( &vertex.tangent ), vNormalTransform ) );
+        }
+    }
+
+    const uint32_t indexBase = GetVertexCount();
+    if ( (uint64_t)indexBase + vertices->size() > UINT_MAX )
+    {
+        LOG_STRING( "Maximum vertex count is exceeded when appending triangles.\n" );
+        return false;
+    }
+
+    m_Vertices.insert( m_Vertices.end(), vertices->begin(), vertices->end() );
+    m_Indices.reserve( m_Indices.size() + indices->size() );
+    for ( uint32_t index : *indices )
+    {
+        m_Indices.push_back( indexBase + index );
+    }
+    m_MaterialIds.resize( m_MaterialIds.size() + indices->size() / 3, (uint32_t)INVALID_MATERIAL_ID );
+
+    return true;
+}
+
 void Mesh::BuildBVH( std::vector<uint32_t>* reorderedTriangleIndices )
 {
+    PROFILE_SCOPE( "Build BLAS" );
+
     std::vector<uint32_t> indices = m_Indices;
     std::vector<uint32_t> triangleIndices;
     std::vector<uint32_t>* reorderedTriangleIndicesUsed = reorderedTriangleIndices;
@@ -22,6 +22,13 @@ class Mesh
 public:
     bool LoadFromWavefrontOBJFile( const std::filesystem::path& filename, const SMeshProcessingParams& params, std::vector<struct SMaterial>* outMaterials, std::vector<class CTexture>* outTextures );
 
+    bool LoadFromPLYFile( const std::filesystem::path& filename, const SMeshProcessingParams& params );
+
+    bool LoadFromMitsubaSerializedFile( const std::filesystem::path& filename, uint32_t shapeIndex, bool useFaceNormals, const SMeshProcessingParams& params );
+
+    // Takes a triangle list with welded vertices, applies the processing params, generates the missing vectors and appends it to the mesh.
+    bool AppendTriangles( std::vector<GPU::Vertex>* vertices, std::vector<uint32_t>* indices, bool hasNormals, const SMeshProcessingParams& params );
+
     bool GenerateRectangle( uint32_t materialId, bool applyTransform = false, const DirectX::XMFLOAT4X4& transform = MathHelper::s_IdentityMatrix4x4 );
 
     void BuildBVH( std::vector<uint32_t>* reorderedTriangleIndices = nullptr );
@@ -65,4 +72,7 @@ public:
     uint32_t m_BVHMaxDepth = 0;
     uint32_t m_BVHMaxStackSize = 0;
     std::vector<uint32_t> m_MaterialIds;
-};
\ No newline at end of file
+};
+
+// Loads the same mesh from an OBJ and a PLY file several times and logs the load times of both formats
+void RunMeshLoadingBenchmark( const std::filesystem::path& OBJFilename, const std::filesystem::path& PLYFilename );
\ No newline at end of file
@@ -0,0 +1,513 @@
+#include "stdafx.h"
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "Logging.h"
+#include "Profiling.h"
+#include "Timers.h"
+
+using namespace DirectX;
+
+enum class EPLYPropertyType
+{
+    Unknown, Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64
+};
+
+enum class EPLYVertexAttribute
+{
+    Unused, PositionX, PositionY, PositionZ, NormalX, NormalY, NormalZ, TexcoordU, TexcoordV
+};
+
+struct SPLYProperty
+{
+    EPLYPropertyType m_Type = EPLYPropertyType::Unknown;
+    EPLYPropertyType m_ListCountType = EPLYPropertyType::Unknown;
+    EPLYVertexAttribute m_VertexAttribute = EPLYVertexAttribute::Unused;
+    std::string m_Name;
+    uint32_t m_Offset = 0;
+    bool m_IsList = false;
+};
+
+struct SPLYElement
+{
+    std::string m_Name;
+    std::vector<SPLYProperty> m_Properties;
+    uint64_t m_Count = 0;
+    uint32_t m_Stride = 0; // Only valid when the element has no list properties
+    bool m_HasListProperty = false;
+};
+
+static EPLYPropertyType GetPLYPropertyType( const std::string& name )
+{
+    static const std::unordered_map<std::string, EPLYPropertyType> s_NameToTypeMap =
+    {
+          { "char", EPLYPropertyType::Int8 }, { "int8", EPLYPropertyType::Int8 }
+        , { "uchar", EPLYPropertyType::UInt8 }, { "uint8", EPLYPropertyType::UInt8 }
+        , { "short", EPLYPropertyType::Int16 }, { "int16", EPLYPropertyType::Int16 }
+        , { "ushort", EPLYPropertyType::UInt16 }, { "uint16", EPLYPropertyType::UInt16 }
+        , { "int", EPLYPropertyType::Int32 }, { "int32", EPLYPropertyType::Int32 }
+        , { "uint", EPLYPropertyType::UInt32 }, { "uint32", EPLYPropertyType::UInt32 }
+        , { "float", EPLYPropertyType::Float32 }, { "float32", EPLYPropertyType::Float32 }
+        , { "double", EPLYPropertyType::Float64 }, { "float64", EPLYPropertyType::Float64 }
+    };
+    auto it = s_NameToTypeMap.find( name );
+    return it != s_NameToTypeMap.end() ? it->second : EPLYPropertyType::Unknown;
+}
+
+static uint32_t GetPLYPropertyTypeSize( EPLYPropertyType type )
+{
+    switch ( type )
+    {
+    case EPLYPropertyType::Int8:
+    case EPLYPropertyType::UInt8:
+        return 1;
+    case EPLYPropertyType::Int16:
+    case EPLYPropertyType::UInt16:
+        return 2;
+    case EPLYPropertyType::Int32:
+    case EPLYPropertyType::UInt32:
+    case EPLYPropertyType::Float32:
+        return 4;
+    case EPLYPropertyType::Float64:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+static EPLYVertexAttribute GetPLYVertexAttribute( const std::string& name )
+{
+    static const std::unordered_map<std::string, EPLYVertexAttribute> s_NameToAttributeMap =
+    {
+          { "x", EPLYVertexAttribute::PositionX }, { "y", EPLYVertexAttribute::PositionY }, { "z", EPLYVertexAttribute::PositionZ }
+        , { "nx", EPLYVertexAttribute::NormalX }, { "ny", EPLYVertexAttribute::NormalY }, { "nz", EPLYVertexAttribute::NormalZ }
+        , { "u", EPLYVertexAttribute::TexcoordU }, { "v", EPLYVertexAttribute::TexcoordV }
+        , { "s", EPLYVertexAttribute::TexcoordU }, { "t", EPLYVertexAttribute::TexcoordV }
+        , { "texture_u", EPLYVertexAttribute::TexcoordU }, { "texture_v", EPLYVertexAttribute::TexcoordV }
+        , { "texture_s", EPLYVertexAttribute::TexcoordU }, { "texture_t", EPLYVertexAttribute::TexcoordV }
+    };
+    auto it = s_NameToAttributeMap.find( name );
+    return it != s_NameToAttributeMap.end() ? it->second : EPLYVertexAttribute::Unused;
+}
+
+// Values are read with memcpy since the binary body has no alignment guarantee
+template <typename T>
+static T ReadPLYValue( const uint8_t* data )
+{
+    T value;
+    memcpy( &value, data, sizeof( T ) );
+    return value;
+}
+
+static double ReadPLYValueAsDouble( const uint8_t* data, EPLYPropertyType type )
+{
+    switch ( type )
+    {
+    case EPLYPropertyType::Int8:    return (double)ReadPLYValue<int8_t>( data );
+    case EPLYPropertyType::UInt8:   return (double)ReadPLYValue<uint8_t>( data );
+    case EPLYPropertyType::Int16:   return (double)ReadPLYValue<int16_t>( data );
+    case EPLYPropertyType::UInt16:  return (double)ReadPLYValue<uint16_t>( data );
+    case EPLYPropertyType::Int32:   return (double)ReadPLYValue<int32_t>( data );
+    case EPLYPropertyType::UInt32:  return (double)ReadPLYValue<uint32_t>( data );
+    case EPLYPropertyType::Float32: return (double)ReadPLYValue<float>( data );
+    case EPLYPropertyType::Float64: return ReadPLYValue<double>( data );
+    default:                        return 0.0;
+    }
+}
+
+static uint32_t ReadPLYValueAsUInt( const uint8_t* data, EPLYPropertyType type )
+{
+    switch ( type )
+    {
+    case EPLYPropertyType::Int8:    return (uint32_t)ReadPLYValue<int8_t>( data );
+    case EPLYPropertyType::UInt8:   return (uint32_t)ReadPLYValue<uint8_t>( data );
+    case EPLYPropertyType::Int16:   return (uint32_t)ReadPLYValue<int16_t>( data );
+    case EPLYPropertyType::UInt16:  return (uint32_t)ReadPLYValue<uint16_t>( data );
+    case EPLYPropertyType::Int32:   return (uint32_t)ReadPLYValue<int32_t>( data );
+    case EPLYPropertyType::UInt32:  return ReadPLYValue<uint32_t>( data );
+    case EPLYPropertyType::Float32: return (uint32_t)ReadPLYValue<float>( data );
+    case EPLYPropertyType::Float64: return (uint32_t)ReadPLYValue<double>( data );
+    default:                        return 0;
+    }
+}
+
+static bool ParsePLYHeader( const uint8_t* data, size_t size, std::vector<SPLYElement>* outElements, size_t* outBodyOffset )
+{
+    static const char s_EndHeader[] = "end_header";
+    const char* headerBegin = (const char*)data;
+    const char* headerEnd = nullptr;
+    for ( size_t i = 0; i + sizeof( s_EndHeader ) - 1 <= size; ++i )
+    {
+        if ( memcmp( headerBegin + i, s_EndHeader, sizeof( s_EndHeader ) - 1 ) == 0 )
+        {
+            headerEnd = headerBegin + i + sizeof( s_EndHeader ) - 1;
+            break;
+        }
+    }
+    if ( !headerEnd )
+    {
+        LOG_STRING( "Cannot find the end of PLY header.\n" );
+        return false;
+    }
+
+    // Skip the line break after end_header, which may be either LF or CRLF
+    const char* bodyBegin = headerEnd;
+    while ( bodyBegin < headerBegin + size && *bodyBegin != '\n' )
+    {
+        ++bodyBegin;
+    }
+    *outBodyOffset = ( bodyBegin - headerBegin ) + 1;
+
+    std::istringstream headerStream( std::string( headerBegin, headerEnd ) );
+    std::string line;
+    std::getline( headerStream, line );
+    if ( line.compare( 0, 3, "ply" ) != 0 )
+    {
+        LOG_STRING( "Missing PLY magic number.\n" );
+        return false;
+    }
+
+    bool hasValidFormat = false;
+    while ( std::getline( headerStream, line ) )
+    {
+        std::istringstream lineStream( line );
+        std::string keyword;
+        lineStream >> keyword;
+        if ( keyword == "format" )
+        {
+            std::string format;
+            lineStream >> format;
+            if ( format != "binary_little_endian" )
+            {
+                LOG_STRING_FORMAT( "Unsupported PLY format \'%s\', only binary_little_endian is supported.\n", format.c_str() );
+                return false;
+            }
+            hasValidFormat = true;
+        }
+        else if ( keyword == "element" )
+        {
+            outElements->emplace_back();
+            SPLYElement& element = outElements->back();
+            lineStream >> element.m_Name >> element.m_Count;
+        }
+        else if ( keyword == "property" )
+        {
+            if ( outElements->empty() )
+            {
+                LOG_STRING( "PLY property declared before any element.\n" );
+                return false;
+            }
+
+            SPLYElement& element = outElements->back();
+            element.m_Properties.emplace_back();
+            SPLYProperty& property = element.m_Properties.back();
+
+            std::string typeName;
+            lineStream >> typeName;
+            if ( typeName == "list" )
+            {
+                std::string countTypeName;
+                lineStream >> countTypeName >> typeName;
+                property.m_IsList = true;
+                property.m_ListCountType = GetPLYPropertyType( countTypeName );
+                element.m_HasListProperty = true;
+            }
+            property.m_Type = GetPLYPropertyType( typeName );
+            lineStream >> property.m_Name;
+
+            if ( property.m_Type == EPLYPropertyType::Unknown || ( property.m_IsList && property.m_ListCountType == EPLYPropertyType::Unknown ) )
+            {
+                LOG_STRING_FORMAT( "Unknown type of PLY property \'%s\'.\n", property.m_Name.c_str() );
+                return false;
+            }
+
+            property.m_Offset = element.m_Stride;
+            element.m_Stride += GetPLYPropertyTypeSize( property.m_Type );
+            if ( element.m_Name == "vertex" )
+            {
+                property.m_VertexAttribute = GetPLYVertexAttribute( property.m_Name );
+            }
+        }
+    }
+
+    if ( !hasValidFormat )
+    {
+        LOG_STRING( "Missing PLY format line.\n" );
+        return false;
+    }
+
+    return true;
+}
+
+static bool ReadPLYVertices( const SPLYElement& element, const uint8_t* data, const uint8_t* dataEnd, std::vector<GPU::Vertex>* outVertices, bool* outHasNormals, size_t* outReadSize )
+{
+    if ( element.m_HasListProperty )
+    {
+        LOG_STRING( "List properties in PLY vertex element are not supported.\n" );
+        return false;
+    }
+
+    uint32_t attributeMask = 0;
+    for ( const SPLYProperty& property : element.m_Properties )
+    {
+        attributeMask |= 1 << (uint32_t)property.m_VertexAttribute;
+    }
+    const uint32_t positionMask = ( 1 << (uint32_t)EPLYVertexAttribute::PositionX ) | ( 1 << (uint32_t)EPLYVertexAttribute::PositionY ) | ( 1 << (uint32_t)EPLYVertexAttribute::PositionZ );
+    const uint32_t normalMask = ( 1 << (uint32_t)EPLYVertexAttribute::NormalX ) | ( 1 << (uint32_t)EPLYVertexAttribute::NormalY ) | ( 1 << (uint32_t)EPLYVertexAttribute::NormalZ );
+    if ( ( attributeMask & positionMask ) != positionMask )
+    {
+        LOG_STRING( "PLY vertex element does not contain position.\n" );
+        return false;
+    }
+    *outHasNormals = ( attributeMask & normalMask ) == normalMask;
+
+    const size_t readSize = (size_t)element.m_Count * element.m_Stride;
+    if ( (size_t)( dataEnd - data ) < readSize )
+    {
+        LOG_STRING( "PLY file is truncated in vertex element.\n" );
+        return false;
+    }
+
+    // Fast path for the common layout where every attribute is a 32-bit float
+    bool allFloat32 = true;
+    for ( const SPLYProperty& property : element.m_Properties )
+    {
+        allFloat32 = allFloat32 && property.m_Type == EPLYPropertyType::Float32;
+    }
+
+    outVertices->resize( (size_t)element.m_Count );
+    for ( size_t iVertex = 0; iVertex < element.m_Count; ++iVertex )
+    {
+        const uint8_t* vertexData = data + iVertex * element.m_Stride;
+        GPU::Vertex& vertex = ( *outVertices )[ iVertex ];
+        vertex.position = XMFLOAT3( 0.f, 0.f, 0.f );
+        vertex.normal = XMFLOAT3( 0.f, 0.f, 0.f );
+        vertex.tangent = XMFLOAT3( 0.f, 0.f, 0.f );
+        vertex.texcoord = XMFLOAT2( 0.f, 0.f );
+
+        float* attributeDestinations[] =
+        {
+              nullptr
+            , &vertex.position.x, &vertex.position.y, &vertex.position.z
+            , &vertex.normal.x, &vertex.normal.y, &vertex.normal.z
+            , &vertex.texcoord.x, &vertex.texcoord.y
+        };
+
+        for ( const SPLYProperty& property : element.m_Properties )
+        {
+            float* destination = attributeDestinations[ (uint32_t)property.m_VertexAttribute ];
+            if ( destination )
+            {
+                *destination = allFloat32 ? ReadPLYValue<float>( vertexData + property.m_Offset ) : (float)ReadPLYValueAsDouble( vertexData + property.m_Offset, property.m_Type );
+            }
+        }
+    }
+
+    *outReadSize = readSize;
+    return true;
+}
+
+static bool ReadPLYFaces( const SPLYElement& element, const uint8_t* data, const uint8_t* dataEnd, uint32_t vertexCount, std::vector<uint32_t>* outIndices, size_t* outReadSize )
+{
+    const SPLYProperty* indicesProperty = nullptr;
+    for ( const SPLYProperty& property : element.m_Properties )
+    {
+        if ( property.m_IsList && ( property.m_Name == "vertex_indices" || property.m_Name == "vertex_index" ) )
+        {
+            indicesProperty = &property;
+            break;
+        }
+    }
+    if ( !indicesProperty )
+    {
+        LOG_STRING( "PLY face element does not contain vertex indices.\n" );
+        return false;
+    }
+
+    const uint8_t* current = data;
+    outIndices->reserve( (size_t)element.m_Count * 3 );
+    for ( size_t iFace = 0; iFace < element.m_Count; ++iFace )
+    {
+        for ( const SPLYProperty& property : element.m_Properties )
+        {
+            const uint32_t countSize = GetPLYPropertyTypeSize( property.m_ListCountType );
+            const uint32_t valueSize = GetPLYPropertyTypeSize( property.m_Type );
+            if ( !property.m_IsList )
+            {
+                if ( current + valueSize > dataEnd )
+                {
+                    LOG_STRING( "PLY file is truncated in face element.\n" );
+                    return false;
+                }
+                current += valueSize;
+                continue;
+            }
+
+            if ( current + countSize > dataEnd )
+            {
+                LOG_STRING( "PLY file is truncated in face element.\n" );
+                return false;
+            }
+            const uint32_t count = ReadPLYValueAsUInt( current, property.m_ListCountType );
+            current += countSize;
+            if ( current + (size_t)count * valueSize > dataEnd )
+            {
+                LOG_STRING( "PLY file is truncated in face element.\n" );
+                return false;
+            }
+
+            if ( &property == indicesProperty && count >= 3 )
+            {
+                // Triangulate polygons as fans
+                const uint32_t index0 = ReadPLYValueAsUInt( current, property.m_Type );
+                for ( uint32_t iVertex = 2; iVertex < count; ++iVertex )
+                {
+                    const uint32_t index1 = ReadPLYValueAsUInt( current + ( iVertex - 1 ) * valueSize, property.m_Type );
+                    const uint32_t index2 = ReadPLYValueAsUInt( current + iVertex * valueSize, property.m_Type );
+                    if ( index0 >= vertexCount || index1 >= vertexCount || index2 >= vertexCount )
+                    {
+                        LOG_STRING( "PLY face references a vertex out of range.\n" );
+                        return false;
+                    }
+                    outIndices->push_back( index0 );
+                    outIndices->push_back( index1 );
+                    outIndices->push_back( index2 );
+                }
+            }
+            current += (size_t)count * valueSize;
+        }
+    }
+
+    *outReadSize = current - data;
+    return true;
+}
+
+bool Mesh::LoadFromPLYFile( const std::filesystem::path& filenamePath, const SMeshProcessingParams& params )
+{
+    PROFILE_SCOPE( "Load PLY" );
+
+    const std::string filename = filenamePath.u8string();
+    LOG_STRING_FORMAT( "Loading mesh from: %s\n", filename.c_str() );
+
+    CMappedFile file;
+    if ( !file.Open( filenamePath ) )
+    {
+        LOG_STRING_FORMAT( "Cannot map PLY file \'%s\'.\n", filename.c_str() );
+        return false;
+    }
+
+    std::vector<SPLYElement> elements;
+    size_t bodyOffset = 0;
+    if ( !ParsePLYHeader( file.GetData(), file.GetSize(), &elements, &bodyOffset ) )
+    {
+        return false;
+    }
+
+    std::vector<GPU::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    bool hasVertexElement = false;
+    bool hasNormals = false;
+    const uint8_t* current = file.GetData() + bodyOffset;
+    const uint8_t* dataEnd = file.GetData() + file.GetSize();
+    for ( const SPLYElement& element : elements )
+    {
+        size_t readSize = 0;
+        if ( element.m_Name == "vertex" )
+        {
+            if ( element.m_Count > UINT_MAX )
+            {
+                LOG_STRING( "PLY vertex count exceeds the maximum.\n" );
+                return false;
+            }
+            if ( !ReadPLYVertices( element, current, dataEnd, &vertices, &hasNormals, &readSize ) )
+            {
+                return false;
+            }
+            hasVertexElement = true;
+        }
+        else if ( element.m_Name == "face" )
+        {
+            if ( !hasVertexElement )
+            {
+                LOG_STRING( "PLY face element appears before vertex element.\n" );
+                return false;
+            }
+            if ( !ReadPLYFaces( element, current, dataEnd, (uint32_t)vertices.size(), &indices, &readSize ) )
+            {
+                return false;
+            }
+        }
+        else if ( !element.m_HasListProperty )
+        {
+            // Skip unknown elements with fixed size
+            readSize = (size_t)element.m_Count * element.m_Stride;
+        }
+        else
+        {
+            LOG_STRING_FORMAT( "Unsupported PLY element \'%s\' with list properties.\n", element.m_Name.c_str() );
+            break;
+        }
+
+        if ( readSize > (size_t)( dataEnd - current ) )
+        {
+            LOG_STRING( "PLY file is truncated.\n" );
+            return false;
+        }
+        current += readSize;
+    }
+
+    if ( indices.empty() )
+    {
+        LOG_STRING( "PLY file contains no triangles.\n" );
+        return false;
+    }
+
+    return AppendTriangles( &vertices, &indices, hasNormals, params );
+}
+
+void RunMeshLoadingBenchmark( const std::filesystem::path& OBJFilename, const std::filesystem::path& PLYFilename )
+{
+    const uint32_t s_RunCount = 5;
+    const std::filesystem::path* filenames[] = { &OBJFilename, &PLYFilename };
+    const char* formatNames[] = { "OBJ", "PLY" };
+    for ( uint32_t iFormat = 0; iFormat < _countof( filenames ); ++iFormat )
+    {
+        // Same processing as the shapes of an XML scene
+        SMeshProcessingParams processingParams;
+        processingParams.m_ApplyTransform = false;
+        processingParams.m_ChangeWindingOrder = true;
+        processingParams.m_FlipTexcoordV = iFormat == 0;
+
+        const std::string filename = filenames[ iFormat ]->u8string();
+        std::error_code errorCode;
+        const uintmax_t fileSize = std::filesystem::file_size( *filenames[ iFormat ], errorCode );
+
+        float minMilliseconds = FLT_MAX;
+        float totalMilliseconds = 0.f;
+        uint32_t vertexCount = 0;
+        uint32_t triangleCount = 0;
+        for ( uint32_t iRun = 0; iRun < s_RunCount; ++iRun )
+        {
+            Mesh mesh;
+            Timer timer;
+            timer.Start();
+            const bool loadSuccessful = iFormat == 0 ? mesh.LoadFromWavefrontOBJFile( *filenames[ iFormat ], processingParams, nullptr, nullptr )
+                : mesh.LoadFromPLYFile( *filenames[ iFormat ], processingParams );
+            const float milliseconds = timer.GetElapsedMicroseconds().count() / 1000.f;
+            if ( !loadSuccessful )
+            {
+                LOG_STRING_FORMAT( "Failed to load %s file \'%s\', skipping it.\n", formatNames[ iFormat ], filename.c_str() );
+                break;
+            }
+
+            minMilliseconds = std::min( minMilliseconds, milliseconds );
+            totalMilliseconds += milliseconds;
+            vertexCount = mesh.GetVertexCount();
+            triangleCount = mesh.GetTriangleCount();
+            if ( iRun == s_RunCount - 1 )
+            {
+                LOG_STRING_FORMAT( "%s \'%s\' (%.2f MB, %u vertices, %u triangles): %.3f ms min, %.3f ms average over %u loads.\n", formatNames[ iFormat ], filename.c_str(),
+                    errorCode ? 0.f : fileSize / ( 1024.f * 1024.f ), vertexCount, triangleCount, minMilliseconds, totalMilliseconds / s_RunCount, s_RunCount );
+            }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "stdafx.h"
+#include "ParallelFor.h"
+
+uint32_t GetParallelForWorkerCount( uint32_t itemCount, uint32_t maxWorkerCount )
+{
+    uint32_t workerCount = std::max( std::thread::hardware_concurrency(), 1u );
+    if ( maxWorkerCount != 0 )
+    {
+        workerCount = std::min( workerCount, maxWorkerCount );
+    }
+    return std::max( std::min( workerCount, itemCount ), 1u );
+}
+
+void ParallelFor( uint32_t itemCount, const std::function<void( uint32_t, uint32_t )>& func, uint32_t maxWorkerCount )
+{
+    const uint32_t workerCount = GetParallelForWorkerCount( itemCount, maxWorkerCount );
+    std::atomic<uint32_t> nextItemIndex = 0;
+    auto workerFunc = [&]( uint32_t workerIndex )
+    {
+        uint32_t itemIndex;
+        while ( ( itemIndex = nextItemIndex.fetch_add( 1 ) ) < itemCount )
+        {
+            func( workerIndex, itemIndex );
+        }
+    };
+
+    // The calling thread works as the last worker
+    std::vector<std::thread> threads;
+    threads.reserve( workerCount - 1 );
+    for ( uint32_t workerIndex = 0; workerIndex + 1 < workerCount; ++workerIndex )
+    {
+        threads.emplace_back( workerFunc, workerIndex );
+    }
+    workerFunc( workerCount - 1 );
+
+    for ( std::thread& thread : threads )
+    {
+        thread.join();
+    }
+}
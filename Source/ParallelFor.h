@@ -0,0 +1,8 @@
+#pragma once
+
+// Returns the number of worker threads ParallelFor will use for the given item count.
+uint32_t GetParallelForWorkerCount( uint32_t itemCount, uint32_t maxWorkerCount = 0 );
+
+// Calls func( workerIndex, itemIndex ) for every item in [0, itemCount). Items are handed out one at a time so uneven items balance out.
+// workerIndex is in [0, GetParallelForWorkerCount()), it can be used to index per-worker state.
+void ParallelFor( uint32_t itemCount, const std::function<void( uint32_t, uint32_t )>& func, uint32_t maxWorkerCount = 0 );
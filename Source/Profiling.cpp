@@ -0,0 +1,239 @@
+#include "stdafx.h"
+#include "Profiling.h"
+#include "Logging.h"
+
+static const uint32_t s_MaxProfileScopeDepth = 64;
+
+struct SProfileEvent
+{
+    const char* m_Name;
+    int64_t m_StartMicroseconds;
+    int64_t m_DurationMicroseconds;
+    int64_t m_SelfMicroseconds;
+    uint32_t m_ThreadIndex;
+};
+
+static std::atomic<bool> s_IsProfileSessionActive = false;
+static std::chrono::steady_clock::time_point s_ProfileSessionStartTime;
+static std::atomic<uint32_t> s_ProfileThreadCount = 0;
+static std::mutex s_FinishedProfileEventsMutex;
+static std::vector<SProfileEvent> s_FinishedProfileEvents;
+
+// Events are appended without locking, the buffer of a thread is handed to the session when the thread exits
+struct SThreadProfileBuffer
+{
+    SThreadProfileBuffer()
+        : m_ThreadIndex( s_ProfileThreadCount.fetch_add( 1 ) )
+    {
+    }
+
+    ~SThreadProfileBuffer()
+    {
+        if ( !m_Events.empty() && s_IsProfileSessionActive.load( std::memory_order_relaxed ) )
+        {
+            std::lock_guard<std::mutex> lock( s_FinishedProfileEventsMutex );
+            s_FinishedProfileEvents.insert( s_FinishedProfileEvents.end(), m_Events.begin(), m_Events.end() );
+        }
+    }
+
+    std::vector<SProfileEvent> m_Events;
+    uint32_t m_ThreadIndex;
+    uint32_t m_Depth = 0;
+    int64_t m_ChildMicroseconds[ s_MaxProfileScopeDepth ] = {};
+};
+
+static thread_local SThreadProfileBuffer t_ProfileBuffer;
+
+CScopedProfileTimer::CScopedProfileTimer( const char* name )
+    : m_Name( name )
+    , m_IsRecording( false )
+{
+    if ( !s_IsProfileSessionActive.load( std::memory_order_relaxed ) )
+    {
+        return;
+    }
+
+    SThreadProfileBuffer& buffer = t_ProfileBuffer;
+    if ( buffer.m_Depth < s_MaxProfileScopeDepth )
+    {
+        buffer.m_ChildMicroseconds[ buffer.m_Depth ] = 0;
+        ++buffer.m_Depth;
+        m_IsRecording = true;
+        m_Timer.Start();
+    }
+}
+
+CScopedProfileTimer::~CScopedProfileTimer()
+{
+    if ( !m_IsRecording )
+    {
+        return;
+    }
+
+    const int64_t durationMicroseconds = m_Timer.GetElapsedMicroseconds().count();
+
+    SThreadProfileBuffer& buffer = t_ProfileBuffer;
+    --buffer.m_Depth;
+    if ( buffer.m_Depth > 0 )
+    {
+        buffer.m_ChildMicroseconds[ buffer.m_Depth - 1 ] += durationMicroseconds;
+    }
+
+    SProfileEvent event;
+    event.m_Name = m_Name;
+    event.m_StartMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>( m_Timer.GetStartTime() - s_ProfileSessionStartTime ).count();
+    event.m_DurationMicroseconds = durationMicroseconds;
+    event.m_SelfMicroseconds = durationMicroseconds - buffer.m_ChildMicroseconds[ buffer.m_Depth ];
+    event.m_ThreadIndex = buffer.m_ThreadIndex;
+    buffer.m_Events.push_back( event );
+}
+
+static void WriteJSONString( FILE* file, const char* str )
+{
+    fputc( '"', file );
+    for ( const char* c = str; *c; ++c )
+    {
+        if ( *c == '"' || *c == '\\' )
+        {
+            fputc( '\\', file );
+        }
+        fputc( *c, file );
+    }
+    fputc( '"', file );
+}
+
+static bool WriteChromeTrace( const std::string& filename, const char* sessionName, const std::vector<SProfileEvent>& events, uint32_t sessionThreadIndex )
+{
+    FILE* file = fopen( filename.c_str(), "w" );
+    if ( !file )
+    {
+        LOG_STRING_FORMAT( "Failed to open %s for writing.\n", filename.c_str() );
+        return false;
+    }
+
+    std::vector<uint32_t> threadIndices;
+    for ( const SProfileEvent& event : events )
+    {
+        threadIndices.push_back( event.m_ThreadIndex );
+    }
+    std::sort( threadIndices.begin(), threadIndices.end() );
+    threadIndices.erase( std::unique( threadIndices.begin(), threadIndices.end() ), threadIndices.end() );
+
+    fprintf( file, "{\n\"displayTimeUnit\": \"ms\",\n\"traceEvents\": [\n" );
+    fprintf( file, "{ \"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": { \"name\": ", sessionThreadIndex );
+    WriteJSONString( file, sessionName );
+    fprintf( file, " } }" );
+    for ( uint32_t threadIndex : threadIndices )
+    {
+        if ( threadIndex == sessionThreadIndex )
+        {
+            fprintf( file, ",\n{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": { \"name\": \"Main\" } }", threadIndex );
+        }
+        else
+        {
+            fprintf( file, ",\n{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": { \"name\": \"Worker %u\" } }", threadIndex, threadIndex );
+        }
+    }
+    for ( const SProfileEvent& event : events )
+    {
+        fprintf( file, ",\n{ \"name\": " );
+        WriteJSONString( file, event.m_Name );
+        fprintf( file, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %lld, \"dur\": %lld }", event.m_ThreadIndex, event.m_StartMicroseconds, event.m_DurationMicroseconds );
+    }
+    fprintf( file, "\n]\n}\n" );
+
+    const bool result = ferror( file ) == 0;
+    fclose( file );
+    return result;
+}
+
+static void LogProfileSummary( const char* sessionName, const std::vector<SProfileEvent>& events, int64_t sessionMicroseconds )
+{
+    struct SScopeSummary
+    {
+        const char* m_Name;
+        uint32_t m_Count = 0;
+        int64_t m_TotalMicroseconds = 0;
+        int64_t m_SelfMicroseconds = 0;
+        int64_t m_MaxMicroseconds = 0;
+    };
+
+    // Scopes are merged by name rather than by address, the same literal may be emitted once per translation unit
+    std::unordered_map<std::string, SScopeSummary> summaryMap;
+    for ( const SProfileEvent& event : events )
+    {
+        SScopeSummary& summary = summaryMap[ event.m_Name ];
+        summary.m_Name = event.m_Name;
+        ++summary.m_Count;
+        summary.m_TotalMicroseconds += event.m_DurationMicroseconds;
+        summary.m_SelfMicroseconds += event.m_SelfMicroseconds;
+        summary.m_MaxMicroseconds = std::max( summary.m_MaxMicroseconds, event.m_DurationMicroseconds );
+    }
+
+    std::vector<SScopeSummary> summaries;
+    summaries.reserve( summaryMap.size() );
+    for ( auto& it : summaryMap )
+    {
+        summaries.push_back( it.second );
+    }
+    std::sort( summaries.begin(), summaries.end(), []( const SScopeSummary& lhs, const SScopeSummary& rhs ) { return lhs.m_TotalMicroseconds > rhs.m_TotalMicroseconds; } );
+
+    // Scopes running on several threads may add up to more than the wall time of the session
+    LOG_STRING_FORMAT( "%s profile, %.2f ms wall time:\n", sessionName, sessionMicroseconds * 1e-3f );
+    LOG_STRING_FORMAT( "  %-32s %8s %12s %12s %12s %8s\n", "Scope", "Count", "Total ms", "Self ms", "Max ms", "Self %" );
+    for ( const SScopeSummary& summary : summaries )
+    {
+        LOG_STRING_FORMAT( "  %-32s %8u %12.2f %12.2f %12.2f %7.1f%%\n", summary.m_Name, summary.m_Count, summary.m_TotalMicroseconds * 1e-3f,
+            summary.m_SelfMicroseconds * 1e-3f, summary.m_MaxMicroseconds * 1e-3f, sessionMicroseconds > 0 ? summary.m_SelfMicroseconds * 100.f / sessionMicroseconds : 0.f );
+    }
+}
+
+CProfileSession::CProfileSession( const char* name, const std::string& traceFilename )
+    : m_Name( name )
+    , m_TraceFilename( traceFilename )
+    , m_IsActive( false )
+{
+    if ( s_IsProfileSessionActive.load() )
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock( s_FinishedProfileEventsMutex );
+        s_FinishedProfileEvents.clear();
+    }
+    t_ProfileBuffer.m_Events.clear();
+    s_ProfileSessionStartTime = std::chrono::steady_clock::now();
+    s_IsProfileSessionActive.store( true );
+    m_IsActive = true;
+}
+
+CProfileSession::~CProfileSession()
+{
+    if ( !m_IsActive )
+    {
+        return;
+    }
+
+    const int64_t sessionMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - s_ProfileSessionStartTime ).count();
+
+    std::vector<SProfileEvent> events;
+    {
+        std::lock_guard<std::mutex> lock( s_FinishedProfileEventsMutex );
+        events.swap( s_FinishedProfileEvents );
+        s_IsProfileSessionActive.store( false );
+    }
+    events.insert( events.end(), t_ProfileBuffer.m_Events.begin(), t_ProfileBuffer.m_Events.end() );
+    t_ProfileBuffer.m_Events.clear();
+
+    LogProfileSummary( m_Name, events, sessionMicroseconds );
+
+    if ( !m_TraceFilename.empty() )
+    {
+        std::sort( events.begin(), events.end(), []( const SProfileEvent& lhs, const SProfileEvent& rhs ) { return lhs.m_StartMicroseconds < rhs.m_StartMicroseconds; } );
+        if ( WriteChromeTrace( m_TraceFilename, m_Name, events, t_ProfileBuffer.m_ThreadIndex ) )
+        {
+            LOG_STRING_FORMAT( "%u profile events written to %s.\n", (uint32_t)events.size(), m_TraceFilename.c_str() );
+        }
+    }
+}
\ No newline at end of file
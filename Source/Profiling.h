@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Timers.h"
+
+// Records a timing event for its scope when a profiling session is active, on whatever thread it runs. Scopes nest, the time of the
+// enclosing scope minus the time of the nested ones is reported as its self time. Without an active session a scope costs one atomic load.
+// The name is not copied, it must be a string literal.
+class CScopedProfileTimer
+{
+public:
+    explicit CScopedProfileTimer( const char* name );
+
+    ~CScopedProfileTimer();
+
+private:
+    const char* m_Name;
+    Timer m_Timer;
+    bool m_IsRecording;
+};
+
+#define PROFILE_SCOPE( name ) CScopedProfileTimer __ProfileScope( name );
+
+// Collects the events of all threads from its construction to its destruction. Logs a table of the total and self times per scope name when
+// destroyed, and writes the events in the Chrome trace event format when a trace filename is given. Events of worker threads are collected
+// when the threads exit, threads still running when the session ends are not included. Only one session is active at a time.
+class CProfileSession
+{
+public:
+    CProfileSession( const char* name, const std::string& traceFilename );
+
+    ~CProfileSession();
+
+private:
+    const char* m_Name;
+    std::string m_TraceFilename;
+    bool m_IsActive;
+};
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "stdafx.h"
+#include "RussianRoulette.h"
+#include "Logging.h"
+#include "Timers.h"
+
+using namespace DirectX;
+
+float CalculateRussianRouletteSurvivalProbability( const XMFLOAT3& pathThroughput )
+{
+    return std::clamp( std::max( pathThroughput.x, std::max( pathThroughput.y, pathThroughput.z ) ), 0.f, 1.f );
+}
+
+struct SFurnaceResult
+{
+    XMFLOAT3 m_Radiance;
+    XMFLOAT3 m_StandardError;
+    double m_RaysPerPath;
+    double m_PathsPerSecond;
+};
+
+// Traces paths from random points inside a unit sphere whose surface is Lambertian with the given albedo and emits unit radiance. Follows the
+// loop of the megakernel path tracer: emission is gathered at every hit, and Russian roulette is played after the bounce throughput is updated.
+static SFurnaceResult RenderFurnace( const XMFLOAT3& albedo, uint32_t maxBounceCount, uint32_t russianRouletteBounceCount, uint32_t pathCount, std::mt19937& rng )
+{
+    auto nextSample = [ &rng ]() { return ( rng() >> 8 ) / float( 1 << 24 ); };
+
+    double sum[ 3 ] = {};
+    double squaredSum[ 3 ] = {};
+    uint64_t rayCount = 0;
+
+    Timer timer;
+    timer.Start();
+    for ( uint32_t iPath = 0; iPath < pathCount; ++iPath )
+    {
+        // Start from a random point and direction inside the sphere
+        XMVECTOR position = XMVectorSet( nextSample() - .5f, nextSample() - .5f, nextSample() - .5f, 0.f );
+        const float z = 1.f - 2.f * nextSample();
+        const float phi = 2.f * (float)M_PI * nextSample();
+        const float r = sqrtf( std::max( 0.f, 1.f - z * z ) );
+        XMVECTOR direction = XMVectorSet( r * cosf( phi ), r * sinf( phi ), z, 0.f );
+
+        XMFLOAT3 pathThroughput( 1.f, 1.f, 1.f );
+        XMFLOAT3 radiance( 0.f, 0.f, 0.f );
+        for ( uint32_t iBounce = 0; iBounce <= maxBounceCount; ++iBounce )
+        {
+            // Intersect the sphere from the inside
+            ++rayCount;
+            const float b = XMVectorGetX( XMVector3Dot( position, direction ) );
+            const float c = XMVectorGetX( XMVector3Dot( position, position ) ) - 1.f;
+            const float t = -b + sqrtf( std::max( 0.f, b * b - c ) );
+            position = XMVector3Normalize( position + direction * t );
+
+            radiance.x += pathThroughput.x;
+            radiance.y += pathThroughput.y;
+            radiance.z += pathThroughput.z;
+            if ( iBounce == maxBounceCount )
+            {
+                break;
+            }
+
+            // Cosine sample around the inward normal, the BSDF times the cosine over the PDF is the albedo
+            const XMVECTOR normal = -position;
+            const XMVECTOR tangent = XMVector3Normalize( fabsf( XMVectorGetX( normal ) ) > .9f ? XMVector3Cross( normal, XMVectorSet( 0.f, 1.f, 0.f, 0.f ) )
+                : XMVector3Cross( normal, XMVectorSet( 1.f, 0.f, 0.f, 0.f ) ) );
+            const XMVECTOR bitangent = XMVector3Cross( normal, tangent );
+            const float diskRadius = sqrtf( nextSample() );
+            const float diskPhi = 2.f * (float)M_PI * nextSample();
+            const float diskX = diskRadius * cosf( diskPhi );
+            const float diskY = diskRadius * sinf( diskPhi );
+            direction = XMVector3Normalize( tangent * diskX + bitangent * diskY + normal * sqrtf( std::max( 0.f, 1.f - diskX * diskX - diskY * diskY ) ) );
+            pathThroughput.x *= albedo.x;
+            pathThroughput.y *= albedo.y;
+            pathThroughput.z *= albedo.z;
+
+            if ( iBounce >= russianRouletteBounceCount )
+            {
+                const float survivalProbability = CalculateRussianRouletteSurvivalProbability( pathThroughput );
+                if ( nextSample() >= survivalProbability )
+                {
+                    break;
+                }
+                pathThroughput.x /= survivalProbability;
+                pathThroughput.y /= survivalProbability;
+                pathThroughput.z /= survivalProbability;
+            }
+        }
+
+        const float values[ 3 ] = { radiance.x, radiance.y, radiance.z };
+        for ( uint32_t i = 0; i < 3; ++i )
+        {
+            sum[ i ] += values[ i ];
+            squaredSum[ i ] += (double)values[ i ] * values[ i ];
+        }
+    }
+    const float elapsedSeconds = timer.GetElapsedSecondsFloat().count();
+
+    SFurnaceResult result;
+    double mean[ 3 ];
+    double standardError[ 3 ];
+    for ( uint32_t i = 0; i < 3; ++i )
+    {
+        mean[ i ] = sum[ i ] / pathCount;
+        standardError[ i ] = sqrt( std::max( squaredSum[ i ] / pathCount - mean[ i ] * mean[ i ], 0.0 ) / pathCount );
+    }
+    result.m_Radiance = XMFLOAT3( (float)mean[ 0 ], (float)mean[ 1 ], (float)mean[ 2 ] );
+    result.m_StandardError = XMFLOAT3( (float)standardError[ 0 ], (float)standardError[ 1 ], (float)standardError[ 2 ] );
+    result.m_RaysPerPath = (double)rayCount / pathCount;
+    result.m_PathsPerSecond = elapsedSeconds > 0.f ? pathCount / elapsedSeconds : 0.0;
+    return result;
+}
+
+static bool IsConsistentWith( const SFurnaceResult& result, const XMFLOAT3& reference )
+{
+    // Five standard errors, plus a tolerance for the float precision of the accumulation
+    return fabsf( result.m_Radiance.x - reference.x ) <= 5.f * result.m_StandardError.x + 1e-4f * reference.x
+        && fabsf( result.m_Radiance.y - reference.y ) <= 5.f * result.m_StandardError.y + 1e-4f * reference.y
+        && fabsf( result.m_Radiance.z - reference.z ) <= 5.f * result.m_StandardError.z + 1e-4f * reference.z;
+}
+
+static bool ValidateFurnace( const char* name, const XMFLOAT3& albedo, uint32_t maxBounceCount, uint32_t russianRouletteBounceCount, std::mt19937& rng )
+{
+    // Every hit gathers the emission, so the radiance is the sum of the powers of the albedo up to the max bounce count
+    XMFLOAT3 reference( 0.f, 0.f, 0.f );
+    XMFLOAT3 power( 1.f, 1.f, 1.f );
+    for ( uint32_t i = 0; i <= maxBounceCount; ++i )
+    {
+        reference.x += power.x;
+        reference.y += power.y;
+        reference.z += power.z;
+        power.x *= albedo.x;
+        power.y *= albedo.y;
+        power.z *= albedo.z;
+    }
+
+    const uint32_t pathCount = 1 << 18;
+    const SFurnaceResult baseline = RenderFurnace( albedo, maxBounceCount, UINT32_MAX, pathCount, rng );
+    const SFurnaceResult roulette = RenderFurnace( albedo, maxBounceCount, russianRouletteBounceCount, pathCount, rng );
+
+    // Without roulette every path of the furnace carries the same radiance, so the noise added by the roulette is reported instead of an efficiency
+    const float relativeStandardError = std::max( roulette.m_StandardError.x / std::max( roulette.m_Radiance.x, 1e-6f ),
+        std::max( roulette.m_StandardError.y / std::max( roulette.m_Radiance.y, 1e-6f ), roulette.m_StandardError.z / std::max( roulette.m_Radiance.z, 1e-6f ) ) );
+
+    const bool passed = IsConsistentWith( baseline, reference ) && IsConsistentWith( roulette, reference );
+    LOG_STRING_FORMAT( "%s: radiance ( %.4f, %.4f, %.4f ), without roulette ( %.4f, %.4f, %.4f ) at %.1f rays per path and %.0f paths/s, "
+        "with roulette from bounce %u ( %.4f, %.4f, %.4f ) at %.1f rays per path and %.0f paths/s, %.2fx paths/s, relative standard error %.2g%%, %s\n",
+        name, reference.x, reference.y, reference.z,
+        baseline.m_Radiance.x, baseline.m_Radiance.y, baseline.m_Radiance.z, baseline.m_RaysPerPath, baseline.m_PathsPerSecond,
+        russianRouletteBounceCount, roulette.m_Radiance.x, roulette.m_Radiance.y, roulette.m_Radiance.z, roulette.m_RaysPerPath, roulette.m_PathsPerSecond,
+        baseline.m_PathsPerSecond > 0.0 ? roulette.m_PathsPerSecond / baseline.m_PathsPerSecond : 0.0, relativeStandardError * 100.f, passed ? "passed" : "FAILED" );
+    return passed;
+}
+
+bool ValidateRussianRoulette()
+{
+    std::mt19937 rng( 0x2255 );
+
+    bool isValid = true;
+    isValid &= ValidateFurnace( "Bright interior", XMFLOAT3( .9f, .8f, .7f ), 64, 3, rng );
+    isValid &= ValidateFurnace( "Colored interior", XMFLOAT3( .2f, .5f, .9f ), 32, 3, rng );
+    isValid &= ValidateFurnace( "Dark interior", XMFLOAT3( .18f, .18f, .18f ), 16, 1, rng );
+    isValid &= ValidateFurnace( "Roulette from the first bounce", XMFLOAT3( .5f, .5f, .5f ), 16, 0, rng );
+
+    LOG_STRING_FORMAT( "Russian roulette validation %s.\n", isValid ? "passed" : "FAILED" );
+    return isValid;
+}
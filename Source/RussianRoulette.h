@@ -0,0 +1,8 @@
+#pragma once
+
+// Same as RussianRouletteSurvivalProbability in the shaders
+float CalculateRussianRouletteSurvivalProbability( const DirectX::XMFLOAT3& pathThroughput );
+
+// Renders a diffuse furnace, the inside of a closed emissive sphere, with a CPU reference integrator with and without Russian roulette.
+// Checks both against the analytic radiance and logs the paths per second. Returns false on failure.
+bool ValidateRussianRoulette();
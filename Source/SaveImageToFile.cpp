@@ -4,17 +4,18 @@
 #include "D3D12Adapter.h"
 #include "GPUTexture.h"
 #include "Logging.h"
-#include <wincodec.h>
-#include <wincodecsdk.h>
+#include "ImageWriting.h"
+#include "Timers.h"
 
-bool SImageReadback::ReadbackRenderResult( CScene* scene )
+using namespace DirectX;
+
+static bool ReadbackTexture( ID3D12Resource* texture, SImageReadback* readback )
 {
-    ID3D12Resource* renderResultTexture = scene->m_RenderResultTexture->GetTexture();
     ID3D12Device* device = D3D12Adapter::GetDevice();
 
-    D3D12_RESOURCE_DESC textureDesc = renderResultTexture->GetDesc();
+    D3D12_RESOURCE_DESC textureDesc = texture->GetDesc();
     UINT64 totalBytes = 0;
-    device->GetCopyableFootprints( &textureDesc, 0, 1, 0, &m_Footprint, nullptr, nullptr, &totalBytes );
+    device->GetCopyableFootprints( &textureDesc, 0, 1, 0, &readback->m_Footprint, nullptr, nullptr, &totalBytes );
 
     ComPtr<ID3D12Resource> readbackBuffer;
     CD3DX12_HEAP_PROPERTIES heapProperties( D3D12_HEAP_TYPE_READBACK );
@@ -29,154 +30,107 @@ bool SImageReadback::ReadbackRenderResult( CScene* scene )
 
     ID3D12GraphicsCommandList* commandList = D3D12Adapter::GetCommandList();
 
-    assert( scene->m_IsRenderResultTextureRead );
-
     D3D12_TEXTURE_COPY_LOCATION dst = {};
     dst.pResource = readbackBuffer.Get();
     dst.Type = D3D12_TEXTURE_COPY_TYPE_PLACED_FOOTPRINT;
-    dst.PlacedFootprint = m_Footprint;
+    dst.PlacedFootprint = readback->m_Footprint;
 
     D3D12_TEXTURE_COPY_LOCATION src = {};
-    src.pResource = renderResultTexture;
+    src.pResource = texture;
     src.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
     src.SubresourceIndex = 0;
 
     commandList->CopyTextureRegion( &dst, 0, 0, 0, &src, nullptr );
 
-    m_Buffer = readbackBuffer;
-    m_SizeInBytes = totalBytes;
+    readback->m_Buffer = readbackBuffer;
+    readback->m_SizeInBytes = totalBytes;
     return true;
 }
 
-static bool CopyReadbackToBGR( const SImageReadback& readback, std::vector<uint8_t>* outBGRPixels )
+bool SImageReadback::ReadbackRenderResult( CScene* scene )
 {
-    const uint32_t width = readback.m_Footprint.Footprint.Width;
-    const uint32_t height = readback.m_Footprint.Footprint.Height;
-    const uint32_t bgrStride = width * 3;
-    const UINT64 bgrSize = (UINT64)bgrStride * height;
-    if ( bgrSize > (UINT64)std::numeric_limits<UINT>::max() )
-    {
-        LOG_STRING( "Image is too large to encode with WIC.\n" );
-        return false;
-    }
+    assert( scene->m_IsRenderResultTextureRead );
 
-    uint8_t* mappedData = nullptr;
-    D3D12_RANGE readRange = { 0, (SIZE_T)readback.m_SizeInBytes };
-    HRESULT hr = readback.m_Buffer->Map( 0, &readRange, reinterpret_cast<void**>( &mappedData ) );
-    if ( FAILED( hr ) )
-    {
-        LOG_STRING_FORMAT( "Failed to map image readback buffer: %x\n", hr );
-        return false;
-    }
+    m_IsFilm = false;
+    return ReadbackTexture( scene->m_RenderResultTexture->GetTexture(), this );
+}
 
-    outBGRPixels->resize( (size_t)bgrSize );
-    for ( uint32_t y = 0; y < height; ++y )
+bool SImageReadback::ReadbackFilm( CScene* scene )
+{
+    if ( scene->m_FilmTextureStates != D3D12_RESOURCE_STATE_COPY_SOURCE )
     {
-        const uint8_t* srcRow = mappedData + (SIZE_T)y * readback.m_Footprint.Footprint.RowPitch;
-        uint8_t* dstRow = outBGRPixels->data() + (size_t)y * bgrStride;
-        for ( uint32_t x = 0; x < width; ++x )
-        {
-            const uint8_t* srcPixel = srcRow + (size_t)x * 4;
-            uint8_t* dstPixel = dstRow + (size_t)x * 3;
-            dstPixel[ 0 ] = srcPixel[ 2 ];
-            dstPixel[ 1 ] = srcPixel[ 1 ];
-            dstPixel[ 2 ] = srcPixel[ 0 ];
-        }
+        D3D12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition( scene->m_FilmTexture->GetTexture(),
+            scene->m_FilmTextureStates, D3D12_RESOURCE_STATE_COPY_SOURCE );
+        D3D12Adapter::GetCommandList()->ResourceBarrier( 1, &barrier );
+        scene->m_FilmTextureStates = D3D12_RESOURCE_STATE_COPY_SOURCE;
     }
 
-    D3D12_RANGE writeRange = { 0, 0 };
-    readback.m_Buffer->Unmap( 0, &writeRange );
-    return true;
+    m_IsFilm = true;
+    return ReadbackTexture( scene->m_FilmTexture->GetTexture(), this );
 }
 
-static bool SaveBGRPixelsToBMP( const wchar_t* filepath, uint32_t width, uint32_t height, const std::vector<uint8_t>& BGRPixels )
+// Divides the weighted sums by the weights, texels without any sample resolve to black
+static void ResolveFilmRow( const XMFLOAT4* filmTexels, uint32_t width, XMFLOAT3* radiance )
 {
-    HRESULT coInitializeHR = CoInitializeEx( nullptr, COINIT_APARTMENTTHREADED );
-    const bool shouldUninitializeCOM = SUCCEEDED( coInitializeHR );
-    if ( FAILED( coInitializeHR ) && coInitializeHR != RPC_E_CHANGED_MODE )
+    const XMVECTOR zero = XMVectorZero();
+    for ( uint32_t x = 0; x < width; ++x )
     {
-        LOG_STRING_FORMAT( "Failed to initialize COM for WIC: %x\n", coInitializeHR );
-        return false;
-    }
-
-    ComPtr<IWICImagingFactory> factory;
-    HRESULT hr = CoCreateInstance( CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS( factory.GetAddressOf() ) );
-    if ( SUCCEEDED( hr ) )
-    {
-        ComPtr<IWICStream> stream;
-        hr = factory->CreateStream( stream.GetAddressOf() );
-        if ( SUCCEEDED( hr ) )
-        {
-            hr = stream->InitializeFromFilename( filepath, GENERIC_WRITE );
-        }
-
-        ComPtr<IWICBitmapEncoder> encoder;
-        if ( SUCCEEDED( hr ) )
-        {
-            hr = factory->CreateEncoder( GUID_ContainerFormatBmp, nullptr, encoder.GetAddressOf() );
-        }
-        if ( SUCCEEDED( hr ) )
-        {
-            hr = encoder->Initialize( stream.Get(), WICBitmapEncoderNoCache );
-        }
-
-        ComPtr<IWICBitmapFrameEncode> frame;
-        if ( SUCCEEDED( hr ) )
-        {
-            hr = encoder->CreateNewFrame( frame.GetAddressOf(), nullptr );
-        }
-        if ( SUCCEEDED( hr ) )
-        {
-            hr = frame->Initialize( nullptr );
-        }
-        if ( SUCCEEDED( hr ) )
-        {
-            hr = frame->SetSize( width, height );
-        }
-        if ( SUCCEEDED( hr ) )
-        {
-            WICPixelFormatGUID pixelFormat = GUID_WICPixelFormat24bppBGR;
-            hr = frame->SetPixelFormat( &pixelFormat );
-            if ( SUCCEEDED( hr ) && !IsEqualGUID( pixelFormat, GUID_WICPixelFormat24bppBGR ) )
-            {
-                hr = E_FAIL;
-            }
-        }
-        if ( SUCCEEDED( hr ) )
-        {
-            const uint32_t stride = width * 3;
-            hr = frame->WritePixels( height, stride, (UINT)BGRPixels.size(), const_cast<BYTE*>( BGRPixels.data() ) );
-        }
-        if ( SUCCEEDED( hr ) )
-        {
-            hr = frame->Commit();
-        }
-        if ( SUCCEEDED( hr ) )
-        {
-            hr = encoder->Commit();
-        }
+        const XMVECTOR texel = XMLoadFloat4( filmTexels + x );
+        const XMVECTOR weight = XMVectorSplatW( texel );
+        const XMVECTOR resolved = XMVectorSelect( zero, XMVectorDivide( texel, weight ), XMVectorGreater( weight, zero ) );
+        XMStoreFloat3( radiance + x, resolved );
     }
+}
 
-    if ( shouldUninitializeCOM )
+bool SImageReadback::SaveToFile( const wchar_t* filepath ) const
+{
+    EImageFileFormat fileFormat = m_IsFilm ? EImageFileFormat::PFM : EImageFileFormat::BMP;
+    if ( !GetImageFileFormatFromExtension( filepath, &fileFormat ) )
     {
-        CoUninitialize();
+        LOG_STRING_FORMAT( "Unknown image file extension, saving as %s.\n", m_IsFilm ? "PFM" : "BMP" );
     }
 
+    uint8_t* mappedData = nullptr;
+    D3D12_RANGE readRange = { 0, (SIZE_T)m_SizeInBytes };
+    HRESULT hr = m_Buffer->Map( 0, &readRange, reinterpret_cast<void**>( &mappedData ) );
     if ( FAILED( hr ) )
     {
-        LOG_STRING_FORMAT( "Failed to save BMP image: %x\n", hr );
+        LOG_STRING_FORMAT( "Failed to map image readback buffer: %x\n", hr );
         return false;
     }
-    return true;
-}
 
-void SImageReadback::SaveToFile( const wchar_t* filepath ) const
-{
-    std::vector<uint8_t> BGRPixels;
-    if ( !CopyReadbackToBGR( *this, &BGRPixels ) )
+    // Rows are pulled straight from the mapped readback buffer, so no full size copy of the image is made. The film is resolved row by row on the writer's workers.
+    SImageWriteDesc desc;
+    desc.m_Width = m_Footprint.Footprint.Width;
+    desc.m_Height = m_Footprint.Footprint.Height;
+    desc.m_RowFormat = m_IsFilm ? EImageRowFormat::R32G32B32_Float : EImageRowFormat::R8G8B8A8_sRGB;
+    desc.m_FileFormat = fileFormat;
+    const uint8_t* imageData = mappedData + m_Footprint.Offset;
+    const UINT rowPitch = m_Footprint.Footprint.RowPitch;
+    const size_t rowSize = (size_t)desc.m_Width * 4;
+    const bool isFilm = m_IsFilm;
+
+    Timer timer;
+    timer.Start();
+
+    const bool result = WriteImageToFile( filepath, desc, [=]( uint32_t y, void* row )
     {
-        return;
+        if ( isFilm )
+        {
+            ResolveFilmRow( (const XMFLOAT4*)( imageData + (SIZE_T)y * rowPitch ), desc.m_Width, (XMFLOAT3*)row );
+        }
+        else
+        {
+            memcpy( row, imageData + (SIZE_T)y * rowPitch, rowSize );
+        }
+    } );
+    if ( result )
+    {
+        LOG_STRING_FORMAT( "%ux%u %s saved in %.3f ms.\n", desc.m_Width, desc.m_Height, isFilm ? "film" : "image", timer.GetElapsedMicroseconds().count() / 1000.f );
     }
 
-    SaveBGRPixelsToBMP( filepath, m_Footprint.Footprint.Width, m_Footprint.Footprint.Height, BGRPixels );
+    D3D12_RANGE writeRange = { 0, 0 };
+    m_Buffer->Unmap( 0, &writeRange );
+
+    return result;
 }
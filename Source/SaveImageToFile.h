@@ -5,9 +5,12 @@ class CScene;
 struct SImageReadback
 {
     bool ReadbackRenderResult( CScene* scene );
-    void SaveToFile( const wchar_t* filepath ) const;
+    // Film texels hold the weighted sum of the samples in RGB and the sum of the weights in A, they are resolved to radiance when saved
+    bool ReadbackFilm( CScene* scene );
+    bool SaveToFile( const wchar_t* filepath ) const;
 
     ComPtr<ID3D12Resource> m_Buffer;
     D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_Footprint = {};
     UINT64 m_SizeInBytes = 0;
+    bool m_IsFilm = false;
 };
@@ -10,6 +10,14 @@
 #include "D3D12GPUDescriptorHeap.h"
 #include "StringConversion.h"
 #include "MathHelper.h"
+#include "Timers.h"
+#include "ParallelFor.h"
+#include "Profiling.h"
+#include "TextureCompression.h"
+#include "TextureCache.h"
+#include "EnvironmentLightDistribution.h"
+#include "AliasTable.h"
+#include "MemoryAccounting.h"
 #include "../Shaders/LightSharedDef.inc.hlsl"
 #include "../Shaders/InstanceSharedDef.inc.hlsl"
 #include "imgui/imgui.h"
@@ -28,6 +36,22 @@ static DXGI_FORMAT GetDXGIFormat( ETexturePixelFormat pixelFormat )
     {
         return DXGI_FORMAT_R8_UNORM;
     }
+    case ETexturePixelFormat::BC1_sRGB:
+    {
+        return DXGI_FORMAT_BC1_UNORM_SRGB;
+    }
+    case ETexturePixelFormat::BC4_Unorm:
+    {
+        return DXGI_FORMAT_BC4_UNORM;
+    }
+    case ETexturePixelFormat::BC7_sRGB:
+    {
+        return DXGI_FORMAT_BC7_UNORM_SRGB;
+    }
+    case ETexturePixelFormat::R32G32B32A32_Float:
+    {
+        return DXGI_FORMAT_R32G32B32A32_FLOAT;
+    }
     default:
     {
         return DXGI_FORMAT_UNKNOWN;
@@ -100,15 +124,526 @@ static void RebuildMeshFlags( CScene* scene )
     }
 }
 
+static uint64_t HashBytes( const void* data, size_t size, uint64_t hash )
+{
+    // FNV-1a
+    const uint8_t* bytes = (const uint8_t*)data;
+    for ( size_t i = 0; i < size; ++i )
+    {
+        hash ^= bytes[ i ];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Hashes the data that is left unchanged by a rigid transform, so copies of a mesh placed at different positions and orientations collide.
+// Positions only enter through the squared edge lengths of the first triangles, quantized to a few mantissa bits since translated copies
+// are rounded differently. Meshes sharing their topology but not their shape then fall in different buckets most of the time.
+static uint64_t HashMeshShape( const Mesh& mesh )
+{
+    uint64_t hash = 14695981039346656037ull;
+    const uint32_t vertexCount = mesh.GetVertexCount();
+    hash = HashBytes( &vertexCount, sizeof( vertexCount ), hash );
+    for ( const GPU::Vertex& vertex : mesh.GetVertices() )
+    {
+        hash = HashBytes( &vertex.texcoord, sizeof( vertex.texcoord ), hash );
+    }
+    hash = HashBytes( mesh.GetIndices().data(), mesh.GetIndices().size() * sizeof( uint32_t ), hash );
+    hash = HashBytes( mesh.GetMaterialIds().data(), mesh.GetMaterialIds().size() * sizeof( uint32_t ), hash );
+
+    const uint32_t s_ShapeHashTriangleCount = 8;
+    const std::vector<GPU::Vertex>& vertices = mesh.GetVertices();
+    const std::vector<uint32_t>& indices = mesh.GetIndices();
+    const uint32_t triangleCount = std::min( (uint32_t)indices.size() / 3, s_ShapeHashTriangleCount );
+    for ( uint32_t iTriangle = 0; iTriangle < triangleCount; ++iTriangle )
+    {
+        for ( uint32_t iEdge = 0; iEdge < 3; ++iEdge )
+        {
+            const XMVECTOR p0 = XMLoadFloat3( &vertices[ indices[ iTriangle * 3 + iEdge ] ].position );
+            const XMVECTOR p1 = XMLoadFloat3( &vertices[ indices[ iTriangle * 3 + ( iEdge + 1 ) % 3 ] ].position );
+            const float edgeLengthSquared = XMVectorGetX( XMVector3LengthSq( p1 - p0 ) );
+            uint32_t quantizedEdgeLengthSquared;
+            memcpy( &quantizedEdgeLengthSquared, &edgeLengthSquared, sizeof( float ) );
+            quantizedEdgeLengthSquared = ( quantizedEdgeLengthSquared + 0x4000 ) & 0xFFFF8000;
+            hash = HashBytes( &quantizedEdgeLengthSquared, sizeof( quantizedEdgeLengthSquared ), hash );
+        }
+    }
+    return hash;
+}
+
+// A mesh kept by the deduplication, with the vertices spanning the frame its duplicates are matched in
+struct SCanonicalMesh
+{
+    uint32_t m_MeshIndex;
+    uint32_t m_FrameVertexIndices[ 3 ];
+    bool m_HasFrame;
+    float m_MaxAbsCoordinate;
+    XMFLOAT4X4 m_InverseFrame;
+};
+
+static float GetMaxAbsCoordinate( const Mesh& mesh )
+{
+    float maxAbsCoordinate = 0.f;
+    for ( const GPU::Vertex& vertex : mesh.GetVertices() )
+    {
+        maxAbsCoordinate = std::max( maxAbsCoordinate, std::max( fabsf( vertex.position.x ), std::max( fabsf( vertex.position.y ), fabsf( vertex.position.z ) ) ) );
+    }
+    return maxAbsCoordinate;
+}
+
+// Orthonormal frame with its origin at the first vertex, the x axis toward the second and the second and third vertices in the xy plane
+static bool BuildMeshFrame( const Mesh& mesh, const uint32_t vertexIndices[ 3 ], XMMATRIX* frame )
+{
+    const std::vector<GPU::Vertex>& vertices = mesh.GetVertices();
+    const XMVECTOR v0 = XMLoadFloat3( &vertices[ vertexIndices[ 0 ] ].position );
+    const XMVECTOR e1 = XMLoadFloat3( &vertices[ vertexIndices[ 1 ] ].position ) - v0;
+    const XMVECTOR e2 = XMLoadFloat3( &vertices[ vertexIndices[ 2 ] ].position ) - v0;
+    const XMVECTOR normal = XMVector3Cross( e1, e2 );
+    const float e1Length = XMVectorGetX( XMVector3Length( e1 ) );
+    const float normalLength = XMVectorGetX( XMVector3Length( normal ) );
+    if ( e1Length <= 0.f || normalLength <= 1e-4f * e1Length * e1Length )
+    {
+        return false;
+    }
+
+    const XMVECTOR xAxis = e1 / e1Length;
+    const XMVECTOR zAxis = normal / normalLength;
+    const XMVECTOR yAxis = XMVector3Cross( zAxis, xAxis );
+    frame->r[ 0 ] = XMVectorSetW( xAxis, 0.f );
+    frame->r[ 1 ] = XMVectorSetW( yAxis, 0.f );
+    frame->r[ 2 ] = XMVectorSetW( zAxis, 0.f );
+    frame->r[ 3 ] = XMVectorSetW( v0, 1.f );
+    return true;
+}
+
+static SCanonicalMesh CreateCanonicalMesh( const Mesh& mesh, uint32_t meshIndex, float maxAbsCoordinate )
+{
+    SCanonicalMesh canonicalMesh;
+    canonicalMesh.m_MeshIndex = meshIndex;
+    canonicalMesh.m_MaxAbsCoordinate = maxAbsCoordinate;
+
+    // The vertex farthest from the first one, then the one farthest from the line through both, to keep the frame well conditioned
+    const std::vector<GPU::Vertex>& vertices = mesh.GetVertices();
+    const XMVECTOR v0 = XMLoadFloat3( &vertices[ 0 ].position );
+    uint32_t farthestIndex = 0;
+    float farthestDistanceSquared = 0.f;
+    for ( uint32_t i = 0; i < (uint32_t)vertices.size(); ++i )
+    {
+        const float distanceSquared = XMVectorGetX( XMVector3LengthSq( XMLoadFloat3( &vertices[ i ].position ) - v0 ) );
+        if ( distanceSquared > farthestDistanceSquared )
+        {
+            farthestDistanceSquared = distanceSquared;
+            farthestIndex = i;
+        }
+    }
+    const XMVECTOR direction = XMVector3Normalize( XMLoadFloat3( &vertices[ farthestIndex ].position ) - v0 );
+    uint32_t offLineIndex = 0;
+    float offLineDistanceSquared = 0.f;
+    for ( uint32_t i = 0; i < (uint32_t)vertices.size(); ++i )
+    {
+        const float distanceSquared = XMVectorGetX( XMVector3LengthSq( XMVector3Cross( XMLoadFloat3( &vertices[ i ].position ) - v0, direction ) ) );
+        if ( distanceSquared > offLineDistanceSquared )
+        {
+            offLineDistanceSquared = distanceSquared;
+            offLineIndex = i;
+        }
+    }
+
+    canonicalMesh.m_FrameVertexIndices[ 0 ] = 0;
+    canonicalMesh.m_FrameVertexIndices[ 1 ] = farthestIndex;
+    canonicalMesh.m_FrameVertexIndices[ 2 ] = offLineIndex;
+    XMMATRIX frame;
+    canonicalMesh.m_HasFrame = BuildMeshFrame( mesh, canonicalMesh.m_FrameVertexIndices, &frame );
+    if ( canonicalMesh.m_HasFrame )
+    {
+        XMVECTOR determinant;
+        XMStoreFloat4x4( &canonicalMesh.m_InverseFrame, XMMatrixInverse( &determinant, frame ) );
+    }
+    return canonicalMesh;
+}
+
+// Finds the rigid transform taking the canonical mesh onto the other one, vertices correspond by index. Positions have to match within a
+// tolerance relative to their magnitude since translated copies are rounded differently, every other attribute matches the transformed one.
+static bool MatchMeshRigidly( const Mesh& canonical, const SCanonicalMesh& canonicalMesh, const Mesh& mesh, float maxAbsCoordinate, XMFLOAT4X4* canonicalToMesh )
+{
+    if ( canonical.GetVertexCount() != mesh.GetVertexCount()
+        || canonical.GetIndexCount() != mesh.GetIndexCount()
+        || canonical.GetMaterialIds().size() != mesh.GetMaterialIds().size()
+        || memcmp( canonical.GetIndices().data(), mesh.GetIndices().data(), mesh.GetIndexCount() * sizeof( uint32_t ) ) != 0
+        || memcmp( canonical.GetMaterialIds().data(), mesh.GetMaterialIds().data(), mesh.GetMaterialIds().size() * sizeof( uint32_t ) ) != 0 )
+    {
+        return false;
+    }
+
+    const std::vector<GPU::Vertex>& canonicalVertices = canonical.GetVertices();
+    const std::vector<GPU::Vertex>& vertices = mesh.GetVertices();
+    if ( memcmp( canonicalVertices.data(), vertices.data(), vertices.size() * sizeof( GPU::Vertex ) ) == 0 )
+    {
+        XMStoreFloat4x4( canonicalToMesh, XMMatrixIdentity() );
+        return true;
+    }
+
+    XMMATRIX transform;
+    if ( canonicalMesh.m_HasFrame )
+    {
+        XMMATRIX frame;
+        if ( !BuildMeshFrame( mesh, canonicalMesh.m_FrameVertexIndices, &frame ) )
+        {
+            return false;
+        }
+        transform = XMMatrixMultiply( XMLoadFloat4x4( &canonicalMesh.m_InverseFrame ), frame );
+    }
+    else
+    {
+        // Degenerate meshes, e.g. all vertices on a line, are only matched up to a translation
+        transform = XMMatrixTranslationFromVector( XMLoadFloat3( &vertices[ 0 ].position ) - XMLoadFloat3( &canonicalVertices[ 0 ].position ) );
+    }
+
+    const float positionTolerance = 1e-5f * std::max( canonicalMesh.m_MaxAbsCoordinate, maxAbsCoordinate );
+    const float directionTolerance = 1e-3f;
+    for ( size_t i = 0; i < vertices.size(); ++i )
+    {
+        const GPU::Vertex& canonicalVertex = canonicalVertices[ i ];
+        const GPU::Vertex& vertex = vertices[ i ];
+        if ( canonicalVertex.texcoord.x != vertex.texcoord.x || canonicalVertex.texcoord.y != vertex.texcoord.y )
+        {
+            return false;
+        }
+
+        const XMVECTOR positionError = XMVector3Transform( XMLoadFloat3( &canonicalVertex.position ), transform ) - XMLoadFloat3( &vertex.position );
+        const XMVECTOR normalError = XMVector3TransformNormal( XMLoadFloat3( &canonicalVertex.normal ), transform ) - XMLoadFloat3( &vertex.normal );
+        const XMVECTOR tangentError = XMVector3TransformNormal( XMLoadFloat3( &canonicalVertex.tangent ), transform ) - XMLoadFloat3( &vertex.tangent );
+        if ( XMVectorGetX( XMVector3Length( positionError ) ) > positionTolerance
+            || XMVectorGetX( XMVector3Length( normalError ) ) > directionTolerance
+            || XMVectorGetX( XMVector3Length( tangentError ) ) > directionTolerance )
+        {
+            return false;
+        }
+    }
+
+    XMStoreFloat4x4( canonicalToMesh, transform );
+    return true;
+}
+
+// Replaces meshes that are copies of another one up to a rigid transform by instances of the first one, so they share a BLAS and vertex buffer
+// range. The transform taking the first mesh onto the copy is folded into the instance transforms, which covers the same prop exported as
+// separate shapes at different places. Only meshes appended by the current load are considered, the older ones have been reordered by their
+// BVH builds already.
+static void DeduplicateMeshes( CScene* scene, size_t meshIndexBase )
+{
+    PROFILE_SCOPE( "Deduplicate meshes" );
+
+    const size_t meshCount = scene->m_Meshes.size();
+    std::unordered_multimap<uint64_t, uint32_t> hashToCanonicalMeshMap;
+    std::vector<SCanonicalMesh> canonicalMeshes;
+    std::vector<uint32_t> meshIndexRemap( meshCount );
+    std::vector<XMFLOAT4X4> canonicalToMeshTransforms( meshCount );
+    uint32_t duplicatedMeshCount = 0;
+    uint32_t transformedDuplicateCount = 0;
+    uint64_t savedSize = 0;
+    for ( size_t iMesh = 0; iMesh < meshCount; ++iMesh )
+    {
+        meshIndexRemap[ iMesh ] = (uint32_t)iMesh;
+        if ( iMesh < meshIndexBase || scene->m_Meshes[ iMesh ].GetVertexCount() == 0 )
+        {
+            continue;
+        }
+
+        const Mesh& mesh = scene->m_Meshes[ iMesh ];
+        const uint64_t hash = HashMeshShape( mesh );
+        const float maxAbsCoordinate = GetMaxAbsCoordinate( mesh );
+        auto range = hashToCanonicalMeshMap.equal_range( hash );
+        for ( auto it = range.first; it != range.second; ++it )
+        {
+            const SCanonicalMesh& canonicalMesh = canonicalMeshes[ it->second ];
+            if ( MatchMeshRigidly( scene->m_Meshes[ canonicalMesh.m_MeshIndex ], canonicalMesh, mesh, maxAbsCoordinate, &canonicalToMeshTransforms[ iMesh ] ) )
+            {
+                meshIndexRemap[ iMesh ] = canonicalMesh.m_MeshIndex;
+                break;
+            }
+        }
+
+        if ( meshIndexRemap[ iMesh ] == iMesh )
+        {
+            hashToCanonicalMeshMap.insert( { hash, (uint32_t)canonicalMeshes.size() } );
+            canonicalMeshes.emplace_back( CreateCanonicalMesh( mesh, (uint32_t)iMesh, maxAbsCoordinate ) );
+        }
+        else
+        {
+            ++duplicatedMeshCount;
+            if ( !XMMatrixIsIdentity( XMLoadFloat4x4( &canonicalToMeshTransforms[ iMesh ] ) ) )
+            {
+                ++transformedDuplicateCount;
+            }
+            savedSize += mesh.GetVertexCount() * sizeof( GPU::Vertex ) + ( mesh.GetIndexCount() + mesh.GetMaterialIds().size() ) * sizeof( uint32_t );
+        }
+    }
+
+    if ( duplicatedMeshCount == 0 )
+    {
+        return;
+    }
+
+    // Instances of a duplicate first apply the transform placing the canonical mesh where the duplicate was
+    assert( scene->m_MeshInstances.size() == scene->m_InstanceTransforms.size() );
+    for ( size_t iInstance = 0; iInstance < scene->m_MeshInstances.size(); ++iInstance )
+    {
+        const uint32_t meshIndex = scene->m_MeshInstances[ iInstance ].m_MeshIndex;
+        if ( meshIndexRemap[ meshIndex ] != meshIndex )
+        {
+            XMFLOAT4X3& instanceTransform = scene->m_InstanceTransforms[ iInstance ];
+            XMStoreFloat4x3( &instanceTransform, XMMatrixMultiply( XMLoadFloat4x4( &canonicalToMeshTransforms[ meshIndex ] ), XMLoadFloat4x3( &instanceTransform ) ) );
+        }
+    }
+
+    // Compact the mesh array, canonical meshes always precede their duplicates so they are moved before being referenced
+    std::vector<uint32_t> compactedMeshIndices( meshCount );
+    uint32_t compactedMeshCount = 0;
+    for ( size_t iMesh = 0; iMesh < meshCount; ++iMesh )
+    {
+        if ( meshIndexRemap[ iMesh ] == iMesh )
+        {
+            if ( compactedMeshCount != iMesh )
+            {
+                scene->m_Meshes[ compactedMeshCount ] = std::move( scene->m_Meshes[ iMesh ] );
+            }
+            compactedMeshIndices[ iMesh ] = compactedMeshCount++;
+        }
+        else
+        {
+            compactedMeshIndices[ iMesh ] = compactedMeshIndices[ meshIndexRemap[ iMesh ] ];
+        }
+    }
+    scene->m_Meshes.resize( compactedMeshCount );
+
+    for ( SMeshInstance& instance : scene->m_MeshInstances )
+    {
+        instance.m_MeshIndex = compactedMeshIndices[ instance.m_MeshIndex ];
+    }
+
+    LOG_STRING_FORMAT( "%u duplicated meshes replaced by instances (%u of them placed differently), %.2f MB of geometry saved.\n", duplicatedMeshCount, transformedDuplicateCount
+        , savedSize / ( 1024.f * 1024.f ) );
+}
+
+// Merges textures loaded from identical files, whatever path they were referenced through, and remaps the material texture indices.
+// Only textures appended by the current load are removed, the older ones already own GPU textures and may be shared by the new materials.
+static void DeduplicateTextures( CScene* scene, size_t textureIndexBase )
+{
+    PROFILE_SCOPE( "Deduplicate textures" );
+
+    const size_t textureCount = scene->m_Textures.size();
+    std::vector<bool> isColorTexture( textureCount, false );
+    for ( const SMaterial& material : scene->m_Materials )
+    {
+        if ( material.m_AlbedoTextureIndex != INDEX_NONE )
+        {
+            isColorTexture[ material.m_AlbedoTextureIndex ] = true;
+        }
+    }
+
+    std::unordered_multimap<uint64_t, uint32_t> hashToTextureIndexMap;
+    std::vector<uint32_t> textureIndexRemap( textureCount );
+    uint32_t duplicatedTextureCount = 0;
+    uint64_t savedSize = 0;
+    for ( size_t iTexture = 0; iTexture < textureCount; ++iTexture )
+    {
+        textureIndexRemap[ iTexture ] = (uint32_t)iTexture;
+        const CTexture& texture = scene->m_Textures[ iTexture ];
+        if ( !texture.IsValid() || texture.m_SourceHash == 0 )
+        {
+            continue;
+        }
+
+        if ( iTexture >= textureIndexBase )
+        {
+            auto range = hashToTextureIndexMap.equal_range( texture.m_SourceHash );
+            for ( auto it = range.first; it != range.second; ++it )
+            {
+                const CTexture& canonicalTexture = scene->m_Textures[ it->second ];
+                if ( canonicalTexture.m_Width != texture.m_Width || canonicalTexture.m_Height != texture.m_Height )
+                {
+                    continue;
+                }
+                // Textures of older loads may have been block compressed already, an opacity only BC4 texture cannot serve as albedo
+                if ( canonicalTexture.m_PixelFormat == ETexturePixelFormat::BC4_Unorm && isColorTexture[ iTexture ] )
+                {
+                    continue;
+                }
+                if ( canonicalTexture.m_PixelFormat == texture.m_PixelFormat && canonicalTexture.m_PixelData != texture.m_PixelData )
+                {
+                    continue;
+                }
+                textureIndexRemap[ iTexture ] = it->second;
+                break;
+            }
+        }
+
+        if ( textureIndexRemap[ iTexture ] == iTexture )
+        {
+            hashToTextureIndexMap.insert( { texture.m_SourceHash, (uint32_t)iTexture } );
+        }
+        else
+        {
+            ++duplicatedTextureCount;
+            savedSize += texture.m_PixelData.size();
+        }
+    }
+
+    if ( duplicatedTextureCount == 0 )
+    {
+        return;
+    }
+
+    // Compact the texture array, canonical textures always precede their duplicates so they are moved before being referenced
+    std::vector<uint32_t> compactedTextureIndices( textureCount );
+    uint32_t compactedTextureCount = 0;
+    for ( size_t iTexture = 0; iTexture < textureCount; ++iTexture )
+    {
+        if ( textureIndexRemap[ iTexture ] == iTexture )
+        {
+            if ( compactedTextureCount != iTexture )
+            {
+                scene->m_Textures[ compactedTextureCount ] = std::move( scene->m_Textures[ iTexture ] );
+            }
+            compactedTextureIndices[ iTexture ] = compactedTextureCount++;
+        }
+        else
+        {
+            compactedTextureIndices[ iTexture ] = compactedTextureIndices[ textureIndexRemap[ iTexture ] ];
+        }
+    }
+    scene->m_Textures.resize( compactedTextureCount );
+
+    for ( SMaterial& material : scene->m_Materials )
+    {
+        if ( material.m_AlbedoTextureIndex != INDEX_NONE )
+        {
+            material.m_AlbedoTextureIndex = (int32_t)compactedTextureIndices[ material.m_AlbedoTextureIndex ];
+        }
+        if ( material.m_OpacityTextureIndex != INDEX_NONE )
+        {
+            material.m_OpacityTextureIndex = (int32_t)compactedTextureIndices[ material.m_OpacityTextureIndex ];
+        }
+    }
+
+    LOG_STRING_FORMAT( "%u duplicated textures merged, %.2f MB of texel data saved.\n", duplicatedTextureCount, savedSize / ( 1024.f * 1024.f ) );
+}
+
+// Block compresses the textures appended by the current load, the format of each texture depends on how materials use it
+static void CompressTextures( CScene* scene, size_t textureIndexBase )
+{
+    PROFILE_SCOPE( "Compress textures" );
+
+    const size_t textureCount = scene->m_Textures.size() - textureIndexBase;
+    std::vector<bool> isColorTexture( textureCount, false );
+    for ( const SMaterial& material : scene->m_Materials )
+    {
+        if ( material.m_AlbedoTextureIndex >= (int32_t)textureIndexBase )
+        {
+            isColorTexture[ material.m_AlbedoTextureIndex - textureIndexBase ] = true;
+        }
+    }
+
+    std::vector<uint32_t> textureIndices;
+    for ( size_t iTexture = 0; iTexture < textureCount; ++iTexture )
+    {
+        const CTexture& texture = scene->m_Textures[ textureIndexBase + iTexture ];
+        if ( texture.IsValid() && CanCompressTexture( texture ) )
+        {
+            textureIndices.push_back( (uint32_t)( textureIndexBase + iTexture ) );
+        }
+    }
+
+    Timer timer;
+    timer.Start();
+
+    std::atomic<uint64_t> uncompressedSize = 0;
+    std::atomic<uint64_t> compressedSize = 0;
+    const uint32_t workerCount = GetParallelForWorkerCount( (uint32_t)textureIndices.size() );
+    ParallelFor( (uint32_t)textureIndices.size(), [&]( uint32_t, uint32_t index )
+    {
+        // Textures not referenced as albedo are only read as opacity
+        const uint32_t textureIndex = textureIndices[ index ];
+        CTexture& texture = scene->m_Textures[ textureIndex ];
+        const ETexturePixelFormat format = SelectCompressedPixelFormat( texture, !isColorTexture[ textureIndex - textureIndexBase ] );
+        const size_t originalSize = texture.m_PixelData.size();
+        const STextureCacheKey cacheKey = { texture.m_SourceHash, texture.m_CodecBackend, format, texture.m_MipLevelCount > 1 };
+        if ( TextureCache::Load( cacheKey, &texture ) )
+        {
+            uncompressedSize += originalSize;
+            compressedSize += texture.m_PixelData.size();
+        }
+        else if ( CompressTexture( &texture, format, workerCount > 1 ? 1 : 0 ) )
+        {
+            TextureCache::Store( cacheKey, texture );
+            uncompressedSize += originalSize;
+            compressedSize += texture.m_PixelData.size();
+        }
+    } );
+
+    const float elapsedSeconds = std::max( timer.GetElapsedSecondsFloat().count(), 1e-6f );
+    LOG_STRING_FORMAT( "%u of %u textures block compressed in %.3f s (%.2f MB/s), %.2f MB -> %.2f MB.\n", (uint32_t)textureIndices.size(), (uint32_t)textureCount, elapsedSeconds,
+        uncompressedSize / ( 1024.f * 1024.f ) / elapsedSeconds, uncompressedSize / ( 1024.f * 1024.f ), compressedSize / ( 1024.f * 1024.f ) );
+}
+
+template <typename T>
+static uint64_t GetVectorBytes( const std::vector<T>& vector )
+{
+    return (uint64_t)vector.size() * sizeof( T );
+}
+
+// Sets the CPU side of the steady state categories from the scene, the GPU side is set when the buffers are created
+static void AccountSceneCPUMemory( CScene* scene )
+{
+    uint64_t vertexBytes = 0;
+    uint64_t indexBytes = 0;
+    uint64_t materialIdBytes = 0;
+    uint64_t BLASNodeBytes = 0;
+    for ( const Mesh& mesh : scene->m_Meshes )
+    {
+        vertexBytes += GetVectorBytes( mesh.GetVertices() );
+        indexBytes += GetVectorBytes( mesh.GetIndices() );
+        materialIdBytes += GetVectorBytes( mesh.GetMaterialIds() );
+        BLASNodeBytes += (uint64_t)mesh.GetBVHNodeCount() * sizeof( BVHAccel::BVHNode );
+    }
+
+    uint64_t textureBytes = 0;
+    for ( const CTexture& texture : scene->m_Textures )
+    {
+        textureBytes += GetVectorBytes( texture.m_PixelData );
+    }
+
+    CMemoryAccounting& accounting = scene->m_MemoryAccounting;
+    accounting.Set( EMemoryCategory::MeshVertices, EMemoryLocation::CPU, vertexBytes );
+    accounting.Set( EMemoryCategory::MeshIndices, EMemoryLocation::CPU, indexBytes );
+    accounting.Set( EMemoryCategory::MaterialIds, EMemoryLocation::CPU, materialIdBytes );
+    accounting.Set( EMemoryCategory::BLASNodes, EMemoryLocation::CPU, BLASNodeBytes );
+    accounting.Set( EMemoryCategory::TLAS, EMemoryLocation::CPU, GetVectorBytes( scene->m_TLAS ) );
+    accounting.Set( EMemoryCategory::Instances, EMemoryLocation::CPU, GetVectorBytes( scene->m_MeshInstances ) + GetVectorBytes( scene->m_InstanceTransforms )
+        + GetVectorBytes( scene->m_OriginalInstanceIndices ) + GetVectorBytes( scene->m_ReorderedInstanceIndices ) + GetVectorBytes( scene->m_MeshFlags ) );
+    accounting.Set( EMemoryCategory::Materials, EMemoryLocation::CPU, GetVectorBytes( scene->m_Materials ) );
+    accounting.Set( EMemoryCategory::Textures, EMemoryLocation::CPU, textureBytes );
+    accounting.Set( EMemoryCategory::Lights, EMemoryLocation::CPU, GetVectorBytes( scene->m_MeshLights ) + GetVectorBytes( scene->m_PunctualLights )
+        + GetVectorBytes( scene->m_TriangleAliasTable ) + GetVectorBytes( scene->m_LightBVH.m_Nodes ) + GetVectorBytes( scene->m_LightBVH.m_BitTrails ) );
+}
+
 bool CScene::LoadFromFile( const std::filesystem::path& filepath )
 {
     if ( !filepath.has_filename() )
         return false;
 
+    CProfileSession profileSession( "Scene load", CommandLineArgs::Singleton()->GetLoadTraceFilename() );
+    PROFILE_SCOPE( "Load scene" );
+
     const size_t meshIndexBase = m_Meshes.size();
     const size_t textureIndexBase = m_Textures.size();
 
+    AccountSceneCPUMemory( this );
+    m_MemoryAccounting.ResetPeaks();
+
     {
+        PROFILE_SCOPE( "Parse scene file" );
+
         const std::filesystem::path extension = filepath.extension();
         bool isWavefrontOBJFile = true;
         if ( extension == ".xml" || extension == ".XML" )
@@ -159,12 +694,25 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
         }
     }
 
+    // Duplicates are still in memory at this point
+    AccountSceneCPUMemory( this );
+
+    DeduplicateMeshes( this, meshIndexBase );
+    DeduplicateTextures( this, textureIndexBase );
+    AccountSceneCPUMemory( this );
+
     {
         std::vector<uint32_t> reorderedTriangleIndices;
         for ( size_t iMesh = meshIndexBase; iMesh < m_Meshes.size(); ++iMesh )
         {
             Mesh& mesh = m_Meshes[ iMesh ];
-            mesh.BuildBVH( &reorderedTriangleIndices );
+            {
+                // The build copies the indices, and the triangle indices and material ids are reordered through copies
+                CScopedMemoryAllocation BVHBuildCopies( &m_MemoryAccounting, EMemoryCategory::LoadTimeCopies, EMemoryLocation::CPU
+                    , (uint64_t)mesh.GetIndexCount() * sizeof( uint32_t ) + (uint64_t)mesh.GetTriangleCount() * sizeof( uint32_t ) * 2 );
+                mesh.BuildBVH( &reorderedTriangleIndices );
+                m_MemoryAccounting.Allocate( EMemoryCategory::BLASNodes, EMemoryLocation::CPU, (uint64_t)mesh.GetBVHNodeCount() * sizeof( BVHAccel::BVHNode ) );
+            }
 
             uint32_t BVHMaxDepth = mesh.GetBVHMaxDepth();
             LOG_STRING_FORMAT( "BLAS created from mesh %s. Node count:%d, depth:%d\n", mesh.GetName().c_str(), mesh.GetBVHNodeCount(), BVHMaxDepth );
@@ -173,6 +721,8 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
 
     m_TLAS.clear();
     {
+        PROFILE_SCOPE( "Build TLAS" );
+
         assert( m_MeshInstances.size() == m_InstanceTransforms.size() );
         const uint32_t instanceCount = (uint32_t)m_MeshInstances.size();
         std::vector<BVHAccel::SInstance> BLASInstances;
@@ -190,10 +740,13 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
 
         std::vector<uint32_t> instanceDepths;
         instanceDepths.resize( instanceCount );
+        CScopedMemoryAllocation TLASBuildCopies( &m_MemoryAccounting, EMemoryCategory::LoadTimeCopies, EMemoryLocation::CPU
+            , GetVectorBytes( BLASInstances ) + GetVectorBytes( instanceDepths ) );
         m_OriginalInstanceIndices.resize( instanceCount );
         uint32_t BVHMaxDepth = 0;
         uint32_t BVHMaxStackSize = 0;
         BVHAccel::BuildTLAS( BLASInstances.data(), m_OriginalInstanceIndices.data(), instanceCount, &m_TLAS, &BVHMaxDepth, &BVHMaxStackSize, instanceDepths.data() );
+        AccountSceneCPUMemory( this );
         LOG_STRING_FORMAT( "TLAS created. Node count:%d, depth:%d\n", m_TLAS.size(), BVHMaxDepth );
 
         uint32_t maxStackSize = 0;
@@ -207,11 +760,35 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
         LOG_STRING_FORMAT( "BVH traversal stack size requirement is %d\n", maxStackSize );
 
         m_ReorderedInstanceIndices.resize( m_OriginalInstanceIndices.size() );
-        for ( uint32_t originalInstanceIndex : m_OriginalInstanceIndices )
+        for ( uint32_t reorderedInstanceIndex = 0; reorderedInstanceIndex < instanceCount; ++reorderedInstanceIndex )
+        {
+            m_ReorderedInstanceIndices[ m_OriginalInstanceIndices[ reorderedInstanceIndex ] ] = reorderedInstanceIndex;
+        }
+    }
+
+    // Report the geometry memory saved by instancing, compared to giving every instance its own copy of the mesh
+    {
+        auto GetMeshGeometrySize = []( const Mesh& mesh )
+        {
+            return (uint64_t)mesh.GetVertexCount() * sizeof( GPU::Vertex ) + (uint64_t)mesh.GetIndexCount() * sizeof( uint32_t )
+                + (uint64_t)mesh.GetMaterialIds().size() * sizeof( uint32_t ) + (uint64_t)mesh.GetBVHNodeCount() * sizeof( GPU::BVHNode );
+        };
+
+        uint64_t instancedSize = 0;
+        for ( const Mesh& mesh : m_Meshes )
         {
-            const uint32_t reorderedInstanceIndex = (uint32_t)std::distance( m_OriginalInstanceIndices.begin(), std::find( m_OriginalInstanceIndices.begin(), m_OriginalInstanceIndices.end(), originalInstanceIndex ) );
-            m_ReorderedInstanceIndices[ originalInstanceIndex ] = reorderedInstanceIndex;
+            instancedSize += GetMeshGeometrySize( mesh );
         }
+        uint64_t flattenedSize = 0;
+        for ( const SMeshInstance& instance : m_MeshInstances )
+        {
+            flattenedSize += GetMeshGeometrySize( m_Meshes[ instance.m_MeshIndex ] );
+        }
+
+        const float bytesToMB = 1.f / ( 1024.f * 1024.f );
+        LOG_STRING_FORMAT( "Geometry memory: %u meshes, %u instances, %.2f MB instanced, %.2f MB if flattened, %.2f MB saved.\n"
+            , (uint32_t)m_Meshes.size(), (uint32_t)m_MeshInstances.size(), instancedSize * bytesToMB, flattenedSize * bytesToMB
+            , flattenedSize > instancedSize ? ( flattenedSize - instancedSize ) * bytesToMB : 0.f );
     }
 
     // Update mesh flags
@@ -230,6 +807,31 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
 
     LOG_STRING_FORMAT( "Total vertex count %d, total index count %d, total BVH node count %d\n", totalVertexCount, totalIndexCount, totalBVHNodeCount );
 
+    // Byte sizes are passed to the GPU buffers as 32-bit integers, and the counts above wrap around before that
+    {
+        uint64_t vertexCount = 0;
+        uint64_t indexCount = 0;
+        uint64_t BVHNodeCount = m_TLAS.size();
+        for ( const Mesh& mesh : m_Meshes )
+        {
+            vertexCount += mesh.GetVertexCount();
+            indexCount += mesh.GetIndexCount();
+            BVHNodeCount += mesh.GetBVHNodeCount();
+        }
+
+        bool isWithinSizeLimits = m_MemoryAccounting.CheckBufferSize( "Vertex buffer", vertexCount * sizeof( GPU::Vertex ) );
+        isWithinSizeLimits &= m_MemoryAccounting.CheckBufferSize( "Triangle buffer", indexCount * sizeof( uint32_t ) );
+        isWithinSizeLimits &= m_MemoryAccounting.CheckBufferSize( "BVH node buffer", BVHNodeCount * sizeof( GPU::BVHNode ) );
+        isWithinSizeLimits &= m_MemoryAccounting.CheckBufferSize( "Material id buffer", indexCount / 3 * sizeof( uint32_t ) );
+        isWithinSizeLimits &= m_MemoryAccounting.CheckBufferSize( "Instance transform buffer", (uint64_t)m_MeshInstances.size() * 2 * sizeof( DirectX::XMFLOAT4X3 ) );
+        isWithinSizeLimits &= m_MemoryAccounting.CheckBufferSize( "Material buffer", (uint64_t)m_Materials.size() * sizeof( GPU::Material ) );
+        if ( !isWithinSizeLimits )
+        {
+            m_MemoryAccounting.LogReport();
+            return false;
+        }
+    }
+
     if ( CommandLineArgs::Singleton()->GetOutputBVHToFile() )
     {
         std::filesystem::path baseDirectory = filepath;
@@ -270,15 +872,17 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
         return false;
     }
 
+    std::vector<uint32_t> instanceLightIndices;
     {
+        PROFILE_SCOPE( "Pack geometry buffers" );
+
         std::vector<GPU::Vertex> vertices;
-        vertices.resize( totalVertexCount );
-        GPU::Vertex* dest = vertices.data();
-        for ( auto& mesh : m_Meshes )
-        {
-            memcpy( dest, mesh.GetVertices().data(), sizeof( GPU::Vertex ) * mesh.GetVertexCount() );
-            dest += mesh.GetVertexCount();
-        }
+        std::vector<uint32_t> triangles;
+        std::vector<uint32_t> materialIds;
+        std::vector<GPU::BVHNode> BVHNodes;
+        BuildGeometryData( &vertices, &triangles, &materialIds, &BVHNodes );
+        CScopedMemoryAllocation packedGeometry( &m_MemoryAccounting, EMemoryCategory::LoadTimeCopies, EMemoryLocation::CPU
+            , GetVectorBytes( vertices ) + GetVectorBytes( triangles ) + GetVectorBytes( materialIds ) + GetVectorBytes( BVHNodes ) );
 
         m_VerticesBuffer.Reset( GPUBuffer::CreateStructured(
               sizeof( GPU::Vertex ) * totalVertexCount
@@ -297,30 +901,13 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
             LOG_STRING( "Failed to create vertices buffer.\n" );
             return false;
         }
-    }
-
-    {
-        std::vector<uint32_t> indices;
-        indices.resize( totalIndexCount );
-        uint32_t* dest = indices.data();
-        uint32_t vertexOffset = 0;
-        for ( auto& mesh : m_Meshes )
-        {
-            auto& meshIndices = mesh.GetIndices();
-            for ( auto index : meshIndices )
-            {
-                ( *dest ) = index + vertexOffset;
-                ++dest;
-            }
-            vertexOffset += mesh.GetVertexCount();
-        }
 
         m_TrianglesBuffer.Reset( GPUBuffer::CreateStructured(
               sizeof( uint32_t ) * totalIndexCount
             , sizeof( uint32_t )
             , EGPUBufferUsage::Default
             , EGPUBufferBindFlag_ShaderResource
-            , indices.data()
+            , triangles.data()
             , D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE ) );
 
         if ( m_TrianglesBuffer )
@@ -332,44 +919,6 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
             LOG_STRING( "Failed to create triangles buffer.\n" );
             return false;
         }
-    }
-
-    {
-        std::vector<GPU::BVHNode> BVHNodes;
-        BVHNodes.resize( totalBVHNodeCount );
-
-        std::vector<uint32_t> BLASNodeIndexOffsets;
-        BLASNodeIndexOffsets.reserve( m_Meshes.size() );
-
-        GPU::BVHNode* dest = BVHNodes.data() + m_TLAS.size();
-        uint32_t triangleIndexOffset = 0;
-        uint32_t nodeIndexOffset = (uint32_t)m_TLAS.size();
-        for ( auto& mesh : m_Meshes )
-        {
-            BVHAccel::PackBVH( mesh.GetBVHNodes(), mesh.GetBVHNodeCount(), true, dest, nodeIndexOffset, triangleIndexOffset );
-            dest += mesh.GetBVHNodeCount();
-            BLASNodeIndexOffsets.push_back( nodeIndexOffset );
-            triangleIndexOffset += mesh.GetTriangleCount();;
-            nodeIndexOffset += mesh.GetBVHNodeCount();
-        }
-
-        // Make the TLAS point to the BLASes
-        std::vector<BVHAccel::BVHNode> TLAS = m_TLAS; // we make a copy here so the original TLAS could be used for CPU ray trace
-        for ( auto& node : TLAS )
-        {
-            if ( node.m_PrimCount > 0 )
-            {
-                uint32_t primIndex = node.m_PrimIndex;
-                assert( node.m_PrimCount == 1 );
-                uint32_t originalInstanceIndex = m_OriginalInstanceIndices[ primIndex ];
-                uint32_t meshIndex = m_MeshInstances[ originalInstanceIndex ].m_MeshIndex;
-                node.m_ChildIndex = BLASNodeIndexOffsets[ meshIndex ];
-                node.m_InstanceIndex = primIndex;
-            }
-        }
-
-        dest = BVHNodes.data();
-        BVHAccel::PackBVH( TLAS.data(), (uint32_t)TLAS.size(), false, dest );
 
         m_BVHNodesBuffer.Reset( GPUBuffer::CreateStructured(
               sizeof( GPU::BVHNode ) * totalBVHNodeCount
@@ -388,18 +937,6 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
             LOG_STRING( "Failed to create BVH nodes buffer.\n" );
             return false;
         }
-    }
-    
-    {
-        std::vector<uint32_t> materialIds;
-        materialIds.resize( totalIndexCount / 3 );
-        uint32_t* dest = materialIds.data();
-        for ( auto& mesh : m_Meshes )
-        {
-            assert( mesh.GetMaterialIds().size() == mesh.GetIndexCount() / 3 );
-            memcpy( dest, mesh.GetMaterialIds().data(), mesh.GetMaterialIds().size() * sizeof( uint32_t ) );
-            dest += mesh.GetMaterialIds().size();
-        }
 
         m_MaterialIdsBuffer.Reset( GPUBuffer::CreateStructured(
               sizeof( uint32_t ) * (uint32_t)materialIds.size()
@@ -418,17 +955,33 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
             LOG_STRING( "Failed to create material id buffer.\n" );
             return false;
         }
+
+        // Mesh BVH nodes follow the TLAS in the node buffer
+        m_MemoryAccounting.Set( EMemoryCategory::MeshVertices, EMemoryLocation::GPU, GetVectorBytes( vertices ) );
+        m_MemoryAccounting.Set( EMemoryCategory::MeshIndices, EMemoryLocation::GPU, GetVectorBytes( triangles ) );
+        m_MemoryAccounting.Set( EMemoryCategory::MaterialIds, EMemoryLocation::GPU, GetVectorBytes( materialIds ) );
+        m_MemoryAccounting.Set( EMemoryCategory::TLAS, EMemoryLocation::GPU, (uint64_t)m_TLAS.size() * sizeof( GPU::BVHNode ) );
+        m_MemoryAccounting.Set( EMemoryCategory::BLASNodes, EMemoryLocation::GPU, GetVectorBytes( BVHNodes ) - (uint64_t)m_TLAS.size() * sizeof( GPU::BVHNode ) );
+        m_MemoryAccounting.Allocate( EMemoryCategory::UploadStaging, EMemoryLocation::GPU
+            , GetVectorBytes( vertices ) + GetVectorBytes( triangles ) + GetVectorBytes( materialIds ) + GetVectorBytes( BVHNodes ) );
     }
 
     {
+        PROFILE_SCOPE( "Pack instance buffers" );
+
         const uint32_t instanceCount = (uint32_t)m_MeshInstances.size();
+        std::vector<DirectX::XMFLOAT4X3> transforms;
+        std::vector<uint32_t> instanceMaterialOverrides;
+        BuildInstanceData( &transforms, &instanceLightIndices, &instanceMaterialOverrides );
+
+        // The shaders take the transforms and then their inverses, both transposed
         std::vector<DirectX::XMFLOAT4X3> instanceTransforms;
         instanceTransforms.resize( instanceCount * 2 );
 
         DirectX::XMFLOAT4X3* dest = instanceTransforms.data();
         for ( uint32_t i = 0; i < instanceCount; ++i )
         {
-            const DirectX::XMFLOAT4X3& transform = m_InstanceTransforms[ m_OriginalInstanceIndices[ i ] ];
+            const DirectX::XMFLOAT4X3& transform = transforms[ i ];
             *dest = DirectX::XMFLOAT4X3( transform._11, transform._21, transform._31, transform._41, transform._12, transform._22, transform._32, transform._42, transform._13, transform._23, transform._33, transform._43 );
             ++dest;
         }
@@ -436,8 +989,7 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
         DirectX::XMFLOAT4X3 rowMajorMatrix;
         for ( uint32_t i = 0; i < instanceCount; ++i )
         {
-            const DirectX::XMFLOAT4X3& transform = m_InstanceTransforms[ m_OriginalInstanceIndices[ i ] ];
-            DirectX::XMMATRIX vMatrix = DirectX::XMLoadFloat4x3( &transform );
+            DirectX::XMMATRIX vMatrix = DirectX::XMLoadFloat4x3( &transforms[ i ] );
             DirectX::XMVECTOR vDet;
             vMatrix = DirectX::XMMatrixInverse( &vDet, vMatrix );
             DirectX::XMStoreFloat4x3( &rowMajorMatrix, vMatrix );
@@ -445,6 +997,9 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
             ++dest;
         }
 
+        CScopedMemoryAllocation packedInstances( &m_MemoryAccounting, EMemoryCategory::LoadTimeCopies, EMemoryLocation::CPU
+            , GetVectorBytes( transforms ) + GetVectorBytes( instanceLightIndices ) + GetVectorBytes( instanceMaterialOverrides ) + GetVectorBytes( instanceTransforms ) );
+
         m_InstanceTransformsBuffer.Reset( GPUBuffer::CreateStructured(
               sizeof( DirectX::XMFLOAT4X3 ) * (uint32_t)instanceTransforms.size()
             , sizeof( DirectX::XMFLOAT4X3 )
@@ -462,95 +1017,178 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
             LOG_STRING( "Failed to create instance transform buffer.\n" );
             return false;
         }
-    }
 
-    {
-        const uint32_t instanceCount = (uint32_t)m_MeshInstances.size();
-        std::vector<uint32_t> instanceLightIndices;
-        instanceLightIndices.resize( instanceCount, LIGHT_INDEX_INVALID );
-
-        uint32_t lightIndex = 0;
-        for ( auto& light : m_MeshLights )
-        {
-            const uint32_t originalInstanceIndex = light.m_InstanceIndex;
-            const uint32_t reorderedInstanceIndex = m_ReorderedInstanceIndices[ originalInstanceIndex ];
-            instanceLightIndices[ reorderedInstanceIndex ] = lightIndex;
-            ++lightIndex;
-        }
-
-        m_InstanceLightIndicesBuffer.Reset( GPUBuffer::Create(
+        m_InstanceMaterialOverrideBuffer.Reset( GPUBuffer::Create(
               sizeof( uint32_t ) * instanceCount
             , sizeof( uint32_t )
             , DXGI_FORMAT_R32_UINT
             , EGPUBufferUsage::Default
             , EGPUBufferBindFlag_ShaderResource
-            , instanceLightIndices.data()
+            , instanceMaterialOverrides.data()
             , D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE ) );
 
-        if ( m_InstanceLightIndicesBuffer )
+        if ( m_InstanceMaterialOverrideBuffer )
         {
-            LOG_STRING_FORMAT( "Instance light indices buffer created, size %d\n", sizeof( uint32_t ) * instanceCount );
+            LOG_STRING_FORMAT( "Instance material override buffer created, size %d\n", sizeof( uint32_t ) * instanceCount );
         }
-        else 
+        else
         {
-            LOG_STRING( "Failed to create instance light indices buffer.\n" );
+            LOG_STRING( "Failed to create instance material override buffer.\n" );
             return false;
         }
+
+        m_MemoryAccounting.Allocate( EMemoryCategory::UploadStaging, EMemoryLocation::GPU, GetVectorBytes( instanceTransforms ) + GetVectorBytes( instanceMaterialOverrides ) );
     }
 
-    // Instance flags buffer
     {
+        PROFILE_SCOPE( "Build mesh light tables" );
+
         const uint32_t instanceCount = (uint32_t)m_MeshInstances.size();
-        m_InstanceFlagsBuffer.Reset( GPUBuffer::Create(
+
+        // Triangles of a mesh light are selected proportionally to their world space area, the total area is also used to estimate
+        // the power of the light for light selection
+        m_TriangleAliasTable.clear();
+        std::vector<float> triangleAreas;
+        std::vector<XMVECTOR> triangleNormals;
+        for ( auto& light : m_MeshLights )
+        {
+            const Mesh& mesh = m_Meshes[ m_MeshInstances[ light.m_InstanceIndex ].m_MeshIndex ];
+            const XMMATRIX transform = XMLoadFloat4x3( &m_InstanceTransforms[ light.m_InstanceIndex ] );
+            const std::vector<GPU::Vertex>& vertices = mesh.GetVertices();
+            const std::vector<uint32_t>& indices = mesh.GetIndices();
+            const uint32_t triangleCount = mesh.GetTriangleCount();
+            triangleAreas.resize( triangleCount );
+            triangleNormals.resize( triangleCount );
+            float surfaceArea = 0.f;
+            XMVECTOR boundsMin = g_XMFltMax;
+            XMVECTOR boundsMax = -g_XMFltMax;
+            XMVECTOR weightedNormal = XMVectorZero();
+            for ( uint32_t i = 0; i < triangleCount; ++i )
+            {
+                const XMVECTOR v0 = XMVector3TransformCoord( XMLoadFloat3( &vertices[ indices[ i * 3 ] ].position ), transform );
+                const XMVECTOR v1 = XMVector3TransformCoord( XMLoadFloat3( &vertices[ indices[ i * 3 + 1 ] ].position ), transform );
+                const XMVECTOR v2 = XMVector3TransformCoord( XMLoadFloat3( &vertices[ indices[ i * 3 + 2 ] ].position ), transform );
+                triangleAreas[ i ] = XMVectorGetX( XMVector3Length( XMVector3Cross( v1 - v0, v2 - v0 ) ) ) * .5f;
+                surfaceArea += triangleAreas[ i ];
+                boundsMin = XMVectorMin( boundsMin, XMVectorMin( v0, XMVectorMin( v1, v2 ) ) );
+                boundsMax = XMVectorMax( boundsMax, XMVectorMax( v0, XMVectorMax( v1, v2 ) ) );
+
+                // Computed the same way as the emitter normal in the shaders
+                const XMVECTOR lv0 = XMLoadFloat3( &vertices[ indices[ i * 3 ] ].position );
+                const XMVECTOR lv1 = XMLoadFloat3( &vertices[ indices[ i * 3 + 1 ] ].position );
+                const XMVECTOR lv2 = XMLoadFloat3( &vertices[ indices[ i * 3 + 2 ] ].position );
+                triangleNormals[ i ] = XMVector3Normalize( XMVector3TransformNormal( XMVector3Normalize( XMVector3Cross( lv2 - lv0, lv1 - lv0 ) ), transform ) );
+                weightedNormal += triangleNormals[ i ] * triangleAreas[ i ];
+            }
+            light.m_SurfaceArea = surfaceArea;
+
+            SLightBounds& bounds = light.m_Bounds;
+            XMStoreFloat3( &bounds.m_BoundsMin, boundsMin );
+            XMStoreFloat3( &bounds.m_BoundsMax, boundsMax );
+            bounds.m_CosThetaE = 0.f;
+            const float weightedNormalLength = XMVectorGetX( XMVector3Length( weightedNormal ) );
+            if ( weightedNormalLength > 1e-6f * surfaceArea )
+            {
+                const XMVECTOR axis = weightedNormal / weightedNormalLength;
+                XMStoreFloat3( &bounds.m_Axis, axis );
+                bounds.m_CosThetaO = 1.f;
+                for ( uint32_t i = 0; i < triangleCount; ++i )
+                {
+                    if ( triangleAreas[ i ] > 0.f )
+                    {
+                        bounds.m_CosThetaO = std::min( bounds.m_CosThetaO, XMVectorGetX( XMVector3Dot( axis, triangleNormals[ i ] ) ) );
+                    }
+                }
+                bounds.m_CosThetaO = std::max( bounds.m_CosThetaO, -1.f );
+            }
+            else
+            {
+                // Normals cancel out, e.g. a closed mesh
+                bounds.m_Axis = XMFLOAT3( 0.f, 0.f, 1.f );
+                bounds.m_CosThetaO = -1.f;
+            }
+
+            light.m_TriangleAliasTableOffset = (uint32_t)m_TriangleAliasTable.size();
+            if ( !BuildAliasTable( triangleAreas.data(), triangleCount, &m_TriangleAliasTable ) )
+            {
+                // Every triangle is degenerate, keep the table valid with uniform selection
+                std::fill( triangleAreas.begin(), triangleAreas.end(), 1.f );
+                BuildAliasTable( triangleAreas.data(), triangleCount, &m_TriangleAliasTable );
+            }
+        }
+
+        if ( !m_TriangleAliasTable.empty() )
+        {
+            m_TriangleAliasTableBuffer.Reset( GPUBuffer::CreateStructured(
+                  sizeof( GPU::SAliasTableEntry ) * (uint32_t)m_TriangleAliasTable.size()
+                , sizeof( GPU::SAliasTableEntry )
+                , EGPUBufferUsage::Default
+                , EGPUBufferBindFlag_ShaderResource
+                , m_TriangleAliasTable.data()
+                , D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE ) );
+
+            if ( m_TriangleAliasTableBuffer )
+            {
+                LOG_STRING_FORMAT( "Triangle alias table buffer created, size %d\n", sizeof( GPU::SAliasTableEntry ) * m_TriangleAliasTable.size() );
+            }
+            else
+            {
+                LOG_STRING( "Failed to create triangle alias table buffer.\n" );
+                return false;
+            }
+        }
+        else
+        {
+            m_TriangleAliasTableBuffer.Reset();
+        }
+
+        m_InstanceLightIndicesBuffer.Reset( GPUBuffer::Create(
               sizeof( uint32_t ) * instanceCount
             , sizeof( uint32_t )
             , DXGI_FORMAT_R32_UINT
             , EGPUBufferUsage::Default
-            , EGPUBufferBindFlag_ShaderResource ) );
+            , EGPUBufferBindFlag_ShaderResource
+            , instanceLightIndices.data()
+            , D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE ) );
 
-        if ( m_InstanceFlagsBuffer )
+        if ( m_InstanceLightIndicesBuffer )
         {
-            LOG_STRING_FORMAT( "Instance flags buffer created, size %d\n", sizeof( uint32_t ) * instanceCount );
+            LOG_STRING_FORMAT( "Instance light indices buffer created, size %d\n", sizeof( uint32_t ) * instanceCount );
         }
         else 
         {
-            LOG_STRING( "Failed to create instance flags buffer.\n" );
+            LOG_STRING( "Failed to create instance light indices buffer.\n" );
             return false;
         }
-    }
 
-    // Instance material override buffer
-    {
-        const uint32_t instanceCount = (uint32_t)m_MeshInstances.size();
-        std::vector<uint32_t> instanceMaterialOverrides;
-        instanceMaterialOverrides.resize( instanceCount );
-
-        for ( uint32_t i = 0; i < instanceCount; ++i )
-        {
-            const uint32_t originalInstanceIndex = m_OriginalInstanceIndices[ i ];
-            instanceMaterialOverrides[ i ] = m_MeshInstances[ originalInstanceIndex ].m_MaterialIdOverride;
-        }
+        AccountSceneCPUMemory( this );
+        m_MemoryAccounting.Allocate( EMemoryCategory::UploadStaging, EMemoryLocation::GPU, GetVectorBytes( m_TriangleAliasTable ) + GetVectorBytes( instanceLightIndices ) );
+    }
 
-        m_InstanceMaterialOverrideBuffer.Reset( GPUBuffer::Create(
+    // Instance flags buffer
+    {
+        const uint32_t instanceCount = (uint32_t)m_MeshInstances.size();
+        m_InstanceFlagsBuffer.Reset( GPUBuffer::Create(
               sizeof( uint32_t ) * instanceCount
             , sizeof( uint32_t )
             , DXGI_FORMAT_R32_UINT
             , EGPUBufferUsage::Default
-            , EGPUBufferBindFlag_ShaderResource
-            , instanceMaterialOverrides.data()
-            , D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE ) );
+            , EGPUBufferBindFlag_ShaderResource ) );
 
-        if ( m_InstanceMaterialOverrideBuffer )
+        if ( m_InstanceFlagsBuffer )
         {
-            LOG_STRING_FORMAT( "Instance material override buffer created, size %d\n", sizeof( uint32_t ) * instanceCount );
+            LOG_STRING_FORMAT( "Instance flags buffer created, size %d\n", sizeof( uint32_t ) * instanceCount );
         }
-        else
+        else 
         {
-            LOG_STRING( "Failed to create instance material override buffer.\n" );
+            LOG_STRING( "Failed to create instance flags buffer.\n" );
             return false;
         }
+
+        // Transforms and their inverses, light indices, material overrides and flags
+        m_MemoryAccounting.Set( EMemoryCategory::Instances, EMemoryLocation::GPU, (uint64_t)instanceCount * ( sizeof( DirectX::XMFLOAT4X3 ) * 2 + sizeof( uint32_t ) * 3 ) );
     }
-    
+
     m_MaterialsBuffer.Reset( GPUBuffer::CreateStructured(
           uint32_t( sizeof( GPU::Material ) * m_Materials.size() )
         , sizeof( GPU::Material )
@@ -566,6 +1204,7 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
         LOG_STRING( "Failed to create materials buffer.\n" );
         return false;
     }
+    m_MemoryAccounting.Set( EMemoryCategory::Materials, EMemoryLocation::GPU, (uint64_t)m_Materials.size() * sizeof( GPU::Material ) );
 
     m_LightsBuffer.Reset( GPUBuffer::CreateStructured(
           sizeof( GPU::SLight ) * s_MaxLightsCount
@@ -583,28 +1222,88 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
         return false;
     }
 
+    // One more entry than the lights for selecting the light BVH
+    m_LightAliasTableBuffer.Reset( GPUBuffer::CreateStructured(
+          sizeof( GPU::SAliasTableEntry ) * ( s_MaxLightsCount + 1 )
+        , sizeof( GPU::SAliasTableEntry )
+        , EGPUBufferUsage::Default
+        , EGPUBufferBindFlag_ShaderResource ) );
+
+    if ( m_LightAliasTableBuffer )
+    {
+        LOG_STRING_FORMAT( "Light alias table buffer created, size %d\n", sizeof( GPU::SAliasTableEntry ) * ( s_MaxLightsCount + 1 ) );
+    }
+    else 
+    {
+        LOG_STRING( "Failed to create light alias table buffer.\n" );
+        return false;
+    }
+
+    m_LightBVHNodesBuffer.Reset( GPUBuffer::CreateStructured(
+          sizeof( GPU::SLightBVHNode ) * ( s_MaxLightsCount * 2 - 1 )
+        , sizeof( GPU::SLightBVHNode )
+        , EGPUBufferUsage::Default
+        , EGPUBufferBindFlag_ShaderResource ) );
+
+    if ( m_LightBVHNodesBuffer )
+    {
+        LOG_STRING_FORMAT( "Light BVH nodes buffer created, size %d\n", sizeof( GPU::SLightBVHNode ) * ( s_MaxLightsCount * 2 - 1 ) );
+    }
+    else 
+    {
+        LOG_STRING( "Failed to create light BVH nodes buffer.\n" );
+        return false;
+    }
+    m_MemoryAccounting.Set( EMemoryCategory::Lights, EMemoryLocation::GPU, GetVectorBytes( m_TriangleAliasTable ) + sizeof( GPU::SLight ) * s_MaxLightsCount
+        + sizeof( GPU::SAliasTableEntry ) * ( s_MaxLightsCount + 1 ) + sizeof( GPU::SLightBVHNode ) * ( s_MaxLightsCount * 2 - 1 ) );
+
+    if ( CommandLineArgs::Singleton()->GetTextureCompressionEnabled() )
+    {
+        CompressTextures( this, textureIndexBase );
+        AccountSceneCPUMemory( this );
+    }
+
+    TextureCache::Trim();
+    TextureCache::LogStatistics();
+
     // Create new textures
     {
+        PROFILE_SCOPE( "Create GPU textures" );
+
         m_GPUTextures.reserve( m_Textures.size() );
 
         std::vector<D3D12_SUBRESOURCE_DATA> initialData;
-        initialData.resize( 1 );
         for ( size_t textureIndex = textureIndexBase; textureIndex < m_Textures.size(); ++textureIndex )
         {
             CTexture& texture = m_Textures[ textureIndex ];
             CD3D12ResourcePtr<GPUTexture> newGPUTexture;
             if ( texture.IsValid() )
             {
-                D3D12_SUBRESOURCE_DATA& subresource = initialData[ 0 ];
-                subresource.pData = texture.m_PixelData.data();
-                subresource.RowPitch = texture.CalculateRowPitch();
-                subresource.SlicePitch = 0;
+                initialData.resize( texture.m_MipLevelCount );
+                for ( uint32_t mipLevel = 0; mipLevel < texture.m_MipLevelCount; ++mipLevel )
+                {
+                    D3D12_SUBRESOURCE_DATA& subresource = initialData[ mipLevel ];
+                    subresource.pData = texture.m_PixelData.data() + texture.GetMipOffset( mipLevel );
+                    subresource.RowPitch = texture.CalculateRowPitch( mipLevel );
+                    subresource.SlicePitch = subresource.RowPitch * texture.CalculateRowCount( mipLevel );
+                }
 
                 newGPUTexture = GPUTexture::Create( texture.m_Width, texture.m_Height, GetDXGIFormat( texture.m_PixelFormat ),
                     EGPUTextureBindFlag_ShaderResource, initialData, 1U, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE, L"SceneTexture" );
             }
             m_GPUTextures.emplace_back( newGPUTexture );
         }
+
+        uint64_t GPUTextureBytes = 0;
+        for ( size_t textureIndex = 0; textureIndex < m_Textures.size(); ++textureIndex )
+        {
+            if ( m_GPUTextures[ textureIndex ] )
+            {
+                GPUTextureBytes += GetVectorBytes( m_Textures[ textureIndex ].m_PixelData );
+            }
+        }
+        m_MemoryAccounting.Allocate( EMemoryCategory::UploadStaging, EMemoryLocation::GPU, GPUTextureBytes - m_MemoryAccounting.GetBytes( EMemoryCategory::Textures, EMemoryLocation::GPU ) );
+        m_MemoryAccounting.Set( EMemoryCategory::Textures, EMemoryLocation::GPU, GPUTextureBytes );
     }
 
     if ( !RecreateFilmTextures() )
@@ -612,6 +1311,14 @@ bool CScene::LoadFromFile( const std::filesystem::path& filepath )
         return false;
     }
 
+    // Staging memory is reused once the commands of the load have executed, what remains is the steady state
+    m_MemoryAccounting.Set( EMemoryCategory::UploadStaging, EMemoryLocation::GPU, 0 );
+    m_MemoryAccounting.LogReport();
+    if ( !CommandLineArgs::Singleton()->GetMemoryReportFilename().empty() )
+    {
+        m_MemoryAccounting.WriteReportToFile( CommandLineArgs::Singleton()->GetMemoryReportFilename() );
+    }
+
     m_Camera.SetDirty();
 
     m_IsLightBufferRead = true;
@@ -628,6 +1335,7 @@ void CScene::Reset()
     m_ResolutionWidth = CommandLineArgs::Singleton()->ResolutionX();
     m_ResolutionHeight = CommandLineArgs::Singleton()->ResolutionY();
     m_MaxBounceCount = 2;
+    m_RussianRouletteBounceCount = 3;
     m_FilmSize = XMFLOAT2( 0.05333f, 0.03f );
     m_CameraType = ECameraType::ThinLens;
     m_FoVX = 1.221730f;
@@ -652,9 +1360,15 @@ void CScene::Reset()
     m_ReorderedInstanceIndices.clear();
     m_InstanceTransforms.clear();
     m_Textures.clear();
+    m_LightBVH.m_Nodes.clear();
+    m_LightBVH.m_BitTrails.clear();
+    m_LightBVHBounds.clear();
+    m_LightBVHLightIndices.clear();
+    m_TriangleAliasTable.clear();
 
     m_GPUTextures.clear();
     m_TextureDescriptorTable.ptr = 0;
+    m_MemoryAccounting.Reset();
 
     m_HasValidScene = false;
 }
@@ -669,62 +1383,291 @@ void CScene::RebuildMeshFlagsIfDirty()
     }
 }
 
-void CScene::UpdateLightGPUData()
+void CScene::BuildGeometryData( std::vector<GPU::Vertex>* vertices, std::vector<uint32_t>* triangles, std::vector<uint32_t>* materialIds, std::vector<GPU::BVHNode>* BVHNodes ) const
 {
-    GPUBuffer::SUploadContext context = {};
-    if ( m_LightsBuffer->AllocateUploadContext( &context ) )
+    uint32_t totalVertexCount = 0;
+    uint32_t totalIndexCount = 0;
+    uint32_t totalBVHNodeCount = (uint32_t)m_TLAS.size();
+    for ( auto& mesh : m_Meshes )
     {
-        void* address = context.Map();
-        if ( address )
+        totalVertexCount += mesh.GetVertexCount();
+        totalIndexCount += mesh.GetIndexCount();
+        totalBVHNodeCount += mesh.GetBVHNodeCount();
+    }
+
+    {
+        vertices->resize( totalVertexCount );
+        GPU::Vertex* dest = vertices->data();
+        for ( auto& mesh : m_Meshes )
         {
-            GPU::SLight* GPULight = (GPU::SLight*)address;
+            memcpy( dest, mesh.GetVertices().data(), sizeof( GPU::Vertex ) * mesh.GetVertexCount() );
+            dest += mesh.GetVertexCount();
+        }
+    }
 
-            // todo: cache the offsets somewhere so it does not need to be calculated every time
-            std::vector<uint32_t> meshTriangleOffsets;
-            meshTriangleOffsets.reserve( m_Meshes.size() );
-            uint32_t triangleCount = 0;
-            for ( auto& mesh : m_Meshes )
+    {
+        triangles->resize( totalIndexCount );
+        uint32_t* dest = triangles->data();
+        uint32_t vertexOffset = 0;
+        for ( auto& mesh : m_Meshes )
+        {
+            auto& meshIndices = mesh.GetIndices();
+            for ( auto index : meshIndices )
             {
-                meshTriangleOffsets.emplace_back( triangleCount );
-                triangleCount += mesh.GetTriangleCount();
+                ( *dest ) = index + vertexOffset;
+                ++dest;
             }
-        
-            for ( uint32_t i = 0; i < (uint32_t)m_MeshLights.size(); ++i )
+            vertexOffset += mesh.GetVertexCount();
+        }
+    }
+
+    {
+        BVHNodes->resize( totalBVHNodeCount );
+
+        std::vector<uint32_t> BLASNodeIndexOffsets;
+        BLASNodeIndexOffsets.reserve( m_Meshes.size() );
+
+        GPU::BVHNode* dest = BVHNodes->data() + m_TLAS.size();
+        uint32_t triangleIndexOffset = 0;
+        uint32_t nodeIndexOffset = (uint32_t)m_TLAS.size();
+        for ( auto& mesh : m_Meshes )
+        {
+            BVHAccel::PackBVH( mesh.GetBVHNodes(), mesh.GetBVHNodeCount(), true, dest, nodeIndexOffset, triangleIndexOffset );
+            dest += mesh.GetBVHNodeCount();
+            BLASNodeIndexOffsets.push_back( nodeIndexOffset );
+            triangleIndexOffset += mesh.GetTriangleCount();;
+            nodeIndexOffset += mesh.GetBVHNodeCount();
+        }
+
+        // Make the TLAS point to the BLASes
+        std::vector<BVHAccel::BVHNode> TLAS = m_TLAS; // we make a copy here so the original TLAS could be used for CPU ray trace
+        for ( auto& node : TLAS )
+        {
+            if ( node.m_PrimCount > 0 )
             {
-                SMeshLight* CPULight = m_MeshLights.data() + i;
-
-                GPULight->radiance = CPULight->color;
-                const uint32_t originalInstanceIndex = CPULight->m_InstanceIndex;
-                const uint32_t meshIndex = m_MeshInstances[ originalInstanceIndex ].m_MeshIndex;
-                GPULight->position_or_triangleRange.x = *(float*)&meshTriangleOffsets[ meshIndex ];
-                uint32_t triangleCount = m_Meshes[ meshIndex ].GetTriangleCount();
-                GPULight->position_or_triangleRange.y = *(float*)&triangleCount;
-                const uint32_t reorderedInstanceIndex = m_ReorderedInstanceIndices[ originalInstanceIndex ];
-                GPULight->position_or_triangleRange.z = *(float*)&reorderedInstanceIndex;
-                GPULight->flags = LIGHT_FLAGS_MESH_LIGHT;
-
-                ++GPULight;
+                uint32_t primIndex = node.m_PrimIndex;
+                assert( node.m_PrimCount == 1 );
+                uint32_t originalInstanceIndex = m_OriginalInstanceIndices[ primIndex ];
+                uint32_t meshIndex = m_MeshInstances[ originalInstanceIndex ].m_MeshIndex;
+                node.m_ChildIndex = BLASNodeIndexOffsets[ meshIndex ];
+                node.m_InstanceIndex = primIndex;
             }
+        }
 
-            if ( m_EnvironmentLight )
-            {
-                SEnvironmentLight* CPULight = m_EnvironmentLight.get();
-                GPULight->radiance = CPULight->m_Color;
-                GPULight->flags = LIGHT_FLAGS_ENVIRONMENT_LIGHT;
+        dest = BVHNodes->data();
+        BVHAccel::PackBVH( TLAS.data(), (uint32_t)TLAS.size(), false, dest );
+    }
 
-                ++GPULight;
-            }
+    {
+        materialIds->resize( totalIndexCount / 3 );
+        uint32_t* dest = materialIds->data();
+        for ( auto& mesh : m_Meshes )
+        {
+            assert( mesh.GetMaterialIds().size() == mesh.GetIndexCount() / 3 );
+            memcpy( dest, mesh.GetMaterialIds().data(), mesh.GetMaterialIds().size() * sizeof( uint32_t ) );
+            dest += mesh.GetMaterialIds().size();
+        }
+    }
+}
 
-            for ( uint32_t i = 0; i < (uint32_t)m_PunctualLights.size(); ++i )
-            {
-                SPunctualLight* CPULight = m_PunctualLights.data() + i;
+void CScene::BuildInstanceData( std::vector<DirectX::XMFLOAT4X3>* transforms, std::vector<uint32_t>* lightIndices, std::vector<uint32_t>* materialOverrides ) const
+{
+    const uint32_t instanceCount = (uint32_t)m_MeshInstances.size();
+    transforms->resize( instanceCount );
+    materialOverrides->resize( instanceCount );
+    for ( uint32_t i = 0; i < instanceCount; ++i )
+    {
+        const uint32_t originalInstanceIndex = m_OriginalInstanceIndices[ i ];
+        ( *transforms )[ i ] = m_InstanceTransforms[ originalInstanceIndex ];
+        ( *materialOverrides )[ i ] = m_MeshInstances[ originalInstanceIndex ].m_MaterialIdOverride;
+    }
+
+    lightIndices->clear();
+    lightIndices->resize( instanceCount, LIGHT_INDEX_INVALID );
+    uint32_t lightIndex = 0;
+    for ( auto& light : m_MeshLights )
+    {
+        const uint32_t originalInstanceIndex = light.m_InstanceIndex;
+        const uint32_t reorderedInstanceIndex = m_ReorderedInstanceIndices[ originalInstanceIndex ];
+        ( *lightIndices )[ reorderedInstanceIndex ] = lightIndex;
+        ++lightIndex;
+    }
+}
+
+static float CalculateLuminance( const XMFLOAT3& color )
+{
+    return color.x * .299f + color.y * .587f + color.z * .114f;
+}
+
+void CScene::BuildLightData( std::vector<GPU::SLight>* lights, std::vector<GPU::SAliasTableEntry>* lightAliasTable )
+{
+    // Lights at infinity are selected proportionally to their estimated power, they are given the power they would send through the
+    // bounding sphere of the scene. Lights at a finite distance share one more entry of the alias table and are selected with the light BVH,
+    // which accounts for their distance and orientation to the shading point.
+    const float sceneRadius = m_TLAS.empty() ? 1.f : XMVectorGetX( XMVector3Length( XMLoadFloat3( &m_TLAS[ 0 ].m_BoundingBox.Extents ) ) );
+    const float sceneDiskArea = (float)M_PI * sceneRadius * sceneRadius;
+    const uint32_t lightCount = GetLightCount();
+    std::vector<float> lightPowers( lightCount + 1, 0.f );
+    std::vector<SLightBounds> lightBVHBounds;
+    std::vector<uint32_t> lightBVHLightIndices;
+    {
+        uint32_t lightIndex = 0;
+        for ( const SMeshLight& light : m_MeshLights )
+        {
+            lightBVHBounds.emplace_back( light.m_Bounds );
+            lightBVHBounds.back().m_Power = (float)M_PI * light.m_SurfaceArea * CalculateLuminance( light.color );
+            lightBVHLightIndices.emplace_back( lightIndex++ );
+        }
 
-                GPULight->radiance = CPULight->m_Color;
-                GPULight->position_or_triangleRange = CPULight->m_IsDirectionalLight ? CPULight->CalculateDirection() : CPULight->m_Position;
-                GPULight->flags = CPULight->m_IsDirectionalLight ? LIGHT_FLAGS_DIRECTIONAL_LIGHT : LIGHT_FLAGS_POINT_LIGHT;    
+        if ( m_EnvironmentLight )
+        {
+            lightPowers[ lightIndex++ ] = 4.f * (float)M_PI * sceneDiskArea * CalculateLuminance( m_EnvironmentLight->m_Color ) * m_EnvironmentLight->m_TextureAverageLuminance;
+        }
 
-                ++GPULight;
+        for ( const SPunctualLight& light : m_PunctualLights )
+        {
+            if ( light.m_IsDirectionalLight )
+            {
+                lightPowers[ lightIndex ] = sceneDiskArea * CalculateLuminance( light.m_Color );
+            }
+            else
+            {
+                SLightBounds bounds;
+                bounds.m_BoundsMin = light.m_Position;
+                bounds.m_BoundsMax = light.m_Position;
+                bounds.m_Axis = XMFLOAT3( 0.f, 0.f, 1.f );
+                bounds.m_CosThetaO = -1.f;
+                bounds.m_CosThetaE = 0.f;
+                bounds.m_Power = 4.f * (float)M_PI * CalculateLuminance( light.m_Color );
+                lightBVHBounds.emplace_back( bounds );
+                lightBVHLightIndices.emplace_back( lightIndex );
             }
+            ++lightIndex;
+        }
+    }
+
+    // Editing a light at infinity does not change the inputs of the light BVH
+    const bool isLightBVHDirty = lightBVHBounds.size() != m_LightBVHBounds.size()
+        || lightBVHLightIndices != m_LightBVHLightIndices
+        || memcmp( lightBVHBounds.data(), m_LightBVHBounds.data(), sizeof( SLightBounds ) * lightBVHBounds.size() ) != 0;
+    if ( isLightBVHDirty )
+    {
+        Timer timer;
+        timer.Start();
+        m_LightBVH.Build( lightBVHBounds.data(), lightBVHLightIndices.data(), (uint32_t)lightBVHBounds.size() );
+        LOG_STRING_FORMAT( "Light BVH rebuilt, lights %d, nodes %d, time %.2fms\n", (uint32_t)lightBVHBounds.size(), (uint32_t)m_LightBVH.m_Nodes.size(), timer.GetElapsedSecondsFloat().count() * 1000.f );
+
+        m_LightBVHBounds = std::move( lightBVHBounds );
+        m_LightBVHLightIndices = std::move( lightBVHLightIndices );
+    }
+
+    std::vector<uint32_t> lightBVHBitTrails( lightCount, 0 );
+    for ( uint32_t i = 0; i < (uint32_t)m_LightBVHLightIndices.size(); ++i )
+    {
+        lightBVHBitTrails[ m_LightBVHLightIndices[ i ] ] = m_LightBVH.m_BitTrails[ i ];
+    }
+    lightPowers[ lightCount ] = m_LightBVH.m_Nodes.empty() ? 0.f : m_LightBVH.m_Nodes[ 0 ].power;
+
+    lights->resize( lightCount );
+    GPU::SLight* GPULight = lights->data();
+
+    // todo: cache the offsets somewhere so it does not need to be calculated every time
+    std::vector<uint32_t> meshTriangleOffsets;
+    meshTriangleOffsets.reserve( m_Meshes.size() );
+    uint32_t triangleCount = 0;
+    for ( auto& mesh : m_Meshes )
+    {
+        meshTriangleOffsets.emplace_back( triangleCount );
+        triangleCount += mesh.GetTriangleCount();
+    }
+
+    for ( uint32_t i = 0; i < (uint32_t)m_MeshLights.size(); ++i )
+    {
+        const SMeshLight* CPULight = m_MeshLights.data() + i;
+
+        *GPULight = {};
+        GPULight->radiance = CPULight->color;
+        const uint32_t originalInstanceIndex = CPULight->m_InstanceIndex;
+        const uint32_t meshIndex = m_MeshInstances[ originalInstanceIndex ].m_MeshIndex;
+        GPULight->position_or_triangleRange.x = *(float*)&meshTriangleOffsets[ meshIndex ];
+        uint32_t triangleCount = m_Meshes[ meshIndex ].GetTriangleCount();
+        GPULight->position_or_triangleRange.y = *(float*)&triangleCount;
+        const uint32_t reorderedInstanceIndex = m_ReorderedInstanceIndices[ originalInstanceIndex ];
+        GPULight->position_or_triangleRange.z = *(float*)&reorderedInstanceIndex;
+        GPULight->triangleAliasTableOffset = CPULight->m_TriangleAliasTableOffset;
+        GPULight->lightBVHBitTrail = lightBVHBitTrails[ i ];
+        GPULight->flags = LIGHT_FLAGS_MESH_LIGHT;
+
+        ++GPULight;
+    }
+
+    if ( m_EnvironmentLight )
+    {
+        const SEnvironmentLight* CPULight = m_EnvironmentLight.get();
+        *GPULight = {};
+        GPULight->radiance = CPULight->m_Color;
+        GPULight->position_or_triangleRange.x = *(float*)&CPULight->m_DistributionCellCount;
+        GPULight->flags = LIGHT_FLAGS_ENVIRONMENT_LIGHT;
+
+        ++GPULight;
+    }
+
+    const uint32_t punctualLightIndexBase = (uint32_t)m_MeshLights.size() + ( m_EnvironmentLight ? 1 : 0 );
+    for ( uint32_t i = 0; i < (uint32_t)m_PunctualLights.size(); ++i )
+    {
+        const SPunctualLight* CPULight = m_PunctualLights.data() + i;
+
+        *GPULight = {};
+        GPULight->radiance = CPULight->m_Color;
+        GPULight->position_or_triangleRange = CPULight->m_IsDirectionalLight ? CPULight->CalculateDirection() : CPULight->m_Position;
+        GPULight->lightBVHBitTrail = lightBVHBitTrails[ punctualLightIndexBase + i ];
+        GPULight->flags = CPULight->m_IsDirectionalLight ? LIGHT_FLAGS_DIRECTIONAL_LIGHT : LIGHT_FLAGS_POINT_LIGHT;    
+
+        ++GPULight;
+    }
+
+    lightAliasTable->clear();
+    if ( !BuildAliasTable( lightPowers.data(), (uint32_t)lightPowers.size(), lightAliasTable ) )
+    {
+        // Every light is black, fall back to uniform selection
+        std::fill( lightPowers.begin(), lightPowers.end(), 1.f );
+        for ( uint32_t lightIndex : m_LightBVHLightIndices )
+        {
+            lightPowers[ lightIndex ] = 0.f;
+        }
+        lightPowers[ lightCount ] = m_LightBVH.m_Nodes.empty() ? 0.f : 1.f;
+        BuildAliasTable( lightPowers.data(), (uint32_t)lightPowers.size(), lightAliasTable );
+    }
+}
+
+void CScene::UpdateLightGPUData()
+{
+    std::vector<GPU::SLight> lights;
+    std::vector<GPU::SAliasTableEntry> lightAliasTable;
+    BuildLightData( &lights, &lightAliasTable );
+
+    GPUBuffer::SUploadContext context = {};
+    if ( m_LightsBuffer->AllocateUploadContext( &context ) )
+    {
+        void* address = context.Map();
+        if ( address )
+        {
+            memcpy( address, lights.data(), sizeof( GPU::SLight ) * lights.size() );
+
+            context.Unmap();
+            context.Upload();
+
+            m_IsLightBufferRead = false;
+        }
+    }
+
+    context = {};
+    if ( m_LightAliasTableBuffer->AllocateUploadContext( &context ) )
+    {
+        void* address = context.Map();
+        if ( address )
+        {
+            memcpy( address, lightAliasTable.data(), sizeof( GPU::SAliasTableEntry ) * lightAliasTable.size() );
 
             context.Unmap();
             context.Upload();
@@ -732,6 +1675,25 @@ void CScene::UpdateLightGPUData()
             m_IsLightBufferRead = false;
         }
     }
+
+    // Uploaded along with the other light buffers even if the BVH is unchanged so they share the same resource state transitions
+    if ( !m_LightBVH.m_Nodes.empty() )
+    {
+        context = {};
+        if ( m_LightBVHNodesBuffer->AllocateUploadContext( &context ) )
+        {
+            void* address = context.Map();
+            if ( address )
+            {
+                memcpy( address, m_LightBVH.m_Nodes.data(), sizeof( GPU::SLightBVHNode ) * m_LightBVH.m_Nodes.size() );
+
+                context.Unmap();
+                context.Upload();
+
+                m_IsLightBufferRead = false;
+            }
+        }
+    }
 }
 
 static uint32_t TranslateToMaterialType( EMaterialType materialType )
@@ -739,32 +1701,41 @@ static uint32_t TranslateToMaterialType( EMaterialType materialType )
     return (uint32_t)materialType;
 }
 
+void CScene::BuildMaterialData( std::vector<GPU::Material>* materials ) const
+{
+    materials->resize( m_Materials.size() );
+    for ( uint32_t i = 0; i < (uint32_t)m_Materials.size(); ++i )
+    {
+        const SMaterial* materialSetting = m_Materials.data() + i;
+        GPU::Material* material = materials->data() + i;
+        material->albedo = materialSetting->m_MaterialType == EMaterialType::Conductor ? materialSetting->m_K : materialSetting->m_Albedo;
+        material->albedoTextureIndex = materialSetting->m_MaterialType == EMaterialType::Conductor || materialSetting->m_MaterialType == EMaterialType::Dielectric ?
+            INDEX_NONE : materialSetting->m_AlbedoTextureIndex;
+        material->ior = materialSetting->m_IOR;
+        material->roughness = std::clamp( materialSetting->m_Roughness, 0.0f, 1.0f );
+        material->texTiling = materialSetting->m_Tiling;
+        material->opacity = materialSetting->m_Opacity;
+        material->opacityTextureIndex = materialSetting->m_OpacityTextureIndex;
+        material->flags = TranslateToMaterialType( materialSetting->m_MaterialType ) & MATERIAL_FLAG_TYPE_MASK;
+        material->flags |= materialSetting->m_Multiscattering ? MATERIAL_FLAG_MULTISCATTERING : 0;
+        material->flags |= materialSetting->m_IsTwoSided ? MATERIAL_FLAG_IS_TWOSIDED : 0;
+        material->flags |= materialSetting->m_HasRoughnessTexture ? MATERIAL_FLAG_ROUGHNESS_TEXTURE : 0;
+        material->flags |= ( materialSetting->m_InternalScatteringMode << MATERIAL_FLAG_INTERNAL_SCATTERING_SHIFT ) & MATERIAL_FLAG_INTERNAL_SCATTERING_MASK;
+    }
+}
+
 void CScene::UpdateMaterialGPUData()
 {
+    std::vector<GPU::Material> materials;
+    BuildMaterialData( &materials );
+
     GPUBuffer::SUploadContext context = {};
     if ( m_MaterialsBuffer->AllocateUploadContext( &context ) )
     {
         void* address = context.Map();
         if ( address )
         { 
-            for ( uint32_t i = 0; i < (uint32_t)m_Materials.size(); ++i )
-            {
-                SMaterial* materialSetting = m_Materials.data() + i;
-                GPU::Material* material = ( (GPU::Material*)address ) + i;
-                material->albedo = materialSetting->m_MaterialType == EMaterialType::Conductor ? materialSetting->m_K : materialSetting->m_Albedo;
-                material->albedoTextureIndex = materialSetting->m_MaterialType == EMaterialType::Conductor || materialSetting->m_MaterialType == EMaterialType::Dielectric ?
-                    INDEX_NONE : materialSetting->m_AlbedoTextureIndex;
-                material->ior = materialSetting->m_IOR;
-                material->roughness = std::clamp( materialSetting->m_Roughness, 0.0f, 1.0f );
-                material->texTiling = materialSetting->m_Tiling;
-                material->opacity = materialSetting->m_Opacity;
-                material->opacityTextureIndex = materialSetting->m_OpacityTextureIndex;
-                material->flags = TranslateToMaterialType( materialSetting->m_MaterialType ) & MATERIAL_FLAG_TYPE_MASK;
-                material->flags |= materialSetting->m_Multiscattering ? MATERIAL_FLAG_MULTISCATTERING : 0;
-                material->flags |= materialSetting->m_IsTwoSided ? MATERIAL_FLAG_IS_TWOSIDED : 0;
-                material->flags |= materialSetting->m_HasRoughnessTexture ? MATERIAL_FLAG_ROUGHNESS_TEXTURE : 0;
-                material->flags |= ( materialSetting->m_InternalScatteringMode << MATERIAL_FLAG_INTERNAL_SCATTERING_SHIFT ) & MATERIAL_FLAG_INTERNAL_SCATTERING_MASK;
-            }
+            memcpy( address, materials.data(), sizeof( GPU::Material ) * materials.size() );
             context.Unmap();
             context.Upload();
 
@@ -773,31 +1744,39 @@ void CScene::UpdateMaterialGPUData()
     }
 }
 
+void CScene::BuildInstanceFlags( std::vector<uint32_t>* instanceFlags ) const
+{
+    instanceFlags->resize( m_OriginalInstanceIndices.size() );
+    for ( uint32_t instanceIndex = 0; instanceIndex < (uint32_t)m_OriginalInstanceIndices.size() ; ++instanceIndex )
+    { 
+        const uint32_t originalIndex = m_OriginalInstanceIndices[ instanceIndex ];
+        const uint32_t meshIndex = m_MeshInstances[ originalIndex ].m_MeshIndex;
+        const uint32_t materialIdOverride = m_MeshInstances[ originalIndex ].m_MaterialIdOverride;
+        bool isOpaque;
+        if ( materialIdOverride != INVALID_MATERIAL_ID )
+        {
+            isOpaque = m_Materials[ materialIdOverride ].IsOpaque();
+        }
+        else
+        {
+            isOpaque = m_MeshFlags[ meshIndex ].m_Opaque;
+        }
+        ( *instanceFlags )[ instanceIndex ] = isOpaque ? INSTANCE_FLAG_OPAQUE : 0;
+    }
+}
+
 void CScene::UpdateInstanceFlagsGPUData()
 {
+    std::vector<uint32_t> instanceFlags;
+    BuildInstanceFlags( &instanceFlags );
+
     GPUBuffer::SUploadContext context = {};
     if ( m_InstanceFlagsBuffer->AllocateUploadContext( &context ) )
     {
         void* address = context.Map();
         if ( address )
         { 
-            for ( uint32_t instanceIndex = 0; instanceIndex < (uint32_t)m_OriginalInstanceIndices.size() ; ++instanceIndex )
-            { 
-                const uint32_t originalIndex = m_OriginalInstanceIndices[ instanceIndex ];
-                const uint32_t meshIndex = m_MeshInstances[ originalIndex ].m_MeshIndex;
-                const uint32_t materialIdOverride = m_MeshInstances[ originalIndex ].m_MaterialIdOverride;
-                bool isOpaque;
-                if ( materialIdOverride != INVALID_MATERIAL_ID )
-                {
-                    isOpaque = m_Materials[ materialIdOverride ].IsOpaque();
-                }
-                else
-                {
-                    isOpaque = m_MeshFlags[ meshIndex ].m_Opaque;
-                }
-                uint32_t* instanceFlag = ( (uint32_t*)address ) + instanceIndex;
-                *instanceFlag = isOpaque ? INSTANCE_FLAG_OPAQUE : 0;
-            }
+            memcpy( address, instanceFlags.data(), sizeof( uint32_t ) * instanceFlags.size() );
             context.Unmap();
             context.Upload();
 
@@ -905,9 +1884,51 @@ bool CScene::RecreateFilmTextures()
 
 bool SEnvironmentLight::CreateTextureFromFile()
 {
+    ClearTexture();
+
     std::wstring filename = StringConversion::UTF8StringToUTF16WString( m_TextureFileName );
-    m_Texture.Reset( GPUTexture::CreateFromFile( filename.c_str() ) );
-    return m_Texture.Get() != nullptr;
+    SEnvironmentLightDistribution distribution;
+    Timer timer;
+    m_Texture.Reset( GPUTexture::CreateFromFile( filename.c_str(),
+        [ this, &distribution ]( const D3D12_RESOURCE_DESC& desc, bool isCubemap, const std::vector<D3D12_SUBRESOURCE_DATA>& subresources )
+        {
+            distribution.BuildFromSubresources( desc, isCubemap, subresources );
+            m_CPURadiance.BuildFromSubresources( desc, isCubemap, subresources );
+        } ) );
+    if ( !m_Texture )
+    {
+        return false;
+    }
+
+    if ( distribution.m_CellCount != 0 )
+    {
+        m_Distribution.Reset( GPUBuffer::CreateStructured(
+              (uint32_t)( sizeof( GPU::SAliasTableEntry ) * distribution.m_AliasTable.size() )
+            , sizeof( GPU::SAliasTableEntry )
+            , EGPUBufferUsage::Default
+            , EGPUBufferBindFlag_ShaderResource
+            , distribution.m_AliasTable.data()
+            , D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE ) );
+        if ( m_Distribution )
+        {
+            m_CPUDistribution = std::move( distribution );
+            m_DistributionCellCount = m_CPUDistribution.m_CellCount;
+            m_TextureAverageLuminance = m_CPUDistribution.m_AverageLuminance;
+            LOG_STRING_FORMAT( "Environment light distribution created, %ux%u cells per face, texture and distribution loaded in %.2f ms\n", m_DistributionCellCount, m_DistributionCellCount,
+                timer.GetElapsedMicroseconds().count() / 1000.f );
+        }
+    }
+    return true;
+}
+
+void SEnvironmentLight::ClearTexture()
+{
+    m_Texture.Reset();
+    m_Distribution.Reset();
+    m_CPUDistribution = SEnvironmentLightDistribution();
+    m_CPURadiance = SEnvironmentLightRadiance();
+    m_DistributionCellCount = 0;
+    m_TextureAverageLuminance = 1.f;
 }
 
 void SPunctualLight::SetEulerAnglesFromDirection( const DirectX::XMFLOAT3& scalarDirection )
@@ -7,7 +7,11 @@
 #include "Texture.h"
 #include "Material.h"
 #include "BxDFTextures.h"
+#include "LightBVH.h"
+#include "EnvironmentLightDistribution.h"
+#include "MemoryAccounting.h"
 #include "../Shaders/Material.inc.hlsl"
+#include "../Shaders/LightSharedDef.inc.hlsl"
 
 #define INDEX_NONE -1
 
@@ -41,15 +45,25 @@ struct SMeshLight
 {
     uint32_t m_InstanceIndex;
     DirectX::XMFLOAT3 color;
+    float m_SurfaceArea = 0.f; // In world space
+    uint32_t m_TriangleAliasTableOffset = 0;
+    SLightBounds m_Bounds; // In world space, the power is estimated when the light BVH is built
 };
 
 struct SEnvironmentLight
 {
     DirectX::XMFLOAT3 m_Color;
     CD3D12ResourcePtr<GPUTexture> m_Texture;
+    CD3D12ResourcePtr<GPUBuffer> m_Distribution;
+    uint32_t m_DistributionCellCount = 0; // 0 when the texture is sampled uniformly
+    float m_TextureAverageLuminance = 1.f;
     std::string m_TextureFileName;
+    SEnvironmentLightDistribution m_CPUDistribution; // Same as m_Distribution, for the CPU path tracer
+    SEnvironmentLightRadiance m_CPURadiance; // Empty when the texture format can not be read on the CPU
 
     bool CreateTextureFromFile();
+
+    void ClearTexture();
 };
 
 struct SMeshInstance
@@ -73,6 +87,19 @@ public:
 
     bool RecreateFilmTextures();
 
+    // Fill the contents of the GPU buffers, the CPU path tracer consumes the same data
+    void BuildGeometryData( std::vector<GPU::Vertex>* vertices, std::vector<uint32_t>* triangles, std::vector<uint32_t>* materialIds, std::vector<GPU::BVHNode>* BVHNodes ) const;
+
+    // Transforms are not inverted nor transposed, all arrays are indexed by reordered instance index
+    void BuildInstanceData( std::vector<DirectX::XMFLOAT4X3>* transforms, std::vector<uint32_t>* lightIndices, std::vector<uint32_t>* materialOverrides ) const;
+
+    // Rebuilds the light BVH if its inputs changed
+    void BuildLightData( std::vector<GPU::SLight>* lights, std::vector<GPU::SAliasTableEntry>* lightAliasTable );
+
+    void BuildMaterialData( std::vector<GPU::Material>* materials ) const;
+
+    void BuildInstanceFlags( std::vector<uint32_t>* instanceFlags ) const;
+
     void UpdateLightGPUData();
 
     void UpdateMaterialGPUData();
@@ -91,6 +118,13 @@ public:
 
     bool XM_CALLCONV TraceRay( DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float tMin, struct SRayHit* outRayHit, struct SRayTraversalCounters* outCounters = nullptr ) const;
 
+    // Inverted instance transforms are indexed by original instance index and built once with BuildInstanceInvTransforms, for tracing many rays.
+    // Only hits closer than tMax are reported.
+    bool XM_CALLCONV TraceRay( const DirectX::XMFLOAT4X3* instanceInvTransforms, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float tMin, float tMax,
+        struct SRayHit* outRayHit, struct SRayTraversalCounters* outCounters = nullptr ) const;
+
+    void BuildInstanceInvTransforms( std::vector<DirectX::XMFLOAT4X3>* invTransforms ) const;
+
     void ScreenToCameraRay( const DirectX::XMFLOAT2& screenPos, DirectX::XMVECTOR* origin, DirectX::XMVECTOR* direction );
 
     D3D12_GPU_DESCRIPTOR_HANDLE GetTextureDescriptorTable() const { return m_TextureDescriptorTable; }
@@ -128,6 +162,7 @@ public:
     float m_ShutterTime;
     float m_ISO;
     uint32_t m_MaxBounceCount;
+    uint32_t m_RussianRouletteBounceCount; // Paths may be terminated by Russian roulette from this bounce on
     float m_FilterRadius = 1.0f;
     EFilter m_Filter = EFilter::Box;
     float m_GaussianFilterAlpha = 1.5f;
@@ -158,11 +193,19 @@ public:
     std::vector<DirectX::XMFLOAT4X3> m_InstanceTransforms;
     std::vector<CTexture> m_Textures;
     uint32_t m_BVHTraversalStackSize;
+    SLightBVH m_LightBVH;
+    std::vector<SLightBounds> m_LightBVHBounds; // Inputs of the last light BVH build
+    std::vector<uint32_t> m_LightBVHLightIndices;
+    std::vector<GPU::SAliasTableEntry> m_TriangleAliasTable; // Tables of all mesh lights, each starts at the m_TriangleAliasTableOffset of its light
+    CMemoryAccounting m_MemoryAccounting;
 
     CD3D12ResourcePtr<GPUBuffer> m_VerticesBuffer;
     CD3D12ResourcePtr<GPUBuffer> m_TrianglesBuffer;
     CD3D12ResourcePtr<GPUBuffer> m_BVHNodesBuffer;
     CD3D12ResourcePtr<GPUBuffer> m_LightsBuffer;
+    CD3D12ResourcePtr<GPUBuffer> m_LightAliasTableBuffer;
+    CD3D12ResourcePtr<GPUBuffer> m_TriangleAliasTableBuffer;
+    CD3D12ResourcePtr<GPUBuffer> m_LightBVHNodesBuffer;
     CD3D12ResourcePtr<GPUBuffer> m_MaterialIdsBuffer;
     CD3D12ResourcePtr<GPUBuffer> m_MaterialsBuffer;
     CD3D12ResourcePtr<GPUBuffer> m_InstanceTransformsBuffer;
@@ -222,4 +265,7 @@ public:
     bool m_IsInstanceFlagsBufferRead = true;
     bool m_IsSampleTexturesRead = false;
     bool m_IsRenderResultTextureRead = true;
-};
\ No newline at end of file
+};
+
+// Parses a generated Mitsuba scene with the given number of shapes several times and logs the XML parsing and value graph building times
+void RunXMLParsingBenchmark( uint32_t shapeCount );
\ No newline at end of file
@@ -55,19 +55,29 @@ static bool XM_CALLCONV RayAABBIntersect( FXMVECTOR origin, FXMVECTOR invDirecti
     return scalarT1 >= scalarT0 && ( scalarT0 < tMax&& scalarT1 >= tMin );
 }
 
-bool CScene::TraceRay( FXMVECTOR origin, FXMVECTOR direction, float tMin, SRayHit* outRayHit, SRayTraversalCounters* outCounters ) const
+void CScene::BuildInstanceInvTransforms( std::vector<XMFLOAT4X3>* invTransforms ) const
 {
-    std::vector<XMFLOAT4X3> instanceInvTransforms;
-    instanceInvTransforms.reserve( m_InstanceTransforms.size() );
+    invTransforms->clear();
+    invTransforms->reserve( m_InstanceTransforms.size() );
     for ( auto& transform : m_InstanceTransforms )
     {
         XMMATRIX matrix = XMLoadFloat4x3( &transform );
         XMVECTOR det;
         matrix = XMMatrixInverse( &det, matrix );
-        instanceInvTransforms.emplace_back();
-        XMStoreFloat4x3( &instanceInvTransforms.back(), matrix );
+        invTransforms->emplace_back();
+        XMStoreFloat4x3( &invTransforms->back(), matrix );
     }
+}
 
+bool CScene::TraceRay( FXMVECTOR origin, FXMVECTOR direction, float tMin, SRayHit* outRayHit, SRayTraversalCounters* outCounters ) const
+{
+    std::vector<XMFLOAT4X3> instanceInvTransforms;
+    BuildInstanceInvTransforms( &instanceInvTransforms );
+    return TraceRay( instanceInvTransforms.data(), origin, direction, tMin, std::numeric_limits<float>::infinity(), outRayHit, outCounters );
+}
+
+bool CScene::TraceRay( const XMFLOAT4X3* instanceInvTransforms, FXMVECTOR origin, FXMVECTOR direction, float tMin, float tMax, SRayHit* outRayHit, SRayTraversalCounters* outCounters ) const
+{
     struct SBVHTraversalNode
     {
         uint32_t m_NodeIndex;
@@ -76,7 +86,7 @@ bool CScene::TraceRay( FXMVECTOR origin, FXMVECTOR direction, float tMin, SRayHi
 
     std::stack<SBVHTraversalNode> stack;
 
-    float tMax = std::numeric_limits<float>::infinity();
+    bool hasHit = false;
     float t, u, v;
     bool backface;
 
@@ -153,6 +163,7 @@ bool CScene::TraceRay( FXMVECTOR origin, FXMVECTOR direction, float tMin, SRayHi
                         if ( RayTriangleIntersect( localRayOrigin, localRayDirection, tMin, tMax, v0, v1, v2, &t, &u, &v, &backface ) )
                         {
                             tMax = t;
+                            hasHit = true;
                             outRayHit->m_T = t;
                             outRayHit->m_U = u;
                             outRayHit->m_V = v;
@@ -204,7 +215,7 @@ bool CScene::TraceRay( FXMVECTOR origin, FXMVECTOR direction, float tMin, SRayHi
         *outCounters = counters;
     }
 
-    return !std::isinf( tMax );
+    return hasHit;
 }
 
 void CScene::ScreenToCameraRay( const DirectX::XMFLOAT2& screenPos, DirectX::XMVECTOR* origin, DirectX::XMVECTOR* direction )
@@ -4,6 +4,9 @@
 #include "MathHelper.h"
 #include "CommandLineArgs.h"
 #include "Constants.h"
+#include "Timers.h"
+#include "ParallelFor.h"
+#include "Profiling.h"
 #include "RapidXml/rapidxml.hpp"
 
 using namespace rapidxml;
@@ -23,7 +26,7 @@ enum class EValueType
 
 enum class EShapeType 
 {
-    Unsupported = 0, eObj = 1, eRectangle = 2 
+    Unsupported = 0, eObj = 1, eRectangle = 2, ePly = 3, eSerialized = 4 
 };
 
 enum class EXMLMaterialType
@@ -50,21 +53,57 @@ template <> struct SGetValueType<std::string_view> { static const EValueType s_V
 template <> struct SGetValueType<XMFLOAT3> { static const EValueType s_ValueType = EValueType::eVector; };
 template <> struct SGetValueType<XMFLOAT4X4> { static const EValueType s_ValueType = EValueType::eMatrix; };
 
+struct SValue;
+
+typedef std::pair<std::string_view, SValue*> SNamedValue;
+
+struct SNamedValueLink
+{
+    SNamedValue m_NamedValue;
+    SNamedValueLink* m_Next;
+};
+
+struct SNamedValueRange
+{
+    SNamedValue* begin() const { return m_Begin; }
+    SNamedValue* end() const { return m_End; }
+    size_t size() const { return m_End - m_Begin; }
+
+    SNamedValue* m_Begin;
+    SNamedValue* m_End;
+};
+
+// Fields and nested objects are gathered in linked lists while the graph is being built, CValueList::Finalize then flattens them into arrays.
+// Fields and the lookup copy of nested objects are sorted by name, the nested objects keep their document order for iteration.
+struct SValueObject
+{
+    SNamedValueLink* m_PendingFieldsHead;
+    SNamedValueLink* m_PendingFieldsTail;
+    SNamedValueLink* m_PendingNestedObjectsHead;
+    SNamedValueLink* m_PendingNestedObjectsTail;
+    SNamedValueRange m_Fields;
+    SNamedValueRange m_NestedObjects;
+    SNamedValueRange m_SortedNestedObjects;
+};
+
+static bool NamedValueLess( const SNamedValue& lhs, const SNamedValue& rhs )
+{
+    return lhs.first < rhs.first;
+}
+
+static SValue* FindFirstNamedValue( const SNamedValueRange& sortedRange, std::string_view name )
+{
+    const SNamedValue key = { name, nullptr };
+    const SNamedValue* iter = std::lower_bound( sortedRange.begin(), sortedRange.end(), key, NamedValueLess );
+    return iter != sortedRange.end() && iter->first == name ? iter->second : nullptr;
+}
+
 struct SValue
 {
     SValue() : m_Float( 0.0f )
     {
     }
 
-    ~SValue()
-    {
-        if ( m_Type == EValueType::eObject )
-        {
-            delete m_ObjectFields;
-            delete m_NestedObjects;
-        }
-    }
-
     template <typename T> T& Get() { return T(); }
     template <typename T> const T& Get() const { return T(); }
 
@@ -86,34 +125,9 @@ struct SValue
     template <> XMFLOAT4X4& Get<XMFLOAT4X4>() { return m_Matrix; }
     template <> const XMFLOAT4X4& Get<XMFLOAT4X4>() const { return m_Matrix; }
 
-    void SetAsObject()
-    {
-        m_ObjectFields = new std::unordered_map<std::string_view, SValue*>();
-        m_NestedObjects = new std::vector<std::pair<std::string_view, SValue*>>();
-        m_Type = EValueType::eObject;
-    }
-
-    void InsertObjectField( std::string_view stringView, SValue* value )
-    {
-        m_ObjectFields->insert( { stringView, value } );
-    }
-
-    void InsertNestedObject( std::string_view stringView, SValue* value )
-    {
-        m_NestedObjects->emplace_back( std::make_pair( stringView, value ) );
-    }
-
     SValue* FindObjectField( std::string_view stringView ) const
     {
-        auto iter = m_ObjectFields->find( stringView );
-        if ( iter != m_ObjectFields->end() )
-        {
-            return iter->second;
-        }
-        else
-        {
-            return nullptr;
-        }
+        return FindFirstNamedValue( m_Object->m_Fields, stringView );
     }
 
     template <typename T>
@@ -126,14 +140,12 @@ struct SValue
 
     SValue* FindFirstNestedObject( std::string_view stringView ) const
     {
-        for ( auto& iter : *m_NestedObjects )
-        {
-            if ( iter.first == stringView ) 
-            {
-                return iter.second;
-            }
-        }
-        return nullptr;
+        return FindFirstNamedValue( m_Object->m_SortedNestedObjects, stringView );
+    }
+
+    const SNamedValueRange& GetNestedObjects() const
+    {
+        return m_Object->m_NestedObjects;
     }
 
     EValueType m_Type;
@@ -149,30 +161,166 @@ struct SValue
             XMFLOAT3 m_Vector;
         };
         XMFLOAT4X4 m_Matrix;
-        struct
-        {
-            std::unordered_map<std::string_view, SValue*>* m_ObjectFields;
-            std::vector<std::pair<std::string_view, SValue*>>* m_NestedObjects;
-        };
+        SValueObject* m_Object;
     };
 };
 
+// Bump arena owning all the values of a graph together with their field tables. Everything is released at once by Clear.
 class CValueList
 {
 public:
+    CValueList() = default;
+
+    CValueList( const CValueList& ) = delete;
+
+    CValueList& operator=( const CValueList& ) = delete;
+
+    ~CValueList()
+    {
+        Clear();
+    }
+
     SValue* AllocateValue()
     {
-        m_Values.emplace_back();
-        return &m_Values.back();
+        ++m_ValueCount;
+        return new ( Allocate( sizeof( SValue ), alignof( SValue ) ) ) SValue();
+    }
+
+    void SetAsObject( SValue* value )
+    {
+        value->m_Object = new ( Allocate( sizeof( SValueObject ), alignof( SValueObject ) ) ) SValueObject();
+        value->m_Type = EValueType::eObject;
+        m_ObjectValues.push_back( value );
+    }
+
+    void InsertObjectField( SValue* object, std::string_view stringView, SValue* value )
+    {
+        AppendLink( &object->m_Object->m_PendingFieldsHead, &object->m_Object->m_PendingFieldsTail, stringView, value );
+    }
+
+    void InsertNestedObject( SValue* object, std::string_view stringView, SValue* value )
+    {
+        AppendLink( &object->m_Object->m_PendingNestedObjectsHead, &object->m_Object->m_PendingNestedObjectsTail, stringView, value );
+    }
+
+    // Flattens the gathered fields and nested objects of every object. Must be called after building and before looking anything up.
+    void Finalize()
+    {
+        for ( SValue* value : m_ObjectValues )
+        {
+            SValueObject* object = value->m_Object;
+            object->m_Fields = FlattenLinks( object->m_PendingFieldsHead );
+            SortByName( object->m_Fields );
+            object->m_NestedObjects = FlattenLinks( object->m_PendingNestedObjectsHead );
+            object->m_SortedNestedObjects = AllocateRange( object->m_NestedObjects.size() );
+            std::copy( object->m_NestedObjects.begin(), object->m_NestedObjects.end(), object->m_SortedNestedObjects.begin() );
+            SortByName( object->m_SortedNestedObjects );
+        }
+        m_ObjectValues.clear();
     }
 
     void Clear()
     {
-        m_Values.clear();
+        for ( uint8_t* block : m_Blocks )
+        {
+            delete[] block;
+        }
+        m_Blocks.clear();
+        m_ObjectValues.clear();
+        m_Current = nullptr;
+        m_End = nullptr;
+        m_AllocatedSize = 0;
+        m_ValueCount = 0;
     }
 
+    uint32_t GetValueCount() const { return m_ValueCount; }
+
+    size_t GetAllocatedSize() const { return m_AllocatedSize; }
+
 private:
-    std::list<SValue> m_Values;
+    void* Allocate( size_t size, size_t alignment )
+    {
+        uint8_t* allocation = (uint8_t*)( ( (uintptr_t)m_Current + alignment - 1 ) & ~( (uintptr_t)alignment - 1 ) );
+        if ( !m_Current || allocation + size > m_End )
+        {
+            const size_t blockSize = std::max( s_BlockSize, size + alignment );
+            m_Blocks.push_back( new uint8_t[ blockSize ] );
+            m_Current = m_Blocks.back();
+            m_End = m_Current + blockSize;
+            m_AllocatedSize += blockSize;
+            allocation = (uint8_t*)( ( (uintptr_t)m_Current + alignment - 1 ) & ~( (uintptr_t)alignment - 1 ) );
+        }
+        m_Current = allocation + size;
+        return allocation;
+    }
+
+    void AppendLink( SNamedValueLink** head, SNamedValueLink** tail, std::string_view stringView, SValue* value )
+    {
+        SNamedValueLink* link = new ( Allocate( sizeof( SNamedValueLink ), alignof( SNamedValueLink ) ) ) SNamedValueLink();
+        link->m_NamedValue = { stringView, value };
+        link->m_Next = nullptr;
+        if ( *tail )
+        {
+            ( *tail )->m_Next = link;
+        }
+        else
+        {
+            *head = link;
+        }
+        *tail = link;
+    }
+
+    SNamedValueRange AllocateRange( size_t count )
+    {
+        SNamedValue* namedValues = count > 0 ? (SNamedValue*)Allocate( sizeof( SNamedValue ) * count, alignof( SNamedValue ) ) : nullptr;
+        return { namedValues, namedValues + count };
+    }
+
+    SNamedValueRange FlattenLinks( const SNamedValueLink* head )
+    {
+        size_t count = 0;
+        for ( const SNamedValueLink* link = head; link; link = link->m_Next )
+        {
+            ++count;
+        }
+        SNamedValueRange range = AllocateRange( count );
+        SNamedValue* namedValue = range.begin();
+        for ( const SNamedValueLink* link = head; link; link = link->m_Next )
+        {
+            new ( namedValue++ ) SNamedValue( link->m_NamedValue );
+        }
+        return range;
+    }
+
+    // Stable, so the first inserted value of a name is the one found. Objects usually have a handful of fields, which insertion sort handles without allocating.
+    static void SortByName( const SNamedValueRange& range )
+    {
+        if ( range.size() > 32 )
+        {
+            std::stable_sort( range.begin(), range.end(), NamedValueLess );
+            return;
+        }
+        for ( SNamedValue* current = range.begin(); current != range.end(); ++current )
+        {
+            SNamedValue namedValue = *current;
+            SNamedValue* insertion = current;
+            while ( insertion != range.begin() && NamedValueLess( namedValue, *( insertion - 1 ) ) )
+            {
+                *insertion = *( insertion - 1 );
+                --insertion;
+            }
+            *insertion = namedValue;
+        }
+    }
+
+    static const size_t s_BlockSize = 256 * 1024;
+
+    std::vector<uint8_t*> m_Blocks;
+    std::vector<SValue*> m_ObjectValues;
+    uint8_t* m_Current = nullptr;
+    uint8_t* m_End = nullptr;
+    size_t m_AllocatedSize = 0;
+    uint32_t m_ValueCount = 0;
 };
 
 static bool TryGetAttribute( xml_node<>* node, const char* attributeName, std::string_view* attributeValue )
@@ -262,7 +410,7 @@ static bool BuildValueGraph( CValueList* valueList, xml_document<>* doc, std::ve
         if ( objectTagNames.find( { currentNode->name(), currentNode->name_size() } ) != objectTagNames.end() )
         {
             currentValue = valueList->AllocateValue();
-            currentValue->SetAsObject();
+            valueList->SetAsObject( currentValue );
 
             if ( parentValue == nullptr )
             {
@@ -299,12 +447,12 @@ static bool BuildValueGraph( CValueList* valueList, xml_document<>* doc, std::ve
                 xml_attribute<>* attribute = currentNode->first_attribute( "name" );
                 if ( attribute != nullptr )
                 {
-                    parentValue->InsertObjectField( std::string_view( attribute->value(), attribute->value_size() ), currentValue );
+                    valueList->InsertObjectField( parentValue, std::string_view( attribute->value(), attribute->value_size() ), currentValue );
                 }
                 else
                 {
                     // Add it as nested object
-                    parentValue->InsertNestedObject( std::string_view( currentNode->name(), currentNode->name_size() ), currentValue );
+                    valueList->InsertNestedObject( parentValue, std::string_view( currentNode->name(), currentNode->name_size() ), currentValue );
                 }
 
                 attribute = currentNode->first_attribute( "id", 0 );
@@ -321,7 +469,7 @@ static bool BuildValueGraph( CValueList* valueList, xml_document<>* doc, std::ve
                     }
 
                     SValue* idValue = valueList->AllocateValue();
-                    currentValue->InsertObjectField( "id", idValue );
+                    valueList->InsertObjectField( currentValue, "id", idValue );
                     idValue->m_Type = EValueType::eString;
                     idValue->m_String = id;
                 }
@@ -330,7 +478,7 @@ static bool BuildValueGraph( CValueList* valueList, xml_document<>* doc, std::ve
                 if ( attribute != nullptr )
                 {
                     SValue* typeValue = valueList->AllocateValue();
-                    currentValue->InsertObjectField( "type", typeValue );
+                    valueList->InsertObjectField( currentValue, "type", typeValue );
                     typeValue->m_Type = EValueType::eString;
                     if ( !TryEvaluateValueString( std::string_view( attribute->value(), attribute->value_size() ), defaultParameterMap, &typeValue->m_String ) )
                     {
@@ -355,12 +503,12 @@ static bool BuildValueGraph( CValueList* valueList, xml_document<>* doc, std::ve
             xml_attribute<>* attribute = currentNode->first_attribute( "name" );
             if ( attribute != nullptr )
             {
-                parentValue->InsertObjectField( std::string_view( attribute->value(), attribute->value_size() ), currentValue );
+                valueList->InsertObjectField( parentValue, std::string_view( attribute->value(), attribute->value_size() ), currentValue );
             }
             else
             {
                 // Add it as nested object
-                parentValue->InsertNestedObject( std::string_view( currentNode->name(), currentNode->name_size() ), currentValue );
+                valueList->InsertNestedObject( parentValue, std::string_view( currentNode->name(), currentNode->name_size() ), currentValue );
             }
 
             attribute = currentNode->first_attribute( "id", 0 );
@@ -375,11 +523,7 @@ static bool BuildValueGraph( CValueList* valueList, xml_document<>* doc, std::ve
                 {
                     LOG_STRING_FORMAT( "Duplicated id \'%.*s\' found.\n", id.length(), id.data() );
                 }
-
-                SValue* idValue = valueList->AllocateValue();
-                currentValue->InsertObjectField( "id", idValue );
-                idValue->m_Type = EValueType::eString;
-                idValue->m_String = id;
+                // A matrix value has no fields to hold the id
             }
 
             currentValue->m_Matrix = XMFLOAT4X4( 1.0f, 0.0f, 0.0f, 0.0f,
@@ -452,12 +596,12 @@ static bool BuildValueGraph( CValueList* valueList, xml_document<>* doc, std::ve
                     if ( nameAttribute )
                     {
                         const std::string_view name( nameAttribute->value(), nameAttribute->value_size() );
-                        parentValue->InsertObjectField( name, refValue );
+                        valueList->InsertObjectField( parentValue, name, refValue );
                     }
                     else
                     {
                         const std::string_view& name = iter->second.first;
-                        parentValue->InsertNestedObject( name, refValue );
+                        valueList->InsertNestedObject( parentValue, name, refValue );
                     }
                 }
                 else
@@ -482,7 +626,7 @@ static bool BuildValueGraph( CValueList* valueList, xml_document<>* doc, std::ve
                 return false;
             }
             currentValue = valueList->AllocateValue();
-            parentValue->InsertObjectField( { nameAttribute->value(), nameAttribute->value_size() }, currentValue );
+            valueList->InsertObjectField( parentValue, { nameAttribute->value(), nameAttribute->value_size() }, currentValue );
 
             xml_attribute<>* valueAttribute = currentNode->first_attribute( "value", 0 );
             if ( !valueAttribute )
@@ -667,6 +811,51 @@ static std::filesystem::path GetAbsoluteExternalFilename( char buffer[ MAX_PATH
     return absoluteFilename;
 }
 
+struct SShapeToCreate
+{
+    SValue* m_ShapeValue;
+    const SValue* m_InstanceValue; // Set when the shape is created through a shapegroup instance
+};
+
+// A shapegroup only declares shapes, they are created once per instance referencing the group. Other shapes are created as they are.
+static void GatherShapesToCreate( SValue* shapeValue, std::vector<SShapeToCreate>* outShapes )
+{
+    const SValue* typeValue = shapeValue->FindObjectField( "type" );
+    if ( typeValue && typeValue->m_String == "shapegroup" )
+    {
+        return;
+    }
+
+    if ( typeValue && typeValue->m_String == "instance" )
+    {
+        SValue* shapeGroupValue = shapeValue->FindFirstNestedObject( "shape" );
+        const SValue* groupTypeValue = shapeGroupValue ? shapeGroupValue->FindObjectField( "type" ) : nullptr;
+        if ( !groupTypeValue || groupTypeValue->m_String != "shapegroup" )
+        {
+            LOG_STRING( "An instance does not reference a shapegroup.\n" );
+            return;
+        }
+
+        for ( auto& nestedObject : shapeGroupValue->GetNestedObjects() )
+        {
+            if ( nestedObject.first == "shape" )
+            {
+                outShapes->push_back( { nestedObject.second, shapeValue } );
+            }
+        }
+        return;
+    }
+
+    outShapes->push_back( { shapeValue, nullptr } );
+}
+
+static std::string GetSerializedShapeKey( const std::filesystem::path& filenamePath, int32_t shapeIndex, bool useFaceNormals )
+{
+    char suffix[ 32 ];
+    sprintf_s( suffix, "#%d%s", shapeIndex, useFaceNormals ? "#flat" : "" );
+    return filenamePath.u8string() + suffix;
+}
+
 int32_t SMaterialGatheringContext::GetOrAddTexture( const SValue* value )
 {
     int32_t textureIndex = INDEX_NONE;
@@ -1019,27 +1208,23 @@ bool SMaterialGatheringContext::CreateAndAddMaterial( const SValue& BSDF, uint32
 
 bool SMaterialGatheringContext::LoadTexturesFromFiles( CScene* scene )
 {
-    STextureCodec* codec = CTexture::CreateCodec();
-    if ( !codec )
-    {
-        return false;
-    }
+    // Slots are allocated upfront so texture indices assigned during gathering stay valid regardless of decode order
+    const size_t textureIndexBase = scene->m_Textures.size();
+    scene->m_Textures.resize( textureIndexBase + m_Textures.size() );
 
-    scene->m_Textures.reserve( scene->m_Textures.size() + m_Textures.size() );
-    for ( const STexture& texture : m_Textures )
+    std::vector<std::string> filenames;
+    filenames.reserve( m_Textures.size() );
+    for ( size_t iTexture = 0; iTexture < m_Textures.size(); ++iTexture )
     {
-        scene->m_Textures.emplace_back();
-        CTexture& newTexture = scene->m_Textures.back();
+        STexture& texture = m_Textures[ iTexture ];
+        filenames.emplace_back( std::move( texture.m_Filename ) );
+
+        CTexture& newTexture = scene->m_Textures[ textureIndexBase + iTexture ];
         newTexture.Clear();
         newTexture.m_Name = std::move( texture.m_Id );
-        if ( !newTexture.LoadFromFile( texture.m_Filename.c_str(), codec ) )
-        {
-            LOG_STRING_FORMAT( "Loading texture from file \"%s\" failed.\n", texture.m_Filename.c_str() );
-        }
     }
 
-    CTexture::DestroyCodec( codec );
-    return true;
+    return CTexture::LoadFromFiles( filenames.data(), scene->m_Textures.data() + textureIndexBase, (uint32_t)m_Textures.size() );
 }
 
 bool CScene::LoadFromXMLFile( const std::filesystem::path& filepath )
@@ -1052,23 +1237,35 @@ bool CScene::LoadFromXMLFile( const std::filesystem::path& filepath )
     ifstream.close();
 
     xml.emplace_back( '\0' );
-    xml_document<> doc;
-    doc.parse<parse_non_destructive>( xml.data() );
 
+    Timer parseTimer;
+    parseTimer.Start();
+
+    xml_document<> doc;
     CValueList valueList;
     std::vector<SValue*> sceneValues;
-    if ( !BuildValueGraph( &valueList, &doc, &sceneValues ) )
     {
-        LOG_STRING( "Failed to build value graph.\n" );
-        return false;
+        PROFILE_SCOPE( "Parse XML" );
+
+        doc.parse<parse_non_destructive>( xml.data() );
+
+        if ( !BuildValueGraph( &valueList, &doc, &sceneValues ) )
+        {
+            LOG_STRING( "Failed to build value graph.\n" );
+            return false;
+        }
+        valueList.Finalize();
     }
 
+    LOG_STRING_FORMAT( "Scene XML parsed in %.3f ms, %u values in %u KB of arena memory.\n", parseTimer.GetElapsedMicroseconds().count() / 1000.f
+        , valueList.GetValueCount(), (uint32_t)( valueList.GetAllocatedSize() / 1024 ) );
+
     if ( sceneValues.size() > 1 )
     {
         LOG_STRING( "The file contains more than 1 scenes, only the first one is supported.\n" );
     }
 
-    std::unordered_map<std::string_view, EShapeType> shapeNameToEnumMap = { { "obj", EShapeType::eObj }, { "rectangle", EShapeType::eRectangle } };
+    std::unordered_map<std::string_view, EShapeType> shapeNameToEnumMap = { { "obj", EShapeType::eObj }, { "ply", EShapeType::ePly }, { "serialized", EShapeType::eSerialized }, { "rectangle", EShapeType::eRectangle } };
     std::unordered_map<std::string_view, EXMLMaterialType> materialNameToEnumMap =
     {
           { "diffuse", EXMLMaterialType::eDiffuse }
@@ -1086,10 +1283,90 @@ bool CScene::LoadFromXMLFile( const std::filesystem::path& filepath )
 
     SMaterialGatheringContext materialGatheringContext( filepath, materialNameToEnumMap, &m_Materials, (uint32_t)m_Textures.size() );
 
-    std::unordered_map<std::string, uint32_t> objFileToMeshIndexMap;
+    std::unordered_map<std::string, uint32_t> meshFileToMeshIndexMap;
 	uint32_t rectangleMeshIndex = INDEX_NONE;
 
-    std::vector<std::pair<std::string_view, SValue*>>& rootObjectValues = *sceneValues[ 0 ]->m_NestedObjects;
+    const SNamedValueRange& rootObjectValues = sceneValues[ 0 ]->GetNestedObjects();
+
+    // Serialized files usually pack many shapes, decompress all the referenced ones up front in parallel
+    struct SSerializedShapeLoadRequest
+    {
+        std::filesystem::path m_FilenamePath;
+        std::string m_Name;
+        int32_t m_ShapeIndex;
+        bool m_UseFaceNormals;
+    };
+    std::vector<SSerializedShapeLoadRequest> serializedShapeLoadRequests;
+    std::unordered_map<std::string, uint32_t> serializedShapeKeyToRequestIndexMap;
+    std::vector<const SValue*> candidateShapeValues;
+    for ( auto& rootObjectValue : rootObjectValues )
+    {
+        if ( strncmp( "shape", rootObjectValue.first.data(), rootObjectValue.first.length() ) != 0 )
+        {
+            continue;
+        }
+        candidateShapeValues.push_back( rootObjectValue.second );
+        const SValue* typeValue = rootObjectValue.second->FindObjectField( "type" );
+        if ( typeValue && typeValue->m_String == "shapegroup" )
+        {
+            for ( auto& nestedObject : rootObjectValue.second->GetNestedObjects() )
+            {
+                if ( nestedObject.first == "shape" )
+                {
+                    candidateShapeValues.push_back( nestedObject.second );
+                }
+            }
+        }
+    }
+    for ( const SValue* shapeValue : candidateShapeValues )
+    {
+        const SValue* typeValue = shapeValue->FindObjectField( "type" );
+        const SValue* filenameValue = shapeValue->FindObjectField( "filename" );
+        if ( !typeValue || !filenameValue || typeValue->m_String != "serialized" )
+        {
+            continue;
+        }
+
+        char zeroTerminatedFilename[ MAX_PATH ];
+        SSerializedShapeLoadRequest request;
+        request.m_FilenamePath = GetAbsoluteExternalFilename( zeroTerminatedFilename, filepath, filenameValue->m_String );
+        request.m_ShapeIndex = shapeValue->GetObjectField<int32_t>( "shape_index", 0 );
+        request.m_UseFaceNormals = shapeValue->GetObjectField<bool>( "face_normals", false );
+        request.m_Name = zeroTerminatedFilename;
+        request.m_Name += "#" + std::to_string( request.m_ShapeIndex );
+        const std::string key = GetSerializedShapeKey( request.m_FilenamePath, request.m_ShapeIndex, request.m_UseFaceNormals );
+        if ( serializedShapeKeyToRequestIndexMap.insert( { key, (uint32_t)serializedShapeLoadRequests.size() } ).second )
+        {
+            serializedShapeLoadRequests.emplace_back( request );
+        }
+    }
+
+    std::vector<Mesh> serializedMeshes( serializedShapeLoadRequests.size() );
+    std::vector<uint8_t> serializedMeshLoaded( serializedShapeLoadRequests.size(), 0 );
+    if ( !serializedShapeLoadRequests.empty() )
+    {
+        PROFILE_SCOPE( "Load serialized shapes" );
+
+        Timer loadTimer;
+        loadTimer.Start();
+
+        SMeshProcessingParams processingParams;
+        processingParams.m_ApplyTransform = false;
+        processingParams.m_ChangeWindingOrder = true;
+        processingParams.m_FlipTexcoordV = false;
+        ParallelFor( (uint32_t)serializedShapeLoadRequests.size(), [&]( uint32_t workerIndex, uint32_t requestIndex )
+            {
+                const SSerializedShapeLoadRequest& request = serializedShapeLoadRequests[ requestIndex ];
+                if ( request.m_ShapeIndex >= 0 )
+                {
+                    serializedMeshLoaded[ requestIndex ] = serializedMeshes[ requestIndex ].LoadFromMitsubaSerializedFile( request.m_FilenamePath, (uint32_t)request.m_ShapeIndex, request.m_UseFaceNormals, processingParams );
+                }
+            } );
+
+        LOG_STRING_FORMAT( "%u serialized shapes loaded in %.3f ms with %u threads.\n", (uint32_t)serializedShapeLoadRequests.size(), loadTimer.GetElapsedMicroseconds().count() / 1000.f
+            , GetParallelForWorkerCount( (uint32_t)serializedShapeLoadRequests.size() ) );
+    }
+
     for ( auto& rootObjectValue : rootObjectValues )
     {
         if ( strncmp( "integrator", rootObjectValue.first.data(), rootObjectValue.first.length() ) == 0 )
@@ -1098,6 +1375,7 @@ bool CScene::LoadFromXMLFile( const std::filesystem::path& filepath )
             if ( strncmp( "path", typeValue->m_String.data(), typeValue->m_String.length() ) == 0 )
             {
                 m_MaxBounceCount = rootObjectValue.second->GetObjectField<int32_t>( "max_depth", 3 );
+                m_RussianRouletteBounceCount = rootObjectValue.second->GetObjectField<int32_t>( "rr_depth", 5 );
             }
             else
             {
@@ -1251,191 +1529,262 @@ bool CScene::LoadFromXMLFile( const std::filesystem::path& filepath )
         }
         else if ( strncmp( "shape", rootObjectValue.first.data(), rootObjectValue.first.length() ) == 0 )
         {
-            SValue* typeValue = rootObjectValue.second->FindObjectField( "type" );
-            if ( !typeValue )
+            std::vector<SShapeToCreate> shapesToCreate;
+            GatherShapesToCreate( rootObjectValue.second, &shapesToCreate );
+            for ( const SShapeToCreate& shapeToCreate : shapesToCreate )
             {
-                LOG_STRING( "Cannot determine the type of shape.\n" );
-            }
-            else
-            {
-                
-                SValue* transformValue = rootObjectValue.second->FindObjectField( "to_world" );
-                XMFLOAT4X4 transform = transformValue ? transformValue->m_Matrix : MathHelper::s_IdentityMatrix4x4;
+                SValue* shapeValue = shapeToCreate.m_ShapeValue;
+                SValue* typeValue = shapeValue->FindObjectField( "type" );
+                if ( !typeValue )
+                {
+                    LOG_STRING( "Cannot determine the type of shape.\n" );
+                }
+                else
+                {
+                    SValue* transformValue = shapeValue->FindObjectField( "to_world" );
+                    XMFLOAT4X4 transform = transformValue ? transformValue->m_Matrix : MathHelper::s_IdentityMatrix4x4;
+                    if ( shapeToCreate.m_InstanceValue )
+                    {
+                        const SValue* instanceTransformValue = shapeToCreate.m_InstanceValue->FindObjectField( "to_world" );
+                        XMFLOAT4X4 instanceTransform = instanceTransformValue ? instanceTransformValue->m_Matrix : MathHelper::s_IdentityMatrix4x4;
+                        if ( transformValue )
+                        {
+                            // Both transforms have the handedness conversion applied, undo the one of the shape so it is only applied once
+                            transform._11 = -transform._11;
+                            transform._21 = -transform._21;
+                            transform._31 = -transform._31;
+                            transform._41 = -transform._41;
+                            XMStoreFloat4x4( &transform, XMMatrixMultiply( XMLoadFloat4x4( &transform ), XMLoadFloat4x4( &instanceTransform ) ) );
+                        }
+                        else
+                        {
+                            transform = instanceTransform;
+                        }
+                    }
 
-                SValue* emitterValue = rootObjectValue.second->FindFirstNestedObject( "emitter" );
-                bool isALight = emitterValue != nullptr;
+                    SValue* emitterValue = shapeValue->FindFirstNestedObject( "emitter" );
+                    bool isALight = emitterValue != nullptr;
 
-                uint32_t materialId = INVALID_MATERIAL_ID;
-                SValue* bsdfValue = rootObjectValue.second->FindFirstNestedObject( "bsdf" );
-                if ( bsdfValue )
-                {
-                    auto iter = materialGatheringContext.m_BSDFToIdMap.find( bsdfValue );
-                    if ( iter == materialGatheringContext.m_BSDFToIdMap.end() )
+                    uint32_t materialId = INVALID_MATERIAL_ID;
+                    SValue* bsdfValue = shapeValue->FindFirstNestedObject( "bsdf" );
+                    if ( bsdfValue )
                     {
-                        materialGatheringContext.CreateAndAddMaterial( *bsdfValue, &materialId );
+                        auto iter = materialGatheringContext.m_BSDFToIdMap.find( bsdfValue );
+                        if ( iter == materialGatheringContext.m_BSDFToIdMap.end() )
+                        {
+                            materialGatheringContext.CreateAndAddMaterial( *bsdfValue, &materialId );
+                        }
+                        else
+                        {
+                            materialId = iter->second;
+                        }
                     }
-                    else
+                    else if ( isALight )
                     {
-                        materialId = iter->second;
+                        // Assign a pitch black non-reflective material to light
+                        materialId = (uint32_t)m_Materials.size();
+                        SMaterial material;
+                        material.m_Albedo = XMFLOAT3( 0.f, 0.f, 0.f );
+                        material.m_Roughness = 0.f;
+                        material.m_IOR = XMFLOAT3( 1.f, 1.f, 1.f );
+                        material.m_Opacity = 1.f;
+                        material.m_MaterialType = EMaterialType::Diffuse;
+                        material.m_AlbedoTextureIndex = INDEX_NONE;
+                        material.m_OpacityTextureIndex = INDEX_NONE;
+                        material.m_Multiscattering = false;
+                        material.m_IsTwoSided = false;
+                        material.m_HasRoughnessTexture = false;
+                        material.m_InternalScatteringMode = INTERNAL_SCATTERING_MODE_MULTIPLE;
+                        material.m_Name = "LightMaterial";
+                        m_Materials.emplace_back( material );
                     }
-                }
-                else if ( isALight )
-                {
-                    // Assign a pitch black non-reflective material to light
-                    materialId = (uint32_t)m_Materials.size();
-                    SMaterial material;
-                    material.m_Albedo = XMFLOAT3( 0.f, 0.f, 0.f );
-                    material.m_Roughness = 0.f;
-                    material.m_IOR = XMFLOAT3( 1.f, 1.f, 1.f );
-                    material.m_Opacity = 1.f;
-                    material.m_MaterialType = EMaterialType::Diffuse;
-                    material.m_AlbedoTextureIndex = INDEX_NONE;
-                    material.m_OpacityTextureIndex = INDEX_NONE;
-                    material.m_Multiscattering = false;
-                    material.m_IsTwoSided = false;
-                    material.m_HasRoughnessTexture = false;
-                    material.m_InternalScatteringMode = INTERNAL_SCATTERING_MODE_MULTIPLE;
-                    material.m_Name = "LightMaterial";
-                    m_Materials.emplace_back( material );
-                }
 
-                EShapeType shapeType = EShapeType::Unsupported;
-                auto itShapeType = shapeNameToEnumMap.find( typeValue->m_String );
-                if ( itShapeType != shapeNameToEnumMap.end() )
-                {
-                    shapeType = itShapeType->second;
-                }
-
-                bool instanceCreated = false;
-                uint32_t meshIndex = 0;
-                switch ( shapeType )
-                {
-                case EShapeType::eObj:
-                {
-                    SValue* filenameValue = rootObjectValue.second->FindObjectField( "filename" );
-                    if ( !filenameValue )
+                    EShapeType shapeType = EShapeType::Unsupported;
+                    auto itShapeType = shapeNameToEnumMap.find( typeValue->m_String );
+                    if ( itShapeType != shapeNameToEnumMap.end() )
                     {
-                        LOG_STRING( "Cannot find filename of an obj shape.\n" );
+                        shapeType = itShapeType->second;
                     }
-                    else
-                    {
-                        char zeroTerminatedFilename[ MAX_PATH ];
-                        const std::filesystem::path filenamePath = GetAbsoluteExternalFilename( zeroTerminatedFilename, filepath, filenameValue->m_String );
-                        const std::string filenameKey = filenamePath.u8string();
 
-                        auto existingMeshIt = objFileToMeshIndexMap.find( filenameKey );
-                        if ( existingMeshIt != objFileToMeshIndexMap.end() )
+                    bool instanceCreated = false;
+                    uint32_t meshIndex = 0;
+                    switch ( shapeType )
+                    {
+                    case EShapeType::eObj:
+                    case EShapeType::ePly:
+                    {
+                        SValue* filenameValue = shapeValue->FindObjectField( "filename" );
+                        if ( !filenameValue )
                         {
-                            meshIndex = existingMeshIt->second;
-                            instanceCreated = true;
+                            LOG_STRING_FORMAT( "Cannot find filename of an %.*s shape.\n", typeValue->m_String.length(), typeValue->m_String.data() );
                         }
                         else
                         {
-                            SMeshProcessingParams processingParams;
-                            processingParams.m_ApplyTransform = false;
-                            processingParams.m_ChangeWindingOrder = true;
-                            processingParams.m_FlipTexcoordV = true;
-
-                            m_Meshes.emplace_back();
-                            Mesh& newMesh = m_Meshes.back();
-                            if ( newMesh.LoadFromWavefrontOBJFile( filenamePath, processingParams, nullptr, nullptr ) )
+                            char zeroTerminatedFilename[ MAX_PATH ];
+                            const std::filesystem::path filenamePath = GetAbsoluteExternalFilename( zeroTerminatedFilename, filepath, filenameValue->m_String );
+                            const std::string filenameKey = filenamePath.u8string();
+
+                            auto existingMeshIt = meshFileToMeshIndexMap.find( filenameKey );
+                            if ( existingMeshIt != meshFileToMeshIndexMap.end() )
                             {
-                                newMesh.SetName( zeroTerminatedFilename );
-                                meshIndex = (uint32_t)m_Meshes.size() - 1;
-                                objFileToMeshIndexMap.insert( { filenameKey, meshIndex } );
+                                meshIndex = existingMeshIt->second;
                                 instanceCreated = true;
                             }
                             else
                             {
-                                m_Meshes.pop_back();
-                                LOG_STRING_FORMAT( "Failed to load wavefront obj file \'%s\'.\n", filenamePath.u8string().c_str() );
+                                SMeshProcessingParams processingParams;
+                                processingParams.m_ApplyTransform = false;
+                                processingParams.m_ChangeWindingOrder = true;
+                                // Mitsuba flips V when reading OBJ files, PLY texcoords are stored in the flipped convention already
+                                processingParams.m_FlipTexcoordV = shapeType == EShapeType::eObj;
+
+                                m_Meshes.emplace_back();
+                                Mesh& newMesh = m_Meshes.back();
+                                const bool loadSuccessful = shapeType == EShapeType::eObj ? newMesh.LoadFromWavefrontOBJFile( filenamePath, processingParams, nullptr, nullptr )
+                                    : newMesh.LoadFromPLYFile( filenamePath, processingParams );
+                                if ( loadSuccessful )
+                                {
+                                    newMesh.SetName( zeroTerminatedFilename );
+                                    meshIndex = (uint32_t)m_Meshes.size() - 1;
+                                    meshFileToMeshIndexMap.insert( { filenameKey, meshIndex } );
+                                    instanceCreated = true;
+                                }
+                                else
+                                {
+                                    m_Meshes.pop_back();
+                                    LOG_STRING_FORMAT( "Failed to load %.*s file \'%s\'.\n", typeValue->m_String.length(), typeValue->m_String.data(), filenamePath.u8string().c_str() );
+                                }
                             }
                         }
-                    }
 
-                    break;
-                }
-                case EShapeType::eRectangle:
-                {
-                    if ( rectangleMeshIndex == INDEX_NONE )
+                        break;
+                    }
+                    case EShapeType::eSerialized:
                     {
-                        Mesh mesh;
-                        if ( mesh.GenerateRectangle( materialId, true, MathHelper::s_IdentityMatrix4x4 ) )
+                        SValue* filenameValue = shapeValue->FindObjectField( "filename" );
+                        if ( !filenameValue )
                         {
-                            mesh.SetName( "rectangle" );
-							rectangleMeshIndex = (uint32_t)m_Meshes.size();
-                            m_Meshes.emplace_back( mesh );
+                            LOG_STRING( "Cannot find filename of a serialized shape.\n" );
+                            break;
                         }
-                        else
+
+                        char zeroTerminatedFilename[ MAX_PATH ];
+                        const std::filesystem::path filenamePath = GetAbsoluteExternalFilename( zeroTerminatedFilename, filepath, filenameValue->m_String );
+                        const int32_t shapeIndex = shapeValue->GetObjectField<int32_t>( "shape_index", 0 );
+                        const std::string shapeKey = GetSerializedShapeKey( filenamePath, shapeIndex, shapeValue->GetObjectField<bool>( "face_normals", false ) );
+
+                        auto existingMeshIt = meshFileToMeshIndexMap.find( shapeKey );
+                        if ( existingMeshIt != meshFileToMeshIndexMap.end() )
                         {
-                            LOG_STRING( "Failed to generate rectangle shape.\n" );
+                            meshIndex = existingMeshIt->second;
+                            instanceCreated = true;
                             break;
                         }
-					}
-                    meshIndex = rectangleMeshIndex;
-                    instanceCreated = true;
-                    break;
-                }
-                case EShapeType::Unsupported:
-                default:
-                {
-                    LOG_STRING_FORMAT( "Unsupported shape type \'%.*s\'\n", typeValue->m_String.length(), typeValue->m_String.data() );
-                    break;
-                }
-                }
 
-                if ( instanceCreated )
-                {
-                    std::string id;
-                    if ( const SValue* idValue = rootObjectValue.second->FindObjectField( "id" ) )
-                    {
-                        id = idValue->Get<std::string_view>();
+                        auto requestIt = serializedShapeKeyToRequestIndexMap.find( shapeKey );
+                        if ( requestIt != serializedShapeKeyToRequestIndexMap.end() && serializedMeshLoaded[ requestIt->second ] )
+                        {
+                            m_Meshes.emplace_back( std::move( serializedMeshes[ requestIt->second ] ) );
+                            m_Meshes.back().SetName( serializedShapeLoadRequests[ requestIt->second ].m_Name );
+                            meshIndex = (uint32_t)m_Meshes.size() - 1;
+                            meshFileToMeshIndexMap.insert( { shapeKey, meshIndex } );
+                            instanceCreated = true;
+                        }
+                        else
+                        {
+                            LOG_STRING_FORMAT( "Failed to load shape %d from serialized file \'%s\'.\n", shapeIndex, filenamePath.u8string().c_str() );
+                        }
+                        break;
                     }
-                    else
+                    case EShapeType::eRectangle:
                     {
-						char generatedIdBuffer[ 64 ];
-                        sprintf_s( generatedIdBuffer, "Unnamed shape %03d", (uint32_t)m_MeshInstances.size() );
-						id = generatedIdBuffer;
+                        if ( rectangleMeshIndex == INDEX_NONE )
+                        {
+                            Mesh mesh;
+                            if ( mesh.GenerateRectangle( materialId, true, MathHelper::s_IdentityMatrix4x4 ) )
+                            {
+                                mesh.SetName( "rectangle" );
+								rectangleMeshIndex = (uint32_t)m_Meshes.size();
+                                m_Meshes.emplace_back( mesh );
+                            }
+                            else
+                            {
+                                LOG_STRING( "Failed to generate rectangle shape.\n" );
+                                break;
+                            }
+						}
+                        meshIndex = rectangleMeshIndex;
+                        instanceCreated = true;
+                        break;
                     }
-
-                    uint32_t instanceIndex = (uint32_t)m_MeshInstances.size();
-
-                    SMeshInstance instance;
-                    instance.m_Name = id;
-                    instance.m_MeshIndex = meshIndex;
-                    instance.m_MaterialIdOverride = materialId;
-                    m_MeshInstances.emplace_back( instance );
-                    m_InstanceTransforms.push_back( XMFLOAT4X3( transform._11, transform._12, transform._13, transform._21, transform._22, transform._23, transform._31, transform._32, transform._33, transform._41, transform._42, transform._43 ) );
-
-                    if ( GetLightCount() >= s_MaxLightsCount )
+                    case EShapeType::Unsupported:
+                    default:
                     {
-                        LOG_STRING( "An emitter is discarded since maximum light count is hit." );
-                        continue;
+                        LOG_STRING_FORMAT( "Unsupported shape type \'%.*s\'\n", typeValue->m_String.length(), typeValue->m_String.data() );
+                        break;
+                    }
                     }
 
-                    if ( isALight )
+                    if ( instanceCreated )
                     {
-                        const SValue* typeValue = emitterValue->FindObjectField( "type" );
-                        if ( typeValue && typeValue->m_Type == EValueType::eString )
+                        std::string id;
+                        if ( const SValue* idValue = shapeValue->FindObjectField( "id" ) )
                         {
-                            if ( strncmp( "area", typeValue->m_String.data(), typeValue->m_String.length() ) == 0 )
+                            id = idValue->Get<std::string_view>();
+                        }
+                        else
+                        {
+							char generatedIdBuffer[ 64 ];
+                            sprintf_s( generatedIdBuffer, "Unnamed shape %03d", (uint32_t)m_MeshInstances.size() );
+							id = generatedIdBuffer;
+                        }
+                        if ( shapeToCreate.m_InstanceValue )
+                        {
+                            if ( const SValue* instanceIdValue = shapeToCreate.m_InstanceValue->FindObjectField( "id" ) )
                             {
-                                SMeshLight light;
-                                light.m_InstanceIndex = instanceIndex;
+                                id = std::string( instanceIdValue->Get<std::string_view>() ) + "/" + id;
+                            }
+                        }
+
+                        uint32_t instanceIndex = (uint32_t)m_MeshInstances.size();
+
+                        SMeshInstance instance;
+                        instance.m_Name = id;
+                        instance.m_MeshIndex = meshIndex;
+                        instance.m_MaterialIdOverride = materialId;
+                        m_MeshInstances.emplace_back( instance );
+                        m_InstanceTransforms.push_back( XMFLOAT4X3( transform._11, transform._12, transform._13, transform._21, transform._22, transform._23, transform._31, transform._32, transform._33, transform._41, transform._42, transform._43 ) );
 
-                                light.color = emitterValue->GetObjectField<XMFLOAT3>( "radiance", XMFLOAT3( 1.f, 1.f, 1.f ) );
+                        if ( GetLightCount() >= s_MaxLightsCount )
+                        {
+                            LOG_STRING( "An emitter is discarded since maximum light count is hit." );
+                            continue;
+                        }
 
-                                m_MeshLights.emplace_back( light );
+                        if ( isALight )
+                        {
+                            const SValue* typeValue = emitterValue->FindObjectField( "type" );
+                            if ( typeValue && typeValue->m_Type == EValueType::eString )
+                            {
+                                if ( strncmp( "area", typeValue->m_String.data(), typeValue->m_String.length() ) == 0 )
+                                {
+                                    SMeshLight light;
+                                    light.m_InstanceIndex = instanceIndex;
+
+                                    light.color = emitterValue->GetObjectField<XMFLOAT3>( "radiance", XMFLOAT3( 1.f, 1.f, 1.f ) );
+
+                                    m_MeshLights.emplace_back( light );
+                                }
+                                else
+                                {
+                                    LOG_STRING_FORMAT( "Unsupported emitter type nested in a shape \'%.*s\'.\n", typeValue->m_String.length(), typeValue->m_String.data() );
+                                }
                             }
                             else
                             {
-                                LOG_STRING_FORMAT( "Unsupported emitter type nested in a shape \'%.*s\'.\n", typeValue->m_String.length(), typeValue->m_String.data() );
+                                LOG_STRING( "Cannot determine emitter type.\n" );
                             }
                         }
-                        else
-                        {
-                            LOG_STRING( "Cannot determine emitter type.\n" );
-                        }
                     }
                 }
             }
@@ -1510,3 +1859,91 @@ bool CScene::LoadFromXMLFile( const std::filesystem::path& filepath )
 
     return true;
 }
+
+// Generates a scene with the given number of shapes, each with its own material and transform, in the layout Mitsuba exporters write
+static void GenerateSyntheticSceneXML( uint32_t shapeCount, std::vector<char>* xml )
+{
+    std::string text;
+    text.reserve( (size_t)shapeCount * 512 );
+    text += "<scene version=\"3.0.0\">\n"
+        "\t<default name=\"spp\" value=\"64\"/>\n"
+        "\t<integrator type=\"path\">\n\t\t<integer name=\"max_depth\" value=\"8\"/>\n\t</integrator>\n"
+        "\t<sensor type=\"perspective\">\n\t\t<float name=\"fov\" value=\"45\"/>\n"
+        "\t\t<transform name=\"to_world\">\n\t\t\t<matrix value=\"1 0 0 0 0 1 0 0 0 0 1 -10 0 0 0 1\"/>\n\t\t</transform>\n"
+        "\t\t<sampler type=\"independent\">\n\t\t\t<integer name=\"sample_count\" value=\"$spp\"/>\n\t\t</sampler>\n"
+        "\t\t<film type=\"hdrfilm\">\n\t\t\t<integer name=\"width\" value=\"1280\"/>\n\t\t\t<integer name=\"height\" value=\"720\"/>\n\t\t</film>\n"
+        "\t</sensor>\n";
+
+    char buffer[ 1024 ];
+    for ( uint32_t i = 0; i < shapeCount; ++i )
+    {
+        const float shade = ( i % 100 ) / 100.f;
+        snprintf( buffer, sizeof( buffer ),
+            "\t<bsdf type=\"twosided\" id=\"Material%u\">\n"
+            "\t\t<bsdf type=\"roughplastic\">\n"
+            "\t\t\t<float name=\"alpha\" value=\"%.3f\"/>\n"
+            "\t\t\t<float name=\"int_ior\" value=\"1.5\"/>\n"
+            "\t\t\t<rgb name=\"diffuse_reflectance\" value=\"%.3f, %.3f, %.3f\"/>\n"
+            "\t\t</bsdf>\n"
+            "\t</bsdf>\n",
+            i, 0.05f + shade * 0.5f, shade, 1.f - shade, 0.5f );
+        text += buffer;
+    }
+    for ( uint32_t i = 0; i < shapeCount; ++i )
+    {
+        snprintf( buffer, sizeof( buffer ),
+            "\t<shape type=\"obj\" id=\"Shape%u\">\n"
+            "\t\t<string name=\"filename\" value=\"meshes/Mesh%u.obj\"/>\n"
+            "\t\t<transform name=\"to_world\">\n"
+            "\t\t\t<matrix value=\"1 0 0 %u 0 1 0 %u 0 0 1 %u 0 0 0 1\"/>\n"
+            "\t\t</transform>\n"
+            "\t\t<boolean name=\"face_normals\" value=\"true\"/>\n"
+            "\t\t<ref id=\"Material%u\"/>\n"
+            "\t</shape>\n",
+            i, i % 1000, i % 17, i % 31, i % 43, i );
+        text += buffer;
+    }
+    text += "</scene>\n";
+
+    xml->assign( text.begin(), text.end() );
+    xml->emplace_back( '\0' );
+}
+
+void RunXMLParsingBenchmark( uint32_t shapeCount )
+{
+    std::vector<char> xml;
+    GenerateSyntheticSceneXML( shapeCount, &xml );
+    LOG_STRING_FORMAT( "Benchmarking XML parsing of a synthetic scene with %u shapes and %u materials (%.2f MB).\n", shapeCount, shapeCount, xml.size() / ( 1024.f * 1024.f ) );
+
+    const uint32_t s_RunCount = 5;
+    float minParseMilliseconds = FLT_MAX;
+    float minBuildMilliseconds = FLT_MAX;
+    for ( uint32_t iRun = 0; iRun < s_RunCount; ++iRun )
+    {
+        Timer timer;
+        timer.Start();
+
+        xml_document<> doc;
+        doc.parse<parse_non_destructive>( xml.data() );
+        const float parseMilliseconds = timer.GetElapsedMicroseconds().count() / 1000.f;
+
+        CValueList valueList;
+        std::vector<SValue*> sceneValues;
+        if ( !BuildValueGraph( &valueList, &doc, &sceneValues ) )
+        {
+            LOG_STRING( "Failed to build value graph.\n" );
+            return;
+        }
+        valueList.Finalize();
+        const float buildMilliseconds = timer.GetElapsedMicroseconds().count() / 1000.f - parseMilliseconds;
+
+        minParseMilliseconds = std::min( minParseMilliseconds, parseMilliseconds );
+        minBuildMilliseconds = std::min( minBuildMilliseconds, buildMilliseconds );
+        if ( iRun == s_RunCount - 1 )
+        {
+            LOG_STRING_FORMAT( "%u values in %u KB of arena memory. Best of %u runs: XML parsed in %.3f ms, value graph built in %.3f ms, %.2f MB/s overall.\n",
+                valueList.GetValueCount(), (uint32_t)( valueList.GetAllocatedSize() / 1024 ), s_RunCount, minParseMilliseconds, minBuildMilliseconds,
+                xml.size() / ( 1024.f * 1024.f ) / std::max( ( minParseMilliseconds + minBuildMilliseconds ) / 1000.f, 1e-6f ) );
+        }
+    }
+}
\ No newline at end of file
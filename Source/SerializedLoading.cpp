@@ -0,0 +1,273 @@
+#include "stdafx.h"
+#include "Mesh.h"
+#include "MappedFile.h"
+#include "Inflate.h"
+#include "Logging.h"
+#include "Profiling.h"
+
+using namespace DirectX;
+
+// Mitsuba serialized mesh format, see Mitsuba's serialized shape plugin documentation
+#define SERIALIZED_FORMAT_IDENTIFIER        0x041C
+#define SERIALIZED_FLAG_VERTEX_NORMALS      0x0001
+#define SERIALIZED_FLAG_TEXCOORDS           0x0002
+#define SERIALIZED_FLAG_VERTEX_COLORS       0x0008
+#define SERIALIZED_FLAG_FACE_NORMALS        0x0010
+#define SERIALIZED_FLAG_SINGLE_PRECISION    0x1000
+#define SERIALIZED_FLAG_DOUBLE_PRECISION    0x2000
+
+class CSerializedStreamReader
+{
+public:
+    CSerializedStreamReader( const uint8_t* data, size_t size ) : m_Data( data ), m_Size( size ), m_Position( 0 ) {}
+
+    template <typename T>
+    bool Read( T* value )
+    {
+        if ( m_Position + sizeof( T ) > m_Size )
+        {
+            return false;
+        }
+        memcpy( value, m_Data + m_Position, sizeof( T ) );
+        m_Position += sizeof( T );
+        return true;
+    }
+
+    bool ReadString( std::string* value )
+    {
+        const uint8_t* terminator = (const uint8_t*)memchr( m_Data + m_Position, 0, m_Size - m_Position );
+        if ( !terminator )
+        {
+            return false;
+        }
+        value->assign( (const char*)m_Data + m_Position, (const char*)terminator );
+        m_Position = terminator - m_Data + 1;
+        return true;
+    }
+
+    // Reads componentCount floats or doubles per element into the destination which has a stride of destinationStride bytes
+    bool ReadFloatArray( uint64_t elementCount, uint32_t componentCount, bool isDoublePrecision, float* destination, size_t destinationStride )
+    {
+        const size_t componentSize = isDoublePrecision ? sizeof( double ) : sizeof( float );
+        const size_t readSize = (size_t)elementCount * componentCount * componentSize;
+        if ( readSize > m_Size - m_Position )
+        {
+            return false;
+        }
+
+        const uint8_t* source = m_Data + m_Position;
+        for ( uint64_t iElement = 0; iElement < elementCount; ++iElement )
+        {
+            float* elementDestination = (float*)( (uint8_t*)destination + iElement * destinationStride );
+            for ( uint32_t iComponent = 0; iComponent < componentCount; ++iComponent )
+            {
+                if ( isDoublePrecision )
+                {
+                    double value;
+                    memcpy( &value, source, sizeof( double ) );
+                    elementDestination[ iComponent ] = (float)value;
+                }
+                else
+                {
+                    memcpy( elementDestination + iComponent, source, sizeof( float ) );
+                }
+                source += componentSize;
+            }
+        }
+        m_Position += readSize;
+        return true;
+    }
+
+    bool Skip( size_t size )
+    {
+        if ( size > m_Size - m_Position )
+        {
+            return false;
+        }
+        m_Position += size;
+        return true;
+    }
+
+private:
+    const uint8_t* m_Data;
+    size_t m_Size;
+    size_t m_Position;
+};
+
+// Locates the compressed stream of a shape through the offset table at the end of the file
+static bool FindSerializedShape( const uint8_t* data, size_t size, uint32_t shapeIndex, const uint8_t** outShapeData, size_t* outShapeSize, uint16_t* outVersion )
+{
+    if ( size < sizeof( uint16_t ) * 2 + sizeof( uint32_t ) )
+    {
+        return false;
+    }
+
+    uint16_t version;
+    memcpy( &version, data + sizeof( uint16_t ), sizeof( uint16_t ) );
+
+    uint32_t shapeCount;
+    memcpy( &shapeCount, data + size - sizeof( uint32_t ), sizeof( uint32_t ) );
+    if ( shapeIndex >= shapeCount )
+    {
+        LOG_STRING_FORMAT( "Shape index %u is out of range, the file contains %u shapes.\n", shapeIndex, shapeCount );
+        return false;
+    }
+
+    // Version 4 uses 64-bit offsets, version 3 uses 32-bit offsets
+    const size_t offsetSize = version >= 4 ? sizeof( uint64_t ) : sizeof( uint32_t );
+    const size_t tableSize = offsetSize * shapeCount + sizeof( uint32_t );
+    if ( tableSize > size )
+    {
+        return false;
+    }
+    const uint8_t* table = data + size - tableSize;
+
+    auto ReadOffset = [&]( uint32_t index )
+    {
+        uint64_t offset = 0;
+        memcpy( &offset, table + index * offsetSize, offsetSize );
+        return offset;
+    };
+
+    const uint64_t shapeBegin = ReadOffset( shapeIndex );
+    const uint64_t shapeEnd = shapeIndex + 1 < shapeCount ? ReadOffset( shapeIndex + 1 ) : (uint64_t)( table - data );
+    if ( shapeBegin + sizeof( uint16_t ) * 2 > shapeEnd || shapeEnd > (uint64_t)( table - data ) )
+    {
+        return false;
+    }
+
+    uint16_t identifier;
+    memcpy( &identifier, data + shapeBegin, sizeof( uint16_t ) );
+    memcpy( outVersion, data + shapeBegin + sizeof( uint16_t ), sizeof( uint16_t ) );
+    if ( identifier != SERIALIZED_FORMAT_IDENTIFIER )
+    {
+        LOG_STRING( "Invalid serialized shape identifier.\n" );
+        return false;
+    }
+
+    *outShapeData = data + shapeBegin + sizeof( uint16_t ) * 2;
+    *outShapeSize = (size_t)( shapeEnd - shapeBegin ) - sizeof( uint16_t ) * 2;
+    return true;
+}
+
+bool Mesh::LoadFromMitsubaSerializedFile( const std::filesystem::path& filenamePath, uint32_t shapeIndex, bool useFaceNormals, const SMeshProcessingParams& params )
+{
+    PROFILE_SCOPE( "Load serialized shape" );
+
+    const std::string filename = filenamePath.u8string();
+    LOG_STRING_FORMAT( "Loading mesh from: %s, shape index %u\n", filename.c_str(), shapeIndex );
+
+    CMappedFile file;
+    if ( !file.Open( filenamePath ) )
+    {
+        LOG_STRING_FORMAT( "Cannot map serialized file \'%s\'.\n", filename.c_str() );
+        return false;
+    }
+
+    const uint8_t* compressedData = nullptr;
+    size_t compressedSize = 0;
+    uint16_t version = 0;
+    if ( !FindSerializedShape( file.GetData(), file.GetSize(), shapeIndex, &compressedData, &compressedSize, &version ) )
+    {
+        LOG_STRING_FORMAT( "Cannot locate shape %u in serialized file \'%s\'.\n", shapeIndex, filename.c_str() );
+        return false;
+    }
+
+    std::vector<uint8_t> decompressedData;
+    decompressedData.reserve( compressedSize * 4 );
+    if ( !InflateZlibStream( compressedData, compressedSize, &decompressedData ) )
+    {
+        LOG_STRING_FORMAT( "Decompressing shape %u in serialized file \'%s\' failed.\n", shapeIndex, filename.c_str() );
+        return false;
+    }
+    file.Close();
+
+    CSerializedStreamReader reader( decompressedData.data(), decompressedData.size() );
+    uint32_t flags = 0;
+    std::string shapeName;
+    uint64_t vertexCount = 0;
+    uint64_t triangleCount = 0;
+    if ( !reader.Read( &flags )
+        || ( version >= 4 && !reader.ReadString( &shapeName ) )
+        || !reader.Read( &vertexCount )
+        || !reader.Read( &triangleCount ) )
+    {
+        LOG_STRING( "Serialized shape header is truncated.\n" );
+        return false;
+    }
+
+    if ( vertexCount == 0 || triangleCount == 0 )
+    {
+        LOG_STRING( "Serialized shape contains no triangles.\n" );
+        return false;
+    }
+
+    if ( vertexCount > UINT_MAX || triangleCount * 3 > UINT_MAX )
+    {
+        LOG_STRING( "Serialized shape exceeds the maximum vertex or index count.\n" );
+        return false;
+    }
+
+    const bool isDoublePrecision = ( flags & SERIALIZED_FLAG_DOUBLE_PRECISION ) != 0;
+    const bool hasNormals = ( flags & SERIALIZED_FLAG_VERTEX_NORMALS ) != 0;
+    const bool hasTexcoords = ( flags & SERIALIZED_FLAG_TEXCOORDS ) != 0;
+    std::vector<GPU::Vertex> vertices( (size_t)vertexCount );
+    memset( vertices.data(), 0, vertices.size() * sizeof( GPU::Vertex ) );
+    bool succeeded = reader.ReadFloatArray( vertexCount, 3, isDoublePrecision, &vertices[ 0 ].position.x, sizeof( GPU::Vertex ) );
+    if ( succeeded && hasNormals )
+    {
+        succeeded = reader.ReadFloatArray( vertexCount, 3, isDoublePrecision, &vertices[ 0 ].normal.x, sizeof( GPU::Vertex ) );
+    }
+    if ( succeeded && hasTexcoords )
+    {
+        succeeded = reader.ReadFloatArray( vertexCount, 2, isDoublePrecision, &vertices[ 0 ].texcoord.x, sizeof( GPU::Vertex ) );
+    }
+    if ( succeeded && ( flags & SERIALIZED_FLAG_VERTEX_COLORS ) != 0 )
+    {
+        succeeded = reader.Skip( (size_t)vertexCount * 3 * ( isDoublePrecision ? sizeof( double ) : sizeof( float ) ) );
+    }
+
+    // Indices are 32-bit since vertex count is limited to UINT_MAX above
+    std::vector<uint32_t> indices( (size_t)triangleCount * 3 );
+    if ( succeeded )
+    {
+        for ( uint32_t& index : indices )
+        {
+            if ( !reader.Read( &index ) || index >= vertexCount )
+            {
+                succeeded = false;
+                break;
+            }
+        }
+    }
+
+    if ( !succeeded )
+    {
+        LOG_STRING( "Serialized shape data is truncated or corrupted.\n" );
+        return false;
+    }
+
+    // Flat shading requires the vertices to be unwelded so each triangle carries its own normal
+    if ( useFaceNormals || ( flags & SERIALIZED_FLAG_FACE_NORMALS ) != 0 )
+    {
+        std::vector<GPU::Vertex> unweldedVertices( indices.size() );
+        for ( size_t iIndex = 0; iIndex < indices.size(); iIndex += 3 )
+        {
+            GPU::Vertex* triangleVertices = unweldedVertices.data() + iIndex;
+            triangleVertices[ 0 ] = vertices[ indices[ iIndex ] ];
+            triangleVertices[ 1 ] = vertices[ indices[ iIndex + 1 ] ];
+            triangleVertices[ 2 ] = vertices[ indices[ iIndex + 2 ] ];
+            XMVECTOR vP0 = XMLoadFloat3( &triangleVertices[ 0 ].position );
+            XMVECTOR vFaceNormal = XMVector3Normalize( XMVector3Cross( XMLoadFloat3( &triangleVertices[ 1 ].position ) - vP0, XMLoadFloat3( &triangleVertices[ 2 ].position ) - vP0 ) );
+            for ( uint32_t iVertex = 0; iVertex < 3; ++iVertex )
+            {
+                XMStoreFloat3( &triangleVertices[ iVertex ].normal, vFaceNormal );
+                indices[ iIndex + iVertex ] = (uint32_t)( iIndex + iVertex );
+            }
+        }
+        vertices = std::move( unweldedVertices );
+        return AppendTriangles( &vertices, &indices, true, params );
+    }
+
+    return AppendTriangles( &vertices, &indices, hasNormals, params );
+}
@@ -0,0 +1,230 @@
+#include "stdafx.h"
+#include "SphericalTriangle.h"
+#include "../Shaders/LightSharedDef.inc.hlsl"
+#include "Logging.h"
+
+using namespace DirectX;
+
+static float SafeSqrt( float value )
+{
+    return sqrtf( std::max( 0.f, value ) );
+}
+
+static float SafeAsin( float value )
+{
+    return asinf( std::clamp( value, -1.f, 1.f ) );
+}
+
+static float AngleBetween( FXMVECTOR v0, FXMVECTOR v1 )
+{
+    return XMVectorGetX( XMVector3Dot( v0, v1 ) ) < 0.f ? (float)M_PI - 2.f * SafeAsin( XMVectorGetX( XMVector3Length( v0 + v1 ) ) * .5f )
+        : 2.f * SafeAsin( XMVectorGetX( XMVector3Length( v1 - v0 ) ) * .5f );
+}
+
+static XMVECTOR GramSchmidt( FXMVECTOR v, FXMVECTOR w )
+{
+    return v - w * XMVectorGetX( XMVector3Dot( v, w ) );
+}
+
+float CalculateSphericalTriangleSolidAngle( FXMVECTOR a, FXMVECTOR b, FXMVECTOR c )
+{
+    const float y = XMVectorGetX( XMVector3Dot( a, XMVector3Cross( b, c ) ) );
+    const float x = 1.f + XMVectorGetX( XMVector3Dot( a, b ) ) + XMVectorGetX( XMVector3Dot( a, c ) ) + XMVectorGetX( XMVector3Dot( b, c ) );
+    return fabsf( 2.f * atan2f( y, x ) );
+}
+
+XMVECTOR SampleSphericalTriangle( FXMVECTOR a, FXMVECTOR b, FXMVECTOR c, const XMFLOAT2& sample, float* pdf )
+{
+    *pdf = 0.f;
+
+    XMVECTOR n_ab = XMVector3Cross( a, b );
+    XMVECTOR n_bc = XMVector3Cross( b, c );
+    XMVECTOR n_ca = XMVector3Cross( c, a );
+    if ( XMVectorGetX( XMVector3LengthSq( n_ab ) ) == 0.f || XMVectorGetX( XMVector3LengthSq( n_bc ) ) == 0.f || XMVectorGetX( XMVector3LengthSq( n_ca ) ) == 0.f )
+    {
+        return XMVectorZero();
+    }
+    n_ab = XMVector3Normalize( n_ab );
+    n_bc = XMVector3Normalize( n_bc );
+    n_ca = XMVector3Normalize( n_ca );
+
+    const float alpha = AngleBetween( n_ab, -n_ca );
+    const float beta = AngleBetween( n_bc, -n_ab );
+    const float gamma = AngleBetween( n_ca, -n_bc );
+    const float A_pi = alpha + beta + gamma;
+    const float area = A_pi - (float)M_PI;
+    if ( area <= 0.f )
+    {
+        return XMVectorZero();
+    }
+    *pdf = 1.f / area;
+
+    const float Ap_pi = (float)M_PI + ( A_pi - (float)M_PI ) * sample.x;
+    const float cosAlpha = cosf( alpha );
+    const float sinAlpha = sinf( alpha );
+    const float sinPhi = sinf( Ap_pi ) * cosAlpha - cosf( Ap_pi ) * sinAlpha;
+    const float cosPhi = cosf( Ap_pi ) * cosAlpha + sinf( Ap_pi ) * sinAlpha;
+    const float k1 = cosPhi + cosAlpha;
+    const float k2 = sinPhi - sinAlpha * XMVectorGetX( XMVector3Dot( a, b ) );
+    float cosBp = ( k2 + ( k2 * cosPhi - k1 * sinPhi ) * cosAlpha ) / ( ( k2 * sinPhi + k1 * cosPhi ) * sinAlpha );
+    cosBp = std::clamp( cosBp, -1.f, 1.f );
+    const float sinBp = SafeSqrt( 1.f - cosBp * cosBp );
+    const XMVECTOR cp = a * cosBp + XMVector3Normalize( GramSchmidt( c, a ) ) * sinBp;
+
+    const float cosTheta = 1.f - sample.y * ( 1.f - XMVectorGetX( XMVector3Dot( cp, b ) ) );
+    const float sinTheta = SafeSqrt( 1.f - cosTheta * cosTheta );
+    return b * cosTheta + XMVector3Normalize( GramSchmidt( cp, b ) ) * sinTheta;
+}
+
+bool ShouldSampleTriangleLightSolidAngle( float solidAngle )
+{
+    return solidAngle >= TRIANGLE_LIGHT_MIN_SOLID_ANGLE_SAMPLING && solidAngle <= TRIANGLE_LIGHT_MAX_SOLID_ANGLE_SAMPLING;
+}
+
+struct SEstimate
+{
+    void Add( double value )
+    {
+        m_Sum += value;
+        m_SquaredSum += value * value;
+        ++m_Count;
+    }
+
+    double GetMean() const { return m_Sum / m_Count; }
+    double GetVariance() const { return std::max( m_SquaredSum / m_Count - GetMean() * GetMean(), 0.0 ); }
+
+    // Five standard errors, plus a tolerance for the float precision of the estimates
+    bool IsConsistentWith( double reference ) const
+    {
+        return fabs( GetMean() - reference ) <= 5.0 * sqrt( GetVariance() / m_Count ) + 1e-4 * fabs( reference );
+    }
+
+    double m_Sum = 0.0;
+    double m_SquaredSum = 0.0;
+    uint32_t m_Count = 0;
+};
+
+// Irradiance at the origin on a surface facing +z from a triangle emitting unit radiance, the triangle is above the horizon.
+// Uses Lambert's formula for polygonal emitters, in double precision since the edges of distant triangles subtend tiny angles.
+static double CalculateIrradiance( const XMFLOAT3 vertices[ 3 ] )
+{
+    double directions[ 3 ][ 3 ];
+    for ( uint32_t i = 0; i < 3; ++i )
+    {
+        const double length = sqrt( (double)vertices[ i ].x * vertices[ i ].x + (double)vertices[ i ].y * vertices[ i ].y + (double)vertices[ i ].z * vertices[ i ].z );
+        directions[ i ][ 0 ] = vertices[ i ].x / length;
+        directions[ i ][ 1 ] = vertices[ i ].y / length;
+        directions[ i ][ 2 ] = vertices[ i ].z / length;
+    }
+
+    double irradiance = 0.0;
+    for ( uint32_t i = 0; i < 3; ++i )
+    {
+        const double* a = directions[ i ];
+        const double* b = directions[ ( i + 1 ) % 3 ];
+        const double difference[ 3 ] = { b[ 0 ] - a[ 0 ], b[ 1 ] - a[ 1 ], b[ 2 ] - a[ 2 ] };
+        const double angle = 2.0 * asin( std::min( sqrt( difference[ 0 ] * difference[ 0 ] + difference[ 1 ] * difference[ 1 ] + difference[ 2 ] * difference[ 2 ] ) * .5, 1.0 ) );
+        const double cross[ 3 ] = { a[ 1 ] * b[ 2 ] - a[ 2 ] * b[ 1 ], a[ 2 ] * b[ 0 ] - a[ 0 ] * b[ 2 ], a[ 0 ] * b[ 1 ] - a[ 1 ] * b[ 0 ] };
+        const double crossLength = sqrt( cross[ 0 ] * cross[ 0 ] + cross[ 1 ] * cross[ 1 ] + cross[ 2 ] * cross[ 2 ] );
+        irradiance += angle * cross[ 2 ] / crossLength;
+    }
+    return fabs( irradiance ) * .5;
+}
+
+static bool ValidateTriangleLight( const char* name, XMFLOAT3 v0, XMFLOAT3 v1, XMFLOAT3 v2, std::mt19937& rng )
+{
+    auto nextSample = [ &rng ]() { return ( rng() >> 8 ) / float( 1 << 24 ); };
+
+    XMVECTOR vertices[ 3 ] = { XMLoadFloat3( &v0 ), XMLoadFloat3( &v1 ), XMLoadFloat3( &v2 ) };
+    // Wind the triangle so its emitter normal faces the origin, the normal is computed as in the shaders
+    XMVECTOR normal = XMVector3Normalize( XMVector3Cross( vertices[ 2 ] - vertices[ 0 ], vertices[ 1 ] - vertices[ 0 ] ) );
+    if ( XMVectorGetX( XMVector3Dot( normal, vertices[ 0 ] ) ) > 0.f )
+    {
+        std::swap( vertices[ 1 ], vertices[ 2 ] );
+        normal = -normal;
+    }
+    const float surfaceArea = XMVectorGetX( XMVector3Length( XMVector3Cross( vertices[ 2 ] - vertices[ 0 ], vertices[ 1 ] - vertices[ 0 ] ) ) ) * .5f;
+
+    const XMVECTOR directions[ 3 ] = { XMVector3Normalize( vertices[ 0 ] ), XMVector3Normalize( vertices[ 1 ] ), XMVector3Normalize( vertices[ 2 ] ) };
+    const float solidAngle = CalculateSphericalTriangleSolidAngle( directions[ 0 ], directions[ 1 ], directions[ 2 ] );
+    XMFLOAT3 windedVertices[ 3 ];
+    for ( uint32_t i = 0; i < 3; ++i )
+    {
+        XMStoreFloat3( &windedVertices[ i ], vertices[ i ] );
+    }
+    const double irradiance = CalculateIrradiance( windedVertices );
+    const bool isSolidAngleSampled = ShouldSampleTriangleLightSolidAngle( solidAngle );
+
+    SEstimate areaSamplingIrradiance;
+    SEstimate solidAngleSamplingIrradiance;
+    SEstimate solidAngleSamplingArea; // Checks that the solid angle samples are uniform, the area is the integral of d^2 / cos over the solid angle
+    uint32_t mismatchCount = 0;
+    const uint32_t sampleCount = 1 << 18;
+    for ( uint32_t iSample = 0; iSample < sampleCount; ++iSample )
+    {
+        // Area sampling, same as TriangleLight_Sample
+        {
+            const float s = sqrtf( nextSample() );
+            const float u = 1.f - s;
+            const float v = nextSample() * s;
+            const XMVECTOR samplePos = vertices[ 0 ] + ( vertices[ 1 ] - vertices[ 0 ] ) * u + ( vertices[ 2 ] - vertices[ 0 ] ) * v;
+            const float distance = XMVectorGetX( XMVector3Length( samplePos ) );
+            const XMVECTOR wi = samplePos * ( 1.f / distance );
+            const float WIdotN = -XMVectorGetX( XMVector3Dot( wi, normal ) );
+            const float pdf = distance * distance / ( WIdotN * surfaceArea );
+            areaSamplingIrradiance.Add( WIdotN > 0.f ? std::max( XMVectorGetZ( wi ), 0.f ) / pdf : 0.0 );
+        }
+
+        // Solid angle sampling, only where TriangleLight_Sample would use it since it loses precision on tiny triangles
+        if ( isSolidAngleSampled )
+        {
+            float pdf;
+            const XMVECTOR wi = SampleSphericalTriangle( directions[ 0 ], directions[ 1 ], directions[ 2 ], XMFLOAT2( nextSample(), nextSample() ), &pdf );
+            const XMVECTOR planeNormal = XMVector3Cross( vertices[ 2 ] - vertices[ 0 ], vertices[ 1 ] - vertices[ 0 ] );
+            const float distance = XMVectorGetX( XMVector3Dot( vertices[ 0 ], planeNormal ) ) / XMVectorGetX( XMVector3Dot( wi, planeNormal ) );
+            const float WIdotN = -XMVectorGetX( XMVector3Dot( wi, normal ) );
+            if ( !( pdf > 0.f ) || !( distance > 0.f ) || !( WIdotN > 0.f ) || fabsf( pdf * solidAngle - 1.f ) > 1e-2f )
+            {
+                ++mismatchCount;
+                continue;
+            }
+            solidAngleSamplingIrradiance.Add( std::max( XMVectorGetZ( wi ), 0.f ) / pdf );
+            solidAngleSamplingArea.Add( distance * distance / ( WIdotN * pdf ) );
+        }
+    }
+
+    if ( !isSolidAngleSampled )
+    {
+        const bool passed = areaSamplingIrradiance.IsConsistentWith( irradiance );
+        LOG_STRING_FORMAT( "%s: solid angle %.3g sr, sampled by area, irradiance %.5g, area sampling %.5g (variance %.3g), %s\n",
+            name, solidAngle, irradiance, areaSamplingIrradiance.GetMean(), areaSamplingIrradiance.GetVariance(), passed ? "passed" : "FAILED" );
+        return passed;
+    }
+
+    const bool passed = mismatchCount == 0
+        && areaSamplingIrradiance.IsConsistentWith( irradiance )
+        && solidAngleSamplingIrradiance.IsConsistentWith( irradiance )
+        && solidAngleSamplingArea.IsConsistentWith( surfaceArea );
+    const double areaSamplingVariance = areaSamplingIrradiance.GetVariance();
+    const double solidAngleSamplingVariance = solidAngleSamplingIrradiance.GetVariance();
+    LOG_STRING_FORMAT( "%s: solid angle %.3g sr, sampled by solid angle, irradiance %.5g, area sampling %.5g (variance %.3g), solid angle sampling %.5g (variance %.3g), "
+        "variance ratio %.2f, area from solid angle samples %.5g of %.5g, %u invalid solid angle samples, %s\n",
+        name, solidAngle, irradiance, areaSamplingIrradiance.GetMean(), areaSamplingVariance, solidAngleSamplingIrradiance.GetMean(), solidAngleSamplingVariance,
+        solidAngleSamplingVariance > 0.0 ? areaSamplingVariance / solidAngleSamplingVariance : 0.0, solidAngleSamplingArea.GetMean(), surfaceArea, mismatchCount,
+        passed ? "passed" : "FAILED" );
+    return passed;
+}
+
+bool ValidateTriangleLightSampling()
+{
+    std::mt19937 rng( 0x5A7E );
+
+    bool isValid = true;
+    isValid &= ValidateTriangleLight( "Large emitter close to the surface", XMFLOAT3( -3.f, -2.f, .25f ), XMFLOAT3( 3.f, -2.f, .25f ), XMFLOAT3( 0.f, 3.f, .25f ), rng );
+    isValid &= ValidateTriangleLight( "Emitter at unit distance", XMFLOAT3( -.5f, -.5f, 1.f ), XMFLOAT3( .5f, -.5f, 1.f ), XMFLOAT3( 0.f, .5f, 1.f ), rng );
+    isValid &= ValidateTriangleLight( "Emitter near the horizon", XMFLOAT3( 1.f, -1.f, .05f ), XMFLOAT3( 1.f, 1.f, .05f ), XMFLOAT3( 1.5f, 0.f, 1.f ), rng );
+    isValid &= ValidateTriangleLight( "Small distant emitter", XMFLOAT3( -.05f, -.05f, 20.f ), XMFLOAT3( .05f, -.05f, 20.f ), XMFLOAT3( 0.f, .05f, 20.f ), rng );
+
+    LOG_STRING_FORMAT( "Triangle light sampling validation %s.\n", isValid ? "passed" : "FAILED" );
+    return isValid;
+}
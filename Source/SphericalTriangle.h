@@ -0,0 +1,15 @@
+#pragma once
+
+// Solid angle subtended by the spherical triangle with unit vertices a, b and c. Same as SphericalTriangleSolidAngle in the shaders.
+float CalculateSphericalTriangleSolidAngle( DirectX::FXMVECTOR a, DirectX::FXMVECTOR b, DirectX::FXMVECTOR c );
+
+// Uniformly samples a direction in the spherical triangle with unit vertices a, b and c. Same as SampleSphericalTriangle in the shaders,
+// pdf is zero for degenerate triangles.
+DirectX::XMVECTOR SampleSphericalTriangle( DirectX::FXMVECTOR a, DirectX::FXMVECTOR b, DirectX::FXMVECTOR c, const DirectX::XMFLOAT2& sample, float* pdf );
+
+// Same as TriangleLight_ShouldSampleSolidAngle in the shaders
+bool ShouldSampleTriangleLightSolidAngle( float solidAngle );
+
+// Estimates the irradiance from triangle lights at various distances with area and solid angle sampling, checks both against the
+// analytic irradiance and logs their variance. Returns false on failure.
+bool ValidateTriangleLightSampling();
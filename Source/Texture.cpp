@@ -1,14 +1,27 @@
 #include "stdafx.h"
 #include "Texture.h"
+#include "TextureDecoding.h"
+#include "TextureMipGeneration.h"
+#include "TextureCache.h"
+#if defined( _WIN32 )
 #include <wincodec.h>
 #include <wincodecsdk.h>
+#endif
 #include "Logging.h"
+#include "Timers.h"
+#include "ParallelFor.h"
+#include "Profiling.h"
 
 struct STextureCodec
 {
-    ComPtr<IWICImagingFactory> m_WICFactory;
+    ETextureCodecBackend m_Backend = ETextureCodecBackend::Portable; // Default only when WIC is available
+#if defined( _WIN32 )
+    ComPtr<IWICImagingFactory> m_WICFactory; // Null when the portable backend is requested or WIC is unavailable
+#endif
 };
 
+#if defined( _WIN32 )
+
 static ETexturePixelFormat GetTexturePixelFormat( WICPixelFormatGUID WICPixelFormat )
 {
     if ( WICPixelFormat == GUID_WICPixelFormat32bppBGRA ||
@@ -25,6 +38,15 @@ static ETexturePixelFormat GetTexturePixelFormat( WICPixelFormatGUID WICPixelFor
     {
         return ETexturePixelFormat::R8_Unorm;
     }
+    else if ( WICPixelFormat == GUID_WICPixelFormat128bppRGBAFloat ||
+        WICPixelFormat == GUID_WICPixelFormat128bppRGBFloat ||
+        WICPixelFormat == GUID_WICPixelFormat96bppRGBFloat ||
+        WICPixelFormat == GUID_WICPixelFormat64bppRGBAHalf ||
+        WICPixelFormat == GUID_WICPixelFormat64bppRGBHalf ||
+        WICPixelFormat == GUID_WICPixelFormat48bppRGBHalf )
+    {
+        return ETexturePixelFormat::R32G32B32A32_Float;
+    }
     return ETexturePixelFormat::Unknown;
 }
 
@@ -40,12 +62,18 @@ static WICPixelFormatGUID GetWICPixelFormat( ETexturePixelFormat texturePixelFor
     {
         return GUID_WICPixelFormat8bppAlpha;
     }
+    case ETexturePixelFormat::R32G32B32A32_Float:
+    {
+        return GUID_WICPixelFormat128bppRGBAFloat;
+    }
     default:
         return GUID_WICPixelFormatDontCare;
     }
     return GUID_WICPixelFormatDontCare;
 }
 
+#endif
+
 uint32_t GetTexturePixelFormatBPP( ETexturePixelFormat format )
 {
     switch ( format )
@@ -58,6 +86,10 @@ uint32_t GetTexturePixelFormatBPP( ETexturePixelFormat format )
     {
         return 1;
     }
+    case ETexturePixelFormat::R32G32B32A32_Float:
+    {
+        return 16;
+    }
     default:
     {
         return 0;
@@ -66,36 +98,60 @@ uint32_t GetTexturePixelFormatBPP( ETexturePixelFormat format )
     return 0;
 }
 
-STextureCodec* CTexture::CreateCodec()
+bool IsBlockCompressedTexturePixelFormat( ETexturePixelFormat format )
+{
+    return format == ETexturePixelFormat::BC1_sRGB || format == ETexturePixelFormat::BC4_Unorm || format == ETexturePixelFormat::BC7_sRGB;
+}
+
+uint32_t GetTexturePixelFormatBlockSize( ETexturePixelFormat format )
 {
-    ComPtr<IWICImagingFactory> factory;
-    if ( SUCCEEDED( CoCreateInstance( CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_IWICImagingFactory, (LPVOID*)factory.GetAddressOf() ) ) )
+    switch ( format )
+    {
+    case ETexturePixelFormat::BC1_sRGB:
+    case ETexturePixelFormat::BC4_Unorm:
+    {
+        return 8;
+    }
+    case ETexturePixelFormat::BC7_sRGB:
+    {
+        return 16;
+    }
+    default:
     {
-        STextureCodec* codec = new STextureCodec();
-        codec->m_WICFactory = factory;
-        return codec;
+        return 0;
+    }
     }
-    return nullptr;
+    return 0;
 }
 
-void CTexture::DestroyCodec( STextureCodec* codec )
+uint32_t CalculateTextureRowPitch( uint32_t width, ETexturePixelFormat format )
 {
-    codec->m_WICFactory.Reset();
-    delete codec;
+    return IsBlockCompressedTexturePixelFormat( format ) ? ( width + 3 ) / 4 * GetTexturePixelFormatBlockSize( format ) : width * GetTexturePixelFormatBPP( format );
+}
+
+uint32_t CalculateTextureRowCount( uint32_t height, ETexturePixelFormat format )
+{
+    return IsBlockCompressedTexturePixelFormat( format ) ? ( height + 3 ) / 4 : height;
 }
 
-bool CTexture::LoadFromFile( const char* filename, STextureCodec* codec )
+#if defined( _WIN32 )
+static bool DecodeWithWIC( IWICImagingFactory* factory, const uint8_t* data, size_t size, CTexture* texture )
 {
+    ComPtr<IWICStream> stream;
     ComPtr<IWICBitmapDecoder> decoder;
     ComPtr<IWICBitmapFrameDecode> frame;
 
-    wchar_t wideFilenameBuffer[ MAX_PATH ];
-    if ( MultiByteToWideChar( CP_UTF8, MB_PRECOMPOSED, filename, -1, wideFilenameBuffer, MAX_PATH ) == 0 )
+    if ( size > MAXDWORD || FAILED( factory->CreateStream( stream.GetAddressOf() ) ) )
     {
         return false;
     }
 
-    if ( FAILED( codec->m_WICFactory->CreateDecoderFromFilename( wideFilenameBuffer, NULL, GENERIC_READ, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf() ) ) )
+    if ( FAILED( stream->InitializeFromMemory( (BYTE*)data, (DWORD)size ) ) )
+    {
+        return false;
+    }
+
+    if ( FAILED( factory->CreateDecoderFromStream( stream.Get(), NULL, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf() ) ) )
     {
         return false;
     }
@@ -131,7 +187,7 @@ bool CTexture::LoadFromFile( const char* filename, STextureCodec* codec )
     if ( dstWICPixelFormat != srcWICPixelFormat )
     {
         // Pixel format conversion
-        if ( FAILED( codec->m_WICFactory->CreateFormatConverter( convertedFrame.GetAddressOf() ) ) )
+        if ( FAILED( factory->CreateFormatConverter( convertedFrame.GetAddressOf() ) ) )
         {
             return false;
         }
@@ -148,23 +204,279 @@ bool CTexture::LoadFromFile( const char* filename, STextureCodec* codec )
     const uint32_t byteSize = width * height * BPP;
     std::vector<uint8_t> pixelData;
     pixelData.resize( byteSize );
-    if ( FAILED( convertedFrame->CopyPixels( nullptr, width * BPP, byteSize, (BYTE*)pixelData.data() ) ) )
+    if ( FAILED( bitmapSource->CopyPixels( nullptr, width * BPP, byteSize, (BYTE*)pixelData.data() ) ) )
+    {
+        return false;
+    }
+
+    texture->m_PixelData = std::move( pixelData );
+    texture->m_PixelFormat = texturePixelFormat;
+    texture->m_Width = width;
+    texture->m_Height = height;
+    texture->m_MipLevelCount = 1;
+
+    return true;
+}
+
+#endif
+
+STextureCodec* CTexture::CreateCodec( ETextureCodecBackend backend )
+{
+    STextureCodec* codec = new STextureCodec();
+#if defined( _WIN32 )
+    if ( backend == ETextureCodecBackend::Default )
+    {
+        if ( FAILED( CoCreateInstance( CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_IWICImagingFactory, (LPVOID*)codec->m_WICFactory.GetAddressOf() ) ) )
+        {
+            LOG_STRING( "Failed to create WIC imaging factory, falling back to the portable texture decoders.\n" );
+        }
+        else
+        {
+            codec->m_Backend = ETextureCodecBackend::Default;
+        }
+    }
+#endif
+    return codec;
+}
+
+void CTexture::DestroyCodec( STextureCodec* codec )
+{
+#if defined( _WIN32 )
+    codec->m_WICFactory.Reset();
+#endif
+    delete codec;
+}
+
+bool CTexture::LoadFromFile( const char* filename, STextureCodec* codec, bool generateMipChain, uint32_t maxWorkerCount )
+{
+    PROFILE_SCOPE( "Load texture" );
+
+    std::ifstream file( std::filesystem::u8path( filename ), std::ios::binary | std::ios::ate );
+    if ( !file )
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> fileData( (size_t)file.tellg() );
+    file.seekg( 0 );
+    if ( !file.read( (char*)fileData.data(), fileData.size() ) )
+    {
+        return false;
+    }
+    file.close();
+
+    // The decoders of the two backends do not produce identical texels, so entries are keyed by the backend as well
+    m_SourceHash = TextureCache::HashSourceData( fileData.data(), fileData.size() );
+    m_CodecBackend = codec->m_Backend;
+    const STextureCacheKey cacheKey = { m_SourceHash, m_CodecBackend, ETexturePixelFormat::Unknown, generateMipChain };
+    if ( TextureCache::Load( cacheKey, this ) )
+    {
+        return true;
+    }
+
+    if ( !LoadFromMemory( fileData.data(), fileData.size(), codec ) )
     {
         return false;
     }
 
-    m_PixelData = std::move( pixelData );
-    m_PixelFormat = texturePixelFormat;
-    m_Width = width;
-    m_Height = height;
+    if ( generateMipChain )
+    {
+        PROFILE_SCOPE( "Generate mips" );
+        GenerateTextureMipChain( this, maxWorkerCount );
+    }
+    TextureCache::Store( cacheKey, *this );
+    return true;
+}
+
+bool CTexture::LoadFromMemory( const uint8_t* data, size_t size, STextureCodec* codec )
+{
+    PROFILE_SCOPE( "Decode texture" );
+
+    m_CodecBackend = codec->m_Backend;
+
+#if defined( _WIN32 )
+    // WIC takes precedence when present, formats it does not know about (e.g. TGA and Radiance HDR) still go to the portable decoders
+    if ( codec->m_WICFactory && DecodeWithWIC( codec->m_WICFactory.Get(), data, size, this ) )
+    {
+        return true;
+    }
+#endif
+
+    if ( IsPNGData( data, size ) )
+    {
+        return DecodePNG( data, size, this );
+    }
+    else if ( IsJPEGData( data, size ) )
+    {
+        return DecodeJPEG( data, size, this );
+    }
+    else if ( IsHDRData( data, size ) )
+    {
+        return DecodeHDR( data, size, this );
+    }
+    else if ( IsTGAData( data, size ) )
+    {
+        return DecodeTGA( data, size, this );
+    }
+
+    LOG_STRING( "Unsupported texture file format.\n" );
+    return false;
+}
+
+bool CTexture::LoadFromFiles( const std::string* filenames, CTexture* textures, uint32_t count )
+{
+    if ( count == 0 )
+    {
+        return true;
+    }
+
+    PROFILE_SCOPE( "Load textures" );
+
+    // Codecs are created on the calling thread, the WIC factory is free-threaded so workers only need to join the MTA to use it
+    std::vector<STextureCodec*> codecs( GetParallelForWorkerCount( count ) );
+    for ( STextureCodec*& codec : codecs )
+    {
+        codec = CreateCodec();
+    }
+
+    Timer totalTimer;
+    totalTimer.Start();
+
+    ParallelFor( count, [&]( uint32_t workerIndex, uint32_t textureIndex )
+    {
+#if defined( _WIN32 )
+        HRESULT coInitializeHR = CoInitializeEx( nullptr, COINIT_MULTITHREADED );
+        const bool shouldUninitializeCOM = SUCCEEDED( coInitializeHR );
+#endif
+
+        Timer timer;
+        timer.Start();
+
+        CTexture& texture = textures[ textureIndex ];
+        const std::string& filename = filenames[ textureIndex ];
+        // Textures are already spread over the workers, a lone texture gets all of them for its mip chain
+        if ( texture.LoadFromFile( filename.c_str(), codecs[ workerIndex ], true, count > 1 ? 1 : 0 ) )
+        {
+            LOG_STRING_FORMAT( "Texture \"%s\" (%ux%u, %u mips) loaded in %.3f ms.\n", filename.c_str(), texture.m_Width, texture.m_Height, texture.m_MipLevelCount,
+                timer.GetElapsedMicroseconds().count() / 1000.f );
+        }
+        else
+        {
+            texture.Clear();
+            LOG_STRING_FORMAT( "Loading texture from file \"%s\" failed.\n", filename.c_str() );
+        }
+
+#if defined( _WIN32 )
+        if ( shouldUninitializeCOM )
+        {
+            CoUninitialize();
+        }
+#endif
+    }, (uint32_t)codecs.size() );
+
+    LOG_STRING_FORMAT( "%u textures decoded in %.3f ms with %u workers.\n", count, totalTimer.GetElapsedMicroseconds().count() / 1000.f, (uint32_t)codecs.size() );
 
+    for ( STextureCodec* codec : codecs )
+    {
+        DestroyCodec( codec );
+    }
     return true;
 }
 
+void RunTextureDecodingBenchmark( const std::filesystem::path& directory )
+{
+#if defined( _WIN32 )
+    HRESULT coInitializeHR = CoInitializeEx( nullptr, COINIT_MULTITHREADED );
+    const bool shouldUninitializeCOM = SUCCEEDED( coInitializeHR );
+#endif
+
+    // Files are read upfront so only the decoding is timed
+    std::vector<std::vector<uint8_t>> fileDatas;
+    uint64_t totalFileSize = 0;
+    std::error_code errorCode;
+    for ( const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator( directory, errorCode ) )
+    {
+        if ( !entry.is_regular_file() )
+        {
+            continue;
+        }
+
+        std::ifstream file( entry.path(), std::ios::binary | std::ios::ate );
+        if ( !file )
+        {
+            continue;
+        }
+        fileDatas.emplace_back( (size_t)file.tellg() );
+        file.seekg( 0 );
+        file.read( (char*)fileDatas.back().data(), fileDatas.back().size() );
+        totalFileSize += fileDatas.back().size();
+    }
+
+    const std::string directoryName = directory.u8string();
+    if ( fileDatas.empty() )
+    {
+        LOG_STRING_FORMAT( "No texture files found in \"%s\".\n", directoryName.c_str() );
+    }
+    else
+    {
+        LOG_STRING_FORMAT( "Benchmarking texture decoding of %u files (%.2f MB) in \"%s\".\n", (uint32_t)fileDatas.size(), totalFileSize / ( 1024.f * 1024.f ), directoryName.c_str() );
+    }
+
+    const ETextureCodecBackend backends[] = { ETextureCodecBackend::Default, ETextureCodecBackend::Portable };
+    const char* backendNames[] = { "Default", "Portable" };
+    for ( uint32_t iBackend = 0; iBackend < _countof( backends ) && !fileDatas.empty(); ++iBackend )
+    {
+        STextureCodec* codec = CTexture::CreateCodec( backends[ iBackend ] );
+        uint32_t decodedFileCount = 0;
+        uint64_t decodedFileSize = 0;
+        uint64_t decodedPixelCount = 0;
+
+        Timer timer;
+        timer.Start();
+        for ( const std::vector<uint8_t>& fileData : fileDatas )
+        {
+            CTexture texture;
+            texture.Clear();
+            if ( texture.LoadFromMemory( fileData.data(), fileData.size(), codec ) )
+            {
+                ++decodedFileCount;
+                decodedFileSize += fileData.size();
+                decodedPixelCount += (uint64_t)texture.m_Width * texture.m_Height;
+            }
+        }
+        const float elapsedSeconds = std::max( timer.GetElapsedSecondsFloat().count(), 1e-6f );
+
+        LOG_STRING_FORMAT( "%s backend: %u/%u files decoded in %.3f s, %.2f MB/s compressed, %.2f MPixels/s.\n", backendNames[ iBackend ], decodedFileCount, (uint32_t)fileDatas.size(), elapsedSeconds,
+            decodedFileSize / ( 1024.f * 1024.f ) / elapsedSeconds, decodedPixelCount / 1e6f / elapsedSeconds );
+
+        CTexture::DestroyCodec( codec );
+    }
+
+#if defined( _WIN32 )
+    if ( shouldUninitializeCOM )
+    {
+        CoUninitialize();
+    }
+#endif
+}
+
+size_t CTexture::GetMipOffset( uint32_t mipLevel ) const
+{
+    size_t offset = 0;
+    for ( uint32_t level = 0; level < mipLevel; ++level )
+    {
+        offset += (size_t)CalculateRowPitch( level ) * CalculateRowCount( level );
+    }
+    return offset;
+}
+
 void CTexture::Clear()
 {
     m_PixelData.clear();
+    m_SourceHash = 0;
+    m_CodecBackend = ETextureCodecBackend::Portable;
     m_PixelFormat = ETexturePixelFormat::Unknown;
     m_Width = 0;
     m_Height = 0;
+    m_MipLevelCount = 0;
 }
@@ -7,31 +7,76 @@ enum class ETexturePixelFormat
     Unknown,
     R8G8B8A8_sRGB,
     R8_Unorm,
+    BC1_sRGB,
+    BC4_Unorm,
+    BC7_sRGB,
+    R32G32B32A32_Float, // Linear, HDR images
 };
 
+// Bytes per texel, 0 for block compressed formats
 uint32_t GetTexturePixelFormatBPP( ETexturePixelFormat format );
 
+bool IsBlockCompressedTexturePixelFormat( ETexturePixelFormat format );
+
+// Bytes per 4x4 block of block compressed formats
+uint32_t GetTexturePixelFormatBlockSize( ETexturePixelFormat format );
+
+// Row pitch and row count of a level, rows of block compressed formats are rows of blocks
+uint32_t CalculateTextureRowPitch( uint32_t width, ETexturePixelFormat format );
+
+uint32_t CalculateTextureRowCount( uint32_t height, ETexturePixelFormat format );
+
+enum class ETextureCodecBackend
+{
+    Default,    // Platform codec (WIC on Windows) with the portable decoders as fallback
+    Portable,   // Portable decoders only
+};
+
 class CTexture
 {
 public:
-    static STextureCodec* CreateCodec();
+    static STextureCodec* CreateCodec( ETextureCodecBackend backend = ETextureCodecBackend::Default );
 
     static void DestroyCodec( STextureCodec* codec );
 
-    bool LoadFromFile( const char* filename, STextureCodec* codec );
+    // Consults the texture cache before decoding and stores the result in it on a miss
+    bool LoadFromFile( const char* filename, STextureCodec* codec, bool generateMipChain = false, uint32_t maxWorkerCount = 0 );
+
+    bool LoadFromMemory( const uint8_t* data, size_t size, STextureCodec* codec );
+
+    // Decodes the files into textures[ 0, count ) on worker threads, each worker owns a codec. Textures failed to load are left cleared.
+    static bool LoadFromFiles( const std::string* filenames, CTexture* textures, uint32_t count );
 
     void Clear();
 
     bool IsValid() const { return m_PixelFormat != ETexturePixelFormat::Unknown; }
 
-    uint32_t CalculateRowPitch() const 
+    uint32_t GetMipWidth( uint32_t mipLevel ) const { return std::max( m_Width >> mipLevel, 1u ); }
+
+    uint32_t GetMipHeight( uint32_t mipLevel ) const { return std::max( m_Height >> mipLevel, 1u ); }
+
+    // Byte offset of the level in m_PixelData, levels are tightly packed from the largest to the smallest
+    size_t GetMipOffset( uint32_t mipLevel ) const;
+
+    uint32_t CalculateRowPitch( uint32_t mipLevel = 0 ) const 
+    {
+        return CalculateTextureRowPitch( GetMipWidth( mipLevel ), m_PixelFormat );
+    }
+
+    uint32_t CalculateRowCount( uint32_t mipLevel = 0 ) const
     {
-        return GetTexturePixelFormatBPP( m_PixelFormat ) * m_Width;
+        return CalculateTextureRowCount( GetMipHeight( mipLevel ), m_PixelFormat );
     }
 
     std::string m_Name;
+    uint64_t m_SourceHash = 0; // Hash of the file content the texture was loaded from, 0 if it was not loaded from a file
+    ETextureCodecBackend m_CodecBackend = ETextureCodecBackend::Portable; // Backend of the codec that decoded the file
     std::vector<uint8_t> m_PixelData;
     ETexturePixelFormat m_PixelFormat;
     uint32_t m_Width;
     uint32_t m_Height;
-};
\ No newline at end of file
+    uint32_t m_MipLevelCount;
+};
+
+// Decodes every file in the directory with each codec backend and logs the decode throughput
+void RunTextureDecodingBenchmark( const std::filesystem::path& directory );
\ No newline at end of file
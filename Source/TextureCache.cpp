@@ -0,0 +1,254 @@
+#include "stdafx.h"
+#include "TextureCache.h"
+#include "TextureMipGeneration.h"
+#include "MappedFile.h"
+#include "Logging.h"
+
+#define TEXTURE_CACHE_FILE_MAGIC    0x43544344 // "DCTC"
+#define TEXTURE_CACHE_FILE_VERSION  2
+
+struct STextureCacheFileHeader
+{
+    uint32_t m_Magic;
+    uint32_t m_Version;
+    uint64_t m_SourceHash;
+    uint32_t m_CodecBackend;
+    uint32_t m_PixelFormat;
+    uint32_t m_Width;
+    uint32_t m_Height;
+    uint32_t m_MipLevelCount;
+    uint64_t m_PixelDataSize;
+};
+
+static std::filesystem::path s_Directory;
+static uint64_t s_SizeLimit = 0;
+static bool s_IsEnabled = false;
+
+static std::atomic<uint32_t> s_HitCount = 0;
+static std::atomic<uint32_t> s_MissCount = 0;
+static std::atomic<uint64_t> s_BytesRead = 0;
+static std::atomic<uint64_t> s_BytesWritten = 0;
+static std::atomic<uint64_t> s_BytesEvicted = 0;
+static std::atomic<uint32_t> s_TemporaryFileIndex = 0;
+
+static std::filesystem::path GetEntryPath( const STextureCacheKey& key )
+{
+    char filename[ 64 ];
+    sprintf_s( filename, "%016llx_%u_%u_%u.tex", (unsigned long long)key.m_SourceHash, (uint32_t)key.m_CodecBackend, (uint32_t)key.m_PixelFormat, key.m_HasMipChain ? 1u : 0u );
+    return s_Directory / filename;
+}
+
+bool TextureCache::Initialize( const std::filesystem::path& directory, uint64_t sizeLimit )
+{
+    std::error_code errorCode;
+    std::filesystem::create_directories( directory, errorCode );
+    if ( errorCode )
+    {
+        LOG_STRING_FORMAT( "Failed to create texture cache directory \"%s\", texture cache disabled.\n", directory.u8string().c_str() );
+        return false;
+    }
+
+    s_Directory = directory;
+    s_SizeLimit = sizeLimit;
+    s_IsEnabled = true;
+    return true;
+}
+
+bool TextureCache::IsEnabled()
+{
+    return s_IsEnabled;
+}
+
+uint64_t TextureCache::HashSourceData( const uint8_t* data, size_t size )
+{
+    // FNV-1a over 64-bit words with an extra xorshift so the high bits of a word reach the low bits of the hash
+    uint64_t hash = 14695981039346656037ull ^ size;
+    size_t offset = 0;
+    for ( ; offset + sizeof( uint64_t ) <= size; offset += sizeof( uint64_t ) )
+    {
+        uint64_t word;
+        memcpy( &word, data + offset, sizeof( uint64_t ) );
+        hash = ( hash ^ word ) * 1099511628211ull;
+        hash ^= hash >> 32;
+    }
+    for ( ; offset < size; ++offset )
+    {
+        hash = ( hash ^ data[ offset ] ) * 1099511628211ull;
+    }
+    // Zero is reserved for textures not loaded from files
+    return hash != 0 ? hash : 1;
+}
+
+bool TextureCache::Load( const STextureCacheKey& key, CTexture* texture )
+{
+    if ( !s_IsEnabled || key.m_SourceHash == 0 )
+    {
+        return false;
+    }
+
+    const std::filesystem::path path = GetEntryPath( key );
+    bool isValid = false;
+    {
+        CMappedFile file;
+        if ( file.Open( path ) && file.GetSize() >= sizeof( STextureCacheFileHeader ) )
+        {
+            STextureCacheFileHeader header;
+            memcpy( &header, file.GetData(), sizeof( STextureCacheFileHeader ) );
+            if ( header.m_Magic == TEXTURE_CACHE_FILE_MAGIC && header.m_Version == TEXTURE_CACHE_FILE_VERSION && header.m_SourceHash == key.m_SourceHash && header.m_CodecBackend == (uint32_t)key.m_CodecBackend
+                && ( key.m_PixelFormat == ETexturePixelFormat::Unknown || header.m_PixelFormat == (uint32_t)key.m_PixelFormat )
+                && header.m_PixelFormat != (uint32_t)ETexturePixelFormat::Unknown && header.m_MipLevelCount != 0
+                && header.m_MipLevelCount <= CalculateMipLevelCount( header.m_Width, header.m_Height )
+                && file.GetSize() == sizeof( STextureCacheFileHeader ) + header.m_PixelDataSize )
+            {
+                // Guards against truncated or foreign entries before the texel data is trusted, the texture is left untouched on failure
+                CTexture layout;
+                layout.m_PixelFormat = (ETexturePixelFormat)header.m_PixelFormat;
+                layout.m_Width = header.m_Width;
+                layout.m_Height = header.m_Height;
+                if ( layout.GetMipOffset( header.m_MipLevelCount ) == header.m_PixelDataSize )
+                {
+                    const uint8_t* pixelData = file.GetData() + sizeof( STextureCacheFileHeader );
+                    texture->m_PixelData.assign( pixelData, pixelData + header.m_PixelDataSize );
+                    texture->m_PixelFormat = layout.m_PixelFormat;
+                    texture->m_Width = header.m_Width;
+                    texture->m_Height = header.m_Height;
+                    texture->m_MipLevelCount = header.m_MipLevelCount;
+                    isValid = true;
+                }
+            }
+        }
+    }
+
+    std::error_code errorCode;
+    if ( !isValid )
+    {
+        ++s_MissCount;
+        // Entries of an older version or corrupted ones are dropped so they get rewritten
+        if ( std::filesystem::exists( path, errorCode ) )
+        {
+            std::filesystem::remove( path, errorCode );
+        }
+        return false;
+    }
+
+    // The modification time doubles as the last access time for the eviction
+    std::filesystem::last_write_time( path, std::filesystem::file_time_type::clock::now(), errorCode );
+    ++s_HitCount;
+    s_BytesRead += texture->m_PixelData.size();
+    return true;
+}
+
+void TextureCache::Store( const STextureCacheKey& key, const CTexture& texture )
+{
+    if ( !s_IsEnabled || key.m_SourceHash == 0 || !texture.IsValid() )
+    {
+        return;
+    }
+
+    STextureCacheFileHeader header = {};
+    header.m_Magic = TEXTURE_CACHE_FILE_MAGIC;
+    header.m_Version = TEXTURE_CACHE_FILE_VERSION;
+    header.m_SourceHash = key.m_SourceHash;
+    header.m_CodecBackend = (uint32_t)key.m_CodecBackend;
+    header.m_PixelFormat = (uint32_t)texture.m_PixelFormat;
+    header.m_Width = texture.m_Width;
+    header.m_Height = texture.m_Height;
+    header.m_MipLevelCount = texture.m_MipLevelCount;
+    header.m_PixelDataSize = texture.m_PixelData.size();
+
+    // Written to a temporary file first so neither other workers nor other processes ever see a partial entry
+    const std::filesystem::path path = GetEntryPath( key );
+    std::filesystem::path temporaryPath = path;
+    temporaryPath += ".tmp" + std::to_string( GetCurrentProcessId() ) + "_" + std::to_string( s_TemporaryFileIndex++ );
+    {
+        std::ofstream file( temporaryPath, std::ios::binary | std::ios::trunc );
+        if ( !file )
+        {
+            return;
+        }
+        file.write( (const char*)&header, sizeof( STextureCacheFileHeader ) );
+        file.write( (const char*)texture.m_PixelData.data(), texture.m_PixelData.size() );
+        if ( !file )
+        {
+            file.close();
+            std::error_code errorCode;
+            std::filesystem::remove( temporaryPath, errorCode );
+            return;
+        }
+    }
+
+    std::error_code errorCode;
+    std::filesystem::rename( temporaryPath, path, errorCode );
+    if ( errorCode )
+    {
+        std::filesystem::remove( temporaryPath, errorCode );
+        return;
+    }
+    s_BytesWritten += sizeof( STextureCacheFileHeader ) + texture.m_PixelData.size();
+}
+
+void TextureCache::Trim()
+{
+    if ( !s_IsEnabled )
+    {
+        return;
+    }
+
+    struct SEntry
+    {
+        std::filesystem::path m_Path;
+        std::filesystem::file_time_type m_LastWriteTime;
+        uint64_t m_Size;
+    };
+
+    std::vector<SEntry> entries;
+    uint64_t totalSize = 0;
+    std::error_code errorCode;
+    for ( const std::filesystem::directory_entry& directoryEntry : std::filesystem::directory_iterator( s_Directory, errorCode ) )
+    {
+        if ( !directoryEntry.is_regular_file( errorCode ) || directoryEntry.path().extension() != ".tex" )
+        {
+            continue;
+        }
+
+        SEntry entry;
+        entry.m_Path = directoryEntry.path();
+        entry.m_LastWriteTime = directoryEntry.last_write_time( errorCode );
+        entry.m_Size = directoryEntry.file_size( errorCode );
+        if ( !errorCode )
+        {
+            totalSize += entry.m_Size;
+            entries.emplace_back( std::move( entry ) );
+        }
+    }
+
+    if ( totalSize <= s_SizeLimit )
+    {
+        return;
+    }
+
+    std::sort( entries.begin(), entries.end(), []( const SEntry& a, const SEntry& b ) { return a.m_LastWriteTime < b.m_LastWriteTime; } );
+    for ( const SEntry& entry : entries )
+    {
+        if ( totalSize <= s_SizeLimit )
+        {
+            break;
+        }
+        if ( std::filesystem::remove( entry.m_Path, errorCode ) )
+        {
+            totalSize -= entry.m_Size;
+            s_BytesEvicted += entry.m_Size;
+        }
+    }
+}
+
+void TextureCache::LogStatistics()
+{
+    if ( !s_IsEnabled )
+    {
+        return;
+    }
+
+    LOG_STRING_FORMAT( "Texture cache: %u hits, %u misses, %.2f MB read, %.2f MB written, %.2f MB evicted.\n", s_HitCount.exchange( 0 ), s_MissCount.exchange( 0 ),
+        s_BytesRead.exchange( 0 ) / ( 1024.f * 1024.f ), s_BytesWritten.exchange( 0 ) / ( 1024.f * 1024.f ), s_BytesEvicted.exchange( 0 ) / ( 1024.f * 1024.f ) );
+}
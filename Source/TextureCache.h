@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Texture.h"
+
+// Identifies a cache entry, the source file content and the codec backend that decoded it plus the processing applied to the decoded texels
+struct STextureCacheKey
+{
+    uint64_t m_SourceHash;
+    ETextureCodecBackend m_CodecBackend;
+    ETexturePixelFormat m_PixelFormat; // Unknown stands for the format produced by the decoders
+    bool m_HasMipChain;
+};
+
+// Disk cache of processed texel data. Every entry is a single file holding a small header followed by the tightly packed levels,
+// so it is mapped and copied into the texture without any parsing. The cache is disabled until initialized.
+namespace TextureCache
+{
+    bool Initialize( const std::filesystem::path& directory, uint64_t sizeLimit );
+
+    bool IsEnabled();
+
+    uint64_t HashSourceData( const uint8_t* data, size_t size );
+
+    // Both are thread safe, keys with a zero source hash are never cached
+    bool Load( const STextureCacheKey& key, CTexture* texture );
+
+    void Store( const STextureCacheKey& key, const CTexture& texture );
+
+    // Evicts the least recently used entries until the cache fits in the size limit
+    void Trim();
+
+    // Logs the counters accumulated since the last call and resets them
+    void LogStatistics();
+}
@@ -0,0 +1,861 @@
+#include "stdafx.h"
+#include "TextureCompression.h"
+#include "ParallelFor.h"
+#include "Timers.h"
+#include "Logging.h"
+
+#define BC_BLOCK_TEXEL_COUNT    16
+#define BC7_MODE6_INDEX_COUNT   16
+
+static const uint32_t s_BC7Mode6Weights[ BC7_MODE6_INDEX_COUNT ] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct SSRGBToLinearTable
+{
+    SSRGBToLinearTable()
+    {
+        for ( uint32_t i = 0; i < 256; ++i )
+        {
+            const float value = i / 255.f;
+            const float linearValue = value <= 0.04045f ? value / 12.92f : powf( ( value + 0.055f ) / 1.055f, 2.4f );
+            m_Values[ i ] = (uint8_t)( linearValue * 255.f + 0.5f );
+        }
+    }
+
+    uint8_t m_Values[ 256 ];
+};
+
+static const SSRGBToLinearTable s_SRGBToLinearTable;
+
+//
+// Endpoint fitting shared by the encoders
+//
+
+// Finds the principal axis of the texels through power iteration, returns false when all texels are identical
+template <uint32_t ChannelCount>
+static bool FindPrincipalAxis( const float texels[ BC_BLOCK_TEXEL_COUNT ][ 4 ], float mean[ 4 ], float axis[ 4 ] )
+{
+    for ( uint32_t c = 0; c < ChannelCount; ++c )
+    {
+        mean[ c ] = 0.f;
+        for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+        {
+            mean[ c ] += texels[ i ][ c ];
+        }
+        mean[ c ] /= BC_BLOCK_TEXEL_COUNT;
+    }
+
+    float covariance[ 4 ][ 4 ] = {};
+    for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+    {
+        for ( uint32_t r = 0; r < ChannelCount; ++r )
+        {
+            for ( uint32_t c = 0; c < ChannelCount; ++c )
+            {
+                covariance[ r ][ c ] += ( texels[ i ][ r ] - mean[ r ] ) * ( texels[ i ][ c ] - mean[ c ] );
+            }
+        }
+    }
+
+    for ( uint32_t c = 0; c < ChannelCount; ++c )
+    {
+        axis[ c ] = 1.f;
+    }
+    for ( uint32_t iteration = 0; iteration < 8; ++iteration )
+    {
+        float nextAxis[ 4 ] = {};
+        float length = 0.f;
+        for ( uint32_t r = 0; r < ChannelCount; ++r )
+        {
+            for ( uint32_t c = 0; c < ChannelCount; ++c )
+            {
+                nextAxis[ r ] += covariance[ r ][ c ] * axis[ c ];
+            }
+            length = std::max( length, fabsf( nextAxis[ r ] ) );
+        }
+        if ( length < 1e-6f )
+        {
+            return false;
+        }
+        for ( uint32_t c = 0; c < ChannelCount; ++c )
+        {
+            axis[ c ] = nextAxis[ c ] / length;
+        }
+    }
+    return true;
+}
+
+// Places the endpoints at the extremes of the texels projected on the principal axis
+template <uint32_t ChannelCount>
+static void FitEndpoints( const float texels[ BC_BLOCK_TEXEL_COUNT ][ 4 ], float endpoint0[ 4 ], float endpoint1[ 4 ] )
+{
+    float mean[ 4 ];
+    float axis[ 4 ];
+    if ( !FindPrincipalAxis<ChannelCount>( texels, mean, axis ) )
+    {
+        for ( uint32_t c = 0; c < ChannelCount; ++c )
+        {
+            endpoint0[ c ] = endpoint1[ c ] = mean[ c ];
+        }
+        return;
+    }
+
+    float minT = std::numeric_limits<float>::max();
+    float maxT = -std::numeric_limits<float>::max();
+    float axisLengthSquared = 0.f;
+    for ( uint32_t c = 0; c < ChannelCount; ++c )
+    {
+        axisLengthSquared += axis[ c ] * axis[ c ];
+    }
+    for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+    {
+        float t = 0.f;
+        for ( uint32_t c = 0; c < ChannelCount; ++c )
+        {
+            t += ( texels[ i ][ c ] - mean[ c ] ) * axis[ c ];
+        }
+        minT = std::min( minT, t );
+        maxT = std::max( maxT, t );
+    }
+    for ( uint32_t c = 0; c < ChannelCount; ++c )
+    {
+        endpoint0[ c ] = mean[ c ] + axis[ c ] * maxT / axisLengthSquared;
+        endpoint1[ c ] = mean[ c ] + axis[ c ] * minT / axisLengthSquared;
+    }
+}
+
+// Least squares endpoints for the given interpolation weights of endpoint1, returns false when the system is singular
+template <uint32_t ChannelCount>
+static bool RefineEndpoints( const float texels[ BC_BLOCK_TEXEL_COUNT ][ 4 ], const float weights[ BC_BLOCK_TEXEL_COUNT ], float endpoint0[ 4 ], float endpoint1[ 4 ] )
+{
+    float aa = 0.f, ab = 0.f, bb = 0.f;
+    float ax[ 4 ] = {};
+    float bx[ 4 ] = {};
+    for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+    {
+        const float b = weights[ i ];
+        const float a = 1.f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for ( uint32_t c = 0; c < ChannelCount; ++c )
+        {
+            ax[ c ] += a * texels[ i ][ c ];
+            bx[ c ] += b * texels[ i ][ c ];
+        }
+    }
+
+    const float determinant = aa * bb - ab * ab;
+    if ( fabsf( determinant ) < 1e-6f )
+    {
+        return false;
+    }
+    for ( uint32_t c = 0; c < ChannelCount; ++c )
+    {
+        endpoint0[ c ] = std::clamp( ( bb * ax[ c ] - ab * bx[ c ] ) / determinant, 0.f, 255.f );
+        endpoint1[ c ] = std::clamp( ( aa * bx[ c ] - ab * ax[ c ] ) / determinant, 0.f, 255.f );
+    }
+    return true;
+}
+
+template <uint32_t ChannelCount>
+static uint32_t CalculateSquaredError( const uint8_t* a, const uint8_t* b )
+{
+    uint32_t error = 0;
+    for ( uint32_t c = 0; c < ChannelCount; ++c )
+    {
+        const int32_t difference = (int32_t)a[ c ] - (int32_t)b[ c ];
+        error += difference * difference;
+    }
+    return error;
+}
+
+static void LoadBlockTexels( const uint8_t texels[ 64 ], float outTexels[ BC_BLOCK_TEXEL_COUNT ][ 4 ] )
+{
+    for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+    {
+        for ( uint32_t c = 0; c < 4; ++c )
+        {
+            outTexels[ i ][ c ] = texels[ i * 4 + c ];
+        }
+    }
+}
+
+//
+// BC1
+//
+
+static uint16_t PackRGB565( const float color[ 4 ] )
+{
+    const uint32_t r = (uint32_t)std::clamp( color[ 0 ] * 31.f / 255.f + 0.5f, 0.f, 31.f );
+    const uint32_t g = (uint32_t)std::clamp( color[ 1 ] * 63.f / 255.f + 0.5f, 0.f, 63.f );
+    const uint32_t b = (uint32_t)std::clamp( color[ 2 ] * 31.f / 255.f + 0.5f, 0.f, 31.f );
+    return (uint16_t)( ( r << 11 ) | ( g << 5 ) | b );
+}
+
+static void UnpackRGB565( uint16_t value, uint8_t color[ 4 ] )
+{
+    const uint32_t r = ( value >> 11 ) & 0x1F;
+    const uint32_t g = ( value >> 5 ) & 0x3F;
+    const uint32_t b = value & 0x1F;
+    color[ 0 ] = (uint8_t)( ( r << 3 ) | ( r >> 2 ) );
+    color[ 1 ] = (uint8_t)( ( g << 2 ) | ( g >> 4 ) );
+    color[ 2 ] = (uint8_t)( ( b << 3 ) | ( b >> 2 ) );
+    color[ 3 ] = 255;
+}
+
+static void BuildBC1Palette( uint16_t color0, uint16_t color1, uint8_t palette[ 4 ][ 4 ] )
+{
+    UnpackRGB565( color0, palette[ 0 ] );
+    UnpackRGB565( color1, palette[ 1 ] );
+    for ( uint32_t c = 0; c < 3; ++c )
+    {
+        if ( color0 > color1 )
+        {
+            palette[ 2 ][ c ] = (uint8_t)( ( 2 * palette[ 0 ][ c ] + palette[ 1 ][ c ] + 1 ) / 3 );
+            palette[ 3 ][ c ] = (uint8_t)( ( palette[ 0 ][ c ] + 2 * palette[ 1 ][ c ] + 1 ) / 3 );
+        }
+        else
+        {
+            palette[ 2 ][ c ] = (uint8_t)( ( palette[ 0 ][ c ] + palette[ 1 ][ c ] ) / 2 );
+            palette[ 3 ][ c ] = 0;
+        }
+    }
+    palette[ 2 ][ 3 ] = 255;
+    palette[ 3 ][ 3 ] = color0 > color1 ? 255 : 0;
+}
+
+// Selects the closest palette entries of the 4-color mode, color0 must be greater than color1
+static uint32_t SelectBC1Indices( const uint8_t texels[ 64 ], uint16_t color0, uint16_t color1, uint32_t* outError )
+{
+    uint8_t palette[ 4 ][ 4 ];
+    BuildBC1Palette( color0, color1, palette );
+
+    uint32_t indices = 0;
+    uint32_t totalError = 0;
+    for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+    {
+        uint32_t bestIndex = 0;
+        uint32_t bestError = UINT_MAX;
+        for ( uint32_t index = 0; index < 4; ++index )
+        {
+            const uint32_t error = CalculateSquaredError<3>( texels + i * 4, palette[ index ] );
+            if ( error < bestError )
+            {
+                bestError = error;
+                bestIndex = index;
+            }
+        }
+        indices |= bestIndex << ( i * 2 );
+        totalError += bestError;
+    }
+    *outError = totalError;
+    return indices;
+}
+
+// Quantizes the endpoints and orders them for the 4-color mode, returns false for a single color block
+static bool QuantizeBC1Endpoints( const float endpoint0[ 4 ], const float endpoint1[ 4 ], uint16_t* outColor0, uint16_t* outColor1 )
+{
+    uint16_t color0 = PackRGB565( endpoint0 );
+    uint16_t color1 = PackRGB565( endpoint1 );
+    if ( color0 < color1 )
+    {
+        std::swap( color0, color1 );
+    }
+    *outColor0 = color0;
+    *outColor1 = color1;
+    return color0 != color1;
+}
+
+static void WriteBC1Block( uint16_t color0, uint16_t color1, uint32_t indices, uint8_t block[ 8 ] )
+{
+    memcpy( block, &color0, 2 );
+    memcpy( block + 2, &color1, 2 );
+    memcpy( block + 4, &indices, 4 );
+}
+
+void EncodeBC1Block( const uint8_t texels[ 64 ], uint8_t block[ 8 ] )
+{
+    float floatTexels[ BC_BLOCK_TEXEL_COUNT ][ 4 ];
+    LoadBlockTexels( texels, floatTexels );
+
+    float endpoint0[ 4 ];
+    float endpoint1[ 4 ];
+    FitEndpoints<3>( floatTexels, endpoint0, endpoint1 );
+
+    uint16_t color0, color1;
+    if ( !QuantizeBC1Endpoints( endpoint0, endpoint1, &color0, &color1 ) )
+    {
+        // Every index refers to color0 which equals color1
+        WriteBC1Block( color0, color1, 0, block );
+        return;
+    }
+
+    uint32_t error;
+    uint32_t indices = SelectBC1Indices( texels, color0, color1, &error );
+
+    // One least squares pass on the selected indices usually recovers most of the endpoint quantization loss
+    static const float s_IndexWeights[ 4 ] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+    float weights[ BC_BLOCK_TEXEL_COUNT ];
+    for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+    {
+        weights[ i ] = s_IndexWeights[ ( indices >> ( i * 2 ) ) & 0x3 ];
+    }
+    uint16_t refinedColor0, refinedColor1;
+    if ( RefineEndpoints<3>( floatTexels, weights, endpoint0, endpoint1 ) && QuantizeBC1Endpoints( endpoint0, endpoint1, &refinedColor0, &refinedColor1 ) )
+    {
+        uint32_t refinedError;
+        const uint32_t refinedIndices = SelectBC1Indices( texels, refinedColor0, refinedColor1, &refinedError );
+        if ( refinedError < error )
+        {
+            color0 = refinedColor0;
+            color1 = refinedColor1;
+            indices = refinedIndices;
+        }
+    }
+
+    WriteBC1Block( color0, color1, indices, block );
+}
+
+void DecodeBC1Block( const uint8_t block[ 8 ], uint8_t texels[ 64 ] )
+{
+    uint16_t color0, color1;
+    uint32_t indices;
+    memcpy( &color0, block, 2 );
+    memcpy( &color1, block + 2, 2 );
+    memcpy( &indices, block + 4, 4 );
+
+    uint8_t palette[ 4 ][ 4 ];
+    BuildBC1Palette( color0, color1, palette );
+    for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+    {
+        memcpy( texels + i * 4, palette[ ( indices >> ( i * 2 ) ) & 0x3 ], 4 );
+    }
+}
+
+//
+// BC4
+//
+
+static void BuildBC4Palette( uint8_t value0, uint8_t value1, uint8_t palette[ 8 ] )
+{
+    palette[ 0 ] = value0;
+    palette[ 1 ] = value1;
+    if ( value0 > value1 )
+    {
+        for ( uint32_t i = 2; i < 8; ++i )
+        {
+            palette[ i ] = (uint8_t)( ( ( 8 - i ) * value0 + ( i - 1 ) * value1 + 3 ) / 7 );
+        }
+    }
+    else
+    {
+        for ( uint32_t i = 2; i < 6; ++i )
+        {
+            palette[ i ] = (uint8_t)( ( ( 6 - i ) * value0 + ( i - 1 ) * value1 + 2 ) / 5 );
+        }
+        palette[ 6 ] = 0;
+        palette[ 7 ] = 255;
+    }
+}
+
+void EncodeBC4Block( const uint8_t texels[ 16 ], uint8_t block[ 8 ] )
+{
+    uint8_t minValue = 255;
+    uint8_t maxValue = 0;
+    for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+    {
+        minValue = std::min( minValue, texels[ i ] );
+        maxValue = std::max( maxValue, texels[ i ] );
+    }
+
+    uint8_t palette[ 8 ];
+    BuildBC4Palette( maxValue, minValue, palette );
+
+    uint64_t indices = 0;
+    for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+    {
+        uint32_t bestIndex = 0;
+        uint32_t bestError = UINT_MAX;
+        for ( uint32_t index = 0; index < 8; ++index )
+        {
+            const uint32_t error = (uint32_t)abs( (int32_t)texels[ i ] - (int32_t)palette[ index ] );
+            if ( error < bestError )
+            {
+                bestError = error;
+                bestIndex = index;
+            }
+        }
+        indices |= (uint64_t)bestIndex << ( i * 3 );
+    }
+
+    block[ 0 ] = maxValue;
+    block[ 1 ] = minValue;
+    for ( uint32_t i = 0; i < 6; ++i )
+    {
+        block[ 2 + i ] = (uint8_t)( indices >> ( i * 8 ) );
+    }
+}
+
+void DecodeBC4Block( const uint8_t block[ 8 ], uint8_t texels[ 16 ] )
+{
+    uint8_t palette[ 8 ];
+    BuildBC4Palette( block[ 0 ], block[ 1 ], palette );
+
+    uint64_t indices = 0;
+    for ( uint32_t i = 0; i < 6; ++i )
+    {
+        indices |= (uint64_t)block[ 2 + i ] << ( i * 8 );
+    }
+    for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+    {
+        texels[ i ] = palette[ ( indices >> ( i * 3 ) ) & 0x7 ];
+    }
+}
+
+//
+// BC7
+//
+
+class CBC7BlockWriter
+{
+public:
+    explicit CBC7BlockWriter( uint8_t block[ 16 ] ) : m_Block( block ), m_BitPosition( 0 )
+    {
+        memset( m_Block, 0, 16 );
+    }
+
+    void Write( uint32_t value, uint32_t bitCount )
+    {
+        for ( uint32_t i = 0; i < bitCount; ++i, ++m_BitPosition )
+        {
+            m_Block[ m_BitPosition >> 3 ] |= (uint8_t)( ( ( value >> i ) & 0x1 ) << ( m_BitPosition & 7 ) );
+        }
+    }
+
+private:
+    uint8_t* m_Block;
+    uint32_t m_BitPosition;
+};
+
+class CBC7BlockReader
+{
+public:
+    explicit CBC7BlockReader( const uint8_t block[ 16 ] ) : m_Block( block ), m_BitPosition( 0 ) {}
+
+    uint32_t Read( uint32_t bitCount )
+    {
+        uint32_t value = 0;
+        for ( uint32_t i = 0; i < bitCount; ++i, ++m_BitPosition )
+        {
+            value |= ( ( m_Block[ m_BitPosition >> 3 ] >> ( m_BitPosition & 7 ) ) & 0x1 ) << i;
+        }
+        return value;
+    }
+
+private:
+    const uint8_t* m_Block;
+    uint32_t m_BitPosition;
+};
+
+struct SBC7Mode6Block
+{
+    uint8_t m_Endpoints[ 2 ][ 4 ]; // 7-bit values
+    uint8_t m_PBits[ 2 ];
+    uint8_t m_Indices[ BC_BLOCK_TEXEL_COUNT ];
+};
+
+static void BuildBC7Mode6Palette( const SBC7Mode6Block& block, uint8_t palette[ BC7_MODE6_INDEX_COUNT ][ 4 ] )
+{
+    uint32_t endpoints[ 2 ][ 4 ];
+    for ( uint32_t e = 0; e < 2; ++e )
+    {
+        for ( uint32_t c = 0; c < 4; ++c )
+        {
+            endpoints[ e ][ c ] = ( (uint32_t)block.m_Endpoints[ e ][ c ] << 1 ) | block.m_PBits[ e ];
+        }
+    }
+    for ( uint32_t index = 0; index < BC7_MODE6_INDEX_COUNT; ++index )
+    {
+        const uint32_t weight = s_BC7Mode6Weights[ index ];
+        for ( uint32_t c = 0; c < 4; ++c )
+        {
+            palette[ index ][ c ] = (uint8_t)( ( ( 64 - weight ) * endpoints[ 0 ][ c ] + weight * endpoints[ 1 ][ c ] + 32 ) >> 6 );
+        }
+    }
+}
+
+static uint32_t SelectBC7Mode6Indices( const uint8_t texels[ 64 ], SBC7Mode6Block* block )
+{
+    uint8_t palette[ BC7_MODE6_INDEX_COUNT ][ 4 ];
+    BuildBC7Mode6Palette( *block, palette );
+
+    uint32_t totalError = 0;
+    for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+    {
+        uint32_t bestIndex = 0;
+        uint32_t bestError = UINT_MAX;
+        for ( uint32_t index = 0; index < BC7_MODE6_INDEX_COUNT; ++index )
+        {
+            const uint32_t error = CalculateSquaredError<4>( texels + i * 4, palette[ index ] );
+            if ( error < bestError )
+            {
+                bestError = error;
+                bestIndex = index;
+            }
+        }
+        block->m_Indices[ i ] = (uint8_t)bestIndex;
+        totalError += bestError;
+    }
+    return totalError;
+}
+
+// Tries every p-bit combination for the endpoints and keeps the one with the lowest error
+static uint32_t QuantizeBC7Mode6Block( const uint8_t texels[ 64 ], const float endpoint0[ 4 ], const float endpoint1[ 4 ], SBC7Mode6Block* outBlock )
+{
+    uint32_t bestError = UINT_MAX;
+    for ( uint32_t pBits = 0; pBits < 4; ++pBits )
+    {
+        SBC7Mode6Block block;
+        block.m_PBits[ 0 ] = pBits & 0x1;
+        block.m_PBits[ 1 ] = pBits >> 1;
+        for ( uint32_t c = 0; c < 4; ++c )
+        {
+            block.m_Endpoints[ 0 ][ c ] = (uint8_t)std::clamp( ( endpoint0[ c ] - block.m_PBits[ 0 ] ) * 0.5f + 0.5f, 0.f, 127.f );
+            block.m_Endpoints[ 1 ][ c ] = (uint8_t)std::clamp( ( endpoint1[ c ] - block.m_PBits[ 1 ] ) * 0.5f + 0.5f, 0.f, 127.f );
+        }
+        const uint32_t error = SelectBC7Mode6Indices( texels, &block );
+        if ( error < bestError )
+        {
+            bestError = error;
+            *outBlock = block;
+        }
+    }
+    return bestError;
+}
+
+void EncodeBC7Block( const uint8_t texels[ 64 ], uint8_t block[ 16 ] )
+{
+    float floatTexels[ BC_BLOCK_TEXEL_COUNT ][ 4 ];
+    LoadBlockTexels( texels, floatTexels );
+
+    float endpoint0[ 4 ];
+    float endpoint1[ 4 ];
+    FitEndpoints<4>( floatTexels, endpoint0, endpoint1 );
+
+    SBC7Mode6Block mode6Block;
+    uint32_t error = QuantizeBC7Mode6Block( texels, endpoint0, endpoint1, &mode6Block );
+    if ( error > 0 )
+    {
+        float weights[ BC_BLOCK_TEXEL_COUNT ];
+        for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+        {
+            weights[ i ] = s_BC7Mode6Weights[ mode6Block.m_Indices[ i ] ] / 64.f;
+        }
+        SBC7Mode6Block refinedBlock;
+        if ( RefineEndpoints<4>( floatTexels, weights, endpoint0, endpoint1 ) && QuantizeBC7Mode6Block( texels, endpoint0, endpoint1, &refinedBlock ) < error )
+        {
+            mode6Block = refinedBlock;
+        }
+    }
+
+    // The most significant index bit of the first texel is implicitly zero, swap the endpoints to satisfy it
+    if ( mode6Block.m_Indices[ 0 ] >= BC7_MODE6_INDEX_COUNT / 2 )
+    {
+        std::swap( mode6Block.m_Endpoints[ 0 ], mode6Block.m_Endpoints[ 1 ] );
+        std::swap( mode6Block.m_PBits[ 0 ], mode6Block.m_PBits[ 1 ] );
+        for ( uint8_t& index : mode6Block.m_Indices )
+        {
+            index = (uint8_t)( BC7_MODE6_INDEX_COUNT - 1 - index );
+        }
+    }
+
+    CBC7BlockWriter writer( block );
+    writer.Write( 1 << 6, 7 );
+    for ( uint32_t c = 0; c < 4; ++c )
+    {
+        writer.Write( mode6Block.m_Endpoints[ 0 ][ c ], 7 );
+        writer.Write( mode6Block.m_Endpoints[ 1 ][ c ], 7 );
+    }
+    writer.Write( mode6Block.m_PBits[ 0 ], 1 );
+    writer.Write( mode6Block.m_PBits[ 1 ], 1 );
+    writer.Write( mode6Block.m_Indices[ 0 ], 3 );
+    for ( uint32_t i = 1; i < BC_BLOCK_TEXEL_COUNT; ++i )
+    {
+        writer.Write( mode6Block.m_Indices[ i ], 4 );
+    }
+}
+
+void DecodeBC7Block( const uint8_t block[ 16 ], uint8_t texels[ 64 ] )
+{
+    CBC7BlockReader reader( block );
+    if ( reader.Read( 7 ) != ( 1 << 6 ) )
+    {
+        memset( texels, 0, 64 );
+        return;
+    }
+
+    SBC7Mode6Block mode6Block;
+    for ( uint32_t c = 0; c < 4; ++c )
+    {
+        mode6Block.m_Endpoints[ 0 ][ c ] = (uint8_t)reader.Read( 7 );
+        mode6Block.m_Endpoints[ 1 ][ c ] = (uint8_t)reader.Read( 7 );
+    }
+    mode6Block.m_PBits[ 0 ] = (uint8_t)reader.Read( 1 );
+    mode6Block.m_PBits[ 1 ] = (uint8_t)reader.Read( 1 );
+    mode6Block.m_Indices[ 0 ] = (uint8_t)reader.Read( 3 );
+    for ( uint32_t i = 1; i < BC_BLOCK_TEXEL_COUNT; ++i )
+    {
+        mode6Block.m_Indices[ i ] = (uint8_t)reader.Read( 4 );
+    }
+
+    uint8_t palette[ BC7_MODE6_INDEX_COUNT ][ 4 ];
+    BuildBC7Mode6Palette( mode6Block, palette );
+    for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+    {
+        memcpy( texels + i * 4, palette[ mode6Block.m_Indices[ i ] ], 4 );
+    }
+}
+
+//
+// Texture compression
+//
+
+// Gathers the 4x4 texels of a block, texels outside of levels smaller than a block repeat the edge
+static void GatherBlockTexels( const uint8_t* source, uint32_t width, uint32_t height, uint32_t BPP, uint32_t blockX, uint32_t blockY, uint8_t* texels )
+{
+    for ( uint32_t y = 0; y < 4; ++y )
+    {
+        const uint32_t sourceY = std::min( blockY * 4 + y, height - 1 );
+        for ( uint32_t x = 0; x < 4; ++x )
+        {
+            const uint32_t sourceX = std::min( blockX * 4 + x, width - 1 );
+            memcpy( texels + ( y * 4 + x ) * BPP, source + ( (size_t)sourceY * width + sourceX ) * BPP, BPP );
+        }
+    }
+}
+
+static void EncodeBlock( const uint8_t* source, uint32_t width, uint32_t height, ETexturePixelFormat sourceFormat, ETexturePixelFormat format, uint32_t blockX, uint32_t blockY, uint8_t* block )
+{
+    const uint32_t sourceBPP = GetTexturePixelFormatBPP( sourceFormat );
+    uint8_t texels[ 64 ];
+    GatherBlockTexels( source, width, height, sourceBPP, blockX, blockY, texels );
+    if ( format == ETexturePixelFormat::BC4_Unorm )
+    {
+        if ( sourceFormat == ETexturePixelFormat::R8G8B8A8_sRGB )
+        {
+            for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+            {
+                texels[ i ] = s_SRGBToLinearTable.m_Values[ texels[ i * 4 ] ];
+            }
+        }
+        EncodeBC4Block( texels, block );
+    }
+    else if ( format == ETexturePixelFormat::BC1_sRGB )
+    {
+        EncodeBC1Block( texels, block );
+    }
+    else
+    {
+        EncodeBC7Block( texels, block );
+    }
+}
+
+bool CanCompressTexture( const CTexture& texture )
+{
+    return ( texture.m_PixelFormat == ETexturePixelFormat::R8G8B8A8_sRGB || texture.m_PixelFormat == ETexturePixelFormat::R8_Unorm )
+        && texture.m_Width % 4 == 0 && texture.m_Height % 4 == 0;
+}
+
+bool CompressTexture( CTexture* texture, ETexturePixelFormat format, uint32_t maxWorkerCount )
+{
+    if ( !CanCompressTexture( *texture ) || !IsBlockCompressedTexturePixelFormat( format ) )
+    {
+        return false;
+    }
+
+    if ( format != ETexturePixelFormat::BC4_Unorm && texture->m_PixelFormat != ETexturePixelFormat::R8G8B8A8_sRGB )
+    {
+        return false;
+    }
+
+    // Every block row of every level is a task so small levels do not serialize the work
+    struct SBlockRowTask
+    {
+        uint32_t m_MipLevel;
+        uint32_t m_BlockRow;
+    };
+    std::vector<SBlockRowTask> tasks;
+    std::vector<size_t> mipOffsets( texture->m_MipLevelCount + 1, 0 );
+    for ( uint32_t mipLevel = 0; mipLevel < texture->m_MipLevelCount; ++mipLevel )
+    {
+        const uint32_t blockRowCount = CalculateTextureRowCount( texture->GetMipHeight( mipLevel ), format );
+        for ( uint32_t blockRow = 0; blockRow < blockRowCount; ++blockRow )
+        {
+            tasks.push_back( { mipLevel, blockRow } );
+        }
+        mipOffsets[ mipLevel + 1 ] = mipOffsets[ mipLevel ] + (size_t)CalculateTextureRowPitch( texture->GetMipWidth( mipLevel ), format ) * blockRowCount;
+    }
+
+    const uint32_t blockSize = GetTexturePixelFormatBlockSize( format );
+    std::vector<uint8_t> compressedData( mipOffsets.back() );
+    ParallelFor( (uint32_t)tasks.size(), [&]( uint32_t, uint32_t taskIndex )
+    {
+        const SBlockRowTask& task = tasks[ taskIndex ];
+        const uint32_t width = texture->GetMipWidth( task.m_MipLevel );
+        const uint32_t height = texture->GetMipHeight( task.m_MipLevel );
+        const uint8_t* source = texture->m_PixelData.data() + texture->GetMipOffset( task.m_MipLevel );
+        const uint32_t blockColumnCount = ( width + 3 ) / 4;
+        uint8_t* block = compressedData.data() + mipOffsets[ task.m_MipLevel ] + (size_t)task.m_BlockRow * blockColumnCount * blockSize;
+        for ( uint32_t blockColumn = 0; blockColumn < blockColumnCount; ++blockColumn, block += blockSize )
+        {
+            EncodeBlock( source, width, height, texture->m_PixelFormat, format, blockColumn, task.m_BlockRow, block );
+        }
+    }, maxWorkerCount );
+
+    texture->m_PixelData = std::move( compressedData );
+    texture->m_PixelFormat = format;
+    return true;
+}
+
+ETexturePixelFormat SelectCompressedPixelFormat( const CTexture& texture, bool isOpacityOnly )
+{
+    if ( isOpacityOnly || texture.m_PixelFormat == ETexturePixelFormat::R8_Unorm )
+    {
+        return ETexturePixelFormat::BC4_Unorm;
+    }
+
+    const uint32_t texelCount = texture.m_Width * texture.m_Height;
+    for ( uint32_t i = 0; i < texelCount; ++i )
+    {
+        if ( texture.m_PixelData[ i * 4 + 3 ] != 255 )
+        {
+            return ETexturePixelFormat::BC7_sRGB;
+        }
+    }
+    return ETexturePixelFormat::BC1_sRGB;
+}
+
+float CalculateTexturePSNR( const CTexture& reference, const CTexture& compressed )
+{
+    const uint32_t width = reference.m_Width;
+    const uint32_t height = reference.m_Height;
+    const uint32_t referenceBPP = GetTexturePixelFormatBPP( reference.m_PixelFormat );
+    const uint32_t blockSize = GetTexturePixelFormatBlockSize( compressed.m_PixelFormat );
+    const uint32_t blockColumnCount = ( width + 3 ) / 4;
+    const uint32_t channelCount = compressed.m_PixelFormat == ETexturePixelFormat::BC4_Unorm ? 1 : ( compressed.m_PixelFormat == ETexturePixelFormat::BC1_sRGB ? 3 : 4 );
+
+    uint64_t squaredError = 0;
+    for ( uint32_t blockY = 0; blockY < ( height + 3 ) / 4; ++blockY )
+    {
+        for ( uint32_t blockX = 0; blockX < blockColumnCount; ++blockX )
+        {
+            const uint8_t* block = compressed.m_PixelData.data() + ( (size_t)blockY * blockColumnCount + blockX ) * blockSize;
+            uint8_t decodedTexels[ 64 ];
+            if ( compressed.m_PixelFormat == ETexturePixelFormat::BC4_Unorm )
+            {
+                DecodeBC4Block( block, decodedTexels );
+            }
+            else if ( compressed.m_PixelFormat == ETexturePixelFormat::BC1_sRGB )
+            {
+                DecodeBC1Block( block, decodedTexels );
+            }
+            else
+            {
+                DecodeBC7Block( block, decodedTexels );
+            }
+
+            uint8_t referenceTexels[ 64 ];
+            GatherBlockTexels( reference.m_PixelData.data(), width, height, referenceBPP, blockX, blockY, referenceTexels );
+            for ( uint32_t i = 0; i < BC_BLOCK_TEXEL_COUNT; ++i )
+            {
+                if ( channelCount == 1 )
+                {
+                    const uint8_t referenceValue = reference.m_PixelFormat == ETexturePixelFormat::R8G8B8A8_sRGB ? s_SRGBToLinearTable.m_Values[ referenceTexels[ i * 4 ] ] : referenceTexels[ i ];
+                    const int32_t difference = (int32_t)referenceValue - decodedTexels[ i ];
+                    squaredError += difference * difference;
+                }
+                else
+                {
+                    for ( uint32_t c = 0; c < channelCount; ++c )
+                    {
+                        const int32_t difference = (int32_t)referenceTexels[ i * 4 + c ] - decodedTexels[ i * 4 + c ];
+                        squaredError += difference * difference;
+                    }
+                }
+            }
+        }
+    }
+
+    const double meanSquaredError = (double)squaredError / ( (double)width * height * channelCount );
+    return meanSquaredError > 0.0 ? (float)( 10.0 * log10( 255.0 * 255.0 / meanSquaredError ) ) : std::numeric_limits<float>::infinity();
+}
+
+void RunTextureCompressionBenchmark( const std::filesystem::path& directory )
+{
+#if defined( _WIN32 )
+    HRESULT coInitializeHR = CoInitializeEx( nullptr, COINIT_MULTITHREADED );
+    const bool shouldUninitializeCOM = SUCCEEDED( coInitializeHR );
+#endif
+
+    STextureCodec* codec = CTexture::CreateCodec();
+    std::vector<CTexture> textures;
+    std::error_code errorCode;
+    for ( const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator( directory, errorCode ) )
+    {
+        if ( !entry.is_regular_file() )
+        {
+            continue;
+        }
+
+        CTexture texture;
+        texture.Clear();
+        const std::string filename = entry.path().u8string();
+        if ( texture.LoadFromFile( filename.c_str(), codec ) && CanCompressTexture( texture ) )
+        {
+            texture.m_Name = entry.path().filename().u8string();
+            textures.emplace_back( std::move( texture ) );
+        }
+    }
+    CTexture::DestroyCodec( codec );
+
+    const std::string directoryName = directory.u8string();
+    LOG_STRING_FORMAT( "Benchmarking texture compression of %u textures in \"%s\".\n", (uint32_t)textures.size(), directoryName.c_str() );
+
+    const ETexturePixelFormat formats[] = { ETexturePixelFormat::BC1_sRGB, ETexturePixelFormat::BC4_Unorm, ETexturePixelFormat::BC7_sRGB };
+    const char* formatNames[] = { "BC1", "BC4", "BC7" };
+    for ( uint32_t iFormat = 0; iFormat < _countof( formats ) && !textures.empty(); ++iFormat )
+    {
+        double totalPSNR = 0.0;
+        uint32_t compressedTextureCount = 0;
+        uint64_t totalSourceSize = 0;
+        float totalSeconds = 0.f;
+        for ( const CTexture& texture : textures )
+        {
+            CTexture compressedTexture = texture;
+
+            Timer timer;
+            timer.Start();
+            if ( !CompressTexture( &compressedTexture, formats[ iFormat ] ) )
+            {
+                continue;
+            }
+            const float seconds = timer.GetElapsedSecondsFloat().count();
+
+            const float PSNR = CalculateTexturePSNR( texture, compressedTexture );
+            LOG_STRING_FORMAT( "  %s %s: %.2f dB, %.3f ms\n", formatNames[ iFormat ], texture.m_Name.c_str(), PSNR, seconds * 1000.f );
+            totalPSNR += std::min( PSNR, 100.f );
+            ++compressedTextureCount;
+            totalSourceSize += texture.m_PixelData.size();
+            totalSeconds += seconds;
+        }
+
+        LOG_STRING_FORMAT( "%s: %u textures, average %.2f dB, %.2f MB/s.\n", formatNames[ iFormat ], compressedTextureCount, totalPSNR / std::max( compressedTextureCount, 1u ), totalSourceSize / ( 1024.f * 1024.f ) / std::max( totalSeconds, 1e-6f ) );
+    }
+
+#if defined( _WIN32 )
+    if ( shouldUninitializeCOM )
+    {
+        CoUninitialize();
+    }
+#endif
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Texture.h"
+
+// 4x4 block encoders. RGBA texels are in row-major order, BC1 ignores alpha and BC7 only emits mode 6 blocks.
+void EncodeBC1Block( const uint8_t texels[ 64 ], uint8_t block[ 8 ] );
+
+void EncodeBC4Block( const uint8_t texels[ 16 ], uint8_t block[ 8 ] );
+
+void EncodeBC7Block( const uint8_t texels[ 64 ], uint8_t block[ 16 ] );
+
+void DecodeBC1Block( const uint8_t block[ 8 ], uint8_t texels[ 64 ] );
+
+void DecodeBC4Block( const uint8_t block[ 8 ], uint8_t texels[ 16 ] );
+
+// Only mode 6 is supported, other modes decode to transparent black
+void DecodeBC7Block( const uint8_t block[ 16 ], uint8_t texels[ 64 ] );
+
+// Whether a texture can be encoded, D3D12 requires the top level of block compressed textures to be a multiple of the block size
+bool CanCompressTexture( const CTexture& texture );
+
+// Compresses every mip level of an R8G8B8A8_sRGB or R8_Unorm texture into a BC format.
+// Converting R8G8B8A8_sRGB to BC4_Unorm keeps the linear value of the red channel, matching what the shaders read through the sRGB view.
+bool CompressTexture( CTexture* texture, ETexturePixelFormat format, uint32_t maxWorkerCount = 0 );
+
+// Picks BC1 for opaque color textures, BC7 for color textures with alpha and BC4 for textures only read as opacity
+ETexturePixelFormat SelectCompressedPixelFormat( const CTexture& texture, bool isOpacityOnly );
+
+// Computes the PSNR in dB between the top levels of two textures, the compressed one is decoded on the fly
+float CalculateTexturePSNR( const CTexture& reference, const CTexture& compressed );
+
+// Decodes every file in the directory, compresses it with each BC format and logs PSNR and throughput
+void RunTextureCompressionBenchmark( const std::filesystem::path& directory );
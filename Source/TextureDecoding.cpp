@@ -0,0 +1,1712 @@
+#include "stdafx.h"
+#include "TextureDecoding.h"
+#include "Texture.h"
+#include "Inflate.h"
+#include "Logging.h"
+
+// Largest image accepted by the decoders, keeps the RGBA8 byte size within 32 bits
+#define MAX_DECODED_IMAGE_PIXEL_COUNT   ( ( 1ull << 32 ) / 4 - 1 )
+
+static uint32_t ReadBigEndianUInt32( const uint8_t* data )
+{
+    return ( (uint32_t)data[ 0 ] << 24 ) | ( (uint32_t)data[ 1 ] << 16 ) | ( (uint32_t)data[ 2 ] << 8 ) | (uint32_t)data[ 3 ];
+}
+
+static uint16_t ReadLittleEndianUInt16( const uint8_t* data )
+{
+    return (uint16_t)( data[ 0 ] | ( data[ 1 ] << 8 ) );
+}
+
+static void AllocateTexture( uint32_t width, uint32_t height, ETexturePixelFormat format, CTexture* texture )
+{
+    texture->m_PixelData.resize( (size_t)width * height * GetTexturePixelFormatBPP( format ) );
+    texture->m_PixelFormat = format;
+    texture->m_Width = width;
+    texture->m_Height = height;
+    texture->m_MipLevelCount = 1;
+}
+
+static void AllocateRGBA8Texture( uint32_t width, uint32_t height, CTexture* texture )
+{
+    AllocateTexture( width, height, ETexturePixelFormat::R8G8B8A8_sRGB, texture );
+}
+
+//
+// PNG
+//
+
+static const uint8_t s_PNGSignature[ 8 ] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+enum EPNGColorType : uint8_t
+{
+    ePNGColorType_Gray = 0,
+    ePNGColorType_RGB = 2,
+    ePNGColorType_Palette = 3,
+    ePNGColorType_GrayAlpha = 4,
+    ePNGColorType_RGBA = 6,
+};
+
+struct SPNGHeader
+{
+    uint32_t m_Width;
+    uint32_t m_Height;
+    uint8_t m_BitDepth;
+    uint8_t m_ColorType;
+    uint8_t m_Interlace;
+};
+
+struct SPNGPalette
+{
+    uint8_t m_Colors[ 256 ][ 4 ];
+    uint32_t m_Size = 0;
+    bool m_HasColorKey = false;
+    uint16_t m_ColorKey[ 3 ]; // tRNS color key of gray and RGB images, compared against the raw samples
+};
+
+static uint32_t GetPNGChannelCount( uint8_t colorType )
+{
+    switch ( colorType )
+    {
+    case ePNGColorType_Gray:
+    case ePNGColorType_Palette:
+        return 1;
+    case ePNGColorType_GrayAlpha:
+        return 2;
+    case ePNGColorType_RGB:
+        return 3;
+    case ePNGColorType_RGBA:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static bool IsPNGBitDepthValid( uint8_t colorType, uint8_t bitDepth )
+{
+    switch ( colorType )
+    {
+    case ePNGColorType_Gray:
+        return bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8 || bitDepth == 16;
+    case ePNGColorType_Palette:
+        return bitDepth == 1 || bitDepth == 2 || bitDepth == 4 || bitDepth == 8;
+    case ePNGColorType_RGB:
+    case ePNGColorType_GrayAlpha:
+    case ePNGColorType_RGBA:
+        return bitDepth == 8 || bitDepth == 16;
+    default:
+        return false;
+    }
+}
+
+static uint8_t PaethPredictor( int32_t a, int32_t b, int32_t c )
+{
+    const int32_t p = a + b - c;
+    const int32_t pa = abs( p - a );
+    const int32_t pb = abs( p - b );
+    const int32_t pc = abs( p - c );
+    if ( pa <= pb && pa <= pc )
+    {
+        return (uint8_t)a;
+    }
+    return (uint8_t)( pb <= pc ? b : c );
+}
+
+// Reverts the per-row filters in place. Every row starts with its filter type byte followed by rowSize bytes.
+static bool UnfilterPNGRows( uint8_t* data, uint32_t rowSize, uint32_t rowCount, uint32_t filterStride )
+{
+    const uint8_t* previousRow = nullptr;
+    for ( uint32_t iRow = 0; iRow < rowCount; ++iRow )
+    {
+        const uint8_t filterType = data[ 0 ];
+        uint8_t* row = data + 1;
+        switch ( filterType )
+        {
+        case 0:
+            break;
+        case 1:
+            for ( uint32_t i = filterStride; i < rowSize; ++i )
+            {
+                row[ i ] += row[ i - filterStride ];
+            }
+            break;
+        case 2:
+            if ( previousRow )
+            {
+                for ( uint32_t i = 0; i < rowSize; ++i )
+                {
+                    row[ i ] += previousRow[ i ];
+                }
+            }
+            break;
+        case 3:
+            for ( uint32_t i = 0; i < rowSize; ++i )
+            {
+                const uint32_t left = i >= filterStride ? row[ i - filterStride ] : 0;
+                const uint32_t up = previousRow ? previousRow[ i ] : 0;
+                row[ i ] += (uint8_t)( ( left + up ) >> 1 );
+            }
+            break;
+        case 4:
+            for ( uint32_t i = 0; i < rowSize; ++i )
+            {
+                const int32_t left = i >= filterStride ? row[ i - filterStride ] : 0;
+                const int32_t up = previousRow ? previousRow[ i ] : 0;
+                const int32_t upLeft = previousRow && i >= filterStride ? previousRow[ i - filterStride ] : 0;
+                row[ i ] += PaethPredictor( left, up, upLeft );
+            }
+            break;
+        default:
+            LOG_STRING_FORMAT( "Invalid PNG filter type %u.\n", filterType );
+            return false;
+        }
+        previousRow = row;
+        data += rowSize + 1;
+    }
+    return true;
+}
+
+static uint16_t ReadPNGSample( const uint8_t* row, uint32_t sampleIndex, uint8_t bitDepth )
+{
+    if ( bitDepth == 8 )
+    {
+        return row[ sampleIndex ];
+    }
+    else if ( bitDepth == 16 )
+    {
+        return (uint16_t)( ( row[ sampleIndex * 2 ] << 8 ) | row[ sampleIndex * 2 + 1 ] );
+    }
+    const uint32_t bitOffset = sampleIndex * bitDepth;
+    const uint32_t shift = 8 - bitDepth - ( bitOffset & 7 );
+    return (uint16_t)( ( row[ bitOffset >> 3 ] >> shift ) & ( ( 1u << bitDepth ) - 1 ) );
+}
+
+static uint8_t PNGSampleToUNorm8( uint16_t sample, uint8_t bitDepth )
+{
+    if ( bitDepth == 16 )
+    {
+        return (uint8_t)( sample >> 8 );
+    }
+    else if ( bitDepth < 8 )
+    {
+        return (uint8_t)( sample * 255 / ( ( 1u << bitDepth ) - 1 ) );
+    }
+    return (uint8_t)sample;
+}
+
+// Converts one unfiltered row to RGBA8, writing every xStep-th pixel of the destination row starting from xStart
+static void ConvertPNGRow( const uint8_t* row, uint32_t pixelCount, const SPNGHeader& header, const SPNGPalette& palette, uint8_t* destination, uint32_t xStart, uint32_t xStep )
+{
+    const uint8_t bitDepth = header.m_BitDepth;
+    uint8_t* pixel = destination + xStart * 4;
+    const uint32_t pixelStride = xStep * 4;
+    if ( bitDepth == 8 && header.m_ColorType == ePNGColorType_RGBA )
+    {
+        for ( uint32_t iPixel = 0; iPixel < pixelCount; ++iPixel, pixel += pixelStride, row += 4 )
+        {
+            memcpy( pixel, row, 4 );
+        }
+        return;
+    }
+
+    for ( uint32_t iPixel = 0; iPixel < pixelCount; ++iPixel, pixel += pixelStride )
+    {
+        switch ( header.m_ColorType )
+        {
+        case ePNGColorType_Gray:
+        {
+            const uint16_t gray = ReadPNGSample( row, iPixel, bitDepth );
+            pixel[ 0 ] = pixel[ 1 ] = pixel[ 2 ] = PNGSampleToUNorm8( gray, bitDepth );
+            pixel[ 3 ] = palette.m_HasColorKey && gray == palette.m_ColorKey[ 0 ] ? 0 : 255;
+            break;
+        }
+        case ePNGColorType_RGB:
+        {
+            const uint16_t r = ReadPNGSample( row, iPixel * 3, bitDepth );
+            const uint16_t g = ReadPNGSample( row, iPixel * 3 + 1, bitDepth );
+            const uint16_t b = ReadPNGSample( row, iPixel * 3 + 2, bitDepth );
+            pixel[ 0 ] = PNGSampleToUNorm8( r, bitDepth );
+            pixel[ 1 ] = PNGSampleToUNorm8( g, bitDepth );
+            pixel[ 2 ] = PNGSampleToUNorm8( b, bitDepth );
+            pixel[ 3 ] = palette.m_HasColorKey && r == palette.m_ColorKey[ 0 ] && g == palette.m_ColorKey[ 1 ] && b == palette.m_ColorKey[ 2 ] ? 0 : 255;
+            break;
+        }
+        case ePNGColorType_Palette:
+        {
+            // Out of range indices are caught by the palette being padded with opaque black
+            memcpy( pixel, palette.m_Colors[ ReadPNGSample( row, iPixel, bitDepth ) ], 4 );
+            break;
+        }
+        case ePNGColorType_GrayAlpha:
+        {
+            pixel[ 0 ] = pixel[ 1 ] = pixel[ 2 ] = PNGSampleToUNorm8( ReadPNGSample( row, iPixel * 2, bitDepth ), bitDepth );
+            pixel[ 3 ] = PNGSampleToUNorm8( ReadPNGSample( row, iPixel * 2 + 1, bitDepth ), bitDepth );
+            break;
+        }
+        case ePNGColorType_RGBA:
+        {
+            for ( uint32_t iChannel = 0; iChannel < 4; ++iChannel )
+            {
+                pixel[ iChannel ] = PNGSampleToUNorm8( ReadPNGSample( row, iPixel * 4 + iChannel, bitDepth ), bitDepth );
+            }
+            break;
+        }
+        }
+    }
+}
+
+bool IsPNGData( const uint8_t* data, size_t size )
+{
+    return size >= sizeof( s_PNGSignature ) && memcmp( data, s_PNGSignature, sizeof( s_PNGSignature ) ) == 0;
+}
+
+bool DecodePNG( const uint8_t* data, size_t size, CTexture* texture )
+{
+    if ( !IsPNGData( data, size ) )
+    {
+        return false;
+    }
+
+    SPNGHeader header = {};
+    SPNGPalette palette;
+    for ( uint32_t iColor = 0; iColor < 256; ++iColor )
+    {
+        palette.m_Colors[ iColor ][ 0 ] = palette.m_Colors[ iColor ][ 1 ] = palette.m_Colors[ iColor ][ 2 ] = 0;
+        palette.m_Colors[ iColor ][ 3 ] = 255;
+    }
+
+    // Gather the header, palette and the concatenated image data, CRCs are not verified
+    std::vector<uint8_t> compressedData;
+    bool hasHeader = false;
+    size_t position = sizeof( s_PNGSignature );
+    while ( position + 12 <= size )
+    {
+        const uint32_t chunkSize = ReadBigEndianUInt32( data + position );
+        const uint8_t* chunkType = data + position + 4;
+        const uint8_t* chunkData = data + position + 8;
+        if ( chunkSize > size - position - 12 )
+        {
+            LOG_STRING( "PNG chunk exceeds the end of file.\n" );
+            return false;
+        }
+        position += (size_t)chunkSize + 12;
+
+        if ( memcmp( chunkType, "IHDR", 4 ) == 0 )
+        {
+            if ( chunkSize < 13 )
+            {
+                return false;
+            }
+            header.m_Width = ReadBigEndianUInt32( chunkData );
+            header.m_Height = ReadBigEndianUInt32( chunkData + 4 );
+            header.m_BitDepth = chunkData[ 8 ];
+            header.m_ColorType = chunkData[ 9 ];
+            header.m_Interlace = chunkData[ 12 ];
+            hasHeader = true;
+        }
+        else if ( memcmp( chunkType, "PLTE", 4 ) == 0 )
+        {
+            palette.m_Size = std::min( chunkSize / 3, 256u );
+            for ( uint32_t iColor = 0; iColor < palette.m_Size; ++iColor )
+            {
+                memcpy( palette.m_Colors[ iColor ], chunkData + iColor * 3, 3 );
+            }
+        }
+        else if ( memcmp( chunkType, "tRNS", 4 ) == 0 )
+        {
+            if ( header.m_ColorType == ePNGColorType_Palette )
+            {
+                for ( uint32_t iColor = 0; iColor < std::min( chunkSize, 256u ); ++iColor )
+                {
+                    palette.m_Colors[ iColor ][ 3 ] = chunkData[ iColor ];
+                }
+            }
+            else if ( ( header.m_ColorType == ePNGColorType_Gray && chunkSize >= 2 ) || ( header.m_ColorType == ePNGColorType_RGB && chunkSize >= 6 ) )
+            {
+                palette.m_HasColorKey = true;
+                for ( uint32_t iChannel = 0; iChannel < chunkSize / 2 && iChannel < 3; ++iChannel )
+                {
+                    palette.m_ColorKey[ iChannel ] = (uint16_t)( ( chunkData[ iChannel * 2 ] << 8 ) | chunkData[ iChannel * 2 + 1 ] );
+                }
+            }
+        }
+        else if ( memcmp( chunkType, "IDAT", 4 ) == 0 )
+        {
+            compressedData.insert( compressedData.end(), chunkData, chunkData + chunkSize );
+        }
+        else if ( memcmp( chunkType, "IEND", 4 ) == 0 )
+        {
+            break;
+        }
+    }
+
+    if ( !hasHeader || header.m_Width == 0 || header.m_Height == 0 || !IsPNGBitDepthValid( header.m_ColorType, header.m_BitDepth ) || header.m_Interlace > 1 )
+    {
+        LOG_STRING( "Invalid or unsupported PNG header.\n" );
+        return false;
+    }
+
+    if ( (uint64_t)header.m_Width * header.m_Height > MAX_DECODED_IMAGE_PIXEL_COUNT )
+    {
+        LOG_STRING( "PNG image is too large.\n" );
+        return false;
+    }
+
+    if ( header.m_ColorType == ePNGColorType_Palette && palette.m_Size == 0 )
+    {
+        LOG_STRING( "PNG palette is missing.\n" );
+        return false;
+    }
+
+    std::vector<uint8_t> imageData;
+    if ( !InflateZlibStream( compressedData.data(), compressedData.size(), &imageData ) )
+    {
+        LOG_STRING( "Decompressing PNG image data failed.\n" );
+        return false;
+    }
+
+    const uint32_t bitsPerPixel = GetPNGChannelCount( header.m_ColorType ) * header.m_BitDepth;
+    const uint32_t filterStride = std::max( bitsPerPixel / 8, 1u );
+
+    // Non-interlaced images are treated as a single pass covering every pixel
+    static const uint32_t s_Adam7XStart[ 7 ] = { 0, 4, 0, 2, 0, 1, 0 };
+    static const uint32_t s_Adam7YStart[ 7 ] = { 0, 0, 4, 0, 2, 0, 1 };
+    static const uint32_t s_Adam7XStep[ 7 ] = { 8, 8, 4, 4, 2, 2, 1 };
+    static const uint32_t s_Adam7YStep[ 7 ] = { 8, 8, 8, 4, 4, 2, 2 };
+    const uint32_t passCount = header.m_Interlace ? 7 : 1;
+
+    AllocateRGBA8Texture( header.m_Width, header.m_Height, texture );
+    uint8_t* passData = imageData.data();
+    size_t remainingSize = imageData.size();
+    for ( uint32_t iPass = 0; iPass < passCount; ++iPass )
+    {
+        const uint32_t xStart = header.m_Interlace ? s_Adam7XStart[ iPass ] : 0;
+        const uint32_t yStart = header.m_Interlace ? s_Adam7YStart[ iPass ] : 0;
+        const uint32_t xStep = header.m_Interlace ? s_Adam7XStep[ iPass ] : 1;
+        const uint32_t yStep = header.m_Interlace ? s_Adam7YStep[ iPass ] : 1;
+        if ( xStart >= header.m_Width || yStart >= header.m_Height )
+        {
+            continue;
+        }
+
+        const uint32_t passWidth = ( header.m_Width - xStart + xStep - 1 ) / xStep;
+        const uint32_t passHeight = ( header.m_Height - yStart + yStep - 1 ) / yStep;
+        const uint32_t rowSize = (uint32_t)( ( (uint64_t)passWidth * bitsPerPixel + 7 ) / 8 );
+        const size_t passSize = ( (size_t)rowSize + 1 ) * passHeight;
+        if ( passSize > remainingSize )
+        {
+            LOG_STRING( "PNG image data is truncated.\n" );
+            texture->Clear();
+            return false;
+        }
+
+        if ( !UnfilterPNGRows( passData, rowSize, passHeight, filterStride ) )
+        {
+            texture->Clear();
+            return false;
+        }
+
+        for ( uint32_t iRow = 0; iRow < passHeight; ++iRow )
+        {
+            uint8_t* destinationRow = texture->m_PixelData.data() + (size_t)( yStart + iRow * yStep ) * header.m_Width * 4;
+            ConvertPNGRow( passData + (size_t)iRow * ( rowSize + 1 ) + 1, passWidth, header, palette, destinationRow, xStart, xStep );
+        }
+
+        passData += passSize;
+        remainingSize -= passSize;
+    }
+
+    return true;
+}
+
+//
+// TGA
+//
+
+#define TGA_HEADER_SIZE                 18
+#define TGA_DESCRIPTOR_RIGHT_TO_LEFT    0x10
+#define TGA_DESCRIPTOR_TOP_TO_BOTTOM    0x20
+
+enum ETGAImageType : uint8_t
+{
+    eTGAImageType_ColorMapped = 1,
+    eTGAImageType_TrueColor = 2,
+    eTGAImageType_Gray = 3,
+    eTGAImageType_RLEColorMapped = 9,
+    eTGAImageType_RLETrueColor = 10,
+    eTGAImageType_RLEGray = 11,
+};
+
+struct STGAHeader
+{
+    uint8_t m_IdLength;
+    uint8_t m_ColorMapType;
+    uint8_t m_ImageType;
+    uint16_t m_ColorMapFirstEntry;
+    uint16_t m_ColorMapLength;
+    uint8_t m_ColorMapEntrySize;
+    uint16_t m_Width;
+    uint16_t m_Height;
+    uint8_t m_PixelDepth;
+    uint8_t m_Descriptor;
+};
+
+static STGAHeader ReadTGAHeader( const uint8_t* data )
+{
+    STGAHeader header;
+    header.m_IdLength = data[ 0 ];
+    header.m_ColorMapType = data[ 1 ];
+    header.m_ImageType = data[ 2 ];
+    header.m_ColorMapFirstEntry = ReadLittleEndianUInt16( data + 3 );
+    header.m_ColorMapLength = ReadLittleEndianUInt16( data + 5 );
+    header.m_ColorMapEntrySize = data[ 7 ];
+    header.m_Width = ReadLittleEndianUInt16( data + 12 );
+    header.m_Height = ReadLittleEndianUInt16( data + 14 );
+    header.m_PixelDepth = data[ 16 ];
+    header.m_Descriptor = data[ 17 ];
+    return header;
+}
+
+static bool IsTGAColorDepthValid( uint8_t depth )
+{
+    return depth == 15 || depth == 16 || depth == 24 || depth == 32;
+}
+
+// Converts a BGR(A) or A1R5G5B5 value of the given bit depth to RGBA8
+static void ConvertTGAColor( const uint8_t* source, uint8_t depth, uint8_t* destination )
+{
+    if ( depth == 15 || depth == 16 )
+    {
+        const uint16_t value = ReadLittleEndianUInt16( source );
+        destination[ 0 ] = (uint8_t)( ( ( value >> 10 ) & 0x1F ) * 255 / 31 );
+        destination[ 1 ] = (uint8_t)( ( ( value >> 5 ) & 0x1F ) * 255 / 31 );
+        destination[ 2 ] = (uint8_t)( ( value & 0x1F ) * 255 / 31 );
+        destination[ 3 ] = 255;
+    }
+    else
+    {
+        destination[ 0 ] = source[ 2 ];
+        destination[ 1 ] = source[ 1 ];
+        destination[ 2 ] = source[ 0 ];
+        destination[ 3 ] = depth == 32 ? source[ 3 ] : 255;
+    }
+}
+
+bool IsTGAData( const uint8_t* data, size_t size )
+{
+    // TGA has no signature, the header fields are checked for consistency instead
+    if ( size < TGA_HEADER_SIZE )
+    {
+        return false;
+    }
+
+    const STGAHeader header = ReadTGAHeader( data );
+    if ( header.m_Width == 0 || header.m_Height == 0 || header.m_ColorMapType > 1 )
+    {
+        return false;
+    }
+
+    switch ( header.m_ImageType )
+    {
+    case eTGAImageType_ColorMapped:
+    case eTGAImageType_RLEColorMapped:
+        return header.m_ColorMapType == 1 && header.m_PixelDepth == 8 && IsTGAColorDepthValid( header.m_ColorMapEntrySize );
+    case eTGAImageType_TrueColor:
+    case eTGAImageType_RLETrueColor:
+        return IsTGAColorDepthValid( header.m_PixelDepth );
+    case eTGAImageType_Gray:
+    case eTGAImageType_RLEGray:
+        return header.m_PixelDepth == 8 || header.m_PixelDepth == 16;
+    default:
+        return false;
+    }
+}
+
+bool DecodeTGA( const uint8_t* data, size_t size, CTexture* texture )
+{
+    if ( !IsTGAData( data, size ) )
+    {
+        return false;
+    }
+
+    const STGAHeader header = ReadTGAHeader( data );
+    const bool isColorMapped = header.m_ImageType == eTGAImageType_ColorMapped || header.m_ImageType == eTGAImageType_RLEColorMapped;
+    const bool isGray = header.m_ImageType == eTGAImageType_Gray || header.m_ImageType == eTGAImageType_RLEGray;
+    const bool isRLE = header.m_ImageType >= eTGAImageType_RLEColorMapped;
+
+    size_t position = TGA_HEADER_SIZE + header.m_IdLength;
+    std::vector<uint8_t> colorMap;
+    if ( header.m_ColorMapType == 1 )
+    {
+        const uint32_t entrySize = ( header.m_ColorMapEntrySize + 7 ) / 8;
+        const size_t colorMapSize = (size_t)header.m_ColorMapLength * entrySize;
+        if ( position + colorMapSize > size )
+        {
+            LOG_STRING( "TGA color map is truncated.\n" );
+            return false;
+        }
+        if ( isColorMapped )
+        {
+            colorMap.resize( (size_t)header.m_ColorMapLength * 4 );
+            for ( uint32_t iEntry = 0; iEntry < header.m_ColorMapLength; ++iEntry )
+            {
+                ConvertTGAColor( data + position + iEntry * entrySize, header.m_ColorMapEntrySize, colorMap.data() + iEntry * 4 );
+            }
+        }
+        position += colorMapSize;
+    }
+
+    const uint32_t bytesPerPixel = ( header.m_PixelDepth + 7 ) / 8;
+    auto ConvertPixel = [&]( const uint8_t* source, uint8_t* destination )
+    {
+        if ( isColorMapped )
+        {
+            const uint32_t entryIndex = (uint32_t)source[ 0 ] - header.m_ColorMapFirstEntry;
+            if ( entryIndex < header.m_ColorMapLength )
+            {
+                memcpy( destination, colorMap.data() + entryIndex * 4, 4 );
+            }
+            else
+            {
+                destination[ 0 ] = destination[ 1 ] = destination[ 2 ] = 0;
+                destination[ 3 ] = 255;
+            }
+        }
+        else if ( isGray )
+        {
+            destination[ 0 ] = destination[ 1 ] = destination[ 2 ] = source[ 0 ];
+            destination[ 3 ] = bytesPerPixel == 2 ? source[ 1 ] : 255;
+        }
+        else
+        {
+            ConvertTGAColor( source, header.m_PixelDepth, destination );
+        }
+    };
+
+    // Pixels are decoded in file order then placed according to the origin bits of the descriptor
+    const uint32_t pixelCount = (uint32_t)header.m_Width * header.m_Height;
+    std::vector<uint8_t> pixels( (size_t)pixelCount * 4 );
+    uint32_t iPixel = 0;
+    while ( iPixel < pixelCount )
+    {
+        uint32_t runLength = pixelCount - iPixel;
+        bool isRepeated = false;
+        if ( isRLE )
+        {
+            if ( position >= size )
+            {
+                break;
+            }
+            const uint8_t packetHeader = data[ position++ ];
+            runLength = std::min( (uint32_t)( packetHeader & 0x7F ) + 1, pixelCount - iPixel );
+            isRepeated = ( packetHeader & 0x80 ) != 0;
+        }
+
+        const size_t readSize = (size_t)( isRepeated ? 1 : runLength ) * bytesPerPixel;
+        if ( position + readSize > size )
+        {
+            break;
+        }
+
+        for ( uint32_t iRun = 0; iRun < runLength; ++iRun, ++iPixel )
+        {
+            ConvertPixel( data + position + ( isRepeated ? 0 : iRun * bytesPerPixel ), pixels.data() + (size_t)iPixel * 4 );
+        }
+        position += readSize;
+    }
+
+    if ( iPixel < pixelCount )
+    {
+        LOG_STRING( "TGA image data is truncated.\n" );
+        return false;
+    }
+
+    AllocateRGBA8Texture( header.m_Width, header.m_Height, texture );
+    const bool isTopToBottom = ( header.m_Descriptor & TGA_DESCRIPTOR_TOP_TO_BOTTOM ) != 0;
+    const bool isRightToLeft = ( header.m_Descriptor & TGA_DESCRIPTOR_RIGHT_TO_LEFT ) != 0;
+    const size_t rowSize = (size_t)header.m_Width * 4;
+    for ( uint32_t iRow = 0; iRow < header.m_Height; ++iRow )
+    {
+        const uint8_t* sourceRow = pixels.data() + ( isTopToBottom ? iRow : header.m_Height - 1 - iRow ) * rowSize;
+        uint8_t* destinationRow = texture->m_PixelData.data() + iRow * rowSize;
+        if ( isRightToLeft )
+        {
+            for ( uint32_t iColumn = 0; iColumn < header.m_Width; ++iColumn )
+            {
+                memcpy( destinationRow + iColumn * 4, sourceRow + ( header.m_Width - 1 - iColumn ) * 4, 4 );
+            }
+        }
+        else
+        {
+            memcpy( destinationRow, sourceRow, rowSize );
+        }
+    }
+
+    return true;
+}
+
+
+//
+// JPEG
+//
+
+#define JPEG_HUFFMAN_LOOKUP_BITS        9
+#define JPEG_MAX_COMPONENT_COUNT        4
+
+enum EJPEGMarker : uint8_t
+{
+    eJPEGMarker_SOF0 = 0xC0,    // Baseline
+    eJPEGMarker_SOF1 = 0xC1,    // Extended sequential, Huffman
+    eJPEGMarker_SOF2 = 0xC2,    // Progressive, Huffman
+    eJPEGMarker_DHT = 0xC4,
+    eJPEGMarker_RST0 = 0xD0,
+    eJPEGMarker_RST7 = 0xD7,
+    eJPEGMarker_SOI = 0xD8,
+    eJPEGMarker_EOI = 0xD9,
+    eJPEGMarker_SOS = 0xDA,
+    eJPEGMarker_DQT = 0xDB,
+    eJPEGMarker_DRI = 0xDD,
+    eJPEGMarker_APP14 = 0xEE,
+    eJPEGMarker_TEM = 0x01,
+};
+
+// Natural index of each zig-zag position, the extra entries keep corrupt runs past the last coefficient in bounds
+static const uint8_t s_JPEGZigZagToNatural[ 64 + 16 ] =
+{
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63,
+    63, 63, 63, 63, 63, 63, 63, 63,
+    63, 63, 63, 63, 63, 63, 63, 63,
+};
+
+struct SJPEGIDCTBasis
+{
+    SJPEGIDCTBasis()
+    {
+        for ( uint32_t x = 0; x < 8; ++x )
+        {
+            for ( uint32_t u = 0; u < 8; ++u )
+            {
+                const double scale = u == 0 ? sqrt( 0.125 ) : 0.5;
+                m_Values[ x ][ u ] = (float)( scale * cos( ( 2 * x + 1 ) * u * 3.14159265358979323846 / 16 ) );
+            }
+        }
+    }
+
+    float m_Values[ 8 ][ 8 ];
+};
+
+static const SJPEGIDCTBasis s_JPEGIDCTBasis;
+
+struct SJPEGHuffmanTable
+{
+    uint16_t m_Lookup[ 1 << JPEG_HUFFMAN_LOOKUP_BITS ]; // ( code length << 8 ) | value of codes not longer than the lookup, 0 otherwise
+    int32_t m_MaxCodes[ 17 ];                           // Largest code of each length, -1 when there is none
+    int32_t m_ValueOffsets[ 17 ];
+    uint8_t m_Values[ 256 ];
+    bool m_IsDefined = false;
+};
+
+struct SJPEGComponent
+{
+    uint8_t m_Id;
+    uint8_t m_HorizontalSampling;
+    uint8_t m_VerticalSampling;
+    uint8_t m_QuantizationTable;
+    uint8_t m_DCTable;
+    uint8_t m_ACTable;
+    uint32_t m_Width;           // Samples before upsampling
+    uint32_t m_Height;
+    uint32_t m_BlockCountX;     // Blocks covering the samples
+    uint32_t m_BlockCountY;
+    uint32_t m_BlockStride;     // Blocks per row of the coefficients, padded to whole MCUs
+    int32_t m_DCPrediction;
+    std::vector<int16_t> m_Coefficients; // 64 per block in natural order, not dequantized
+    std::vector<uint8_t> m_Samples;      // m_BlockCountX * 8 samples per row
+};
+
+struct SJPEGScan
+{
+    SJPEGComponent* m_Components[ JPEG_MAX_COMPONENT_COUNT ];
+    uint32_t m_ComponentCount;
+    uint32_t m_SpectralStart;
+    uint32_t m_SpectralEnd;
+    uint32_t m_ApproximationHigh;
+    uint32_t m_ApproximationLow;
+    uint32_t m_EOBRun;
+};
+
+struct SJPEGDecoder
+{
+    SJPEGHuffmanTable m_HuffmanTables[ 2 ][ 4 ]; // DC tables then AC tables
+    uint16_t m_QuantizationTables[ 4 ][ 64 ];    // Natural order
+    SJPEGComponent m_Components[ JPEG_MAX_COMPONENT_COUNT ];
+    uint32_t m_ComponentCount = 0;
+    uint32_t m_Width = 0;
+    uint32_t m_Height = 0;
+    uint32_t m_MaxHorizontalSampling = 0;
+    uint32_t m_MaxVerticalSampling = 0;
+    uint32_t m_MCUCountX = 0;
+    uint32_t m_MCUCountY = 0;
+    uint32_t m_RestartInterval = 0;
+    int32_t m_AdobeTransform = -1; // -1 without an Adobe segment
+    bool m_IsProgressive = false;
+};
+
+// Reads the entropy coded data of a scan, stuffed zero bytes are removed and zeros are shifted in once a marker is reached
+struct SJPEGBitReader
+{
+    const uint8_t* m_Data;
+    size_t m_Size;
+    size_t m_Position;
+    uint32_t m_Bits = 0; // Left aligned
+    uint32_t m_BitCount = 0;
+    bool m_IsAtMarker = false;
+
+    void Fill()
+    {
+        while ( m_BitCount <= 24 )
+        {
+            uint32_t byte = 0;
+            if ( !m_IsAtMarker && m_Position < m_Size )
+            {
+                byte = m_Data[ m_Position ];
+                if ( byte != 0xFF )
+                {
+                    ++m_Position;
+                }
+                else if ( m_Position + 1 < m_Size && m_Data[ m_Position + 1 ] == 0x00 )
+                {
+                    m_Position += 2;
+                }
+                else
+                {
+                    m_IsAtMarker = true;
+                    byte = 0;
+                }
+            }
+            m_Bits |= byte << ( 24 - m_BitCount );
+            m_BitCount += 8;
+        }
+    }
+
+    void Skip( uint32_t count )
+    {
+        m_Bits <<= count;
+        m_BitCount -= count;
+    }
+
+    // 1 to 16 bits
+    uint32_t GetBits( uint32_t count )
+    {
+        Fill();
+        const uint32_t value = m_Bits >> ( 32 - count );
+        Skip( count );
+        return value;
+    }
+
+    // Drops the padding bits of the interval and the restart marker following it
+    void Restart()
+    {
+        m_Bits = 0;
+        m_BitCount = 0;
+        m_IsAtMarker = false;
+        while ( m_Position + 1 < m_Size )
+        {
+            const uint8_t marker = m_Data[ m_Position + 1 ];
+            if ( m_Data[ m_Position ] == 0xFF && marker != 0x00 && marker != 0xFF )
+            {
+                if ( marker >= eJPEGMarker_RST0 && marker <= eJPEGMarker_RST7 )
+                {
+                    m_Position += 2;
+                }
+                break;
+            }
+            ++m_Position;
+        }
+    }
+};
+
+static uint16_t ReadBigEndianUInt16( const uint8_t* data )
+{
+    return (uint16_t)( ( data[ 0 ] << 8 ) | data[ 1 ] );
+}
+
+static bool BuildJPEGHuffmanTable( const uint8_t* codeCounts, const uint8_t* values, SJPEGHuffmanTable* table )
+{
+    memset( table->m_Lookup, 0, sizeof( table->m_Lookup ) );
+    uint32_t code = 0;
+    uint32_t valueIndex = 0;
+    for ( uint32_t length = 1; length <= 16; ++length )
+    {
+        table->m_ValueOffsets[ length ] = (int32_t)valueIndex - (int32_t)code;
+        for ( uint32_t iCode = 0; iCode < codeCounts[ length - 1 ]; ++iCode, ++code, ++valueIndex )
+        {
+            if ( code >= ( 1u << length ) )
+            {
+                return false;
+            }
+            table->m_Values[ valueIndex ] = values[ valueIndex ];
+            if ( length <= JPEG_HUFFMAN_LOOKUP_BITS )
+            {
+                const uint32_t shift = JPEG_HUFFMAN_LOOKUP_BITS - length;
+                for ( uint32_t iEntry = code << shift; iEntry < ( code + 1 ) << shift; ++iEntry )
+                {
+                    table->m_Lookup[ iEntry ] = (uint16_t)( ( length << 8 ) | values[ valueIndex ] );
+                }
+            }
+        }
+        table->m_MaxCodes[ length ] = codeCounts[ length - 1 ] != 0 ? (int32_t)code - 1 : -1;
+        code <<= 1;
+    }
+    table->m_IsDefined = true;
+    return true;
+}
+
+// Returns -1 on an invalid code
+static int32_t DecodeJPEGHuffmanSymbol( SJPEGBitReader* reader, const SJPEGHuffmanTable& table )
+{
+    reader->Fill();
+    const uint16_t entry = table.m_Lookup[ reader->m_Bits >> ( 32 - JPEG_HUFFMAN_LOOKUP_BITS ) ];
+    if ( entry != 0 )
+    {
+        reader->Skip( entry >> 8 );
+        return entry & 0xFF;
+    }
+    for ( uint32_t length = JPEG_HUFFMAN_LOOKUP_BITS + 1; length <= 16; ++length )
+    {
+        const int32_t code = (int32_t)( reader->m_Bits >> ( 32 - length ) );
+        if ( code <= table.m_MaxCodes[ length ] )
+        {
+            reader->Skip( length );
+            return table.m_Values[ code + table.m_ValueOffsets[ length ] ];
+        }
+    }
+    return -1;
+}
+
+static int32_t ExtendJPEGValue( uint32_t value, uint32_t bitCount )
+{
+    return value < ( 1u << ( bitCount - 1 ) ) ? (int32_t)value - (int32_t)( 1u << bitCount ) + 1 : (int32_t)value;
+}
+
+static bool DecodeJPEGBlock( SJPEGDecoder* decoder, SJPEGScan* scan, SJPEGBitReader* reader, SJPEGComponent* component, int16_t* coefficients )
+{
+    const SJPEGHuffmanTable& DCTable = decoder->m_HuffmanTables[ 0 ][ component->m_DCTable ];
+    const SJPEGHuffmanTable& ACTable = decoder->m_HuffmanTables[ 1 ][ component->m_ACTable ];
+    const uint32_t spectralEnd = scan->m_SpectralEnd;
+    const int32_t bitValue = 1 << scan->m_ApproximationLow;
+
+    if ( scan->m_SpectralStart == 0 )
+    {
+        if ( scan->m_ApproximationHigh == 0 )
+        {
+            const int32_t bitCount = DecodeJPEGHuffmanSymbol( reader, DCTable );
+            if ( bitCount < 0 || bitCount > 16 )
+            {
+                return false;
+            }
+            component->m_DCPrediction += bitCount != 0 ? ExtendJPEGValue( reader->GetBits( bitCount ), bitCount ) : 0;
+            coefficients[ 0 ] = (int16_t)( component->m_DCPrediction * bitValue );
+        }
+        else if ( reader->GetBits( 1 ) )
+        {
+            coefficients[ 0 ] |= (int16_t)bitValue;
+        }
+
+        if ( decoder->m_IsProgressive )
+        {
+            return true;
+        }
+
+        // The rest of a sequential block
+        for ( uint32_t k = 1; k < 64; )
+        {
+            const int32_t symbol = DecodeJPEGHuffmanSymbol( reader, ACTable );
+            if ( symbol < 0 )
+            {
+                return false;
+            }
+            const uint32_t runLength = symbol >> 4;
+            const uint32_t bitCount = symbol & 15;
+            if ( bitCount == 0 )
+            {
+                if ( runLength != 15 )
+                {
+                    break;
+                }
+                k += 16;
+                continue;
+            }
+            k += runLength;
+            coefficients[ s_JPEGZigZagToNatural[ k ] ] = (int16_t)ExtendJPEGValue( reader->GetBits( bitCount ), bitCount );
+            ++k;
+        }
+        return true;
+    }
+
+    if ( scan->m_ApproximationHigh == 0 )
+    {
+        // First AC scan of a band, runs of empty blocks are coded as a single end of band
+        if ( scan->m_EOBRun > 0 )
+        {
+            --scan->m_EOBRun;
+            return true;
+        }
+        for ( uint32_t k = scan->m_SpectralStart; k <= spectralEnd; )
+        {
+            const int32_t symbol = DecodeJPEGHuffmanSymbol( reader, ACTable );
+            if ( symbol < 0 )
+            {
+                return false;
+            }
+            const uint32_t runLength = symbol >> 4;
+            const uint32_t bitCount = symbol & 15;
+            if ( bitCount == 0 )
+            {
+                if ( runLength < 15 )
+                {
+                    scan->m_EOBRun = ( 1u << runLength ) - 1;
+                    if ( runLength != 0 )
+                    {
+                        scan->m_EOBRun += reader->GetBits( runLength );
+                    }
+                    break;
+                }
+                k += 16;
+                continue;
+            }
+            k += runLength;
+            coefficients[ s_JPEGZigZagToNatural[ k ] ] = (int16_t)( ExtendJPEGValue( reader->GetBits( bitCount ), bitCount ) * bitValue );
+            ++k;
+        }
+        return true;
+    }
+
+    // AC refinement, nonzero coefficients receive a correction bit and zero ones are either skipped by the run or become +-1 at the current bit
+    uint32_t k = scan->m_SpectralStart;
+    if ( scan->m_EOBRun == 0 )
+    {
+        for ( ; k <= spectralEnd; ++k )
+        {
+            const int32_t symbol = DecodeJPEGHuffmanSymbol( reader, ACTable );
+            if ( symbol < 0 )
+            {
+                return false;
+            }
+            int32_t runLength = symbol >> 4;
+            int32_t newValue = 0;
+            if ( ( symbol & 15 ) != 0 )
+            {
+                newValue = reader->GetBits( 1 ) ? bitValue : -bitValue;
+            }
+            else if ( runLength != 15 )
+            {
+                scan->m_EOBRun = 1u << runLength;
+                if ( runLength != 0 )
+                {
+                    scan->m_EOBRun += reader->GetBits( runLength );
+                }
+                break;
+            }
+
+            for ( ; k <= spectralEnd; ++k )
+            {
+                int16_t& coefficient = coefficients[ s_JPEGZigZagToNatural[ k ] ];
+                if ( coefficient != 0 )
+                {
+                    if ( reader->GetBits( 1 ) && ( coefficient & bitValue ) == 0 )
+                    {
+                        coefficient += (int16_t)( coefficient >= 0 ? bitValue : -bitValue );
+                    }
+                }
+                else if ( --runLength < 0 )
+                {
+                    break;
+                }
+            }
+            if ( newValue != 0 )
+            {
+                coefficients[ s_JPEGZigZagToNatural[ k ] ] = (int16_t)newValue;
+            }
+        }
+    }
+
+    if ( scan->m_EOBRun > 0 )
+    {
+        for ( ; k <= spectralEnd; ++k )
+        {
+            int16_t& coefficient = coefficients[ s_JPEGZigZagToNatural[ k ] ];
+            if ( coefficient != 0 && reader->GetBits( 1 ) && ( coefficient & bitValue ) == 0 )
+            {
+                coefficient += (int16_t)( coefficient >= 0 ? bitValue : -bitValue );
+            }
+        }
+        --scan->m_EOBRun;
+    }
+    return true;
+}
+
+// Decodes the entropy coded data following the scan header and returns the position of the marker ending it
+static bool DecodeJPEGScan( SJPEGDecoder* decoder, SJPEGScan* scan, const uint8_t* data, size_t size, size_t* position )
+{
+    SJPEGBitReader reader;
+    reader.m_Data = data;
+    reader.m_Size = size;
+    reader.m_Position = *position;
+
+    for ( uint32_t iComponent = 0; iComponent < decoder->m_ComponentCount; ++iComponent )
+    {
+        decoder->m_Components[ iComponent ].m_DCPrediction = 0;
+    }
+    scan->m_EOBRun = 0;
+
+    // A single component scan is not interleaved, its MCU is one block and it only covers the blocks holding samples
+    const bool isInterleaved = scan->m_ComponentCount > 1;
+    const uint32_t MCUCountX = isInterleaved ? decoder->m_MCUCountX : scan->m_Components[ 0 ]->m_BlockCountX;
+    const uint32_t MCUCount = isInterleaved ? decoder->m_MCUCountX * decoder->m_MCUCountY : scan->m_Components[ 0 ]->m_BlockCountX * scan->m_Components[ 0 ]->m_BlockCountY;
+    for ( uint32_t iMCU = 0; iMCU < MCUCount; ++iMCU )
+    {
+        if ( decoder->m_RestartInterval != 0 && iMCU != 0 && iMCU % decoder->m_RestartInterval == 0 )
+        {
+            reader.Restart();
+            for ( uint32_t iComponent = 0; iComponent < decoder->m_ComponentCount; ++iComponent )
+            {
+                decoder->m_Components[ iComponent ].m_DCPrediction = 0;
+            }
+            scan->m_EOBRun = 0;
+        }
+
+        const uint32_t MCUX = iMCU % MCUCountX;
+        const uint32_t MCUY = iMCU / MCUCountX;
+        for ( uint32_t iComponent = 0; iComponent < scan->m_ComponentCount; ++iComponent )
+        {
+            SJPEGComponent* component = scan->m_Components[ iComponent ];
+            const uint32_t blockCountX = isInterleaved ? component->m_HorizontalSampling : 1;
+            const uint32_t blockCountY = isInterleaved ? component->m_VerticalSampling : 1;
+            for ( uint32_t blockY = 0; blockY < blockCountY; ++blockY )
+            {
+                for ( uint32_t blockX = 0; blockX < blockCountX; ++blockX )
+                {
+                    const size_t blockIndex = (size_t)( MCUY * blockCountY + blockY ) * component->m_BlockStride + MCUX * blockCountX + blockX;
+                    if ( !DecodeJPEGBlock( decoder, scan, &reader, component, component->m_Coefficients.data() + blockIndex * 64 ) )
+                    {
+                        LOG_STRING( "JPEG entropy coded data is corrupt.\n" );
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    // Skip to the next marker other than a restart marker, fill bytes included
+    size_t markerPosition = reader.m_Position;
+    while ( markerPosition + 1 < size )
+    {
+        const uint8_t marker = data[ markerPosition + 1 ];
+        if ( data[ markerPosition ] == 0xFF && marker != 0x00 && marker != 0xFF && ( marker < eJPEGMarker_RST0 || marker > eJPEGMarker_RST7 ) )
+        {
+            break;
+        }
+        ++markerPosition;
+    }
+    *position = markerPosition;
+    return true;
+}
+
+static bool ParseJPEGFrame( const uint8_t* segment, uint32_t segmentSize, SJPEGDecoder* decoder )
+{
+    if ( decoder->m_ComponentCount != 0 )
+    {
+        LOG_STRING( "JPEG with more than one frame is not supported.\n" );
+        return false;
+    }
+    if ( segmentSize < 6 )
+    {
+        LOG_STRING( "JPEG frame header is truncated.\n" );
+        return false;
+    }
+    if ( segment[ 0 ] != 8 )
+    {
+        LOG_STRING( "Only 8 bit JPEG is supported.\n" );
+        return false;
+    }
+
+    decoder->m_Height = ReadBigEndianUInt16( segment + 1 );
+    decoder->m_Width = ReadBigEndianUInt16( segment + 3 );
+    decoder->m_ComponentCount = segment[ 5 ];
+    if ( decoder->m_Width == 0 || decoder->m_Height == 0 || (uint64_t)decoder->m_Width * decoder->m_Height > MAX_DECODED_IMAGE_PIXEL_COUNT )
+    {
+        LOG_STRING( "JPEG image size is invalid or not supported.\n" );
+        return false;
+    }
+    if ( ( decoder->m_ComponentCount != 1 && decoder->m_ComponentCount != 3 && decoder->m_ComponentCount != 4 ) || segmentSize < 6 + decoder->m_ComponentCount * 3 )
+    {
+        LOG_STRING( "JPEG component count is not supported.\n" );
+        return false;
+    }
+
+    for ( uint32_t iComponent = 0; iComponent < decoder->m_ComponentCount; ++iComponent )
+    {
+        const uint8_t* componentData = segment + 6 + iComponent * 3;
+        SJPEGComponent& component = decoder->m_Components[ iComponent ];
+        component.m_Id = componentData[ 0 ];
+        component.m_HorizontalSampling = componentData[ 1 ] >> 4;
+        component.m_VerticalSampling = componentData[ 1 ] & 15;
+        component.m_QuantizationTable = componentData[ 2 ];
+        component.m_DCTable = 0;
+        component.m_ACTable = 0;
+        if ( component.m_HorizontalSampling < 1 || component.m_HorizontalSampling > 4 || component.m_VerticalSampling < 1 || component.m_VerticalSampling > 4 || component.m_QuantizationTable > 3 )
+        {
+            LOG_STRING( "JPEG component is invalid.\n" );
+            return false;
+        }
+        decoder->m_MaxHorizontalSampling = std::max( decoder->m_MaxHorizontalSampling, (uint32_t)component.m_HorizontalSampling );
+        decoder->m_MaxVerticalSampling = std::max( decoder->m_MaxVerticalSampling, (uint32_t)component.m_VerticalSampling );
+    }
+
+    decoder->m_MCUCountX = ( decoder->m_Width + decoder->m_MaxHorizontalSampling * 8 - 1 ) / ( decoder->m_MaxHorizontalSampling * 8 );
+    decoder->m_MCUCountY = ( decoder->m_Height + decoder->m_MaxVerticalSampling * 8 - 1 ) / ( decoder->m_MaxVerticalSampling * 8 );
+    for ( uint32_t iComponent = 0; iComponent < decoder->m_ComponentCount; ++iComponent )
+    {
+        SJPEGComponent& component = decoder->m_Components[ iComponent ];
+        component.m_Width = ( decoder->m_Width * component.m_HorizontalSampling + decoder->m_MaxHorizontalSampling - 1 ) / decoder->m_MaxHorizontalSampling;
+        component.m_Height = ( decoder->m_Height * component.m_VerticalSampling + decoder->m_MaxVerticalSampling - 1 ) / decoder->m_MaxVerticalSampling;
+        component.m_BlockCountX = ( component.m_Width + 7 ) / 8;
+        component.m_BlockCountY = ( component.m_Height + 7 ) / 8;
+        component.m_BlockStride = decoder->m_MCUCountX * component.m_HorizontalSampling;
+        component.m_Coefficients.assign( (size_t)component.m_BlockStride * decoder->m_MCUCountY * component.m_VerticalSampling * 64, 0 );
+    }
+    return true;
+}
+
+static bool ParseJPEGScanHeader( const uint8_t* segment, uint32_t segmentSize, SJPEGDecoder* decoder, SJPEGScan* scan )
+{
+    if ( decoder->m_ComponentCount == 0 )
+    {
+        LOG_STRING( "JPEG scan precedes the frame header.\n" );
+        return false;
+    }
+
+    scan->m_ComponentCount = segmentSize > 0 ? segment[ 0 ] : 0;
+    if ( scan->m_ComponentCount == 0 || scan->m_ComponentCount > decoder->m_ComponentCount || segmentSize < 4 + scan->m_ComponentCount * 2 )
+    {
+        LOG_STRING( "JPEG scan header is invalid.\n" );
+        return false;
+    }
+
+    for ( uint32_t iScanComponent = 0; iScanComponent < scan->m_ComponentCount; ++iScanComponent )
+    {
+        const uint8_t* componentData = segment + 1 + iScanComponent * 2;
+        SJPEGComponent* component = nullptr;
+        for ( uint32_t iComponent = 0; iComponent < decoder->m_ComponentCount && !component; ++iComponent )
+        {
+            component = decoder->m_Components[ iComponent ].m_Id == componentData[ 0 ] ? &decoder->m_Components[ iComponent ] : nullptr;
+        }
+        if ( !component || ( componentData[ 1 ] >> 4 ) > 3 || ( componentData[ 1 ] & 15 ) > 3 )
+        {
+            LOG_STRING( "JPEG scan component is invalid.\n" );
+            return false;
+        }
+        component->m_DCTable = componentData[ 1 ] >> 4;
+        component->m_ACTable = componentData[ 1 ] & 15;
+        scan->m_Components[ iScanComponent ] = component;
+    }
+
+    const uint8_t* spectralData = segment + 1 + scan->m_ComponentCount * 2;
+    scan->m_SpectralStart = spectralData[ 0 ];
+    scan->m_SpectralEnd = spectralData[ 1 ];
+    scan->m_ApproximationHigh = spectralData[ 2 ] >> 4;
+    scan->m_ApproximationLow = spectralData[ 2 ] & 15;
+    if ( decoder->m_IsProgressive )
+    {
+        // DC and AC coefficients go in separate scans, AC scans hold a single component
+        const bool isDCScan = scan->m_SpectralStart == 0;
+        if ( scan->m_SpectralEnd > 63 || scan->m_SpectralStart > scan->m_SpectralEnd || ( isDCScan && scan->m_SpectralEnd != 0 ) || ( !isDCScan && scan->m_ComponentCount != 1 )
+            || scan->m_ApproximationLow > 13 )
+        {
+            LOG_STRING( "JPEG progressive scan is invalid.\n" );
+            return false;
+        }
+    }
+    else
+    {
+        scan->m_SpectralStart = 0;
+        scan->m_SpectralEnd = 63;
+        scan->m_ApproximationHigh = 0;
+        scan->m_ApproximationLow = 0;
+    }
+
+    for ( uint32_t iScanComponent = 0; iScanComponent < scan->m_ComponentCount; ++iScanComponent )
+    {
+        const SJPEGComponent* component = scan->m_Components[ iScanComponent ];
+        const bool isDCTableUsed = scan->m_SpectralStart == 0 && scan->m_ApproximationHigh == 0;
+        const bool isACTableUsed = scan->m_SpectralEnd > 0;
+        if ( ( isDCTableUsed && !decoder->m_HuffmanTables[ 0 ][ component->m_DCTable ].m_IsDefined ) || ( isACTableUsed && !decoder->m_HuffmanTables[ 1 ][ component->m_ACTable ].m_IsDefined ) )
+        {
+            LOG_STRING( "JPEG scan references an undefined Huffman table.\n" );
+            return false;
+        }
+    }
+    return true;
+}
+
+// Dequantizes the coefficients of a block and writes its samples with a separable inverse DCT
+static void InverseJPEGDCT( const int16_t* coefficients, const uint16_t* quantizationTable, uint8_t* destination, uint32_t destinationStride )
+{
+    const float ( *basis )[ 8 ] = s_JPEGIDCTBasis.m_Values;
+    float rows[ 64 ];
+    for ( uint32_t v = 0; v < 8; ++v )
+    {
+        float frequencies[ 8 ];
+        bool isZero = true;
+        for ( uint32_t u = 0; u < 8; ++u )
+        {
+            frequencies[ u ] = (float)coefficients[ v * 8 + u ] * quantizationTable[ v * 8 + u ];
+            isZero &= frequencies[ u ] == 0.f;
+        }
+        for ( uint32_t x = 0; x < 8; ++x )
+        {
+            float value = 0.f;
+            for ( uint32_t u = 0; u < 8 && !isZero; ++u )
+            {
+                value += basis[ x ][ u ] * frequencies[ u ];
+            }
+            rows[ v * 8 + x ] = value;
+        }
+    }
+    for ( uint32_t y = 0; y < 8; ++y )
+    {
+        for ( uint32_t x = 0; x < 8; ++x )
+        {
+            float value = 128.f;
+            for ( uint32_t v = 0; v < 8; ++v )
+            {
+                value += basis[ y ][ v ] * rows[ v * 8 + x ];
+            }
+            destination[ y * destinationStride + x ] = (uint8_t)std::min( std::max( value + 0.5f, 0.f ), 255.f );
+        }
+    }
+}
+
+// Upsamples a subsampled component to the image size with a triangle filter centered on the samples, the same as the fancy upsampling of libjpeg
+static void UpsampleJPEGComponent( const SJPEGComponent& component, uint32_t width, uint32_t height, uint32_t maxHorizontalSampling, uint32_t maxVerticalSampling, std::vector<uint8_t>* samples )
+{
+    struct STap
+    {
+        uint32_t m_Index0;
+        uint32_t m_Index1;
+        float m_Weight1;
+    };
+    auto calculateTaps = []( uint32_t size, uint32_t sourceSize, float scale, std::vector<STap>* taps )
+    {
+        taps->resize( size );
+        for ( uint32_t i = 0; i < size; ++i )
+        {
+            const float position = std::min( std::max( ( i + .5f ) * scale - .5f, 0.f ), (float)( sourceSize - 1 ) );
+            STap& tap = ( *taps )[ i ];
+            tap.m_Index0 = (uint32_t)position;
+            tap.m_Index1 = std::min( tap.m_Index0 + 1, sourceSize - 1 );
+            tap.m_Weight1 = position - tap.m_Index0;
+        }
+    };
+
+    std::vector<STap> horizontalTaps;
+    std::vector<STap> verticalTaps;
+    calculateTaps( width, component.m_Width, (float)component.m_HorizontalSampling / maxHorizontalSampling, &horizontalTaps );
+    calculateTaps( height, component.m_Height, (float)component.m_VerticalSampling / maxVerticalSampling, &verticalTaps );
+
+    const uint32_t sourceStride = component.m_BlockCountX * 8;
+    samples->resize( (size_t)width * height );
+    for ( uint32_t y = 0; y < height; ++y )
+    {
+        const STap& verticalTap = verticalTaps[ y ];
+        const uint8_t* sourceRow0 = component.m_Samples.data() + (size_t)verticalTap.m_Index0 * sourceStride;
+        const uint8_t* sourceRow1 = component.m_Samples.data() + (size_t)verticalTap.m_Index1 * sourceStride;
+        uint8_t* destinationRow = samples->data() + (size_t)y * width;
+        for ( uint32_t x = 0; x < width; ++x )
+        {
+            const STap& horizontalTap = horizontalTaps[ x ];
+            const float value0 = sourceRow0[ horizontalTap.m_Index0 ] + ( sourceRow0[ horizontalTap.m_Index1 ] - sourceRow0[ horizontalTap.m_Index0 ] ) * horizontalTap.m_Weight1;
+            const float value1 = sourceRow1[ horizontalTap.m_Index0 ] + ( sourceRow1[ horizontalTap.m_Index1 ] - sourceRow1[ horizontalTap.m_Index0 ] ) * horizontalTap.m_Weight1;
+            destinationRow[ x ] = (uint8_t)( value0 + ( value1 - value0 ) * verticalTap.m_Weight1 + .5f );
+        }
+    }
+}
+
+static void ConvertYCbCrToRGB( uint8_t y, uint8_t cb, uint8_t cr, uint8_t* destination )
+{
+    const float chromaBlue = cb - 128.f;
+    const float chromaRed = cr - 128.f;
+    destination[ 0 ] = (uint8_t)std::min( std::max( y + 1.402f * chromaRed + .5f, 0.f ), 255.f );
+    destination[ 1 ] = (uint8_t)std::min( std::max( y - 0.344136f * chromaBlue - 0.714136f * chromaRed + .5f, 0.f ), 255.f );
+    destination[ 2 ] = (uint8_t)std::min( std::max( y + 1.772f * chromaBlue + .5f, 0.f ), 255.f );
+}
+
+bool IsJPEGData( const uint8_t* data, size_t size )
+{
+    return size >= 3 && data[ 0 ] == 0xFF && data[ 1 ] == eJPEGMarker_SOI && data[ 2 ] == 0xFF;
+}
+
+bool DecodeJPEG( const uint8_t* data, size_t size, CTexture* texture )
+{
+    if ( !IsJPEGData( data, size ) )
+    {
+        return false;
+    }
+
+    std::unique_ptr<SJPEGDecoder> decoder = std::make_unique<SJPEGDecoder>();
+    uint32_t scanCount = 0;
+    size_t position = 2;
+    while ( position + 1 < size )
+    {
+        // Markers may be preceded by any number of fill bytes
+        if ( data[ position ] != 0xFF || data[ position + 1 ] == 0xFF )
+        {
+            ++position;
+            continue;
+        }
+
+        const uint8_t marker = data[ position + 1 ];
+        position += 2;
+        if ( marker == eJPEGMarker_EOI )
+        {
+            break;
+        }
+        if ( marker == eJPEGMarker_SOI || marker == eJPEGMarker_TEM || ( marker >= eJPEGMarker_RST0 && marker <= eJPEGMarker_RST7 ) )
+        {
+            continue;
+        }
+
+        const uint32_t segmentSize = position + 2 <= size ? ReadBigEndianUInt16( data + position ) : 0;
+        if ( segmentSize < 2 || segmentSize > size - position )
+        {
+            LOG_STRING( "JPEG segment exceeds the end of file.\n" );
+            return false;
+        }
+        const uint8_t* segment = data + position + 2;
+        const uint32_t segmentDataSize = segmentSize - 2;
+        position += segmentSize;
+
+        switch ( marker )
+        {
+        case eJPEGMarker_DQT:
+        {
+            for ( uint32_t offset = 0; offset < segmentDataSize; )
+            {
+                const uint32_t precision = segment[ offset ] >> 4;
+                const uint32_t tableIndex = segment[ offset ] & 15;
+                const uint32_t tableSize = precision != 0 ? 128 : 64;
+                if ( tableIndex > 3 || precision > 1 || offset + 1 + tableSize > segmentDataSize )
+                {
+                    LOG_STRING( "JPEG quantization table is invalid.\n" );
+                    return false;
+                }
+                const uint8_t* values = segment + offset + 1;
+                for ( uint32_t i = 0; i < 64; ++i )
+                {
+                    decoder->m_QuantizationTables[ tableIndex ][ s_JPEGZigZagToNatural[ i ] ] = precision != 0 ? ReadBigEndianUInt16( values + i * 2 ) : values[ i ];
+                }
+                offset += 1 + tableSize;
+            }
+            break;
+        }
+        case eJPEGMarker_DHT:
+        {
+            for ( uint32_t offset = 0; offset < segmentDataSize; )
+            {
+                const uint32_t tableClass = segment[ offset ] >> 4;
+                const uint32_t tableIndex = segment[ offset ] & 15;
+                uint32_t valueCount = 0;
+                for ( uint32_t length = 0; length < 16 && offset + 1 + length < segmentDataSize; ++length )
+                {
+                    valueCount += segment[ offset + 1 + length ];
+                }
+                if ( tableClass > 1 || tableIndex > 3 || valueCount > 256 || offset + 17 + valueCount > segmentDataSize
+                    || !BuildJPEGHuffmanTable( segment + offset + 1, segment + offset + 17, &decoder->m_HuffmanTables[ tableClass ][ tableIndex ] ) )
+                {
+                    LOG_STRING( "JPEG Huffman table is invalid.\n" );
+                    return false;
+                }
+                offset += 17 + valueCount;
+            }
+            break;
+        }
+        case eJPEGMarker_SOF0:
+        case eJPEGMarker_SOF1:
+        case eJPEGMarker_SOF2:
+        {
+            decoder->m_IsProgressive = marker == eJPEGMarker_SOF2;
+            if ( !ParseJPEGFrame( segment, segmentDataSize, decoder.get() ) )
+            {
+                return false;
+            }
+            break;
+        }
+        case eJPEGMarker_DRI:
+        {
+            if ( segmentDataSize < 2 )
+            {
+                return false;
+            }
+            decoder->m_RestartInterval = ReadBigEndianUInt16( segment );
+            break;
+        }
+        case eJPEGMarker_SOS:
+        {
+            SJPEGScan scan;
+            if ( !ParseJPEGScanHeader( segment, segmentDataSize, decoder.get(), &scan ) || !DecodeJPEGScan( decoder.get(), &scan, data, size, &position ) )
+            {
+                return false;
+            }
+            ++scanCount;
+            break;
+        }
+        case eJPEGMarker_APP14:
+        {
+            if ( segmentDataSize >= 12 && memcmp( segment, "Adobe", 5 ) == 0 )
+            {
+                decoder->m_AdobeTransform = segment[ 11 ];
+            }
+            break;
+        }
+        default:
+        {
+            // Lossless, hierarchical and arithmetic coded frames
+            if ( marker >= 0xC3 && marker <= 0xCF && marker != eJPEGMarker_DHT && marker != 0xC8 && marker != 0xCC )
+            {
+                LOG_STRING( "JPEG coding process is not supported.\n" );
+                return false;
+            }
+            break;
+        }
+        }
+    }
+
+    if ( decoder->m_ComponentCount == 0 || scanCount == 0 )
+    {
+        LOG_STRING( "JPEG image data is missing.\n" );
+        return false;
+    }
+
+    for ( uint32_t iComponent = 0; iComponent < decoder->m_ComponentCount; ++iComponent )
+    {
+        SJPEGComponent& component = decoder->m_Components[ iComponent ];
+        const uint16_t* quantizationTable = decoder->m_QuantizationTables[ component.m_QuantizationTable ];
+        const uint32_t sampleStride = component.m_BlockCountX * 8;
+        component.m_Samples.resize( (size_t)sampleStride * component.m_BlockCountY * 8 );
+        for ( uint32_t blockY = 0; blockY < component.m_BlockCountY; ++blockY )
+        {
+            for ( uint32_t blockX = 0; blockX < component.m_BlockCountX; ++blockX )
+            {
+                InverseJPEGDCT( component.m_Coefficients.data() + ( (size_t)blockY * component.m_BlockStride + blockX ) * 64, quantizationTable,
+                    component.m_Samples.data() + (size_t)blockY * 8 * sampleStride + blockX * 8, sampleStride );
+            }
+        }
+        std::vector<int16_t>().swap( component.m_Coefficients );
+    }
+
+    // Components at the image size are read in place, subsampled ones are upsampled first
+    const uint8_t* componentSamples[ JPEG_MAX_COMPONENT_COUNT ];
+    uint32_t componentStrides[ JPEG_MAX_COMPONENT_COUNT ];
+    std::vector<uint8_t> upsampledSamples[ JPEG_MAX_COMPONENT_COUNT ];
+    for ( uint32_t iComponent = 0; iComponent < decoder->m_ComponentCount; ++iComponent )
+    {
+        const SJPEGComponent& component = decoder->m_Components[ iComponent ];
+        if ( component.m_HorizontalSampling == decoder->m_MaxHorizontalSampling && component.m_VerticalSampling == decoder->m_MaxVerticalSampling )
+        {
+            componentSamples[ iComponent ] = component.m_Samples.data();
+            componentStrides[ iComponent ] = component.m_BlockCountX * 8;
+        }
+        else
+        {
+            UpsampleJPEGComponent( component, decoder->m_Width, decoder->m_Height, decoder->m_MaxHorizontalSampling, decoder->m_MaxVerticalSampling, &upsampledSamples[ iComponent ] );
+            componentSamples[ iComponent ] = upsampledSamples[ iComponent ].data();
+            componentStrides[ iComponent ] = decoder->m_Width;
+        }
+    }
+
+    // Three components are YCbCr unless an Adobe segment or the component ids say RGB, four components are Adobe (inverted) CMYK or YCCK
+    const SJPEGComponent* components = decoder->m_Components;
+    const bool isRGB = decoder->m_ComponentCount == 3
+        && ( decoder->m_AdobeTransform == 0 || ( components[ 0 ].m_Id == 'R' && components[ 1 ].m_Id == 'G' && components[ 2 ].m_Id == 'B' ) );
+    const bool isYCCK = decoder->m_ComponentCount == 4 && decoder->m_AdobeTransform == 2;
+    AllocateRGBA8Texture( decoder->m_Width, decoder->m_Height, texture );
+    for ( uint32_t y = 0; y < decoder->m_Height; ++y )
+    {
+        const uint8_t* sourceRows[ JPEG_MAX_COMPONENT_COUNT ];
+        for ( uint32_t iComponent = 0; iComponent < decoder->m_ComponentCount; ++iComponent )
+        {
+            sourceRows[ iComponent ] = componentSamples[ iComponent ] + (size_t)y * componentStrides[ iComponent ];
+        }
+        uint8_t* destination = texture->m_PixelData.data() + (size_t)y * decoder->m_Width * 4;
+        for ( uint32_t x = 0; x < decoder->m_Width; ++x, destination += 4 )
+        {
+            if ( decoder->m_ComponentCount == 1 )
+            {
+                destination[ 0 ] = destination[ 1 ] = destination[ 2 ] = sourceRows[ 0 ][ x ];
+            }
+            else if ( isRGB )
+            {
+                destination[ 0 ] = sourceRows[ 0 ][ x ];
+                destination[ 1 ] = sourceRows[ 1 ][ x ];
+                destination[ 2 ] = sourceRows[ 2 ][ x ];
+            }
+            else
+            {
+                ConvertYCbCrToRGB( sourceRows[ 0 ][ x ], sourceRows[ 1 ][ x ], sourceRows[ 2 ][ x ], destination );
+                if ( decoder->m_ComponentCount == 4 )
+                {
+                    const uint32_t black = sourceRows[ 3 ][ x ];
+                    for ( uint32_t iChannel = 0; iChannel < 3; ++iChannel )
+                    {
+                        const uint32_t ink = isYCCK ? 255 - destination[ iChannel ] : sourceRows[ iChannel ][ x ];
+                        destination[ iChannel ] = (uint8_t)( ( ink * black + 127 ) / 255 );
+                    }
+                }
+            }
+            destination[ 3 ] = 255;
+        }
+    }
+
+    return true;
+}
+
+
+//
+// Radiance HDR
+//
+
+#define HDR_MAX_LINE_LENGTH     256
+
+// Reads a header line without the line break, returns false at the end of file or on an overlong line
+static bool ReadHDRLine( const uint8_t* data, size_t size, size_t* position, std::string* line )
+{
+    line->clear();
+    while ( *position < size && line->size() < HDR_MAX_LINE_LENGTH )
+    {
+        const char c = (char)data[ ( *position )++ ];
+        if ( c == '\n' )
+        {
+            if ( !line->empty() && line->back() == '\r' )
+            {
+                line->pop_back();
+            }
+            return true;
+        }
+        line->push_back( c );
+    }
+    return false;
+}
+
+bool IsHDRData( const uint8_t* data, size_t size )
+{
+    return ( size >= 10 && memcmp( data, "#?RADIANCE", 10 ) == 0 ) || ( size >= 6 && memcmp( data, "#?RGBE", 6 ) == 0 );
+}
+
+bool DecodeHDR( const uint8_t* data, size_t size, CTexture* texture )
+{
+    if ( !IsHDRData( data, size ) )
+    {
+        return false;
+    }
+
+    // Header lines end at an empty line, only RGBE pixels are supported
+    size_t position = 0;
+    std::string line;
+    do
+    {
+        if ( !ReadHDRLine( data, size, &position, &line ) )
+        {
+            LOG_STRING( "HDR header is truncated.\n" );
+            return false;
+        }
+        if ( line.compare( 0, 7, "FORMAT=" ) == 0 && line != "FORMAT=32-bit_rle_rgbe" )
+        {
+            LOG_STRING( "HDR pixel format is not supported.\n" );
+            return false;
+        }
+    }
+    while ( !line.empty() );
+
+    // Resolution string, rows from top to bottom ( -Y ) or bottom to top ( +Y ) with columns from left to right
+    if ( !ReadHDRLine( data, size, &position, &line ) || line.size() < 3 || ( line.compare( 0, 3, "-Y " ) != 0 && line.compare( 0, 3, "+Y " ) != 0 ) )
+    {
+        LOG_STRING( "HDR image orientation is not supported.\n" );
+        return false;
+    }
+    const bool isBottomToTop = line[ 0 ] == '+';
+    char* end = nullptr;
+    const unsigned long height = strtoul( line.c_str() + 3, &end, 10 );
+    if ( end == nullptr || strncmp( end, " +X ", 4 ) != 0 )
+    {
+        LOG_STRING( "HDR image orientation is not supported.\n" );
+        return false;
+    }
+    const unsigned long width = strtoul( end + 4, &end, 10 );
+    if ( width == 0 || height == 0 || width > 0xFFFFFFFF || height > 0xFFFFFFFF || (uint64_t)width * height > MAX_DECODED_IMAGE_PIXEL_COUNT / 4 )
+    {
+        LOG_STRING( "HDR image size is invalid or not supported.\n" );
+        return false;
+    }
+
+    AllocateTexture( (uint32_t)width, (uint32_t)height, ETexturePixelFormat::R32G32B32A32_Float, texture );
+    std::vector<uint8_t> scanline( (size_t)width * 4 );
+    for ( uint32_t iRow = 0; iRow < height; ++iRow )
+    {
+        // Scanlines of 8 to 32767 pixels are usually run length encoded per channel, they start with 2, 2 and the width
+        const bool isRLE = width >= 8 && width < 0x8000 && position + 4 <= size && data[ position ] == 2 && data[ position + 1 ] == 2
+            && ( ( data[ position + 2 ] << 8 ) | data[ position + 3 ] ) == (int)width;
+        if ( isRLE )
+        {
+            position += 4;
+            for ( uint32_t iChannel = 0; iChannel < 4; ++iChannel )
+            {
+                for ( uint32_t x = 0; x < width; )
+                {
+                    uint32_t count = position < size ? data[ position++ ] : 0;
+                    const bool isRun = count > 128;
+                    count = isRun ? count - 128 : count;
+                    if ( count == 0 || x + count > width || position + ( isRun ? 1 : count ) > size )
+                    {
+                        LOG_STRING( "HDR image data is corrupt or truncated.\n" );
+                        return false;
+                    }
+                    for ( uint32_t i = 0; i < count; ++i, ++x )
+                    {
+                        scanline[ x * 4 + iChannel ] = data[ isRun ? position : position + i ];
+                    }
+                    position += isRun ? 1 : count;
+                }
+            }
+        }
+        else
+        {
+            if ( position + scanline.size() > size )
+            {
+                LOG_STRING( "HDR image data is truncated.\n" );
+                return false;
+            }
+            memcpy( scanline.data(), data + position, scanline.size() );
+            position += scanline.size();
+        }
+
+        float* destination = (float*)( texture->m_PixelData.data() ) + (size_t)( isBottomToTop ? height - 1 - iRow : iRow ) * width * 4;
+        for ( uint32_t x = 0; x < width; ++x, destination += 4 )
+        {
+            const uint8_t* rgbe = scanline.data() + x * 4;
+            const float scale = rgbe[ 3 ] != 0 ? ldexpf( 1.f, (int)rgbe[ 3 ] - ( 128 + 8 ) ) : 0.f;
+            destination[ 0 ] = rgbe[ 0 ] * scale;
+            destination[ 1 ] = rgbe[ 1 ] * scale;
+            destination[ 2 ] = rgbe[ 2 ] * scale;
+            destination[ 3 ] = 1.f;
+        }
+    }
+
+    return true;
+}
\ No newline at end of file
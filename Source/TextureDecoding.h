@@ -0,0 +1,25 @@
+#pragma once
+
+class CTexture;
+
+// Portable image decoders, they only depend on the C++ standard library and write straight into the texture's pixel data.
+// Images are decoded to R8G8B8A8_sRGB, grayscale images are replicated into the color channels. Radiance HDR images are decoded to R32G32B32A32_Float.
+
+bool IsPNGData( const uint8_t* data, size_t size );
+
+bool IsTGAData( const uint8_t* data, size_t size );
+
+bool IsJPEGData( const uint8_t* data, size_t size );
+
+bool IsHDRData( const uint8_t* data, size_t size );
+
+bool DecodePNG( const uint8_t* data, size_t size, CTexture* texture );
+
+bool DecodeTGA( const uint8_t* data, size_t size, CTexture* texture );
+
+
+// Baseline, extended sequential and progressive Huffman coded JPEG with 1, 3 or 4 components. Subsampled components are upsampled with a triangle filter.
+bool DecodeJPEG( const uint8_t* data, size_t size, CTexture* texture );
+
+// Run length encoded or flat RGBE pixels
+bool DecodeHDR( const uint8_t* data, size_t size, CTexture* texture );
\ No newline at end of file
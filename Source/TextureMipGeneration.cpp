@@ -0,0 +1,308 @@
+#include "stdafx.h"
+#include "TextureMipGeneration.h"
+#include "ParallelFor.h"
+#include "Logging.h"
+
+using namespace DirectX;
+
+#define LINEAR_TO_SRGB_TABLE_SIZE       16384
+#define MIP_GENERATION_ROWS_PER_TASK    16
+
+struct SSRGBConversionTables
+{
+    SSRGBConversionTables()
+    {
+        for ( uint32_t i = 0; i < 256; ++i )
+        {
+            const float value = i / 255.f;
+            m_SRGBToLinear[ i ] = value <= 0.04045f ? value / 12.92f : powf( ( value + 0.055f ) / 1.055f, 2.4f );
+        }
+        for ( uint32_t i = 0; i < LINEAR_TO_SRGB_TABLE_SIZE; ++i )
+        {
+            const float value = i / (float)( LINEAR_TO_SRGB_TABLE_SIZE - 1 );
+            const float sRGBValue = value <= 0.0031308f ? value * 12.92f : 1.055f * powf( value, 1.f / 2.4f ) - 0.055f;
+            m_LinearToSRGB[ i ] = (uint8_t)std::min( sRGBValue * 255.f + 0.5f, 255.f );
+        }
+    }
+
+    float m_SRGBToLinear[ 256 ];
+    uint8_t m_LinearToSRGB[ LINEAR_TO_SRGB_TABLE_SIZE ];
+};
+
+static const SSRGBConversionTables s_SRGBConversionTables;
+
+// Source texels covered by one destination texel along an axis, at most 3 when the source size is odd
+struct SDownsampleFootprint
+{
+    uint32_t m_Begin;
+    uint32_t m_Count;
+    float m_Weights[ 3 ];
+};
+
+static void CalculateDownsampleFootprints( uint32_t sourceSize, uint32_t destinationSize, std::vector<SDownsampleFootprint>* footprints )
+{
+    footprints->resize( destinationSize );
+    const double ratio = (double)sourceSize / destinationSize;
+    for ( uint32_t i = 0; i < destinationSize; ++i )
+    {
+        const double begin = i * ratio;
+        const double end = ( i + 1 ) * ratio;
+        SDownsampleFootprint& footprint = ( *footprints )[ i ];
+        footprint.m_Begin = (uint32_t)begin;
+        footprint.m_Count = 0;
+        for ( uint32_t sourceIndex = footprint.m_Begin; sourceIndex < end && footprint.m_Count < 3; ++sourceIndex )
+        {
+            const double coverage = std::min( end, sourceIndex + 1.0 ) - std::max( begin, (double)sourceIndex );
+            footprint.m_Weights[ footprint.m_Count++ ] = (float)( coverage / ratio );
+        }
+    }
+}
+
+static XMVECTOR LoadLinearTexel( const uint8_t* texel, ETexturePixelFormat format )
+{
+    if ( format == ETexturePixelFormat::R32G32B32A32_Float )
+    {
+        return XMLoadFloat4( (const XMFLOAT4*)texel );
+    }
+    else if ( format == ETexturePixelFormat::R8G8B8A8_sRGB )
+    {
+        const float* table = s_SRGBConversionTables.m_SRGBToLinear;
+        return XMVectorSet( table[ texel[ 0 ] ], table[ texel[ 1 ] ], table[ texel[ 2 ] ], texel[ 3 ] / 255.f );
+    }
+    return XMVectorSet( texel[ 0 ] / 255.f, 0.f, 0.f, 0.f );
+}
+
+static void StoreLinearTexel( FXMVECTOR value, ETexturePixelFormat format, uint8_t* texel )
+{
+    if ( format == ETexturePixelFormat::R32G32B32A32_Float )
+    {
+        XMStoreFloat4( (XMFLOAT4*)texel, value );
+        return;
+    }
+
+    XMFLOAT4 linearValue;
+    XMStoreFloat4( &linearValue, XMVectorSaturate( value ) );
+    if ( format == ETexturePixelFormat::R8G8B8A8_sRGB )
+    {
+        const uint8_t* table = s_SRGBConversionTables.m_LinearToSRGB;
+        texel[ 0 ] = table[ (uint32_t)( linearValue.x * ( LINEAR_TO_SRGB_TABLE_SIZE - 1 ) + 0.5f ) ];
+        texel[ 1 ] = table[ (uint32_t)( linearValue.y * ( LINEAR_TO_SRGB_TABLE_SIZE - 1 ) + 0.5f ) ];
+        texel[ 2 ] = table[ (uint32_t)( linearValue.z * ( LINEAR_TO_SRGB_TABLE_SIZE - 1 ) + 0.5f ) ];
+        texel[ 3 ] = (uint8_t)( linearValue.w * 255.f + 0.5f );
+    }
+    else
+    {
+        texel[ 0 ] = (uint8_t)( linearValue.x * 255.f + 0.5f );
+    }
+}
+
+uint32_t CalculateMipLevelCount( uint32_t width, uint32_t height )
+{
+    uint32_t mipLevelCount = 1;
+    uint32_t size = std::max( width, height );
+    while ( size > 1 )
+    {
+        size >>= 1;
+        ++mipLevelCount;
+    }
+    return mipLevelCount;
+}
+
+void DownsampleTextureMip( const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, ETexturePixelFormat format, uint8_t* destination, uint32_t maxWorkerCount )
+{
+    const uint32_t destinationWidth = std::max( sourceWidth / 2, 1u );
+    const uint32_t destinationHeight = std::max( sourceHeight / 2, 1u );
+    const uint32_t BPP = GetTexturePixelFormatBPP( format );
+
+    std::vector<SDownsampleFootprint> horizontalFootprints;
+    std::vector<SDownsampleFootprint> verticalFootprints;
+    CalculateDownsampleFootprints( sourceWidth, destinationWidth, &horizontalFootprints );
+    CalculateDownsampleFootprints( sourceHeight, destinationHeight, &verticalFootprints );
+
+    const uint32_t taskCount = ( destinationHeight + MIP_GENERATION_ROWS_PER_TASK - 1 ) / MIP_GENERATION_ROWS_PER_TASK;
+    ParallelFor( taskCount, [&]( uint32_t, uint32_t taskIndex )
+    {
+        const uint32_t rowBegin = taskIndex * MIP_GENERATION_ROWS_PER_TASK;
+        const uint32_t rowEnd = std::min( rowBegin + MIP_GENERATION_ROWS_PER_TASK, destinationHeight );
+        for ( uint32_t y = rowBegin; y < rowEnd; ++y )
+        {
+            const SDownsampleFootprint& verticalFootprint = verticalFootprints[ y ];
+            uint8_t* destinationTexel = destination + (size_t)y * destinationWidth * BPP;
+            for ( uint32_t x = 0; x < destinationWidth; ++x, destinationTexel += BPP )
+            {
+                const SDownsampleFootprint& horizontalFootprint = horizontalFootprints[ x ];
+                XMVECTOR sum = XMVectorZero();
+                for ( uint32_t iRow = 0; iRow < verticalFootprint.m_Count; ++iRow )
+                {
+                    const uint8_t* sourceRow = source + (size_t)( verticalFootprint.m_Begin + iRow ) * sourceWidth * BPP;
+                    XMVECTOR rowSum = XMVectorZero();
+                    for ( uint32_t iColumn = 0; iColumn < horizontalFootprint.m_Count; ++iColumn )
+                    {
+                        const XMVECTOR texel = LoadLinearTexel( sourceRow + ( horizontalFootprint.m_Begin + iColumn ) * BPP, format );
+                        rowSum = XMVectorMultiplyAdd( texel, XMVectorReplicate( horizontalFootprint.m_Weights[ iColumn ] ), rowSum );
+                    }
+                    sum = XMVectorMultiplyAdd( rowSum, XMVectorReplicate( verticalFootprint.m_Weights[ iRow ] ), sum );
+                }
+                StoreLinearTexel( sum, format, destinationTexel );
+            }
+        }
+    }, maxWorkerCount );
+}
+
+void GenerateTextureMipChain( CTexture* texture, uint32_t maxWorkerCount )
+{
+    if ( !texture->IsValid() || texture->m_MipLevelCount != 1 || IsBlockCompressedTexturePixelFormat( texture->m_PixelFormat ) )
+    {
+        return;
+    }
+
+    const uint32_t mipLevelCount = CalculateMipLevelCount( texture->m_Width, texture->m_Height );
+    texture->m_MipLevelCount = mipLevelCount;
+    texture->m_PixelData.resize( texture->GetMipOffset( mipLevelCount ) );
+    for ( uint32_t mipLevel = 1; mipLevel < mipLevelCount; ++mipLevel )
+    {
+        DownsampleTextureMip( texture->m_PixelData.data() + texture->GetMipOffset( mipLevel - 1 ), texture->GetMipWidth( mipLevel - 1 ), texture->GetMipHeight( mipLevel - 1 ),
+            texture->m_PixelFormat, texture->m_PixelData.data() + texture->GetMipOffset( mipLevel ), maxWorkerCount );
+    }
+}
+
+
+static float SRGBToLinear( float value )
+{
+    return value <= 0.04045f ? value / 12.92f : powf( ( value + 0.055f ) / 1.055f, 2.4f );
+}
+
+// Mean of the texels of a level, color is averaged in linear space and the last channel is the opacity
+static XMFLOAT4 CalculateMipMean( const CTexture& texture, uint32_t mipLevel )
+{
+    const uint32_t BPP = GetTexturePixelFormatBPP( texture.m_PixelFormat );
+    const uint32_t texelCount = texture.GetMipWidth( mipLevel ) * texture.GetMipHeight( mipLevel );
+    const uint8_t* texel = texture.m_PixelData.data() + texture.GetMipOffset( mipLevel );
+    double sum[ 4 ] = { 0.0, 0.0, 0.0, 0.0 };
+    for ( uint32_t i = 0; i < texelCount; ++i, texel += BPP )
+    {
+        if ( texture.m_PixelFormat == ETexturePixelFormat::R32G32B32A32_Float )
+        {
+            const float* values = (const float*)texel;
+            sum[ 0 ] += values[ 0 ];
+            sum[ 1 ] += values[ 1 ];
+            sum[ 2 ] += values[ 2 ];
+            sum[ 3 ] += values[ 3 ];
+        }
+        else if ( texture.m_PixelFormat == ETexturePixelFormat::R8G8B8A8_sRGB )
+        {
+            sum[ 0 ] += SRGBToLinear( texel[ 0 ] / 255.f );
+            sum[ 1 ] += SRGBToLinear( texel[ 1 ] / 255.f );
+            sum[ 2 ] += SRGBToLinear( texel[ 2 ] / 255.f );
+            sum[ 3 ] += texel[ 3 ] / 255.f;
+        }
+        else
+        {
+            sum[ 3 ] += texel[ 0 ] / 255.f;
+        }
+    }
+    return XMFLOAT4( (float)( sum[ 0 ] / texelCount ), (float)( sum[ 1 ] / texelCount ), (float)( sum[ 2 ] / texelCount ), (float)( sum[ 3 ] / texelCount ) );
+}
+
+static bool ValidateMipChain( uint32_t width, uint32_t height, ETexturePixelFormat format, std::mt19937& rng )
+{
+    CTexture texture;
+    texture.m_PixelFormat = format;
+    texture.m_Width = width;
+    texture.m_Height = height;
+    texture.m_MipLevelCount = 1;
+    texture.m_PixelData.resize( (size_t)width * height * GetTexturePixelFormatBPP( format ) );
+    const bool isFloat = format == ETexturePixelFormat::R32G32B32A32_Float;
+    if ( isFloat )
+    {
+        // HDR colors well above 1 must not be clamped
+        std::uniform_real_distribution<float> distribution( 0.f, 16.f );
+        float* values = (float*)texture.m_PixelData.data();
+        for ( size_t i = 0; i < texture.m_PixelData.size() / sizeof( float ); ++i )
+        {
+            const float value = distribution( rng );
+            values[ i ] = i % 4 == 3 ? value / 16.f : value;
+        }
+    }
+    else
+    {
+        std::uniform_int_distribution<uint32_t> distribution( 0, 255 );
+        for ( uint8_t& value : texture.m_PixelData )
+        {
+            value = (uint8_t)distribution( rng );
+        }
+    }
+
+    GenerateTextureMipChain( &texture, 1 );
+
+    const char* formatName = isFloat ? "R32G32B32A32_Float" : ( format == ETexturePixelFormat::R8G8B8A8_sRGB ? "R8G8B8A8_sRGB" : "R8_Unorm" );
+    const uint32_t expectedMipLevelCount = (uint32_t)floorf( log2f( (float)std::max( width, height ) ) ) + 1;
+    if ( texture.m_MipLevelCount != expectedMipLevelCount || texture.GetMipWidth( texture.m_MipLevelCount - 1 ) != 1 || texture.GetMipHeight( texture.m_MipLevelCount - 1 ) != 1
+        || texture.m_PixelData.size() != texture.GetMipOffset( texture.m_MipLevelCount ) )
+    {
+        LOG_STRING_FORMAT( "%ux%u %s: %u mips generated, expected %u ending at 1x1, FAILED\n", width, height, formatName, texture.m_MipLevelCount, expectedMipLevelCount );
+        return false;
+    }
+
+    // The box filter preserves the mean of the level, so each level may only deviate from the previous one by the quantization of its texels.
+    // A half step of 8 bit sRGB is at most 0.0045 in linear space.
+    const float colorTolerance = isFloat ? 1e-4f : 0.005f;
+    const float opacityTolerance = isFloat ? 1e-4f : 0.5f / 255.f + 1e-5f;
+    const XMFLOAT4 topMean = CalculateMipMean( texture, 0 );
+    XMFLOAT4 previousMean = topMean;
+    float maxColorError = 0.f;
+    float maxOpacityError = 0.f;
+    bool passed = true;
+    for ( uint32_t mipLevel = 1; mipLevel < texture.m_MipLevelCount; ++mipLevel )
+    {
+        const XMFLOAT4 mean = CalculateMipMean( texture, mipLevel );
+        const float colorError = std::max( fabsf( mean.x - previousMean.x ), std::max( fabsf( mean.y - previousMean.y ), fabsf( mean.z - previousMean.z ) ) );
+        const float opacityError = fabsf( mean.w - previousMean.w );
+        maxColorError = std::max( maxColorError, colorError );
+        maxOpacityError = std::max( maxOpacityError, opacityError );
+        passed &= colorError <= colorTolerance && opacityError <= opacityTolerance;
+        previousMean = mean;
+    }
+
+    LOG_STRING_FORMAT( "%ux%u %s: %u mips, mean opacity %.4f at the top and %.4f at 1x1, max error between levels color %.5f opacity %.5f, %s\n",
+        width, height, formatName, texture.m_MipLevelCount, topMean.w, previousMean.w, maxColorError, maxOpacityError, passed ? "passed" : "FAILED" );
+    return passed;
+}
+
+// Black and white texels must average to linear 0.5, not to sRGB 0.5
+static bool ValidateSRGBAveraging()
+{
+    CTexture texture;
+    texture.m_PixelFormat = ETexturePixelFormat::R8G8B8A8_sRGB;
+    texture.m_Width = 2;
+    texture.m_Height = 1;
+    texture.m_MipLevelCount = 1;
+    texture.m_PixelData = { 0, 0, 0, 0, 255, 255, 255, 255 };
+
+    GenerateTextureMipChain( &texture, 1 );
+
+    const uint8_t* texel = texture.m_PixelData.data() + texture.GetMipOffset( 1 );
+    const float expectedValue = ( 1.055f * powf( .5f, 1.f / 2.4f ) - 0.055f ) * 255.f;
+    const bool passed = texture.m_MipLevelCount == 2 && fabsf( texel[ 0 ] - expectedValue ) <= 1.f && texel[ 0 ] == texel[ 1 ] && texel[ 0 ] == texel[ 2 ]
+        && fabsf( texel[ 3 ] - 127.5f ) <= .5f;
+    LOG_STRING_FORMAT( "sRGB averaging: black and white average to ( %u, %u, %u, %u ), expected %.1f, %s\n",
+        texel[ 0 ], texel[ 1 ], texel[ 2 ], texel[ 3 ], expectedValue, passed ? "passed" : "FAILED" );
+    return passed;
+}
+
+bool ValidateMipGeneration()
+{
+    std::mt19937 rng( 0x3317 );
+
+    bool isValid = ValidateSRGBAveraging();
+    const uint32_t sizes[][ 2 ] = { { 1, 1 }, { 2, 1 }, { 3, 3 }, { 5, 7 }, { 13, 1 }, { 1, 9 }, { 64, 32 }, { 100, 37 }, { 129, 255 } };
+    for ( const uint32_t* size : sizes )
+    {
+        isValid &= ValidateMipChain( size[ 0 ], size[ 1 ], ETexturePixelFormat::R8G8B8A8_sRGB, rng );
+        isValid &= ValidateMipChain( size[ 0 ], size[ 1 ], ETexturePixelFormat::R8_Unorm, rng );
+        isValid &= ValidateMipChain( size[ 0 ], size[ 1 ], ETexturePixelFormat::R32G32B32A32_Float, rng );
+    }
+
+    LOG_STRING_FORMAT( "Mip generation validation %s.\n", isValid ? "passed" : "FAILED" );
+    return isValid;
+}
\ No newline at end of file
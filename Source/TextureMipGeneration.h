@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Texture.h"
+
+uint32_t CalculateMipLevelCount( uint32_t width, uint32_t height );
+
+// Box filters the source level into the next one of max( sourceWidth / 2, 1 ) x max( sourceHeight / 2, 1 ) texels.
+// Odd dimensions are handled with fractional footprints so every source texel carries the same total weight.
+// sRGB texels are averaged in linear space. Since opacity is consumed as the probability of a stochastic test, averaging the
+// decoded values keeps the expected coverage of every level equal to the one of the top level.
+void DownsampleTextureMip( const uint8_t* source, uint32_t sourceWidth, uint32_t sourceHeight, ETexturePixelFormat format, uint8_t* destination, uint32_t maxWorkerCount = 0 );
+
+// Appends the full mip chain to a texture holding a single level
+void GenerateTextureMipChain( CTexture* texture, uint32_t maxWorkerCount = 0 );
+
+
+// Generates mip chains of random 8 bit and float textures with odd, non power of two and power of two sizes and checks the level sizes, that sRGB texels
+// are averaged in linear space and that the mean color and opacity are the same at every level. Returns false on failure.
+bool ValidateMipGeneration();
\ No newline at end of file
@@ -28,6 +28,11 @@ public:
 		return stop - m_Start;
 	}
 
+	std::chrono::steady_clock::time_point GetStartTime() const
+	{
+		return m_Start;
+	}
+
 private:
 	std::chrono::steady_clock::time_point m_Start;
 };
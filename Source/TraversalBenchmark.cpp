@@ -0,0 +1,316 @@
+#include "stdafx.h"
+#include "TraversalBenchmark.h"
+#include "BatchRender.h"
+#include "CommandLineArgs.h"
+#include "Scene.h"
+#include "SceneRayTrace.h"
+#include "Logging.h"
+#include "Timers.h"
+
+using namespace DirectX;
+
+static const uint32_t s_RayCountPerSet = 1 << 18;
+static const uint32_t s_RepeatCount = 3; // The fastest run of a set is reported
+
+struct SBenchmarkRay
+{
+    XMFLOAT3 m_Origin;
+    XMFLOAT3 m_Direction;
+    float m_TMax;
+};
+
+struct SCounterStatistics
+{
+    double m_Average;
+    uint32_t m_Percentile50;
+    uint32_t m_Percentile90;
+    uint32_t m_Percentile99;
+    uint32_t m_Max;
+};
+
+struct SRaySetResult
+{
+    const char* m_Name;
+    uint32_t m_RayCount;
+    uint32_t m_HitCount;
+    float m_Seconds;
+    SCounterStatistics m_BoundingBoxTests;
+    SCounterStatistics m_TriangleTests;
+    SCounterStatistics m_BLASEnterings;
+    SCounterStatistics m_BLASLeafTests;
+};
+
+static XMVECTOR XM_CALLCONV SampleUniformSphere( std::mt19937& rng, std::uniform_real_distribution<float>& distribution )
+{
+    const float z = 1.f - 2.f * distribution( rng );
+    const float phi = 2.f * (float)M_PI * distribution( rng );
+    const float r = sqrtf( std::max( 0.f, 1.f - z * z ) );
+    return XMVectorSet( r * cosf( phi ), r * sinf( phi ), z, 0.f );
+}
+
+static XMVECTOR XM_CALLCONV SamplePointInBounds( const BoundingBox& bounds, std::mt19937& rng, std::uniform_real_distribution<float>& distribution )
+{
+    const XMVECTOR sample = XMVectorSet( distribution( rng ), distribution( rng ), distribution( rng ), 0.f );
+    const XMVECTOR center = XMLoadFloat3( &bounds.Center );
+    const XMVECTOR extents = XMLoadFloat3( &bounds.Extents );
+    return center + extents * ( sample * 2.f - XMVectorReplicate( 1.f ) );
+}
+
+static void XM_CALLCONV AddRay( FXMVECTOR origin, FXMVECTOR direction, float tMax, std::vector<SBenchmarkRay>* rays )
+{
+    rays->emplace_back();
+    XMStoreFloat3( &rays->back().m_Origin, origin );
+    XMStoreFloat3( &rays->back().m_Direction, direction );
+    rays->back().m_TMax = tMax;
+}
+
+static SCounterStatistics CalculateCounterStatistics( std::vector<uint32_t>& values )
+{
+    SCounterStatistics statistics = {};
+    if ( values.empty() )
+    {
+        return statistics;
+    }
+
+    uint64_t sum = 0;
+    for ( uint32_t value : values )
+    {
+        sum += value;
+    }
+    statistics.m_Average = (double)sum / values.size();
+
+    // Nearest rank
+    std::sort( values.begin(), values.end() );
+    auto percentile = [ &values ]( float p ) { return values[ std::min( values.size() - 1, (size_t)( p * ( values.size() - 1 ) + .5f ) ) ]; };
+    statistics.m_Percentile50 = percentile( .5f );
+    statistics.m_Percentile90 = percentile( .9f );
+    statistics.m_Percentile99 = percentile( .99f );
+    statistics.m_Max = values.back();
+    return statistics;
+}
+
+static SRaySetResult TraceRaySet( const char* name, const CScene& scene, const std::vector<XMFLOAT4X3>& instanceInvTransforms, const std::vector<SBenchmarkRay>& rays )
+{
+    const uint32_t rayCount = (uint32_t)rays.size();
+    std::vector<SRayTraversalCounters> counters( rayCount );
+
+    SRaySetResult result = {};
+    result.m_Name = name;
+    result.m_RayCount = rayCount;
+    result.m_Seconds = std::numeric_limits<float>::infinity();
+    for ( uint32_t iRepeat = 0; iRepeat < s_RepeatCount; ++iRepeat )
+    {
+        uint32_t hitCount = 0;
+        SRayHit hit;
+        Timer timer;
+        timer.Start();
+        for ( uint32_t iRay = 0; iRay < rayCount; ++iRay )
+        {
+            const SBenchmarkRay& ray = rays[ iRay ];
+            if ( scene.TraceRay( instanceInvTransforms.data(), XMLoadFloat3( &ray.m_Origin ), XMLoadFloat3( &ray.m_Direction ), 0.f, ray.m_TMax, &hit, &counters[ iRay ] ) )
+            {
+                ++hitCount;
+            }
+        }
+        result.m_Seconds = std::min( result.m_Seconds, timer.GetElapsedMicroseconds().count() * 1e-6f );
+        result.m_HitCount = hitCount;
+    }
+
+    std::vector<uint32_t> values( rayCount );
+    auto gatherCounter = [ & ]( uint32_t SRayTraversalCounters::* counter )
+    {
+        for ( uint32_t iRay = 0; iRay < rayCount; ++iRay )
+        {
+            values[ iRay ] = counters[ iRay ].*counter;
+        }
+        return CalculateCounterStatistics( values );
+    };
+    result.m_BoundingBoxTests = gatherCounter( &SRayTraversalCounters::m_BoundingBoxTestsCount );
+    result.m_TriangleTests = gatherCounter( &SRayTraversalCounters::m_TriangleTestsCount );
+    result.m_BLASEnterings = gatherCounter( &SRayTraversalCounters::m_BLASEnteringsCount );
+    result.m_BLASLeafTests = gatherCounter( &SRayTraversalCounters::m_BLASLeafTestsCount );
+
+    LOG_STRING_FORMAT( "%s rays: %u rays, %u hits, %.3fs, %.3f Mrays/s, average %.1f box tests, %.1f triangle tests, %.2f BLAS enterings, "
+        "p99 %u box tests, %u triangle tests\n", name, rayCount, result.m_HitCount, result.m_Seconds,
+        result.m_Seconds > 0.f ? rayCount / result.m_Seconds * 1e-6f : 0.f, result.m_BoundingBoxTests.m_Average, result.m_TriangleTests.m_Average,
+        result.m_BLASEnterings.m_Average, result.m_BoundingBoxTests.m_Percentile99, result.m_TriangleTests.m_Percentile99 );
+    return result;
+}
+
+static void WriteJSONString( FILE* file, const char* str )
+{
+    fputc( '"', file );
+    for ( const char* c = str; *c; ++c )
+    {
+        if ( *c == '"' || *c == '\\' )
+        {
+            fputc( '\\', file );
+        }
+        fputc( *c, file );
+    }
+    fputc( '"', file );
+}
+
+static void WriteCounterStatistics( FILE* file, const char* name, const SCounterStatistics& statistics, bool isLast )
+{
+    fprintf( file, "      \"%s\": { \"average\": %.4f, \"p50\": %u, \"p90\": %u, \"p99\": %u, \"max\": %u }%s\n", name, statistics.m_Average,
+        statistics.m_Percentile50, statistics.m_Percentile90, statistics.m_Percentile99, statistics.m_Max, isLast ? "" : "," );
+}
+
+static bool WriteResultsToJSON( const std::string& filename, const CScene& scene, const std::vector<SRaySetResult>& results )
+{
+    FILE* file = fopen( filename.c_str(), "w" );
+    if ( !file )
+    {
+        LOG_STRING_FORMAT( "Failed to open %s for writing.\n", filename.c_str() );
+        return false;
+    }
+
+    uint32_t triangleCount = 0;
+    uint32_t BLASNodeCount = 0;
+    for ( const Mesh& mesh : scene.m_Meshes )
+    {
+        triangleCount += mesh.GetTriangleCount();
+        BLASNodeCount += mesh.GetBVHNodeCount();
+    }
+
+    fprintf( file, "{\n  \"scene\": " );
+    WriteJSONString( file, CommandLineArgs::Singleton()->GetFilename().c_str() );
+    fprintf( file, ",\n  \"meshCount\": %u,\n  \"instanceCount\": %u,\n  \"triangleCount\": %u,\n  \"TLASNodeCount\": %u,\n  \"BLASNodeCount\": %u,\n"
+        , (uint32_t)scene.m_Meshes.size(), (uint32_t)scene.m_MeshInstances.size(), triangleCount, (uint32_t)scene.m_TLAS.size(), BLASNodeCount );
+    fprintf( file, "  \"repeatCount\": %u,\n  \"raySets\": [\n", s_RepeatCount );
+    for ( size_t iResult = 0; iResult < results.size(); ++iResult )
+    {
+        const SRaySetResult& result = results[ iResult ];
+        fprintf( file, "    {\n      \"name\": \"%s\",\n      \"rayCount\": %u,\n      \"hitCount\": %u,\n      \"seconds\": %.6f,\n      \"mraysPerSecond\": %.4f,\n"
+            , result.m_Name, result.m_RayCount, result.m_HitCount, result.m_Seconds, result.m_Seconds > 0.f ? result.m_RayCount / result.m_Seconds * 1e-6f : 0.f );
+        WriteCounterStatistics( file, "boundingBoxTests", result.m_BoundingBoxTests, false );
+        WriteCounterStatistics( file, "triangleTests", result.m_TriangleTests, false );
+        WriteCounterStatistics( file, "BLASEnterings", result.m_BLASEnterings, false );
+        WriteCounterStatistics( file, "BLASLeafTests", result.m_BLASLeafTests, true );
+        fprintf( file, "    }%s\n", iResult + 1 < results.size() ? "," : "" );
+    }
+    fprintf( file, "  ]\n}\n" );
+
+    const bool result = ferror( file ) == 0;
+    fclose( file );
+    return result;
+}
+
+bool RunTraversalBenchmark( const std::string& outputFilename )
+{
+    EnableLogToStandardOutput();
+
+    CScene* scene = LoadSceneWithoutWindow();
+    if ( !scene )
+    {
+        LOG_STRING( "Traversal benchmark requires a scene that loads.\n" );
+        return false;
+    }
+    if ( scene->m_TLAS.empty() )
+    {
+        LOG_STRING( "Traversal benchmark requires a scene with geometry.\n" );
+        DestroySceneWithoutWindow( scene );
+        return false;
+    }
+
+    std::vector<XMFLOAT4X3> instanceInvTransforms;
+    scene->BuildInstanceInvTransforms( &instanceInvTransforms );
+
+    const BoundingBox& sceneBounds = scene->m_TLAS[ 0 ].m_BoundingBox;
+    const float sceneRadius = XMVectorGetX( XMVector3Length( XMLoadFloat3( &sceneBounds.Extents ) ) );
+    const float offset = sceneRadius * 1e-5f;
+    const float infinity = std::numeric_limits<float>::infinity();
+
+    std::mt19937 rng( 0x6b27 );
+    std::uniform_real_distribution<float> distribution( 0.f, 1.f );
+
+    // Camera rays are jittered in the pixels of a grid with the aspect ratio of the film
+    std::vector<SBenchmarkRay> primaryRays;
+    {
+        const float aspectRatio = (float)scene->m_ResolutionWidth / scene->m_ResolutionHeight;
+        const uint32_t height = std::max( 1u, (uint32_t)sqrtf( s_RayCountPerSet / aspectRatio ) );
+        const uint32_t width = std::max( 1u, s_RayCountPerSet / height );
+        primaryRays.reserve( (size_t)width * height );
+        for ( uint32_t y = 0; y < height; ++y )
+        {
+            for ( uint32_t x = 0; x < width; ++x )
+            {
+                const XMFLOAT2 screenPos( ( x + distribution( rng ) ) / width, ( y + distribution( rng ) ) / height );
+                XMVECTOR origin, direction;
+                scene->ScreenToCameraRay( screenPos, &origin, &direction );
+                AddRay( origin, direction, infinity, &primaryRays );
+            }
+        }
+    }
+
+    // Diffuse bounces are cosine distributed around the geometry normal facing the camera ray, shadow rays end at random points of the scene
+    // bounds, as for a light at a finite distance
+    std::vector<SBenchmarkRay> diffuseRays;
+    std::vector<SBenchmarkRay> shadowRays;
+    for ( const SBenchmarkRay& ray : primaryRays )
+    {
+        const XMVECTOR origin = XMLoadFloat3( &ray.m_Origin );
+        const XMVECTOR direction = XMLoadFloat3( &ray.m_Direction );
+        SRayHit hit;
+        if ( !scene->TraceRay( instanceInvTransforms.data(), origin, direction, 0.f, infinity, &hit ) )
+        {
+            continue;
+        }
+
+        const uint32_t originalInstanceIndex = scene->m_OriginalInstanceIndices[ hit.m_InstanceIndex ];
+        const XMMATRIX transform = XMLoadFloat4x3( &scene->m_InstanceTransforms[ originalInstanceIndex ] );
+        const Mesh& mesh = scene->m_Meshes[ hit.m_MeshIndex ];
+        const GPU::Vertex* vertices = mesh.GetVertices().data();
+        const uint32_t* indices = mesh.GetIndices().data() + hit.m_TriangleIndex * 3;
+        const XMVECTOR v0 = XMVector3TransformCoord( XMLoadFloat3( &vertices[ indices[ 0 ] ].position ), transform );
+        const XMVECTOR v1 = XMVector3TransformCoord( XMLoadFloat3( &vertices[ indices[ 1 ] ].position ), transform );
+        const XMVECTOR v2 = XMVector3TransformCoord( XMLoadFloat3( &vertices[ indices[ 2 ] ].position ), transform );
+        XMVECTOR normal = XMVector3Normalize( XMVector3Cross( v1 - v0, v2 - v0 ) );
+        if ( XMVectorGetX( XMVector3Dot( normal, direction ) ) > 0.f )
+        {
+            normal = -normal;
+        }
+        const XMVECTOR position = origin + direction * hit.m_T + normal * offset;
+
+        const XMVECTOR tangent = XMVector3Normalize( fabsf( XMVectorGetX( normal ) ) > .9f ? XMVector3Cross( normal, XMVectorSet( 0.f, 1.f, 0.f, 0.f ) )
+            : XMVector3Cross( normal, XMVectorSet( 1.f, 0.f, 0.f, 0.f ) ) );
+        const XMVECTOR bitangent = XMVector3Cross( normal, tangent );
+        const float diskRadius = sqrtf( distribution( rng ) );
+        const float diskPhi = 2.f * (float)M_PI * distribution( rng );
+        const float diskX = diskRadius * cosf( diskPhi );
+        const float diskY = diskRadius * sinf( diskPhi );
+        const XMVECTOR diffuseDirection = XMVector3Normalize( tangent * diskX + bitangent * diskY + normal * sqrtf( std::max( 0.f, 1.f - diskX * diskX - diskY * diskY ) ) );
+        AddRay( position, diffuseDirection, infinity, &diffuseRays );
+
+        const XMVECTOR toTarget = SamplePointInBounds( sceneBounds, rng, distribution ) - position;
+        const float distance = XMVectorGetX( XMVector3Length( toTarget ) );
+        if ( distance > 0.f )
+        {
+            AddRay( position, toTarget / distance, distance, &shadowRays );
+        }
+    }
+
+    std::vector<SBenchmarkRay> incoherentRays;
+    incoherentRays.reserve( s_RayCountPerSet );
+    for ( uint32_t iRay = 0; iRay < s_RayCountPerSet; ++iRay )
+    {
+        const XMVECTOR origin = SamplePointInBounds( sceneBounds, rng, distribution );
+        AddRay( origin, SampleUniformSphere( rng, distribution ), infinity, &incoherentRays );
+    }
+
+    std::vector<SRaySetResult> results;
+    results.push_back( TraceRaySet( "primary", *scene, instanceInvTransforms, primaryRays ) );
+    results.push_back( TraceRaySet( "diffuse", *scene, instanceInvTransforms, diffuseRays ) );
+    results.push_back( TraceRaySet( "shadow", *scene, instanceInvTransforms, shadowRays ) );
+    results.push_back( TraceRaySet( "incoherent", *scene, instanceInvTransforms, incoherentRays ) );
+
+    const bool result = WriteResultsToJSON( outputFilename, *scene, results );
+    if ( result )
+    {
+        LOG_STRING_FORMAT( "Traversal benchmark results written to %s.\n", outputFilename.c_str() );
+    }
+
+    DestroySceneWithoutWindow( scene );
+    return result;
+}
\ No newline at end of file
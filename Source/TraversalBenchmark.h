@@ -0,0 +1,6 @@
+#pragma once
+
+// Traces standard ray sets of the scene of the command line through CScene::TraceRay on one thread: camera rays, diffuse bounces and shadow
+// rays from the camera ray hits, and incoherent rays between random points of the scene bounds. The sets are generated with a fixed seed, so
+// the same rays are traced for the same scene and camera. Logs the results and writes them to a JSON file. Returns false on failure.
+bool RunTraversalBenchmark( const std::string& outputFilename );
\ No newline at end of file
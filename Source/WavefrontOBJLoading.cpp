@@ -6,6 +6,7 @@
 #include "Logging.h"
 #include "Constants.h"
 #include "MathHelper.h"
+#include "Profiling.h"
 
 inline static void hash_combine( std::size_t& seed ) { }
 
@@ -146,6 +147,8 @@ static void MikkTSpaceSetTSpaceBasic( const SMikkTSpaceContext* pContext, const
 
 static bool GenerateTangentVectorsForMesh( const tinyobj::attrib_t& attrib, const tinyobj::mesh_t& mesh, SMikkTSpaceContext* context, bool flipTexcoordV, std::vector<XMFLOAT3>* outTangents )
 {
+    PROFILE_SCOPE( "Generate tangents" );
+
     outTangents->resize( mesh.num_face_vertices.size() * 3 );
     STinyObjMeshMikkTSpaceContext meshContext( attrib, mesh, outTangents, flipTexcoordV );
     context->m_pUserData = &meshContext;
@@ -198,6 +201,8 @@ static bool CreateMeshFromWavefrontOBJData( const tinyobj::attrib_t& attrib, con
             continue;
         }
 
+        PROFILE_SCOPE( "Deduplicate vertices" );
+
         for ( size_t iFace = 0; iFace < mesh.num_face_vertices.size(); ++iFace )
         {
             assert( mesh.num_face_vertices[ iFace ] == 3 );
@@ -339,36 +344,29 @@ void SMaterialTranslationContext::TranslateMaterials( const tinyobj::material_t*
 
 bool SMaterialTranslationContext::LoadTexturesFromFiles( const std::filesystem::path& parentFilenamePath, std::vector<CTexture>* textures )
 {
-    STextureCodec* codec = CTexture::CreateCodec();
-    if ( codec == nullptr )
-    {
-        return false;
-    }
+    // Slots are allocated upfront so texture indices assigned during translation stay valid regardless of decode order
+    const size_t textureIndexBase = textures->size();
+    textures->resize( textureIndexBase + m_Textures.size() );
 
-    textures->reserve( textures->size() + m_Textures.size() );
+    std::vector<std::string> absoluteFilenames;
+    absoluteFilenames.reserve( m_Textures.size() );
     std::filesystem::path filenamePath;
-    for ( const STexture& texture : m_Textures )
+    for ( size_t iTexture = 0; iTexture < m_Textures.size(); ++iTexture )
     {
-        const std::string& filename = texture.m_Filename;
-        filenamePath = filename;
+        STexture& texture = m_Textures[ iTexture ];
+        filenamePath = texture.m_Filename;
         if ( filenamePath.is_relative() )
         {
             filenamePath = parentFilenamePath.parent_path() / filenamePath;
         }
+        absoluteFilenames.emplace_back( filenamePath.u8string() );
 
-        textures->emplace_back();
-        CTexture& newTexture = textures->back();
+        CTexture& newTexture = ( *textures )[ textureIndexBase + iTexture ];
         newTexture.Clear();
         newTexture.m_Name = std::move( texture.m_Filename );
-        const std::string absoluteFilename = filenamePath.u8string();
-        if ( !newTexture.LoadFromFile( absoluteFilename.c_str(), codec ) )
-        {
-            LOG_STRING_FORMAT( "Loading texture from file \"%s\" failed.\n", absoluteFilename.c_str() );
-        }
     }
 
-    CTexture::DestroyCodec( codec );
-    return true;
+    return CTexture::LoadFromFiles( absoluteFilenames.data(), textures->data() + textureIndexBase, (uint32_t)m_Textures.size() );
 }
 
 bool Mesh::LoadFromWavefrontOBJFile( const std::filesystem::path& filenamePath, const SMeshProcessingParams& params, std::vector<SMaterial>* outMaterials, std::vector<CTexture>* outTextures )
@@ -382,7 +380,11 @@ bool Mesh::LoadFromWavefrontOBJFile( const std::filesystem::path& filenamePath,
     std::vector<tinyobj::material_t> materials;
     std::string warn;
     std::string err;
-    bool loadSuccessful = tinyobj::LoadObj( &attrib, &shapes, &materials, &warn, &err, filename.c_str(), MTLSearchPath.c_str() );
+    bool loadSuccessful = false;
+    {
+        PROFILE_SCOPE( "Parse OBJ" );
+        loadSuccessful = tinyobj::LoadObj( &attrib, &shapes, &materials, &warn, &err, filename.c_str(), MTLSearchPath.c_str() );
+    }
     if ( !loadSuccessful )
     {
         return false;
@@ -417,7 +419,11 @@ bool CScene::LoadFromWavefrontOBJFile( const std::filesystem::path& filenamePath
     std::vector<tinyobj::material_t> materials;
     std::string warn;
     std::string err;
-    bool loadSuccessful = tinyobj::LoadObj( &attrib, &shapes, &materials, &warn, &err, filename.c_str(), MTLSearchPath.c_str() );
+    bool loadSuccessful = false;
+    {
+        PROFILE_SCOPE( "Parse OBJ" );
+        loadSuccessful = tinyobj::LoadObj( &attrib, &shapes, &materials, &warn, &err, filename.c_str(), MTLSearchPath.c_str() );
+    }
     if ( !loadSuccessful )
     {
         return false;
@@ -29,7 +29,7 @@ static const uint32_t s_KernelGroupSize = 32;
 
 static const uint32_t s_BlockDimensionCount = 2;
 
-static SD3D12DescriptorTableLayout s_DescriptorTableLayout = SD3D12DescriptorTableLayout( 18, 11 );
+static SD3D12DescriptorTableLayout s_DescriptorTableLayout = SD3D12DescriptorTableLayout( 22, 11 );
 
 struct alignas( 256 ) SControlConstants
 {
@@ -60,6 +60,8 @@ struct alignas( 256 ) SMaterialConstants
     uint32_t g_LightCount;
     uint32_t g_MaxBounceCount;
     uint32_t g_EnvironmentLightIndex;
+    uint32_t g_RussianRouletteBounceCount;
+    float g_PixelSpreadAngle;
 };
 
 CWavefrontPathTracer::CWavefrontPathTracer()
@@ -175,8 +177,8 @@ bool CWavefrontPathTracer::Create()
         return false;
 
     m_PathAccumulationBuffer.Reset( GPUBuffer::CreateStructured(
-          s_PathPoolLaneCount * 32
-        , 32
+          s_PathPoolLaneCount * 48
+        , 48
         , EGPUBufferUsage::Default
         , EGPUBufferBindFlag_ShaderResource | EGPUBufferBindFlag_UnorderedAccess ) );
     if ( !m_PathAccumulationBuffer )
@@ -423,6 +425,8 @@ void CWavefrontPathTracer::Render( CScene* scene, const SRenderContext& renderCo
             constants->g_LightCount = scene->GetLightCount();
             constants->g_MaxBounceCount = scene->m_MaxBounceCount;
             constants->g_EnvironmentLightIndex = scene->m_EnvironmentLight ? (uint32_t)scene->m_MeshLights.size() : LIGHT_INDEX_INVALID; // Environment light is right after the mesh lights.
+            constants->g_RussianRouletteBounceCount = scene->m_RussianRouletteBounceCount;
+            constants->g_PixelSpreadAngle = scene->m_FilmSize.y / ( scene->CalculateFilmDistance() * renderContext.m_CurrentResolutionHeight );
             constantBufferUploadContexts[ 2 ].Unmap();
         }
     }
@@ -876,6 +880,13 @@ void CWavefrontPathTracer::RenderOneIteration( CScene* scene, const SBxDFTexture
         {
             barriers.emplace_back( CD3DX12_RESOURCE_BARRIER::Transition( scene->m_LightsBuffer->GetBuffer(),
                 D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE ) );
+            barriers.emplace_back( CD3DX12_RESOURCE_BARRIER::Transition( scene->m_LightAliasTableBuffer->GetBuffer(),
+                D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE ) );
+            if ( !scene->m_LightBVH.m_Nodes.empty() )
+            {
+                barriers.emplace_back( CD3DX12_RESOURCE_BARRIER::Transition( scene->m_LightBVHNodesBuffer->GetBuffer(),
+                    D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_ALL_SHADER_RESOURCE ) );
+            }
             scene->m_IsLightBufferRead = true;
         }
         if ( !scene->m_IsMaterialBufferRead )
@@ -916,9 +927,14 @@ void CWavefrontPathTracer::RenderOneIteration( CScene* scene, const SBxDFTexture
         SCOPED_RENDER_ANNOTATION( commandList, L"Material" );
 
         SD3D12DescriptorHandle environmentTextureSRV = D3D12Adapter::GetNullBufferSRV();
+        SD3D12DescriptorHandle environmentDistributionSRV = D3D12Adapter::GetNullBufferSRV();
         if ( scene->m_EnvironmentLight && scene->m_EnvironmentLight->m_Texture )
         {
             environmentTextureSRV = scene->m_EnvironmentLight->m_Texture->GetSRV();
+            if ( scene->m_EnvironmentLight->m_Distribution )
+            {
+                environmentDistributionSRV = scene->m_EnvironmentLight->m_Distribution->GetSRV();
+            }
         }
 
         SD3D12DescriptorHandle SRVs[] =
@@ -941,6 +957,10 @@ void CWavefrontPathTracer::RenderOneIteration( CScene* scene, const SBxDFTexture
             , BxDFTextures.m_CookTorranceBSDF->GetSRV()
             , BxDFTextures.m_CookTorranceBSDFAverage->GetSRV()
             , environmentTextureSRV
+            , environmentDistributionSRV
+            , scene->m_LightAliasTableBuffer->GetSRV()
+            , scene->m_TriangleAliasTableBuffer ? scene->m_TriangleAliasTableBuffer->GetSRV() : D3D12Adapter::GetNullBufferSRV()
+            , scene->m_LightBVHNodesBuffer->GetSRV()
         };
 
         SD3D12DescriptorHandle UAVs[] =
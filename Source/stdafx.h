@@ -17,6 +17,7 @@
 
 #include <vector>
 #include <stack>
+#include <queue>
 
 #include "d3d12.h"
 #include "d3d12sdklayers.h"
@@ -32,6 +33,9 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
 #include <locale>
 #include <codecvt>
 #include <filesystem>